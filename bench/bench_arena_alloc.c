@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_arena_alloc: bpf_arena_alloc() / bpf_arena_free() in isolation
+ *
+ * The userspace allocator as skeleton_msqueue builds it (ARENA_PAGE_OWNER:
+ * pages come from an ownership map and go back when their last object is
+ * freed), over a 16 MB region. The default bump allocator never returns a
+ * page, so it could not sustain these loops. Four sections:
+ *
+ *   size classes   one thread, 8..2048 B: alloc and free Mops in batches,
+ *                  per-op p50/p99 from a separately timed pass
+ *   scaling        1..T threads pinned to CPUs, 64 B alloc+free pairs
+ *   cross free     T threads each allocate a batch, then free either their
+ *                  own batch or their neighbour's
+ *   fragmentation  random 8..512 B objects, a random fraction freed: pages
+ *                  still held, fill ratio, and new pages a refill needs
+ *
+ * Every row also shows page-source calls per 1000 objects, from the
+ * ARENA_ALLOC_STATS counters. skeleton_arena_alloc measures the BPF-side
+ * allocator with the same sections.
+ */
+#define ARENA_PAGE_OWNER
+#define ARENA_ALLOC_STATS
+
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_page_owner.h"
+
+#define BENCH_MAX_BATCH 4096
+#define BENCH_FRAG_OBJS 16384
+#define BENCH_FRAG_MAX_SIZE 512
+
+static const unsigned int sizes[] = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048 };
+static const unsigned int frag_pcts[] = { 50, 75, 90, 99 };
+
+struct bench_config {
+	uint64_t ops;
+	__u32 batch;
+	int max_threads;
+	unsigned int scale_size;
+};
+
+static struct bench_config config = {
+	.ops = 2000000,
+	.batch = 256,
+	.max_threads = 0,	/* 0: online CPUs */
+	.scale_size = 64,
+};
+
+/* Stands in for the BPF program's arena globals */
+static struct ds_page_owner *owner;
+
+struct page_calls {
+	__u64 allocs;
+	__u64 frees;
+};
+
+static struct page_calls page_calls_now(void)
+{
+	return (struct page_calls){
+		.allocs = __atomic_load_n(&bpf_arena_userspace_stats.page_allocs, __ATOMIC_RELAXED),
+		.frees = __atomic_load_n(&bpf_arena_userspace_stats.page_frees, __ATOMIC_RELAXED),
+	};
+}
+
+static double per_k(__u64 n, uint64_t objs)
+{
+	return objs ? (double)n * 1000.0 / (double)objs : 0.0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void *alloc_or_die(unsigned int size)
+{
+	void *p = bpf_arena_alloc(size);
+
+	if (!p) {
+		fprintf(stderr, "bench_arena_alloc: arena exhausted at %u B\n", size);
+		exit(1);
+	}
+	return p;
+}
+
+/* ------------------------------------------------------------------------
+ * Size classes
+ * ------------------------------------------------------------------------ */
+
+static void run_size(unsigned int size)
+{
+	static void *slots[BENCH_MAX_BATCH];
+	static uint64_t lat_alloc[BENCH_MAX_BATCH], lat_free[BENCH_MAX_BATCH];
+	uint64_t alloc_ns = 0, free_ns = 0, done = 0, t0;
+	struct page_calls before = page_calls_now(), after;
+	__u32 b = config.batch;
+
+	while (done < config.ops) {
+		t0 = bench_now_ns();
+		for (__u32 i = 0; i < b; i++)
+			slots[i] = alloc_or_die(size);
+		alloc_ns += bench_now_ns() - t0;
+
+		t0 = bench_now_ns();
+		for (__u32 i = 0; i < b; i++)
+			bpf_arena_free(slots[i]);
+		free_ns += bench_now_ns() - t0;
+		done += b;
+	}
+	after = page_calls_now();
+
+	/* One timed pass for the distribution; includes one clock read per op */
+	for (__u32 i = 0; i < b; i++) {
+		t0 = bench_now_ns();
+		slots[i] = alloc_or_die(size);
+		lat_alloc[i] = bench_now_ns() - t0;
+	}
+	for (__u32 i = 0; i < b; i++) {
+		t0 = bench_now_ns();
+		bpf_arena_free(slots[i]);
+		lat_free[i] = bench_now_ns() - t0;
+	}
+	qsort(lat_alloc, b, sizeof(*lat_alloc), cmp_u64);
+	qsort(lat_free, b, sizeof(*lat_free), cmp_u64);
+
+	printf("%6u %10.2f %9.2f %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %9.2f %9.2f\n",
+	       size, bench_mops(done, alloc_ns), bench_mops(done, free_ns),
+	       lat_alloc[b / 2], lat_alloc[b * 99 / 100], lat_free[b / 2], lat_free[b * 99 / 100],
+	       per_k(after.allocs - before.allocs, done), per_k(after.frees - before.frees, done));
+}
+
+/* ------------------------------------------------------------------------
+ * Scaling and cross-thread free
+ * ------------------------------------------------------------------------ */
+
+struct worker {
+	pthread_t thread;
+	int id;
+	int nr;
+	bool neighbour;		/* cross free: free the next worker's batch */
+	void **slots;
+	uint64_t ns;
+};
+
+static struct worker workers[BENCH_MAX_THREADS];
+static pthread_barrier_t round_barrier;
+
+static void *scale_main(void *arg)
+{
+	struct worker *w = arg;
+	uint64_t done = 0, per = config.ops / (uint64_t)w->nr, t0;
+
+	bench_pin_cpu(w->id);
+	pthread_barrier_wait(&round_barrier);
+	t0 = bench_now_ns();
+	while (done < per) {
+		for (__u32 i = 0; i < config.batch; i++)
+			w->slots[i] = alloc_or_die(config.scale_size);
+		for (__u32 i = 0; i < config.batch; i++)
+			bpf_arena_free(w->slots[i]);
+		done += config.batch;
+	}
+	w->ns = bench_now_ns() - t0;
+	return NULL;
+}
+
+static void *cross_main(void *arg)
+{
+	struct worker *w = arg;
+	struct worker *victim = w->neighbour ? &workers[(w->id + 1) % w->nr] : w;
+	uint64_t done = 0, per = config.ops / (uint64_t)w->nr, t0;
+
+	bench_pin_cpu(w->id);
+	pthread_barrier_wait(&round_barrier);
+	t0 = bench_now_ns();
+	while (done < per) {
+		for (__u32 i = 0; i < config.batch; i++)
+			w->slots[i] = alloc_or_die(config.scale_size);
+		pthread_barrier_wait(&round_barrier);
+		for (__u32 i = 0; i < config.batch; i++)
+			bpf_arena_free(victim->slots[i]);
+		pthread_barrier_wait(&round_barrier);
+		done += config.batch;
+	}
+	w->ns = bench_now_ns() - t0;
+	return NULL;
+}
+
+/* Returns aggregate Mops over alloc+free pairs; page calls via @pc */
+static double run_threads(int nr, void *(*fn)(void *), bool neighbour, struct page_calls *pc)
+{
+	struct page_calls before = page_calls_now(), after;
+	uint64_t max_ns = 0;
+
+	pthread_barrier_init(&round_barrier, NULL, (unsigned int)nr);
+	for (int t = 0; t < nr; t++) {
+		workers[t].id = t;
+		workers[t].nr = nr;
+		workers[t].neighbour = neighbour;
+		workers[t].ns = 0;
+		if (pthread_create(&workers[t].thread, NULL, fn, &workers[t]) != 0) {
+			fprintf(stderr, "bench_arena_alloc: pthread_create failed\n");
+			exit(1);
+		}
+	}
+	for (int t = 0; t < nr; t++) {
+		pthread_join(workers[t].thread, NULL);
+		if (workers[t].ns > max_ns)
+			max_ns = workers[t].ns;
+	}
+	pthread_barrier_destroy(&round_barrier);
+
+	after = page_calls_now();
+	pc->allocs = after.allocs - before.allocs;
+	pc->frees = after.frees - before.frees;
+	return bench_mops(config.ops / (uint64_t)nr * (uint64_t)nr, max_ns);
+}
+
+/* ------------------------------------------------------------------------
+ * Fragmentation
+ * ------------------------------------------------------------------------ */
+
+static void run_frag(unsigned int pct, uint64_t *seed)
+{
+	static void *objs[BENCH_FRAG_OBJS];
+	static unsigned int objsz[BENCH_FRAG_OBJS];
+	size_t pg = bpf_arena_userspace_page_size;
+	__u32 base = ds_page_owner_count_c(owner);
+	__u32 held_full, held_after, held_refill, nr_free;
+	uint64_t live = 0;
+	struct page_calls before, after;
+
+	for (__u32 i = 0; i < BENCH_FRAG_OBJS; i++) {
+		objsz[i] = 8u + (unsigned int)(bench_rand(seed) % (BENCH_FRAG_MAX_SIZE - 7));
+		objs[i] = alloc_or_die(objsz[i]);
+	}
+	held_full = ds_page_owner_count_c(owner) - base;
+
+	/* Free a random pct% in random order (Fisher-Yates prefix) */
+	nr_free = (__u32)((uint64_t)BENCH_FRAG_OBJS * pct / 100);
+	for (__u32 i = 0; i < nr_free; i++) {
+		__u32 j = i + (__u32)(bench_rand(seed) % (BENCH_FRAG_OBJS - i));
+		void *p = objs[i];
+		unsigned int s = objsz[i];
+
+		objs[i] = objs[j];
+		objsz[i] = objsz[j];
+		objs[j] = p;
+		objsz[j] = s;
+		bpf_arena_free(objs[i]);
+	}
+	for (__u32 i = nr_free; i < BENCH_FRAG_OBJS; i++)
+		live += round_up((uint64_t)objsz[i], 8);
+	held_after = ds_page_owner_count_c(owner) - base;
+
+	/* Refill the same number of objects: holes inside held pages are not reused */
+	before = page_calls_now();
+	for (__u32 i = 0; i < nr_free; i++)
+		objs[i] = alloc_or_die(objsz[i]);
+	after = page_calls_now();
+	held_refill = ds_page_owner_count_c(owner) - base;
+
+	printf("%5u%% %8u %10u %10u %8.1f%% %10" PRIu64 " %10u\n", pct, held_full, held_after,
+	       held_refill, held_after ? 100.0 * (double)live / ((double)held_after * (double)pg) : 0.0,
+	       (uint64_t)(after.allocs - before.allocs), BENCH_FRAG_OBJS - nr_free);
+
+	for (__u32 i = 0; i < BENCH_FRAG_OBJS; i++)
+		bpf_arena_free(objs[i]);
+}
+
+/* ------------------------------------------------------------------------ */
+
+static int setup_arena(void)
+{
+	size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+	size_t bytes = (size_t)DS_PAGE_OWNER_MAX_PAGES * pg;
+	size_t reserved = (sizeof(*owner) + pg - 1) / pg;
+	void *mem;
+
+	mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "bench_arena_alloc: mmap(%zu) failed: %s\n", bytes, strerror(errno));
+		return -1;
+	}
+
+	owner = mem;
+	bpf_arena_userspace_set_range((char *)mem + reserved * pg, bytes - reserved * pg);
+	if (ds_page_owner_init_c(owner, mem, DS_PAGE_OWNER_MAX_PAGES, (__u32)reserved) != DS_SUCCESS)
+		return -1;
+	bpf_arena_userspace_set_owner(owner);
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Userspace arena allocator: size classes, scaling, cross-thread free, fragmentation\n\n");
+	printf("OPTIONS:\n");
+	printf("  -n N    Objects per run (default: %" PRIu64 ")\n", config.ops);
+	printf("  -b N    Objects live per batch, 1..%d (default: %u)\n", BENCH_MAX_BATCH, config.batch);
+	printf("  -t N    Max threads for scaling and cross free (default: online CPUs)\n");
+	printf("  -s B    Object size for scaling and cross free (default: %u)\n", config.scale_size);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:t:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			config.ops = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			config.batch = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 's':
+			config.scale_size = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!config.max_threads)
+		config.max_threads = bench_nr_cpus();
+	if (!config.ops || !config.batch || config.batch > BENCH_MAX_BATCH ||
+	    config.max_threads < 1 || config.max_threads > BENCH_MAX_THREADS ||
+	    !config.scale_size || config.scale_size > 2048) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t seed = 0x9e3779b97f4a7c15ull;
+	struct page_calls pc;
+	double mops;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (setup_arena() < 0)
+		return 1;
+	/* Cross free always runs at least two threads */
+	for (int t = 0; t < (config.max_threads < 2 ? 2 : config.max_threads); t++) {
+		workers[t].slots = calloc(config.batch, sizeof(void *));
+		if (!workers[t].slots)
+			return 1;
+	}
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Size classes: 1 thread, %" PRIu64 " objects, %u live per batch\n",
+	       config.ops, config.batch);
+	printf("  ns columns include one clock read; pages = page-source calls per 1000 objects\n");
+	bench_print_rule();
+	printf("%6s %10s %9s %8s %8s %8s %8s %9s %9s\n", "Size", "Alloc Mops", "Free Mops",
+	       "a p50", "a p99", "f p50", "f p99", "Pg alloc", "Pg free");
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		run_size(sizes[i]);
+
+	bench_print_rule();
+	printf("  Scaling: %u B alloc+free pairs, threads pinned to CPUs 0..N-1\n", config.scale_size);
+	bench_print_rule();
+	printf("%7s %10s %9s %9s\n", "Threads", "Mpairs/s", "Pg alloc", "Pg free");
+	for (int t = 1;; t = t * 2 < config.max_threads ? t * 2 : config.max_threads) {
+		mops = run_threads(t, scale_main, false, &pc);
+		printf("%7d %10.2f %9.2f %9.2f\n", t, mops, per_k(pc.allocs, config.ops),
+		       per_k(pc.frees, config.ops));
+		if (t == config.max_threads)
+			break;
+	}
+
+	bench_print_rule();
+	printf("  Cross free: %d threads allocate %u each, then free own or neighbour's batch\n",
+	       config.max_threads < 2 ? 2 : config.max_threads, config.batch);
+	bench_print_rule();
+	printf("%-10s %10s %9s %9s\n", "Free", "Mpairs/s", "Pg alloc", "Pg free");
+	for (int n = 0; n < 2; n++) {
+		int nr = config.max_threads < 2 ? 2 : config.max_threads;
+
+		mops = run_threads(nr, cross_main, n == 1, &pc);
+		printf("%-10s %10.2f %9.2f %9.2f\n", n ? "neighbour" : "own", mops,
+		       per_k(pc.allocs, config.ops), per_k(pc.frees, config.ops));
+	}
+
+	bench_print_rule();
+	printf("  Fragmentation: %d objects of 8..%d B, a random share freed, then refilled\n",
+	       BENCH_FRAG_OBJS, BENCH_FRAG_MAX_SIZE);
+	printf("  Fill = live bytes / held pages; Refill pg = new pages for the refill\n");
+	bench_print_rule();
+	printf("%6s %8s %10s %10s %9s %10s %10s\n", "Freed", "Pages", "After free", "After fill",
+	       "Fill", "Refill pg", "Live objs");
+	for (size_t i = 0; i < sizeof(frag_pcts) / sizeof(frag_pcts[0]); i++)
+		run_frag(frag_pcts[i], &seed);
+
+	bench_print_rule();
+	ds_page_owner_print(owner);
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/types.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Benchmarks run against the real userspace arena allocator from
+ * libarena_ds.h (unlike usertests, which redirect to a bump allocator),
+ * so allocation and free costs are part of what is measured.
+ */
+#include "libarena_ds.h"
+
+#ifndef BENCH_ARENA_BYTES
+#define BENCH_ARENA_BYTES (1024ull * 1024ull * 1024ull)
+#endif
+
+#define BENCH_MAX_THREADS 256
+
+static inline uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Map an anonymous region and hand it to the userspace arena allocator. */
+static inline int bench_arena_setup(size_t bytes)
+{
+	void *mem;
+
+	mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "bench: mmap(%zu) failed: %s\n", bytes, strerror(errno));
+		return -1;
+	}
+
+	bpf_arena_userspace_set_range(mem, bytes);
+	return 0;
+}
+
+static inline int bench_nr_cpus(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int)n : 1;
+}
+
+static inline void bench_pin_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % bench_nr_cpus(), &set);
+	(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/* xorshift64*: cheap per-thread PRNG; state must be non-zero */
+static inline uint64_t bench_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Spin barrier so all workers start timing together */
+struct bench_barrier {
+	_Atomic int arrived;
+	int total;
+};
+
+static inline void bench_barrier_wait(struct bench_barrier *b)
+{
+	atomic_fetch_add_explicit(&b->arrived, 1, memory_order_acq_rel);
+	while (atomic_load_explicit(&b->arrived, memory_order_acquire) < b->total)
+		;
+}
+
+static inline double bench_mops(uint64_t ops, uint64_t ns)
+{
+	return ns ? (double)ops * 1e3 / (double)ns : 0.0;
+}
+
+static inline void bench_print_rule(void)
+{
+	printf("============================================================\n");
+}
+
+#include "bench_env.h"
@@ -0,0 +1,297 @@
+#pragma once
+
+/*
+ * Benchmark environment: what the machine was doing while the numbers
+ * were taken, and whether they can be trusted.
+ *
+ * bench_env_begin() records the CPU governor, turbo state, SMT, isolcpus
+ * / nohz_full, THP mode and kernel release, then calibrates: the cost of
+ * one bench_now_ns() and the spread of a fixed busy loop. bench_env_end()
+ * repeats the loop and flags the run as NOISY when either spread (p99
+ * over p50) exceeds BENCH_NOISE_MAX_PCT. Both print indented "env:"
+ * lines, which scripts that parse result rows (relax_explorer.py) skip.
+ *
+ * Environment knobs (benches keep their own getopt letters):
+ *   BENCH_PERF_MODE=1       set the performance governor and disable
+ *                           turbo for the run, restored at exit; needs
+ *                           write access to sysfs and is reported if denied
+ *   BENCH_NOISE_MAX_PCT=N   noise threshold (default 10)
+ */
+
+#include <sys/utsname.h>
+
+#define BENCH_ENV_TIMER_SAMPLES 20000
+#define BENCH_ENV_LOOP_SAMPLES 2000
+#define BENCH_ENV_LOOP_ITERS 2000
+#define BENCH_ENV_NOISE_MAX_PCT 10.0
+#define BENCH_ENV_MAX_CPUS 1024
+#define BENCH_ENV_STR 128
+
+struct bench_env_restore {
+	char path[96];
+	char value[BENCH_ENV_STR];
+};
+
+struct bench_env {
+	char kernel[BENCH_ENV_STR];
+	char governor[BENCH_ENV_STR];	/* cpu0's, "mixed" if CPUs differ */
+	char turbo[BENCH_ENV_STR];
+	char smt[BENCH_ENV_STR];
+	char isolated[BENCH_ENV_STR];
+	char nohz_full[BENCH_ENV_STR];
+	char thp[BENCH_ENV_STR];
+	char perf_mode[BENCH_ENV_STR];
+	int nr_cpus;
+	int nr_cores;
+	double timer_ns;		/* median bench_now_ns() cost */
+	double loop_ns;			/* median busy-loop time */
+	double begin_noise_pct;
+	double end_noise_pct;
+	double noise_max_pct;
+	/* sysfs values changed by BENCH_PERF_MODE, put back at exit */
+	struct bench_env_restore restore[BENCH_ENV_MAX_CPUS + 1];
+	int nr_restore;
+};
+
+static struct bench_env bench_env;
+
+/* First line of @path without the newline; "" if unreadable */
+static inline void bench_env_read(const char *path, char *buf, size_t len)
+{
+	FILE *f = fopen(path, "r");
+
+	buf[0] = '\0';
+	if (!f)
+		return;
+	if (!fgets(buf, (int)len, f))
+		buf[0] = '\0';
+	fclose(f);
+	buf[strcspn(buf, "\n")] = '\0';
+}
+
+static inline int bench_env_write(const char *path, const char *value)
+{
+	FILE *f = fopen(path, "w");
+	int err;
+
+	if (!f)
+		return -errno;
+	err = fputs(value, f) < 0 ? -EIO : 0;
+	if (fclose(f) != 0 && !err)
+		err = -errno;
+	return err;
+}
+
+/* Write @value to @path, remembering the old value for bench_env_restore_all() */
+static inline int bench_env_set(const char *path, const char *value)
+{
+	struct bench_env_restore *r;
+	int err;
+
+	if (bench_env.nr_restore >= BENCH_ENV_MAX_CPUS + 1)
+		return -ENOSPC;
+	r = &bench_env.restore[bench_env.nr_restore];
+	bench_env_read(path, r->value, sizeof(r->value));
+	if (!r->value[0])
+		return -ENOENT;
+	if (!strcmp(r->value, value))
+		return 0;
+
+	err = bench_env_write(path, value);
+	if (err)
+		return err;
+	snprintf(r->path, sizeof(r->path), "%s", path);
+	bench_env.nr_restore++;
+	return 0;
+}
+
+static void bench_env_restore_all(void)
+{
+	while (bench_env.nr_restore > 0) {
+		struct bench_env_restore *r = &bench_env.restore[--bench_env.nr_restore];
+
+		(void)bench_env_write(r->path, r->value);
+	}
+}
+
+static inline void bench_env_detect(struct bench_env *env)
+{
+	char path[96], buf[BENCH_ENV_STR], sib[BENCH_ENV_STR];
+	struct utsname u;
+
+	env->nr_cpus = bench_nr_cpus();
+	snprintf(env->kernel, sizeof(env->kernel), "%s", uname(&u) == 0 ? u.release : "unknown");
+
+	env->governor[0] = '\0';
+	env->nr_cores = 0;
+	for (int cpu = 0; cpu < env->nr_cpus && cpu < BENCH_ENV_MAX_CPUS; cpu++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+		bench_env_read(path, buf, sizeof(buf));
+		if (!env->governor[0])
+			snprintf(env->governor, sizeof(env->governor), "%s", buf);
+		else if (strcmp(env->governor, buf))
+			snprintf(env->governor, sizeof(env->governor), "mixed");
+
+		/* A core is counted once, by its lowest-numbered sibling */
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+		bench_env_read(path, sib, sizeof(sib));
+		if (!sib[0] || atoi(sib) == cpu)
+			env->nr_cores++;
+	}
+	if (!env->governor[0])
+		snprintf(env->governor, sizeof(env->governor), "n/a (no cpufreq)");
+
+	bench_env_read("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof(buf));
+	if (buf[0]) {
+		snprintf(env->turbo, sizeof(env->turbo), "%s", buf[0] == '1' ? "off" : "on");
+	} else {
+		bench_env_read("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof(buf));
+		snprintf(env->turbo, sizeof(env->turbo), "%s",
+			 buf[0] ? (buf[0] == '1' ? "on" : "off") : "n/a");
+	}
+
+	bench_env_read("/sys/devices/system/cpu/smt/active", buf, sizeof(buf));
+	snprintf(env->smt, sizeof(env->smt), "SMT %s, %d CPUs on %d cores",
+		 buf[0] ? (buf[0] == '1' ? "active" : "inactive") : "n/a",
+		 env->nr_cpus, env->nr_cores);
+
+	bench_env_read("/sys/devices/system/cpu/isolated", buf, sizeof(buf));
+	snprintf(env->isolated, sizeof(env->isolated), "%s", buf[0] ? buf : "none");
+	bench_env_read("/sys/devices/system/cpu/nohz_full", buf, sizeof(buf));
+	snprintf(env->nohz_full, sizeof(env->nohz_full), "%s",
+		 buf[0] && strcmp(buf, "(null)") ? buf : "none");
+
+	/* "always [madvise] never": the bracketed word is the mode */
+	bench_env_read("/sys/kernel/mm/transparent_hugepage/enabled", buf, sizeof(buf));
+	if (strchr(buf, '[') && strchr(buf, ']')) {
+		*strchr(buf, ']') = '\0';
+		snprintf(env->thp, sizeof(env->thp), "%s", strchr(buf, '[') + 1);
+	} else {
+		snprintf(env->thp, sizeof(env->thp), "n/a");
+	}
+}
+
+/* Performance governor on every CPU and turbo off, when sysfs lets us */
+static inline void bench_env_perf_mode(struct bench_env *env)
+{
+	char path[96];
+	int err = 0, turbo_err;
+
+	for (int cpu = 0; cpu < env->nr_cpus && cpu < BENCH_ENV_MAX_CPUS && !err; cpu++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+		err = bench_env_set(path, "performance");
+	}
+
+	turbo_err = bench_env_set("/sys/devices/system/cpu/intel_pstate/no_turbo", "1");
+	if (turbo_err == -ENOENT)
+		turbo_err = bench_env_set("/sys/devices/system/cpu/cpufreq/boost", "0");
+
+	atexit(bench_env_restore_all);
+	snprintf(env->perf_mode, sizeof(env->perf_mode), "governor %s, turbo %s",
+		 err == -ENOENT ? "n/a" : err ? "denied" : "performance",
+		 turbo_err == -ENOENT ? "n/a" : turbo_err ? "denied" : "disabled");
+}
+
+static int bench_env_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Median cost of one bench_now_ns() call */
+static inline double bench_env_timer_ns(void)
+{
+	uint64_t *s = malloc(sizeof(*s) * BENCH_ENV_TIMER_SAMPLES);
+	uint64_t t0, t1;
+	double median;
+
+	if (!s)
+		return 0.0;
+	for (int i = 0; i < BENCH_ENV_TIMER_SAMPLES; i++) {
+		t0 = bench_now_ns();
+		t1 = bench_now_ns();
+		s[i] = t1 - t0;
+	}
+	qsort(s, BENCH_ENV_TIMER_SAMPLES, sizeof(*s), bench_env_cmp_u64);
+	median = (double)s[BENCH_ENV_TIMER_SAMPLES / 2];
+	free(s);
+	return median;
+}
+
+/*
+ * Time a fixed busy loop BENCH_ENV_LOOP_SAMPLES times. Returns the p99
+ * over p50 spread in percent; on a quiet CPU it is a few percent.
+ */
+static inline double bench_env_loop_noise(double *median_ns)
+{
+	uint64_t *s = malloc(sizeof(*s) * BENCH_ENV_LOOP_SAMPLES);
+	volatile uint64_t sink;
+	uint64_t x = 1, t0;
+	double p50, p99;
+
+	if (!s)
+		return 0.0;
+	for (int i = 0; i < BENCH_ENV_LOOP_SAMPLES; i++) {
+		t0 = bench_now_ns();
+		for (int j = 0; j < BENCH_ENV_LOOP_ITERS; j++)
+			x = bench_rand(&x) | 1;
+		s[i] = bench_now_ns() - t0;
+	}
+	sink = x;
+	(void)sink;
+
+	qsort(s, BENCH_ENV_LOOP_SAMPLES, sizeof(*s), bench_env_cmp_u64);
+	p50 = (double)s[BENCH_ENV_LOOP_SAMPLES / 2];
+	p99 = (double)s[BENCH_ENV_LOOP_SAMPLES * 99 / 100];
+	free(s);
+	if (median_ns)
+		*median_ns = p50;
+	return p50 > 0 ? (p99 - p50) * 100.0 / p50 : 0.0;
+}
+
+static inline void bench_env_begin(void)
+{
+	const char *s;
+
+	bench_env_detect(&bench_env);
+
+	s = getenv("BENCH_PERF_MODE");
+	if (s && atoi(s))
+		bench_env_perf_mode(&bench_env);
+	else
+		snprintf(bench_env.perf_mode, sizeof(bench_env.perf_mode), "off (BENCH_PERF_MODE=1)");
+
+	s = getenv("BENCH_NOISE_MAX_PCT");
+	bench_env.noise_max_pct = s ? atof(s) : BENCH_ENV_NOISE_MAX_PCT;
+
+	bench_env.timer_ns = bench_env_timer_ns();
+	bench_env.begin_noise_pct = bench_env_loop_noise(&bench_env.loop_ns);
+
+	bench_print_rule();
+	printf("  env: kernel %s, %s\n", bench_env.kernel, bench_env.smt);
+	printf("  env: governor %s, turbo %s, perf mode %s\n",
+	       bench_env.governor, bench_env.turbo, bench_env.perf_mode);
+	printf("  env: isolcpus %s, nohz_full %s, THP %s\n",
+	       bench_env.isolated, bench_env.nohz_full, bench_env.thp);
+	printf("  env: timer %.0f ns/call, busy loop %.1f us, p99 spread %.1f%% (max %.0f%%)\n",
+	       bench_env.timer_ns, bench_env.loop_ns / 1e3, bench_env.begin_noise_pct,
+	       bench_env.noise_max_pct);
+}
+
+/* Returns: true if the run stayed under the noise threshold */
+static inline bool bench_env_end(void)
+{
+	bool quiet;
+
+	bench_env.end_noise_pct = bench_env_loop_noise(NULL);
+	quiet = bench_env.begin_noise_pct <= bench_env.noise_max_pct &&
+		bench_env.end_noise_pct <= bench_env.noise_max_pct;
+
+	printf("  env: p99 spread %.1f%% before, %.1f%% after: %s\n",
+	       bench_env.begin_noise_pct, bench_env.end_noise_pct,
+	       quiet ? "ok" : "NOISY, treat the numbers above as indicative only");
+	bench_print_rule();
+	return quiet;
+}
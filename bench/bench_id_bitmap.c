@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_id_bitmap: acquire/release throughput of ds_id_bitmap.h at scale
+ *
+ * The pool holds -c IDs and is pre-filled to -f percent, so searches run
+ * against a mostly full hierarchy. Each worker keeps a window of -w held
+ * IDs and, per operation, releases the oldest one and acquires a new one.
+ * The same loop over a mutex-protected free stack (the allocator this
+ * replaces) is reported alongside. The run is repeated for 1, 2, 4, ...
+ * up to -t threads.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_id_bitmap.h"
+
+#define BENCH_MAX_WINDOW 1024
+
+struct bench_config {
+	int max_threads;
+	uint64_t ops_per_thread;
+	__u32 nr_ids;
+	unsigned int prefill_pct;
+	unsigned int window;
+};
+
+static struct bench_config config = {
+	.max_threads = 4,
+	.ops_per_thread = 2000000,
+	.nr_ids = DS_ID_BITMAP_MAX_IDS,
+	.prefill_pct = 90,
+	.window = 32,
+};
+
+/* Baseline: the userspace mutex + free stack the bitmap replaces */
+struct mutex_pool {
+	pthread_mutex_t lock;
+	__u32 top;
+	__u32 *stack;
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	bool use_mutex;
+	struct ds_id_bitmap *ids;
+	struct mutex_pool *pool;
+	struct bench_barrier *barrier;
+	uint64_t ops;
+	uint64_t failures;
+	uint64_t elapsed_ns;
+};
+
+static struct ds_id_bitmap g_ids;
+
+static int mutex_acquire(struct mutex_pool *p, __u32 *id)
+{
+	int ret = DS_ERROR_FULL;
+
+	pthread_mutex_lock(&p->lock);
+	if (p->top) {
+		*id = p->stack[--p->top];
+		ret = DS_SUCCESS;
+	}
+	pthread_mutex_unlock(&p->lock);
+	return ret;
+}
+
+static void mutex_release(struct mutex_pool *p, __u32 id)
+{
+	pthread_mutex_lock(&p->lock);
+	p->stack[p->top++] = id;
+	pthread_mutex_unlock(&p->lock);
+}
+
+static int do_acquire(struct worker *w, __u32 *id)
+{
+	if (w->use_mutex)
+		return mutex_acquire(w->pool, id);
+	return ds_id_bitmap_acquire_c(w->ids, (__u32)w->id, id);
+}
+
+static void do_release(struct worker *w, __u32 id)
+{
+	if (w->use_mutex)
+		mutex_release(w->pool, id);
+	else if (ds_id_bitmap_release_c(w->ids, id) != DS_SUCCESS)
+		w->failures++;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	__u32 held[BENCH_MAX_WINDOW];
+	bool valid[BENCH_MAX_WINDOW] = {0};
+	uint64_t start;
+
+	bench_pin_cpu(w->id);
+	bench_barrier_wait(w->barrier);
+
+	start = bench_now_ns();
+	for (uint64_t i = 0; i < config.ops_per_thread; i++) {
+		unsigned int slot = (unsigned int)(i % config.window);
+
+		if (valid[slot])
+			do_release(w, held[slot]);
+		valid[slot] = do_acquire(w, &held[slot]) == DS_SUCCESS;
+		if (!valid[slot])
+			w->failures++;
+		w->ops++;
+	}
+	w->elapsed_ns = bench_now_ns() - start;
+
+	for (unsigned int s = 0; s < config.window; s++)
+		if (valid[s])
+			do_release(w, held[s]);
+
+	return NULL;
+}
+
+static double run_mode(int nr_threads, bool use_mutex, uint64_t *failures_out)
+{
+	struct worker workers[BENCH_MAX_THREADS] = {0};
+	struct bench_barrier barrier = { .total = nr_threads };
+	struct mutex_pool pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+	__u32 prefill = (__u32)((uint64_t)config.nr_ids * config.prefill_pct / 100);
+	uint64_t ops = 0, failures = 0, max_ns = 0;
+	__u32 id;
+
+	if (use_mutex) {
+		pool.stack = malloc(sizeof(*pool.stack) * config.nr_ids);
+		if (!pool.stack)
+			return -1.0;
+		/* Pre-filled IDs are simply absent from the stack */
+		for (__u32 i = config.nr_ids; i > prefill; i--)
+			pool.stack[pool.top++] = i - 1;
+	} else {
+		if (ds_id_bitmap_init_c(&g_ids, config.nr_ids) != DS_SUCCESS)
+			return -1.0;
+		for (__u32 i = 0; i < prefill; i++)
+			if (ds_id_bitmap_acquire_c(&g_ids, 0, &id) != DS_SUCCESS)
+				return -1.0;
+		/* Spread the hints again so workers do not all start on the fill edge */
+		for (__u32 c = 0; c < DS_ID_BITMAP_HINTS; c++)
+			g_ids.hints[c].leaf =
+				(__u32)(((__u64)c * g_ids.nr_leaves) / DS_ID_BITMAP_HINTS);
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].use_mutex = use_mutex;
+		workers[i].ids = &g_ids;
+		workers[i].pool = &pool;
+		workers[i].barrier = &barrier;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1.0;
+		}
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ops += workers[i].ops;
+		failures += workers[i].failures;
+		if (workers[i].elapsed_ns > max_ns)
+			max_ns = workers[i].elapsed_ns;
+	}
+
+	if (use_mutex) {
+		if (pool.top != config.nr_ids - prefill)
+			failures++;
+		free(pool.stack);
+	} else if (ds_id_bitmap_count_c(&g_ids) != prefill ||
+		   ds_id_bitmap_verify_c(&g_ids) != DS_SUCCESS) {
+		failures++;
+	}
+
+	*failures_out = failures;
+	return bench_mops(ops, max_ns);
+}
+
+static int run_one(int nr_threads)
+{
+	uint64_t bitmap_fail, mutex_fail;
+	double bitmap_mops, mutex_mops;
+
+	bitmap_mops = run_mode(nr_threads, false, &bitmap_fail);
+	mutex_mops = run_mode(nr_threads, true, &mutex_fail);
+	if (bitmap_mops < 0 || mutex_mops < 0)
+		return -1;
+
+	printf("%7d %12.2f %12.2f %8.2fx %10llu %7s\n",
+	       nr_threads, bitmap_mops, mutex_mops,
+	       mutex_mops > 0 ? bitmap_mops / mutex_mops : 0.0,
+	       (unsigned long long)bitmap_fail,
+	       bitmap_fail == 0 && mutex_fail == 0 ? "ok" : "FAIL");
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Hierarchical bitmap ID allocator acquire/release benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -t N    Max worker threads (default: %d)\n", config.max_threads);
+	printf("  -n N    Operations per thread (default: %llu)\n",
+	       (unsigned long long)config.ops_per_thread);
+	printf("  -c N    IDs in the pool, <= %u (default: %u)\n",
+	       DS_ID_BITMAP_MAX_IDS, config.nr_ids);
+	printf("  -f PCT  Percent of IDs held before the run (default: %u)\n", config.prefill_pct);
+	printf("  -w N    IDs each worker holds at once, <= %d (default: %u)\n",
+	       BENCH_MAX_WINDOW, config.window);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:c:f:w:h")) != -1) {
+		switch (opt) {
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 'n':
+			config.ops_per_thread = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.nr_ids = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			config.prefill_pct = (unsigned int)atoi(optarg);
+			break;
+		case 'w':
+			config.window = (unsigned int)atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_threads < 1 || config.max_threads > BENCH_MAX_THREADS ||
+	    !config.nr_ids || config.nr_ids > DS_ID_BITMAP_MAX_IDS ||
+	    config.prefill_pct >= 100 || config.window < 1 || config.window > BENCH_MAX_WINDOW) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  ID bitmap: ids=%u prefill=%u%% window=%u per thread\n",
+	       config.nr_ids, config.prefill_pct, config.window);
+	printf("  Mops/s counts one release+acquire pair per op\n");
+	bench_print_rule();
+	printf("%7s %12s %12s %9s %10s %7s\n",
+	       "Threads", "Bitmap Mops", "Mutex Mops", "Speedup", "Failures", "Verify");
+
+	for (int n = 1; n <= config.max_threads; n *= 2) {
+		if (run_one(n) < 0)
+			return 1;
+		if (n < config.max_threads && n * 2 > config.max_threads)
+			n = config.max_threads / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_kway_merge: per-CPU SPSC lanes + k-way merge vs one shared MPMC lane
+ *
+ * Each producer stamps CLOCK_MONOTONIC into the entry's value and inserts
+ * it into its own ds_ck_ring_spsc lane; one consumer merges the lanes with
+ * ds_kway_merge.h. The baseline sends the same stream through a single
+ * shared ds_vyukhov lane. Both report consumer throughput and ordering
+ * violations (entries older than one already delivered). The run is
+ * repeated for 1, 2, 4, ... up to -l lanes.
+ *
+ * The shared lane has the same -c capacity as one per-CPU lane.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_kway_merge.h"
+#include "ds_vyukhov.h"
+
+#define BENCH_POLL_BUDGET 256
+
+struct bench_config {
+	int max_lanes;
+	uint64_t items_per_lane;
+	__u32 lane_capacity;
+	uint64_t window_ns;
+};
+
+static struct bench_config config = {
+	.max_lanes = 4,
+	.items_per_lane = 1000000,
+	.lane_capacity = 128,
+	.window_ns = 1000000,
+};
+
+struct run {
+	bool merged;
+	int nr_lanes;
+	struct ds_ck_ring_spsc_head *lanes[DS_KWAY_MERGE_MAX_LANES];
+	struct ds_vyukhov_head *shared;
+	struct bench_barrier barrier;
+	_Atomic int producers_done;
+	uint64_t consumed;
+	uint64_t last_ts;
+	uint64_t violations;
+	uint64_t window_waits;
+	uint64_t elapsed_ns;
+};
+
+struct producer {
+	pthread_t thread;
+	int id;
+	struct run *r;
+};
+
+static void *producer_main(void *arg)
+{
+	struct producer *p = arg;
+	struct run *r = p->r;
+
+	bench_pin_cpu(p->id + 1);
+	bench_barrier_wait(&r->barrier);
+
+	for (uint64_t i = 0; i < config.items_per_lane; i++) {
+		__u64 key = ((__u64)p->id << 32) | i;
+
+		if (r->merged) {
+			while (ds_ck_ring_spsc_insert_c(r->lanes[p->id], key, bench_now_ns()) !=
+			       DS_SUCCESS)
+				sched_yield();
+		} else {
+			while (ds_vyukhov_insert_c(r->shared, key, bench_now_ns()) != DS_SUCCESS)
+				sched_yield();
+		}
+	}
+
+	atomic_fetch_add(&r->producers_done, 1);
+	return NULL;
+}
+
+static void count_entry(void *arg, __u32 lane, const struct ds_kv *kv)
+{
+	struct run *r = arg;
+
+	(void)lane;
+	if (kv->value < r->last_ts)
+		r->violations++;
+	else
+		r->last_ts = kv->value;
+	r->consumed++;
+}
+
+static void consume_merged(struct run *r)
+{
+	static struct ds_kway_merge m;
+
+	ds_kway_merge_init(&m, r->lanes, (__u32)r->nr_lanes, config.window_ns);
+	while (atomic_load_explicit(&r->producers_done, memory_order_relaxed) < r->nr_lanes)
+		if (!ds_kway_merge_poll(&m, bench_now_ns(), count_entry, r, BENCH_POLL_BUDGET))
+			sched_yield();
+	ds_kway_merge_flush(&m, count_entry, r);
+	r->window_waits = m.window_waits;
+}
+
+static void consume_shared(struct run *r)
+{
+	uint64_t total = config.items_per_lane * (uint64_t)r->nr_lanes;
+	struct ds_kv kv;
+
+	while (r->consumed < total) {
+		if (ds_vyukhov_pop_c(r->shared, &kv) == DS_SUCCESS)
+			count_entry(r, 0, &kv);
+		else
+			sched_yield();
+	}
+}
+
+static int run_one(int nr_lanes, bool merged, struct run *r)
+{
+	struct producer producers[BENCH_MAX_THREADS] = {0};
+	uint64_t start;
+
+	memset(r, 0, sizeof(*r));
+	r->merged = merged;
+	r->nr_lanes = nr_lanes;
+	r->barrier.total = nr_lanes + 1;
+
+	if (merged) {
+		for (int i = 0; i < nr_lanes; i++) {
+			r->lanes[i] = bpf_arena_alloc(sizeof(*r->lanes[i]));
+			if (!r->lanes[i] ||
+			    ds_ck_ring_spsc_init_c(r->lanes[i], config.lane_capacity) != DS_SUCCESS)
+				return -1;
+		}
+	} else {
+		r->shared = bpf_arena_alloc(sizeof(*r->shared));
+		if (!r->shared ||
+		    ds_vyukhov_init_c(r->shared, config.lane_capacity) != DS_SUCCESS)
+			return -1;
+	}
+
+	for (int i = 0; i < nr_lanes; i++) {
+		producers[i].id = i;
+		producers[i].r = r;
+		if (pthread_create(&producers[i].thread, NULL, producer_main, &producers[i]) != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	bench_pin_cpu(0);
+	bench_barrier_wait(&r->barrier);
+	start = bench_now_ns();
+	if (merged)
+		consume_merged(r);
+	else
+		consume_shared(r);
+	r->elapsed_ns = bench_now_ns() - start;
+
+	for (int i = 0; i < nr_lanes; i++)
+		pthread_join(producers[i].thread, NULL);
+
+	return r->consumed == config.items_per_lane * (uint64_t)nr_lanes ? 0 : -1;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Per-CPU lanes + k-way timestamp merge vs one shared MPMC lane\n\n");
+	printf("OPTIONS:\n");
+	printf("  -l N    Max lanes / producer threads (default: %d)\n", config.max_lanes);
+	printf("  -n N    Entries per producer (default: %llu)\n",
+	       (unsigned long long)config.items_per_lane);
+	printf("  -c N    Per-lane capacity, power of 2 (default: %u)\n", config.lane_capacity);
+	printf("  -w US   Reorder window in microseconds (default: %llu)\n",
+	       (unsigned long long)(config.window_ns / 1000));
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:n:c:w:h")) != -1) {
+		switch (opt) {
+		case 'l':
+			config.max_lanes = atoi(optarg);
+			break;
+		case 'n':
+			config.items_per_lane = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.lane_capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			config.window_ns = strtoull(optarg, NULL, 0) * 1000ull;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_lanes < 1 || config.max_lanes > DS_KWAY_MERGE_MAX_LANES ||
+	    config.max_lanes >= BENCH_MAX_THREADS ||
+	    !ds_ck_ring_spsc_is_power_of_two(config.lane_capacity)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct run merged, shared;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  K-way merge: entries=%llu per lane, capacity=%u, window=%llu us\n",
+	       (unsigned long long)config.items_per_lane, config.lane_capacity,
+	       (unsigned long long)(config.window_ns / 1000));
+	bench_print_rule();
+	printf("%5s %11s %11s %10s %12s %12s\n",
+	       "Lanes", "Merge Mops", "MPMC Mops", "Merge Viol", "MPMC Viol", "WindowWaits");
+
+	for (int n = 1; n <= config.max_lanes; n *= 2) {
+		if (run_one(n, true, &merged) < 0 || run_one(n, false, &shared) < 0) {
+			fprintf(stderr, "bench_kway_merge: lost entries\n");
+			return 1;
+		}
+
+		printf("%5d %11.2f %11.2f %10llu %12llu %12llu\n", n,
+		       bench_mops(merged.consumed, merged.elapsed_ns),
+		       bench_mops(shared.consumed, shared.elapsed_ns),
+		       (unsigned long long)merged.violations,
+		       (unsigned long long)shared.violations,
+		       (unsigned long long)merged.window_waits);
+
+		if (n < config.max_lanes && n * 2 > config.max_lanes)
+			n = config.max_lanes / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_lru: hit-ratio and throughput benchmark for ds_lru.h
+ *
+ * Each worker runs a read-through cache loop: look the key up, and on a
+ * miss insert it (evicting via CLOCK when the set is full). Keys follow a
+ * hot/cold split: -H percent of accesses go to the first -W percent of
+ * the key space. The run is repeated for 1, 2, 4, ... up to -t threads.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_lru.h"
+
+struct bench_config {
+	int max_threads;
+	uint64_t ops_per_thread;
+	__u32 capacity;
+	uint64_t key_space;
+	unsigned int hot_access_pct;
+	unsigned int hot_key_pct;
+};
+
+static struct bench_config config = {
+	.max_threads = 4,
+	.ops_per_thread = 2000000,
+	.capacity = 256,
+	.key_space = 2048,
+	.hot_access_pct = 80,
+	.hot_key_pct = 10,
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	struct ds_lru_head *cache;
+	struct bench_barrier *barrier;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t insert_failures;
+	uint64_t elapsed_ns;
+};
+
+static uint64_t next_key(uint64_t *rng)
+{
+	uint64_t hot_keys = config.key_space * config.hot_key_pct / 100;
+	uint64_t r = bench_rand(rng);
+
+	if (hot_keys == 0)
+		hot_keys = 1;
+	if (r % 100 < config.hot_access_pct)
+		return bench_rand(rng) % hot_keys;
+	return hot_keys + bench_rand(rng) % (config.key_space - hot_keys);
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	uint64_t rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(w->id + 1);
+	uint64_t start;
+
+	bench_pin_cpu(w->id);
+	bench_barrier_wait(w->barrier);
+
+	start = bench_now_ns();
+	for (uint64_t i = 0; i < config.ops_per_thread; i++) {
+		uint64_t key = next_key(&rng);
+		__u64 value;
+
+		if (ds_lru_lookup_c(w->cache, key, &value) == DS_SUCCESS) {
+			w->hits++;
+			continue;
+		}
+
+		w->misses++;
+		if (ds_lru_insert_c(w->cache, key, key) != DS_SUCCESS)
+			w->insert_failures++;
+	}
+	w->elapsed_ns = bench_now_ns() - start;
+
+	return NULL;
+}
+
+static int run_one(int nr_threads)
+{
+	struct worker workers[BENCH_MAX_THREADS] = {0};
+	struct bench_barrier barrier = { .total = nr_threads };
+	struct ds_lru_head *cache;
+	uint64_t hits = 0, misses = 0, failures = 0, max_ns = 0;
+	uint64_t total_ops;
+	int ret;
+
+	cache = bpf_arena_alloc(sizeof(*cache));
+	if (!cache)
+		return -1;
+
+	ret = ds_lru_init_c(cache, config.capacity);
+	if (ret != DS_SUCCESS) {
+		fprintf(stderr, "bench_lru: init failed (%d)\n", ret);
+		return -1;
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].cache = cache;
+		workers[i].barrier = &barrier;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		hits += workers[i].hits;
+		misses += workers[i].misses;
+		failures += workers[i].insert_failures;
+		if (workers[i].elapsed_ns > max_ns)
+			max_ns = workers[i].elapsed_ns;
+	}
+
+	total_ops = hits + misses;
+	printf("%7d %10.2f %8.2f%% %12llu %10llu %8.1f %7s\n",
+	       nr_threads,
+	       bench_mops(total_ops, max_ns),
+	       total_ops ? (double)hits * 100.0 / (double)total_ops : 0.0,
+	       (unsigned long long)arena_atomic_load(&cache->evictions, ARENA_RELAXED),
+	       (unsigned long long)failures,
+	       total_ops ? (double)max_ns * nr_threads / (double)total_ops : 0.0,
+	       ds_lru_verify_c(cache) == DS_SUCCESS ? "ok" : "FAIL");
+
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("CLOCK LRU cache hit-ratio / throughput benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -t N    Max worker threads (default: %d)\n", config.max_threads);
+	printf("  -n N    Operations per thread (default: %llu)\n",
+	       (unsigned long long)config.ops_per_thread);
+	printf("  -c N    Cache capacity, power of 2 (default: %u)\n", config.capacity);
+	printf("  -k N    Key space (default: %llu)\n", (unsigned long long)config.key_space);
+	printf("  -H PCT  Percent of accesses to hot keys (default: %u)\n", config.hot_access_pct);
+	printf("  -W PCT  Percent of keys that are hot (default: %u)\n", config.hot_key_pct);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:c:k:H:W:h")) != -1) {
+		switch (opt) {
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 'n':
+			config.ops_per_thread = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			config.key_space = strtoull(optarg, NULL, 0);
+			break;
+		case 'H':
+			config.hot_access_pct = (unsigned int)atoi(optarg);
+			break;
+		case 'W':
+			config.hot_key_pct = (unsigned int)atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_threads < 1 || config.max_threads > BENCH_MAX_THREADS ||
+	    config.key_space < 2 || config.hot_access_pct > 100 || config.hot_key_pct >= 100) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  CLOCK LRU: capacity=%u keys=%llu hot=%u%% of keys get %u%% of accesses\n",
+	       config.capacity, (unsigned long long)config.key_space,
+	       config.hot_key_pct, config.hot_access_pct);
+	bench_print_rule();
+	printf("%7s %10s %9s %12s %10s %8s %7s\n",
+	       "Threads", "Mops/s", "Hit%", "Evictions", "InsFail", "ns/op", "Verify");
+
+	for (int n = 1; n <= config.max_threads; n *= 2) {
+		if (run_one(n) < 0)
+			return 1;
+		if (n < config.max_threads && n * 2 > config.max_threads)
+			n = config.max_threads / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
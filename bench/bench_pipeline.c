@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_pipeline: per-stage cost and end-to-end throughput of ds_pipeline.h
+ *
+ * A producer thread stamps CLOCK_MONOTONIC into each entry and feeds the
+ * source ring. The entries then pass through S stages. Each stage does -w
+ * rounds of synthetic work per entry, and the last stage records
+ * end-to-end latency. The same work runs twice:
+ *   - pipeline: one pinned thread per stage, linked by arena SPSC rings
+ *     with -b entries per handoff
+ *   - inline: one relay thread runs all S stages back to back (the
+ *     single-stage relay every skeleton uses today)
+ * The run is repeated for 1, 2, 4, ... up to -s stages, and the per-stage
+ * report for the largest pipeline is printed at the end.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_pipeline.h"
+
+#define BENCH_LAT_BUCKETS 40
+
+struct bench_config {
+	int max_stages;
+	uint64_t items;
+	__u32 batch;
+	__u32 capacity;
+	unsigned int work;
+};
+
+static struct bench_config config = {
+	.max_stages = 4,
+	.items = 2000000,
+	.batch = 32,
+	.capacity = 128,
+	.work = 64,
+};
+
+struct run {
+	bool pipelined;
+	int nr_stages;
+	struct ds_ck_ring_spsc_head *in;
+	struct ds_pipeline pipe;
+	struct bench_barrier barrier;
+	_Atomic int producer_done;
+	uint64_t consumed;
+	uint64_t lat_sum_ns;
+	uint64_t lat_hist[BENCH_LAT_BUCKETS];
+	uint64_t elapsed_ns;
+};
+
+/* Synthetic per-entry work: -w rounds of xorshift, folded into the entry */
+static inline void do_work(struct ds_kv *kv)
+{
+	uint64_t x = kv->key | 1;
+
+	for (unsigned int i = 0; i < config.work; i++)
+		x = bench_rand(&x) | 1;
+	kv->key ^= x & 0xff00000000000000ull;
+}
+
+static void record_latency(struct run *r, const struct ds_kv *kv)
+{
+	uint64_t lat = bench_now_ns() - kv->value;
+	unsigned int b = lat ? 63 - (unsigned int)__builtin_clzll(lat) : 0;
+
+	r->lat_sum_ns += lat;
+	r->lat_hist[b < BENCH_LAT_BUCKETS ? b : BENCH_LAT_BUCKETS - 1]++;
+	r->consumed++;
+}
+
+static int work_stage(void *arg, struct ds_kv *kv)
+{
+	(void)arg;
+	do_work(kv);
+	return DS_PIPELINE_FORWARD;
+}
+
+static int last_stage(void *arg, struct ds_kv *kv)
+{
+	do_work(kv);
+	record_latency(arg, kv);
+	return DS_PIPELINE_FORWARD;
+}
+
+static void *producer_main(void *arg)
+{
+	struct run *r = arg;
+	struct ds_kv buf[DS_PIPELINE_MAX_BATCH];
+	uint64_t sent = 0;
+
+	bench_pin_cpu(0);
+	bench_barrier_wait(&r->barrier);
+
+	while (sent < config.items) {
+		__u32 n = config.batch;
+		__u32 k;
+
+		if (config.items - sent < n)
+			n = (__u32)(config.items - sent);
+		for (__u32 i = 0; i < n; i++) {
+			buf[i].key = sent + i;
+			buf[i].value = bench_now_ns();
+		}
+		for (__u32 off = 0; off < n; off += k) {
+			k = ds_ck_ring_spsc_insert_batch_c(r->in, buf + off, n - off);
+			if (!k)
+				sched_yield();
+		}
+		sent += n;
+	}
+
+	atomic_store_explicit(&r->producer_done, 1, memory_order_release);
+	ds_pipeline_close_input(&r->pipe);
+	return NULL;
+}
+
+/* Baseline: the whole chain on one relay thread */
+static void relay_inline(struct run *r)
+{
+	struct ds_kv buf[DS_PIPELINE_MAX_BATCH];
+
+	bench_pin_cpu(1);
+	for (;;) {
+		__u32 n = ds_ck_ring_spsc_delete_batch_c(r->in, buf, config.batch);
+
+		if (!n) {
+			if (atomic_load_explicit(&r->producer_done, memory_order_acquire) &&
+			    ds_ck_ring_spsc_is_empty_c(r->in))
+				break;
+			sched_yield();
+			continue;
+		}
+		for (__u32 i = 0; i < n; i++) {
+			for (int s = 0; s + 1 < r->nr_stages; s++)
+				do_work(&buf[i]);
+			last_stage(r, &buf[i]);
+		}
+	}
+}
+
+static int run_one(int nr_stages, bool pipelined, struct run *r)
+{
+	pthread_t producer;
+	uint64_t start;
+
+	memset(r, 0, sizeof(*r));
+	r->pipelined = pipelined;
+	r->nr_stages = nr_stages;
+	r->barrier.total = 2;
+
+	r->in = bpf_arena_alloc(sizeof(*r->in));
+	if (!r->in || ds_ck_ring_spsc_init_c(r->in, config.capacity) != DS_SUCCESS)
+		return -1;
+	if (ds_pipeline_init(&r->pipe, r->in, NULL, config.capacity, config.batch) != DS_SUCCESS)
+		return -1;
+
+	if (pipelined) {
+		for (int s = 0; s < nr_stages; s++) {
+			bool last = s + 1 == nr_stages;
+
+			if (ds_pipeline_add_stage(&r->pipe, last ? "sink" : "work",
+						  last ? last_stage : work_stage, r,
+						  s + 1) != DS_SUCCESS)
+				return -1;
+		}
+		if (ds_pipeline_start(&r->pipe) != DS_SUCCESS)
+			return -1;
+	}
+
+	if (pthread_create(&producer, NULL, producer_main, r) != 0) {
+		perror("pthread_create");
+		return -1;
+	}
+
+	bench_barrier_wait(&r->barrier);
+	start = bench_now_ns();
+	if (pipelined)
+		ds_pipeline_wait(&r->pipe);
+	else
+		relay_inline(r);
+	r->elapsed_ns = bench_now_ns() - start;
+	pthread_join(producer, NULL);
+
+	return r->consumed == config.items ? 0 : -1;
+}
+
+static uint64_t lat_p99_ns(const struct run *r)
+{
+	uint64_t rank = (r->consumed * 99 + 99) / 100, seen = 0;
+
+	for (int b = 0; b < BENCH_LAT_BUCKETS; b++) {
+		seen += r->lat_hist[b];
+		if (seen >= rank)
+			return (2ull << b) - 1;
+	}
+	return ~0ull;
+}
+
+static double stage_ns_max(const struct run *r)
+{
+	double worst = 0.0;
+
+	for (__u32 s = 0; s < r->pipe.nr_stages; s++) {
+		const struct ds_pipeline_stage_stats *st = &r->pipe.stages[s].stats;
+		double ns = st->items_in ? (double)st->service_ns / (double)st->items_in : 0.0;
+
+		if (ns > worst)
+			worst = ns;
+	}
+	return worst;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Multi-stage pipeline vs single-thread relay benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -s N    Max stages, <= %d (default: %d)\n", DS_PIPELINE_MAX_STAGES,
+	       config.max_stages);
+	printf("  -n N    Entries per run (default: %llu)\n", (unsigned long long)config.items);
+	printf("  -b N    Entries per handoff, <= %d (default: %u)\n", DS_PIPELINE_MAX_BATCH,
+	       config.batch);
+	printf("  -c N    Ring capacity, power of 2 (default: %u)\n", config.capacity);
+	printf("  -w N    Work rounds per entry per stage (default: %u)\n", config.work);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:n:b:c:w:h")) != -1) {
+		switch (opt) {
+		case 's':
+			config.max_stages = atoi(optarg);
+			break;
+		case 'n':
+			config.items = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			config.batch = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			config.work = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_stages < 1 || config.max_stages > DS_PIPELINE_MAX_STAGES ||
+	    !config.items || !config.batch || config.batch > DS_PIPELINE_MAX_BATCH ||
+	    !ds_ck_ring_spsc_is_power_of_two(config.capacity)) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct run piped, inl;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Pipeline: entries=%llu batch=%u capacity=%u work=%u rounds/stage\n",
+	       (unsigned long long)config.items, config.batch, config.capacity, config.work);
+	printf("  Latency is producer stamp -> last stage, end to end\n");
+	bench_print_rule();
+	printf("%6s %10s %11s %11s %11s %12s %11s\n",
+	       "Stages", "Pipe Mops", "Inline Mops", "Stage ns/op", "Pipe p99us",
+	       "Inline p99us", "Pipe avg us");
+
+	for (int n = 1; n <= config.max_stages; n *= 2) {
+		if (run_one(n, true, &piped) < 0 || run_one(n, false, &inl) < 0) {
+			fprintf(stderr, "bench_pipeline: lost entries\n");
+			return 1;
+		}
+
+		printf("%6d %10.2f %11.2f %11.1f %11.1f %12.1f %11.1f\n", n,
+		       bench_mops(piped.consumed, piped.elapsed_ns),
+		       bench_mops(inl.consumed, inl.elapsed_ns),
+		       stage_ns_max(&piped),
+		       (double)lat_p99_ns(&piped) / 1e3,
+		       (double)lat_p99_ns(&inl) / 1e3,
+		       (double)piped.lat_sum_ns / (double)piped.consumed / 1e3);
+
+		if (n < config.max_stages && n * 2 > config.max_stages)
+			n = config.max_stages / 2;
+	}
+
+	bench_print_rule();
+	printf("  Per-stage report, %u stages\n", piped.pipe.nr_stages);
+	bench_print_rule();
+	ds_pipeline_print(&piped.pipe);
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
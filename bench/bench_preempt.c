@@ -0,0 +1,486 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_preempt: MPMC throughput and tail latency under preemption
+ *
+ * Every worker repeats one insert followed by one pop on a shared
+ * structure, retrying each until it succeeds, and records the latency of
+ * the pair. Each structure runs in up to four modes:
+ *   - fit:      one worker per online CPU
+ *   - oversub:  -o workers per CPU, left to the scheduler
+ *   - inject:   oversub, plus DS_PREEMPT_POINT() yielding (or sleeping
+ *               -S us) with probability -p ppm inside the _c load-CAS
+ *               windows and claim-to-publish windows
+ *   - fifo:     inject, plus -f SCHED_FIFO hogs that spin -H us out of
+ *               every -P us on their CPU (skipped without CAP_SYS_NICE)
+ * A lock-free structure loses throughput in oversub/inject but its p99
+ * stays near the time slice. A structure where a preempted thread holds
+ * others up (the Vyukhov claim-to-publish window) shows it in p99.9/max.
+ *
+ * ck_stack_upmc pops never free their entry (freeing would reintroduce
+ * ABA), so its runs leak one entry per pair into the bench arena.
+ */
+static void bench_preempt_point(void);
+#define DS_PREEMPT_POINT() bench_preempt_point()
+
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_ck_stack_upmc.h"
+#include "ds_msqueue.h"
+#include "ds_vyukhov.h"
+
+#define BENCH_LAT_BUCKETS 40
+#define BENCH_VYUKHOV_CAPACITY 128u
+
+enum bench_mode {
+	MODE_FIT,
+	MODE_OVERSUB,
+	MODE_INJECT,
+	MODE_FIFO,
+	NUM_MODES,
+};
+
+static const char *const mode_names[NUM_MODES] = { "fit", "oversub", "inject", "fifo" };
+
+struct bench_config {
+	int oversub;
+	uint64_t pairs_per_thread;
+	unsigned int preempt_ppm;
+	unsigned int sleep_us;
+	int fifo_hogs;
+	unsigned int hog_on_us;
+	unsigned int hog_period_us;
+	const char *only;
+};
+
+static struct bench_config config = {
+	.oversub = 4,
+	.pairs_per_thread = 50000,
+	.preempt_ppm = 10000,
+	.sleep_us = 0,
+	.fifo_hogs = 0,
+	.hog_on_us = 2000,
+	.hog_period_us = 10000,
+	.only = NULL,
+};
+
+/* Injection state: read by DS_PREEMPT_POINT() in every worker */
+static _Atomic bool inject_on;
+static __thread uint64_t inject_rng;
+static __thread uint64_t injected;
+
+static void bench_preempt_point(void)
+{
+	if (!atomic_load_explicit(&inject_on, memory_order_relaxed))
+		return;
+	if (bench_rand(&inject_rng) % 1000000 >= config.preempt_ppm)
+		return;
+
+	injected++;
+	if (config.sleep_us)
+		usleep(config.sleep_us);
+	else
+		sched_yield();
+}
+
+/* ========================================================================
+ * Structures under test
+ * ======================================================================== */
+
+union bench_head {
+	struct ds_vyukhov_head vyukhov;
+	struct ds_msqueue msqueue;
+	struct ds_ck_stack_upmc_head stack;
+};
+
+struct bench_ds {
+	const char *name;
+	int (*init)(union bench_head *h);
+	int (*insert)(union bench_head *h, __u64 key, __u64 value);
+	int (*pop)(union bench_head *h, struct ds_kv *kv);
+	void (*fini)(union bench_head *h);
+};
+
+static int vyukhov_init(union bench_head *h)
+{
+	return ds_vyukhov_init_c(&h->vyukhov, BENCH_VYUKHOV_CAPACITY);
+}
+
+static int vyukhov_insert(union bench_head *h, __u64 key, __u64 value)
+{
+	return ds_vyukhov_insert_c(&h->vyukhov, key, value);
+}
+
+static int vyukhov_pop(union bench_head *h, struct ds_kv *kv)
+{
+	return ds_vyukhov_pop_c(&h->vyukhov, kv);
+}
+
+static void vyukhov_fini(union bench_head *h)
+{
+	ds_arena_free_array(h->vyukhov.buffer, BENCH_VYUKHOV_CAPACITY * sizeof(struct ds_vyukhov_node));
+}
+
+static int msqueue_init(union bench_head *h)
+{
+	return ds_msqueue_init_c(&h->msqueue);
+}
+
+static int msqueue_insert(union bench_head *h, __u64 key, __u64 value)
+{
+	return ds_msqueue_insert_c(&h->msqueue, key, value);
+}
+
+static int msqueue_pop(union bench_head *h, struct ds_kv *kv)
+{
+	return ds_msqueue_pop_c(&h->msqueue, kv);
+}
+
+static void msqueue_fini(union bench_head *h)
+{
+	bpf_arena_free(h->msqueue.head);
+}
+
+static int stack_init(union bench_head *h)
+{
+	ds_ck_stack_upmc_init_c(&h->stack);
+	return DS_SUCCESS;
+}
+
+static int stack_insert(union bench_head *h, __u64 key, __u64 value)
+{
+	return ds_ck_stack_upmc_insert_c(&h->stack, key, value);
+}
+
+static int stack_pop(union bench_head *h, struct ds_kv *kv)
+{
+	return ds_ck_stack_upmc_pop_c(&h->stack, kv);
+}
+
+static void stack_fini(union bench_head *h)
+{
+	(void)h;
+}
+
+static const struct bench_ds structures[] = {
+	{ "vyukhov", vyukhov_init, vyukhov_insert, vyukhov_pop, vyukhov_fini },
+	{ "msqueue", msqueue_init, msqueue_insert, msqueue_pop, msqueue_fini },
+	{ "ck_stack_upmc", stack_init, stack_insert, stack_pop, stack_fini },
+};
+
+/* ========================================================================
+ * Workers and hogs
+ * ======================================================================== */
+
+struct worker {
+	pthread_t thread;
+	int id;
+	const struct bench_ds *ds;
+	union bench_head *head;
+	pthread_barrier_t *barrier;
+	uint64_t lat_hist[BENCH_LAT_BUCKETS];
+	uint64_t max_ns;
+	uint64_t busy;		/* attempts that did not complete the op */
+	uint64_t injected;
+	uint64_t sum;
+	uint64_t elapsed_ns;
+};
+
+struct hog {
+	pthread_t thread;
+	int cpu;
+	_Atomic bool *stop;
+};
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct ds_kv kv;
+	uint64_t start, t0, lat;
+	unsigned int b;
+
+	inject_rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(w->id + 1);
+	injected = 0;
+
+	/* Oversubscribed workers are left unpinned: placement is the scheduler's */
+	pthread_barrier_wait(w->barrier);
+	start = bench_now_ns();
+
+	for (uint64_t i = 0; i < config.pairs_per_thread; i++) {
+		t0 = bench_now_ns();
+		while (w->ds->insert(w->head, i, i + 1) != DS_SUCCESS) {
+			w->busy++;
+			sched_yield();
+		}
+		while (w->ds->pop(w->head, &kv) != DS_SUCCESS) {
+			w->busy++;
+			sched_yield();
+		}
+		w->sum += kv.value - kv.key;
+
+		lat = bench_now_ns() - t0;
+		b = lat ? 63 - (unsigned int)__builtin_clzll(lat) : 0;
+		w->lat_hist[b < BENCH_LAT_BUCKETS ? b : BENCH_LAT_BUCKETS - 1]++;
+		if (lat > w->max_ns)
+			w->max_ns = lat;
+	}
+
+	w->elapsed_ns = bench_now_ns() - start;
+	w->injected = injected;
+	return NULL;
+}
+
+static void *hog_main(void *arg)
+{
+	struct hog *h = arg;
+	uint64_t until;
+
+	bench_pin_cpu(h->cpu);
+	while (!atomic_load_explicit(h->stop, memory_order_relaxed)) {
+		until = bench_now_ns() + (uint64_t)config.hog_on_us * 1000;
+		while (bench_now_ns() < until)
+			;
+		usleep(config.hog_period_us - config.hog_on_us);
+	}
+	return NULL;
+}
+
+/* Returns: hogs started, or -1 if SCHED_FIFO is not permitted */
+static int start_hogs(struct hog *hogs, _Atomic bool *stop)
+{
+	struct sched_param sp = { .sched_priority = 1 };
+	pthread_attr_t attr;
+	int started = 0;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &sp);
+
+	for (int i = 0; i < config.fifo_hogs; i++) {
+		hogs[i].cpu = i;
+		hogs[i].stop = stop;
+		if (pthread_create(&hogs[i].thread, &attr, hog_main, &hogs[i]) != 0)
+			break;
+		started++;
+	}
+	pthread_attr_destroy(&attr);
+
+	if (!started)
+		return -1;
+	return started;
+}
+
+static void stop_hogs(struct hog *hogs, int started, _Atomic bool *stop)
+{
+	atomic_store_explicit(stop, true, memory_order_relaxed);
+	for (int i = 0; i < started; i++)
+		pthread_join(hogs[i].thread, NULL);
+}
+
+/* ========================================================================
+ * Runs
+ * ======================================================================== */
+
+static double hist_percentile_us(const uint64_t *hist, uint64_t total, unsigned int permille)
+{
+	uint64_t rank = (total * permille + 999) / 1000, seen = 0;
+
+	for (int b = 0; b < BENCH_LAT_BUCKETS; b++) {
+		seen += hist[b];
+		if (seen >= rank)
+			return (double)((2ull << b) - 1) / 1e3;
+	}
+	return (double)~0ull;
+}
+
+static int run_one(const struct bench_ds *ds, enum bench_mode mode)
+{
+	int nr_threads = bench_nr_cpus() * (mode == MODE_FIT ? 1 : config.oversub);
+	struct hog hogs[BENCH_MAX_THREADS];
+	_Atomic bool hogs_stop = false;
+	struct worker *workers;
+	pthread_barrier_t barrier;
+	uint64_t hist[BENCH_LAT_BUCKETS] = {0};
+	uint64_t max_ns = 0, elapsed = 0, busy = 0, inj = 0, sum = 0;
+	uint64_t pairs = config.pairs_per_thread * (uint64_t)nr_threads;
+	union bench_head *head;
+	int nr_hogs = 0;
+
+	if (nr_threads > BENCH_MAX_THREADS)
+		nr_threads = BENCH_MAX_THREADS;
+
+	if (mode == MODE_FIFO) {
+		nr_hogs = start_hogs(hogs, &hogs_stop);
+		if (nr_hogs < 0) {
+			printf("%-14s %-8s %s\n", ds->name, mode_names[mode],
+			       "skipped: SCHED_FIFO not permitted (needs CAP_SYS_NICE)");
+			return 0;
+		}
+	}
+
+	head = calloc(1, sizeof(*head));
+	workers = calloc((size_t)nr_threads, sizeof(*workers));
+	if (!head || !workers || ds->init(head) != DS_SUCCESS) {
+		fprintf(stderr, "bench_preempt: %s init failed\n", ds->name);
+		return -1;
+	}
+
+	atomic_store(&inject_on, mode >= MODE_INJECT);
+	pthread_barrier_init(&barrier, NULL, (unsigned int)nr_threads);
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].ds = ds;
+		workers[i].head = head;
+		workers[i].barrier = &barrier;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		for (int b = 0; b < BENCH_LAT_BUCKETS; b++)
+			hist[b] += workers[i].lat_hist[b];
+		if (workers[i].max_ns > max_ns)
+			max_ns = workers[i].max_ns;
+		if (workers[i].elapsed_ns > elapsed)
+			elapsed = workers[i].elapsed_ns;
+		busy += workers[i].busy;
+		inj += workers[i].injected;
+		sum += workers[i].sum;
+	}
+
+	if (nr_hogs > 0)
+		stop_hogs(hogs, nr_hogs, &hogs_stop);
+	atomic_store(&inject_on, false);
+	pthread_barrier_destroy(&barrier);
+
+	/* Every pair moves one item with value = key + 1 */
+	printf("%-14s %-8s %7d %9.2f %9.1f %9.1f %9.1f %9.1f %10llu %9llu %6s\n",
+	       ds->name, mode_names[mode], nr_threads, bench_mops(pairs, elapsed),
+	       hist_percentile_us(hist, pairs, 500), hist_percentile_us(hist, pairs, 990),
+	       hist_percentile_us(hist, pairs, 999), (double)max_ns / 1e3,
+	       (unsigned long long)inj, (unsigned long long)busy,
+	       sum == pairs ? "ok" : "FAIL");
+
+	ds->fini(head);
+	free(workers);
+	free(head);
+	return sum == pairs ? 0 : -1;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Throughput and tail latency with more threads than CPUs\n\n");
+	printf("OPTIONS:\n");
+	printf("  -s NAME   Only this structure: vyukhov, msqueue, ck_stack_upmc (default: all)\n");
+	printf("  -o N      Workers per CPU when oversubscribed (default: %d)\n", config.oversub);
+	printf("  -n N      Insert+pop pairs per worker (default: %llu)\n",
+	       (unsigned long long)config.pairs_per_thread);
+	printf("  -p PPM    Preemption point probability, per million (default: %u)\n",
+	       config.preempt_ppm);
+	printf("  -S US     Sleep this long at a preemption point instead of yielding\n");
+	printf("  -f N      SCHED_FIFO hog threads, one per CPU from 0 (default: %d = no fifo mode)\n",
+	       config.fifo_hogs);
+	printf("  -H US     Hog spin time per period (default: %u)\n", config.hog_on_us);
+	printf("  -P US     Hog period (default: %u)\n", config.hog_period_us);
+	printf("  -h        Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "s:o:n:p:S:f:H:P:h")) != -1) {
+		switch (opt) {
+		case 's':
+			config.only = optarg;
+			break;
+		case 'o':
+			config.oversub = atoi(optarg);
+			break;
+		case 'n':
+			config.pairs_per_thread = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			config.preempt_ppm = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			config.sleep_us = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'f':
+			config.fifo_hogs = atoi(optarg);
+			break;
+		case 'H':
+			config.hog_on_us = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			config.hog_period_us = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	/* Hogs must leave the CPU idle part of every period */
+	if (config.oversub < 1 || !config.pairs_per_thread || config.preempt_ppm > 1000000 ||
+	    config.fifo_hogs < 0 || config.fifo_hogs > bench_nr_cpus() ||
+	    config.hog_on_us >= config.hog_period_us) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	bool matched = false;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Preemption: %d CPUs, %dx oversubscribed, %llu pairs per worker\n",
+	       bench_nr_cpus(), config.oversub, (unsigned long long)config.pairs_per_thread);
+	printf("  inject: %u ppm %s; fifo: %d hogs spinning %u of every %u us\n",
+	       config.preempt_ppm, config.sleep_us ? "sleep" : "yield", config.fifo_hogs,
+	       config.hog_on_us, config.hog_period_us);
+	printf("  Latency is per insert+pop pair in us (log2 buckets, upper bound)\n");
+	bench_print_rule();
+	printf("%-14s %-8s %7s %9s %9s %9s %9s %9s %10s %9s %6s\n",
+	       "Structure", "Mode", "Threads", "Mops/s", "p50", "p99", "p99.9", "max",
+	       "Injected", "Busy", "Verify");
+
+	for (size_t s = 0; s < sizeof(structures) / sizeof(structures[0]); s++) {
+		if (config.only && strcmp(config.only, structures[s].name) != 0)
+			continue;
+		matched = true;
+		for (int m = 0; m < NUM_MODES; m++) {
+			if (m == MODE_FIFO && !config.fifo_hogs)
+				continue;
+			if (run_one(&structures[s], (enum bench_mode)m) < 0)
+				return 1;
+		}
+	}
+
+	bench_print_rule();
+	if (!matched) {
+		fprintf(stderr, "bench_preempt: unknown structure '%s'\n", config.only);
+		return 1;
+	}
+	bench_env_end();
+	return 0;
+}
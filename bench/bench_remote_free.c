@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_remote_free: cross-CPU free cost, in place vs deferred lists
+ *
+ * The relay shape: a producer pinned to one CPU allocates objects with
+ * bpf_arena_alloc() and hands them over an SPSC ring to a consumer pinned
+ * to another CPU, which frees them. Each object size runs two ways:
+ *
+ *   in place   the consumer's bpf_arena_free() decrements the page footer
+ *              the producer is incrementing, so the line bounces.
+ *   deferred   the consumer pushes the object onto the producer's remote
+ *              list (bpf_arena_remote_push(), what a kernel-side free of a
+ *              userspace object does under ARENA_REMOTE_FREE), and the
+ *              producer takes the list back on its next allocation.
+ *
+ * Reported per run: end-to-end frees/s, producer ns per alloc, consumer ns
+ * per free, average objects per drain, and footer updates per object.
+ * Pages come from a ds_page_owner map over a 16 MB region, so freed pages
+ * are reused and any run length fits.
+ */
+#define ARENA_PAGE_OWNER
+#define ARENA_REMOTE_FREE
+
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_page_owner.h"
+#include "ds_ck_ring_spsc.h"
+
+#define BENCH_RING_CAPACITY 1024u
+#define BENCH_MAX_BATCH 256
+
+static const unsigned int sizes[] = { 16, 64, 256, 1024 };
+
+struct bench_config {
+	uint64_t ops;
+	__u32 batch;
+	int prod_cpu;
+	int cons_cpu;
+};
+
+static struct bench_config config = {
+	.ops = 2000000,
+	.batch = 32,
+	.prod_cpu = 0,
+	.cons_cpu = 1,
+};
+
+/* Stands in for the BPF program's arena globals */
+struct bench_shared {
+	struct ds_page_owner owner;
+	struct arena_remote_free remote;
+};
+
+static struct bench_shared *shared;
+
+struct run {
+	struct ds_ck_ring_spsc_head ring;
+	unsigned int size;
+	bool deferred;
+	pthread_barrier_t barrier;
+	uint64_t alloc_ns;
+	uint64_t free_ns;
+	uint64_t elapsed_ns;
+	uint64_t sum;
+};
+
+static void *producer_main(void *arg)
+{
+	struct run *r = arg;
+	struct ds_kv out[BENCH_MAX_BATCH];
+	uint64_t done = 0, t0;
+
+	bench_pin_cpu(config.prod_cpu);
+	pthread_barrier_wait(&r->barrier);
+
+	while (done < config.ops) {
+		__u32 n = config.batch, sent = 0;
+
+		if (n > config.ops - done)
+			n = (__u32)(config.ops - done);
+
+		t0 = bench_now_ns();
+		for (__u32 i = 0; i < n; i++) {
+			uint64_t *obj;
+
+			while (!(obj = bpf_arena_alloc(r->size)))
+				sched_yield();
+			obj[0] = done + i + 1;
+			out[i].key = (__u64)(uintptr_t)obj;
+			out[i].value = 0;
+		}
+		r->alloc_ns += bench_now_ns() - t0;
+
+		while (sent < n)
+			sent += ds_ck_ring_spsc_insert_batch_c(&r->ring, out + sent, n - sent);
+		done += n;
+	}
+	return NULL;
+}
+
+static void *consumer_main(void *arg)
+{
+	struct run *r = arg;
+	struct ds_kv in[BENCH_MAX_BATCH];
+	uint64_t done = 0, t0, start;
+
+	bench_pin_cpu(config.cons_cpu);
+	pthread_barrier_wait(&r->barrier);
+	start = bench_now_ns();
+
+	while (done < config.ops) {
+		__u32 n = ds_ck_ring_spsc_delete_batch_c(&r->ring, in, config.batch);
+
+		if (!n) {
+			sched_yield();
+			continue;
+		}
+
+		t0 = bench_now_ns();
+		for (__u32 i = 0; i < n; i++) {
+			uint64_t *obj = (uint64_t *)(uintptr_t)in[i].key;
+
+			r->sum += obj[0];
+			if (!r->deferred || !bpf_arena_remote_push(ARENA_REMOTE_USER, obj))
+				bpf_arena_free(obj);
+		}
+		r->free_ns += bench_now_ns() - t0;
+		done += n;
+	}
+
+	r->elapsed_ns = bench_now_ns() - start;
+	return NULL;
+}
+
+static int run_one(unsigned int size, bool deferred)
+{
+	struct arena_remote_list *rl = &shared->remote.owner[ARENA_REMOTE_USER];
+	struct arena_remote_list before = *rl;
+	pthread_t prod, cons;
+	struct run *r;
+	uint64_t drained, batches, puts;
+
+	r = calloc(1, sizeof(*r));
+	if (!r || ds_ck_ring_spsc_init_c(&r->ring, BENCH_RING_CAPACITY) != DS_SUCCESS)
+		return -1;
+	r->size = size;
+	r->deferred = deferred;
+	pthread_barrier_init(&r->barrier, NULL, 2);
+
+	if (pthread_create(&cons, NULL, consumer_main, r) != 0 ||
+	    pthread_create(&prod, NULL, producer_main, r) != 0)
+		return -1;
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+
+	/* Settle what is still queued so the next run starts clean */
+	bpf_arena_userspace_remote_drain();
+
+	drained = rl->drained - before.drained;
+	batches = rl->batches - before.batches;
+	puts = rl->page_puts - before.page_puts;
+
+	if (r->sum != config.ops * (config.ops + 1) / 2) {
+		fprintf(stderr, "bench_remote_free: objects lost or corrupted\n");
+		return -1;
+	}
+
+	printf("%6u %-9s %10.2f %11.1f %11.1f %9.1f %11.3f\n", size,
+	       deferred ? "deferred" : "in place",
+	       bench_mops(config.ops, r->elapsed_ns),
+	       (double)r->alloc_ns / (double)config.ops,
+	       (double)r->free_ns / (double)config.ops,
+	       batches ? (double)drained / (double)batches : 0.0,
+	       deferred ? (drained ? (double)puts / (double)drained : 0.0) : 1.0);
+
+	ds_arena_free_array(r->ring.slots, (__u64)BENCH_RING_CAPACITY * sizeof(struct ds_kv));
+	pthread_barrier_destroy(&r->barrier);
+	free(r);
+	return 0;
+}
+
+static int setup_arena(void)
+{
+	size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+	size_t bytes = (size_t)DS_PAGE_OWNER_MAX_PAGES * pg;
+	size_t reserved = (sizeof(*shared) + pg - 1) / pg;
+	void *mem;
+
+	mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "bench_remote_free: mmap(%zu) failed: %s\n", bytes, strerror(errno));
+		return -1;
+	}
+
+	shared = mem;
+	bpf_arena_userspace_set_range((char *)mem + reserved * pg, bytes - reserved * pg);
+	if (ds_page_owner_init_c(&shared->owner, mem, DS_PAGE_OWNER_MAX_PAGES,
+				 (__u32)reserved) != DS_SUCCESS)
+		return -1;
+	bpf_arena_userspace_set_owner(&shared->owner);
+	bpf_arena_userspace_set_remote(&shared->remote);
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Cross-CPU arena frees, in place vs deferred remote-free lists\n\n");
+	printf("OPTIONS:\n");
+	printf("  -n N    Objects per run (default: %" PRIu64 ")\n", config.ops);
+	printf("  -b N    Handoff batch, 1..%d (default: %u)\n", BENCH_MAX_BATCH, config.batch);
+	printf("  -p CPU  Producer CPU (default: %d)\n", config.prod_cpu);
+	printf("  -c CPU  Consumer CPU (default: %d)\n", config.cons_cpu);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:p:c:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			config.ops = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			config.batch = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			config.prod_cpu = atoi(optarg);
+			break;
+		case 'c':
+			config.cons_cpu = atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!config.ops || !config.batch || config.batch > BENCH_MAX_BATCH ||
+	    config.prod_cpu < 0 || config.cons_cpu < 0) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (setup_arena() < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Remote free: producer CPU %d -> consumer CPU %d, %" PRIu64 " objects, batch %u\n",
+	       config.prod_cpu % bench_nr_cpus(), config.cons_cpu % bench_nr_cpus(),
+	       config.ops, config.batch);
+	printf("  Per drain = objects per owner drain; Footer/obj = footer RMWs per free\n");
+	bench_print_rule();
+	printf("%6s %-9s %10s %11s %11s %9s %11s\n", "Size", "Free", "Mfrees/s",
+	       "Alloc ns/op", "Free ns/op", "Per drain", "Footer/obj");
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		if (run_one(sizes[i], false) < 0 || run_one(sizes[i], true) < 0) {
+			fprintf(stderr, "bench_remote_free: size %u failed\n", sizes[i]);
+			return 1;
+		}
+	}
+
+	bench_print_rule();
+	ds_page_owner_print(&shared->owner);
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_ring_init: startup latency of ds_vyukhov.h rings across capacities
+ *
+ * For each capacity from 16 up to -c cells, a fresh ring is built in two
+ * ways. "Lazy" is ds_vyukhov_init_c() as shipped, which only allocates the
+ * buffer. "Eager" adds the per-cell sequence pass the init used to run,
+ * so its cost is what every ring paid before. Each run reports:
+ *
+ *   Init       ds_vyukhov_init_c() (plus the pass, for eager)
+ *   1st op     init + the first insert, i.e. time to the first event
+ *   Lap        inserting one full lap after the first op
+ *
+ * Lap shows where the lazy ring pays for first-touch page faults instead.
+ * Buffers are never freed, so every run gets untouched pages and
+ * none of the allocator's re-zeroing of reused runs is timed. Each value is
+ * the median of -r runs.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_vyukhov.h"
+
+#define BENCH_MAX_REPS 64
+
+struct bench_config {
+	__u32 max_capacity;
+	int reps;
+};
+
+static struct bench_config config = {
+	.max_capacity = 1u << 19,
+	.reps = 5,
+};
+
+struct sample {
+	uint64_t init_ns;
+	uint64_t first_ns;
+	uint64_t lap_ns;
+};
+
+/* The pre-lazy init: visit every cell once and store its first-lap sequence */
+static void eager_pass(struct ds_vyukhov_head *q, __u32 capacity)
+{
+	for (__u32 i = 0; i < capacity; i++)
+		arena_atomic_store(&q->buffer[i].sequence, DS_VYUKHOV_SEQ_STORE(i, i),
+				   ARENA_RELAXED);
+}
+
+static int run_one(__u32 capacity, bool eager, struct sample *s)
+{
+	struct ds_vyukhov_head *q;
+	uint64_t start, t;
+
+	q = bpf_arena_alloc(sizeof(*q));
+	if (!q)
+		return -1;
+
+	start = bench_now_ns();
+	if (ds_vyukhov_init_c(q, capacity) != DS_SUCCESS)
+		return -1;
+	if (eager)
+		eager_pass(q, capacity);
+	t = bench_now_ns();
+	s->init_ns = t - start;
+
+	if (ds_vyukhov_insert_c(q, 0, 0) != DS_SUCCESS)
+		return -1;
+	s->first_ns = bench_now_ns() - start;
+
+	t = bench_now_ns();
+	for (__u32 i = 1; i < capacity; i++)
+		if (ds_vyukhov_insert_c(q, i, i) != DS_SUCCESS)
+			return -1;
+	s->lap_ns = bench_now_ns() - t;
+
+	return ds_vyukhov_insert_c(q, 0, 0) == DS_ERROR_NOMEM &&
+	       ds_vyukhov_verify_c(q) == DS_SUCCESS ? 0 : -1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t median(uint64_t *v, int n)
+{
+	qsort(v, (size_t)n, sizeof(*v), cmp_u64);
+	return v[n / 2];
+}
+
+static int measure(__u32 capacity, bool eager, struct sample *out)
+{
+	uint64_t init[BENCH_MAX_REPS], first[BENCH_MAX_REPS], lap[BENCH_MAX_REPS];
+	struct sample s;
+
+	for (int r = 0; r < config.reps; r++) {
+		if (run_one(capacity, eager, &s) < 0)
+			return -1;
+		init[r] = s.init_ns;
+		first[r] = s.first_ns;
+		lap[r] = s.lap_ns;
+	}
+
+	out->init_ns = median(init, config.reps);
+	out->first_ns = median(first, config.reps);
+	out->lap_ns = median(lap, config.reps);
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Vyukhov ring startup latency, lazy vs per-cell init\n\n");
+	printf("OPTIONS:\n");
+	printf("  -c N    Max capacity, power of 2, >= 16 (default: %u)\n", config.max_capacity);
+	printf("  -r N    Runs per point, median reported (default: %d, max %d)\n",
+	       config.reps, BENCH_MAX_REPS);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:r:h")) != -1) {
+		switch (opt) {
+		case 'c':
+			config.max_capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			config.reps = atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_capacity < 16 || (config.max_capacity & (config.max_capacity - 1)) ||
+	    config.reps < 1 || config.reps > BENCH_MAX_REPS) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Vyukhov ring startup: capacities 16..%u, median of %d runs\n",
+	       config.max_capacity, config.reps);
+	printf("  1st op = init + first insert; Lap = remaining inserts of lap one\n");
+	bench_print_rule();
+	printf("%9s %11s %11s %11s %11s %10s %10s\n", "Capacity", "Lazy init",
+	       "Eager init", "Lazy 1stop", "Eager 1stop", "Lazy lap", "Eager lap");
+	printf("%9s %11s %11s %11s %11s %10s %10s\n", "", "us", "us", "us", "us", "ms", "ms");
+
+	bench_pin_cpu(0);
+	for (__u32 cap = 16; cap && cap <= config.max_capacity; cap <<= 1) {
+		struct sample lazy, eager;
+
+		if (measure(cap, false, &lazy) < 0 || measure(cap, true, &eager) < 0) {
+			fprintf(stderr, "bench_ring_init: capacity %u failed (arena too small?)\n", cap);
+			return 1;
+		}
+
+		printf("%9u %11.2f %11.2f %11.2f %11.2f %10.3f %10.3f\n", cap,
+		       lazy.init_ns / 1e3, eager.init_ns / 1e3,
+		       lazy.first_ns / 1e3, eager.first_ns / 1e3,
+		       lazy.lap_ns / 1e6, eager.lap_ns / 1e6);
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_spill: spill bandwidth and replay latency of ds_spill.h
+ *
+ * A producer thread fills a Vyukhov lane as fast as it can, standing in
+ * for a BPF program that never waits. The consumer stalls for T ms at the
+ * start of the run and then drains through ds_spill_pop(). A third thread
+ * runs ds_spill_poll() and moves batches to segment files while the lane
+ * is above its high watermark. The run is repeated for T = 1, 2, 4, ... up
+ * to -t ms.
+ *
+ * Lane full counts the inserts that found the lane full. A BPF producer
+ * would have dropped each of them, so it should stay near zero while the
+ * spill keeps up.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_spill.h"
+#include "ds_vyukhov.h"
+
+struct bench_config {
+	uint64_t items;
+	__u32 capacity;
+	unsigned int max_stall_ms;
+	__u64 segment_bytes;
+	bool direct;
+	const char *dir;
+};
+
+static struct bench_config config = {
+	.items = 2000000,
+	.capacity = 128,
+	.max_stall_ms = 512,
+	.segment_bytes = 16ULL << 20,
+	.direct = false,
+	.dir = "/tmp",
+};
+
+struct run {
+	struct ds_vyukhov_head *lane;
+	struct ds_spill spill;
+	struct bench_barrier barrier;
+	unsigned int stall_ms;
+	_Atomic int producer_done;
+	_Atomic int consumer_done;
+	uint64_t lane_full;
+	uint64_t consumed;
+	uint64_t out_of_order;
+	uint64_t elapsed_ns;
+};
+
+static int lane_pop(void *lane, struct ds_kv *out)
+{
+	return ds_vyukhov_pop_c(lane, out);
+}
+
+static __u32 lane_depth(void *lane)
+{
+	struct ds_vyukhov_head *head = lane;
+
+	return (__u32)arena_atomic_load(&head->count, ARENA_RELAXED);
+}
+
+static void *producer_main(void *arg)
+{
+	struct run *r = arg;
+
+	bench_pin_cpu(0);
+	bench_barrier_wait(&r->barrier);
+
+	for (uint64_t i = 0; i < config.items; i++) {
+		while (ds_vyukhov_insert_c(r->lane, i, i) != DS_SUCCESS) {
+			r->lane_full++;
+			sched_yield();
+		}
+	}
+
+	atomic_store_explicit(&r->producer_done, 1, memory_order_release);
+	return NULL;
+}
+
+static void *spill_main(void *arg)
+{
+	struct run *r = arg;
+
+	bench_pin_cpu(2);
+	while (!atomic_load_explicit(&r->consumer_done, memory_order_acquire)) {
+		if (!ds_spill_poll(&r->spill))
+			sched_yield();
+	}
+	return NULL;
+}
+
+static void consume(struct run *r)
+{
+	uint64_t next = 0;
+	struct ds_kv kv;
+
+	bench_pin_cpu(1);
+	usleep(r->stall_ms * 1000u);
+
+	while (r->consumed < config.items) {
+		if (ds_spill_pop(&r->spill, &kv) != DS_SUCCESS) {
+			sched_yield();
+			continue;
+		}
+		r->out_of_order += kv.key != next;
+		next = kv.key + 1;
+		r->consumed++;
+	}
+}
+
+static int run_one(unsigned int stall_ms, struct run *r)
+{
+	pthread_t producer, spiller;
+	uint64_t start;
+
+	memset(r, 0, sizeof(*r));
+	r->stall_ms = stall_ms;
+	r->barrier.total = 2;
+
+	r->lane = bpf_arena_alloc(sizeof(*r->lane));
+	if (!r->lane || ds_vyukhov_init_c(r->lane, config.capacity) != DS_SUCCESS)
+		return -1;
+	if (ds_spill_init(&r->spill, config.dir, r->lane, lane_pop, lane_depth, config.capacity,
+			  config.segment_bytes, config.direct ? DS_SPILL_F_DIRECT : 0) != DS_SUCCESS) {
+		fprintf(stderr, "bench_spill: cannot create segments in %s\n", config.dir);
+		return -1;
+	}
+
+	if (pthread_create(&producer, NULL, producer_main, r) != 0 ||
+	    pthread_create(&spiller, NULL, spill_main, r) != 0) {
+		perror("pthread_create");
+		return -1;
+	}
+
+	bench_barrier_wait(&r->barrier);
+	start = bench_now_ns();
+	consume(r);
+	r->elapsed_ns = bench_now_ns() - start;
+	atomic_store_explicit(&r->consumer_done, 1, memory_order_release);
+	pthread_join(producer, NULL);
+	pthread_join(spiller, NULL);
+
+	if (r->out_of_order || r->spill.stats.errors) {
+		ds_spill_destroy(&r->spill);
+		return -1;
+	}
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Spill-to-disk lane overflow benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -n N    Entries per run (default: %llu)\n", (unsigned long long)config.items);
+	printf("  -c N    Lane capacity, power of 2, >= 4 (default: %u)\n", config.capacity);
+	printf("  -t MS   Max consumer stall (default: %u)\n", config.max_stall_ms);
+	printf("  -S MB   Segment size (default: %llu)\n",
+	       (unsigned long long)(config.segment_bytes >> 20));
+	printf("  -d      Write segments with O_DIRECT\n");
+	printf("  -D DIR  Segment directory (default: %s)\n", config.dir);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:c:t:S:dD:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			config.items = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			config.max_stall_ms = (unsigned int)strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			config.segment_bytes = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'd':
+			config.direct = true;
+			break;
+		case 'D':
+			config.dir = optarg;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!config.items || config.capacity < 4 ||
+	    (config.capacity & (config.capacity - 1)) || !config.max_stall_ms ||
+	    !config.segment_bytes) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static struct run r;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Spill: entries=%llu capacity=%u segment=%lluMB dir=%s%s\n",
+	       (unsigned long long)config.items, config.capacity,
+	       (unsigned long long)(config.segment_bytes >> 20), config.dir,
+	       config.direct ? " O_DIRECT" : "");
+	printf("  Replay latency is spill -> consumer pop, per replayed entry\n");
+	bench_print_rule();
+	printf("%8s %10s %9s %10s %9s %13s %12s %10s\n",
+	       "Stall ms", "Spilled", "Segments", "Spill MB/s", "Mops",
+	       "Replay avg us", "Replay p99us", "Lane full");
+
+	for (unsigned int t = 1; t <= config.max_stall_ms; t *= 2) {
+		const struct ds_spill_stats *st = &r.spill.stats;
+
+		if (run_one(t, &r) < 0) {
+			fprintf(stderr, "bench_spill: entries lost or reordered\n");
+			return 1;
+		}
+
+		printf("%8u %10llu %9llu %10.1f %9.2f %13.1f %12.1f %10llu\n", t,
+		       (unsigned long long)st->spilled, (unsigned long long)st->segments,
+		       ds_spill_bandwidth_mbps(st), bench_mops(r.consumed, r.elapsed_ns),
+		       st->replayed ? (double)st->replay_lat_sum_ns / (double)st->replayed / 1e3 : 0.0,
+		       (double)ds_spill_replay_percentile_ns(st, 99) / 1e3,
+		       (unsigned long long)r.lane_full);
+		ds_spill_destroy(&r.spill);
+
+		if (t < config.max_stall_ms && t * 2 > config.max_stall_ms)
+			t = config.max_stall_ms / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
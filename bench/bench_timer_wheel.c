@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_timer_wheel: schedule/cancel/expire cost of ds_timer_wheel.h with
+ * millions of pending timers
+ *
+ * Workers schedule -n timers in total with random delays up to -d ticks and
+ * cancel -x percent of them. A single advancer then drives a synthetic
+ * clock across the whole horizon, so the expire rate reflects the wheel
+ * itself rather than wall-clock waiting. The run is repeated for 1, 2,
+ * 4, ... up to -t scheduling threads.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_timer_wheel.h"
+
+#define BENCH_TICK_NS 1000ull
+
+struct bench_config {
+	int max_threads;
+	uint64_t timers;
+	uint64_t max_delay_ticks;
+	unsigned int cancel_pct;
+};
+
+static struct bench_config config = {
+	.max_threads = 4,
+	.timers = 2000000,
+	.max_delay_ticks = 100000,
+	.cancel_pct = 10,
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	uint64_t count;
+	struct ds_timer_wheel *wheel;
+	struct bench_barrier *barrier;
+	struct ds_timer_wheel_handle *handles;
+	uint64_t sched_failures;
+	uint64_t cancel_failures;
+	uint64_t sched_ns;
+	uint64_t cancel_ns;
+};
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	uint64_t rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(w->id + 1);
+	uint64_t nr_cancel = w->count * config.cancel_pct / 100;
+	uint64_t start;
+
+	bench_pin_cpu(w->id);
+	bench_barrier_wait(w->barrier);
+
+	start = bench_now_ns();
+	for (uint64_t i = 0; i < w->count; i++) {
+		uint64_t delay = 1 + bench_rand(&rng) % config.max_delay_ticks;
+
+		if (ds_timer_wheel_schedule_c(w->wheel, delay * BENCH_TICK_NS, i, delay,
+					      i < nr_cancel ? &w->handles[i] : NULL) != DS_SUCCESS)
+			w->sched_failures++;
+	}
+	w->sched_ns = bench_now_ns() - start;
+
+	start = bench_now_ns();
+	for (uint64_t i = 0; i < nr_cancel; i++)
+		if (ds_timer_wheel_cancel_c(w->wheel, &w->handles[i]) != DS_SUCCESS)
+			w->cancel_failures++;
+	w->cancel_ns = bench_now_ns() - start;
+
+	return NULL;
+}
+
+static int run_one(int nr_threads)
+{
+	struct worker workers[BENCH_MAX_THREADS] = {0};
+	struct bench_barrier barrier = { .total = nr_threads };
+	struct ds_timer_wheel *wheel;
+	uint64_t per_thread = config.timers / (uint64_t)nr_threads;
+	uint64_t sched_ns = 0, cancel_ns = 0, failures = 0;
+	uint64_t scheduled, cancelled, fired = 0, place_ns, expire_ns, reclaim_ns;
+	uint64_t now, start;
+	int ret = 0;
+
+	wheel = bpf_arena_alloc(sizeof(*wheel));
+	if (!wheel || ds_timer_wheel_init_c(wheel, BENCH_TICK_NS, 0) != DS_SUCCESS)
+		return -1;
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].count = per_thread;
+		workers[i].wheel = wheel;
+		workers[i].barrier = &barrier;
+		workers[i].handles = calloc(per_thread, sizeof(*workers[i].handles));
+		if (!workers[i].handles) {
+			perror("calloc");
+			return -1;
+		}
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].sched_ns > sched_ns)
+			sched_ns = workers[i].sched_ns;
+		if (workers[i].cancel_ns > cancel_ns)
+			cancel_ns = workers[i].cancel_ns;
+		failures += workers[i].sched_failures + workers[i].cancel_failures;
+		free(workers[i].handles);
+	}
+
+	scheduled = arena_atomic_load(&wheel->scheduled, ARENA_RELAXED);
+	cancelled = arena_atomic_load(&wheel->cancelled, ARENA_RELAXED);
+
+	/* First advance at tick 0 only drains incoming into the slots */
+	start = bench_now_ns();
+	fired += ds_timer_wheel_advance_c(wheel, 0, NULL);
+	place_ns = bench_now_ns() - start;
+
+	start = bench_now_ns();
+	for (now = BENCH_TICK_NS; wheel->cur <= config.max_delay_ticks; now += BENCH_TICK_NS)
+		fired += ds_timer_wheel_advance_c(wheel, now, NULL);
+	expire_ns = bench_now_ns() - start;
+
+	start = bench_now_ns();
+	ds_timer_wheel_reclaim_c(wheel);
+	reclaim_ns = bench_now_ns() - start;
+
+	if (fired + cancelled != scheduled || wheel->freed != scheduled)
+		ret = -1;
+
+	printf("%7d %10llu %9.1f %9.1f %9.1f %10.2f %9.1f %7s\n",
+	       nr_threads,
+	       (unsigned long long)scheduled,
+	       scheduled ? (double)sched_ns * nr_threads / (double)scheduled : 0.0,
+	       cancelled ? (double)cancel_ns * nr_threads / (double)cancelled : 0.0,
+	       scheduled ? (double)place_ns / (double)scheduled : 0.0,
+	       bench_mops(fired, expire_ns),
+	       scheduled ? (double)reclaim_ns / (double)scheduled : 0.0,
+	       ret == 0 && failures == 0 && ds_timer_wheel_verify_c(wheel) == DS_SUCCESS ?
+	       "ok" : "FAIL");
+
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Hierarchical timer wheel schedule/cancel/expire benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -t N    Max scheduling threads (default: %d)\n", config.max_threads);
+	printf("  -n N    Timers per run (default: %llu)\n", (unsigned long long)config.timers);
+	printf("  -d N    Max delay in ticks (default: %llu)\n",
+	       (unsigned long long)config.max_delay_ticks);
+	printf("  -x PCT  Percent of timers cancelled (default: %u)\n", config.cancel_pct);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:d:x:h")) != -1) {
+		switch (opt) {
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 'n':
+			config.timers = strtoull(optarg, NULL, 0);
+			break;
+		case 'd':
+			config.max_delay_ticks = strtoull(optarg, NULL, 0);
+			break;
+		case 'x':
+			config.cancel_pct = (unsigned int)atoi(optarg);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_threads < 1 || config.max_threads > BENCH_MAX_THREADS ||
+	    config.timers < (uint64_t)config.max_threads || config.max_delay_ticks < 1 ||
+	    config.cancel_pct > 100) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Timer wheel: timers=%llu max_delay=%llu ticks cancel=%u%%\n",
+	       (unsigned long long)config.timers, (unsigned long long)config.max_delay_ticks,
+	       config.cancel_pct);
+	printf("  ns/op columns: Sched/Cancel per op per thread, Place/Reclaim per timer\n");
+	bench_print_rule();
+	printf("%7s %10s %9s %9s %9s %10s %9s %7s\n",
+	       "Threads", "Timers", "Sched", "Cancel", "Place", "Fire Mops", "Reclaim", "Verify");
+
+	for (int n = 1; n <= config.max_threads; n *= 2) {
+		if (run_one(n) < 0)
+			return 1;
+		if (n < config.max_threads && n * 2 > config.max_threads)
+			n = config.max_threads / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
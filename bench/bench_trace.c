@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_trace: cost of recording one flight-recorder event (ds_trace.h)
+ *
+ * Each worker runs -n insert+pop pairs on its own Vyukhov queue, timed
+ * with DS_METRICS_RECORD_OP as the relay does, then the same loop with
+ * DS_TRACE_RECORD_OP_C with recording off and on. The per-event cost is
+ * the difference divided by the events recorded (two per pair). A raw
+ * loop of ds_trace_record_c() calls with fixed arguments, which leaves out
+ * the clock reads and the operation, is reported too. The run is repeated
+ * for 1, 2, 4, ... up to -t threads, each writing its own ring. Costs are
+ * per-thread CPU time, so they hold when threads outnumber CPUs.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_trace.h"
+#include "ds_vyukhov.h"
+
+/* Recording must stay below this per event */
+#define BENCH_TRACE_BUDGET_NS 20.0
+
+enum bench_mode {
+	BENCH_METRICS,	/* metrics only: the baseline */
+	BENCH_TRACE_OFF,	/* metrics + trace, recording disabled */
+	BENCH_TRACE_ON,	/* metrics + trace, recording */
+	BENCH_RAW,	/* ds_trace_record_c alone */
+	BENCH_NUM_MODES,
+};
+
+struct bench_config {
+	int max_threads;
+	uint64_t pairs_per_thread;
+};
+
+static struct bench_config config = {
+	.max_threads = 4,
+	.pairs_per_thread = 1000000,
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	enum bench_mode mode;
+	struct bench_barrier *barrier;
+	uint64_t elapsed_ns;
+	uint64_t failures;
+};
+
+static struct ds_metrics_store g_metrics;
+static struct ds_trace_store g_trace;
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct ds_vyukhov_head *q;
+	__u32 ring, cpu;
+	struct ds_kv kv;
+	uint64_t start;
+	int rc;
+
+	bench_pin_cpu(w->id);
+	cpu = (__u32)sched_getcpu();
+	ring = ds_trace_register_c(&g_trace);
+
+	q = calloc(1, sizeof(*q));
+	if (!q || ds_vyukhov_init_c(q, 64) != DS_SUCCESS) {
+		w->failures++;
+		bench_barrier_wait(w->barrier);
+		return NULL;
+	}
+
+	bench_barrier_wait(w->barrier);
+	start = thread_cpu_ns();
+
+	for (uint64_t i = 0; i < config.pairs_per_thread; i++) {
+		switch (w->mode) {
+		case BENCH_METRICS:
+			DS_METRICS_RECORD_OP(&g_metrics, DS_METRICS_USER_PRODUCER, {
+				rc = ds_vyukhov_insert_c(q, i, i);
+			}, rc);
+			w->failures += rc != DS_SUCCESS;
+			DS_METRICS_RECORD_OP(&g_metrics, DS_METRICS_USER_CONSUMER, {
+				rc = ds_vyukhov_pop_c(q, &kv);
+			}, rc);
+			w->failures += rc != DS_SUCCESS;
+			break;
+		case BENCH_TRACE_OFF:
+		case BENCH_TRACE_ON:
+			DS_TRACE_RECORD_OP_C(&g_metrics, DS_METRICS_USER_PRODUCER, &g_trace, ring, cpu,
+					     DS_OP_INSERT, 0, {
+				rc = ds_vyukhov_insert_c(q, i, i);
+			}, rc);
+			w->failures += rc != DS_SUCCESS;
+			DS_TRACE_RECORD_OP_C(&g_metrics, DS_METRICS_USER_CONSUMER, &g_trace, ring, cpu,
+					     DS_OP_POP, 0, {
+				rc = ds_vyukhov_pop_c(q, &kv);
+			}, rc);
+			w->failures += rc != DS_SUCCESS;
+			break;
+		default:
+			ds_trace_record_c(&g_trace, ring, cpu, i, 100, DS_OP_INSERT, 0, DS_SUCCESS);
+			ds_trace_record_c(&g_trace, ring, cpu, i, 100, DS_OP_POP, 0, DS_SUCCESS);
+			break;
+		}
+	}
+
+	w->elapsed_ns = thread_cpu_ns() - start;
+	ds_arena_free_array(q->buffer, 64 * sizeof(struct ds_vyukhov_node));
+	free(q);
+	return NULL;
+}
+
+/* Returns: ns per recorded event (two per pair), or -1 */
+static double run_mode(int nr_threads, enum bench_mode mode, uint64_t *failures)
+{
+	struct worker workers[BENCH_MAX_THREADS] = {0};
+	struct bench_barrier barrier = { .total = nr_threads };
+	uint64_t total_ns = 0;
+
+	g_trace.nr_threads = 0;
+	arena_atomic_store(&g_trace.enabled, mode == BENCH_TRACE_ON || mode == BENCH_RAW,
+			   ARENA_RELAXED);
+
+	for (int i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].mode = mode;
+		workers[i].barrier = &barrier;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1.0;
+		}
+	}
+
+	for (int i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total_ns += workers[i].elapsed_ns;
+		*failures += workers[i].failures;
+	}
+
+	return (double)total_ns / ((double)nr_threads * (double)config.pairs_per_thread * 2.0);
+}
+
+static int run_one(int nr_threads)
+{
+	double ns[BENCH_NUM_MODES];
+	uint64_t failures = 0;
+	double added;
+
+	for (int m = 0; m < BENCH_NUM_MODES; m++) {
+		ns[m] = run_mode(nr_threads, (enum bench_mode)m, &failures);
+		if (ns[m] < 0)
+			return -1;
+	}
+
+	added = ns[BENCH_TRACE_ON] - ns[BENCH_METRICS];
+	printf("%7d %11.1f %11.1f %11.1f %11.1f %9.1f %9s\n",
+	       nr_threads, ns[BENCH_METRICS], ns[BENCH_TRACE_OFF], ns[BENCH_TRACE_ON],
+	       added, ns[BENCH_RAW],
+	       failures ? "FAIL" : added < BENCH_TRACE_BUDGET_NS ? "ok" : "OVER");
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Flight recorder per-event overhead benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -t N    Max worker threads, <= %d (default: %d)\n",
+	       DS_TRACE_THREADS, config.max_threads);
+	printf("  -n N    Insert+pop pairs per thread (default: %llu)\n",
+	       (unsigned long long)config.pairs_per_thread);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:h")) != -1) {
+		switch (opt) {
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 'n':
+			config.pairs_per_thread = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	/* Every worker owns a ring, as the relay's threads do */
+	if (config.max_threads < 1 || config.max_threads > DS_TRACE_THREADS ||
+	    !config.pairs_per_thread) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Flight recorder: %llu insert+pop pairs per thread, %d-slot rings\n",
+	       (unsigned long long)config.pairs_per_thread, DS_TRACE_SLOTS);
+	printf("  ns per op; Added = trace on - metrics only (budget %.0f ns)\n",
+	       BENCH_TRACE_BUDGET_NS);
+	bench_print_rule();
+	printf("%7s %11s %11s %11s %11s %9s %9s\n",
+	       "Threads", "Metrics", "Trace-off", "Trace-on", "Added", "Raw", "Budget");
+
+	for (int n = 1; n <= config.max_threads; n *= 2) {
+		if (run_one(n) < 0)
+			return 1;
+		if (n < config.max_threads && n * 2 > config.max_threads)
+			n = config.max_threads / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * bench_vyukhov: MPMC throughput of the ds_vyukhov.h _c operations
+ *
+ * -t producers and -t consumers share one queue of -c cells. Producers
+ * insert -n items each, retrying while the queue is full; consumers pop
+ * until every item is accounted for. Mops/s counts items moved end to
+ * end. The run is repeated for 1, 2, 4, ... up to -t threads per side.
+ * scripts/relax_explorer.py uses this to score memory-order variants of
+ * the header.
+ */
+#include "bench_common.h"
+
+#include <getopt.h>
+
+#include "ds_vyukhov.h"
+
+struct bench_config {
+	int max_threads;
+	uint64_t items_per_producer;
+	__u32 capacity;
+};
+
+static struct bench_config config = {
+	.max_threads = 2,
+	.items_per_producer = 2000000,
+	.capacity = 128,
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	bool producer;
+	struct ds_vyukhov_head *q;
+	struct bench_barrier *barrier;
+	_Atomic uint64_t *consumed;
+	uint64_t target;
+	uint64_t sum;
+	uint64_t elapsed_ns;
+};
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct ds_kv kv;
+	uint64_t start;
+
+	bench_pin_cpu(w->id);
+	bench_barrier_wait(w->barrier);
+	start = bench_now_ns();
+
+	if (w->producer) {
+		for (uint64_t i = 0; i < config.items_per_producer; i++) {
+			while (ds_vyukhov_insert_c(w->q, i, i + 1) != DS_SUCCESS)
+				sched_yield();
+		}
+	} else {
+		while (atomic_load_explicit(w->consumed, memory_order_relaxed) < w->target) {
+			if (ds_vyukhov_pop_c(w->q, &kv) != DS_SUCCESS) {
+				sched_yield();
+				continue;
+			}
+			w->sum += kv.value - kv.key;
+			atomic_fetch_add_explicit(w->consumed, 1, memory_order_relaxed);
+		}
+	}
+
+	w->elapsed_ns = bench_now_ns() - start;
+	return NULL;
+}
+
+static int run_one(int nr_threads)
+{
+	struct worker workers[2 * BENCH_MAX_THREADS] = {0};
+	struct bench_barrier barrier = { .total = 2 * nr_threads };
+	_Atomic uint64_t consumed = 0;
+	uint64_t target = config.items_per_producer * (uint64_t)nr_threads;
+	uint64_t max_ns = 0, sum = 0;
+	struct ds_vyukhov_head *q;
+
+	q = calloc(1, sizeof(*q));
+	if (!q || ds_vyukhov_init_c(q, config.capacity) != DS_SUCCESS) {
+		fprintf(stderr, "bench_vyukhov: init failed (capacity=%u)\n", config.capacity);
+		return -1;
+	}
+
+	for (int i = 0; i < 2 * nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].producer = i < nr_threads;
+		workers[i].q = q;
+		workers[i].barrier = &barrier;
+		workers[i].consumed = &consumed;
+		workers[i].target = target;
+		if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < 2 * nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		sum += workers[i].sum;
+		if (workers[i].elapsed_ns > max_ns)
+			max_ns = workers[i].elapsed_ns;
+	}
+
+	/* Every item carries value = key + 1 */
+	printf("%7d %12.2f %10llu %7s\n", nr_threads, bench_mops(target, max_ns),
+	       (unsigned long long)max_ns / 1000000,
+	       sum == target && ds_vyukhov_verify_c(q) == DS_SUCCESS ? "ok" : "FAIL");
+
+	ds_arena_free_array(q->buffer, (__u64)config.capacity * sizeof(struct ds_vyukhov_node));
+	free(q);
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Vyukhov MPMC queue throughput benchmark\n\n");
+	printf("OPTIONS:\n");
+	printf("  -t N    Max producers (and consumers) (default: %d)\n", config.max_threads);
+	printf("  -n N    Items per producer (default: %llu)\n",
+	       (unsigned long long)config.items_per_producer);
+	printf("  -c N    Queue capacity, power of 2 (default: %u)\n",
+	       config.capacity);
+	printf("  -h      Show this help\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:c:h")) != -1) {
+		switch (opt) {
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 'n':
+			config.items_per_producer = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			config.capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.max_threads < 1 || config.max_threads > BENCH_MAX_THREADS ||
+	    !config.items_per_producer || config.capacity < 2 ||
+	    (config.capacity & (config.capacity - 1))) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (parse_args(argc, argv) < 0)
+		return 1;
+	if (bench_arena_setup(BENCH_ARENA_BYTES) < 0)
+		return 1;
+	bench_env_begin();
+
+	bench_print_rule();
+	printf("  Vyukhov MPMC: %llu items per producer, capacity=%u\n",
+	       (unsigned long long)config.items_per_producer, config.capacity);
+	printf("  Threads = producers = consumers; Mops/s counts items moved\n");
+	bench_print_rule();
+	printf("%7s %12s %10s %7s\n", "Threads", "Mops/s", "Time(ms)", "Verify");
+
+	for (int n = 1; n <= config.max_threads; n *= 2) {
+		if (run_one(n) < 0)
+			return 1;
+		if (n < config.max_threads && n * 2 > config.max_threads)
+			n = config.max_threads / 2;
+	}
+
+	bench_print_rule();
+	bench_env_end();
+	return 0;
+}
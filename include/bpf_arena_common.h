@@ -36,6 +36,49 @@
 
 
 #ifdef __BPF__
+/*
+ * BPF has no fence instruction. A value-returning atomic is fully ordered
+ * and arm64 JITs it as such, so a full barrier is an exchange on a stack
+ * slot; volatile keeps the compiler from turning it into a plain store.
+ */
+#ifndef bpf_full_barrier
+#define bpf_full_barrier()					\
+do {								\
+	volatile __u64 __bpf_mb = 0;				\
+	(void)__atomic_exchange_n(&__bpf_mb, 0, __ATOMIC_SEQ_CST);	\
+} while (0)
+#endif
+
+/*
+ * Acquire/release. Compilers with BPF load-acquire/store-release emit
+ * those instructions. Otherwise x86 (TSO) only needs the compiler
+ * barrier below, and weakly ordered targets get a full barrier.
+ */
+#if defined(__BPF_FEATURE_LOAD_ACQ_STORE_REL)
+# ifndef smp_store_release
+#  define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+# endif
+# ifndef smp_load_acquire
+#  define smp_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# endif
+#elif !defined(__TARGET_ARCH_x86)
+# ifndef smp_store_release
+#  define smp_store_release(p, v)		\
+do {						\
+	bpf_full_barrier();			\
+	WRITE_ONCE(*p, v);			\
+} while (0)
+# endif
+# ifndef smp_load_acquire
+#  define smp_load_acquire(p)			\
+({						\
+	uintptr_t __p = (uintptr_t)READ_ONCE(*p);	\
+	bpf_full_barrier();			\
+	(typeof(*p))__p;			\
+})
+# endif
+#endif
+
 #ifndef smp_store_release
 # define smp_store_release(p, v)		\
 do {						\
@@ -61,6 +61,98 @@ enum ds_op_type {
 	DS_OP_MAX
 };
 
+/*
+ * Retry-count hook: lock-free operations call DS_TRACE_RETRIES(n) before
+ * returning. ds_trace.h records the count; otherwise it compiles away.
+ */
+#ifndef DS_TRACE_RETRIES
+#define DS_TRACE_RETRIES(n) do { } while (0)
+#endif
+
+/*
+ * Preemption hook: the _c lock-free paths call DS_PREEMPT_POINT() between
+ * the load a CAS depends on and the CAS itself, and in any window where a
+ * claimed slot is not yet published. bench_preempt defines it to yield or
+ * sleep at random; otherwise it compiles away.
+ */
+#ifndef DS_PREEMPT_POINT
+#define DS_PREEMPT_POINT() do { } while (0)
+#endif
+
+/*
+ * Phase hooks: an operation opens a timer with DS_PHASE_START(op), or
+ * DS_PHASE_RESUME() in a helper, and closes each phase with
+ * DS_PHASE_END(op, phase). ds_phase.h with DS_PHASES adds the time per
+ * phase to per-CPU cells; otherwise they compile away.
+ */
+#ifndef DS_PHASE_START
+#define DS_PHASE_START(op) do { } while (0)
+#define DS_PHASE_RESUME() do { } while (0)
+#define DS_PHASE_END(op, phase) do { } while (0)
+#endif
+
+/* ========================================================================
+ * ARRAY ALLOCATION
+ * ======================================================================== */
+
+/* Largest request bpf_arena_alloc() serves: rounded to 8, below the page footer */
+static inline __u64 ds_arena_small_max(void)
+{
+#ifdef __BPF__
+	return PAGE_SIZE - 16;
+#else
+	return (bpf_arena_userspace_page_size ? bpf_arena_userspace_page_size : 4096) - 16;
+#endif
+}
+
+/*
+ * Ring slot arrays: small ones share a page through bpf_arena_alloc(),
+ * larger ones take a contiguous page run. Free with the size passed at
+ * allocation so the same path is chosen. Large arrays need a sleepable
+ * program on the BPF side.
+ *
+ * Either way the array comes back zeroed: page runs are zero already, and
+ * a small array is cleared here because a fragment may be recycled with
+ * an earlier owner's contents. The Vyukhov ring's O(1) init depends on it,
+ * so if the BPF clearing loop is cut short the array is freed and NULL
+ * returned, as for an allocation failure.
+ */
+static inline void __arena *ds_arena_alloc_array(__u64 bytes)
+{
+	__u64 __arena *words;
+
+	if (bytes > ds_arena_small_max())
+		return bpf_arena_alloc_large(bytes);
+
+	words = bpf_arena_alloc((unsigned int)bytes);
+	if (!words)
+		return NULL;
+#ifdef __BPF__
+	__u32 i, nr = (__u32)((bytes + 7) / 8);
+
+	cast_kern(words);
+	for (i = 0; i < nr && can_loop; i++)
+		words[i] = 0;
+	cast_user(words);
+	/* can_loop ran out of budget: a partly cleared array must not escape */
+	if (i < nr) {
+		bpf_arena_free(words);
+		return NULL;
+	}
+#else
+	memset((void *)words, 0, (size_t)bytes);
+#endif
+	return words;
+}
+
+static inline void ds_arena_free_array(void __arena *addr, __u64 bytes)
+{
+	if (bytes <= ds_arena_small_max())
+		bpf_arena_free(addr);
+	else
+		bpf_arena_free_large(addr, bytes);
+}
+
 /* ========================================================================
  * DATA STRUCTURE METADATA
  * ======================================================================== */
@@ -89,6 +181,175 @@ struct ds_stats {
 	__u64 memory_used;            /* Bytes of arena memory used */
 };
 
+/*
+ * Per-operation counters, opt-in with DS_OP_STATS. Define it before any
+ * ds_*.h header, in the BPF program and in the loader alike, since it adds
+ * DS_OP_STATS_FIELD to each head. Every public _lkmm and _c operation then
+ * runs through DS_OP_STATS_RUN(): two clock reads and three relaxed adds
+ * on a slot of its own, picked by CPU in BPF and by thread in userspace.
+ * ds_<name>_stats() sums the slots into a struct ds_stats. Batch calls and
+ * pop aliases of delete are not counted on their own. Without the macro
+ * the field and the hook compile away.
+ *
+ * Besides the queues, rings, stacks and buffers, the LRU, RCU table, timer
+ * wheel and ID bitmap carry counters; their headers say which op id each
+ * call maps to. struct ds_seqlock does not: it is a single sequence word
+ * embedded in other structures, and the slots would be 3 KB per lock.
+ */
+
+/* Counter slots per head; CPUs or threads beyond this share. Power of 2. */
+#define DS_OP_STATS_SLOTS 16
+
+/**
+ * struct ds_op_stats_slot - One CPU's counters (three cache lines)
+ */
+struct ds_op_stats_slot {
+	struct ds_op_stats ops[DS_OP_MAX];
+	__u64 pad[3];
+};
+
+/**
+ * struct ds_op_stats_pcpu - Counters of one data structure instance
+ */
+struct ds_op_stats_pcpu {
+	struct ds_op_stats_slot slots[DS_OP_STATS_SLOTS];
+};
+
+#ifdef __BPF__
+static inline __u32 ds_op_stats_slot(void)
+{
+	return bpf_get_smp_processor_id() & (DS_OP_STATS_SLOTS - 1);
+}
+
+#define ds_op_stats_now() bpf_ktime_get_ns()
+#else
+#include <time.h>
+
+static __u32 ds_op_stats_next_slot;
+static __thread __u32 ds_op_stats_thread_slot = ~0U;
+
+/* Handed out in thread order on first use, so up to 16 threads never share */
+static inline __u32 ds_op_stats_slot(void)
+{
+	if (ds_op_stats_thread_slot == ~0U)
+		ds_op_stats_thread_slot = __atomic_fetch_add(&ds_op_stats_next_slot, 1,
+							     __ATOMIC_RELAXED) & (DS_OP_STATS_SLOTS - 1);
+	return ds_op_stats_thread_slot;
+}
+
+static inline __u64 ds_op_stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + (__u64)ts.tv_nsec;
+}
+#endif
+
+/**
+ * ds_op_stats_add - Account one operation
+ * @pcpu: Counters of the instance (NULL is ignored)
+ * @op: enum ds_op_type
+ * @ns: Time the operation took
+ * @result: Operation result; a negative DS_ERROR_* counts as a failure
+ *          (ITERATE returns a count, so it never fails)
+ */
+static inline void ds_op_stats_add(struct ds_op_stats_pcpu __arena *pcpu, int op,
+				   __u64 ns, long result)
+{
+	struct ds_op_stats __arena *s;
+
+	if (!pcpu || op < 0 || op >= DS_OP_MAX)
+		return;
+	cast_kern(pcpu);
+	s = &pcpu->slots[ds_op_stats_slot()].ops[op];
+
+	arena_atomic_add(&s->count, 1, ARENA_RELAXED);
+	arena_atomic_add(&s->total_time_ns, ns, ARENA_RELAXED);
+	if (result < 0)
+		arena_atomic_add(&s->failures, 1, ARENA_RELAXED);
+}
+
+/**
+ * ds_op_stats_read - Sum every slot of an instance into @stats->ops
+ */
+static inline void ds_op_stats_read(struct ds_op_stats_pcpu __arena *pcpu,
+				    struct ds_stats *stats)
+{
+	for (int op = 0; op < DS_OP_MAX; op++) {
+		stats->ops[op].count = 0;
+		stats->ops[op].failures = 0;
+		stats->ops[op].total_time_ns = 0;
+	}
+	if (!pcpu)
+		return;
+	cast_kern(pcpu);
+
+	for (int i = 0; i < DS_OP_STATS_SLOTS; i++) {
+		for (int op = 0; op < DS_OP_MAX; op++) {
+			struct ds_op_stats __arena *s = &pcpu->slots[i].ops[op];
+
+			stats->ops[op].count += arena_atomic_load(&s->count, ARENA_RELAXED);
+			stats->ops[op].failures += arena_atomic_load(&s->failures, ARENA_RELAXED);
+			stats->ops[op].total_time_ns +=
+				arena_atomic_load(&s->total_time_ns, ARENA_RELAXED);
+		}
+	}
+}
+
+/**
+ * ds_op_stats_reset - Zero every slot; racing updates may survive
+ */
+static inline void ds_op_stats_reset(struct ds_op_stats_pcpu __arena *pcpu)
+{
+	if (!pcpu)
+		return;
+	cast_kern(pcpu);
+
+	for (int i = 0; i < DS_OP_STATS_SLOTS; i++) {
+		for (int op = 0; op < DS_OP_MAX; op++) {
+			struct ds_op_stats __arena *s = &pcpu->slots[i].ops[op];
+
+			arena_atomic_store(&s->count, 0, ARENA_RELAXED);
+			arena_atomic_store(&s->failures, 0, ARENA_RELAXED);
+			arena_atomic_store(&s->total_time_ns, 0, ARENA_RELAXED);
+		}
+	}
+}
+
+/*
+ * DS_OP_STATS_RUN(head, op, call) evaluates to @call's result; with
+ * DS_OP_STATS it also times @call into @head->op_stats. DS_OP_STATS_ADDR()
+ * gives the counters of a head, or NULL when they are compiled out.
+ */
+#ifdef DS_OP_STATS
+#define DS_OP_STATS_FIELD struct ds_op_stats_pcpu op_stats;
+
+#define DS_OP_STATS_ADDR(head) ((head) ? &(head)->op_stats : NULL)
+
+#define DS_OP_STATS_RUN(head, op, call) \
+({ \
+	__u64 __ds_t0 = ds_op_stats_now(); \
+	__typeof__(call) __ds_ret = (call); \
+	ds_op_stats_add(DS_OP_STATS_ADDR(head), (op), ds_op_stats_now() - __ds_t0, \
+			(long)__ds_ret); \
+	__ds_ret; \
+})
+
+#define DS_OP_STATS_RUN_VOID(head, op, call) \
+do { \
+	__u64 __ds_t0 = ds_op_stats_now(); \
+	call; \
+	ds_op_stats_add(DS_OP_STATS_ADDR(head), (op), ds_op_stats_now() - __ds_t0, \
+			DS_SUCCESS); \
+} while (0)
+#else
+#define DS_OP_STATS_FIELD
+#define DS_OP_STATS_ADDR(head) ((void)(head), (struct ds_op_stats_pcpu __arena *)NULL)
+#define DS_OP_STATS_RUN(head, op, call) (call)
+#define DS_OP_STATS_RUN_VOID(head, op, call) call
+#endif
+
 struct ds_kv {
 	__u64 key;
 	__u64 value;
@@ -132,7 +393,7 @@ struct ds_v {
 	static inline int ds_##name##_pop(ds_##name##_head_t *head, struct ds_kv *out); \
 	static inline int ds_##name##_search(ds_##name##_head_t *head, __u64 key); \
 	static inline int ds_##name##_verify(ds_##name##_head_t *head); \
-	static inline void ds_##name##_get_stats(ds_##name##_head_t *head, struct ds_stats *stats); \
+	static inline int ds_##name##_stats(ds_##name##_head_t *head, struct ds_stats *stats); \
 	static inline void ds_##name##_reset_stats(ds_##name##_head_t *head); \
 	static inline const struct ds_metadata* ds_##name##_get_metadata(void);
 	
@@ -223,23 +484,28 @@ static inline __u64 ds_get_timestamp(void)
  */
 static inline void ds_print_stats(const char *name, struct ds_stats *stats)
 {
-	const char *op_names[] = {
-		"INIT", "INSERT", "DELETE", "SEARCH", "VERIFY", "ITERATE"
+	const char *op_names[DS_OP_MAX] = {
+		"INIT", "INSERT", "DELETE", "POP", "SEARCH", "VERIFY", "ITERATE"
 	};
-	
+	__u64 total_ns = 0;
+
+	for (int i = 0; i < DS_OP_MAX; i++)
+		total_ns += stats->ops[i].total_time_ns;
+
 	printf("\n=== %s Statistics ===\n", name);
 	printf("Elements: %llu (max: %llu)\n", stats->current_elements, stats->max_elements);
 	printf("Memory: %llu bytes\n", stats->memory_used);
 	printf("\nOperations:\n");
-	
+
 	for (int i = 0; i < DS_OP_MAX; i++) {
 		if (stats->ops[i].count > 0) {
 			__u64 avg_ns = stats->ops[i].total_time_ns / stats->ops[i].count;
-			printf("  %-8s: %10llu ops, %8llu failures, %8llu ns avg\n",
+			printf("  %-8s: %10llu ops, %8llu failures, %8llu ns avg, %5.1f%% of time\n",
 				op_names[i],
 				stats->ops[i].count,
 				stats->ops[i].failures,
-				avg_ns);
+				avg_ns,
+				total_ns ? (double)stats->ops[i].total_time_ns * 100.0 / (double)total_ns : 0.0);
 		}
 	}
 	printf("\n");
@@ -25,6 +25,7 @@ struct ds_ck_fifo_spsc {
 
 struct ds_ck_fifo_spsc_head {
 	struct ds_ck_fifo_spsc fifo;
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_ck_fifo_spsc_head __arena ds_ck_fifo_spsc_head_t;
@@ -264,7 +265,7 @@ ds_ck_fifo_spsc_recycle(struct ds_ck_fifo_spsc __arena *fifo)
 #endif
 }
 
-static inline int ds_ck_fifo_spsc_init_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
+static inline int __ds_ck_fifo_spsc_init_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
 {
 	struct ds_ck_fifo_spsc_entry __arena *stub;
 
@@ -286,8 +287,13 @@ static inline int ds_ck_fifo_spsc_init_lkmm(struct ds_ck_fifo_spsc_head __arena
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_fifo_spsc_init_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_ck_fifo_spsc_init_lkmm(head));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_fifo_spsc_init_c(struct ds_ck_fifo_spsc_head __arena *head)
+static inline int __ds_ck_fifo_spsc_init_c(struct ds_ck_fifo_spsc_head __arena *head)
 {
 	struct ds_ck_fifo_spsc_entry __arena *stub;
 
@@ -308,6 +314,11 @@ static inline int ds_ck_fifo_spsc_init_c(struct ds_ck_fifo_spsc_head __arena *he
 	ds_ck_fifo_spsc_fifo_init_c(&head->fifo, stub);
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_fifo_spsc_init_c(struct ds_ck_fifo_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_ck_fifo_spsc_init_c(head));
+}
 #endif
 
 static inline int ds_ck_fifo_spsc_init(struct ds_ck_fifo_spsc_head __arena *head)
@@ -319,8 +330,8 @@ static inline int ds_ck_fifo_spsc_init(struct ds_ck_fifo_spsc_head __arena *head
 #endif
 }
 
-static inline int ds_ck_fifo_spsc_insert_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
-					      __u64 key, __u64 value)
+static inline int __ds_ck_fifo_spsc_insert_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
+						__u64 key, __u64 value)
 {
 	struct ds_ck_fifo_spsc_entry __arena *entry;
 	struct ds_kv __arena *payload;
@@ -344,9 +355,15 @@ static inline int ds_ck_fifo_spsc_insert_lkmm(struct ds_ck_fifo_spsc_head __aren
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_fifo_spsc_insert_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
+					      __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_ck_fifo_spsc_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_fifo_spsc_insert_c(struct ds_ck_fifo_spsc_head __arena *head,
-					   __u64 key, __u64 value)
+static inline int __ds_ck_fifo_spsc_insert_c(struct ds_ck_fifo_spsc_head __arena *head,
+					     __u64 key, __u64 value)
 {
 	struct ds_ck_fifo_spsc_entry __arena *entry;
 	struct ds_kv __arena *payload;
@@ -369,6 +386,12 @@ static inline int ds_ck_fifo_spsc_insert_c(struct ds_ck_fifo_spsc_head __arena *
 	ds_ck_fifo_spsc_enqueue_c(&head->fifo, entry, payload);
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_fifo_spsc_insert_c(struct ds_ck_fifo_spsc_head __arena *head,
+					   __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_ck_fifo_spsc_insert_c(head, key, value));
+}
 #endif
 
 static inline int ds_ck_fifo_spsc_insert(struct ds_ck_fifo_spsc_head __arena *head,
@@ -381,8 +404,8 @@ static inline int ds_ck_fifo_spsc_insert(struct ds_ck_fifo_spsc_head __arena *he
 #endif
 }
 
-static inline int ds_ck_fifo_spsc_delete_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
-					      struct ds_kv *out)
+static inline int __ds_ck_fifo_spsc_delete_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
+						struct ds_kv *out)
 {
 	void __arena *value;
 	struct ds_kv __arena *payload;
@@ -407,9 +430,15 @@ static inline int ds_ck_fifo_spsc_delete_lkmm(struct ds_ck_fifo_spsc_head __aren
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_fifo_spsc_delete_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
+					      struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_ck_fifo_spsc_delete_lkmm(head, out));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_fifo_spsc_delete_c(struct ds_ck_fifo_spsc_head __arena *head,
-					   struct ds_kv *out)
+static inline int __ds_ck_fifo_spsc_delete_c(struct ds_ck_fifo_spsc_head __arena *head,
+					     struct ds_kv *out)
 {
 	void __arena *value;
 	struct ds_kv __arena *payload;
@@ -433,6 +462,12 @@ static inline int ds_ck_fifo_spsc_delete_c(struct ds_ck_fifo_spsc_head __arena *
 	out->value = arena_atomic_load(&payload->value, ARENA_RELAXED);
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_fifo_spsc_delete_c(struct ds_ck_fifo_spsc_head __arena *head,
+					   struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_ck_fifo_spsc_delete_c(head, out));
+}
 #endif
 
 static inline int ds_ck_fifo_spsc_delete(struct ds_ck_fifo_spsc_head __arena *head,
@@ -459,7 +494,7 @@ __u64 key)
 	return DS_ERROR_INVALID;
 }
 
-static inline int ds_ck_fifo_spsc_verify_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
+static inline int __ds_ck_fifo_spsc_verify_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
 {
 	struct ds_ck_fifo_spsc_entry __arena *cursor;
 	struct ds_ck_fifo_spsc_entry __arena *tail;
@@ -491,8 +526,13 @@ static inline int ds_ck_fifo_spsc_verify_lkmm(struct ds_ck_fifo_spsc_head __aren
 	return DS_ERROR_CORRUPT;
 }
 
+static inline int ds_ck_fifo_spsc_verify_lkmm(struct ds_ck_fifo_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_ck_fifo_spsc_verify_lkmm(head));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_fifo_spsc_verify_c(struct ds_ck_fifo_spsc_head __arena *head)
+static inline int __ds_ck_fifo_spsc_verify_c(struct ds_ck_fifo_spsc_head __arena *head)
 {
 	struct ds_ck_fifo_spsc_entry __arena *cursor;
 	struct ds_ck_fifo_spsc_entry __arena *tail;
@@ -523,6 +563,11 @@ static inline int ds_ck_fifo_spsc_verify_c(struct ds_ck_fifo_spsc_head __arena *
 
 	return DS_ERROR_CORRUPT;
 }
+
+static inline int ds_ck_fifo_spsc_verify_c(struct ds_ck_fifo_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_ck_fifo_spsc_verify_c(head));
+}
 #endif
 
 static inline int ds_ck_fifo_spsc_verify(struct ds_ck_fifo_spsc_head __arena *head)
@@ -534,4 +579,55 @@ static inline int ds_ck_fifo_spsc_verify(struct ds_ck_fifo_spsc_head __arena *he
 #endif
 }
 
+/**
+ * ds_ck_fifo_spsc_stats - Per-op counters (the FIFO keeps no element count)
+ * @head: FIFO
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_ck_fifo_spsc_stats_lkmm(struct ds_ck_fifo_spsc_head __arena *head,
+					     struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	stats->current_elements = 0;
+	stats->max_elements = 0;
+	stats->memory_used = 0;
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_ck_fifo_spsc_stats_c(struct ds_ck_fifo_spsc_head __arena *head,
+					  struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	stats->current_elements = 0;
+	stats->max_elements = 0;
+	stats->memory_used = 0;
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_ck_fifo_spsc_stats(struct ds_ck_fifo_spsc_head __arena *head,
+					struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_ck_fifo_spsc_stats_lkmm(head, stats);
+#else
+	return ds_ck_fifo_spsc_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_ck_fifo_spsc_reset_stats(struct ds_ck_fifo_spsc_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
+
 #endif /* DS_CK_FIFO_SPSC_H */
@@ -28,6 +28,7 @@ struct ds_ck_ring_spsc_head {
 	__u32 p_tail;
 
 	struct ds_kv __arena *slots;
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_ck_ring_spsc_head __arena ds_ck_ring_spsc_head_t;
@@ -37,8 +38,8 @@ static inline int ds_ck_ring_spsc_is_power_of_two(__u32 value)
 	return value >= 2 && (value & (value - 1)) == 0;
 }
 
-static inline int ds_ck_ring_spsc_init_lkmm(struct ds_ck_ring_spsc_head __arena *head,
-					    __u32 capacity)
+static inline int __ds_ck_ring_spsc_init_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+					      __u32 capacity)
 {
 	struct ds_kv __arena *slots;
 
@@ -50,7 +51,7 @@ static inline int ds_ck_ring_spsc_init_lkmm(struct ds_ck_ring_spsc_head __arena
 	if (!ds_ck_ring_spsc_is_power_of_two(capacity))
 		return DS_ERROR_INVALID;
 
-	slots = (struct ds_kv __arena *)bpf_arena_alloc(capacity * sizeof(*slots));
+	slots = (struct ds_kv __arena *)ds_arena_alloc_array((__u64)capacity * sizeof(*slots));
 	if (!slots)
 		return DS_ERROR_NOMEM;
 
@@ -67,9 +68,15 @@ static inline int ds_ck_ring_spsc_init_lkmm(struct ds_ck_ring_spsc_head __arena
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_ring_spsc_init_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+					    __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_ck_ring_spsc_init_lkmm(head, capacity));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_ring_spsc_init_c(struct ds_ck_ring_spsc_head __arena *head,
-					 __u32 capacity)
+static inline int __ds_ck_ring_spsc_init_c(struct ds_ck_ring_spsc_head __arena *head,
+					   __u32 capacity)
 {
 	struct ds_kv __arena *slots;
 
@@ -81,7 +88,7 @@ static inline int ds_ck_ring_spsc_init_c(struct ds_ck_ring_spsc_head __arena *he
 	if (!ds_ck_ring_spsc_is_power_of_two(capacity))
 		return DS_ERROR_INVALID;
 
-	slots = (struct ds_kv __arena *)bpf_arena_alloc(capacity * sizeof(*slots));
+	slots = (struct ds_kv __arena *)ds_arena_alloc_array((__u64)capacity * sizeof(*slots));
 	if (!slots)
 		return DS_ERROR_NOMEM;
 
@@ -97,6 +104,12 @@ static inline int ds_ck_ring_spsc_init_c(struct ds_ck_ring_spsc_head __arena *he
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_ring_spsc_init_c(struct ds_ck_ring_spsc_head __arena *head,
+					 __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_ck_ring_spsc_init_c(head, capacity));
+}
 #endif
 
 static inline int ds_ck_ring_spsc_init(struct ds_ck_ring_spsc_head __arena *head,
@@ -109,8 +122,8 @@ static inline int ds_ck_ring_spsc_init(struct ds_ck_ring_spsc_head __arena *head
 #endif
 }
 
-static inline int ds_ck_ring_spsc_insert_lkmm(struct ds_ck_ring_spsc_head __arena *head,
-				      __u64 key, __u64 value)
+static inline int __ds_ck_ring_spsc_insert_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+					__u64 key, __u64 value)
 {
 	__u32 producer;
 	__u32 consumer;
@@ -141,9 +154,15 @@ static inline int ds_ck_ring_spsc_insert_lkmm(struct ds_ck_ring_spsc_head __aren
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_ring_spsc_insert_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+				      __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_ck_ring_spsc_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_ring_spsc_insert_c(struct ds_ck_ring_spsc_head __arena *head,
-				   __u64 key, __u64 value)
+static inline int __ds_ck_ring_spsc_insert_c(struct ds_ck_ring_spsc_head __arena *head,
+				     __u64 key, __u64 value)
 {
 	__u32 producer;
 	__u32 consumer;
@@ -173,6 +192,12 @@ static inline int ds_ck_ring_spsc_insert_c(struct ds_ck_ring_spsc_head __arena *
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_ring_spsc_insert_c(struct ds_ck_ring_spsc_head __arena *head,
+				   __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_ck_ring_spsc_insert_c(head, key, value));
+}
 #endif
 
 static inline int ds_ck_ring_spsc_insert(struct ds_ck_ring_spsc_head __arena *head,
@@ -185,8 +210,8 @@ static inline int ds_ck_ring_spsc_insert(struct ds_ck_ring_spsc_head __arena *he
 #endif
 }
 
-static inline int ds_ck_ring_spsc_delete_lkmm(struct ds_ck_ring_spsc_head __arena *head,
-				      struct ds_kv *out)
+static inline int __ds_ck_ring_spsc_delete_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+					struct ds_kv *out)
 {
 	__u32 consumer;
 	__u32 producer;
@@ -222,9 +247,15 @@ static inline int ds_ck_ring_spsc_delete_lkmm(struct ds_ck_ring_spsc_head __aren
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_ring_spsc_delete_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+				      struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_ck_ring_spsc_delete_lkmm(head, out));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_ring_spsc_delete_c(struct ds_ck_ring_spsc_head __arena *head,
-				   struct ds_kv *out)
+static inline int __ds_ck_ring_spsc_delete_c(struct ds_ck_ring_spsc_head __arena *head,
+				     struct ds_kv *out)
 {
 	__u32 consumer;
 	__u32 producer;
@@ -258,6 +289,12 @@ static inline int ds_ck_ring_spsc_delete_c(struct ds_ck_ring_spsc_head __arena *
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_ring_spsc_delete_c(struct ds_ck_ring_spsc_head __arena *head,
+				   struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_ck_ring_spsc_delete_c(head, out));
+}
 #endif
 
 static inline int ds_ck_ring_spsc_delete(struct ds_ck_ring_spsc_head __arena *head,
@@ -276,6 +313,80 @@ static inline int ds_ck_ring_spsc_pop(struct ds_ck_ring_spsc_head __arena *head,
 	return ds_ck_ring_spsc_delete(head, out);
 }
 
+#ifndef __BPF__
+/*
+ * Batched handoff: one acquire of the peer index and one release of our
+ * own index per batch instead of per entry. Returns entries moved.
+ */
+static inline __u32 ds_ck_ring_spsc_insert_batch_c(struct ds_ck_ring_spsc_head __arena *head,
+						   const struct ds_kv *in, __u32 n)
+{
+	__u32 producer;
+	__u32 consumer;
+	__u32 space;
+	struct ds_kv __arena *slot;
+
+	if (!head || !in)
+		return 0;
+
+	cast_kern(head);
+	if (!head->slots)
+		return 0;
+
+	consumer = arena_atomic_load(&head->c_head, ARENA_ACQUIRE);
+	producer = arena_atomic_load(&head->p_tail, ARENA_RELAXED);
+	space = (consumer - producer - 1) & head->mask;
+	if (n > space)
+		n = space;
+
+	for (__u32 i = 0; i < n; i++) {
+		slot = &head->slots[(producer + i) & head->mask];
+		cast_kern(slot);
+		slot->key = in[i].key;
+		slot->value = in[i].value;
+	}
+
+	if (n)
+		arena_atomic_store(&head->p_tail, (producer + n) & head->mask, ARENA_RELEASE);
+
+	return n;
+}
+
+static inline __u32 ds_ck_ring_spsc_delete_batch_c(struct ds_ck_ring_spsc_head __arena *head,
+						   struct ds_kv *out, __u32 max)
+{
+	__u32 consumer;
+	__u32 producer;
+	__u32 n;
+	struct ds_kv __arena *slot;
+
+	if (!head || !out)
+		return 0;
+
+	cast_kern(head);
+	if (!head->slots)
+		return 0;
+
+	consumer = arena_atomic_load(&head->c_head, ARENA_RELAXED);
+	producer = arena_atomic_load(&head->p_tail, ARENA_ACQUIRE);
+	n = (producer - consumer) & head->mask;
+	if (n > max)
+		n = max;
+
+	for (__u32 i = 0; i < n; i++) {
+		slot = &head->slots[(consumer + i) & head->mask];
+		cast_kern(slot);
+		out[i].key = slot->key;
+		out[i].value = slot->value;
+	}
+
+	if (n)
+		arena_atomic_store(&head->c_head, (consumer + n) & head->mask, ARENA_RELEASE);
+
+	return n;
+}
+#endif
+
 static inline int ds_ck_ring_spsc_search(struct ds_ck_ring_spsc_head __arena *head,
 __u64 key)
 {
@@ -387,7 +498,7 @@ static inline bool ds_ck_ring_spsc_is_full(struct ds_ck_ring_spsc_head __arena *
 #endif
 }
 
-static inline int ds_ck_ring_spsc_verify_lkmm(struct ds_ck_ring_spsc_head __arena *head)
+static inline int __ds_ck_ring_spsc_verify_lkmm(struct ds_ck_ring_spsc_head __arena *head)
 {
 	__u32 capacity;
 	__u32 mask;
@@ -426,8 +537,13 @@ static inline int ds_ck_ring_spsc_verify_lkmm(struct ds_ck_ring_spsc_head __aren
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_ring_spsc_verify_lkmm(struct ds_ck_ring_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_ck_ring_spsc_verify_lkmm(head));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_ring_spsc_verify_c(struct ds_ck_ring_spsc_head __arena *head)
+static inline int __ds_ck_ring_spsc_verify_c(struct ds_ck_ring_spsc_head __arena *head)
 {
 	__u32 capacity;
 	__u32 mask;
@@ -465,6 +581,11 @@ static inline int ds_ck_ring_spsc_verify_c(struct ds_ck_ring_spsc_head __arena *
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_ring_spsc_verify_c(struct ds_ck_ring_spsc_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_ck_ring_spsc_verify_c(head));
+}
 #endif
 
 static inline int ds_ck_ring_spsc_verify(struct ds_ck_ring_spsc_head __arena *head)
@@ -476,4 +597,57 @@ static inline int ds_ck_ring_spsc_verify(struct ds_ck_ring_spsc_head __arena *he
 #endif
 }
 
+/**
+ * ds_ck_ring_spsc_stats - Occupancy, slot memory and per-op counters
+ * @head: Ring
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_ck_ring_spsc_stats_lkmm(struct ds_ck_ring_spsc_head __arena *head,
+					     struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = ds_ck_ring_spsc_size_lkmm(head);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->capacity * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_ck_ring_spsc_stats_c(struct ds_ck_ring_spsc_head __arena *head,
+					  struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = ds_ck_ring_spsc_size_c(head);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->capacity * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_ck_ring_spsc_stats(struct ds_ck_ring_spsc_head __arena *head,
+					struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_ck_ring_spsc_stats_lkmm(head, stats);
+#else
+	return ds_ck_ring_spsc_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_ck_ring_spsc_reset_stats(struct ds_ck_ring_spsc_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
+
 #endif /* DS_CK_RING_SPSC_H */
@@ -18,11 +18,12 @@ struct ds_ck_stack_upmc_entry {
 struct ds_ck_stack_upmc_head {
 	ds_ck_stack_upmc_entry_t *head;
 	__u64 count;
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_ck_stack_upmc_head __arena ds_ck_stack_upmc_head_t;
 
-static inline void ds_ck_stack_upmc_init_lkmm(ds_ck_stack_upmc_head_t *stack)
+static inline void __ds_ck_stack_upmc_init_lkmm(ds_ck_stack_upmc_head_t *stack)
 {
 	if (!stack)
 		return;
@@ -32,8 +33,13 @@ static inline void ds_ck_stack_upmc_init_lkmm(ds_ck_stack_upmc_head_t *stack)
 	WRITE_ONCE(stack->count, 0);
 }
 
+static inline void ds_ck_stack_upmc_init_lkmm(ds_ck_stack_upmc_head_t *stack)
+{
+	DS_OP_STATS_RUN_VOID(stack, DS_OP_INIT, __ds_ck_stack_upmc_init_lkmm(stack));
+}
+
 #ifndef __BPF__
-static inline void ds_ck_stack_upmc_init_c(ds_ck_stack_upmc_head_t *stack)
+static inline void __ds_ck_stack_upmc_init_c(ds_ck_stack_upmc_head_t *stack)
 {
 	if (!stack)
 		return;
@@ -42,6 +48,11 @@ static inline void ds_ck_stack_upmc_init_c(ds_ck_stack_upmc_head_t *stack)
 	arena_atomic_store(&stack->head, NULL, ARENA_RELAXED);
 	arena_atomic_store(&stack->count, 0, ARENA_RELAXED);
 }
+
+static inline void ds_ck_stack_upmc_init_c(ds_ck_stack_upmc_head_t *stack)
+{
+	DS_OP_STATS_RUN_VOID(stack, DS_OP_INIT, __ds_ck_stack_upmc_init_c(stack));
+}
 #endif
 
 static inline void ds_ck_stack_upmc_init(ds_ck_stack_upmc_head_t *stack)
@@ -138,6 +149,7 @@ static inline void ds_ck_stack_upmc_push_upmc_c(ds_ck_stack_upmc_head_t *stack,
 	do {
 		arena_atomic_store(&entry->next, head, ARENA_RELAXED);
 		cast_user(entry);
+		DS_PREEMPT_POINT();
 		observed = arena_atomic_cmpxchg(&stack->head, head, entry,
 					       ARENA_RELEASE, ARENA_RELAXED);
 		if (observed == head) {
@@ -277,6 +289,7 @@ ds_ck_stack_upmc_pop_upmc_c(ds_ck_stack_upmc_head_t *stack)
 	while (head != NULL && can_loop) {
 		cast_kern(head);
 		next = arena_atomic_load(&head->next, ARENA_RELAXED);
+		DS_PREEMPT_POINT();
 		observed = arena_atomic_cmpxchg(&stack->head, head, next,
 					       ARENA_ACQUIRE, ARENA_RELAXED);
 		if (observed == head) {
@@ -366,9 +379,9 @@ static inline bool ds_ck_stack_upmc_trypop_upmc(ds_ck_stack_upmc_head_t *stack,
 #endif
 }
 
-static inline int ds_ck_stack_upmc_insert_lkmm(ds_ck_stack_upmc_head_t *stack,
-					       __u64 key,
-					       __u64 value)
+static inline int __ds_ck_stack_upmc_insert_lkmm(ds_ck_stack_upmc_head_t *stack,
+						 __u64 key,
+						 __u64 value)
 {
 	ds_ck_stack_upmc_entry_t *entry;
 
@@ -384,10 +397,17 @@ static inline int ds_ck_stack_upmc_insert_lkmm(ds_ck_stack_upmc_head_t *stack,
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_stack_upmc_insert_lkmm(ds_ck_stack_upmc_head_t *stack,
+					       __u64 key,
+					       __u64 value)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_INSERT, __ds_ck_stack_upmc_insert_lkmm(stack, key, value));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_stack_upmc_insert_c(ds_ck_stack_upmc_head_t *stack,
-					    __u64 key,
-					    __u64 value)
+static inline int __ds_ck_stack_upmc_insert_c(ds_ck_stack_upmc_head_t *stack,
+					      __u64 key,
+					      __u64 value)
 {
 	ds_ck_stack_upmc_entry_t *entry;
 
@@ -402,6 +422,13 @@ static inline int ds_ck_stack_upmc_insert_c(ds_ck_stack_upmc_head_t *stack,
 	ds_ck_stack_upmc_push_upmc_c(stack, entry, key, value);
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_stack_upmc_insert_c(ds_ck_stack_upmc_head_t *stack,
+					    __u64 key,
+					    __u64 value)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_INSERT, __ds_ck_stack_upmc_insert_c(stack, key, value));
+}
 #endif
 
 static inline int ds_ck_stack_upmc_insert(ds_ck_stack_upmc_head_t *stack,
@@ -424,7 +451,7 @@ static inline int ds_ck_stack_upmc_delete(ds_ck_stack_upmc_head_t *stack, __u64
 	return DS_ERROR_INVALID;
 }
 
-static inline int ds_ck_stack_upmc_pop_lkmm(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
+static inline int __ds_ck_stack_upmc_pop_lkmm(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
 {
 	ds_ck_stack_upmc_entry_t *entry;
 
@@ -442,8 +469,13 @@ static inline int ds_ck_stack_upmc_pop_lkmm(ds_ck_stack_upmc_head_t *stack, stru
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_stack_upmc_pop_lkmm(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_POP, __ds_ck_stack_upmc_pop_lkmm(stack, out));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_stack_upmc_pop_c(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
+static inline int __ds_ck_stack_upmc_pop_c(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
 {
 	ds_ck_stack_upmc_entry_t *entry;
 
@@ -460,6 +492,11 @@ static inline int ds_ck_stack_upmc_pop_c(ds_ck_stack_upmc_head_t *stack, struct
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_stack_upmc_pop_c(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_POP, __ds_ck_stack_upmc_pop_c(stack, out));
+}
 #endif
 
 static inline int ds_ck_stack_upmc_pop(ds_ck_stack_upmc_head_t *stack, struct ds_kv *out)
@@ -471,7 +508,7 @@ static inline int ds_ck_stack_upmc_pop(ds_ck_stack_upmc_head_t *stack, struct ds
 #endif
 }
 
-static inline int ds_ck_stack_upmc_search_lkmm(ds_ck_stack_upmc_head_t *stack, __u64 key)
+static inline int __ds_ck_stack_upmc_search_lkmm(ds_ck_stack_upmc_head_t *stack, __u64 key)
 {
 	ds_ck_stack_upmc_entry_t *cursor;
 	int iterations;
@@ -490,8 +527,13 @@ static inline int ds_ck_stack_upmc_search_lkmm(ds_ck_stack_upmc_head_t *stack, _
 	return DS_ERROR_NOT_FOUND;
 }
 
+static inline int ds_ck_stack_upmc_search_lkmm(ds_ck_stack_upmc_head_t *stack, __u64 key)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_SEARCH, __ds_ck_stack_upmc_search_lkmm(stack, key));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_stack_upmc_search_c(ds_ck_stack_upmc_head_t *stack, __u64 key)
+static inline int __ds_ck_stack_upmc_search_c(ds_ck_stack_upmc_head_t *stack, __u64 key)
 {
 	ds_ck_stack_upmc_entry_t *cursor;
 	int iterations;
@@ -509,6 +551,11 @@ static inline int ds_ck_stack_upmc_search_c(ds_ck_stack_upmc_head_t *stack, __u6
 
 	return DS_ERROR_NOT_FOUND;
 }
+
+static inline int ds_ck_stack_upmc_search_c(ds_ck_stack_upmc_head_t *stack, __u64 key)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_SEARCH, __ds_ck_stack_upmc_search_c(stack, key));
+}
 #endif
 
 static inline int ds_ck_stack_upmc_search(ds_ck_stack_upmc_head_t *stack, __u64 key)
@@ -520,7 +567,7 @@ static inline int ds_ck_stack_upmc_search(ds_ck_stack_upmc_head_t *stack, __u64
 #endif
 }
 
-static inline int ds_ck_stack_upmc_verify_lkmm(ds_ck_stack_upmc_head_t *stack)
+static inline int __ds_ck_stack_upmc_verify_lkmm(ds_ck_stack_upmc_head_t *stack)
 {
 	ds_ck_stack_upmc_entry_t *slow;
 	ds_ck_stack_upmc_entry_t *fast;
@@ -554,8 +601,13 @@ static inline int ds_ck_stack_upmc_verify_lkmm(ds_ck_stack_upmc_head_t *stack)
 	return DS_SUCCESS;
 }
 
+static inline int ds_ck_stack_upmc_verify_lkmm(ds_ck_stack_upmc_head_t *stack)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_VERIFY, __ds_ck_stack_upmc_verify_lkmm(stack));
+}
+
 #ifndef __BPF__
-static inline int ds_ck_stack_upmc_verify_c(ds_ck_stack_upmc_head_t *stack)
+static inline int __ds_ck_stack_upmc_verify_c(ds_ck_stack_upmc_head_t *stack)
 {
 	ds_ck_stack_upmc_entry_t *slow;
 	ds_ck_stack_upmc_entry_t *fast;
@@ -588,6 +640,11 @@ static inline int ds_ck_stack_upmc_verify_c(ds_ck_stack_upmc_head_t *stack)
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_ck_stack_upmc_verify_c(ds_ck_stack_upmc_head_t *stack)
+{
+	return DS_OP_STATS_RUN(stack, DS_OP_VERIFY, __ds_ck_stack_upmc_verify_c(stack));
+}
 #endif
 
 static inline int ds_ck_stack_upmc_verify(ds_ck_stack_upmc_head_t *stack)
@@ -604,6 +661,7 @@ static inline int ds_ck_stack_upmc_stats_lkmm(ds_ck_stack_upmc_head_t *stack, st
 	if (!stack || !stats)
 		return DS_ERROR_INVALID;
 
+	ds_op_stats_read(DS_OP_STATS_ADDR(stack), stats);
 	stats->current_elements = READ_ONCE(stack->count);
 	stats->max_elements = 0;
 	stats->memory_used = 0;
@@ -616,6 +674,7 @@ static inline int ds_ck_stack_upmc_stats_c(ds_ck_stack_upmc_head_t *stack, struc
 	if (!stack || !stats)
 		return DS_ERROR_INVALID;
 
+	ds_op_stats_read(DS_OP_STATS_ADDR(stack), stats);
 	stats->current_elements = arena_atomic_load(&stack->count, ARENA_RELAXED);
 	stats->max_elements = 0;
 	stats->memory_used = 0;
@@ -632,4 +691,10 @@ static inline int ds_ck_stack_upmc_stats(ds_ck_stack_upmc_head_t *stack, struct
 #endif
 }
 
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_ck_stack_upmc_reset_stats(ds_ck_stack_upmc_head_t *stack)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(stack));
+}
+
 #endif
@@ -0,0 +1,322 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Source-Side Event Filter: Userspace Rules Consulted by BPF Producers
+ *
+ * Every lsm_inode_create becomes a KU entry today, including events the
+ * consumer throws away. This filter lets the BPF producer decide before
+ * it enqueues, using rules that userspace edits in the arena while the
+ * hook keeps running:
+ *
+ *   - a PID set (tgid) used as an allow list or a deny list
+ *   - a cgroup id set, the same way
+ *   - a default sampling rate N (keep about 1 in N events), with
+ *     optional per-PID or per-cgroup rates stored as the set's value
+ *
+ * Both sets are ds_rcu_table versions: userspace clones, edits and
+ * publishes them, and readers take a plain-load snapshot with a
+ * generation re-check. The mode flags and default rate share one 64-bit
+ * word, so one store changes them together. The read path never writes
+ * shared memory. Sampling uses a random number supplied by the caller
+ * (bpf_get_prandom_u32() in BPF), so no shared counter is involved.
+ *
+ * A lookup that keeps racing with reclaim fails open (the event is
+ * enqueued): a rule update must not make the hook lose events.
+ *
+ * Verdicts match the ds_metrics_store filter counters, so the hook can
+ * count each decision with ds_metrics_count_filter().
+ */
+#ifndef DS_FILTER_H
+#define DS_FILTER_H
+
+#pragma once
+
+#include "ds_api.h"
+#include "ds_metrics.h"
+#include "ds_rcu_table.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Mode flags; the ALLOW and DENY flags of one set are mutually exclusive */
+#define DS_FILTER_PID_ALLOW	(1U << 0) /* only PIDs in the set pass */
+#define DS_FILTER_PID_DENY	(1U << 1) /* PIDs in the set are dropped */
+#define DS_FILTER_CGROUP_ALLOW	(1U << 2) /* only cgroups in the set pass */
+#define DS_FILTER_CGROUP_DENY	(1U << 3) /* cgroups in the set are dropped */
+#define DS_FILTER_FLAGS_MASK	0xfU
+
+/* Verdicts (indices into ds_metrics_store::filter) */
+#define DS_FILTER_ENQUEUE	DS_METRICS_FILTER_ENQUEUED
+#define DS_FILTER_DROP_PID	DS_METRICS_FILTER_DROP_PID
+#define DS_FILTER_DROP_CGROUP	DS_METRICS_FILTER_DROP_CGROUP
+#define DS_FILTER_DROP_SAMPLE	DS_METRICS_FILTER_DROP_SAMPLE
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_filter_rules - Rule table shared with the BPF producer
+ * @config: Mode flags << 32 | default sample rate (0 or 1 = keep all)
+ * @pids: tgid -> sample rate override (0 = use the default)
+ * @cgroups: cgroup id -> sample rate override (0 = use the default)
+ *
+ * All-zero memory is a valid table that enqueues everything.
+ */
+struct ds_filter_rules {
+	__u64 config;
+	struct ds_rcu_table_head pids;
+	struct ds_rcu_table_head cgroups;
+};
+
+static inline __u64 ds_filter_pack_config(__u32 flags, __u32 rate)
+{
+	return ((__u64)flags << 32) | rate;
+}
+
+/* ========================================================================
+ * READ SIDE (lock-free, called by the producer before enqueue)
+ * ======================================================================== */
+
+/*
+ * Apply one set's rule. @found is 1 (in set), 0 (not in set) or -1
+ * (lookup kept racing reclaim: fail open, neither allow nor deny).
+ */
+static inline bool ds_filter_set_rejects(__u32 flags, __u32 allow, __u32 deny, int found)
+{
+	if (found < 0)
+		return false;
+	if ((flags & allow) && !found)
+		return true;
+	return (flags & deny) && found;
+}
+
+static inline int ds_filter_lookup_result(int ret)
+{
+	if (ret == DS_SUCCESS)
+		return 1;
+	return ret == DS_ERROR_BUSY ? -1 : 0;
+}
+
+/* Common tail: pick the rate (PID over cgroup over default) and sample */
+static inline int ds_filter_decide(__u32 flags, __u32 rate, int pid_found, __u64 pid_rate,
+				   int cg_found, __u64 cg_rate, __u32 rnd)
+{
+	if (ds_filter_set_rejects(flags, DS_FILTER_PID_ALLOW, DS_FILTER_PID_DENY, pid_found))
+		return DS_FILTER_DROP_PID;
+	if (ds_filter_set_rejects(flags, DS_FILTER_CGROUP_ALLOW, DS_FILTER_CGROUP_DENY, cg_found))
+		return DS_FILTER_DROP_CGROUP;
+
+	if (pid_found > 0 && pid_rate)
+		rate = (__u32)pid_rate;
+	else if (cg_found > 0 && cg_rate)
+		rate = (__u32)cg_rate;
+
+	if (rate > 1 && rnd % rate)
+		return DS_FILTER_DROP_SAMPLE;
+	return DS_FILTER_ENQUEUE;
+}
+
+/**
+ * ds_filter_check_lkmm - Decide whether an event should be enqueued
+ * @rules: Rule table
+ * @pid: Current tgid
+ * @cgroup_id: Current cgroup id (bpf_get_current_cgroup_id())
+ * @rnd: Uniform random number (bpf_get_prandom_u32())
+ *
+ * Costs one load when no rules are set, otherwise up to two bounded
+ * binary searches over snapshot-validated table versions.
+ *
+ * Returns: DS_FILTER_ENQUEUE or a DS_FILTER_DROP_* verdict
+ */
+static inline int ds_filter_check_lkmm(struct ds_filter_rules __arena *rules,
+				       __u64 pid, __u64 cgroup_id, __u32 rnd)
+{
+	__u64 pid_rate = 0, cg_rate = 0, cfg;
+	int pid_found, cg_found;
+
+	if (!rules)
+		return DS_FILTER_ENQUEUE;
+
+	cast_kern(rules);
+	cfg = READ_ONCE(rules->config);
+	if (!cfg)
+		return DS_FILTER_ENQUEUE;
+
+	pid_found = ds_filter_lookup_result(ds_rcu_table_lookup_lkmm(&rules->pids, pid,
+								     &pid_rate));
+	cg_found = ds_filter_lookup_result(ds_rcu_table_lookup_lkmm(&rules->cgroups, cgroup_id,
+								    &cg_rate));
+
+	return ds_filter_decide((__u32)(cfg >> 32), (__u32)cfg, pid_found, pid_rate,
+				cg_found, cg_rate, rnd);
+}
+
+#ifndef __BPF__
+static inline int ds_filter_check_c(struct ds_filter_rules __arena *rules,
+				    __u64 pid, __u64 cgroup_id, __u32 rnd)
+{
+	__u64 pid_rate = 0, cg_rate = 0, cfg;
+	int pid_found, cg_found;
+
+	if (!rules)
+		return DS_FILTER_ENQUEUE;
+
+	cast_kern(rules);
+	cfg = arena_atomic_load(&rules->config, ARENA_RELAXED);
+	if (!cfg)
+		return DS_FILTER_ENQUEUE;
+
+	pid_found = ds_filter_lookup_result(ds_rcu_table_lookup_c(&rules->pids, pid,
+								  &pid_rate));
+	cg_found = ds_filter_lookup_result(ds_rcu_table_lookup_c(&rules->cgroups, cgroup_id,
+								 &cg_rate));
+
+	return ds_filter_decide((__u32)(cfg >> 32), (__u32)cfg, pid_found, pid_rate,
+				cg_found, cg_rate, rnd);
+}
+#endif
+
+static inline int ds_filter_check(struct ds_filter_rules __arena *rules,
+				  __u64 pid, __u64 cgroup_id, __u32 rnd)
+{
+#ifdef __BPF__
+	return ds_filter_check_lkmm(rules, pid, cgroup_id, rnd);
+#else
+	return ds_filter_check_c(rules, pid, cgroup_id, rnd);
+#endif
+}
+
+/* ========================================================================
+ * WRITE SIDE (userspace only, single writer)
+ * ======================================================================== */
+
+#ifndef __BPF__
+
+/**
+ * ds_filter_init_c - Reset to the pass-everything table
+ * @rules: Rule table in arena memory
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int ds_filter_init_c(struct ds_filter_rules __arena *rules)
+{
+	if (!rules)
+		return DS_ERROR_INVALID;
+
+	arena_atomic_store(&rules->config, 0, ARENA_RELAXED);
+	if (ds_rcu_table_init_c(&rules->pids) != DS_SUCCESS ||
+	    ds_rcu_table_init_c(&rules->cgroups) != DS_SUCCESS)
+		return DS_ERROR_INVALID;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_filter_set_mode_c - Change the mode flags and default rate in place
+ * @rules: Rule table
+ * @flags: DS_FILTER_* mode flags
+ * @rate: Keep about 1 in @rate events (0 or 1 = keep all)
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int ds_filter_set_mode_c(struct ds_filter_rules __arena *rules,
+				       __u32 flags, __u32 rate)
+{
+	if (!rules || (flags & ~DS_FILTER_FLAGS_MASK))
+		return DS_ERROR_INVALID;
+	if ((flags & DS_FILTER_PID_ALLOW) && (flags & DS_FILTER_PID_DENY))
+		return DS_ERROR_INVALID;
+	if ((flags & DS_FILTER_CGROUP_ALLOW) && (flags & DS_FILTER_CGROUP_DENY))
+		return DS_ERROR_INVALID;
+
+	arena_atomic_store(&rules->config, ds_filter_pack_config(flags, rate), ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+
+/* Clone, edit one key, publish: one new version per update */
+static inline int ds_filter_update_c(struct ds_rcu_table_head __arena *set, __u64 key,
+				     __u32 rate, bool del)
+{
+	ds_rcu_table_ver_t *ver;
+	int ret;
+
+	ver = ds_rcu_table_ver_clone_c(set);
+	if (!ver)
+		return DS_ERROR_NOMEM;
+
+	ret = del ? ds_rcu_table_ver_del_c(ver, key) : ds_rcu_table_ver_set_c(ver, key, rate);
+	if (ret != DS_SUCCESS) {
+		bpf_arena_free(ver);
+		return ret;
+	}
+	return ds_rcu_table_publish_c(set, ver);
+}
+
+/**
+ * ds_filter_pid_set_c - Add or update a PID
+ * @rules: Rule table
+ * @pid: tgid
+ * @rate: Per-PID sample rate, 0 to use the default
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_FULL, or DS_ERROR_NOMEM
+ */
+static inline int ds_filter_pid_set_c(struct ds_filter_rules __arena *rules,
+				      __u64 pid, __u32 rate)
+{
+	return ds_filter_update_c(&rules->pids, pid, rate, false);
+}
+
+static inline int ds_filter_pid_del_c(struct ds_filter_rules __arena *rules, __u64 pid)
+{
+	return ds_filter_update_c(&rules->pids, pid, 0, true);
+}
+
+static inline int ds_filter_cgroup_set_c(struct ds_filter_rules __arena *rules,
+					 __u64 cgroup_id, __u32 rate)
+{
+	return ds_filter_update_c(&rules->cgroups, cgroup_id, rate, false);
+}
+
+static inline int ds_filter_cgroup_del_c(struct ds_filter_rules __arena *rules,
+					 __u64 cgroup_id)
+{
+	return ds_filter_update_c(&rules->cgroups, cgroup_id, 0, true);
+}
+
+/* Free retired set versions after a grace period */
+static inline int ds_filter_reclaim_c(struct ds_filter_rules __arena *rules)
+{
+	return ds_rcu_table_reclaim_c(&rules->pids) + ds_rcu_table_reclaim_c(&rules->cgroups);
+}
+
+#endif /* !__BPF__ */
+
+/* ========================================================================
+ * VERIFY / METADATA
+ * ======================================================================== */
+
+static inline int ds_filter_verify(struct ds_filter_rules __arena *rules)
+{
+	int ret;
+
+	if (!rules)
+		return DS_ERROR_INVALID;
+
+	cast_kern(rules);
+	ret = ds_rcu_table_verify(&rules->pids);
+	if (ret != DS_SUCCESS)
+		return ret;
+	return ds_rcu_table_verify(&rules->cgroups);
+}
+
+static inline const struct ds_metadata *ds_filter_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "filter",
+		.description = "Userspace-managed PID/cgroup/sampling rules checked before enqueue",
+		.node_size = sizeof(struct ds_filter_rules),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+#endif /* DS_FILTER_H */
@@ -58,6 +58,7 @@ struct ds_spsc_queue_head {
 
 	__u32 size;             /* Total number of slots (capacity + 1) */
 	struct ds_kv __arena *records; /* Pointer to contiguous array */
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_spsc_queue_head __arena ds_spsc_queue_head_t;
@@ -76,7 +77,7 @@ typedef struct ds_spsc_queue_head __arena ds_spsc_queue_head_t;
  * Returns: DS_SUCCESS or DS_ERROR_*
  */
 static inline __attribute__((unused))
-int ds_spsc_init_lkmm(struct ds_spsc_queue_head __arena *head, __u32 size)
+int __ds_spsc_init_lkmm(struct ds_spsc_queue_head __arena *head, __u32 size)
 {
 	struct ds_kv __arena *records;
 	
@@ -85,7 +86,7 @@ int ds_spsc_init_lkmm(struct ds_spsc_queue_head __arena *head, __u32 size)
 		return DS_ERROR_INVALID;
 
 	/* Allocate contiguous array for records */
-	records = bpf_arena_alloc(size * sizeof(struct ds_kv));
+	records = ds_arena_alloc_array((__u64)size * sizeof(struct ds_kv));
 	if (!records)
 		return DS_ERROR_NOMEM;
 	
@@ -105,9 +106,15 @@ int ds_spsc_init_lkmm(struct ds_spsc_queue_head __arena *head, __u32 size)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_spsc_init_lkmm(struct ds_spsc_queue_head __arena *head, __u32 size)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_spsc_init_lkmm(head, size));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_spsc_init_c(struct ds_spsc_queue_head __arena *head, __u32 size)
+int __ds_spsc_init_c(struct ds_spsc_queue_head __arena *head, __u32 size)
 {
 	struct ds_kv __arena *records;
 
@@ -115,7 +122,7 @@ int ds_spsc_init_c(struct ds_spsc_queue_head __arena *head, __u32 size)
 	if (size < 2)
 		return DS_ERROR_INVALID;
 
-	records = bpf_arena_alloc(size * sizeof(struct ds_kv));
+	records = ds_arena_alloc_array((__u64)size * sizeof(struct ds_kv));
 	if (!records)
 		return DS_ERROR_NOMEM;
 
@@ -130,6 +137,12 @@ int ds_spsc_init_c(struct ds_spsc_queue_head __arena *head, __u32 size)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_spsc_init_c(struct ds_spsc_queue_head __arena *head, __u32 size)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_spsc_init_c(head, size));
+}
 #endif
 
 static inline __attribute__((unused))
@@ -154,7 +167,7 @@ int ds_spsc_init(struct ds_spsc_queue_head __arena *head, __u32 size)
  * Returns: DS_SUCCESS or DS_ERROR_FULL
  */
 static inline __attribute__((unused))
-int ds_spsc_insert_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
+int __ds_spsc_insert_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
 {
 	cast_kern(head);
 	
@@ -188,9 +201,15 @@ int ds_spsc_insert_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key, __u6
 	return DS_ERROR_FULL;
 }
 
+static inline __attribute__((unused))
+int ds_spsc_insert_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_spsc_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_spsc_insert_c(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
+int __ds_spsc_insert_c(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
 {
 	cast_kern(head);
 
@@ -213,6 +232,12 @@ int ds_spsc_insert_c(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 v
 
 	return DS_ERROR_FULL;
 }
+
+static inline __attribute__((unused))
+int ds_spsc_insert_c(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_spsc_insert_c(head, key, value));
+}
 #endif
 
 static inline __attribute__((unused))
@@ -239,7 +264,7 @@ int ds_spsc_insert(struct ds_spsc_queue_head __arena *head, __u64 key, __u64 val
  * Returns: DS_SUCCESS or DS_ERROR_NOT_FOUND (empty)
  */
 static inline __attribute__((unused))
-int ds_spsc_delete_lkmm(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
+int __ds_spsc_delete_lkmm(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
 {
 	cast_kern(head);
 
@@ -273,9 +298,15 @@ int ds_spsc_delete_lkmm(struct ds_spsc_queue_head __arena *head, struct ds_kv *d
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_spsc_delete_lkmm(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_spsc_delete_lkmm(head, data));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_spsc_delete_c(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
+int __ds_spsc_delete_c(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
 {
 	cast_kern(head);
 
@@ -299,6 +330,12 @@ int ds_spsc_delete_c(struct ds_spsc_queue_head __arena *head, struct ds_kv *data
 	arena_atomic_store(&head->read_idx.idx, next_record, ARENA_RELEASE);
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_spsc_delete_c(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_spsc_delete_c(head, data));
+}
 #endif
 
 static inline __attribute__((unused))
@@ -349,7 +386,7 @@ int ds_spsc_pop(struct ds_spsc_queue_head __arena *head, struct ds_kv *data)
  * Returns: DS_ERROR_INVALID (unsupported operation)
  */
 static inline __attribute__((unused))
-int ds_spsc_search_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key)
+int __ds_spsc_search_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key)
 {
 	/* Search is not practical for SPSC queue - it's a FIFO structure */
 	(void)head;
@@ -357,14 +394,26 @@ int ds_spsc_search_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key)
 	return DS_ERROR_INVALID;
 }
 
+static inline __attribute__((unused))
+int ds_spsc_search_lkmm(struct ds_spsc_queue_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_spsc_search_lkmm(head, key));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_spsc_search_c(struct ds_spsc_queue_head __arena *head, __u64 key)
+int __ds_spsc_search_c(struct ds_spsc_queue_head __arena *head, __u64 key)
 {
 	(void)head;
 	(void)key;
 	return DS_ERROR_INVALID;
 }
+
+static inline __attribute__((unused))
+int ds_spsc_search_c(struct ds_spsc_queue_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_spsc_search_c(head, key));
+}
 #endif
 
 static inline __attribute__((unused))
@@ -386,7 +435,7 @@ int ds_spsc_search(struct ds_spsc_queue_head __arena *head, __u64 key)
  * Returns: DS_SUCCESS or DS_ERROR_CORRUPT
  */
 static inline __attribute__((unused))
-int ds_spsc_verify_lkmm(struct ds_spsc_queue_head __arena *head)
+int __ds_spsc_verify_lkmm(struct ds_spsc_queue_head __arena *head)
 {
 	cast_kern(head);
 	
@@ -410,9 +459,15 @@ int ds_spsc_verify_lkmm(struct ds_spsc_queue_head __arena *head)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_spsc_verify_lkmm(struct ds_spsc_queue_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_spsc_verify_lkmm(head));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_spsc_verify_c(struct ds_spsc_queue_head __arena *head)
+int __ds_spsc_verify_c(struct ds_spsc_queue_head __arena *head)
 {
 	cast_kern(head);
 
@@ -432,6 +487,12 @@ int ds_spsc_verify_c(struct ds_spsc_queue_head __arena *head)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_spsc_verify_c(struct ds_spsc_queue_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_spsc_verify_c(head));
+}
 #endif
 
 static inline __attribute__((unused))
@@ -584,3 +645,57 @@ bool ds_spsc_is_full(struct ds_spsc_queue_head __arena *head)
 	return ds_spsc_is_full_c(head);
 #endif
 }
+
+/**
+ * ds_spsc_stats - Occupancy, slot memory and per-op counters
+ * @head: Queue
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline __attribute__((unused))
+int ds_spsc_stats_lkmm(struct ds_spsc_queue_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = ds_spsc_size_lkmm(head);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->size * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline __attribute__((unused))
+int ds_spsc_stats_c(struct ds_spsc_queue_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = ds_spsc_size_c(head);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->size * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+#endif
+
+static inline __attribute__((unused))
+int ds_spsc_stats(struct ds_spsc_queue_head __arena *head, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_spsc_stats_lkmm(head, stats);
+#else
+	return ds_spsc_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline __attribute__((unused))
+void ds_spsc_reset_stats(struct ds_spsc_queue_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
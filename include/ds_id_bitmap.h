@@ -0,0 +1,753 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Hierarchical Bitmap ID Allocator for BPF Arena
+ *
+ * Hands out small integer handles (0 .. nr_ids-1) for in-flight events
+ * from BPF and userspace alike, without a lock.
+ *
+ * Layout: three levels of 64-bit words. A leaf bit is one ID (1 = in
+ * use). A mid bit says its leaf word is full, and a top bit says its mid
+ * word is full, so a search reads at most one word per level:
+ *
+ *   top[t]  bit m  -> mid[t*64 + m] == ~0
+ *   mid[m]  bit l  -> leaf[m*64 + l] == ~0
+ *   leaf[l] bit b  -> ID l*64 + b allocated
+ *
+ * Acquire: try the CPU's hint leaf (find_first_zero + CAS); if it is full,
+ * pick the first non-full leaf under the hint's mid word, then under the
+ * top level, and move the hint there. Each CPU starts on its own stretch
+ * of leaves, so allocators on different CPUs rarely share a line.
+ *
+ * Release: one fetch-and on the leaf word. Only the full <-> not-full
+ * transitions touch the summary levels.
+ *
+ * Summary bits are hints. Setting a "full" bit races with a release that
+ * empties a bit underneath, so a setter re-reads the child after the
+ * fetch-or and clears the bit again if the child is no longer full.
+ * Each side's RMW is fully ordered against its following re-read (BPF
+ * fetch atomics or a full barrier; seq_cst in userspace), so either the
+ * setter sees the release or the release sees the set bit and clears it:
+ * no ID is hidden behind a stale "full" bit once both sides return. A
+ * stale "not full" bit only costs a retry.
+ *
+ * Loops are bounded by DS_ID_BITMAP_RETRIES and the fixed level sizes, so
+ * the _lkmm variants pass the verifier with can_loop.
+ */
+#ifndef DS_ID_BITMAP_H
+#define DS_ID_BITMAP_H
+
+#pragma once
+
+#include "ds_api.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Compile-time capacity; a multiple of 4096 (one full mid word) */
+#ifndef DS_ID_BITMAP_MAX_IDS
+#define DS_ID_BITMAP_MAX_IDS (1U << 18)
+#endif
+
+#define DS_ID_BITMAP_LEAF_WORDS (DS_ID_BITMAP_MAX_IDS / 64)
+#define DS_ID_BITMAP_MID_WORDS (DS_ID_BITMAP_MAX_IDS / 4096)
+#define DS_ID_BITMAP_TOP_WORDS ((DS_ID_BITMAP_MID_WORDS + 63) / 64)
+
+/* Per-CPU hint slots; CPUs beyond this share hints. Power of 2. */
+#define DS_ID_BITMAP_HINTS 64
+
+/* Bound on CAS retries / leaf re-selections per acquire */
+#define DS_ID_BITMAP_RETRIES 16
+
+#define DS_ID_BITMAP_FULL (~0ULL)
+
+_Static_assert(DS_ID_BITMAP_MAX_IDS % 4096 == 0,
+	       "DS_ID_BITMAP_MAX_IDS must be a multiple of 4096");
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_id_bitmap_hint - Per-CPU starting leaf, one cache line each
+ * @leaf: Leaf word index the CPU allocated from last
+ */
+struct ds_id_bitmap_hint {
+	__u32 leaf;
+	__u32 pad[15];
+};
+
+/**
+ * struct ds_id_bitmap - ID allocator state
+ * @nr_ids: Number of usable IDs (<= DS_ID_BITMAP_MAX_IDS)
+ * @nr_leaves: Leaf words covering @nr_ids
+ * @top: Level 2 summary (bit set = mid word full)
+ * @mid: Level 1 summary (bit set = leaf word full)
+ * @leaf: Level 0 (bit set = ID allocated); bits >= nr_ids stay set
+ * @hints: Per-CPU starting leaf
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
+ */
+struct ds_id_bitmap {
+	__u32 nr_ids;
+	__u32 nr_leaves;
+	__u64 top[DS_ID_BITMAP_TOP_WORDS];
+	__u64 mid[DS_ID_BITMAP_MID_WORDS];
+	__u64 leaf[DS_ID_BITMAP_LEAF_WORDS];
+	struct ds_id_bitmap_hint hints[DS_ID_BITMAP_HINTS];
+	DS_OP_STATS_FIELD
+};
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+/*
+ * Index of the lowest clear bit; @w must not be DS_ID_BITMAP_FULL. BPF has
+ * no count-trailing-zeros instruction, so the BPF side bisects.
+ */
+static inline __u32 ds_id_bitmap_ffz(__u64 w)
+{
+#ifdef __BPF__
+	__u32 n = 0;
+
+	w = ~w;
+	if (!(w & 0xffffffffULL)) {
+		n += 32;
+		w >>= 32;
+	}
+	if (!(w & 0xffffULL)) {
+		n += 16;
+		w >>= 16;
+	}
+	if (!(w & 0xffULL)) {
+		n += 8;
+		w >>= 8;
+	}
+	if (!(w & 0xfULL)) {
+		n += 4;
+		w >>= 4;
+	}
+	if (!(w & 0x3ULL)) {
+		n += 2;
+		w >>= 2;
+	}
+	if (!(w & 0x1ULL))
+		n += 1;
+	return n;
+#else
+	return (__u32)__builtin_ctzll(~w);
+#endif
+}
+
+/* ========================================================================
+ * INIT
+ * ======================================================================== */
+
+/**
+ * ds_id_bitmap_init_lkmm - Initialize with all IDs free
+ * @b: Allocator
+ * @nr_ids: Number of IDs, 1 .. DS_ID_BITMAP_MAX_IDS
+ *
+ * Not concurrent with acquire/release.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int __ds_id_bitmap_init_lkmm(struct ds_id_bitmap __arena *b, __u32 nr_ids)
+{
+	cast_kern(b);
+	if (!b || !nr_ids || nr_ids > DS_ID_BITMAP_MAX_IDS)
+		return DS_ERROR_INVALID;
+
+	b->nr_ids = nr_ids;
+	b->nr_leaves = (nr_ids + 63) / 64;
+
+	for (__u32 t = 0; t < DS_ID_BITMAP_TOP_WORDS && can_loop; t++)
+		b->top[t] = 0;
+	for (__u32 m = 0; m < DS_ID_BITMAP_MID_WORDS && can_loop; m++)
+		b->mid[m] = 0;
+
+	/* IDs past nr_ids are permanently "allocated" */
+	for (__u32 l = 0; l < DS_ID_BITMAP_LEAF_WORDS && can_loop; l++) {
+		__u32 base = l * 64;
+		__u64 w = 0;
+
+		if (base >= nr_ids)
+			w = DS_ID_BITMAP_FULL;
+		else if (nr_ids - base < 64)
+			w = DS_ID_BITMAP_FULL << (nr_ids - base);
+		b->leaf[l] = w;
+		if (w == DS_ID_BITMAP_FULL)
+			b->mid[l / 64] |= 1ULL << (l % 64);
+	}
+
+	for (__u32 m = 0; m < DS_ID_BITMAP_TOP_WORDS * 64 && can_loop; m++)
+		if (m >= DS_ID_BITMAP_MID_WORDS || b->mid[m] == DS_ID_BITMAP_FULL)
+			b->top[m / 64] |= 1ULL << (m % 64);
+
+	for (__u32 c = 0; c < DS_ID_BITMAP_HINTS && can_loop; c++)
+		b->hints[c].leaf = (__u32)(((__u64)c * b->nr_leaves) / DS_ID_BITMAP_HINTS);
+
+	barrier();
+	return DS_SUCCESS;
+}
+
+static inline int ds_id_bitmap_init_lkmm(struct ds_id_bitmap __arena *b, __u32 nr_ids)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_INIT, __ds_id_bitmap_init_lkmm(b, nr_ids));
+}
+
+#ifndef __BPF__
+static inline int __ds_id_bitmap_init_c(struct ds_id_bitmap __arena *b, __u32 nr_ids)
+{
+	if (!b || !nr_ids || nr_ids > DS_ID_BITMAP_MAX_IDS)
+		return DS_ERROR_INVALID;
+
+	b->nr_ids = nr_ids;
+	b->nr_leaves = (nr_ids + 63) / 64;
+
+	for (__u32 t = 0; t < DS_ID_BITMAP_TOP_WORDS; t++)
+		b->top[t] = 0;
+	for (__u32 m = 0; m < DS_ID_BITMAP_MID_WORDS; m++)
+		b->mid[m] = 0;
+
+	for (__u32 l = 0; l < DS_ID_BITMAP_LEAF_WORDS; l++) {
+		__u32 base = l * 64;
+		__u64 w = 0;
+
+		if (base >= nr_ids)
+			w = DS_ID_BITMAP_FULL;
+		else if (nr_ids - base < 64)
+			w = DS_ID_BITMAP_FULL << (nr_ids - base);
+		b->leaf[l] = w;
+		if (w == DS_ID_BITMAP_FULL)
+			b->mid[l / 64] |= 1ULL << (l % 64);
+	}
+
+	for (__u32 m = 0; m < DS_ID_BITMAP_TOP_WORDS * 64; m++)
+		if (m >= DS_ID_BITMAP_MID_WORDS || b->mid[m] == DS_ID_BITMAP_FULL)
+			b->top[m / 64] |= 1ULL << (m % 64);
+
+	for (__u32 c = 0; c < DS_ID_BITMAP_HINTS; c++)
+		b->hints[c].leaf = (__u32)(((__u64)c * b->nr_leaves) / DS_ID_BITMAP_HINTS);
+
+	__atomic_thread_fence(ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+
+static inline int ds_id_bitmap_init_c(struct ds_id_bitmap __arena *b, __u32 nr_ids)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_INIT, __ds_id_bitmap_init_c(b, nr_ids));
+}
+#endif
+
+static inline int ds_id_bitmap_init(struct ds_id_bitmap __arena *b, __u32 nr_ids)
+{
+#ifdef __BPF__
+	return ds_id_bitmap_init_lkmm(b, nr_ids);
+#else
+	return ds_id_bitmap_init_c(b, nr_ids);
+#endif
+}
+
+/* ========================================================================
+ * SUMMARY MAINTENANCE
+ * ======================================================================== */
+
+/* Leaf @l went not-full: clear its mid bit, and the top bit if mid was full */
+static inline void ds_id_bitmap_mark_avail_lkmm(struct ds_id_bitmap __arena *b, __u32 l)
+{
+	__u32 m = l / 64;
+	__u64 mb = 1ULL << (l % 64);
+	__u64 tb = 1ULL << (m % 64);
+	__u64 old;
+
+	old = arena_atomic_and(&b->mid[m], ~mb, ARENA_RELAXED);
+	if (old == DS_ID_BITMAP_FULL || (READ_ONCE(b->top[m / 64]) & tb))
+		arena_atomic_and(&b->top[m / 64], ~tb, ARENA_RELAXED);
+}
+
+/*
+ * Leaf @l went full: publish it upward, then undo if a release raced in.
+ * An atomic whose result is unused compiles to a non-fetch BPF atomic,
+ * which is unordered, so each re-check sits behind a full barrier.
+ */
+static inline void ds_id_bitmap_mark_full_lkmm(struct ds_id_bitmap __arena *b, __u32 l)
+{
+	__u32 m = l / 64;
+	__u64 mb = 1ULL << (l % 64);
+	__u64 tb = 1ULL << (m % 64);
+	__u64 old;
+
+	old = arena_atomic_or(&b->mid[m], mb, ARENA_RELAXED);
+	if ((old | mb) == DS_ID_BITMAP_FULL) {
+		arena_atomic_or(&b->top[m / 64], tb, ARENA_RELAXED);
+		arena_smp_mb();
+		if (READ_ONCE(b->mid[m]) != DS_ID_BITMAP_FULL)
+			arena_atomic_and(&b->top[m / 64], ~tb, ARENA_RELAXED);
+	}
+
+	arena_smp_mb();
+	if (READ_ONCE(b->leaf[l]) != DS_ID_BITMAP_FULL)
+		ds_id_bitmap_mark_avail_lkmm(b, l);
+}
+
+#ifndef __BPF__
+static inline void ds_id_bitmap_mark_avail_c(struct ds_id_bitmap __arena *b, __u32 l)
+{
+	__u32 m = l / 64;
+	__u64 mb = 1ULL << (l % 64);
+	__u64 tb = 1ULL << (m % 64);
+	__u64 old;
+
+	old = arena_atomic_and(&b->mid[m], ~mb, ARENA_SEQ_CST);
+	if (old == DS_ID_BITMAP_FULL ||
+	    (arena_atomic_load(&b->top[m / 64], ARENA_SEQ_CST) & tb))
+		arena_atomic_and(&b->top[m / 64], ~tb, ARENA_SEQ_CST);
+}
+
+static inline void ds_id_bitmap_mark_full_c(struct ds_id_bitmap __arena *b, __u32 l)
+{
+	__u32 m = l / 64;
+	__u64 mb = 1ULL << (l % 64);
+	__u64 tb = 1ULL << (m % 64);
+	__u64 old;
+
+	old = arena_atomic_or(&b->mid[m], mb, ARENA_SEQ_CST);
+	if ((old | mb) == DS_ID_BITMAP_FULL) {
+		arena_atomic_or(&b->top[m / 64], tb, ARENA_SEQ_CST);
+		if (arena_atomic_load(&b->mid[m], ARENA_SEQ_CST) != DS_ID_BITMAP_FULL)
+			arena_atomic_and(&b->top[m / 64], ~tb, ARENA_SEQ_CST);
+	}
+
+	if (arena_atomic_load(&b->leaf[l], ARENA_SEQ_CST) != DS_ID_BITMAP_FULL)
+		ds_id_bitmap_mark_avail_c(b, l);
+}
+#endif
+
+/* ========================================================================
+ * ACQUIRE
+ * ======================================================================== */
+
+/*
+ * Claim the lowest free bit of leaf @l. Returns DS_SUCCESS, DS_ERROR_FULL
+ * if the leaf has no free bit, or DS_ERROR_BUSY after repeated CAS loss.
+ */
+static inline int ds_id_bitmap_try_leaf_lkmm(struct ds_id_bitmap __arena *b, __u32 l,
+					     __u32 *id)
+{
+	for (int i = 0; i < DS_ID_BITMAP_RETRIES && can_loop; i++) {
+		__u64 w = READ_ONCE(b->leaf[l]);
+		__u64 nw;
+		__u32 bit;
+
+		if (w == DS_ID_BITMAP_FULL) {
+			ds_id_bitmap_mark_full_lkmm(b, l);
+			return DS_ERROR_FULL;
+		}
+
+		bit = ds_id_bitmap_ffz(w);
+		nw = w | (1ULL << bit);
+		if (arena_atomic_cmpxchg(&b->leaf[l], w, nw, ARENA_ACQUIRE, ARENA_RELAXED) != w)
+			continue;
+
+		if (nw == DS_ID_BITMAP_FULL)
+			ds_id_bitmap_mark_full_lkmm(b, l);
+		*id = l * 64 + bit;
+		return DS_SUCCESS;
+	}
+	return DS_ERROR_BUSY;
+}
+
+/*
+ * Next leaf to try after @l failed: first non-full leaf under @l's mid
+ * word, else under the first non-full top-level entry.
+ * Returns DS_ERROR_FULL if the summaries report no free ID.
+ */
+static inline int ds_id_bitmap_pick_leaf_lkmm(struct ds_id_bitmap __arena *b, __u32 l,
+					      __u32 *next)
+{
+	__u32 m = l / 64;
+	__u64 w = READ_ONCE(b->mid[m]);
+
+	if (w != DS_ID_BITMAP_FULL) {
+		*next = m * 64 + ds_id_bitmap_ffz(w);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 t = 0; t < DS_ID_BITMAP_TOP_WORDS && can_loop; t++) {
+		w = READ_ONCE(b->top[t]);
+		if (w == DS_ID_BITMAP_FULL)
+			continue;
+
+		m = t * 64 + ds_id_bitmap_ffz(w);
+		if (m >= DS_ID_BITMAP_MID_WORDS)
+			return DS_ERROR_FULL;
+		w = READ_ONCE(b->mid[m]);
+		if (w == DS_ID_BITMAP_FULL) {
+			/* Stale top bit; fall back to the first leaf under it */
+			*next = m * 64;
+			return DS_SUCCESS;
+		}
+		*next = m * 64 + ds_id_bitmap_ffz(w);
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_FULL;
+}
+
+#ifdef __BPF__
+/**
+ * ds_id_bitmap_acquire_lkmm - Allocate an ID
+ * @b: Allocator
+ * @id: Output ID
+ *
+ * Starts from the current CPU's hint leaf. Never allocates memory, so it
+ * may run from any program type.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_FULL (no free ID) or DS_ERROR_BUSY
+ *          (retry budget exhausted under contention)
+ */
+static inline int __ds_id_bitmap_acquire_lkmm(struct ds_id_bitmap __arena *b, __u32 *id)
+{
+	struct ds_id_bitmap_hint __arena *hint;
+	int ret = DS_ERROR_BUSY;
+	__u32 l;
+
+	if (!b || !id)
+		return DS_ERROR_INVALID;
+
+	hint = &b->hints[bpf_get_smp_processor_id() & (DS_ID_BITMAP_HINTS - 1)];
+	l = READ_ONCE(hint->leaf);
+
+	for (int i = 0; i < DS_ID_BITMAP_RETRIES && can_loop; i++) {
+		if (l < DS_ID_BITMAP_LEAF_WORDS) {
+			ret = ds_id_bitmap_try_leaf_lkmm(b, l, id);
+			if (ret == DS_SUCCESS) {
+				if (i)
+					WRITE_ONCE(hint->leaf, l);
+				return DS_SUCCESS;
+			}
+		} else {
+			l = 0;
+		}
+
+		if (ds_id_bitmap_pick_leaf_lkmm(b, l, &l) != DS_SUCCESS)
+			return DS_ERROR_FULL;
+	}
+
+	return ret == DS_ERROR_FULL ? DS_ERROR_FULL : DS_ERROR_BUSY;
+}
+
+static inline int ds_id_bitmap_acquire_lkmm(struct ds_id_bitmap __arena *b, __u32 *id)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_INSERT, __ds_id_bitmap_acquire_lkmm(b, id));
+}
+#endif
+
+#ifndef __BPF__
+static inline int ds_id_bitmap_try_leaf_c(struct ds_id_bitmap __arena *b, __u32 l, __u32 *id)
+{
+	for (int i = 0; i < DS_ID_BITMAP_RETRIES; i++) {
+		__u64 w = arena_atomic_load(&b->leaf[l], ARENA_RELAXED);
+		__u64 nw;
+		__u32 bit;
+
+		if (w == DS_ID_BITMAP_FULL) {
+			ds_id_bitmap_mark_full_c(b, l);
+			return DS_ERROR_FULL;
+		}
+
+		bit = ds_id_bitmap_ffz(w);
+		nw = w | (1ULL << bit);
+		if (arena_atomic_cmpxchg(&b->leaf[l], w, nw, ARENA_SEQ_CST, ARENA_RELAXED) != w)
+			continue;
+
+		if (nw == DS_ID_BITMAP_FULL)
+			ds_id_bitmap_mark_full_c(b, l);
+		*id = l * 64 + bit;
+		return DS_SUCCESS;
+	}
+	return DS_ERROR_BUSY;
+}
+
+static inline int ds_id_bitmap_pick_leaf_c(struct ds_id_bitmap __arena *b, __u32 l,
+					   __u32 *next)
+{
+	__u32 m = l / 64;
+	__u64 w = arena_atomic_load(&b->mid[m], ARENA_RELAXED);
+
+	if (w != DS_ID_BITMAP_FULL) {
+		*next = m * 64 + ds_id_bitmap_ffz(w);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 t = 0; t < DS_ID_BITMAP_TOP_WORDS; t++) {
+		w = arena_atomic_load(&b->top[t], ARENA_RELAXED);
+		if (w == DS_ID_BITMAP_FULL)
+			continue;
+
+		m = t * 64 + ds_id_bitmap_ffz(w);
+		if (m >= DS_ID_BITMAP_MID_WORDS)
+			return DS_ERROR_FULL;
+		w = arena_atomic_load(&b->mid[m], ARENA_RELAXED);
+		if (w == DS_ID_BITMAP_FULL) {
+			*next = m * 64;
+			return DS_SUCCESS;
+		}
+		*next = m * 64 + ds_id_bitmap_ffz(w);
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_FULL;
+}
+
+/**
+ * ds_id_bitmap_acquire_c - Userspace acquire
+ * @b: Allocator
+ * @cpu: Hint slot to start from (e.g. thread index)
+ * @id: Output ID
+ */
+static inline int __ds_id_bitmap_acquire_c(struct ds_id_bitmap __arena *b, __u32 cpu, __u32 *id)
+{
+	struct ds_id_bitmap_hint __arena *hint;
+	int ret = DS_ERROR_BUSY;
+	__u32 l;
+
+	if (!b || !id)
+		return DS_ERROR_INVALID;
+
+	hint = &b->hints[cpu & (DS_ID_BITMAP_HINTS - 1)];
+	l = arena_atomic_load(&hint->leaf, ARENA_RELAXED);
+
+	for (int i = 0; i < DS_ID_BITMAP_RETRIES; i++) {
+		if (l < DS_ID_BITMAP_LEAF_WORDS) {
+			ret = ds_id_bitmap_try_leaf_c(b, l, id);
+			if (ret == DS_SUCCESS) {
+				if (i)
+					arena_atomic_store(&hint->leaf, l, ARENA_RELAXED);
+				return DS_SUCCESS;
+			}
+		} else {
+			l = 0;
+		}
+
+		if (ds_id_bitmap_pick_leaf_c(b, l, &l) != DS_SUCCESS)
+			return DS_ERROR_FULL;
+	}
+
+	return ret == DS_ERROR_FULL ? DS_ERROR_FULL : DS_ERROR_BUSY;
+}
+
+static inline int ds_id_bitmap_acquire_c(struct ds_id_bitmap __arena *b, __u32 cpu, __u32 *id)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_INSERT, __ds_id_bitmap_acquire_c(b, cpu, id));
+}
+#endif
+
+/* ========================================================================
+ * RELEASE
+ * ======================================================================== */
+
+/**
+ * ds_id_bitmap_release_lkmm - Return an ID
+ * @b: Allocator
+ * @id: ID from ds_id_bitmap_acquire()
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_INVALID (out of range) or
+ *          DS_ERROR_NOT_FOUND (ID was not allocated: double release)
+ */
+static inline int __ds_id_bitmap_release_lkmm(struct ds_id_bitmap __arena *b, __u32 id)
+{
+	__u64 bit, old;
+	__u32 l;
+
+	if (!b || id >= b->nr_ids)
+		return DS_ERROR_INVALID;
+
+	l = id / 64;
+	bit = 1ULL << (id % 64);
+	old = arena_atomic_and(&b->leaf[l], ~bit, ARENA_RELEASE);
+	if (!(old & bit))
+		return DS_ERROR_NOT_FOUND;
+
+	if (old == DS_ID_BITMAP_FULL)
+		ds_id_bitmap_mark_avail_lkmm(b, l);
+	return DS_SUCCESS;
+}
+
+static inline int ds_id_bitmap_release_lkmm(struct ds_id_bitmap __arena *b, __u32 id)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_DELETE, __ds_id_bitmap_release_lkmm(b, id));
+}
+
+#ifndef __BPF__
+static inline int __ds_id_bitmap_release_c(struct ds_id_bitmap __arena *b, __u32 id)
+{
+	__u64 bit, old;
+	__u32 l;
+
+	if (!b || id >= b->nr_ids)
+		return DS_ERROR_INVALID;
+
+	l = id / 64;
+	bit = 1ULL << (id % 64);
+	old = arena_atomic_and(&b->leaf[l], ~bit, ARENA_SEQ_CST);
+	if (!(old & bit))
+		return DS_ERROR_NOT_FOUND;
+
+	if (old == DS_ID_BITMAP_FULL)
+		ds_id_bitmap_mark_avail_c(b, l);
+	return DS_SUCCESS;
+}
+
+static inline int ds_id_bitmap_release_c(struct ds_id_bitmap __arena *b, __u32 id)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_DELETE, __ds_id_bitmap_release_c(b, id));
+}
+#endif
+
+static inline int ds_id_bitmap_release(struct ds_id_bitmap __arena *b, __u32 id)
+{
+#ifdef __BPF__
+	return ds_id_bitmap_release_lkmm(b, id);
+#else
+	return ds_id_bitmap_release_c(b, id);
+#endif
+}
+
+/* ========================================================================
+ * VERIFY / METADATA
+ * ======================================================================== */
+
+#ifndef __BPF__
+/**
+ * ds_id_bitmap_count_c - Number of allocated IDs (racy while in use)
+ */
+static inline __u32 ds_id_bitmap_count_c(struct ds_id_bitmap __arena *b)
+{
+	__u64 n = 0;
+
+	for (__u32 l = 0; l < b->nr_leaves; l++)
+		n += (__u64)__builtin_popcountll(arena_atomic_load(&b->leaf[l], ARENA_RELAXED));
+
+	/* Padding bits in the last leaf are always set */
+	return (__u32)(n - ((__u64)b->nr_leaves * 64 - b->nr_ids));
+}
+
+/**
+ * ds_id_bitmap_verify_c - Check summaries against leaves (quiescent only)
+ * @b: Allocator
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_CORRUPT
+ */
+static inline int __ds_id_bitmap_verify_c(struct ds_id_bitmap __arena *b)
+{
+	if (!b->nr_ids || b->nr_ids > DS_ID_BITMAP_MAX_IDS ||
+	    b->nr_leaves != (b->nr_ids + 63) / 64)
+		return DS_ERROR_CORRUPT;
+
+	for (__u32 l = 0; l < DS_ID_BITMAP_LEAF_WORDS; l++) {
+		bool full = b->leaf[l] == DS_ID_BITMAP_FULL;
+		bool marked = (b->mid[l / 64] >> (l % 64)) & 1;
+
+		if (full != marked)
+			return DS_ERROR_CORRUPT;
+		if (l >= b->nr_leaves && !full)
+			return DS_ERROR_CORRUPT;
+	}
+
+	for (__u32 m = 0; m < DS_ID_BITMAP_MID_WORDS; m++) {
+		bool full = b->mid[m] == DS_ID_BITMAP_FULL;
+		bool marked = (b->top[m / 64] >> (m % 64)) & 1;
+
+		if (full != marked)
+			return DS_ERROR_CORRUPT;
+	}
+
+	if (b->nr_ids % 64) {
+		__u64 pad = DS_ID_BITMAP_FULL << (b->nr_ids % 64);
+
+		if ((b->leaf[b->nr_leaves - 1] & pad) != pad)
+			return DS_ERROR_CORRUPT;
+	}
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_id_bitmap_verify_c(struct ds_id_bitmap __arena *b)
+{
+	return DS_OP_STATS_RUN(b, DS_OP_VERIFY, __ds_id_bitmap_verify_c(b));
+}
+#endif
+
+static inline const struct ds_metadata *ds_id_bitmap_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "id_bitmap",
+		.description = "Hierarchical bitmap ID allocator with per-CPU hints",
+		.node_size = sizeof(__u64),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+/**
+ * ds_id_bitmap_stats - Allocated IDs, leaf memory and per-op counters
+ * @b: Allocator
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * current_elements is a popcount of the leaves, racy while IDs move.
+ * Acquire counts as DS_OP_INSERT and release as DS_OP_DELETE.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_id_bitmap_stats_lkmm(struct ds_id_bitmap __arena *b, struct ds_stats *stats)
+{
+	__u64 n = 0;
+	__u32 nr_leaves;
+
+	if (!b || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(b), stats);
+	cast_kern(b);
+	nr_leaves = READ_ONCE(b->nr_leaves);
+	for (__u32 l = 0; l < nr_leaves && l < DS_ID_BITMAP_LEAF_WORDS && can_loop; l++)
+		n += (__u64)__builtin_popcountll(READ_ONCE(b->leaf[l]));
+
+	/* Padding bits in the last leaf are always set */
+	stats->current_elements = n - ((__u64)nr_leaves * 64 - b->nr_ids);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)nr_leaves * sizeof(__u64);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_id_bitmap_stats_c(struct ds_id_bitmap __arena *b, struct ds_stats *stats)
+{
+	if (!b || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(b), stats);
+	stats->current_elements = ds_id_bitmap_count_c(b);
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)b->nr_leaves * sizeof(__u64);
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_id_bitmap_stats(struct ds_id_bitmap __arena *b, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_id_bitmap_stats_lkmm(b, stats);
+#else
+	return ds_id_bitmap_stats_c(b, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_id_bitmap_reset_stats(struct ds_id_bitmap __arena *b)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(b));
+}
+
+#endif /* DS_ID_BITMAP_H */
@@ -43,6 +43,7 @@
  *            and cleared via arena_atomic_and() after a successful insert
  *            clears the backpressure condition.
  * @entries: Flat arena-allocated array of ds_kv slots.
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
  *
  * INVARIANTS:
  * - ring_entries > 0 and is a power of 2
@@ -77,6 +78,7 @@ struct ds_io_uring_ring_head {
 	__u32 sq_flags;                 /* status flags: bit 0 = DS_IO_URING_SQ_FLAG_FULL */
 	                                /* NOTE: accessed via arena_atomic_or/and/store — no _Atomic needed */
 	struct ds_kv __arena *entries;  /* arena-allocated flat array */
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_io_uring_ring_head __arena ds_io_uring_ring_head_t;
@@ -95,8 +97,8 @@ typedef struct ds_io_uring_ring_head __arena ds_io_uring_ring_head_t;
  * Returns DS_ERROR_NOMEM if arena allocation fails.
  */
 static inline __attribute__((unused))
-int ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
-			   __u32 ring_entries)
+int __ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
+			     __u32 ring_entries)
 {
 	struct ds_kv __arena *entries;
 
@@ -106,8 +108,8 @@ int ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
 	if (!ring_entries || (ring_entries & (ring_entries - 1)))
 		return DS_ERROR_INVALID;
 
-	entries = (struct ds_kv __arena *)bpf_arena_alloc(
-		ring_entries * sizeof(struct ds_kv));
+	entries = (struct ds_kv __arena *)ds_arena_alloc_array(
+		(__u64)ring_entries * sizeof(struct ds_kv));
 	if (!entries)
 		return DS_ERROR_NOMEM;
 
@@ -126,6 +128,13 @@ int ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
+			   __u32 ring_entries)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_io_uring_init_lkmm(head, ring_entries));
+}
+
 #ifndef __BPF__
 /**
  * ds_io_uring_init_c - Initialize ring using C11 atomics (userspace)
@@ -133,8 +142,8 @@ int ds_io_uring_init_lkmm(struct ds_io_uring_ring_head __arena *head,
  * @ring_entries: Number of slots; MUST be a power of 2
  */
 static inline __attribute__((unused))
-int ds_io_uring_init_c(struct ds_io_uring_ring_head __arena *head,
-		       __u32 ring_entries)
+int __ds_io_uring_init_c(struct ds_io_uring_ring_head __arena *head,
+			 __u32 ring_entries)
 {
 	struct ds_kv __arena *entries;
 
@@ -143,8 +152,8 @@ int ds_io_uring_init_c(struct ds_io_uring_ring_head __arena *head,
 	if (!ring_entries || (ring_entries & (ring_entries - 1)))
 		return DS_ERROR_INVALID;
 
-	entries = (struct ds_kv __arena *)bpf_arena_alloc(
-		ring_entries * sizeof(struct ds_kv));
+	entries = (struct ds_kv __arena *)ds_arena_alloc_array(
+		(__u64)ring_entries * sizeof(struct ds_kv));
 	if (!entries)
 		return DS_ERROR_NOMEM;
 
@@ -161,6 +170,13 @@ int ds_io_uring_init_c(struct ds_io_uring_ring_head __arena *head,
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_io_uring_init_c(struct ds_io_uring_ring_head __arena *head,
+		       __u32 ring_entries)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_io_uring_init_c(head, ring_entries));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -195,8 +211,8 @@ int ds_io_uring_init(struct ds_io_uring_ring_head __arena *head,
  * before the tail update becomes visible to the consumer.
  */
 static inline __attribute__((unused))
-int ds_io_uring_insert_lkmm(struct ds_io_uring_ring_head __arena *head,
-			     __u64 key, __u64 value)
+int __ds_io_uring_insert_lkmm(struct ds_io_uring_ring_head __arena *head,
+			       __u64 key, __u64 value)
 {
 	struct ds_kv __arena *slot;
 	__u32 tail, h;
@@ -237,6 +253,13 @@ int ds_io_uring_insert_lkmm(struct ds_io_uring_ring_head __arena *head,
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_io_uring_insert_lkmm(struct ds_io_uring_ring_head __arena *head,
+			     __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_io_uring_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
 /**
  * ds_io_uring_insert_c - Enqueue a key/value pair (PRODUCER ONLY, C11)
@@ -245,8 +268,8 @@ int ds_io_uring_insert_lkmm(struct ds_io_uring_ring_head __arena *head,
  * @value: Value to enqueue
  */
 static inline __attribute__((unused))
-int ds_io_uring_insert_c(struct ds_io_uring_ring_head __arena *head,
-			  __u64 key, __u64 value)
+int __ds_io_uring_insert_c(struct ds_io_uring_ring_head __arena *head,
+			    __u64 key, __u64 value)
 {
 	struct ds_kv __arena *slot;
 	__u32 tail, h;
@@ -278,6 +301,13 @@ int ds_io_uring_insert_c(struct ds_io_uring_ring_head __arena *head,
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_io_uring_insert_c(struct ds_io_uring_ring_head __arena *head,
+			  __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_io_uring_insert_c(head, key, value));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -316,8 +346,8 @@ int ds_io_uring_insert(struct ds_io_uring_ring_head __arena *head,
  *   io_uring's smp_store_release(cq_head) after CQE consumption.
  */
 static inline __attribute__((unused))
-int ds_io_uring_pop_lkmm(struct ds_io_uring_ring_head __arena *head,
-			  struct ds_kv *out)
+int __ds_io_uring_pop_lkmm(struct ds_io_uring_ring_head __arena *head,
+			    struct ds_kv *out)
 {
 	struct ds_kv __arena *slot;
 	__u32 h, t;
@@ -350,6 +380,13 @@ int ds_io_uring_pop_lkmm(struct ds_io_uring_ring_head __arena *head,
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_io_uring_pop_lkmm(struct ds_io_uring_ring_head __arena *head,
+			  struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_io_uring_pop_lkmm(head, out));
+}
+
 #ifndef __BPF__
 /**
  * ds_io_uring_pop_c - Dequeue the front entry (CONSUMER ONLY, C11)
@@ -357,8 +394,8 @@ int ds_io_uring_pop_lkmm(struct ds_io_uring_ring_head __arena *head,
  * @out: Output buffer to receive the dequeued key/value pair
  */
 static inline __attribute__((unused))
-int ds_io_uring_pop_c(struct ds_io_uring_ring_head __arena *head,
-		      struct ds_kv *out)
+int __ds_io_uring_pop_c(struct ds_io_uring_ring_head __arena *head,
+			struct ds_kv *out)
 {
 	struct ds_kv __arena *slot;
 	__u32 h, t;
@@ -386,6 +423,13 @@ int ds_io_uring_pop_c(struct ds_io_uring_ring_head __arena *head,
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_io_uring_pop_c(struct ds_io_uring_ring_head __arena *head,
+		      struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_io_uring_pop_c(head, out));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -413,23 +457,37 @@ int ds_io_uring_pop(struct ds_io_uring_ring_head __arena *head,
  * Returns DS_ERROR_INVALID unconditionally.
  */
 static inline __attribute__((unused))
-int ds_io_uring_search_lkmm(struct ds_io_uring_ring_head __arena *head,
-			     __u64 key)
+int __ds_io_uring_search_lkmm(struct ds_io_uring_ring_head __arena *head,
+			       __u64 key)
 {
 	(void)head;
 	(void)key;
 	return DS_ERROR_INVALID;
 }
 
+static inline __attribute__((unused))
+int ds_io_uring_search_lkmm(struct ds_io_uring_ring_head __arena *head,
+			     __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_io_uring_search_lkmm(head, key));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_io_uring_search_c(struct ds_io_uring_ring_head __arena *head,
-			  __u64 key)
+int __ds_io_uring_search_c(struct ds_io_uring_ring_head __arena *head,
+			    __u64 key)
 {
 	(void)head;
 	(void)key;
 	return DS_ERROR_INVALID;
 }
+
+static inline __attribute__((unused))
+int ds_io_uring_search_c(struct ds_io_uring_ring_head __arena *head,
+			  __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_io_uring_search_c(head, key));
+}
 #endif /* !__BPF__ */
 
 static inline __attribute__((unused))
@@ -458,7 +516,7 @@ int ds_io_uring_search(struct ds_io_uring_ring_head __arena *head,
  * Returns DS_SUCCESS or DS_ERROR_CORRUPT.
  */
 static inline __attribute__((unused))
-int ds_io_uring_verify_lkmm(struct ds_io_uring_ring_head __arena *head)
+int __ds_io_uring_verify_lkmm(struct ds_io_uring_ring_head __arena *head)
 {
 	__u32 tail, h, ring_entries;
 
@@ -485,13 +543,19 @@ int ds_io_uring_verify_lkmm(struct ds_io_uring_ring_head __arena *head)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_io_uring_verify_lkmm(struct ds_io_uring_ring_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_io_uring_verify_lkmm(head));
+}
+
 #ifndef __BPF__
 /**
  * ds_io_uring_verify_c - Verify ring invariants (C11)
  * @head: Ring head
  */
 static inline __attribute__((unused))
-int ds_io_uring_verify_c(struct ds_io_uring_ring_head __arena *head)
+int __ds_io_uring_verify_c(struct ds_io_uring_ring_head __arena *head)
 {
 	__u32 tail, h, ring_entries;
 
@@ -513,6 +577,12 @@ int ds_io_uring_verify_c(struct ds_io_uring_ring_head __arena *head)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_io_uring_verify_c(struct ds_io_uring_ring_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_io_uring_verify_c(head));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -527,3 +597,58 @@ int ds_io_uring_verify(struct ds_io_uring_ring_head __arena *head)
 	return ds_io_uring_verify_c(head);
 #endif
 }
+
+/**
+ * ds_io_uring_stats - Occupancy, ring memory and per-op counters
+ * @head: Ring
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline __attribute__((unused))
+int ds_io_uring_stats_lkmm(struct ds_io_uring_ring_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = (__u32)(READ_ONCE(head->prod.tail) - READ_ONCE(head->cons.head));
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->ring_entries * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline __attribute__((unused))
+int ds_io_uring_stats_c(struct ds_io_uring_ring_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = (__u32)(arena_atomic_load(&head->prod.tail, ARENA_RELAXED) -
+					  arena_atomic_load(&head->cons.head, ARENA_RELAXED));
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->ring_entries * sizeof(struct ds_kv);
+	return DS_SUCCESS;
+}
+#endif /* !__BPF__ */
+
+static inline __attribute__((unused))
+int ds_io_uring_stats(struct ds_io_uring_ring_head __arena *head, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_io_uring_stats_lkmm(head, stats);
+#else
+	return ds_io_uring_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline __attribute__((unused))
+void ds_io_uring_reset_stats(struct ds_io_uring_ring_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
@@ -40,6 +40,7 @@
  *        Maximum entries = (size - 1) / KCOV_WORDS_PER_ENTRY.
  * @area: Arena-allocated flat array. area[0] = entry count (READ_ONCE/WRITE_ONCE).
  *        area[1..] = tightly packed key/value pairs.
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
  *
  * INVARIANTS:
  * - size >= 1 + KCOV_WORDS_PER_ENTRY (at least one entry fits)
@@ -49,6 +50,7 @@
 struct ds_kcov_buf {
 	__u64 size;           /* total words including counter slot (area[0]) */
 	__u64 __arena *area;  /* arena-allocated flat array; area[0] = count  */
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_kcov_buf __arena ds_kcov_buf_t;
@@ -66,7 +68,7 @@ typedef struct ds_kcov_buf __arena ds_kcov_buf_t;
  * Returns: DS_SUCCESS or DS_ERROR_NOMEM / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
+int __ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
 {
 	__u64 __arena *area;
 
@@ -74,7 +76,7 @@ int ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
 	if (size < 1 + KCOV_WORDS_PER_ENTRY)
 		return DS_ERROR_INVALID;
 
-	area = bpf_arena_alloc((__u32)(size * sizeof(__u64)));
+	area = ds_arena_alloc_array(size * sizeof(__u64));
 	if (!area)
 		return DS_ERROR_NOMEM;
 
@@ -90,6 +92,12 @@ int ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_kcov_init_lkmm(head, size));
+}
+
 #ifndef __BPF__
 /**
  * ds_kcov_init_c - Initialize kcov flat buffer (C11 / userspace side)
@@ -99,7 +107,7 @@ int ds_kcov_init_lkmm(struct ds_kcov_buf __arena *head, __u64 size)
  * Returns: DS_SUCCESS or DS_ERROR_NOMEM / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_init_c(struct ds_kcov_buf __arena *head, __u64 size)
+int __ds_kcov_init_c(struct ds_kcov_buf __arena *head, __u64 size)
 {
 	__u64 __arena *area;
 
@@ -107,7 +115,7 @@ int ds_kcov_init_c(struct ds_kcov_buf __arena *head, __u64 size)
 	if (size < 1 + KCOV_WORDS_PER_ENTRY)
 		return DS_ERROR_INVALID;
 
-	area = bpf_arena_alloc((__u32)(size * sizeof(__u64)));
+	area = ds_arena_alloc_array(size * sizeof(__u64));
 	if (!area)
 		return DS_ERROR_NOMEM;
 
@@ -121,6 +129,12 @@ int ds_kcov_init_c(struct ds_kcov_buf __arena *head, __u64 size)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_kcov_init_c(struct ds_kcov_buf __arena *head, __u64 size)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_kcov_init_c(head, size));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -161,7 +175,7 @@ int ds_kcov_init(struct ds_kcov_buf __arena *head, __u64 size)
  * Returns: DS_SUCCESS or DS_ERROR_FULL / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_insert_lkmm(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
+int __ds_kcov_insert_lkmm(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
 {
 	__u64 __arena *area;
 	__u64 count, start_index, end_index;
@@ -194,6 +208,12 @@ int ds_kcov_insert_lkmm(struct ds_kcov_buf __arena *head, __u64 key, __u64 value
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_kcov_insert_lkmm(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_kcov_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
 /**
  * ds_kcov_insert_c - Append a key/value entry (C11 / userspace side)
@@ -208,7 +228,7 @@ int ds_kcov_insert_lkmm(struct ds_kcov_buf __arena *head, __u64 key, __u64 value
  * Returns: DS_SUCCESS or DS_ERROR_FULL / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_insert_c(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
+int __ds_kcov_insert_c(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
 {
 	__u64 __arena *area;
 	__u64 count, start_index, end_index;
@@ -238,6 +258,12 @@ int ds_kcov_insert_c(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_kcov_insert_c(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_kcov_insert_c(head, key, value));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -274,7 +300,7 @@ int ds_kcov_insert(struct ds_kcov_buf __arena *head, __u64 key, __u64 value)
  * Returns: DS_SUCCESS or DS_ERROR_NOT_FOUND (empty) / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_pop_lkmm(struct ds_kcov_buf __arena *head, struct ds_kv *out)
+int __ds_kcov_pop_lkmm(struct ds_kcov_buf __arena *head, struct ds_kv *out)
 {
 	__u64 __arena *area;
 	__u64 count, start_index;
@@ -307,6 +333,12 @@ int ds_kcov_pop_lkmm(struct ds_kcov_buf __arena *head, struct ds_kv *out)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_kcov_pop_lkmm(struct ds_kcov_buf __arena *head, struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_kcov_pop_lkmm(head, out));
+}
+
 #ifndef __BPF__
 /**
  * ds_kcov_pop_c - Remove and return the most-recently inserted entry (C11)
@@ -316,7 +348,7 @@ int ds_kcov_pop_lkmm(struct ds_kcov_buf __arena *head, struct ds_kv *out)
  * Returns: DS_SUCCESS or DS_ERROR_NOT_FOUND (empty) / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_pop_c(struct ds_kcov_buf __arena *head, struct ds_kv *out)
+int __ds_kcov_pop_c(struct ds_kcov_buf __arena *head, struct ds_kv *out)
 {
 	__u64 __arena *area;
 	__u64 count, start_index;
@@ -344,6 +376,12 @@ int ds_kcov_pop_c(struct ds_kcov_buf __arena *head, struct ds_kv *out)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_kcov_pop_c(struct ds_kcov_buf __arena *head, struct ds_kv *out)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_kcov_pop_c(head, out));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -372,21 +410,33 @@ int ds_kcov_pop(struct ds_kcov_buf __arena *head, struct ds_kv *out)
  * Returns: DS_ERROR_INVALID always
  */
 static inline __attribute__((unused))
-int ds_kcov_search_lkmm(struct ds_kcov_buf __arena *head, __u64 key)
+int __ds_kcov_search_lkmm(struct ds_kcov_buf __arena *head, __u64 key)
 {
 	(void)head;
 	(void)key;
 	return DS_ERROR_INVALID;
 }
 
+static inline __attribute__((unused))
+int ds_kcov_search_lkmm(struct ds_kcov_buf __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_kcov_search_lkmm(head, key));
+}
+
 #ifndef __BPF__
 static inline __attribute__((unused))
-int ds_kcov_search_c(struct ds_kcov_buf __arena *head, __u64 key)
+int __ds_kcov_search_c(struct ds_kcov_buf __arena *head, __u64 key)
 {
 	(void)head;
 	(void)key;
 	return DS_ERROR_INVALID;
 }
+
+static inline __attribute__((unused))
+int ds_kcov_search_c(struct ds_kcov_buf __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_kcov_search_c(head, key));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -418,7 +468,7 @@ int ds_kcov_search(struct ds_kcov_buf __arena *head, __u64 key)
  * Returns: DS_SUCCESS or DS_ERROR_CORRUPT / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_verify_lkmm(struct ds_kcov_buf __arena *head)
+int __ds_kcov_verify_lkmm(struct ds_kcov_buf __arena *head)
 {
 	__u64 __arena *area;
 	__u64 count, max_entries;
@@ -444,6 +494,12 @@ int ds_kcov_verify_lkmm(struct ds_kcov_buf __arena *head)
 	return DS_SUCCESS;
 }
 
+static inline __attribute__((unused))
+int ds_kcov_verify_lkmm(struct ds_kcov_buf __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_kcov_verify_lkmm(head));
+}
+
 #ifndef __BPF__
 /**
  * ds_kcov_verify_c - Verify flat buffer invariants (C11 / userspace side)
@@ -452,7 +508,7 @@ int ds_kcov_verify_lkmm(struct ds_kcov_buf __arena *head)
  * Returns: DS_SUCCESS or DS_ERROR_CORRUPT / DS_ERROR_INVALID
  */
 static inline __attribute__((unused))
-int ds_kcov_verify_c(struct ds_kcov_buf __arena *head)
+int __ds_kcov_verify_c(struct ds_kcov_buf __arena *head)
 {
 	__u64 __arena *area;
 	__u64 count, size, max_entries;
@@ -476,6 +532,12 @@ int ds_kcov_verify_c(struct ds_kcov_buf __arena *head)
 
 	return DS_SUCCESS;
 }
+
+static inline __attribute__((unused))
+int ds_kcov_verify_c(struct ds_kcov_buf __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_kcov_verify_c(head));
+}
 #endif /* !__BPF__ */
 
 /**
@@ -490,3 +552,57 @@ int ds_kcov_verify(struct ds_kcov_buf __arena *head)
 	return ds_kcov_verify_c(head);
 #endif
 }
+
+/**
+ * ds_kcov_stats - Entry count, area memory and per-op counters
+ * @head: Buffer
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline __attribute__((unused))
+int ds_kcov_stats_lkmm(struct ds_kcov_buf __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = head->area ? READ_ONCE(head->area[0]) : 0;
+	stats->max_elements = 0;
+	stats->memory_used = head->size * sizeof(__u64);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline __attribute__((unused))
+int ds_kcov_stats_c(struct ds_kcov_buf __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = head->area ? arena_atomic_load(&head->area[0], ARENA_RELAXED) : 0;
+	stats->max_elements = 0;
+	stats->memory_used = head->size * sizeof(__u64);
+	return DS_SUCCESS;
+}
+#endif /* !__BPF__ */
+
+static inline __attribute__((unused))
+int ds_kcov_stats(struct ds_kcov_buf __arena *head, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_kcov_stats_lkmm(head, stats);
+#else
+	return ds_kcov_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline __attribute__((unused))
+void ds_kcov_reset_stats(struct ds_kcov_buf __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
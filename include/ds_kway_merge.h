@@ -0,0 +1,307 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Timestamp-Ordered K-Way Merge over Per-CPU Lanes (userspace consumer)
+ *
+ * Kernel producers that each own a per-CPU SPSC lane (ds_ck_ring_spsc)
+ * never contend, but the consumer loses global order. Every entry's
+ * value already carries bpf_ktime_get_ns() (CLOCK_MONOTONIC), and each
+ * lane is FIFO from a single producer, so lanes are individually sorted
+ * and a k-way merge restores the global order.
+ *
+ * The merge stages one entry per lane and keeps them in a loser tree
+ * (tournament tree): the winner is the oldest staged entry, and
+ * replacing it costs one leaf-to-root replay, O(log k) comparisons
+ * against the stored losers only.
+ *
+ * Each lane's watermark is the last timestamp popped from it; since the
+ * lane is sorted, it will never deliver anything older. The winner is
+ * safe to emit when every lane either has an entry staged or has a
+ * watermark at or past the winner. An empty lane may simply be idle, so
+ * the merge does not wait on it forever: with a reorder window W, an
+ * entry is also emitted once its timestamp is older than now - W.
+ * An entry that arrives older than what was already emitted (its
+ * producer stalled longer than W) is emitted anyway and counted as an
+ * ordering violation; the output watermark is the newest emitted
+ * timestamp.
+ *
+ * Userspace only; lanes are written by BPF with ds_ck_ring_spsc_insert().
+ */
+#ifndef DS_KWAY_MERGE_H
+#define DS_KWAY_MERGE_H
+
+#pragma once
+
+#ifndef __BPF__
+
+#include <string.h>
+
+#include "ds_api.h"
+#include "ds_ck_ring_spsc.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Maximum lanes (one per CPU); power of 2 */
+#define DS_KWAY_MERGE_MAX_LANES 256
+
+#define DS_KWAY_MERGE_EMPTY_KEY (~0ULL)
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/* Called once per emitted entry, in timestamp order */
+typedef void (*ds_kway_merge_emit_fn)(void *ctx, __u32 lane, const struct ds_kv *kv);
+
+/**
+ * struct ds_kway_merge - Merge state (consumer-private, not shared)
+ * @nr_lanes: Lanes merged
+ * @leaves: nr_lanes rounded up to a power of 2
+ * @window_ns: Reorder window W
+ * @nr_empty: Lanes without a staged entry
+ * @watermark: Newest timestamp emitted so far
+ * @lanes: Per-CPU SPSC lanes
+ * @staged: Staged entry per lane
+ * @key: Staged timestamp per lane, DS_KWAY_MERGE_EMPTY_KEY if none
+ * @last_ts: Last timestamp popped per lane (the lane's watermark)
+ * @tree: tree[0] = winner lane, tree[1..leaves-1] = loser at each node
+ * @popped: Entries taken from lanes
+ * @emitted: Entries handed to the emit callback
+ * @violations: Entries emitted older than @watermark
+ * @lane_regressions: Entries older than their own lane's previous one
+ * @window_waits: Polls that stopped to wait on an empty lane
+ */
+struct ds_kway_merge {
+	__u32 nr_lanes;
+	__u32 leaves;
+	__u64 window_ns;
+	__u32 nr_empty;
+	__u64 watermark;
+	struct ds_ck_ring_spsc_head *lanes[DS_KWAY_MERGE_MAX_LANES];
+	struct ds_kv staged[DS_KWAY_MERGE_MAX_LANES];
+	__u64 key[DS_KWAY_MERGE_MAX_LANES];
+	__u64 last_ts[DS_KWAY_MERGE_MAX_LANES];
+	__u32 tree[DS_KWAY_MERGE_MAX_LANES];
+	__u64 popped;
+	__u64 emitted;
+	__u64 violations;
+	__u64 lane_regressions;
+	__u64 window_waits;
+};
+
+/* ========================================================================
+ * LOSER TREE
+ * ======================================================================== */
+
+/* Strict order on lanes: older key first, lane index breaks ties */
+static inline bool ds_kway_merge_less(struct ds_kway_merge *m, __u32 a, __u32 b)
+{
+	__u64 ka = a < m->nr_lanes ? m->key[a] : DS_KWAY_MERGE_EMPTY_KEY;
+	__u64 kb = b < m->nr_lanes ? m->key[b] : DS_KWAY_MERGE_EMPTY_KEY;
+
+	return ka < kb || (ka == kb && a < b);
+}
+
+/* The winner's key changed: replay its path against the stored losers */
+static inline void ds_kway_merge_replay(struct ds_kway_merge *m, __u32 lane)
+{
+	__u32 winner = lane;
+
+	for (__u32 n = (lane + m->leaves) >> 1; n; n >>= 1) {
+		if (ds_kway_merge_less(m, m->tree[n], winner)) {
+			__u32 t = m->tree[n];
+
+			m->tree[n] = winner;
+			winner = t;
+		}
+	}
+	m->tree[0] = winner;
+}
+
+/* Full bottom-up build: play every match once */
+static inline void ds_kway_merge_build(struct ds_kway_merge *m)
+{
+	__u32 win[2 * DS_KWAY_MERGE_MAX_LANES];
+
+	for (__u32 i = 0; i < m->leaves; i++)
+		win[m->leaves + i] = i;
+
+	for (__u32 n = m->leaves - 1; n >= 1; n--) {
+		__u32 a = win[2 * n], b = win[2 * n + 1];
+
+		if (ds_kway_merge_less(m, a, b)) {
+			win[n] = a;
+			m->tree[n] = b;
+		} else {
+			win[n] = b;
+			m->tree[n] = a;
+		}
+	}
+	m->tree[0] = m->leaves > 1 ? win[1] : 0;
+}
+
+/* ========================================================================
+ * API
+ * ======================================================================== */
+
+/**
+ * ds_kway_merge_init - Set up a merge over @nr_lanes initialized lanes
+ * @m: Merge state
+ * @lanes: Array of @nr_lanes lane heads (e.g. one per CPU)
+ * @nr_lanes: 1 .. DS_KWAY_MERGE_MAX_LANES
+ * @window_ns: Reorder window; how long an empty lane can hold back output
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int ds_kway_merge_init(struct ds_kway_merge *m,
+				     struct ds_ck_ring_spsc_head **lanes,
+				     __u32 nr_lanes, __u64 window_ns)
+{
+	if (!m || !lanes || !nr_lanes || nr_lanes > DS_KWAY_MERGE_MAX_LANES)
+		return DS_ERROR_INVALID;
+
+	memset(m, 0, sizeof(*m));
+	m->nr_lanes = nr_lanes;
+	m->leaves = 1;
+	while (m->leaves < nr_lanes)
+		m->leaves <<= 1;
+	m->window_ns = window_ns;
+	m->nr_empty = nr_lanes;
+
+	for (__u32 i = 0; i < nr_lanes; i++) {
+		if (!lanes[i])
+			return DS_ERROR_INVALID;
+		m->lanes[i] = lanes[i];
+		m->key[i] = DS_KWAY_MERGE_EMPTY_KEY;
+	}
+
+	ds_kway_merge_build(m);
+	return DS_SUCCESS;
+}
+
+/* Pop the next entry of an empty lane into its staging slot */
+static inline bool ds_kway_merge_stage(struct ds_kway_merge *m, __u32 lane)
+{
+	struct ds_kv kv;
+
+	if (ds_ck_ring_spsc_delete_c(m->lanes[lane], &kv) != DS_SUCCESS)
+		return false;
+
+	if (kv.value < m->last_ts[lane])
+		m->lane_regressions++;
+	m->last_ts[lane] = kv.value;
+	m->staged[lane] = kv;
+	m->key[lane] = kv.value;
+	m->nr_empty--;
+	m->popped++;
+	return true;
+}
+
+static inline void ds_kway_merge_emit_winner(struct ds_kway_merge *m, __u32 lane,
+					     ds_kway_merge_emit_fn emit, void *ctx)
+{
+	if (m->key[lane] < m->watermark)
+		m->violations++;
+	else
+		m->watermark = m->key[lane];
+
+	if (emit)
+		emit(ctx, lane, &m->staged[lane]);
+	m->emitted++;
+
+	m->key[lane] = DS_KWAY_MERGE_EMPTY_KEY;
+	m->nr_empty++;
+	ds_kway_merge_stage(m, lane);
+	ds_kway_merge_replay(m, lane);
+}
+
+/* True if no empty lane can still deliver an entry older than @ts */
+static inline bool ds_kway_merge_lanes_past(struct ds_kway_merge *m, __u64 ts)
+{
+	for (__u32 i = 0; i < m->nr_lanes; i++)
+		if (m->key[i] == DS_KWAY_MERGE_EMPTY_KEY && m->last_ts[i] < ts)
+			return false;
+	return true;
+}
+
+/**
+ * ds_kway_merge_poll - Drain lanes and emit everything that is safe
+ * @m: Merge state
+ * @now_ns: Current CLOCK_MONOTONIC time (same base as bpf_ktime_get_ns)
+ * @emit: Callback per entry, in timestamp order
+ * @ctx: Callback argument
+ * @budget: Maximum entries to emit in this call
+ *
+ * Returns: Number of entries emitted
+ */
+static inline __u64 ds_kway_merge_poll(struct ds_kway_merge *m, __u64 now_ns,
+				       ds_kway_merge_emit_fn emit, void *ctx, __u64 budget)
+{
+	__u64 n = 0;
+
+	/*
+	 * Replay is only valid for the current winner's lane, so lanes that
+	 * were refilled from empty get one full rebuild instead.
+	 */
+	if (m->nr_empty) {
+		bool staged = false;
+
+		for (__u32 i = 0; i < m->nr_lanes; i++)
+			if (m->key[i] == DS_KWAY_MERGE_EMPTY_KEY && ds_kway_merge_stage(m, i))
+				staged = true;
+		if (staged)
+			ds_kway_merge_build(m);
+	}
+
+	while (n < budget) {
+		__u32 w = m->tree[0];
+
+		if (w >= m->nr_lanes || m->key[w] == DS_KWAY_MERGE_EMPTY_KEY)
+			break;
+
+		/* An empty lane may still deliver something older, up to now - W */
+		if (m->nr_empty &&
+		    (m->key[w] > now_ns || now_ns - m->key[w] < m->window_ns) &&
+		    !ds_kway_merge_lanes_past(m, m->key[w])) {
+			m->window_waits++;
+			break;
+		}
+
+		ds_kway_merge_emit_winner(m, w, emit, ctx);
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * ds_kway_merge_flush - Emit every staged and queued entry, ignoring W
+ * @m: Merge state
+ * @emit: Callback per entry
+ * @ctx: Callback argument
+ *
+ * For shutdown, once producers have stopped.
+ *
+ * Returns: Number of entries emitted
+ */
+static inline __u64 ds_kway_merge_flush(struct ds_kway_merge *m,
+					ds_kway_merge_emit_fn emit, void *ctx)
+{
+	return ds_kway_merge_poll(m, DS_KWAY_MERGE_EMPTY_KEY, emit, ctx,
+				  DS_KWAY_MERGE_EMPTY_KEY);
+}
+
+static inline const struct ds_metadata *ds_kway_merge_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "kway_merge",
+		.description = "Loser-tree timestamp merge over per-CPU SPSC lanes",
+		.node_size = sizeof(struct ds_kv),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_KWAY_MERGE_H */
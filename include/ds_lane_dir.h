@@ -0,0 +1,522 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Lane Directory and Cross-Process Arena Consumers
+ *
+ * An arena map is also a shared memory segment. Once the loader pins it in
+ * bpffs, any process with access to the pin can mmap the same pages.
+ * Arena pointers are absolute user addresses starting at the map's
+ * map_extra, so a process that maps the arena at exactly map_extra can
+ * follow the loader's pointers (lane heads, ring buffers, nodes) directly.
+ * Consumers read the same bytes the BPF producer wrote, with no copy and
+ * no broker process.
+ *
+ * Consumers find lanes through a directory at a fixed arena offset,
+ * DS_LANE_DIR_OFFSET from map_extra:
+ *
+ *   map_extra ──> [ arena globals | ... | ds_lane_dir | allocator pages ... ]
+ *                                         │
+ *                 lanes[i] = { "ku", kind, head ──> struct ds_vyukhov_head, ... }
+ *
+ * - Loader: ds_lane_dir_init() once, then ds_lane_dir_publish() for each
+ *   lane. Pin the arena map with bpf_map__pin() or ds_arena_pin().
+ * - Consumer: ds_arena_view_open(pin path), then ds_lane_dir_lookup(name)
+ *   and ds_lane_claim(), then pop with the lane's own _c functions. Only
+ *   raw bpf(2) calls are used, so consumers do not need libbpf.
+ *
+ * A lane flagged DS_LANE_F_SINGLE_CONSUMER (the SPSC rings) can be claimed
+ * by one process at a time. A claim held by a process that has exited is
+ * taken over. Multi-consumer lanes such as Vyukhov can be attached by any
+ * number of processes, and each entry goes to one of them.
+ *
+ * The directory is written only by the loader. Entries are filled in
+ * before nr_lanes is release-stored, so a consumer that acquires nr_lanes
+ * sees complete entries. Consumers write only the claim and
+ * counter fields.
+ */
+#ifndef DS_LANE_DIR_H
+#define DS_LANE_DIR_H
+
+#pragma once
+
+#include "ds_api.h"
+
+/* ========================================================================
+ * LAYOUT (shared with BPF)
+ * ======================================================================== */
+
+#define DS_LANE_DIR_MAGIC	0x4452414cU /* "LARD" */
+#define DS_LANE_DIR_VERSION	1
+
+/* Byte offset of the directory from the arena base (map_extra). It sits
+ * past the arena globals; the metrics store alone is 640 KiB. */
+#define DS_LANE_DIR_OFFSET	(2ULL << 20)
+
+/* Bytes reserved for the directory; allocator pages start after this */
+#define DS_LANE_DIR_BYTES	4096ULL
+
+#define DS_LANE_DIR_MAX_LANES	32
+#define DS_LANE_NAME_LEN	32
+
+/* Which _c API pops the lane */
+enum ds_lane_kind {
+	DS_LANE_KIND_NONE = 0,
+	DS_LANE_KIND_MSQUEUE = 1,
+	DS_LANE_KIND_VYUKHOV = 2,
+	DS_LANE_KIND_FOLLY_SPSC = 3,
+	DS_LANE_KIND_CK_FIFO_SPSC = 4,
+	DS_LANE_KIND_CK_RING_SPSC = 5,
+	DS_LANE_KIND_CK_STACK_UPMC = 6,
+};
+
+#define DS_LANE_F_KU			(1U << 0) /* kernel produces, userspace consumes */
+#define DS_LANE_F_UK			(1U << 1) /* userspace produces, kernel consumes */
+#define DS_LANE_F_SINGLE_CONSUMER	(1U << 2) /* one claimed consumer at a time */
+#define DS_LANE_F_CLOSED		(1U << 3) /* producer gone; drain and detach */
+
+/**
+ * struct ds_lane_dir_entry - One named lane
+ * @name: NUL-terminated lane name
+ * @head: Arena address of the lane head
+ * @kind: enum ds_lane_kind
+ * @capacity: Lane capacity, 0 if unbounded
+ * @flags: DS_LANE_F_* flags
+ * @consumers: Attached consumer processes
+ * @owner_pid: Claim holder of a single-consumer lane, 0 if free
+ * @consumed: Entries popped by attached consumers (ds_lane_account)
+ */
+struct ds_lane_dir_entry {
+	char name[DS_LANE_NAME_LEN];
+	__u64 head;
+	__u32 kind;
+	__u32 capacity;
+	__u32 flags;
+	__u32 consumers;
+	__u64 owner_pid;
+	__u64 consumed;
+};
+
+/**
+ * struct ds_lane_dir - Directory at DS_LANE_DIR_OFFSET
+ * @magic: DS_LANE_DIR_MAGIC, stored last by ds_lane_dir_init
+ * @version: DS_LANE_DIR_VERSION
+ * @nr_lanes: Published entries (release-stored)
+ * @arena_base: Address every process must map the arena at (map_extra)
+ * @arena_bytes: Arena size
+ * @generation: Incremented on every publish or flag change
+ * @owner_pid: Loader process
+ * @alloc_used: Bytes of the allocator range a detached loader handed out
+ * @detach_ns: CLOCK_MONOTONIC time the loader detached, 0 while attached
+ * @restarts: Times a loader re-attached (ds_lane_dir_reattach)
+ */
+struct ds_lane_dir {
+	__u32 magic;
+	__u32 version;
+	__u32 nr_lanes;
+	__u32 pad;
+	__u64 arena_base;
+	__u64 arena_bytes;
+	__u64 generation;
+	__u64 owner_pid;
+	__u64 alloc_used;
+	__u64 detach_ns;
+	__u64 restarts;
+	struct ds_lane_dir_entry lanes[DS_LANE_DIR_MAX_LANES];
+};
+
+_Static_assert(sizeof(struct ds_lane_dir) <= DS_LANE_DIR_BYTES,
+	       "lane directory must fit in DS_LANE_DIR_BYTES");
+
+#ifndef __BPF__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/bpf.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* BPF_MAP_TYPE_ARENA; older uapi headers do not have it */
+#define DS_LANE_BPF_MAP_TYPE_ARENA 33
+
+/* ========================================================================
+ * LOADER SIDE
+ * ======================================================================== */
+
+static inline struct ds_lane_dir *ds_lane_dir_at(void *arena_base)
+{
+	return (struct ds_lane_dir *)((char *)arena_base + DS_LANE_DIR_OFFSET);
+}
+
+/* First byte after the directory: where the loader's allocator range starts */
+static inline void *ds_lane_dir_end(void *arena_base)
+{
+	return (char *)arena_base + DS_LANE_DIR_OFFSET + DS_LANE_DIR_BYTES;
+}
+
+/**
+ * ds_lane_dir_init - Format the directory of a freshly loaded arena
+ * @arena_base: Arena mapping (map_extra)
+ * @arena_bytes: Arena size
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if the arena is too small
+ */
+static inline int ds_lane_dir_init(void *arena_base, __u64 arena_bytes)
+{
+	struct ds_lane_dir *dir;
+
+	if (!arena_base || arena_bytes < DS_LANE_DIR_OFFSET + DS_LANE_DIR_BYTES)
+		return DS_ERROR_INVALID;
+
+	dir = ds_lane_dir_at(arena_base);
+	memset(dir, 0, sizeof(*dir));
+	dir->version = DS_LANE_DIR_VERSION;
+	dir->arena_base = (__u64)(unsigned long)arena_base;
+	dir->arena_bytes = arena_bytes;
+	dir->owner_pid = (__u64)getpid();
+	arena_atomic_store(&dir->magic, DS_LANE_DIR_MAGIC, ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_lane_dir_publish - Add a named lane
+ * @dir: Directory
+ * @name: Lane name, shorter than DS_LANE_NAME_LEN
+ * @kind: enum ds_lane_kind
+ * @head: Lane head inside the arena
+ * @capacity: Lane capacity, 0 if unbounded
+ * @flags: DS_LANE_F_* flags
+ *
+ * Loader only. Entries are never removed; a retired lane is marked
+ * DS_LANE_F_CLOSED with ds_lane_dir_set_flags().
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_EXISTS, DS_ERROR_FULL or DS_ERROR_INVALID
+ */
+static inline int ds_lane_dir_publish(struct ds_lane_dir *dir, const char *name, __u32 kind,
+				      void *head, __u32 capacity, __u32 flags)
+{
+	struct ds_lane_dir_entry *e;
+	__u32 nr;
+
+	if (!dir || !name || !head || !name[0] || strlen(name) >= DS_LANE_NAME_LEN)
+		return DS_ERROR_INVALID;
+
+	nr = dir->nr_lanes;
+	for (__u32 i = 0; i < nr; i++) {
+		if (!strcmp(dir->lanes[i].name, name))
+			return DS_ERROR_EXISTS;
+	}
+	if (nr >= DS_LANE_DIR_MAX_LANES)
+		return DS_ERROR_FULL;
+
+	e = &dir->lanes[nr];
+	memset(e, 0, sizeof(*e));
+	strcpy(e->name, name);
+	e->head = (__u64)(unsigned long)head;
+	e->kind = kind;
+	e->capacity = capacity;
+	e->flags = flags;
+
+	arena_atomic_add(&dir->generation, 1, ARENA_RELAXED);
+	arena_atomic_store(&dir->nr_lanes, nr + 1, ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+
+/* Loader: set and clear flags of a published lane (e.g. DS_LANE_F_CLOSED) */
+static inline void ds_lane_dir_set_flags(struct ds_lane_dir *dir, struct ds_lane_dir_entry *e,
+					 __u32 set, __u32 clear)
+{
+	if (set)
+		arena_atomic_or(&e->flags, set, ARENA_RELEASE);
+	if (clear)
+		arena_atomic_and(&e->flags, ~clear, ARENA_RELEASE);
+	arena_atomic_add(&dir->generation, 1, ARENA_RELAXED);
+}
+
+/* ========================================================================
+ * HOT RESTART
+ *
+ * A loader that pins its programs, links and arena can exit without
+ * tearing anything down. BPF keeps producing into the lanes, and the
+ * next loader maps the same arena and picks up at the current lane
+ * indices. The directory records what the successor needs.
+ * ======================================================================== */
+
+static inline __u64 ds_lane_dir_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + (__u64)ts.tv_nsec;
+}
+
+/**
+ * ds_lane_dir_detach - Loader: hand the arena over to a future loader
+ * @dir: Directory
+ * @alloc_used: Bytes of the allocator range in use; the successor starts past them
+ */
+static inline void ds_lane_dir_detach(struct ds_lane_dir *dir, __u64 alloc_used)
+{
+	dir->alloc_used = alloc_used;
+	arena_atomic_store(&dir->detach_ns, ds_lane_dir_clock(), ARENA_RELEASE);
+}
+
+/**
+ * ds_lane_dir_reattach - Loader: take over a directory left by ds_lane_dir_detach
+ * @dir: Directory of an arena mapped from its pin
+ *
+ * Returns: CLOCK_MONOTONIC time the previous loader detached, or 0 if it
+ *          did not detach cleanly (still running, or crashed)
+ */
+static inline __u64 ds_lane_dir_reattach(struct ds_lane_dir *dir)
+{
+	__u64 detached = arena_atomic_exchange(&dir->detach_ns, 0, ARENA_ACQ_REL);
+
+	dir->owner_pid = (__u64)getpid();
+	arena_atomic_add(&dir->restarts, 1, ARENA_RELAXED);
+	arena_atomic_add(&dir->generation, 1, ARENA_RELAXED);
+	return detached;
+}
+
+/* ========================================================================
+ * CONSUMER SIDE
+ * ======================================================================== */
+
+/**
+ * struct ds_arena_view - A process's mapping of a shared arena
+ * @map_fd: Arena map fd (-1 for plain shared memory in tests)
+ * @base: Mapping address, equal to the loader's map_extra
+ * @bytes: Mapping size
+ * @dir: Directory inside the mapping
+ */
+struct ds_arena_view {
+	int map_fd;
+	void *base;
+	size_t bytes;
+	struct ds_lane_dir *dir;
+};
+
+static inline long ds_lane_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+/* Pin an arena (or any map) fd at a bpffs path */
+static inline int ds_arena_pin(int map_fd, const char *path)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.pathname = (__u64)(unsigned long)path;
+	attr.bpf_fd = (__u32)map_fd;
+	return ds_lane_bpf(BPF_OBJ_PIN, &attr) ? DS_ERROR_INVALID : DS_SUCCESS;
+}
+
+/**
+ * ds_arena_view_map - Map a shared arena at @addr and validate its directory
+ * @view: View to fill
+ * @fd: File to map (arena map fd, or any shared memory fd)
+ * @addr: Address to map at; must be free in this process
+ * @bytes: Size to map
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_BUSY if @addr is already in use,
+ *          DS_ERROR_NOT_FOUND if no directory has been published,
+ *          DS_ERROR_INVALID otherwise
+ */
+static inline int ds_arena_view_map(struct ds_arena_view *view, int fd, void *addr, size_t bytes)
+{
+	struct ds_lane_dir *dir;
+	void *base;
+
+	if (!view || fd < 0 || !addr || bytes < DS_LANE_DIR_OFFSET + DS_LANE_DIR_BYTES)
+		return DS_ERROR_INVALID;
+
+	base = mmap(addr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+	if (base == MAP_FAILED)
+		return errno == EEXIST ? DS_ERROR_BUSY : DS_ERROR_INVALID;
+	if (base != addr) {
+		/* Pre-4.17 kernels ignore MAP_FIXED_NOREPLACE and treat it as a hint */
+		munmap(base, bytes);
+		return DS_ERROR_BUSY;
+	}
+
+	dir = ds_lane_dir_at(base);
+	if (arena_atomic_load(&dir->magic, ARENA_ACQUIRE) != DS_LANE_DIR_MAGIC ||
+	    dir->version != DS_LANE_DIR_VERSION ||
+	    dir->arena_base != (__u64)(unsigned long)base) {
+		munmap(base, bytes);
+		return DS_ERROR_NOT_FOUND;
+	}
+
+	view->map_fd = fd;
+	view->base = base;
+	view->bytes = bytes;
+	view->dir = dir;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_arena_view_open - Attach to an arena pinned in bpffs
+ * @view: View to fill
+ * @pin_path: bpffs path the loader pinned the arena map at
+ *
+ * Opens the pin, reads map_extra and the size from the map info, and maps
+ * the arena at map_extra so that arena pointers are valid as they are.
+ *
+ * Returns: DS_SUCCESS or a DS_ERROR_* code (see ds_arena_view_map)
+ */
+static inline int ds_arena_view_open(struct ds_arena_view *view, const char *pin_path)
+{
+	struct bpf_map_info info;
+	union bpf_attr attr;
+	long page_size = sysconf(_SC_PAGESIZE);
+	int fd, ret;
+
+	if (!view || !pin_path || page_size <= 0)
+		return DS_ERROR_INVALID;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.pathname = (__u64)(unsigned long)pin_path;
+	fd = (int)ds_lane_bpf(BPF_OBJ_GET, &attr);
+	if (fd < 0)
+		return errno == ENOENT ? DS_ERROR_NOT_FOUND : DS_ERROR_INVALID;
+
+	memset(&info, 0, sizeof(info));
+	memset(&attr, 0, sizeof(attr));
+	attr.info.bpf_fd = (__u32)fd;
+	attr.info.info_len = sizeof(info);
+	attr.info.info = (__u64)(unsigned long)&info;
+	if (ds_lane_bpf(BPF_OBJ_GET_INFO_BY_FD, &attr) ||
+	    info.type != DS_LANE_BPF_MAP_TYPE_ARENA || !info.map_extra) {
+		close(fd);
+		return DS_ERROR_INVALID;
+	}
+
+	ret = ds_arena_view_map(view, fd, (void *)(unsigned long)info.map_extra,
+				(size_t)info.max_entries * (size_t)page_size);
+	if (ret != DS_SUCCESS)
+		close(fd);
+	return ret;
+}
+
+static inline void ds_arena_view_close(struct ds_arena_view *view)
+{
+	if (!view || !view->base)
+		return;
+	munmap(view->base, view->bytes);
+	if (view->map_fd >= 0)
+		close(view->map_fd);
+	view->base = NULL;
+	view->dir = NULL;
+}
+
+/**
+ * ds_lane_dir_lookup - Find a published lane by name
+ *
+ * Returns: The entry, or NULL if no lane of that name is published yet
+ */
+static inline struct ds_lane_dir_entry *ds_lane_dir_lookup(struct ds_lane_dir *dir,
+							   const char *name)
+{
+	__u32 nr;
+
+	if (!dir || !name)
+		return NULL;
+
+	nr = arena_atomic_load(&dir->nr_lanes, ARENA_ACQUIRE);
+	for (__u32 i = 0; i < nr && i < DS_LANE_DIR_MAX_LANES; i++) {
+		if (!strncmp(dir->lanes[i].name, name, DS_LANE_NAME_LEN))
+			return &dir->lanes[i];
+	}
+	return NULL;
+}
+
+/* Lane head pointer, valid in any process that mapped the arena at map_extra */
+static inline void *ds_lane_head(const struct ds_lane_dir_entry *e)
+{
+	return (void *)(unsigned long)e->head;
+}
+
+static inline bool ds_lane_closed(const struct ds_lane_dir_entry *e)
+{
+	return arena_atomic_load(&e->flags, ARENA_ACQUIRE) & DS_LANE_F_CLOSED;
+}
+
+static inline bool ds_lane_pid_alive(__u64 pid)
+{
+	return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * ds_lane_claim - Attach this process as a consumer of @e
+ *
+ * Single-consumer lanes are claimed with a CAS on @owner_pid. A claim held
+ * by a dead process is taken over. Multi-consumer lanes only count
+ * attachments.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_BUSY if another live process holds the lane
+ */
+static inline int ds_lane_claim(struct ds_lane_dir_entry *e)
+{
+	__u64 self = (__u64)getpid();
+
+	if (!e)
+		return DS_ERROR_INVALID;
+
+	if (arena_atomic_load(&e->flags, ARENA_ACQUIRE) & DS_LANE_F_SINGLE_CONSUMER) {
+		__u64 holder = arena_atomic_load(&e->owner_pid, ARENA_ACQUIRE);
+
+		for (;;) {
+			__u64 seen;
+
+			if (holder == self)
+				return DS_SUCCESS;
+			if (holder && ds_lane_pid_alive(holder))
+				return DS_ERROR_BUSY;
+			seen = arena_atomic_cmpxchg(&e->owner_pid, holder, self,
+						    ARENA_ACQ_REL, ARENA_ACQUIRE);
+			if (seen == holder)
+				break;
+			holder = seen;
+		}
+	}
+
+	arena_atomic_add(&e->consumers, 1, ARENA_RELAXED);
+	return DS_SUCCESS;
+}
+
+/* Detach this process; releases a single-consumer claim */
+static inline void ds_lane_release(struct ds_lane_dir_entry *e)
+{
+	if (!e)
+		return;
+	arena_atomic_sub(&e->consumers, 1, ARENA_RELAXED);
+	arena_atomic_cmpxchg(&e->owner_pid, (__u64)getpid(), 0, ARENA_RELEASE, ARENA_RELAXED);
+}
+
+/* Count @n entries popped through this lane (visible to every process) */
+static inline void ds_lane_account(struct ds_lane_dir_entry *e, __u64 n)
+{
+	arena_atomic_add(&e->consumed, n, ARENA_RELAXED);
+}
+
+static inline const struct ds_metadata *ds_lane_dir_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "lane_dir",
+		.description = "Lane directory at a fixed arena offset for cross-process consumers",
+		.node_size = sizeof(struct ds_lane_dir_entry),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_LANE_DIR_H */
@@ -0,0 +1,862 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Bounded Concurrent CLOCK Cache (LRU approximation) for BPF Arena
+ *
+ * A set-associative cache whose replacement policy is CLOCK, the usual
+ * lock-free approximation of LRU:
+ * - capacity = nr_sets * DS_LRU_WAYS; a key hashes to exactly one set
+ * - each way holds its entry inline, guarded by a per-way seqcount
+ * - lookups are lock-free and perform no atomic RMW: a hit only stores
+ *   way->ref = 1 when it is not already set
+ * - inserts claim a way with one CAS on its seqcount (even -> odd),
+ *   rewrite it and release it (odd -> even); when the set is full a
+ *   per-set CLOCK hand picks the victim, clearing reference bits as it
+ *   sweeps
+ *
+ * Ways are recycled in place and never freed while the cache lives, so a
+ * reader or sweeper that races with an eviction only ever touches another
+ * ds_lru_way: a stray reference bit store is at worst a wrong hint.
+ * Readers re-check the seqcount after reading the payload, so an entry
+ * rewritten mid-read is reported as a miss instead of torn data. The set
+ * array is the only allocation; inserts never allocate, so every
+ * operation may run from non-sleepable BPF programs.
+ *
+ * Two concurrent inserts of the same missing key may both land in the
+ * set. Lookups return whichever they see first, delete removes all
+ * copies, and CLOCK ages the stale one out.
+ */
+#ifndef DS_LRU_H
+#define DS_LRU_H
+
+#pragma once
+
+#include "ds_api.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Associativity: ways per set. Must be a power of 2. */
+#define DS_LRU_WAYS 8
+
+/* Bound on CLOCK hand advances per insert (two full sweeps of a set) */
+#define DS_LRU_MAX_SWEEP (2 * DS_LRU_WAYS)
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_lru_way - One cache entry, rewritten in place
+ * @seq: Seqcount; odd while a writer owns the way, +2 per rewrite
+ * @data: Cached key/value pair
+ * @ref: CLOCK reference bit; set by lookups, cleared by the sweeping hand
+ * @live: 1 if @data holds an entry, 0 for an empty way
+ */
+struct ds_lru_way {
+	__u64 seq;
+	struct ds_kv data;
+	__u32 ref;
+	__u32 live;
+};
+
+/**
+ * struct ds_lru_set - One associativity set
+ * @ways: Inline entries
+ * @hand: CLOCK hand; advanced with fetch-add, taken modulo DS_LRU_WAYS
+ */
+struct ds_lru_set {
+	struct ds_lru_way ways[DS_LRU_WAYS];
+	__u64 hand;
+};
+
+/**
+ * struct ds_lru_head - Cache control block
+ * @set_mask: nr_sets - 1 (nr_sets is a power of 2)
+ * @sets: Arena-allocated array of nr_sets sets
+ * @count: Live entries
+ * @evictions: Entries displaced by the CLOCK hand
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
+ */
+struct ds_lru_head {
+	__u64 set_mask;
+	struct ds_lru_set __arena *sets;
+	__u64 count;
+	__u64 evictions;
+	DS_OP_STATS_FIELD
+};
+
+typedef struct ds_lru_head __arena ds_lru_head_t;
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+static inline __u64 ds_lru_hash(__u64 key)
+{
+	/* Fibonacci hashing; the high bits are the well-mixed ones */
+	return (key * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+static inline struct ds_lru_set __arena *
+ds_lru_set_of(struct ds_lru_head __arena *head, __u64 key)
+{
+	struct ds_lru_set __arena *set;
+
+	set = &head->sets[ds_lru_hash(key) & head->set_mask];
+	cast_kern(set);
+	return set;
+}
+
+/*
+ * Claim a way last seen stable at @seq. Fails if it has been claimed or
+ * rewritten since, which also validates whatever was read under @seq.
+ * The value-returning BPF cmpxchg is fully ordered, so the payload
+ * stores that follow cannot pass it.
+ */
+static inline bool ds_lru_way_claim_lkmm(struct ds_lru_way __arena *way, __u64 seq)
+{
+	return arena_atomic_cmpxchg(&way->seq, seq, seq + 1,
+				    ARENA_ACQUIRE, ARENA_RELAXED) == seq;
+}
+
+/* Release a way claimed at @seq; the payload stores happen before it */
+static inline void ds_lru_way_release_lkmm(struct ds_lru_way __arena *way, __u64 seq)
+{
+	smp_store_release(&way->seq, seq + 2);
+}
+
+/* Fill a claimed way with a fresh, unreferenced entry */
+static inline void ds_lru_way_fill_lkmm(struct ds_lru_way __arena *way,
+					__u64 key, __u64 value)
+{
+	WRITE_ONCE(way->data.key, key);
+	WRITE_ONCE(way->data.value, value);
+	WRITE_ONCE(way->ref, 0);
+	WRITE_ONCE(way->live, 1);
+}
+
+#ifndef __BPF__
+static inline bool ds_lru_way_claim_c(struct ds_lru_way __arena *way, __u64 seq)
+{
+	if (arena_atomic_cmpxchg(&way->seq, seq, seq + 1,
+				 ARENA_ACQUIRE, ARENA_RELAXED) != seq)
+		return false;
+	/* An acquire RMW does not keep its store before the payload stores */
+	arena_smp_wmb();
+	return true;
+}
+
+static inline void ds_lru_way_release_c(struct ds_lru_way __arena *way, __u64 seq)
+{
+	arena_atomic_store(&way->seq, seq + 2, ARENA_RELEASE);
+}
+
+static inline void ds_lru_way_fill_c(struct ds_lru_way __arena *way, __u64 key, __u64 value)
+{
+	arena_atomic_store(&way->data.key, key, ARENA_RELAXED);
+	arena_atomic_store(&way->data.value, value, ARENA_RELAXED);
+	arena_atomic_store(&way->ref, 0, ARENA_RELAXED);
+	arena_atomic_store(&way->live, 1, ARENA_RELAXED);
+}
+#endif
+
+/* ========================================================================
+ * INIT
+ * ======================================================================== */
+
+/**
+ * ds_lru_init_lkmm - Initialize the cache
+ * @head: Cache head to initialize
+ * @capacity: Total entries; power of 2 and at least DS_LRU_WAYS
+ *
+ * Allocates capacity / DS_LRU_WAYS sets and clears every way. Arrays
+ * larger than a page take a page run, which needs a sleepable program.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_INVALID on bad capacity,
+ *          DS_ERROR_NOMEM if the set array cannot be allocated
+ */
+static inline int __ds_lru_init_lkmm(struct ds_lru_head __arena *head, __u32 capacity)
+{
+	struct ds_lru_set __arena *sets;
+	__u32 nr_sets;
+
+	cast_kern(head);
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	if (capacity < DS_LRU_WAYS || (capacity & (capacity - 1)) != 0)
+		return DS_ERROR_INVALID;
+
+	nr_sets = capacity / DS_LRU_WAYS;
+	sets = ds_arena_alloc_array((__u64)nr_sets * sizeof(struct ds_lru_set));
+	if (!sets)
+		return DS_ERROR_NOMEM;
+
+	cast_kern(sets);
+	for (__u32 i = 0; i < nr_sets && can_loop; i++) {
+		struct ds_lru_set __arena *set = &sets[i];
+
+		cast_kern(set);
+		for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+			struct ds_lru_way __arena *way = &set->ways[w];
+
+			WRITE_ONCE(way->seq, 0);
+			WRITE_ONCE(way->data.key, 0);
+			WRITE_ONCE(way->data.value, 0);
+			WRITE_ONCE(way->ref, 0);
+			WRITE_ONCE(way->live, 0);
+		}
+		WRITE_ONCE(set->hand, 0);
+	}
+
+	head->set_mask = nr_sets - 1;
+	WRITE_ONCE(head->count, 0);
+	WRITE_ONCE(head->evictions, 0);
+
+	/* Publish the set array last; readers test head->sets for readiness */
+	cast_user(sets);
+	smp_store_release(&head->sets, sets);
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_lru_init_lkmm(struct ds_lru_head __arena *head, __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_lru_init_lkmm(head, capacity));
+}
+
+#ifndef __BPF__
+static inline int __ds_lru_init_c(struct ds_lru_head __arena *head, __u32 capacity)
+{
+	struct ds_lru_set __arena *sets;
+	__u32 nr_sets;
+
+	cast_kern(head);
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	if (capacity < DS_LRU_WAYS || (capacity & (capacity - 1)) != 0)
+		return DS_ERROR_INVALID;
+
+	nr_sets = capacity / DS_LRU_WAYS;
+	sets = ds_arena_alloc_array((__u64)nr_sets * sizeof(struct ds_lru_set));
+	if (!sets)
+		return DS_ERROR_NOMEM;
+
+	cast_kern(sets);
+	for (__u32 i = 0; i < nr_sets && can_loop; i++) {
+		struct ds_lru_set __arena *set = &sets[i];
+
+		cast_kern(set);
+		for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+			struct ds_lru_way __arena *way = &set->ways[w];
+
+			arena_atomic_store(&way->seq, 0, ARENA_RELAXED);
+			arena_atomic_store(&way->data.key, 0, ARENA_RELAXED);
+			arena_atomic_store(&way->data.value, 0, ARENA_RELAXED);
+			arena_atomic_store(&way->ref, 0, ARENA_RELAXED);
+			arena_atomic_store(&way->live, 0, ARENA_RELAXED);
+		}
+		arena_atomic_store(&set->hand, 0, ARENA_RELAXED);
+	}
+
+	arena_atomic_store(&head->set_mask, nr_sets - 1, ARENA_RELAXED);
+	arena_atomic_store(&head->count, 0, ARENA_RELAXED);
+	arena_atomic_store(&head->evictions, 0, ARENA_RELAXED);
+
+	cast_user(sets);
+	arena_atomic_store(&head->sets, sets, ARENA_RELEASE);
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_lru_init_c(struct ds_lru_head __arena *head, __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_lru_init_c(head, capacity));
+}
+#endif
+
+static inline int ds_lru_init(struct ds_lru_head __arena *head, __u32 capacity)
+{
+#ifdef __BPF__
+	return ds_lru_init_lkmm(head, capacity);
+#else
+	return ds_lru_init_c(head, capacity);
+#endif
+}
+
+/* ========================================================================
+ * LOOKUP (lock-free, no atomic RMW)
+ * ======================================================================== */
+
+/**
+ * ds_lru_lookup_lkmm - Look up a key and mark it recently used
+ * @head: Cache head
+ * @key: Key to look up
+ * @value: Output for the cached value; may be NULL
+ *
+ * Seqcount reader per way: the acquire load of way->seq pairs with the
+ * writer's release, and the read barrier keeps the payload loads before
+ * the re-check. The reference bit is written only when clear, which keeps
+ * hot entries from bouncing their cache line.
+ *
+ * Returns: DS_SUCCESS on hit, DS_ERROR_NOT_FOUND on miss,
+ *          DS_ERROR_INVALID if the cache is not initialized
+ */
+static inline int __ds_lru_lookup_lkmm(struct ds_lru_head __arena *head,
+				       __u64 key, __u64 *value)
+{
+	struct ds_lru_set __arena *set;
+
+	if (!head || !head->sets)
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq, val;
+
+		seq = smp_load_acquire(&way->seq);
+		if (seq & 1)
+			continue;
+		if (!READ_ONCE(way->live) || READ_ONCE(way->data.key) != key)
+			continue;
+		val = READ_ONCE(way->data.value);
+
+		arena_smp_rmb();
+		if (READ_ONCE(way->seq) != seq)
+			continue;
+
+		if (!READ_ONCE(way->ref))
+			WRITE_ONCE(way->ref, 1);
+		if (value)
+			*value = val;
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_NOT_FOUND;
+}
+
+static inline int ds_lru_lookup_lkmm(struct ds_lru_head __arena *head,
+				     __u64 key, __u64 *value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_lru_lookup_lkmm(head, key, value));
+}
+
+#ifndef __BPF__
+static inline int __ds_lru_lookup_c(struct ds_lru_head __arena *head,
+				    __u64 key, __u64 *value)
+{
+	struct ds_lru_set __arena *set;
+
+	if (!head || !arena_atomic_load(&head->sets, ARENA_ACQUIRE))
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq, val;
+
+		seq = arena_atomic_load(&way->seq, ARENA_ACQUIRE);
+		if (seq & 1)
+			continue;
+		if (!arena_atomic_load(&way->live, ARENA_RELAXED) ||
+		    arena_atomic_load(&way->data.key, ARENA_RELAXED) != key)
+			continue;
+		val = arena_atomic_load(&way->data.value, ARENA_RELAXED);
+
+		arena_smp_rmb();
+		if (arena_atomic_load(&way->seq, ARENA_RELAXED) != seq)
+			continue;
+
+		if (!arena_atomic_load(&way->ref, ARENA_RELAXED))
+			arena_atomic_store(&way->ref, 1, ARENA_RELAXED);
+		if (value)
+			*value = val;
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_NOT_FOUND;
+}
+
+static inline int ds_lru_lookup_c(struct ds_lru_head __arena *head,
+				  __u64 key, __u64 *value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_lru_lookup_c(head, key, value));
+}
+#endif
+
+static inline int ds_lru_lookup(struct ds_lru_head __arena *head, __u64 key, __u64 *value)
+{
+#ifdef __BPF__
+	return ds_lru_lookup_lkmm(head, key, value);
+#else
+	return ds_lru_lookup_c(head, key, value);
+#endif
+}
+
+/* ========================================================================
+ * INSERT (with eviction)
+ * ======================================================================== */
+
+/**
+ * ds_lru_insert_lkmm - Insert or update a key, evicting if the set is full
+ * @head: Cache head
+ * @key: Key to insert
+ * @value: Value to cache
+ *
+ * Order of preference inside the key's set:
+ *   1. rewrite the value of an existing entry for @key (update)
+ *   2. fill an empty way
+ *   3. CLOCK sweep: clear set reference bits until an unreferenced
+ *      victim is found, then overwrite it
+ * New entries start with ref = 0, so a one-shot scan cannot flush entries
+ * that have been hit since the hand last passed them. An update keeps the
+ * entry's reference bit.
+ *
+ * Every rewrite happens between a claim CAS and a release store of the
+ * way's seqcount. Nothing is allocated or freed.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_BUSY if every claim in the bounded sweep
+ *          lost a race, DS_ERROR_INVALID if the cache is not initialized
+ */
+static inline int __ds_lru_insert_lkmm(struct ds_lru_head __arena *head,
+				       __u64 key, __u64 value)
+{
+	struct ds_lru_set __arena *set;
+
+	if (!head || !head->sets)
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	/* 1. Update in place */
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = smp_load_acquire(&way->seq);
+
+		if ((seq & 1) || !READ_ONCE(way->live) || READ_ONCE(way->data.key) != key)
+			continue;
+		if (!ds_lru_way_claim_lkmm(way, seq))
+			continue;
+		WRITE_ONCE(way->data.value, value);
+		ds_lru_way_release_lkmm(way, seq);
+		return DS_SUCCESS;
+	}
+
+	/* 2. Empty way */
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = smp_load_acquire(&way->seq);
+
+		if ((seq & 1) || READ_ONCE(way->live))
+			continue;
+		if (!ds_lru_way_claim_lkmm(way, seq))
+			continue;
+		ds_lru_way_fill_lkmm(way, key, value);
+		ds_lru_way_release_lkmm(way, seq);
+		arena_atomic_inc(&head->count);
+		return DS_SUCCESS;
+	}
+
+	/* 3. CLOCK sweep */
+	for (__u32 i = 0; i < DS_LRU_MAX_SWEEP && can_loop; i++) {
+		__u32 w = arena_atomic_add(&set->hand, 1, ARENA_RELAXED) & (DS_LRU_WAYS - 1);
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = smp_load_acquire(&way->seq);
+		bool live;
+
+		if (seq & 1)
+			continue;
+
+		live = READ_ONCE(way->live);
+		if (live && READ_ONCE(way->ref)) {
+			/* Second chance */
+			WRITE_ONCE(way->ref, 0);
+			continue;
+		}
+
+		if (!ds_lru_way_claim_lkmm(way, seq))
+			continue;
+		ds_lru_way_fill_lkmm(way, key, value);
+		ds_lru_way_release_lkmm(way, seq);
+		if (live)
+			arena_atomic_inc(&head->evictions);
+		else
+			arena_atomic_inc(&head->count);
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_BUSY;
+}
+
+static inline int ds_lru_insert_lkmm(struct ds_lru_head __arena *head,
+				     __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_lru_insert_lkmm(head, key, value));
+}
+
+#ifndef __BPF__
+static inline int __ds_lru_insert_c(struct ds_lru_head __arena *head,
+				    __u64 key, __u64 value)
+{
+	struct ds_lru_set __arena *set;
+
+	if (!head || !arena_atomic_load(&head->sets, ARENA_ACQUIRE))
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = arena_atomic_load(&way->seq, ARENA_ACQUIRE);
+
+		if ((seq & 1) || !arena_atomic_load(&way->live, ARENA_RELAXED) ||
+		    arena_atomic_load(&way->data.key, ARENA_RELAXED) != key)
+			continue;
+		if (!ds_lru_way_claim_c(way, seq))
+			continue;
+		arena_atomic_store(&way->data.value, value, ARENA_RELAXED);
+		ds_lru_way_release_c(way, seq);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = arena_atomic_load(&way->seq, ARENA_ACQUIRE);
+
+		if ((seq & 1) || arena_atomic_load(&way->live, ARENA_RELAXED))
+			continue;
+		if (!ds_lru_way_claim_c(way, seq))
+			continue;
+		ds_lru_way_fill_c(way, key, value);
+		ds_lru_way_release_c(way, seq);
+		arena_atomic_inc(&head->count);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 i = 0; i < DS_LRU_MAX_SWEEP && can_loop; i++) {
+		__u32 w = arena_atomic_add(&set->hand, 1, ARENA_RELAXED) & (DS_LRU_WAYS - 1);
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = arena_atomic_load(&way->seq, ARENA_ACQUIRE);
+		bool live;
+
+		if (seq & 1)
+			continue;
+
+		live = arena_atomic_load(&way->live, ARENA_RELAXED);
+		if (live && arena_atomic_load(&way->ref, ARENA_RELAXED)) {
+			arena_atomic_store(&way->ref, 0, ARENA_RELAXED);
+			continue;
+		}
+
+		if (!ds_lru_way_claim_c(way, seq))
+			continue;
+		ds_lru_way_fill_c(way, key, value);
+		ds_lru_way_release_c(way, seq);
+		if (live)
+			arena_atomic_inc(&head->evictions);
+		else
+			arena_atomic_inc(&head->count);
+		return DS_SUCCESS;
+	}
+
+	return DS_ERROR_BUSY;
+}
+
+static inline int ds_lru_insert_c(struct ds_lru_head __arena *head,
+				  __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_lru_insert_c(head, key, value));
+}
+#endif
+
+static inline int ds_lru_insert(struct ds_lru_head __arena *head, __u64 key, __u64 value)
+{
+#ifdef __BPF__
+	return ds_lru_insert_lkmm(head, key, value);
+#else
+	return ds_lru_insert_c(head, key, value);
+#endif
+}
+
+/* ========================================================================
+ * DELETE
+ * ======================================================================== */
+
+/**
+ * ds_lru_delete_lkmm - Remove every entry for @key from its set
+ * @head: Cache head
+ * @key: Key to remove
+ *
+ * Returns: DS_SUCCESS if at least one entry was removed,
+ *          DS_ERROR_NOT_FOUND otherwise
+ */
+static inline int __ds_lru_delete_lkmm(struct ds_lru_head __arena *head, __u64 key)
+{
+	struct ds_lru_set __arena *set;
+	int ret = DS_ERROR_NOT_FOUND;
+
+	if (!head || !head->sets)
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = smp_load_acquire(&way->seq);
+
+		if ((seq & 1) || !READ_ONCE(way->live) || READ_ONCE(way->data.key) != key)
+			continue;
+		if (!ds_lru_way_claim_lkmm(way, seq))
+			continue;
+		WRITE_ONCE(way->live, 0);
+		ds_lru_way_release_lkmm(way, seq);
+		arena_atomic_dec(&head->count);
+		ret = DS_SUCCESS;
+	}
+
+	return ret;
+}
+
+static inline int ds_lru_delete_lkmm(struct ds_lru_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_lru_delete_lkmm(head, key));
+}
+
+#ifndef __BPF__
+static inline int __ds_lru_delete_c(struct ds_lru_head __arena *head, __u64 key)
+{
+	struct ds_lru_set __arena *set;
+	int ret = DS_ERROR_NOT_FOUND;
+
+	if (!head || !arena_atomic_load(&head->sets, ARENA_ACQUIRE))
+		return DS_ERROR_INVALID;
+
+	set = ds_lru_set_of(head, key);
+
+	for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+		struct ds_lru_way __arena *way = &set->ways[w];
+		__u64 seq = arena_atomic_load(&way->seq, ARENA_ACQUIRE);
+
+		if ((seq & 1) || !arena_atomic_load(&way->live, ARENA_RELAXED) ||
+		    arena_atomic_load(&way->data.key, ARENA_RELAXED) != key)
+			continue;
+		if (!ds_lru_way_claim_c(way, seq))
+			continue;
+		arena_atomic_store(&way->live, 0, ARENA_RELAXED);
+		ds_lru_way_release_c(way, seq);
+		arena_atomic_dec(&head->count);
+		ret = DS_SUCCESS;
+	}
+
+	return ret;
+}
+
+static inline int ds_lru_delete_c(struct ds_lru_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_DELETE, __ds_lru_delete_c(head, key));
+}
+#endif
+
+static inline int ds_lru_delete(struct ds_lru_head __arena *head, __u64 key)
+{
+#ifdef __BPF__
+	return ds_lru_delete_lkmm(head, key);
+#else
+	return ds_lru_delete_c(head, key);
+#endif
+}
+
+static inline int ds_lru_search(struct ds_lru_head __arena *head, __u64 key)
+{
+	return ds_lru_lookup(head, key, NULL);
+}
+
+/* ========================================================================
+ * VERIFY
+ * ======================================================================== */
+
+/**
+ * ds_lru_verify_lkmm - Check cache invariants (quiescent use only)
+ * @head: Cache head
+ *
+ * Checks that no way is left claimed, that every live entry hashes to the
+ * set holding it and that the live count matches the entries found.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_CORRUPT / DS_ERROR_INVALID
+ */
+static inline int __ds_lru_verify_lkmm(struct ds_lru_head __arena *head)
+{
+	struct ds_lru_set __arena *sets;
+	__u64 nr_sets;
+	__u64 installed = 0;
+
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	cast_kern(head);
+	sets = READ_ONCE(head->sets);
+	if (!sets)
+		return DS_ERROR_CORRUPT;
+
+	nr_sets = head->set_mask + 1;
+	if (nr_sets & head->set_mask)
+		return DS_ERROR_CORRUPT;
+
+	for (__u64 i = 0; i < nr_sets && can_loop; i++) {
+		struct ds_lru_set __arena *set = &sets[i];
+
+		cast_kern(set);
+		for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+			struct ds_lru_way __arena *way = &set->ways[w];
+
+			if (READ_ONCE(way->seq) & 1)
+				return DS_ERROR_CORRUPT;
+			if (!READ_ONCE(way->live))
+				continue;
+			if ((ds_lru_hash(way->data.key) & head->set_mask) != i)
+				return DS_ERROR_CORRUPT;
+			installed++;
+		}
+	}
+
+	if (READ_ONCE(head->count) != installed)
+		return DS_ERROR_CORRUPT;
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_lru_verify_lkmm(struct ds_lru_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_lru_verify_lkmm(head));
+}
+
+#ifndef __BPF__
+static inline int __ds_lru_verify_c(struct ds_lru_head __arena *head)
+{
+	struct ds_lru_set __arena *sets;
+	__u64 nr_sets;
+	__u64 mask;
+	__u64 installed = 0;
+
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	cast_kern(head);
+	sets = arena_atomic_load(&head->sets, ARENA_ACQUIRE);
+	if (!sets)
+		return DS_ERROR_CORRUPT;
+
+	mask = arena_atomic_load(&head->set_mask, ARENA_RELAXED);
+	nr_sets = mask + 1;
+	if (nr_sets & mask)
+		return DS_ERROR_CORRUPT;
+
+	for (__u64 i = 0; i < nr_sets && can_loop; i++) {
+		struct ds_lru_set __arena *set = &sets[i];
+
+		cast_kern(set);
+		for (__u32 w = 0; w < DS_LRU_WAYS && can_loop; w++) {
+			struct ds_lru_way __arena *way = &set->ways[w];
+
+			if (arena_atomic_load(&way->seq, ARENA_ACQUIRE) & 1)
+				return DS_ERROR_CORRUPT;
+			if (!arena_atomic_load(&way->live, ARENA_RELAXED))
+				continue;
+			if ((ds_lru_hash(way->data.key) & mask) != i)
+				return DS_ERROR_CORRUPT;
+			installed++;
+		}
+	}
+
+	if (arena_atomic_load(&head->count, ARENA_RELAXED) != installed)
+		return DS_ERROR_CORRUPT;
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_lru_verify_c(struct ds_lru_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_lru_verify_c(head));
+}
+#endif
+
+static inline int ds_lru_verify(struct ds_lru_head __arena *head)
+{
+#ifdef __BPF__
+	return ds_lru_verify_lkmm(head);
+#else
+	return ds_lru_verify_c(head);
+#endif
+}
+
+/**
+ * ds_lru_get_metadata - Get data structure metadata
+ */
+static inline const struct ds_metadata *ds_lru_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "lru",
+		.description = "Set-associative CLOCK cache (LRU approximation)",
+		.node_size = sizeof(struct ds_lru_way),
+		.requires_locking = 0,
+	};
+
+	return &metadata;
+}
+
+/**
+ * ds_lru_stats - Live entries, set memory and per-op counters
+ * @head: Cache
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Lookups count as DS_OP_SEARCH.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_lru_stats_lkmm(struct ds_lru_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = READ_ONCE(head->count);
+	stats->max_elements = 0;
+	stats->memory_used = head->sets ? (head->set_mask + 1) * sizeof(struct ds_lru_set) : 0;
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_lru_stats_c(struct ds_lru_head __arena *head, struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	stats->current_elements = arena_atomic_load(&head->count, ARENA_RELAXED);
+	stats->max_elements = 0;
+	stats->memory_used = head->sets ? (head->set_mask + 1) * sizeof(struct ds_lru_set) : 0;
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_lru_stats(struct ds_lru_head __arena *head, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_lru_stats_lkmm(head, stats);
+#else
+	return ds_lru_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_lru_reset_stats(struct ds_lru_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
+
+#endif /* DS_LRU_H */
@@ -49,9 +49,49 @@ enum ds_metrics_category {
 	DS_METRICS_NUM_CATEGORIES = 4,
 };
 
+/* Extra ring that only ds_metrics_calibrate() records into */
+#define DS_METRICS_CALIB	DS_METRICS_NUM_CATEGORIES
+#define DS_METRICS_NUM_RINGS	(DS_METRICS_NUM_CATEGORIES + 1)
+
+/* Which clock a category is timed with; indexes ds_metrics_store.calib */
+enum ds_metrics_side {
+	DS_METRICS_SIDE_KERNEL = 0,  /* bpf_ktime_get_ns() in a BPF program */
+	DS_METRICS_SIDE_USER = 1,    /* clock_gettime() in the loader */
+	DS_METRICS_NUM_SIDES = 2,
+};
+
+/* Empty ops per calibration round, and rounds; the quietest round wins */
+#define DS_METRICS_CALIB_OPS	256
+#define DS_METRICS_CALIB_ROUNDS	16
+
+/**
+ * struct ds_metrics_calib - Cost of timing nothing, per side
+ * @ops: Empty ops timed (0 = not calibrated)
+ * @bias_ns: Latency an empty DS_METRICS_RECORD_OP reports. Every sample
+ *           includes it, so ds_metrics_print() subtracts it.
+ * @cost_ns: Wall time of one empty DS_METRICS_RECORD_OP, clock reads and
+ *           ds_metrics_record() included: what recording adds to a caller
+ */
+struct ds_metrics_calib {
+	__u64 ops;
+	__u64 bias_ns;
+	__u64 cost_ns;
+};
+
+/* Source-side admission outcomes, one counter each (see ds_filter.h) */
+enum ds_metrics_filter_counter {
+	DS_METRICS_FILTER_ENQUEUED = 0,      /* passed the rules, handed to KU */
+	DS_METRICS_FILTER_DROP_PID = 1,      /* rejected by the PID set */
+	DS_METRICS_FILTER_DROP_CGROUP = 2,   /* rejected by the cgroup set */
+	DS_METRICS_FILTER_DROP_SAMPLE = 3,   /* passed the sets, sampled out */
+	DS_METRICS_FILTER_NUM = 4,
+};
+
 /* Top-level metrics store — lives in arena */
 struct ds_metrics_store {
-	struct ds_metrics_ring rings[DS_METRICS_NUM_CATEGORIES];
+	struct ds_metrics_ring rings[DS_METRICS_NUM_RINGS];
+	__u64 filter[DS_METRICS_FILTER_NUM];
+	struct ds_metrics_calib calib[DS_METRICS_NUM_SIDES];
 };
 
 /* ========================================================================
@@ -126,6 +166,22 @@ static inline void ds_metrics_record(
 	}
 }
 
+/**
+ * ds_metrics_count_filter - Count one admission decision
+ * @store:   Arena pointer to the top-level metrics store
+ * @verdict: ds_metrics_filter_counter value
+ */
+static inline void ds_metrics_count_filter(
+	struct ds_metrics_store __arena *store,
+	int verdict)
+{
+	if (!store || verdict < 0 || verdict >= DS_METRICS_FILTER_NUM)
+		return;
+
+	cast_kern(store);
+	arena_atomic_add(&store->filter[verdict], 1, ARENA_RELAXED);
+}
+
 /* ========================================================================
  * CONVENIENCE MACRO
  * ======================================================================== */
@@ -150,6 +206,79 @@ do { \
 	ds_metrics_record(store, cat, __elapsed, result_var); \
 } while (0)
 
+/* ========================================================================
+ * OVERHEAD CALIBRATION
+ * ======================================================================== */
+
+/**
+ * ds_metrics_calibrate - Measure what an empty DS_METRICS_RECORD_OP costs
+ * @store: Arena pointer to the top-level metrics store
+ * @side:  ds_metrics_side whose clock this context uses
+ *
+ * Runs DS_METRICS_CALIB_ROUNDS rounds of DS_METRICS_CALIB_OPS empty ops
+ * into the DS_METRICS_CALIB ring and keeps the lowest per-op average of
+ * each measure, so a round hit by an interrupt or migration is dropped.
+ * Call it from the side being measured: a SEC("syscall") program run with
+ * BPF_PROG_TEST_RUN for the kernel, the loader itself for userspace. It
+ * runs before attach; the category rings are not touched.
+ */
+static inline void ds_metrics_calibrate(
+	struct ds_metrics_store __arena *store,
+	enum ds_metrics_side side)
+{
+	struct ds_metrics_ring __arena *ring;
+	__u64 bias = ~0ULL, cost = ~0ULL;
+	__u32 r, i;
+
+	if (!store || side >= DS_METRICS_NUM_SIDES)
+		return;
+
+	cast_kern(store);
+	ring = &store->rings[DS_METRICS_CALIB];
+	cast_kern(ring);
+
+	for (r = 0; r < DS_METRICS_CALIB_ROUNDS && can_loop; r++) {
+		__u64 lat0 = ring->total_latency_ns;
+		__u64 t0 = DS_METRICS_CLOCK_START();
+		int result = DS_SUCCESS;
+
+		for (i = 0; i < DS_METRICS_CALIB_OPS && can_loop; i++)
+			DS_METRICS_RECORD_OP(store, DS_METRICS_CALIB, {}, result);
+
+		t0 = DS_METRICS_CLOCK_END(t0) / DS_METRICS_CALIB_OPS;
+		lat0 = (ring->total_latency_ns - lat0) / DS_METRICS_CALIB_OPS;
+		if (t0 < cost)
+			cost = t0;
+		if (lat0 < bias)
+			bias = lat0;
+	}
+
+	store->calib[side].bias_ns = bias;
+	store->calib[side].cost_ns = cost;
+	store->calib[side].ops = (__u64)DS_METRICS_CALIB_OPS * DS_METRICS_CALIB_ROUNDS;
+}
+
+#ifdef __BPF__
+/*
+ * DS_METRICS_CALIBRATE_PROG - Define the kernel half of calibration
+ * @store: Arena pointer to the program's metrics store
+ *
+ * Expands to SEC("syscall") metrics_calibrate, which the loader runs once
+ * with BPF_PROG_TEST_RUN before attaching (ds_metrics_calibrate_run() in
+ * ds_prog_stats.h) so ds_metrics_print() can take the kernel clock's bias
+ * off the LKMM rows. Use at file scope, after @store is defined.
+ */
+#define DS_METRICS_CALIBRATE_PROG(store)				\
+SEC("syscall")								\
+int metrics_calibrate(void *ctx)					\
+{									\
+	(void)ctx;							\
+									\
+	ds_metrics_calibrate((store), DS_METRICS_SIDE_KERNEL);		\
+	return DS_SUCCESS;						\
+}
+#endif
+
 /* ========================================================================
  * USERSPACE-ONLY STATS PRINTER
  * ======================================================================== */
@@ -163,13 +292,31 @@ static const char *ds_metrics_category_names[DS_METRICS_NUM_CATEGORIES] = {
 	"LKMM consumer",
 };
 
+/* Calibrated timing bias of @cat's clock; 0 until ds_metrics_calibrate() ran */
+static inline __u64 ds_metrics_bias(struct ds_metrics_store __arena *store, int cat)
+{
+	int side = (cat == DS_METRICS_LKMM_PRODUCER || cat == DS_METRICS_LKMM_CONSUMER)
+		? DS_METRICS_SIDE_KERNEL : DS_METRICS_SIDE_USER;
+
+	cast_kern(store);
+	return store->calib[side].ops ? store->calib[side].bias_ns : 0;
+}
+
+/* An average latency with the bias taken off, floored at 0 */
+static inline __u64 ds_metrics_corrected(__u64 avg_ns, __u64 bias_ns)
+{
+	return avg_ns > bias_ns ? avg_ns - bias_ns : 0;
+}
+
 /**
  * ds_metrics_print - Print a formatted performance table
  * @store:   Arena pointer to the metrics store
  * @ds_name: Human-readable name of the data structure being measured
  *
  * Columns: category, total ops, successful ops, success rate (%),
- * average latency (all), average latency (successful only), throughput.
+ * average latency (all), average latency (successful only), both again
+ * with the calibrated timing bias taken off, throughput. Throughput uses
+ * the raw latencies.
  */
 static inline void ds_metrics_print(
 	struct ds_metrics_store __arena *store,
@@ -183,9 +330,9 @@ static inline void ds_metrics_print(
 	printf("============================================================\n");
 	printf("              PERFORMANCE METRICS: %s\n", ds_name);
 	printf("============================================================\n");
-	printf("%-20s %7s %9s %6s %9s %11s %11s\n",
+	printf("%-20s %7s %9s %6s %9s %11s %9s %9s %11s\n",
 	       "Category", "Total", "Success", "Rate%",
-	       "Avg(ns)", "Avg-OK(ns)", "Tput-OK");
+	       "Avg(ns)", "Avg-OK(ns)", "Corr(ns)", "Corr-OK", "Tput-OK");
 
 	for (int i = 0; i < DS_METRICS_NUM_CATEGORIES; i++) {
 		struct ds_metrics_ring __arena *ring = &store->rings[i];
@@ -202,21 +349,55 @@ static inline void ds_metrics_print(
 
 		__u64 avg_all = (total > 0) ? lat_all / total : 0;
 		__u64 avg_ok  = (success > 0) ? lat_ok / success : 0;
+		__u64 bias    = ds_metrics_bias(store, i);
 
 		__u64 throughput = 0;
 		if (lat_ok > 0)
 			throughput = (__u64)((double)success / ((double)lat_ok / 1e9));
 
-		printf("%-20s %7llu %9llu %5.1f%% %9llu %11llu %11llu\n",
+		printf("%-20s %7llu %9llu %5.1f%% %9llu %11llu %9llu %9llu %11llu\n",
 		       ds_metrics_category_names[i],
 		       (unsigned long long)total,
 		       (unsigned long long)success,
 		       rate,
 		       (unsigned long long)avg_all,
 		       (unsigned long long)avg_ok,
+		       (unsigned long long)(total ? ds_metrics_corrected(avg_all, bias) : 0),
+		       (unsigned long long)(success ? ds_metrics_corrected(avg_ok, bias) : 0),
 		       (unsigned long long)throughput);
 	}
 
+	for (int side = 0; side < DS_METRICS_NUM_SIDES; side++) {
+		struct ds_metrics_calib __arena *c = &store->calib[side];
+
+		if (!c->ops) {
+			printf("Calibration (%s): not run, Corr = Avg\n",
+			       side == DS_METRICS_SIDE_KERNEL ? "kernel" : "user");
+			continue;
+		}
+		printf("Calibration (%s): empty op reads %llu ns, costs %llu ns per record (%llu ops)\n",
+		       side == DS_METRICS_SIDE_KERNEL ? "kernel" : "user",
+		       (unsigned long long)c->bias_ns, (unsigned long long)c->cost_ns,
+		       (unsigned long long)c->ops);
+	}
+
+	__u64 enq = store->filter[DS_METRICS_FILTER_ENQUEUED];
+	__u64 by_pid = store->filter[DS_METRICS_FILTER_DROP_PID];
+	__u64 by_cgroup = store->filter[DS_METRICS_FILTER_DROP_CGROUP];
+	__u64 by_sample = store->filter[DS_METRICS_FILTER_DROP_SAMPLE];
+	__u64 seen = enq + by_pid + by_cgroup + by_sample;
+
+	if (seen > 0) {
+		printf("------------------------------------------------------------\n");
+		printf("Source filter: seen=%llu enqueued=%llu filtered=%llu (%.1f%% saved)\n",
+		       (unsigned long long)seen, (unsigned long long)enq,
+		       (unsigned long long)(seen - enq),
+		       (double)(seen - enq) / (double)seen * 100.0);
+		printf("  dropped by pid=%llu cgroup=%llu sampling=%llu\n",
+		       (unsigned long long)by_pid, (unsigned long long)by_cgroup,
+		       (unsigned long long)by_sample);
+	}
+
 	printf("============================================================\n");
 }
 
@@ -54,6 +54,7 @@ struct ds_msqueue_elem {
  * @head: Pointer to head node (always points to dummy node)
  * @tail: Pointer to tail node (last node, may lag during concurrent operations)
  * @count: Number of elements in queue (excluding the dummy node)
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
  * 
  * The queue maintains two key invariants:
  * 1. head always points to a dummy node; the first actual element is head->next
@@ -65,6 +66,7 @@ struct ds_msqueue {
 	struct ds_msqueue_elem __arena *head;
 	struct ds_msqueue_elem __arena *tail;
 	__u64 count;
+	DS_OP_STATS_FIELD
 };
 typedef struct ds_msqueue __arena ds_msqueue_t;
 
@@ -86,7 +88,7 @@ typedef struct ds_msqueue __arena ds_msqueue_t;
  *          DS_ERROR_INVALID if queue pointer is NULL,
  *          DS_ERROR_NOMEM if dummy node allocation fails
  */
-static inline int ds_msqueue_init_lkmm(struct ds_msqueue __arena *queue)
+static inline int __ds_msqueue_init_lkmm(struct ds_msqueue __arena *queue)
 {
 	struct ds_msqueue_elem __arena *dummy;
 	
@@ -114,8 +116,13 @@ static inline int ds_msqueue_init_lkmm(struct ds_msqueue __arena *queue)
 	return DS_SUCCESS;
 }
 
+static inline int ds_msqueue_init_lkmm(struct ds_msqueue __arena *queue)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_INIT, __ds_msqueue_init_lkmm(queue));
+}
+
 #ifndef __BPF__
-static inline int ds_msqueue_init_c(struct ds_msqueue __arena *queue)
+static inline int __ds_msqueue_init_c(struct ds_msqueue __arena *queue)
 {
 	struct ds_msqueue_elem __arena *dummy;
 
@@ -139,6 +146,11 @@ static inline int ds_msqueue_init_c(struct ds_msqueue __arena *queue)
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_msqueue_init_c(struct ds_msqueue __arena *queue)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_INIT, __ds_msqueue_init_c(queue));
+}
 #endif
 
 static inline int ds_msqueue_init(struct ds_msqueue __arena *queue)
@@ -169,6 +181,7 @@ static inline int __msqueue_add_node_lkmm(struct ds_msqueue_elem __arena *new_no
 	struct ds_msqueue_node __arena *next;
 	int max_retries = 10;
 	int retry_count = 0;
+	DS_PHASE_RESUME();
 
 	/* Enqueue loop */
 	while (retry_count < max_retries && can_loop) {
@@ -190,15 +203,18 @@ static inline int __msqueue_add_node_lkmm(struct ds_msqueue_elem __arena *new_no
 			cast_user(tail);
 			(void)arena_atomic_cmpxchg(&queue->tail, tail, next_elem, ARENA_RELEASE, ARENA_RELAXED);
 			retry_count++;
+			DS_PHASE_END(DS_OP_INSERT, DS_PHASE_RETRY);
 			continue;
 		}
 
 		cast_kern(new_node);
 		if (arena_atomic_cmpxchg(&tail->node.next, next, &new_node->node, ARENA_RELEASE, ARENA_RELAXED) == next) {
+			DS_PHASE_END(DS_OP_INSERT, DS_PHASE_CAS);
 			break;
 		}
 
 		retry_count++;
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_RETRY);
 		continue;
 	}
 
@@ -211,11 +227,10 @@ static inline int __msqueue_add_node_lkmm(struct ds_msqueue_elem __arena *new_no
 	
 	cast_user(tail);
 	cast_user(new_node);
-	/* Successfully linked, now try to swing tail to new node */
-	if (arena_atomic_cmpxchg(&queue->tail, tail, new_node, ARENA_RELEASE, ARENA_RELAXED) != tail) {
-		/* Failed to update tail, but it's okay - another thread will help */
-		return DS_SUCCESS;
-	}
+	/* Successfully linked, now try to swing tail to new node. Failing is
+	 * okay - another thread will help */
+	(void)arena_atomic_cmpxchg(&queue->tail, tail, new_node, ARENA_RELEASE, ARENA_RELAXED);
+	DS_PHASE_END(DS_OP_INSERT, DS_PHASE_FIXUP);
 		
 	return DS_SUCCESS;
 }
@@ -227,6 +242,7 @@ static inline int __msqueue_add_node_c(struct ds_msqueue_elem __arena *new_node,
 	struct ds_msqueue_node __arena *next;
 	int max_retries = 10;
 	int retry_count = 0;
+	DS_PHASE_RESUME();
 
 	while (retry_count < max_retries && can_loop) {
 
@@ -243,16 +259,20 @@ static inline int __msqueue_add_node_c(struct ds_msqueue_elem __arena *new_node,
 			cast_user(tail);
 			(void)arena_atomic_cmpxchg(&queue->tail, tail, next_elem, ARENA_RELEASE, ARENA_RELAXED);
 			retry_count++;
+			DS_PHASE_END(DS_OP_INSERT, DS_PHASE_RETRY);
 			continue;
 		}
 
 		cast_kern(new_node);
+		DS_PREEMPT_POINT();
 		if (arena_atomic_cmpxchg(&tail->node.next, next, &new_node->node,
 						ARENA_RELEASE, ARENA_RELAXED) == next) {
+			DS_PHASE_END(DS_OP_INSERT, DS_PHASE_CAS);
 			break;
 		}
 
 		retry_count++;
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_RETRY);
 		continue;
 	}
 
@@ -263,8 +283,8 @@ static inline int __msqueue_add_node_c(struct ds_msqueue_elem __arena *new_node,
 
 	cast_user(tail);
 	cast_user(new_node);
-	if (arena_atomic_cmpxchg(&queue->tail, tail, new_node, ARENA_RELEASE, ARENA_RELAXED) != tail)
-		return DS_SUCCESS;
+	(void)arena_atomic_cmpxchg(&queue->tail, tail, new_node, ARENA_RELEASE, ARENA_RELAXED);
+	DS_PHASE_END(DS_OP_INSERT, DS_PHASE_FIXUP);
 
 	return DS_SUCCESS;
 }
@@ -286,17 +306,20 @@ static inline int __msqueue_add_node_c(struct ds_msqueue_elem __arena *new_node,
  *          DS_ERROR_INVALID if queue is NULL or operation fails after max retries,
  *          DS_ERROR_NOMEM if node allocation fails
  */
-static inline int ds_msqueue_insert_lkmm(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
+static inline int __ds_msqueue_insert_lkmm(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
 {
 	struct ds_msqueue_elem __arena *new_node;
 	
 	if (!queue)
 		return DS_ERROR_INVALID;
+	DS_PHASE_START(DS_OP_INSERT);
 	
 	/* Allocate new element */
 	new_node = bpf_arena_alloc(sizeof(*new_node));
-	if (!new_node)
+	if (!new_node) {
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 		return DS_ERROR_NOMEM;
+	}
 	
 	/* Initialize element */
 	new_node->data.key = key;
@@ -304,40 +327,59 @@ static inline int ds_msqueue_insert_lkmm(struct ds_msqueue __arena *queue, __u64
 	new_node->node.next = NULL;
 	
 	cast_user(new_node);
+	DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 	if (__msqueue_add_node_lkmm(new_node, queue) == DS_SUCCESS) {
 		return DS_SUCCESS;
 	} else {
+		DS_PHASE_RESUME();
 		cast_user(new_node);
 		bpf_arena_free(new_node);
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 		return DS_ERROR_INVALID;
 	}
 }
 
+static inline int ds_msqueue_insert_lkmm(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_INSERT, __ds_msqueue_insert_lkmm(queue, key, value));
+}
+
 #ifndef __BPF__
-static inline int ds_msqueue_insert_c(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
+static inline int __ds_msqueue_insert_c(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
 {
 	struct ds_msqueue_elem __arena *new_node;
 
 	if (!queue)
 		return DS_ERROR_INVALID;
+	DS_PHASE_START(DS_OP_INSERT);
 
 	new_node = bpf_arena_alloc(sizeof(*new_node));
-	if (!new_node)
+	if (!new_node) {
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 		return DS_ERROR_NOMEM;
+	}
 
 	new_node->data.key = key;
 	new_node->data.value = value;
 	new_node->node.next = NULL;
 
 	cast_user(new_node);
+	DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 	if (__msqueue_add_node_c(new_node, queue) == DS_SUCCESS) {
 		return DS_SUCCESS;
 	} else {
+		DS_PHASE_RESUME();
 		cast_user(new_node);
 		bpf_arena_free(new_node);
+		DS_PHASE_END(DS_OP_INSERT, DS_PHASE_ALLOC);
 		return DS_ERROR_INVALID;
 	}
 }
+
+static inline int ds_msqueue_insert_c(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_INSERT, __ds_msqueue_insert_c(queue, key, value));
+}
 #endif
 
 static inline int ds_msqueue_insert(struct ds_msqueue __arena *queue, __u64 key, __u64 value)
@@ -363,7 +405,7 @@ static inline int ds_msqueue_insert(struct ds_msqueue __arena *queue, __u64 key,
  *          DS_ERROR_INVALID if queue is NULL or operation fails after max retries,
  *          DS_ERROR_NOT_FOUND if queue is empty (head->next is NULL)
  */
-static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct ds_kv *data)
+static inline int __ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct ds_kv *data)
 {
 	struct ds_msqueue_elem __arena *head;
 	struct ds_msqueue_elem __arena *tail;
@@ -375,6 +417,7 @@ static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct d
 	if (!queue || !data) {
 		return DS_ERROR_INVALID;
 	}
+	DS_PHASE_START(DS_OP_POP);
 
 	/* Dequeue loop */
 	while (retry_count < max_retries && can_loop) {
@@ -389,12 +432,14 @@ static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct d
 		cast_user(head);
 		if ( READ_ONCE(queue->head) != head ) {
 			retry_count++;
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 			continue;
 		}
 
 		cast_user(next);
 		if ( next == NULL ) {
 			/* Queue is empty */
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_CAS);
 			return DS_ERROR_NOT_FOUND;
 		}
 
@@ -405,6 +450,7 @@ static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct d
 			next_elem_tail = (void __arena *)__msqueue_list_entry(next, struct ds_msqueue_elem, node);
 			(void)arena_atomic_cmpxchg(&queue->tail, tail, next_elem_tail, ARENA_RELEASE, ARENA_RELAXED);
 			retry_count++;
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 			continue;
 		}
 
@@ -419,14 +465,18 @@ static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct d
 		/* LKMM: address dependency chain (head → head->next → next_elem →
 		 * next_elem->data) ensures data visibility; relax CAS to RELAXED */
 		if ( arena_atomic_cmpxchg(&queue->head, head, next_elem, ARENA_RELAXED, ARENA_RELAXED) == head) {
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_CAS);
 			cast_user(head);
 			bpf_arena_free(head);
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_ALLOC);
 		
 			/* Update count (relaxed: just statistics) */
 			arena_atomic_dec(&queue->count);
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_FIXUP);
 			return DS_SUCCESS;
 		}
 		retry_count++;
+		DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 		continue;
 	}
 		
@@ -434,8 +484,13 @@ static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct d
 	return DS_ERROR_INVALID;
 }
 
+static inline int ds_msqueue_pop_lkmm(struct ds_msqueue __arena *queue, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_POP, __ds_msqueue_pop_lkmm(queue, data));
+}
+
 #ifndef __BPF__
-static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_kv *data)
+static inline int __ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_kv *data)
 {
 	struct ds_msqueue_elem __arena *head;
 	struct ds_msqueue_elem __arena *tail;
@@ -446,6 +501,7 @@ static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_k
 	/* Guard userspace caller mistakes that can surface as runner SIGSEGV (-11). */
 	if (!queue || !data)
 		return DS_ERROR_INVALID;
+	DS_PHASE_START(DS_OP_POP);
 
 	while (retry_count < max_retries && can_loop) {
 		head = arena_atomic_load(&queue->head, ARENA_ACQUIRE);
@@ -462,12 +518,15 @@ static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_k
 		cast_user(head);
 		if (arena_atomic_load(&queue->head, ARENA_ACQUIRE) != head) {
 			retry_count++;
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 			continue;
 		}
 
 		cast_user(next);
-		if (next == NULL)
+		if (next == NULL) {
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_CAS);
 			return DS_ERROR_NOT_FOUND;
+		}
 
 		cast_user(tail);
 		if (head == tail) {
@@ -477,6 +536,7 @@ static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_k
 				return DS_ERROR_INVALID;
 			(void)arena_atomic_cmpxchg(&queue->tail, tail, next_elem_tail, ARENA_RELEASE, ARENA_RELAXED);
 			retry_count++;
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 			continue;
 		}
 
@@ -490,18 +550,28 @@ static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_k
 		data->value = next_elem->data.value;
 
 		cast_user(next_elem);
+		DS_PREEMPT_POINT();
 		if (arena_atomic_cmpxchg(&queue->head, head, next_elem, ARENA_ACQUIRE, ARENA_RELAXED) == head) {
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_CAS);
 			cast_user(head);
 			bpf_arena_free(head);
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_ALLOC);
 			arena_atomic_dec(&queue->count);
+			DS_PHASE_END(DS_OP_POP, DS_PHASE_FIXUP);
 			return DS_SUCCESS;
 		}
 		retry_count++;
+		DS_PHASE_END(DS_OP_POP, DS_PHASE_RETRY);
 		continue;
 	}
 
 	return DS_ERROR_INVALID;
 }
+
+static inline int ds_msqueue_pop_c(struct ds_msqueue __arena *queue, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_POP, __ds_msqueue_pop_c(queue, data));
+}
 #endif
 
 static inline int ds_msqueue_pop(struct ds_msqueue __arena *queue, struct ds_kv *data)
@@ -527,7 +597,7 @@ static inline int ds_msqueue_pop(struct ds_msqueue __arena *queue, struct ds_kv
  *          DS_ERROR_INVALID if queue is NULL,
  *          DS_ERROR_NOT_FOUND if key not found or queue is empty
  */
-static inline int ds_msqueue_search_lkmm(struct ds_msqueue __arena *queue, __u64 key)
+static inline int __ds_msqueue_search_lkmm(struct ds_msqueue __arena *queue, __u64 key)
 {
 	struct ds_msqueue_node __arena *next;
 	struct ds_msqueue_elem __arena *head;
@@ -560,8 +630,13 @@ static inline int ds_msqueue_search_lkmm(struct ds_msqueue __arena *queue, __u64
 	return DS_ERROR_NOT_FOUND;
 }
 
+static inline int ds_msqueue_search_lkmm(struct ds_msqueue __arena *queue, __u64 key)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_SEARCH, __ds_msqueue_search_lkmm(queue, key));
+}
+
 #ifndef __BPF__
-static inline int ds_msqueue_search_c(struct ds_msqueue __arena *queue, __u64 key)
+static inline int __ds_msqueue_search_c(struct ds_msqueue __arena *queue, __u64 key)
 {
 	struct ds_msqueue_node __arena *next;
 	struct ds_msqueue_elem __arena *head;
@@ -590,6 +665,11 @@ static inline int ds_msqueue_search_c(struct ds_msqueue __arena *queue, __u64 ke
 
 	return DS_ERROR_NOT_FOUND;
 }
+
+static inline int ds_msqueue_search_c(struct ds_msqueue __arena *queue, __u64 key)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_SEARCH, __ds_msqueue_search_c(queue, key));
+}
 #endif
 
 static inline int ds_msqueue_search(struct ds_msqueue __arena *queue, __u64 key)
@@ -618,7 +698,7 @@ static inline int ds_msqueue_search(struct ds_msqueue __arena *queue, __u64 key)
  *          DS_ERROR_INVALID if queue is NULL,
  *          DS_ERROR_CORRUPT if structural corruption detected
  */
-static inline int ds_msqueue_verify_lkmm(struct ds_msqueue __arena *queue)
+static inline int __ds_msqueue_verify_lkmm(struct ds_msqueue __arena *queue)
 {
 	struct ds_msqueue_elem __arena *node;
 	struct ds_msqueue_elem __arena *head;
@@ -685,8 +765,13 @@ static inline int ds_msqueue_verify_lkmm(struct ds_msqueue __arena *queue)
 	return DS_SUCCESS;
 }
 
+static inline int ds_msqueue_verify_lkmm(struct ds_msqueue __arena *queue)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_VERIFY, __ds_msqueue_verify_lkmm(queue));
+}
+
 #ifndef __BPF__
-static inline int ds_msqueue_verify_c(struct ds_msqueue __arena *queue)
+static inline int __ds_msqueue_verify_c(struct ds_msqueue __arena *queue)
 {
 	struct ds_msqueue_elem __arena *node;
 	struct ds_msqueue_elem __arena *head;
@@ -741,6 +826,11 @@ static inline int ds_msqueue_verify_c(struct ds_msqueue __arena *queue)
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_msqueue_verify_c(struct ds_msqueue __arena *queue)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_VERIFY, __ds_msqueue_verify_c(queue));
+}
 #endif
 
 static inline int ds_msqueue_verify(struct ds_msqueue __arena *queue)
@@ -793,9 +883,9 @@ static inline const struct ds_metadata* ds_msqueue_get_metadata(void)
  */
 typedef int (*ds_msqueue_iter_fn)(__u64 key, __u64 value, void *ctx);
 
-static inline __u64 ds_msqueue_iterate_lkmm(struct ds_msqueue __arena *queue,
-					    ds_msqueue_iter_fn fn,
-					    void *ctx)
+static inline __u64 __ds_msqueue_iterate_lkmm(struct ds_msqueue __arena *queue,
+					      ds_msqueue_iter_fn fn,
+					      void *ctx)
 {
 	struct ds_msqueue_elem __arena *node;
 	struct ds_msqueue_elem __arena *head;
@@ -836,10 +926,17 @@ static inline __u64 ds_msqueue_iterate_lkmm(struct ds_msqueue __arena *queue,
 	return visited;
 }
 
+static inline __u64 ds_msqueue_iterate_lkmm(struct ds_msqueue __arena *queue,
+					    ds_msqueue_iter_fn fn,
+					    void *ctx)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_ITERATE, __ds_msqueue_iterate_lkmm(queue, fn, ctx));
+}
+
 #ifndef __BPF__
-static inline __u64 ds_msqueue_iterate_c(struct ds_msqueue __arena *queue,
-					 ds_msqueue_iter_fn fn,
-					 void *ctx)
+static inline __u64 __ds_msqueue_iterate_c(struct ds_msqueue __arena *queue,
+					   ds_msqueue_iter_fn fn,
+					   void *ctx)
 {
 	struct ds_msqueue_elem __arena *node;
 	struct ds_msqueue_elem __arena *head;
@@ -878,6 +975,13 @@ static inline __u64 ds_msqueue_iterate_c(struct ds_msqueue __arena *queue,
 
 	return visited;
 }
+
+static inline __u64 ds_msqueue_iterate_c(struct ds_msqueue __arena *queue,
+					 ds_msqueue_iter_fn fn,
+					 void *ctx)
+{
+	return DS_OP_STATS_RUN(queue, DS_OP_ITERATE, __ds_msqueue_iterate_c(queue, fn, ctx));
+}
 #endif
 
 static inline __u64 ds_msqueue_iterate(struct ds_msqueue __arena *queue,
@@ -891,4 +995,55 @@ static inline __u64 ds_msqueue_iterate(struct ds_msqueue __arena *queue,
 #endif
 }
 
+/**
+ * ds_msqueue_stats - Element count, node memory and per-op counters
+ * @queue: Queue
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_msqueue_stats_lkmm(struct ds_msqueue __arena *queue,
+					struct ds_stats *stats)
+{
+	if (!queue || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(queue), stats);
+	cast_kern(queue);
+	stats->current_elements = READ_ONCE(queue->count);
+	stats->max_elements = 0;
+	stats->memory_used = (stats->current_elements + 1) * sizeof(struct ds_msqueue_elem);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_msqueue_stats_c(struct ds_msqueue __arena *queue, struct ds_stats *stats)
+{
+	if (!queue || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(queue), stats);
+	cast_kern(queue);
+	stats->current_elements = arena_atomic_load(&queue->count, ARENA_RELAXED);
+	stats->max_elements = 0;
+	stats->memory_used = (stats->current_elements + 1) * sizeof(struct ds_msqueue_elem);
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_msqueue_stats(struct ds_msqueue __arena *queue, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_msqueue_stats_lkmm(queue, stats);
+#else
+	return ds_msqueue_stats_c(queue, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_msqueue_reset_stats(struct ds_msqueue __arena *queue)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(queue));
+}
+
 #endif /* DS_MSQUEUE_H */
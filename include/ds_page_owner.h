@@ -0,0 +1,565 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Shared Page Ownership Map for the BPF Arena
+ *
+ * Without this map the two allocators in libarena_ds.h pick pages blindly.
+ * The kernel side asks bpf_arena_alloc_pages(&arena, NULL, ...) for any
+ * free page, and the userspace side bumps linearly from its range. Neither
+ * knows what the other holds, so the arena had to be big enough that the
+ * two never meet, and a page freed on one side was never reused by the
+ * other.
+ *
+ * The map is one bit per arena page (1 = owned), kept in the arena so
+ * both sides see the same words:
+ *
+ *   claim:   find a clear run of 1..64 bits inside one word and set it
+ *            with one CAS. Next-fit from a shared hint word. Longer runs
+ *            start on a word boundary and take whole words plus the low
+ *            bits of the last one, claimed word by word; if a later word
+ *            is taken, the words already set are cleared again.
+ *   release: one fetch-and per word clears the run.
+ *
+ * Whoever holds the bits owns the pages. The claim and release never
+ * allocate, so they run in any program type.
+ *
+ * Mapping pages is side-specific (BPF glue below, userspace glue further
+ * down):
+ *
+ *   - kernel: claims the bits, then maps exactly those pages with
+ *     bpf_arena_alloc_pages(&arena, addr, ...). If userspace touched a page
+ *     while it owned it, the page is still mapped and the call fails. The
+ *     kernel then frees the run and maps it again, which hands back zeroed
+ *     pages. Freeing unmaps the pages before the bits are cleared.
+ *   - userspace: claims the bits and zeroes the pages. A page the kernel
+ *     freed faults back in as a zero page, and one that userspace released
+ *     keeps its old contents, so zeroing covers both. Releasing only clears
+ *     the bits. The page stays mapped until the kernel reclaims it.
+ *
+ * Page 0 and the pages under the BPF program's arena globals are marked
+ * owned at init. Bits past @nr_pages are always set.
+ *
+ * Usage: define ARENA_PAGE_OWNER before including libarena_ds.h on both
+ * sides, and include this header after it. Userspace calls
+ * ds_page_owner_init_c() on the skeleton's ds_page_owner_state, then
+ * bpf_arena_userspace_set_owner(). It must do both after load and before
+ * any BPF program allocates. DS_PAGE_OWNER_MAX_PAGES must agree between
+ * the BPF object and the loader.
+ */
+#ifndef DS_PAGE_OWNER_H
+#define DS_PAGE_OWNER_H
+
+#pragma once
+
+#include "ds_api.h"
+#include "ds_id_bitmap.h"
+
+#ifndef __BPF__
+#include <stdio.h>
+#include <string.h>
+#endif
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Arena pages the map can describe (16 MB of 4 KB pages); multiple of 64 */
+#ifndef DS_PAGE_OWNER_MAX_PAGES
+#define DS_PAGE_OWNER_MAX_PAGES 4096
+#endif
+
+#define DS_PAGE_OWNER_WORDS (DS_PAGE_OWNER_MAX_PAGES / 64)
+
+/* Longest run one claim can take; runs past 64 pages span words */
+#define DS_PAGE_OWNER_MAX_RUN DS_PAGE_OWNER_MAX_PAGES
+
+/* CAS attempts on one word before moving on */
+#define DS_PAGE_OWNER_RETRIES 16
+
+/* Stats index per side */
+#define DS_PAGE_OWNER_KERN 0
+#define DS_PAGE_OWNER_USER 1
+
+_Static_assert(DS_PAGE_OWNER_MAX_PAGES % 64 == 0,
+	       "DS_PAGE_OWNER_MAX_PAGES must be a multiple of 64");
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_page_owner - Ownership bits for every page of one arena
+ * @base: Userspace address of arena page 0 (the skeleton's mapping)
+ * @nr_pages: Pages covered (<= DS_PAGE_OWNER_MAX_PAGES)
+ * @nr_words: Words covering @nr_pages
+ * @reserved: Leading pages owned for good (page 0 and arena globals)
+ * @hint: Word the last claim succeeded in
+ * @claimed: Pages claimed, per side
+ * @released: Pages released, per side
+ * @failed: Claims or mappings that found no room, per side
+ * @words: Bit i of word w is page w * 64 + i (1 = owned)
+ */
+struct ds_page_owner {
+	__u64 base;
+	__u32 nr_pages;
+	__u32 nr_words;
+	__u32 reserved;
+	__u32 hint;
+	__u64 claimed[2];
+	__u64 released[2];
+	__u64 failed[2];
+	__u64 words[DS_PAGE_OWNER_WORDS];
+};
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+static inline __u64 ds_page_owner_mask(__u32 n)
+{
+	return n >= 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+/*
+ * Lowest shift at which @n clear bits of @w start, or 64 if there is
+ * none. A run never crosses a word boundary.
+ */
+static inline __u32 ds_page_owner_find_run(__u64 w, __u32 n)
+{
+	__u64 mask = ds_page_owner_mask(n);
+
+	if (n == 1)
+		return w == ~0ULL ? 64 : ds_id_bitmap_ffz(w);
+
+	for (__u32 s = 0; s + n <= 64 && can_loop; s++)
+		if (!(w & (mask << s)))
+			return s;
+	return 64;
+}
+
+/* Bits a multi-word run of @n pages sets in its @j-th word */
+static inline __u64 ds_page_owner_span_bits(__u32 n, __u32 j)
+{
+	return j < n / 64 ? ~0ULL : ds_page_owner_mask(n % 64);
+}
+
+/* ========================================================================
+ * INIT
+ * ======================================================================== */
+
+/**
+ * ds_page_owner_init_c - Mark every page free except the reserved ones
+ * @o: Map (in the arena, e.g. skel->arena->ds_page_owner_state)
+ * @base: Userspace address of arena page 0
+ * @nr_pages: Arena pages; anything above DS_PAGE_OWNER_MAX_PAGES is left
+ *            out of the map
+ * @reserved: Leading pages that stay owned (at least 1: page 0)
+ *
+ * Not concurrent with claim/release.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+#ifndef __BPF__
+static inline int ds_page_owner_init_c(struct ds_page_owner __arena *o, void *base,
+				       __u32 nr_pages, __u32 reserved)
+{
+	if (nr_pages > DS_PAGE_OWNER_MAX_PAGES)
+		nr_pages = DS_PAGE_OWNER_MAX_PAGES;
+	if (!o || !base || !reserved || reserved >= nr_pages)
+		return DS_ERROR_INVALID;
+
+	memset(o, 0, sizeof(*o));
+	o->base = (__u64)(uintptr_t)base;
+	o->nr_pages = nr_pages;
+	o->nr_words = (nr_pages + 63) / 64;
+	o->reserved = reserved;
+
+	for (__u32 w = 0; w < DS_PAGE_OWNER_WORDS; w++) {
+		__u32 first = w * 64;
+		__u64 bits = 0;
+
+		if (first >= nr_pages)
+			bits = ~0ULL;
+		else if (nr_pages - first < 64)
+			bits = ~0ULL << (nr_pages - first);
+		if (first < reserved)
+			bits |= ds_page_owner_mask(reserved - first);
+		o->words[w] = bits;
+	}
+	o->hint = reserved / 64;
+
+	__atomic_thread_fence(ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+#endif
+
+/* ========================================================================
+ * CLAIM / RELEASE
+ * ======================================================================== */
+
+/*
+ * Claim a run of more than 64 pages starting at a word boundary. Each word
+ * is taken with one CAS; a word that is not clear ends the attempt, and
+ * the words already set are cleared before moving to the next start.
+ */
+static inline int ds_page_owner_claim_span_lkmm(struct ds_page_owner __arena *o, __u32 n,
+						__u32 nr_words, __u32 start, __u32 *idx)
+{
+	__u32 k = (n + 63) / 64;
+
+	for (__u32 i = 0; i < nr_words && i < DS_PAGE_OWNER_WORDS && can_loop; i++) {
+		__u32 w = (start + i) % nr_words;
+		__u32 got = 0;
+
+		if (w + k > nr_words)
+			continue;
+
+		for (__u32 j = 0; j < k && j < DS_PAGE_OWNER_WORDS && can_loop; j++) {
+			__u64 __arena *word = &o->words[(w + j) % DS_PAGE_OWNER_WORDS];
+			__u64 bits = ds_page_owner_span_bits(n, j);
+			__u64 old = READ_ONCE(*word);
+
+			if ((old & bits) || arena_atomic_cmpxchg(word, old, old | bits, ARENA_ACQUIRE,
+								 ARENA_RELAXED) != old)
+				break;
+			got++;
+		}
+
+		if (got == k) {
+			if (w != start)
+				WRITE_ONCE(o->hint, w);
+			*idx = w * 64;
+			return DS_SUCCESS;
+		}
+
+		/* Nothing was written to these pages; just clear the bits again */
+		for (__u32 j = 0; j < got && j < DS_PAGE_OWNER_WORDS && can_loop; j++)
+			arena_atomic_and(&o->words[(w + j) % DS_PAGE_OWNER_WORDS],
+					 ~ds_page_owner_span_bits(n, j), ARENA_RELAXED);
+	}
+
+	return DS_ERROR_FULL;
+}
+
+/**
+ * ds_page_owner_claim_lkmm - Take ownership of @n contiguous free pages
+ * @o: Map
+ * @n: Pages, 1..DS_PAGE_OWNER_MAX_RUN
+ * @side: DS_PAGE_OWNER_KERN or DS_PAGE_OWNER_USER (stats only)
+ * @idx: Output index of the first page
+ *
+ * Runs of up to 64 pages sit inside one word; longer ones start on a word
+ * boundary (see ds_page_owner_claim_span_lkmm()).
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_INVALID (map not set up, bad @n) or
+ *          DS_ERROR_FULL (no free run of @n pages)
+ */
+static inline int ds_page_owner_claim_lkmm(struct ds_page_owner __arena *o, __u32 n,
+					   __u32 side, __u32 *idx)
+{
+	__u32 nr_words, start;
+
+	cast_kern(o);
+	nr_words = READ_ONCE(o->nr_words);
+	if (!nr_words || nr_words > DS_PAGE_OWNER_WORDS || !n || n > DS_PAGE_OWNER_MAX_RUN)
+		return DS_ERROR_INVALID;
+
+	start = READ_ONCE(o->hint);
+	if (n > 64) {
+		if (ds_page_owner_claim_span_lkmm(o, n, nr_words, start, idx) != DS_SUCCESS) {
+			arena_atomic_inc(&o->failed[side & 1]);
+			return DS_ERROR_FULL;
+		}
+		arena_atomic_add(&o->claimed[side & 1], n, ARENA_RELAXED);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 i = 0; i < nr_words && i < DS_PAGE_OWNER_WORDS && can_loop; i++) {
+		__u32 w = (start + i) % nr_words;
+
+		for (int r = 0; r < DS_PAGE_OWNER_RETRIES && can_loop; r++) {
+			__u64 old = READ_ONCE(o->words[w]);
+			__u64 run;
+			__u32 s = ds_page_owner_find_run(old, n);
+
+			if (s >= 64)
+				break;
+			run = ds_page_owner_mask(n) << s;
+			if (arena_atomic_cmpxchg(&o->words[w], old, old | run,
+						 ARENA_ACQUIRE, ARENA_RELAXED) != old)
+				continue;
+
+			if (w != start)
+				WRITE_ONCE(o->hint, w);
+			arena_atomic_add(&o->claimed[side & 1], n, ARENA_RELAXED);
+			*idx = w * 64 + s;
+			return DS_SUCCESS;
+		}
+	}
+
+	arena_atomic_inc(&o->failed[side & 1]);
+	return DS_ERROR_FULL;
+}
+
+#ifndef __BPF__
+static inline int ds_page_owner_claim_span_c(struct ds_page_owner __arena *o, __u32 n,
+					     __u32 nr_words, __u32 start, __u32 *idx)
+{
+	__u32 k = (n + 63) / 64;
+
+	for (__u32 i = 0; i < nr_words; i++) {
+		__u32 w = (start + i) % nr_words;
+		__u32 got = 0;
+
+		if (w + k > nr_words)
+			continue;
+
+		for (__u32 j = 0; j < k; j++) {
+			__u64 bits = ds_page_owner_span_bits(n, j);
+			__u64 old = arena_atomic_load(&o->words[w + j], ARENA_RELAXED);
+
+			if ((old & bits) || arena_atomic_cmpxchg(&o->words[w + j], old, old | bits,
+								 ARENA_ACQUIRE, ARENA_RELAXED) != old)
+				break;
+			got++;
+		}
+
+		if (got == k) {
+			if (w != start)
+				arena_atomic_store(&o->hint, w, ARENA_RELAXED);
+			*idx = w * 64;
+			return DS_SUCCESS;
+		}
+
+		for (__u32 j = 0; j < got; j++)
+			arena_atomic_and(&o->words[w + j], ~ds_page_owner_span_bits(n, j),
+					 ARENA_RELAXED);
+	}
+
+	return DS_ERROR_FULL;
+}
+
+static inline int ds_page_owner_claim_c(struct ds_page_owner __arena *o, __u32 n,
+					__u32 side, __u32 *idx)
+{
+	__u32 nr_words, start;
+
+	nr_words = arena_atomic_load(&o->nr_words, ARENA_RELAXED);
+	if (!nr_words || nr_words > DS_PAGE_OWNER_WORDS || !n || n > DS_PAGE_OWNER_MAX_RUN)
+		return DS_ERROR_INVALID;
+
+	start = arena_atomic_load(&o->hint, ARENA_RELAXED);
+	if (n > 64) {
+		if (ds_page_owner_claim_span_c(o, n, nr_words, start, idx) != DS_SUCCESS) {
+			arena_atomic_inc(&o->failed[side & 1]);
+			return DS_ERROR_FULL;
+		}
+		arena_atomic_add(&o->claimed[side & 1], n, ARENA_RELAXED);
+		return DS_SUCCESS;
+	}
+
+	for (__u32 i = 0; i < nr_words; i++) {
+		__u32 w = (start + i) % nr_words;
+		__u64 old = arena_atomic_load(&o->words[w], ARENA_RELAXED);
+
+		for (int r = 0; r < DS_PAGE_OWNER_RETRIES; r++) {
+			__u32 s = ds_page_owner_find_run(old, n);
+			__u64 run, seen;
+
+			if (s >= 64)
+				break;
+			run = ds_page_owner_mask(n) << s;
+			seen = arena_atomic_cmpxchg(&o->words[w], old, old | run,
+						    ARENA_ACQUIRE, ARENA_RELAXED);
+			if (seen != old) {
+				old = seen;
+				continue;
+			}
+
+			if (w != start)
+				arena_atomic_store(&o->hint, w, ARENA_RELAXED);
+			arena_atomic_add(&o->claimed[side & 1], n, ARENA_RELAXED);
+			*idx = w * 64 + s;
+			return DS_SUCCESS;
+		}
+	}
+
+	arena_atomic_inc(&o->failed[side & 1]);
+	return DS_ERROR_FULL;
+}
+#endif
+
+/**
+ * ds_page_owner_release_lkmm - Give up @n pages from ds_page_owner_claim()
+ * @o: Map
+ * @idx: First page
+ * @n: Pages, as claimed
+ * @side: DS_PAGE_OWNER_KERN or DS_PAGE_OWNER_USER (stats only)
+ *
+ * Release ordering: everything the owner did to the pages (including the
+ * kernel unmapping them) happens before the next claimer sees them free.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_INVALID (run outside the map, or a run of
+ *          up to 64 pages across a word, or a longer one not starting on
+ *          a word) or DS_ERROR_NOT_FOUND (some page was not owned)
+ */
+static inline int ds_page_owner_release_lkmm(struct ds_page_owner __arena *o, __u32 idx,
+					     __u32 n, __u32 side)
+{
+	bool owned = true;
+	__u64 run, old;
+
+	cast_kern(o);
+	if (!n || n > DS_PAGE_OWNER_MAX_RUN || idx < READ_ONCE(o->reserved) ||
+	    idx + n > READ_ONCE(o->nr_pages))
+		return DS_ERROR_INVALID;
+	if (n <= 64 ? (idx % 64) + n > 64 : idx % 64)
+		return DS_ERROR_INVALID;
+
+	for (__u32 j = 0; j * 64 < n && j < DS_PAGE_OWNER_WORDS && can_loop; j++) {
+		run = n <= 64 ? ds_page_owner_mask(n) << (idx % 64) : ds_page_owner_span_bits(n, j);
+		old = arena_atomic_and(&o->words[(idx / 64 + j) % DS_PAGE_OWNER_WORDS], ~run,
+				       ARENA_RELEASE);
+		if ((old & run) != run)
+			owned = false;
+	}
+	if (!owned)
+		return DS_ERROR_NOT_FOUND;
+
+	arena_atomic_add(&o->released[side & 1], n, ARENA_RELAXED);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_page_owner_release_c(struct ds_page_owner __arena *o, __u32 idx,
+					  __u32 n, __u32 side)
+{
+	bool owned = true;
+	__u64 run, old;
+
+	if (!n || n > DS_PAGE_OWNER_MAX_RUN || idx < o->reserved || idx + n > o->nr_pages)
+		return DS_ERROR_INVALID;
+	if (n <= 64 ? (idx % 64) + n > 64 : idx % 64)
+		return DS_ERROR_INVALID;
+
+	for (__u32 j = 0; j * 64 < n; j++) {
+		run = n <= 64 ? ds_page_owner_mask(n) << (idx % 64) : ds_page_owner_span_bits(n, j);
+		old = arena_atomic_and(&o->words[idx / 64 + j], ~run, ARENA_RELEASE);
+		if ((old & run) != run)
+			owned = false;
+	}
+	if (!owned)
+		return DS_ERROR_NOT_FOUND;
+
+	arena_atomic_add(&o->released[side & 1], n, ARENA_RELAXED);
+	return DS_SUCCESS;
+}
+#endif
+
+#ifdef __BPF__
+
+/* ========================================================================
+ * BPF GLUE: libarena_ds.h page source under ARENA_PAGE_OWNER
+ * ======================================================================== */
+
+struct ds_page_owner __arena ds_page_owner_state;
+
+/*
+ * Sleepable: claim @n pages and map exactly those. A run userspace used
+ * is still mapped, so the first bpf_arena_alloc_pages() fails; freeing
+ * and mapping it again gives zeroed pages like any fresh allocation.
+ */
+static void __arena *ds_page_owner_alloc_pages(__u32 n)
+{
+	struct ds_page_owner __arena *o = &ds_page_owner_state;
+	void __arena *addr, *page;
+	__u32 idx;
+
+	if (ds_page_owner_claim_lkmm(o, n, DS_PAGE_OWNER_KERN, &idx) != DS_SUCCESS)
+		return NULL;
+
+	addr = (void __arena *)(long)(READ_ONCE(o->base) + (__u64)idx * PAGE_SIZE);
+	page = bpf_arena_alloc_pages(&arena, addr, n, NUMA_NO_NODE, 0);
+	if (!page) {
+		bpf_arena_free_pages(&arena, addr, n);
+		page = bpf_arena_alloc_pages(&arena, addr, n, NUMA_NO_NODE, 0);
+	}
+	if (!page) {
+		arena_atomic_inc(&o->failed[DS_PAGE_OWNER_KERN]);
+		ds_page_owner_release_lkmm(o, idx, n, DS_PAGE_OWNER_KERN);
+		return NULL;
+	}
+	return page;
+}
+
+/* Sleepable: unmap the run, then let either side claim it */
+static void ds_page_owner_free_pages(void __arena *page, __u32 n)
+{
+	struct ds_page_owner __arena *o = &ds_page_owner_state;
+	__u32 idx = ((__u32)(long)page - (__u32)READ_ONCE(o->base)) / PAGE_SIZE;
+
+	bpf_arena_free_pages(&arena, page, n);
+	ds_page_owner_release_lkmm(o, idx, n, DS_PAGE_OWNER_KERN);
+}
+
+#else /* !__BPF__ */
+
+/* ========================================================================
+ * USERSPACE GLUE: libarena_ds.h page source under ARENA_PAGE_OWNER
+ * ======================================================================== */
+
+static void *ds_page_owner_user_alloc(struct ds_page_owner *o, __u32 n)
+{
+	size_t pg = bpf_arena_userspace_page_size;
+	void *page;
+	__u32 idx;
+
+	if (!o || !pg || ds_page_owner_claim_c(o, n, DS_PAGE_OWNER_USER, &idx) != DS_SUCCESS)
+		return NULL;
+
+	page = (void *)(uintptr_t)(o->base + (__u64)idx * pg);
+	memset(page, 0, (size_t)n * pg);
+	return page;
+}
+
+static void ds_page_owner_user_free(struct ds_page_owner *o, void *page, __u32 n)
+{
+	size_t pg = bpf_arena_userspace_page_size;
+
+	if (!o || !pg)
+		return;
+	ds_page_owner_release_c(o, (__u32)(((uintptr_t)page - o->base) / pg), n,
+				DS_PAGE_OWNER_USER);
+}
+
+/* ========================================================================
+ * USERSPACE REPORTING
+ * ======================================================================== */
+
+/* Pages currently owned, reserved ones excluded (racy while in use) */
+static inline __u32 ds_page_owner_count_c(struct ds_page_owner __arena *o)
+{
+	__u64 n = 0;
+
+	for (__u32 w = 0; w < o->nr_words; w++)
+		n += (__u64)__builtin_popcountll(arena_atomic_load(&o->words[w], ARENA_RELAXED));
+
+	/* Padding bits in the last word are always set */
+	return (__u32)(n - ((__u64)o->nr_words * 64 - o->nr_pages) - o->reserved);
+}
+
+static inline void ds_page_owner_print(struct ds_page_owner __arena *o)
+{
+	printf("Page ownership (%u pages, %u reserved): %u owned now\n",
+	       o->nr_pages, o->reserved, ds_page_owner_count_c(o));
+	printf("  kernel: claimed=%llu released=%llu failed=%llu\n",
+	       (unsigned long long)o->claimed[DS_PAGE_OWNER_KERN],
+	       (unsigned long long)o->released[DS_PAGE_OWNER_KERN],
+	       (unsigned long long)o->failed[DS_PAGE_OWNER_KERN]);
+	printf("  user:   claimed=%llu released=%llu failed=%llu\n",
+	       (unsigned long long)o->claimed[DS_PAGE_OWNER_USER],
+	       (unsigned long long)o->released[DS_PAGE_OWNER_USER],
+	       (unsigned long long)o->failed[DS_PAGE_OWNER_USER]);
+}
+
+#endif /* __BPF__ */
+
+#endif /* DS_PAGE_OWNER_H */
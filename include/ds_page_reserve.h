@@ -0,0 +1,545 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Per-CPU Page Reserve for Non-Sleepable Arena Allocation
+ *
+ * bpf_arena_alloc_pages() and bpf_arena_free_pages() may sleep, so any
+ * program that allocates through libarena_ds.h has had to be sleepable
+ * (lsm.s, uprobe.s, syscall). The reserve keeps a few pre-allocated pages
+ * per CPU so the page-fragment allocator never calls the page allocator
+ * from the program itself:
+ *
+ *   - take: bpf_arena_alloc() pops its next page from the reserve of the
+ *     CPU it runs on. Any context, any nesting: the pop is one CAS on the
+ *     reserve's tail. An empty reserve counts as exhausted and the
+ *     allocation fails with NULL, as a failed page allocation would.
+ *   - give back: a page whose last object is freed goes on a retired
+ *     list (one CAS push, the link lives in the page) instead of
+ *     bpf_arena_free_pages().
+ *   - refill: when a take leaves a reserve below @low, or a page is
+ *     retired, the first caller to set @refill_pending starts a bpf_wq.
+ *     Its callback runs in sleepable process context. It frees the
+ *     retired pages and tops every reserve back up to @depth. It is the
+ *     only writer of reserve heads.
+ *
+ * Usage (BPF): define ARENA_NOSLEEP_RESERVE before including
+ * libarena_ds.h, include this header after it, and run
+ * ds_page_reserve_start() once from a SEC("syscall") program before
+ * attaching anything that allocates. bpf_arena_alloc_large() still needs a
+ * sleepable caller; allocate ring arrays in the start program. With
+ * ARENA_PAGE_OWNER as well, the worker gets and returns pages through the
+ * shared ownership map (ds_page_owner.h).
+ *
+ * Userspace gets the _c operations so tests can drive the same protocol
+ * with threads standing in for CPUs and the worker.
+ */
+#ifndef DS_PAGE_RESERVE_H
+#define DS_PAGE_RESERVE_H
+
+#pragma once
+
+#include "ds_api.h"
+
+#ifndef __BPF__
+#include <stdio.h>
+#endif
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Most per-CPU reserves; CPUs past nr_cpus share them. Power of 2. */
+#define DS_PAGE_RESERVE_CPUS 64
+
+/* Most pages one reserve can hold */
+#define DS_PAGE_RESERVE_DEPTH 16
+
+/* CAS attempts for a retire push (verifier safety) */
+#define DS_PAGE_RESERVE_MAX_RETRIES 100
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_page_reserve_cpu - One CPU's stock of ready pages
+ * @head: Pages ever put (refill worker only)
+ * @tail: Pages ever taken (CAS by takers)
+ * @slot: Ring of pages, indexed by position % DS_PAGE_RESERVE_DEPTH
+ * @taken: Successful takes
+ * @exhausted: Takes that found the reserve empty
+ * @refilled: Pages the worker put back
+ */
+struct ds_page_reserve_cpu {
+	__u64 head;
+	__u64 tail;
+	void __arena *slot[DS_PAGE_RESERVE_DEPTH];
+	__u64 taken;
+	__u64 exhausted;
+	__u64 refilled;
+	char pad[24];	/* 192 bytes: three cache lines */
+};
+
+/**
+ * struct ds_page_reserve - Reserves of every CPU plus the refill state
+ * @nr_cpus: Reserves in use; the worker fills these and CPU ids are
+ *           taken modulo this count, so every CPU maps onto one of them
+ * @depth: Pages the worker tops each reserve up to
+ * @low: Watermark; a take that leaves fewer pages starts a refill
+ * @refill_pending: 1 from the first kick until the worker starts
+ * @retired: Freed pages waiting for the worker, linked through word 0
+ * @kicks: Refills started
+ * @refill_runs: Worker runs
+ * @refill_failed: Worker page allocations that failed
+ * @retire_lost: Retire pushes that lost every CAS; the page is leaked
+ * @released: Retired pages the worker returned to the arena
+ * @cpu: Per-CPU reserves
+ */
+struct ds_page_reserve {
+	__u32 nr_cpus;
+	__u32 depth;
+	__u32 low;
+	__u32 pad0;
+	__u64 refill_pending;
+	void __arena *retired;
+	__u64 kicks;
+	__u64 refill_runs;
+	__u64 refill_failed;
+	__u64 retire_lost;
+	__u64 released;
+	struct ds_page_reserve_cpu cpu[DS_PAGE_RESERVE_CPUS];
+};
+
+/* ========================================================================
+ * API IMPLEMENTATION
+ * ======================================================================== */
+
+/**
+ * ds_page_reserve_init - Set the reserve geometry
+ * @r: Reserve, zeroed
+ * @nr_cpus: Reserves to keep (1..DS_PAGE_RESERVE_CPUS); CPU ids past it
+ *           share them, so fewer than the CPU count is allowed
+ * @depth: Pages per reserve (1..DS_PAGE_RESERVE_DEPTH)
+ * @low: Refill watermark (< @depth)
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID for a bad geometry
+ */
+static inline int ds_page_reserve_init_lkmm(struct ds_page_reserve __arena *r,
+					    __u32 nr_cpus, __u32 depth, __u32 low)
+{
+	if (!r || !nr_cpus || nr_cpus > DS_PAGE_RESERVE_CPUS ||
+	    !depth || depth > DS_PAGE_RESERVE_DEPTH || low >= depth)
+		return DS_ERROR_INVALID;
+
+	WRITE_ONCE(r->nr_cpus, nr_cpus);
+	WRITE_ONCE(r->depth, depth);
+	WRITE_ONCE(r->low, low);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_page_reserve_init_c(struct ds_page_reserve __arena *r,
+					 __u32 nr_cpus, __u32 depth, __u32 low)
+{
+	if (!r || !nr_cpus || nr_cpus > DS_PAGE_RESERVE_CPUS ||
+	    !depth || depth > DS_PAGE_RESERVE_DEPTH || low >= depth)
+		return DS_ERROR_INVALID;
+
+	arena_atomic_store(&r->nr_cpus, nr_cpus, ARENA_RELAXED);
+	arena_atomic_store(&r->depth, depth, ARENA_RELAXED);
+	arena_atomic_store(&r->low, low, ARENA_RELAXED);
+	return DS_SUCCESS;
+}
+#endif
+
+/*
+ * Reserve of @cpu: CPU ids are taken modulo @nr_cpus, the range the worker
+ * fills, so a geometry smaller than the CPU count shares reserves instead
+ * of leaving some CPUs on one that is never refilled. Takes are CAS-based,
+ * so sharing is safe. The mask only bounds the index for the verifier.
+ */
+static inline struct ds_page_reserve_cpu __arena *
+ds_page_reserve_of(struct ds_page_reserve __arena *r, __u32 cpu)
+{
+	__u32 nr = arena_atomic_load(&r->nr_cpus, ARENA_RELAXED);
+
+	return &r->cpu[(nr ? cpu % nr : cpu) & (DS_PAGE_RESERVE_CPUS - 1)];
+}
+
+/**
+ * ds_page_reserve_take - Pop a ready page from a CPU's reserve
+ * @r: Reserve
+ * @cpu: Calling CPU (any value; modulo @nr_cpus)
+ *
+ * The slot is read before the CAS that claims it. The worker overwrites a
+ * slot only after it sees @tail move past it, so a successful CAS means
+ * the page read is ours.
+ *
+ * Returns: A zeroed page, or NULL if the reserve is empty
+ */
+static inline void __arena *ds_page_reserve_take_lkmm(struct ds_page_reserve __arena *r, __u32 cpu)
+{
+	struct ds_page_reserve_cpu __arena *rc = ds_page_reserve_of(r, cpu);
+	void __arena *page;
+	__u64 head, tail;
+
+	for (int i = 0; i < DS_PAGE_RESERVE_DEPTH && can_loop; i++) {
+		tail = READ_ONCE(rc->tail);
+		head = smp_load_acquire(&rc->head);
+		if (tail == head) {
+			arena_atomic_inc(&rc->exhausted);
+			return NULL;
+		}
+
+		page = READ_ONCE(rc->slot[tail % DS_PAGE_RESERVE_DEPTH]);
+		if (arena_atomic_cmpxchg(&rc->tail, tail, tail + 1,
+					 ARENA_RELEASE, ARENA_RELAXED) == tail) {
+			arena_atomic_inc(&rc->taken);
+			return page;
+		}
+	}
+
+	/* Lost every race to nested takers on this CPU */
+	arena_atomic_inc(&rc->exhausted);
+	return NULL;
+}
+
+#ifndef __BPF__
+static inline void __arena *ds_page_reserve_take_c(struct ds_page_reserve __arena *r, __u32 cpu)
+{
+	struct ds_page_reserve_cpu __arena *rc = ds_page_reserve_of(r, cpu);
+	void __arena *page;
+	__u64 head, tail;
+
+	for (int i = 0; i < DS_PAGE_RESERVE_DEPTH && can_loop; i++) {
+		tail = arena_atomic_load(&rc->tail, ARENA_RELAXED);
+		head = arena_atomic_load(&rc->head, ARENA_ACQUIRE);
+		if (tail == head) {
+			arena_atomic_inc(&rc->exhausted);
+			return NULL;
+		}
+
+		page = arena_atomic_load(&rc->slot[tail % DS_PAGE_RESERVE_DEPTH], ARENA_RELAXED);
+		if (arena_atomic_cmpxchg(&rc->tail, tail, tail + 1,
+					 ARENA_RELEASE, ARENA_RELAXED) == tail) {
+			arena_atomic_inc(&rc->taken);
+			return page;
+		}
+	}
+
+	arena_atomic_inc(&rc->exhausted);
+	return NULL;
+}
+#endif
+
+/**
+ * ds_page_reserve_level - Pages currently in a CPU's reserve
+ * @r: Reserve
+ * @cpu: CPU (modulo @nr_cpus)
+ */
+static inline __u32 ds_page_reserve_level(struct ds_page_reserve __arena *r, __u32 cpu)
+{
+	struct ds_page_reserve_cpu __arena *rc = ds_page_reserve_of(r, cpu);
+
+	return (__u32)(arena_atomic_load(&rc->head, ARENA_RELAXED) -
+		       arena_atomic_load(&rc->tail, ARENA_RELAXED));
+}
+
+/**
+ * ds_page_reserve_put - Add a page to a CPU's reserve (refill worker only)
+ * @r: Reserve
+ * @cpu: CPU (modulo @nr_cpus)
+ * @page: Zeroed page
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_NOMEM if the reserve holds @depth pages
+ */
+static inline int ds_page_reserve_put_lkmm(struct ds_page_reserve __arena *r, __u32 cpu,
+					   void __arena *page)
+{
+	struct ds_page_reserve_cpu __arena *rc = ds_page_reserve_of(r, cpu);
+	__u64 head = READ_ONCE(rc->head);
+
+	if (head - smp_load_acquire(&rc->tail) >= READ_ONCE(r->depth))
+		return DS_ERROR_NOMEM;
+
+	WRITE_ONCE(rc->slot[head % DS_PAGE_RESERVE_DEPTH], page);
+	smp_store_release(&rc->head, head + 1);
+	arena_atomic_inc(&rc->refilled);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_page_reserve_put_c(struct ds_page_reserve __arena *r, __u32 cpu,
+					void __arena *page)
+{
+	struct ds_page_reserve_cpu __arena *rc = ds_page_reserve_of(r, cpu);
+	__u64 head = arena_atomic_load(&rc->head, ARENA_RELAXED);
+
+	if (head - arena_atomic_load(&rc->tail, ARENA_ACQUIRE) >=
+	    arena_atomic_load(&r->depth, ARENA_RELAXED))
+		return DS_ERROR_NOMEM;
+
+	arena_atomic_store(&rc->slot[head % DS_PAGE_RESERVE_DEPTH], page, ARENA_RELAXED);
+	arena_atomic_store(&rc->head, head + 1, ARENA_RELEASE);
+	arena_atomic_inc(&rc->refilled);
+	return DS_SUCCESS;
+}
+#endif
+
+/**
+ * ds_page_reserve_retire - Hand a free page to the refill worker
+ * @r: Reserve
+ * @page: Page with no live objects; its first word becomes the list link
+ *
+ * The BPF push gives up after DS_PAGE_RESERVE_MAX_RETRIES lost CASes. The
+ * page then stays out of use and is counted in @retire_lost.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_BUSY if the page was not queued
+ */
+static inline int ds_page_reserve_retire_lkmm(struct ds_page_reserve __arena *r,
+					      void __arena *page)
+{
+	void __arena * __arena *link = page;
+	void __arena *old;
+
+	cast_kern(link);
+	for (int i = 0; i < DS_PAGE_RESERVE_MAX_RETRIES && can_loop; i++) {
+		old = READ_ONCE(r->retired);
+		WRITE_ONCE(*link, old);
+		if (arena_atomic_cmpxchg(&r->retired, old, page,
+					 ARENA_RELEASE, ARENA_RELAXED) == old)
+			return DS_SUCCESS;
+	}
+	arena_atomic_inc(&r->retire_lost);
+	return DS_ERROR_BUSY;
+}
+
+#ifndef __BPF__
+static inline void ds_page_reserve_retire_c(struct ds_page_reserve __arena *r,
+					    void __arena *page)
+{
+	void __arena * __arena *link = page;
+	void __arena *old = arena_atomic_load(&r->retired, ARENA_RELAXED);
+
+	for (;;) {
+		arena_atomic_store(link, old, ARENA_RELAXED);
+		void __arena *seen = arena_atomic_cmpxchg(&r->retired, old, page,
+							  ARENA_RELEASE, ARENA_RELAXED);
+		if (seen == old)
+			return;
+		old = seen;
+	}
+}
+#endif
+
+/**
+ * ds_page_reserve_drain - Take the whole retired list (refill worker only)
+ * @r: Reserve
+ *
+ * Returns: First retired page (follow word 0 for the next), or NULL
+ */
+static inline void __arena *ds_page_reserve_drain_lkmm(struct ds_page_reserve __arena *r)
+{
+	return arena_atomic_exchange(&r->retired, NULL, ARENA_ACQUIRE);
+}
+
+#ifndef __BPF__
+static inline void __arena *ds_page_reserve_drain_c(struct ds_page_reserve __arena *r)
+{
+	return arena_atomic_exchange(&r->retired, NULL, ARENA_ACQUIRE);
+}
+#endif
+
+/**
+ * ds_page_reserve_claim_refill - Decide who starts the refill worker
+ * @r: Reserve
+ *
+ * Returns: true for exactly one caller until the worker clears
+ * @refill_pending at the start of its run
+ */
+static inline bool ds_page_reserve_claim_refill(struct ds_page_reserve __arena *r)
+{
+	if (arena_atomic_load(&r->refill_pending, ARENA_RELAXED) ||
+	    arena_atomic_exchange(&r->refill_pending, 1, ARENA_ACQ_REL))
+		return false;
+	arena_atomic_inc(&r->kicks);
+	return true;
+}
+
+/* Worker side of the claim: later drops below @low start another run */
+static inline void ds_page_reserve_refill_begin(struct ds_page_reserve __arena *r)
+{
+	arena_atomic_exchange(&r->refill_pending, 0, ARENA_ACQ_REL);
+	arena_atomic_inc(&r->refill_runs);
+}
+
+/* True once a reserve holds fewer than @low pages */
+static inline bool ds_page_reserve_low(struct ds_page_reserve __arena *r, __u32 cpu)
+{
+	return ds_page_reserve_level(r, cpu) < arena_atomic_load(&r->low, ARENA_RELAXED);
+}
+
+#ifdef __BPF__
+
+/* ========================================================================
+ * BPF GLUE: libarena_ds.h page source and the bpf_wq refill worker
+ * ======================================================================== */
+
+struct ds_page_reserve_work {
+	struct bpf_wq work;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct ds_page_reserve_work);
+} ds_page_reserve_wq SEC(".maps");
+
+struct ds_page_reserve __arena ds_page_reserve_state;
+
+static inline void ds_page_reserve_kick(void)
+{
+	struct ds_page_reserve_work *w;
+	int key = 0;
+
+	if (!ds_page_reserve_claim_refill(&ds_page_reserve_state))
+		return;
+	w = bpf_map_lookup_elem(&ds_page_reserve_wq, &key);
+	if (w)
+		bpf_wq_start(&w->work, 0);
+}
+
+/* bpf_arena_refill_page() source under ARENA_NOSLEEP_RESERVE */
+static void __arena *ds_page_reserve_take(__u32 cpu)
+{
+	void __arena *page = ds_page_reserve_take_lkmm(&ds_page_reserve_state, cpu);
+
+	if (!page || ds_page_reserve_low(&ds_page_reserve_state, cpu))
+		ds_page_reserve_kick();
+	return page;
+}
+
+/* bpf_arena_free() sink under ARENA_NOSLEEP_RESERVE */
+static void ds_page_reserve_give_back(void __arena *page)
+{
+	if (ds_page_reserve_retire_lkmm(&ds_page_reserve_state, page) == DS_SUCCESS)
+		ds_page_reserve_kick();
+}
+
+/* Sleepable: free retired pages, then top every reserve up to depth */
+static int ds_page_reserve_fill(void)
+{
+	struct ds_page_reserve __arena *r = &ds_page_reserve_state;
+	void __arena *page, *next;
+	__u32 nr_cpus = READ_ONCE(r->nr_cpus);
+
+	page = ds_page_reserve_drain_lkmm(r);
+	while (page && can_loop) {
+		void __arena * __arena *link = page;
+
+		cast_kern(link);
+		next = READ_ONCE(*link);
+#ifdef ARENA_PAGE_OWNER
+		ds_page_owner_free_pages(page, 1);
+#else
+		bpf_arena_free_pages(&arena, page, 1);
+#endif
+		arena_atomic_inc(&r->released);
+		page = next;
+	}
+
+	for (__u32 cpu = 0; cpu < nr_cpus && cpu < DS_PAGE_RESERVE_CPUS && can_loop; cpu++) {
+		while (ds_page_reserve_level(r, cpu) < READ_ONCE(r->depth) && can_loop) {
+#ifdef ARENA_PAGE_OWNER
+			page = ds_page_owner_alloc_pages(1);
+#else
+			page = bpf_arena_alloc_pages(&arena, NULL, 1, NUMA_NO_NODE, 0);
+#endif
+			if (!page) {
+				arena_atomic_inc(&r->refill_failed);
+				return DS_ERROR_NOMEM;
+			}
+			if (ds_page_reserve_put_lkmm(r, cpu, page) != DS_SUCCESS) {
+#ifdef ARENA_PAGE_OWNER
+				ds_page_owner_free_pages(page, 1);
+#else
+				bpf_arena_free_pages(&arena, page, 1);
+#endif
+				break;
+			}
+		}
+	}
+
+	return DS_SUCCESS;
+}
+
+static int ds_page_reserve_refill_cb(void *map, int *key, void *value)
+{
+	(void)map;
+	(void)key;
+	(void)value;
+
+	ds_page_reserve_refill_begin(&ds_page_reserve_state);
+	ds_page_reserve_fill();
+	return 0;
+}
+
+/**
+ * ds_page_reserve_start - Set up the worker and fill every reserve
+ * @nr_cpus: Reserves to keep; CPU ids are taken modulo this
+ * @depth: Pages per reserve
+ * @low: Refill watermark
+ *
+ * Sleepable context only; run it once from a SEC("syscall") program.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_INVALID, or DS_ERROR_NOMEM if the arena
+ * could not fill every reserve
+ */
+static inline int ds_page_reserve_start(__u32 nr_cpus, __u32 depth, __u32 low)
+{
+	struct ds_page_reserve_work *w;
+	int key = 0;
+	int ret;
+
+	ret = ds_page_reserve_init_lkmm(&ds_page_reserve_state, nr_cpus, depth, low);
+	if (ret != DS_SUCCESS)
+		return ret;
+
+	w = bpf_map_lookup_elem(&ds_page_reserve_wq, &key);
+	if (!w)
+		return DS_ERROR_INVALID;
+	if (bpf_wq_init(&w->work, &ds_page_reserve_wq, 0) ||
+	    bpf_wq_set_callback(&w->work, ds_page_reserve_refill_cb, 0))
+		return DS_ERROR_INVALID;
+
+	return ds_page_reserve_fill();
+}
+
+#else /* !__BPF__ */
+
+/* ========================================================================
+ * USERSPACE REPORTING
+ * ======================================================================== */
+
+static inline void ds_page_reserve_print(struct ds_page_reserve __arena *r)
+{
+	__u64 taken = 0, exhausted = 0, refilled = 0;
+
+	for (__u32 cpu = 0; cpu < r->nr_cpus && cpu < DS_PAGE_RESERVE_CPUS; cpu++) {
+		taken += r->cpu[cpu].taken;
+		exhausted += r->cpu[cpu].exhausted;
+		refilled += r->cpu[cpu].refilled;
+	}
+
+	printf("Page reserve (%u CPUs x %u pages, refill below %u):\n",
+	       r->nr_cpus, r->depth, r->low);
+	printf("  taken=%llu exhausted=%llu retire_lost=%llu refilled=%llu\n",
+	       (unsigned long long)taken, (unsigned long long)exhausted,
+	       (unsigned long long)r->retire_lost, (unsigned long long)refilled);
+	printf("  kicks=%llu runs=%llu released=%llu refill_failed=%llu\n",
+	       (unsigned long long)r->kicks, (unsigned long long)r->refill_runs,
+	       (unsigned long long)r->released, (unsigned long long)r->refill_failed);
+}
+
+#endif /* __BPF__ */
+
+#endif /* DS_PAGE_RESERVE_H */
@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Phase-Level Latency Attribution
+ *
+ * DS_OP_STATS and ds_metrics say how long an operation took. Phase markers
+ * say where inside it the time went. An instrumented operation starts a
+ * timer on entry and closes a phase at each boundary; every close adds the
+ * time since the previous boundary to that (op, phase) cell:
+ *
+ *   insert: [alloc: get + fill node] [retry: lost round]... [cas: winning
+ *           round, loads + link CAS on tail->node.next] [fixup: count +
+ *           tail swing]
+ *   pop:    [retry]... [cas: deciding round, loads + head CAS, or the empty
+ *           check] [alloc: free old dummy] [fixup: count]
+ *
+ * Instrumented so far: ds_msqueue insert and pop, _lkmm and _c.
+ *
+ * Define DS_PHASES and include this header before the data structure
+ * headers; the Makefile's PHASES=1 does the define for the BPF objects and
+ * loaders. Without DS_PHASES the markers in ds_api.h compile to nothing.
+ * Each marker costs one clock read and two relaxed adds. That cost lands in
+ * the phase it closes, so compare phases within a build rather than
+ * against an uninstrumented one.
+ *
+ * Cells live in one slot per CPU (BPF, ds_phase_state in the arena) or per
+ * thread (userspace, ds_phase_user_state), picked like the DS_OP_STATS
+ * slots. They cover every instrumented structure in the program, so keep
+ * one structure per program when reading them. ds_phase_print() sums the
+ * slots and prints a per-op breakdown.
+ */
+#ifndef DS_PHASE_H
+#define DS_PHASE_H
+
+#pragma once
+
+#if defined(DS_PHASES) && defined(DS_MSQUEUE_H)
+#error "include ds_phase.h before the data structure headers it instruments"
+#endif
+
+#include "ds_api.h"
+
+#ifndef __BPF__
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#endif
+
+/* ========================================================================
+ * LAYOUT (shared with BPF)
+ * ======================================================================== */
+
+enum ds_phase {
+	DS_PHASE_ALLOC = 0,  /* allocator calls and node setup */
+	DS_PHASE_CAS = 1,    /* the round that decides the op: its loads and CAS */
+	DS_PHASE_RETRY = 2,  /* rounds that lost a CAS or helped a lagging tail */
+	DS_PHASE_FIXUP = 3,  /* after the op is visible: count, tail swing */
+	DS_PHASE_MAX = 4,
+};
+
+struct ds_phase_cell {
+	__u64 ns;    /* time attributed to this phase */
+	__u64 hits;  /* phase closes; retries can close several per op */
+};
+
+/**
+ * struct ds_phase_slot - One CPU's or thread's cells (eight cache lines)
+ * @ops: Operations started, per enum ds_op_type
+ * @cell: Time per op and phase
+ */
+struct ds_phase_slot {
+	__u64 ops[DS_OP_MAX];
+	struct ds_phase_cell cell[DS_OP_MAX][DS_PHASE_MAX];
+	__u64 pad[1];
+};
+
+struct ds_phase_store {
+	struct ds_phase_slot slots[DS_OP_STATS_SLOTS];
+};
+
+#ifdef __BPF__
+struct ds_phase_store __arena ds_phase_state;
+#define DS_PHASE_STATE (&ds_phase_state)
+#else
+static struct ds_phase_store ds_phase_user_state;
+#define DS_PHASE_STATE (&ds_phase_user_state)
+#endif
+
+/* ========================================================================
+ * RECORDING
+ * ======================================================================== */
+
+static inline void ds_phase_count(struct ds_phase_store __arena *s, int op)
+{
+	if (op < 0 || op >= DS_OP_MAX)
+		return;
+	cast_kern(s);
+	arena_atomic_add(&s->slots[ds_op_stats_slot()].ops[op], 1, ARENA_RELAXED);
+}
+
+static inline void ds_phase_add(struct ds_phase_store __arena *s, int op, int phase, __u64 ns)
+{
+	struct ds_phase_cell __arena *c;
+
+	if (op < 0 || op >= DS_OP_MAX || phase < 0 || phase >= DS_PHASE_MAX)
+		return;
+	cast_kern(s);
+	c = &s->slots[ds_op_stats_slot()].cell[op][phase];
+	arena_atomic_add(&c->ns, ns, ARENA_RELAXED);
+	arena_atomic_add(&c->hits, 1, ARENA_RELAXED);
+}
+
+/*
+ * The markers keep the last boundary in a local, so an operation split
+ * across helpers opens it again with DS_PHASE_RESUME() in each one.
+ */
+#ifdef DS_PHASES
+#undef DS_PHASE_START
+#undef DS_PHASE_RESUME
+#undef DS_PHASE_END
+
+#define DS_PHASE_START(op) \
+	__u64 __ds_phase_t = (ds_phase_count(DS_PHASE_STATE, (op)), ds_op_stats_now())
+
+#define DS_PHASE_RESUME() __u64 __ds_phase_t = ds_op_stats_now()
+
+#define DS_PHASE_END(op, phase) \
+do { \
+	__u64 __ds_phase_now = ds_op_stats_now(); \
+	ds_phase_add(DS_PHASE_STATE, (op), (phase), __ds_phase_now - __ds_phase_t); \
+	__ds_phase_t = __ds_phase_now; \
+} while (0)
+#endif /* DS_PHASES */
+
+/* ========================================================================
+ * USERSPACE REPORTING
+ * ======================================================================== */
+
+#ifndef __BPF__
+
+static const char *const ds_phase_names[DS_PHASE_MAX] = {
+	"alloc", "cas", "retry", "fixup",
+};
+
+/* Sum every slot of @s into @out (one slot's worth of fields) */
+static inline void ds_phase_read(struct ds_phase_store __arena *s, struct ds_phase_slot *out)
+{
+	memset(out, 0, sizeof(*out));
+	cast_kern(s);
+
+	for (int i = 0; i < DS_OP_STATS_SLOTS; i++) {
+		struct ds_phase_slot __arena *slot = &s->slots[i];
+
+		for (int op = 0; op < DS_OP_MAX; op++) {
+			out->ops[op] += arena_atomic_load(&slot->ops[op], ARENA_RELAXED);
+			for (int p = 0; p < DS_PHASE_MAX; p++) {
+				out->cell[op][p].ns +=
+					arena_atomic_load(&slot->cell[op][p].ns, ARENA_RELAXED);
+				out->cell[op][p].hits +=
+					arena_atomic_load(&slot->cell[op][p].hits, ARENA_RELAXED);
+			}
+		}
+	}
+}
+
+/**
+ * ds_phase_print - Per-op phase breakdown
+ * @name: Label, e.g. "MSQueue kernel"
+ * @s: ds_phase_state from the skeleton, or DS_PHASE_STATE for this process
+ *
+ * For each op that ran: ops and attributed ns per op, then per phase its
+ * closes, ns per close, ns per op and share of the op's attributed time.
+ */
+static inline void ds_phase_print(const char *name, struct ds_phase_store __arena *s)
+{
+	static const char *op_names[DS_OP_MAX] = {
+		"INIT", "INSERT", "DELETE", "POP", "SEARCH", "VERIFY", "ITERATE",
+	};
+	struct ds_phase_slot sum;
+	bool any = false;
+
+	ds_phase_read(s, &sum);
+
+	printf("Phases (%s):\n", name);
+	for (int op = 0; op < DS_OP_MAX; op++) {
+		__u64 ops = sum.ops[op], total = 0;
+
+		if (!ops)
+			continue;
+		any = true;
+		for (int p = 0; p < DS_PHASE_MAX; p++)
+			total += sum.cell[op][p].ns;
+
+		printf("  %-8s %10llu ops, %llu ns/op attributed\n", op_names[op],
+		       (unsigned long long)ops, (unsigned long long)(total / ops));
+		for (int p = 0; p < DS_PHASE_MAX; p++) {
+			struct ds_phase_cell *c = &sum.cell[op][p];
+
+			if (!c->hits)
+				continue;
+			printf("    %-6s %10llu hits %7llu ns/hit %7llu ns/op %5.1f%%\n",
+			       ds_phase_names[p], (unsigned long long)c->hits,
+			       (unsigned long long)(c->ns / c->hits),
+			       (unsigned long long)(c->ns / ops),
+			       total ? (double)c->ns / (double)total * 100.0 : 0.0);
+		}
+	}
+	if (!any)
+		printf("  (none recorded)\n");
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_PHASE_H */
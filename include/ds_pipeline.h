@@ -0,0 +1,470 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Multi-Stage Userspace Pipeline over Arena SPSC Rings
+ *
+ * The skeleton relays are a single stage (pop KU, insert UK). Real
+ * processing is usually several steps, e.g. filter -> enrich -> forward,
+ * and running them in one thread puts the slowest step's cost on every
+ * event. This runtime runs each stage on its own pinned thread and links
+ * neighbouring stages with a ds_ck_ring_spsc in the arena:
+ *
+ *   in ──> [stage 0] ──link──> [stage 1] ──link──> ... [stage n-1] ──> out
+ *
+ * - Batched handoff: a stage takes up to @batch entries from its input
+ *   with one index acquire/release pair, runs its callback on each, and
+ *   publishes the survivors downstream the same way.
+ * - Back-pressure: a stage whose output ring is full keeps retrying and
+ *   stops reading its input, so a slow stage fills the links before it
+ *   and finally the source ring; BPF producers then see DS_ERROR_FULL.
+ *   Nothing is dropped inside the pipeline.
+ * - Metrics, per stage: input queue depth (sampled at every batch),
+ *   service time per entry averaged over each batch (log2 histogram),
+ *   time stalled on a full downstream ring, and items in / out / dropped.
+ *
+ * Shutdown drains: once the input is closed, each stage exits after its
+ * upstream has exited and its input ring is empty.
+ *
+ * Userspace only. @in is typically the KU lane the BPF side fills with
+ * ds_ck_ring_spsc_insert(); @out (optional) is read by the next consumer.
+ */
+#ifndef DS_PIPELINE_H
+#define DS_PIPELINE_H
+
+#pragma once
+
+#ifndef __BPF__
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ds_api.h"
+#include "ds_ck_ring_spsc.h"
+#include "ds_metrics.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+#define DS_PIPELINE_MAX_STAGES 8
+#define DS_PIPELINE_MAX_BATCH 256
+
+/*
+ * Service-time histogram: bucket b counts entries whose batch averaged
+ * [2^b, 2^(b+1)) ns per entry. Entries are not timed one by one, so a
+ * slow entry in a fast batch is smoothed out.
+ */
+#define DS_PIPELINE_LAT_BUCKETS 32
+
+/* CPUs addressable by the affinity mask */
+#define DS_PIPELINE_MAX_CPUS 1024
+
+/* Stage callback results */
+#define DS_PIPELINE_FORWARD 0
+#define DS_PIPELINE_DROP 1
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/*
+ * Called once per entry; may rewrite @kv in place. Returns
+ * DS_PIPELINE_FORWARD to pass it downstream or DS_PIPELINE_DROP.
+ */
+typedef int (*ds_pipeline_stage_fn)(void *ctx, struct ds_kv *kv);
+
+/**
+ * struct ds_pipeline_stage_stats - Per-stage counters (written by the stage)
+ * @items_in: Entries taken from the input ring
+ * @items_out: Entries handed downstream (or sunk by the last stage)
+ * @dropped: Entries the callback dropped
+ * @batches: Non-empty input batches
+ * @idle_polls: Polls that found the input empty
+ * @depth_sum: Sum of input depth sampled at each batch
+ * @depth_max: Largest input depth seen
+ * @service_ns: Time spent inside the callback
+ * @stall_ns: Time blocked on a full output ring (back-pressure)
+ * @stalls: Handoff attempts that found the output full
+ * @lat_hist: Batch-average service time per entry, log2 buckets,
+ *            weighted by entries
+ *
+ * Stable once ds_pipeline_wait() returns; live reads may be torn.
+ */
+struct ds_pipeline_stage_stats {
+	__u64 items_in;
+	__u64 items_out;
+	__u64 dropped;
+	__u64 batches;
+	__u64 idle_polls;
+	__u64 depth_sum;
+	__u64 depth_max;
+	__u64 service_ns;
+	__u64 stall_ns;
+	__u64 stalls;
+	__u64 lat_hist[DS_PIPELINE_LAT_BUCKETS];
+};
+
+struct ds_pipeline;
+
+/**
+ * struct ds_pipeline_stage - One stage thread
+ * @name: Label for ds_pipeline_print()
+ * @fn: Per-entry callback, NULL forwards everything
+ * @ctx: Callback argument
+ * @cpu: CPU to pin to, or -1 to leave unpinned
+ * @index: Position in the pipeline
+ * @in: Input ring (the pipeline input or the previous link)
+ * @out: Output ring (the next link, the pipeline output, or NULL = sink)
+ * @done: Set after the stage's last handoff
+ */
+struct ds_pipeline_stage {
+	const char *name;
+	ds_pipeline_stage_fn fn;
+	void *ctx;
+	int cpu;
+	__u32 index;
+	struct ds_ck_ring_spsc_head *in;
+	struct ds_ck_ring_spsc_head *out;
+	struct ds_pipeline *pipe;
+	pthread_t thread;
+	_Atomic int done;
+	struct ds_pipeline_stage_stats stats;
+};
+
+/**
+ * struct ds_pipeline - Stage chain and the links between stages
+ * @nr_stages: Stages added
+ * @batch: Entries moved per handoff, 1 .. DS_PIPELINE_MAX_BATCH
+ * @link_capacity: Capacity of each inter-stage ring (power of 2)
+ * @started: Threads running
+ * @input_closed: No more entries will be written to @in
+ * @abort: Stop without draining
+ * @in: Source ring read by stage 0
+ * @out: Ring written by the last stage, or NULL
+ * @links: links[i] joins stage i to stage i + 1
+ */
+struct ds_pipeline {
+	__u32 nr_stages;
+	__u32 batch;
+	__u32 link_capacity;
+	bool started;
+	_Atomic int input_closed;
+	_Atomic int abort;
+	struct ds_ck_ring_spsc_head *in;
+	struct ds_ck_ring_spsc_head *out;
+	struct ds_ck_ring_spsc_head links[DS_PIPELINE_MAX_STAGES - 1];
+	struct ds_pipeline_stage stages[DS_PIPELINE_MAX_STAGES];
+};
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+/* Pin the calling thread; raw syscall so callers need not set _GNU_SOURCE */
+static inline void ds_pipeline_pin_cpu(int cpu)
+{
+	unsigned long mask[DS_PIPELINE_MAX_CPUS / (8 * sizeof(unsigned long))] = {0};
+	long nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int bits = 8 * sizeof(unsigned long);
+
+	if (cpu < 0 || nr_cpus < 1)
+		return;
+
+	cpu %= nr_cpus < DS_PIPELINE_MAX_CPUS ? (int)nr_cpus : DS_PIPELINE_MAX_CPUS;
+	mask[cpu / bits] |= 1ul << (cpu % bits);
+	(void)syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+}
+
+static inline __u32 ds_pipeline_log2(__u64 v)
+{
+	__u32 b = v ? 63 - (__u32)__builtin_clzll(v) : 0;
+
+	return b < DS_PIPELINE_LAT_BUCKETS ? b : DS_PIPELINE_LAT_BUCKETS - 1;
+}
+
+/* Push @n entries downstream, waiting while the output ring is full */
+static inline void ds_pipeline_handoff(struct ds_pipeline_stage *s,
+				       const struct ds_kv *buf, __u32 n)
+{
+	__u64 stall_start = 0;
+	__u32 off = 0;
+
+	if (!s->out) {
+		s->stats.items_out += n;
+		return;
+	}
+
+	while (off < n) {
+		__u32 k = ds_ck_ring_spsc_insert_batch_c(s->out, buf + off, n - off);
+
+		off += k;
+		if (k)
+			continue;
+
+		if (atomic_load_explicit(&s->pipe->abort, memory_order_relaxed))
+			break;
+		if (!stall_start)
+			stall_start = ds_metrics_clock();
+		s->stats.stalls++;
+		sched_yield();
+	}
+
+	if (stall_start)
+		s->stats.stall_ns += ds_metrics_clock() - stall_start;
+	s->stats.items_out += off;
+}
+
+static inline void *ds_pipeline_stage_main(void *arg)
+{
+	struct ds_pipeline_stage *s = arg;
+	struct ds_pipeline *p = s->pipe;
+	_Atomic int *upstream_done = s->index ? &p->stages[s->index - 1].done :
+						&p->input_closed;
+	struct ds_kv buf[DS_PIPELINE_MAX_BATCH];
+
+	ds_pipeline_pin_cpu(s->cpu);
+
+	while (!atomic_load_explicit(&p->abort, memory_order_relaxed)) {
+		__u32 depth = ds_ck_ring_spsc_size_c(s->in);
+		__u32 n, kept = 0;
+		__u64 start, elapsed;
+
+		if (!depth) {
+			/* Upstream finished before the re-check: nothing more can arrive */
+			if (atomic_load_explicit(upstream_done, memory_order_acquire) &&
+			    ds_ck_ring_spsc_is_empty_c(s->in))
+				break;
+			s->stats.idle_polls++;
+			sched_yield();
+			continue;
+		}
+
+		n = ds_ck_ring_spsc_delete_batch_c(s->in, buf, p->batch);
+		if (!n)
+			continue;
+
+		start = ds_metrics_clock();
+		for (__u32 i = 0; i < n; i++) {
+			if (s->fn && s->fn(s->ctx, &buf[i]) != DS_PIPELINE_FORWARD)
+				continue;
+			buf[kept++] = buf[i];
+		}
+		elapsed = ds_metrics_clock() - start;
+
+		s->stats.items_in += n;
+		s->stats.dropped += n - kept;
+		s->stats.batches++;
+		s->stats.depth_sum += depth;
+		if (depth > s->stats.depth_max)
+			s->stats.depth_max = depth;
+		s->stats.service_ns += elapsed;
+		s->stats.lat_hist[ds_pipeline_log2(elapsed / n)] += n;
+
+		ds_pipeline_handoff(s, buf, kept);
+	}
+
+	atomic_store_explicit(&s->done, 1, memory_order_release);
+	return NULL;
+}
+
+/* ========================================================================
+ * API
+ * ======================================================================== */
+
+/**
+ * ds_pipeline_init - Prepare an empty pipeline
+ * @p: Pipeline
+ * @in: Initialized source ring, read by stage 0
+ * @out: Initialized ring for the last stage's output, or NULL to sink
+ * @link_capacity: Capacity of each inter-stage ring (power of 2)
+ * @batch: Entries moved per handoff, 1 .. DS_PIPELINE_MAX_BATCH
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int ds_pipeline_init(struct ds_pipeline *p,
+				   struct ds_ck_ring_spsc_head *in,
+				   struct ds_ck_ring_spsc_head *out,
+				   __u32 link_capacity, __u32 batch)
+{
+	if (!p || !in || !batch || batch > DS_PIPELINE_MAX_BATCH ||
+	    !ds_ck_ring_spsc_is_power_of_two(link_capacity))
+		return DS_ERROR_INVALID;
+
+	memset(p, 0, sizeof(*p));
+	p->in = in;
+	p->out = out;
+	p->link_capacity = link_capacity;
+	p->batch = batch;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_pipeline_add_stage - Append a stage
+ * @p: Pipeline (not started)
+ * @name: Label for reports
+ * @fn: Per-entry callback, NULL to forward unchanged
+ * @ctx: Callback argument
+ * @cpu: CPU to pin the stage thread to, -1 for none
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_FULL or DS_ERROR_INVALID
+ */
+static inline int ds_pipeline_add_stage(struct ds_pipeline *p, const char *name,
+					ds_pipeline_stage_fn fn, void *ctx, int cpu)
+{
+	struct ds_pipeline_stage *s;
+
+	if (!p || p->started)
+		return DS_ERROR_INVALID;
+	if (p->nr_stages >= DS_PIPELINE_MAX_STAGES)
+		return DS_ERROR_FULL;
+
+	s = &p->stages[p->nr_stages];
+	s->name = name;
+	s->fn = fn;
+	s->ctx = ctx;
+	s->cpu = cpu;
+	s->index = p->nr_stages++;
+	s->pipe = p;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_pipeline_start - Allocate the links and start one thread per stage
+ * @p: Pipeline with at least one stage
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOMEM or DS_ERROR_INVALID
+ */
+static inline int ds_pipeline_start(struct ds_pipeline *p)
+{
+	int ret;
+
+	if (!p || p->started || !p->nr_stages)
+		return DS_ERROR_INVALID;
+
+	for (__u32 i = 0; i + 1 < p->nr_stages; i++) {
+		ret = ds_ck_ring_spsc_init_c(&p->links[i], p->link_capacity);
+		if (ret != DS_SUCCESS)
+			return ret;
+	}
+
+	for (__u32 i = 0; i < p->nr_stages; i++) {
+		struct ds_pipeline_stage *s = &p->stages[i];
+
+		s->in = i ? &p->links[i - 1] : p->in;
+		s->out = i + 1 < p->nr_stages ? &p->links[i] : p->out;
+	}
+
+	for (__u32 i = 0; i < p->nr_stages; i++) {
+		if (pthread_create(&p->stages[i].thread, NULL, ds_pipeline_stage_main,
+				   &p->stages[i]) != 0) {
+			/* Unwind the stages already running */
+			atomic_store(&p->abort, 1);
+			for (__u32 j = 0; j < i; j++)
+				pthread_join(p->stages[j].thread, NULL);
+			return DS_ERROR_NOMEM;
+		}
+	}
+
+	p->started = true;
+	return DS_SUCCESS;
+}
+
+/* The writer of @in is finished; stages drain and exit */
+static inline void ds_pipeline_close_input(struct ds_pipeline *p)
+{
+	atomic_store_explicit(&p->input_closed, 1, memory_order_release);
+}
+
+/* Wait for every stage to exit (after close_input or abort) */
+static inline void ds_pipeline_wait(struct ds_pipeline *p)
+{
+	if (!p->started)
+		return;
+	for (__u32 i = 0; i < p->nr_stages; i++)
+		pthread_join(p->stages[i].thread, NULL);
+	p->started = false;
+}
+
+/* Stop without draining; entries still queued stay in the rings */
+static inline void ds_pipeline_stop(struct ds_pipeline *p)
+{
+	atomic_store(&p->abort, 1);
+	ds_pipeline_wait(p);
+}
+
+/* Live input depth of stage @i (safe while running) */
+static inline __u32 ds_pipeline_depth(struct ds_pipeline *p, __u32 i)
+{
+	if (i >= p->nr_stages || !p->stages[i].in)
+		return 0;
+	return ds_ck_ring_spsc_size_c(p->stages[i].in);
+}
+
+/* Upper bound of the bucket holding the @pct percentile of batch-average service time */
+static inline __u64 ds_pipeline_percentile_ns(const struct ds_pipeline_stage_stats *st,
+					      unsigned int pct)
+{
+	__u64 total = 0, seen = 0, rank;
+
+	for (__u32 b = 0; b < DS_PIPELINE_LAT_BUCKETS; b++)
+		total += st->lat_hist[b];
+	if (!total)
+		return 0;
+
+	rank = (total * pct + 99) / 100;
+	for (__u32 b = 0; b < DS_PIPELINE_LAT_BUCKETS; b++) {
+		seen += st->lat_hist[b];
+		if (seen >= rank)
+			return (2ull << b) - 1;
+	}
+	return ~0ull;
+}
+
+/**
+ * ds_pipeline_print - Per-stage report
+ * @p: Pipeline (after ds_pipeline_wait() for exact numbers)
+ *
+ * Columns: entries in / out / dropped, mean and max input depth, mean
+ * service time per entry, p99 of the per-batch average, and time stalled
+ * by back-pressure.
+ */
+static inline void ds_pipeline_print(struct ds_pipeline *p)
+{
+	printf("%-12s %10s %10s %8s %9s %7s %9s %11s %10s\n",
+	       "Stage", "In", "Out", "Dropped", "AvgDepth", "MaxDep",
+	       "ns/item", "p99avg(ns)", "Stall(ms)");
+
+	for (__u32 i = 0; i < p->nr_stages; i++) {
+		struct ds_pipeline_stage *s = &p->stages[i];
+		const struct ds_pipeline_stage_stats *st = &s->stats;
+
+		printf("%-12s %10llu %10llu %8llu %9.1f %7llu %9.1f %11llu %10.2f\n",
+		       s->name ? s->name : "stage",
+		       (unsigned long long)st->items_in,
+		       (unsigned long long)st->items_out,
+		       (unsigned long long)st->dropped,
+		       st->batches ? (double)st->depth_sum / (double)st->batches : 0.0,
+		       (unsigned long long)st->depth_max,
+		       st->items_in ? (double)st->service_ns / (double)st->items_in : 0.0,
+		       (unsigned long long)ds_pipeline_percentile_ns(st, 99),
+		       (double)st->stall_ns / 1e6);
+	}
+}
+
+static inline const struct ds_metadata *ds_pipeline_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "pipeline",
+		.description = "Pinned stage threads linked by arena SPSC rings",
+		.node_size = sizeof(struct ds_kv),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_PIPELINE_H */
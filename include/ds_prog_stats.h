@@ -0,0 +1,301 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Kernel Run-Time Statistics for the Relay Programs
+ *
+ * DS_METRICS_RECORD_OP times only the data structure call, from inside the
+ * program. The rest of an invocation is not in those numbers: the program's
+ * own bookkeeping and helper calls, the metrics record itself, and the
+ * trampoline, LSM or uprobe dispatch that runs it.
+ *
+ * With BPF_ENABLE_STATS (bpf_enable_stats(BPF_STATS_RUN_TIME)) the kernel
+ * adds each run's duration to the program's run_time_ns and counts it in
+ * run_cnt, readable through bpf_prog_info. Stats stay on while the returned
+ * fd is open. The kernel brackets the program body only, so per-run cost
+ * minus the in-program DS time is what the program spends outside the data
+ * structure:
+ *
+ *   wall per trigger ─┬─ uprobe trap + dispatch   (wall - run)
+ *                     └─ run_time_ns / run_cnt ─┬─ outside the DS op (run - DS)
+ *                                               └─ DS op (ds_metrics ring)
+ *
+ * Dispatch is not in run_time_ns. For the uprobe consumer the loader fires
+ * the probe itself, so it can time its triggers and ds_prog_stats_print()
+ * shows the difference as entry overhead. The LSM producer runs inside
+ * someone else's syscall and gets no wall column.
+ *
+ * Usage (loader): DS_PROG_STATS_SETUP() after load with one
+ * DS_PROG_STATS_PROG() per program and the ds_metrics category it records,
+ * and ds_prog_stats_print() next to ds_metrics_print(). Loaders that need
+ * more control call ds_prog_stats_enable() and ds_prog_stats_add()
+ * themselves. ds_metrics_calibrate_run() is here too: like the stats, it
+ * drives a program through libbpf, which ds_metrics.h does not depend on.
+ * Userspace only.
+ */
+#ifndef DS_PROG_STATS_H
+#define DS_PROG_STATS_H
+
+#pragma once
+
+#ifndef __BPF__
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+
+#include "ds_api.h"
+#include "ds_metrics.h"
+
+#define DS_PROG_STATS_MAX 8
+
+/**
+ * struct ds_prog_stats_entry - One program's run-time counters
+ * @name: Label for the report
+ * @prog_fd: Program fd, or -1 if the program was not loaded
+ * @category: ds_metrics category it records, or -1 for none
+ * @base_run_ns: run_time_ns when the entry was added
+ * @base_run_cnt: run_cnt when the entry was added
+ * @wall_ns: Loader-measured time for @wall_cnt triggers (0 if not timed)
+ * @wall_cnt: Number of triggers timed
+ */
+struct ds_prog_stats_entry {
+	const char *name;
+	int prog_fd;
+	int category;
+	__u64 base_run_ns;
+	__u64 base_run_cnt;
+	__u64 wall_ns;
+	__u64 wall_cnt;
+};
+
+/**
+ * struct ds_prog_stats - Programs watched by one loader
+ * @stats_fd: fd from bpf_enable_stats(), or -1
+ * @nr: Entries in use
+ * @progs: The entries
+ */
+struct ds_prog_stats {
+	int stats_fd;
+	int nr;
+	struct ds_prog_stats_entry progs[DS_PROG_STATS_MAX];
+};
+
+/* Read one program's cumulative run time and run count */
+static inline int ds_prog_stats_read(int prog_fd, __u64 *run_ns, __u64 *run_cnt)
+{
+	struct bpf_prog_info info;
+	__u32 len = sizeof(info);
+
+	if (prog_fd < 0)
+		return DS_ERROR_INVALID;
+
+	memset(&info, 0, sizeof(info));
+	if (bpf_obj_get_info_by_fd(prog_fd, &info, &len))
+		return DS_ERROR_INVALID;
+
+	*run_ns = info.run_time_ns;
+	*run_cnt = info.run_cnt;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_prog_stats_enable - Turn on kernel run-time accounting
+ * @ps: Stats to set up
+ *
+ * Needs CAP_SYS_ADMIN. Stats are also on while the kernel.bpf_stats_enabled
+ * sysctl is set, in which case the counters may already be non-zero; each
+ * entry keeps its starting values and reports the difference.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if the kernel refused
+ */
+static inline int ds_prog_stats_enable(struct ds_prog_stats *ps)
+{
+	memset(ps, 0, sizeof(*ps));
+	ps->stats_fd = bpf_enable_stats(BPF_STATS_RUN_TIME);
+	return ps->stats_fd >= 0 ? DS_SUCCESS : DS_ERROR_INVALID;
+}
+
+/**
+ * ds_prog_stats_add - Watch one program
+ * @ps: Enabled stats
+ * @name: Label for the report
+ * @prog_fd: bpf_program__fd() of the program; negative if not loaded
+ * @category: ds_metrics category the program records, or -1
+ *
+ * Returns: Entry index for ds_prog_stats_set_wall(), or DS_ERROR_FULL
+ */
+static inline int ds_prog_stats_add(struct ds_prog_stats *ps, const char *name,
+				    int prog_fd, int category)
+{
+	struct ds_prog_stats_entry *e;
+
+	if (ps->nr >= DS_PROG_STATS_MAX)
+		return DS_ERROR_FULL;
+
+	e = &ps->progs[ps->nr];
+	e->name = name;
+	e->prog_fd = prog_fd;
+	e->category = category;
+	if (ds_prog_stats_read(prog_fd, &e->base_run_ns, &e->base_run_cnt) != DS_SUCCESS)
+		e->prog_fd = -1;
+	return ps->nr++;
+}
+
+/**
+ * struct ds_prog_stats_prog - One program to watch, for ds_prog_stats_setup()
+ * @name: Label for the report
+ * @prog_fd: bpf_program__fd() of the program
+ * @category: ds_metrics category it records, or -1
+ */
+struct ds_prog_stats_prog {
+	const char *name;
+	int prog_fd;
+	int category;
+};
+
+/* Entry for program @prog of skeleton @skel, labelled with its name */
+#define DS_PROG_STATS_PROG(skel, prog, cat) \
+	{ .name = #prog, .prog_fd = bpf_program__fd((skel)->progs.prog), .category = (cat) }
+
+/**
+ * ds_prog_stats_setup - Enable run-time stats and watch @nr programs
+ * @ps: Stats to set up
+ * @progs: Programs, in report order
+ * @nr: Entries in @progs
+ *
+ * Call after load and before attach, so every counted run is one the
+ * loader caused. If the kernel refuses (no CAP_SYS_ADMIN) this says so and
+ * leaves @ps disabled; the other ds_prog_stats_*() calls then do nothing.
+ *
+ * Returns: Entry index of the last DS_METRICS_LKMM_CONSUMER program, for
+ *          ds_prog_stats_set_wall(), or -1
+ */
+static inline int ds_prog_stats_setup(struct ds_prog_stats *ps,
+				      const struct ds_prog_stats_prog *progs, int nr)
+{
+	int consumer = -1;
+
+	if (ds_prog_stats_enable(ps) != DS_SUCCESS) {
+		fprintf(stderr, "BPF_ENABLE_STATS failed (needs CAP_SYS_ADMIN); -S ignored\n");
+		return -1;
+	}
+
+	for (int i = 0; i < nr; i++) {
+		int idx = ds_prog_stats_add(ps, progs[i].name, progs[i].prog_fd,
+					    progs[i].category);
+
+		if (idx >= 0 && progs[i].category == DS_METRICS_LKMM_CONSUMER)
+			consumer = idx;
+	}
+	return consumer;
+}
+
+/* ds_prog_stats_setup() over the DS_PROG_STATS_PROG() entries given */
+#define DS_PROG_STATS_SETUP(ps, ...)							\
+	({										\
+		const struct ds_prog_stats_prog __progs[] = { __VA_ARGS__ };		\
+											\
+		ds_prog_stats_setup((ps), __progs,					\
+				    (int)(sizeof(__progs) / sizeof(__progs[0])));	\
+	})
+
+/* Record how long the loader spent firing @idx @cnt times */
+static inline void ds_prog_stats_set_wall(struct ds_prog_stats *ps, int idx,
+					  __u64 ns, __u64 cnt)
+{
+	if (ps->stats_fd < 0 || idx < 0 || idx >= ps->nr)
+		return;
+	ps->progs[idx].wall_ns = ns;
+	ps->progs[idx].wall_cnt = cnt;
+}
+
+/**
+ * ds_prog_stats_print - Per-run kernel cost next to the in-program DS time
+ * @ps: Enabled stats
+ * @store: Metrics store the programs record into, or NULL
+ *
+ * Columns: runs and ns per run from bpf_prog_info; ns per DS op from the
+ * program's ds_metrics ring, less the calibrated timing bias; the part of
+ * each run spent outside the DS op; and, for timed triggers, wall ns per
+ * trigger and the dispatch overhead it implies. Programs sharing a
+ * category share its DS average.
+ */
+static inline void ds_prog_stats_print(struct ds_prog_stats *ps,
+				       struct ds_metrics_store __arena *store)
+{
+	if (ps->stats_fd < 0)
+		return;
+
+	printf("------------------------------------------------------------\n");
+	printf("BPF run time (BPF_ENABLE_STATS):\n");
+	printf("%-18s %9s %9s %9s %9s %6s %9s %9s\n",
+	       "Program", "Runs", "Run(ns)", "DS(ns)", "Other", "DS%", "Wall(ns)", "Entry");
+
+	for (int i = 0; i < ps->nr; i++) {
+		struct ds_prog_stats_entry *e = &ps->progs[i];
+		__u64 run_ns, run_cnt, per_run, ds = 0;
+
+		if (ds_prog_stats_read(e->prog_fd, &run_ns, &run_cnt) != DS_SUCCESS) {
+			printf("%-18s %9s\n", e->name, "n/a");
+			continue;
+		}
+		run_ns -= e->base_run_ns;
+		run_cnt -= e->base_run_cnt;
+		per_run = run_cnt ? run_ns / run_cnt : 0;
+
+		if (store && e->category >= 0 && e->category < DS_METRICS_NUM_CATEGORIES) {
+			struct ds_metrics_ring __arena *ring = &store->rings[e->category];
+
+			cast_kern(ring);
+			ds = ring->count ? ring->total_latency_ns / ring->count : 0;
+			ds = ds_metrics_corrected(ds, ds_metrics_bias(store, e->category));
+		}
+
+		printf("%-18s %9llu %9llu %9llu %9llu %5.1f%%",
+		       e->name, (unsigned long long)run_cnt, (unsigned long long)per_run,
+		       (unsigned long long)ds,
+		       (unsigned long long)(per_run > ds ? per_run - ds : 0),
+		       per_run ? (double)ds / (double)per_run * 100.0 : 0.0);
+		if (e->wall_cnt) {
+			__u64 wall = e->wall_ns / e->wall_cnt;
+
+			printf(" %9llu %9llu", (unsigned long long)wall,
+			       (unsigned long long)(wall > per_run ? wall - per_run : 0));
+		}
+		printf("\n");
+	}
+}
+
+/**
+ * ds_metrics_calibrate_run - Calibrate the kernel and userspace clocks
+ * @store: The skeleton's metrics store, mapped from the arena
+ * @prog_fd: bpf_program__fd() of the DS_METRICS_CALIBRATE_PROG() program
+ *
+ * Runs the kernel half with BPF_PROG_TEST_RUN, then ds_metrics_calibrate()
+ * for userspace. Call once after load and before anything is attached.
+ *
+ * Returns: 0, or non-zero if the kernel half did not run; latencies are
+ *          then printed uncorrected
+ */
+static inline int ds_metrics_calibrate_run(struct ds_metrics_store __arena *store, int prog_fd)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int err;
+
+	err = bpf_prog_test_run_opts(prog_fd, &opts);
+	if (err)
+		return err;
+	ds_metrics_calibrate(store, DS_METRICS_SIDE_USER);
+	return opts.retval == DS_SUCCESS ? 0 : -1;
+}
+
+static inline void ds_prog_stats_close(struct ds_prog_stats *ps)
+{
+	if (ps->stats_fd >= 0)
+		close(ps->stats_fd);
+	ps->stats_fd = -1;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_PROG_STATS_H */
@@ -0,0 +1,805 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Read-Mostly RCU Table for BPF Arena (userspace writer, BPF readers)
+ *
+ * Configuration pushed kernel-ward (allow lists, thresholds) is read on
+ * every event but changes rarely. Instead of streaming it through a UK
+ * queue, userspace builds a complete new version of the table off to the
+ * side and publishes it with a single pointer store:
+ *
+ *   writer (userspace, single):          readers (BPF or userspace, many):
+ *     ver = clone(cur) / alloc()            snap = read_begin(head)
+ *     set()/del() on ver (private)          get(snap, key)...
+ *     publish(head, ver)  -> cur = ver      if (read_retry(snap)) redo
+ *     reclaim(head): grace period,
+ *       poison old->gen, free old
+ *
+ * Reads are plain loads only -- no atomic RMW, no shared counters, no
+ * cache line written by a reader.
+ *
+ * Grace periods: non-sleepable BPF programs run inside classic RCU
+ * read-side sections, so ds_rcu_table_synchronize_c() uses
+ * membarrier(MEMBARRIER_CMD_GLOBAL) (a synchronize_rcu() in the kernel)
+ * to wait them out, falling back to a fixed sleep where membarrier is
+ * unavailable. Sleepable programs (lsm.s, uprobe.s) and userspace readers
+ * are not covered by that, so every version also carries a seqcount-style
+ * generation: reclaim poisons ver->gen to 0 before freeing, and readers
+ * re-check the generation after reading. A reader that straddles a
+ * reclaim sees the mismatch and retries on the current version instead
+ * of returning stale or torn data. Arena pages stay addressable after a
+ * free (BPF reads zeroes, userspace refaults), so a late read never
+ * crashes.
+ *
+ * Entries are kept sorted by key, so BPF lookups are a bounded binary
+ * search over one arena page.
+ */
+#ifndef DS_RCU_TABLE_H
+#define DS_RCU_TABLE_H
+
+#pragma once
+
+#include "ds_api.h"
+
+#ifndef __BPF__
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Entries per version; a version must fit one allocator page fragment */
+#define DS_RCU_TABLE_CAPACITY 240
+
+/* Retired versions the writer may hold before it must reclaim */
+#define DS_RCU_TABLE_MAX_RETIRED 8
+
+/* Reader retries before ds_rcu_table_lookup() gives up with BUSY */
+#define DS_RCU_TABLE_READ_RETRIES 4
+
+/* Fallback grace period when membarrier() is unavailable */
+#define DS_RCU_TABLE_GRACE_NS (10ULL * 1000 * 1000)
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+struct ds_rcu_table_ver;
+
+typedef struct ds_rcu_table_ver __arena ds_rcu_table_ver_t;
+
+/**
+ * struct ds_rcu_table_ver - One immutable-once-published table version
+ * @gen: Publication generation; 0 = unpublished or reclaimed
+ * @nr: Number of valid entries
+ * @entries: Entries sorted by ascending key
+ */
+struct ds_rcu_table_ver {
+	__u64 gen;
+	__u32 nr;
+	__u32 pad;
+	struct ds_kv entries[DS_RCU_TABLE_CAPACITY];
+};
+
+_Static_assert(sizeof(struct ds_rcu_table_ver) <= 4096 - sizeof(__u64),
+	       "ds_rcu_table version must fit one arena page fragment");
+
+/**
+ * struct ds_rcu_table_head - Table control block
+ * @cur: Currently published version (NULL until the first publish)
+ * @gen: Generation of @cur
+ * @publishes: Versions published so far
+ * @reclaimed: Retired versions freed so far
+ * @nr_retired: Writer-private: entries used in @retired
+ * @retired: Writer-private: unpublished versions awaiting a grace period
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
+ *
+ * Only @cur and @gen are read by readers; the rest belongs to the writer.
+ */
+struct ds_rcu_table_head {
+	ds_rcu_table_ver_t *cur;
+	__u64 gen;
+	__u64 publishes;
+	__u64 reclaimed;
+	__u32 nr_retired;
+	__u32 pad;
+	ds_rcu_table_ver_t *retired[DS_RCU_TABLE_MAX_RETIRED];
+	DS_OP_STATS_FIELD
+};
+
+typedef struct ds_rcu_table_head __arena ds_rcu_table_head_t;
+
+/**
+ * struct ds_rcu_table_snap - Reader-side snapshot handle (lives on stack)
+ * @ver: Version being read
+ * @gen: Generation observed at ds_rcu_table_read_begin()
+ */
+struct ds_rcu_table_snap {
+	ds_rcu_table_ver_t *ver;
+	__u64 gen;
+};
+
+/* ========================================================================
+ * READ SIDE (lock-free, no atomic RMW)
+ * ======================================================================== */
+
+/**
+ * ds_rcu_table_read_begin_lkmm - Take a snapshot of the current version
+ * @head: Table head
+ * @snap: Snapshot to fill
+ *
+ * LKMM: head->cur is loaded with acquire, pairing with the writer's
+ * release store, so the version contents written before it are visible.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOT_FOUND if nothing is published yet,
+ *          DS_ERROR_BUSY if the version was reclaimed under us
+ */
+static inline int ds_rcu_table_read_begin_lkmm(struct ds_rcu_table_head __arena *head,
+					       struct ds_rcu_table_snap *snap)
+{
+	ds_rcu_table_ver_t *ver;
+	__u64 gen;
+
+	if (!head || !snap)
+		return DS_ERROR_INVALID;
+
+	ver = smp_load_acquire(&head->cur);
+	if (!ver)
+		return DS_ERROR_NOT_FOUND;
+
+	cast_kern(ver);
+	gen = smp_load_acquire(&ver->gen);
+	if (!gen)
+		return DS_ERROR_BUSY;
+
+	snap->ver = ver;
+	snap->gen = gen;
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_rcu_table_read_begin_c(struct ds_rcu_table_head __arena *head,
+					    struct ds_rcu_table_snap *snap)
+{
+	ds_rcu_table_ver_t *ver;
+	__u64 gen;
+
+	if (!head || !snap)
+		return DS_ERROR_INVALID;
+
+	ver = arena_atomic_load(&head->cur, ARENA_ACQUIRE);
+	if (!ver)
+		return DS_ERROR_NOT_FOUND;
+
+	cast_kern(ver);
+	gen = arena_atomic_load(&ver->gen, ARENA_ACQUIRE);
+	if (!gen)
+		return DS_ERROR_BUSY;
+
+	snap->ver = ver;
+	snap->gen = gen;
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_rcu_table_read_begin(struct ds_rcu_table_head __arena *head,
+					  struct ds_rcu_table_snap *snap)
+{
+#ifdef __BPF__
+	return ds_rcu_table_read_begin_lkmm(head, snap);
+#else
+	return ds_rcu_table_read_begin_c(head, snap);
+#endif
+}
+
+/**
+ * ds_rcu_table_get_lkmm - Look a key up inside a snapshot
+ * @snap: Snapshot from ds_rcu_table_read_begin()
+ * @key: Key to find
+ * @value: Output for the value; may be NULL
+ *
+ * Bounded binary search. The result is only trustworthy once
+ * ds_rcu_table_read_retry() has returned false for @snap.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_NOT_FOUND
+ */
+static inline int ds_rcu_table_get_lkmm(struct ds_rcu_table_snap *snap,
+					__u64 key, __u64 *value)
+{
+	ds_rcu_table_ver_t *ver = snap->ver;
+	__u32 lo = 0, hi;
+
+	hi = READ_ONCE(ver->nr);
+	if (hi > DS_RCU_TABLE_CAPACITY)
+		hi = DS_RCU_TABLE_CAPACITY;
+
+	while (lo < hi && can_loop) {
+		__u32 mid = lo + (hi - lo) / 2;
+		__u64 k = READ_ONCE(ver->entries[mid].key);
+
+		if (k == key) {
+			if (value)
+				*value = READ_ONCE(ver->entries[mid].value);
+			return DS_SUCCESS;
+		}
+		if (k < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return DS_ERROR_NOT_FOUND;
+}
+
+#ifndef __BPF__
+static inline int ds_rcu_table_get_c(struct ds_rcu_table_snap *snap,
+				     __u64 key, __u64 *value)
+{
+	ds_rcu_table_ver_t *ver = snap->ver;
+	__u32 lo = 0, hi;
+
+	hi = arena_atomic_load(&ver->nr, ARENA_RELAXED);
+	if (hi > DS_RCU_TABLE_CAPACITY)
+		hi = DS_RCU_TABLE_CAPACITY;
+
+	while (lo < hi && can_loop) {
+		__u32 mid = lo + (hi - lo) / 2;
+		__u64 k = arena_atomic_load(&ver->entries[mid].key, ARENA_RELAXED);
+
+		if (k == key) {
+			if (value)
+				*value = arena_atomic_load(&ver->entries[mid].value, ARENA_RELAXED);
+			return DS_SUCCESS;
+		}
+		if (k < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return DS_ERROR_NOT_FOUND;
+}
+#endif
+
+static inline int ds_rcu_table_get(struct ds_rcu_table_snap *snap, __u64 key, __u64 *value)
+{
+#ifdef __BPF__
+	return ds_rcu_table_get_lkmm(snap, key, value);
+#else
+	return ds_rcu_table_get_c(snap, key, value);
+#endif
+}
+
+/**
+ * ds_rcu_table_read_retry_lkmm - Validate a snapshot after reading it
+ * @snap: Snapshot from ds_rcu_table_read_begin()
+ *
+ * Seqcount-style re-check: if the version was reclaimed while we read it,
+ * its generation has been poisoned. The read barrier keeps the entry and
+ * @nr loads before the generation load; sleepable BPF readers are not
+ * covered by the membarrier grace period and rely on this check alone.
+ *
+ * Returns: true if the reads since read_begin must be discarded
+ */
+static inline bool ds_rcu_table_read_retry_lkmm(struct ds_rcu_table_snap *snap)
+{
+	arena_smp_rmb();
+	return READ_ONCE(snap->ver->gen) != snap->gen;
+}
+
+#ifndef __BPF__
+static inline bool ds_rcu_table_read_retry_c(struct ds_rcu_table_snap *snap)
+{
+	__atomic_thread_fence(ARENA_ACQUIRE);
+	return arena_atomic_load(&snap->ver->gen, ARENA_RELAXED) != snap->gen;
+}
+#endif
+
+static inline bool ds_rcu_table_read_retry(struct ds_rcu_table_snap *snap)
+{
+#ifdef __BPF__
+	return ds_rcu_table_read_retry_lkmm(snap);
+#else
+	return ds_rcu_table_read_retry_c(snap);
+#endif
+}
+
+/**
+ * ds_rcu_table_lookup_lkmm - One-shot validated lookup
+ * @head: Table head
+ * @key: Key to find
+ * @value: Output for the value; may be NULL
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOT_FOUND, or DS_ERROR_BUSY if every
+ *          attempt raced with a reclaim
+ */
+static inline int __ds_rcu_table_lookup_lkmm(struct ds_rcu_table_head __arena *head,
+					     __u64 key, __u64 *value)
+{
+	struct ds_rcu_table_snap snap;
+	__u64 val = 0;
+	int ret;
+
+	for (int i = 0; i < DS_RCU_TABLE_READ_RETRIES && can_loop; i++) {
+		ret = ds_rcu_table_read_begin_lkmm(head, &snap);
+		if (ret == DS_ERROR_BUSY)
+			continue;
+		if (ret != DS_SUCCESS)
+			return ret;
+
+		ret = ds_rcu_table_get_lkmm(&snap, key, &val);
+		if (ds_rcu_table_read_retry_lkmm(&snap))
+			continue;
+
+		if (ret == DS_SUCCESS && value)
+			*value = val;
+		return ret;
+	}
+
+	return DS_ERROR_BUSY;
+}
+
+static inline int ds_rcu_table_lookup_lkmm(struct ds_rcu_table_head __arena *head,
+					   __u64 key, __u64 *value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_rcu_table_lookup_lkmm(head, key, value));
+}
+
+#ifndef __BPF__
+static inline int __ds_rcu_table_lookup_c(struct ds_rcu_table_head __arena *head,
+					  __u64 key, __u64 *value)
+{
+	struct ds_rcu_table_snap snap;
+	__u64 val = 0;
+	int ret;
+
+	for (int i = 0; i < DS_RCU_TABLE_READ_RETRIES && can_loop; i++) {
+		ret = ds_rcu_table_read_begin_c(head, &snap);
+		if (ret == DS_ERROR_BUSY)
+			continue;
+		if (ret != DS_SUCCESS)
+			return ret;
+
+		ret = ds_rcu_table_get_c(&snap, key, &val);
+		if (ds_rcu_table_read_retry_c(&snap))
+			continue;
+
+		if (ret == DS_SUCCESS && value)
+			*value = val;
+		return ret;
+	}
+
+	return DS_ERROR_BUSY;
+}
+
+static inline int ds_rcu_table_lookup_c(struct ds_rcu_table_head __arena *head,
+					__u64 key, __u64 *value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_rcu_table_lookup_c(head, key, value));
+}
+#endif
+
+static inline int ds_rcu_table_lookup(struct ds_rcu_table_head __arena *head,
+				      __u64 key, __u64 *value)
+{
+#ifdef __BPF__
+	return ds_rcu_table_lookup_lkmm(head, key, value);
+#else
+	return ds_rcu_table_lookup_c(head, key, value);
+#endif
+}
+
+static inline int ds_rcu_table_search(struct ds_rcu_table_head __arena *head, __u64 key)
+{
+	return ds_rcu_table_lookup(head, key, NULL);
+}
+
+/* ========================================================================
+ * WRITE SIDE (userspace only, single writer)
+ * ======================================================================== */
+
+#ifndef __BPF__
+
+/**
+ * ds_rcu_table_init_c - Initialize an empty, unpublished table
+ * @head: Table head (arena memory shared with the BPF readers)
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int __ds_rcu_table_init_c(struct ds_rcu_table_head __arena *head)
+{
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	arena_atomic_store(&head->gen, 0, ARENA_RELAXED);
+	head->publishes = 0;
+	head->reclaimed = 0;
+	head->nr_retired = 0;
+	for (int i = 0; i < DS_RCU_TABLE_MAX_RETIRED; i++)
+		head->retired[i] = NULL;
+	arena_atomic_store(&head->cur, NULL, ARENA_RELEASE);
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_rcu_table_init_c(struct ds_rcu_table_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_rcu_table_init_c(head));
+}
+
+/**
+ * ds_rcu_table_ver_alloc_c - Allocate an empty private version
+ *
+ * Returns: New version, or NULL if the arena is exhausted
+ */
+static inline ds_rcu_table_ver_t *ds_rcu_table_ver_alloc_c(void)
+{
+	ds_rcu_table_ver_t *ver;
+
+	ver = bpf_arena_alloc(sizeof(*ver));
+	if (!ver)
+		return NULL;
+
+	ver->gen = 0;
+	ver->nr = 0;
+	ver->pad = 0;
+	return ver;
+}
+
+/**
+ * ds_rcu_table_ver_clone_c - Copy the published version into a private one
+ * @head: Table head
+ *
+ * The read-copy half of read-copy-update: the caller edits the returned
+ * copy and publishes it. Starts empty if nothing is published yet.
+ *
+ * Returns: New version, or NULL if the arena is exhausted
+ */
+static inline ds_rcu_table_ver_t *ds_rcu_table_ver_clone_c(struct ds_rcu_table_head __arena *head)
+{
+	ds_rcu_table_ver_t *ver, *cur;
+
+	ver = ds_rcu_table_ver_alloc_c();
+	if (!ver)
+		return NULL;
+
+	/* Single writer: cur cannot be reclaimed under us */
+	cur = arena_atomic_load(&head->cur, ARENA_RELAXED);
+	if (cur) {
+		ver->nr = cur->nr;
+		memcpy((void *)ver->entries, (const void *)cur->entries,
+		       cur->nr * sizeof(struct ds_kv));
+	}
+	return ver;
+}
+
+/**
+ * ds_rcu_table_ver_set_c - Insert or update a key in a private version
+ * @ver: Unpublished version
+ * @key: Key
+ * @value: Value
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_FULL at DS_RCU_TABLE_CAPACITY,
+ *          DS_ERROR_INVALID if @ver is already published
+ */
+static inline int ds_rcu_table_ver_set_c(ds_rcu_table_ver_t *ver, __u64 key, __u64 value)
+{
+	__u32 pos = 0;
+
+	if (!ver || ver->gen)
+		return DS_ERROR_INVALID;
+
+	while (pos < ver->nr && ver->entries[pos].key < key)
+		pos++;
+
+	if (pos < ver->nr && ver->entries[pos].key == key) {
+		ver->entries[pos].value = value;
+		return DS_SUCCESS;
+	}
+
+	if (ver->nr >= DS_RCU_TABLE_CAPACITY)
+		return DS_ERROR_FULL;
+
+	memmove((void *)&ver->entries[pos + 1], (const void *)&ver->entries[pos],
+		(ver->nr - pos) * sizeof(struct ds_kv));
+	ver->entries[pos].key = key;
+	ver->entries[pos].value = value;
+	ver->nr++;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_rcu_table_ver_del_c - Remove a key from a private version
+ * @ver: Unpublished version
+ * @key: Key
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOT_FOUND, or DS_ERROR_INVALID
+ */
+static inline int ds_rcu_table_ver_del_c(ds_rcu_table_ver_t *ver, __u64 key)
+{
+	__u32 pos = 0;
+
+	if (!ver || ver->gen)
+		return DS_ERROR_INVALID;
+
+	while (pos < ver->nr && ver->entries[pos].key < key)
+		pos++;
+
+	if (pos >= ver->nr || ver->entries[pos].key != key)
+		return DS_ERROR_NOT_FOUND;
+
+	memmove((void *)&ver->entries[pos], (const void *)&ver->entries[pos + 1],
+		(ver->nr - pos - 1) * sizeof(struct ds_kv));
+	ver->nr--;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_rcu_table_synchronize_c - Wait for a grace period
+ *
+ * membarrier(MEMBARRIER_CMD_GLOBAL) returns only after a kernel
+ * synchronize_rcu(), which covers every non-sleepable BPF reader that was
+ * running when it was called. Without membarrier, sleep for
+ * DS_RCU_TABLE_GRACE_NS; the generation re-check keeps readers safe
+ * either way.
+ */
+static inline void ds_rcu_table_synchronize_c(void)
+{
+	struct timespec ts = {
+		.tv_sec = DS_RCU_TABLE_GRACE_NS / 1000000000ULL,
+		.tv_nsec = DS_RCU_TABLE_GRACE_NS % 1000000000ULL,
+	};
+
+	if (syscall(__NR_membarrier, MEMBARRIER_CMD_GLOBAL, 0, 0) == 0)
+		return;
+
+	nanosleep(&ts, NULL);
+}
+
+/**
+ * ds_rcu_table_reclaim_c - Free every retired version after a grace period
+ * @head: Table head
+ *
+ * Poisons each retired version's generation before freeing it so that a
+ * reader still inside it fails its re-check.
+ *
+ * Returns: Number of versions freed
+ */
+static inline int __ds_rcu_table_reclaim_c(struct ds_rcu_table_head __arena *head)
+{
+	__u32 n = head->nr_retired;
+
+	if (!n)
+		return 0;
+
+	ds_rcu_table_synchronize_c();
+
+	for (__u32 i = 0; i < n; i++) {
+		ds_rcu_table_ver_t *old = head->retired[i];
+
+		arena_atomic_store(&old->gen, 0, ARENA_RELEASE);
+		bpf_arena_free(old);
+		head->retired[i] = NULL;
+	}
+
+	head->nr_retired = 0;
+	head->reclaimed += n;
+	return (int)n;
+}
+
+static inline int ds_rcu_table_reclaim_c(struct ds_rcu_table_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_ITERATE, __ds_rcu_table_reclaim_c(head));
+}
+
+/**
+ * ds_rcu_table_publish_c - Make a private version the current one
+ * @head: Table head
+ * @ver: Version built with ver_alloc/ver_clone and ver_set/ver_del
+ *
+ * A single release store of head->cur publishes the whole version. The
+ * previous version is retired; if the retired list is full it is
+ * reclaimed first, which waits for a grace period.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int __ds_rcu_table_publish_c(struct ds_rcu_table_head __arena *head,
+					   ds_rcu_table_ver_t *ver)
+{
+	ds_rcu_table_ver_t *old;
+	__u64 gen;
+
+	if (!head || !ver || ver->gen)
+		return DS_ERROR_INVALID;
+
+	if (head->nr_retired >= DS_RCU_TABLE_MAX_RETIRED)
+		__ds_rcu_table_reclaim_c(head);
+
+	gen = arena_atomic_load(&head->gen, ARENA_RELAXED) + 1;
+	arena_atomic_store(&ver->gen, gen, ARENA_RELAXED);
+
+	old = arena_atomic_load(&head->cur, ARENA_RELAXED);
+	arena_atomic_store(&head->cur, ver, ARENA_RELEASE);
+	arena_atomic_store(&head->gen, gen, ARENA_RELAXED);
+	head->publishes++;
+
+	if (old)
+		head->retired[head->nr_retired++] = old;
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_rcu_table_publish_c(struct ds_rcu_table_head __arena *head,
+					 ds_rcu_table_ver_t *ver)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_rcu_table_publish_c(head, ver));
+}
+
+#endif /* !__BPF__ */
+
+/* ========================================================================
+ * VERIFY / METADATA
+ * ======================================================================== */
+
+/**
+ * ds_rcu_table_verify_lkmm - Check the published version is sorted and sane
+ * @head: Table head
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_CORRUPT, or DS_ERROR_INVALID
+ */
+static inline int __ds_rcu_table_verify_lkmm(struct ds_rcu_table_head __arena *head)
+{
+	ds_rcu_table_ver_t *ver;
+	__u32 nr;
+
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	ver = READ_ONCE(head->cur);
+	if (!ver)
+		return DS_SUCCESS;
+
+	cast_kern(ver);
+	nr = READ_ONCE(ver->nr);
+	if (nr > DS_RCU_TABLE_CAPACITY || READ_ONCE(ver->gen) != READ_ONCE(head->gen))
+		return DS_ERROR_CORRUPT;
+
+	for (__u32 i = 1; i < nr && can_loop; i++) {
+		if (ver->entries[i - 1].key >= ver->entries[i].key)
+			return DS_ERROR_CORRUPT;
+	}
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_rcu_table_verify_lkmm(struct ds_rcu_table_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_rcu_table_verify_lkmm(head));
+}
+
+#ifndef __BPF__
+static inline int __ds_rcu_table_verify_c(struct ds_rcu_table_head __arena *head)
+{
+	ds_rcu_table_ver_t *ver;
+	__u32 nr;
+
+	if (!head)
+		return DS_ERROR_INVALID;
+
+	ver = arena_atomic_load(&head->cur, ARENA_ACQUIRE);
+	if (!ver)
+		return DS_SUCCESS;
+
+	nr = arena_atomic_load(&ver->nr, ARENA_RELAXED);
+	if (nr > DS_RCU_TABLE_CAPACITY ||
+	    arena_atomic_load(&ver->gen, ARENA_RELAXED) != arena_atomic_load(&head->gen, ARENA_RELAXED))
+		return DS_ERROR_CORRUPT;
+
+	for (__u32 i = 1; i < nr; i++) {
+		if (ver->entries[i - 1].key >= ver->entries[i].key)
+			return DS_ERROR_CORRUPT;
+	}
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_rcu_table_verify_c(struct ds_rcu_table_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_rcu_table_verify_c(head));
+}
+#endif
+
+static inline int ds_rcu_table_verify(struct ds_rcu_table_head __arena *head)
+{
+#ifdef __BPF__
+	return ds_rcu_table_verify_lkmm(head);
+#else
+	return ds_rcu_table_verify_c(head);
+#endif
+}
+
+static inline const struct ds_metadata *ds_rcu_table_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "rcu_table",
+		.description = "Double-buffered read-mostly table published from userspace",
+		.node_size = sizeof(struct ds_rcu_table_ver),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+/**
+ * ds_rcu_table_stats - Published entries, version memory and per-op counters
+ * @head: Table head
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * memory_used counts the current version and the retired ones still
+ * waiting for a grace period. Call it from the writer, which owns
+ * @head->nr_retired. Publish counts as DS_OP_INSERT, lookup as
+ * DS_OP_SEARCH and reclaim as DS_OP_ITERATE.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_rcu_table_stats_lkmm(struct ds_rcu_table_head __arena *head,
+					  struct ds_stats *stats)
+{
+	ds_rcu_table_ver_t *ver;
+
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	ver = smp_load_acquire(&head->cur);
+	stats->current_elements = 0;
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)READ_ONCE(head->nr_retired) * sizeof(struct ds_rcu_table_ver);
+	if (ver) {
+		cast_kern(ver);
+		stats->current_elements = READ_ONCE(ver->nr);
+		stats->memory_used += sizeof(struct ds_rcu_table_ver);
+	}
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_rcu_table_stats_c(struct ds_rcu_table_head __arena *head,
+				       struct ds_stats *stats)
+{
+	ds_rcu_table_ver_t *ver;
+
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	ver = arena_atomic_load(&head->cur, ARENA_ACQUIRE);
+	stats->current_elements = 0;
+	stats->max_elements = 0;
+	stats->memory_used = (__u64)head->nr_retired * sizeof(struct ds_rcu_table_ver);
+	if (ver) {
+		stats->current_elements = arena_atomic_load(&ver->nr, ARENA_RELAXED);
+		stats->memory_used += sizeof(struct ds_rcu_table_ver);
+	}
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_rcu_table_stats(struct ds_rcu_table_head __arena *head,
+				     struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_rcu_table_stats_lkmm(head, stats);
+#else
+	return ds_rcu_table_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_rcu_table_reset_stats(struct ds_rcu_table_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
+
+#endif /* DS_RCU_TABLE_H */
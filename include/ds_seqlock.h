@@ -0,0 +1,349 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Arena Seqlock for Consistent Multi-Word Snapshots
+ *
+ * Counters such as the relay's total_kernel_* globals are read by
+ * userspace one word at a time, so a reader can see ops from one update
+ * and failures from the next. A seqlock makes a small multi-word record
+ * readable as a unit:
+ *
+ *   writer:  seq -> odd (CAS), write fields, seq -> even (release)
+ *   reader:  s1 = seq (acquire, must be even), read fields,
+ *            read barrier, s2 = seq; retry if s1 != s2
+ *
+ * Readers only load, so they never delay a writer. Writers claim the
+ * record with a CAS rather than a plain increment: sleepable BPF programs
+ * can be preempted mid-update and another writer can land on the same
+ * record, so a writer that finds the sequence odd backs off with
+ * DS_ERROR_BUSY instead of corrupting it.
+ *
+ * ds_lane_stats builds per-lane statistics on top: one seqlocked record
+ * per CPU, so writers on different CPUs never share a line, and the
+ * reader sums per-CPU snapshots, each internally consistent.
+ */
+#ifndef DS_SEQLOCK_H
+#define DS_SEQLOCK_H
+
+#pragma once
+
+#include "ds_api.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Reader attempts before giving up on a record held by a stalled writer */
+#define DS_SEQLOCK_READ_RETRIES 4096
+
+/* Per-CPU records per lane; CPUs beyond this share records. Power of 2. */
+#define DS_LANE_STATS_SLOTS 64
+
+/* ========================================================================
+ * SEQLOCK PRIMITIVE
+ * ======================================================================== */
+
+/**
+ * struct ds_seqlock - Sequence counter guarding an adjacent record
+ * @seq: Even = stable, odd = write in progress
+ */
+struct ds_seqlock {
+	__u64 seq;
+};
+
+/**
+ * ds_seqlock_write_begin_lkmm - Enter a write section
+ * @sl: Seqlock
+ * @seq: Output: odd sequence to hand to ds_seqlock_write_end_lkmm()
+ *
+ * LKMM: BPF atomics that return a value are fully ordered, so the CAS
+ * also acts as the smp_wmb() between the odd sequence and the data.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_BUSY if another writer holds @sl
+ */
+static inline int ds_seqlock_write_begin_lkmm(struct ds_seqlock __arena *sl, __u64 *seq)
+{
+	__u64 s = READ_ONCE(sl->seq);
+
+	if (s & 1)
+		return DS_ERROR_BUSY;
+	if (arena_atomic_cmpxchg(&sl->seq, s, s + 1, ARENA_ACQUIRE, ARENA_RELAXED) != s)
+		return DS_ERROR_BUSY;
+
+	*seq = s + 1;
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_seqlock_write_end_lkmm - Leave a write section
+ * @sl: Seqlock
+ * @seq: Value returned by ds_seqlock_write_begin_lkmm()
+ */
+static inline void ds_seqlock_write_end_lkmm(struct ds_seqlock __arena *sl, __u64 seq)
+{
+	smp_store_release(&sl->seq, seq + 1);
+}
+
+#ifndef __BPF__
+static inline int ds_seqlock_write_begin_c(struct ds_seqlock __arena *sl, __u64 *seq)
+{
+	__u64 s = arena_atomic_load(&sl->seq, ARENA_RELAXED);
+
+	if (s & 1)
+		return DS_ERROR_BUSY;
+	if (arena_atomic_cmpxchg(&sl->seq, s, s + 1, ARENA_ACQUIRE, ARENA_RELAXED) != s)
+		return DS_ERROR_BUSY;
+	/* An acquire RMW does not keep its store before the data stores */
+	arena_smp_wmb();
+
+	*seq = s + 1;
+	return DS_SUCCESS;
+}
+
+static inline void ds_seqlock_write_end_c(struct ds_seqlock __arena *sl, __u64 seq)
+{
+	arena_atomic_store(&sl->seq, seq + 1, ARENA_RELEASE);
+}
+#endif
+
+static inline int ds_seqlock_write_begin(struct ds_seqlock __arena *sl, __u64 *seq)
+{
+#ifdef __BPF__
+	return ds_seqlock_write_begin_lkmm(sl, seq);
+#else
+	return ds_seqlock_write_begin_c(sl, seq);
+#endif
+}
+
+static inline void ds_seqlock_write_end(struct ds_seqlock __arena *sl, __u64 seq)
+{
+#ifdef __BPF__
+	ds_seqlock_write_end_lkmm(sl, seq);
+#else
+	ds_seqlock_write_end_c(sl, seq);
+#endif
+}
+
+/**
+ * ds_seqlock_read_begin_lkmm - Start a read section
+ * @sl: Seqlock
+ *
+ * Returns: Sequence to pass to ds_seqlock_read_retry_lkmm(); odd if a
+ *          writer is active (the retry check then always fails)
+ */
+static inline __u64 ds_seqlock_read_begin_lkmm(struct ds_seqlock __arena *sl)
+{
+	return smp_load_acquire(&sl->seq);
+}
+
+/**
+ * ds_seqlock_read_retry_lkmm - Check whether a read section was torn
+ * @sl: Seqlock
+ * @start: Value from ds_seqlock_read_begin_lkmm()
+ *
+ * The read barrier keeps the data loads before the second sequence load,
+ * pairing with the write barrier in ds_seqlock_write_begin_lkmm().
+ *
+ * Returns: true if the data read since @start must be discarded
+ */
+static inline bool ds_seqlock_read_retry_lkmm(struct ds_seqlock __arena *sl, __u64 start)
+{
+	arena_smp_rmb();
+	return (start & 1) || READ_ONCE(sl->seq) != start;
+}
+
+#ifndef __BPF__
+static inline __u64 ds_seqlock_read_begin_c(struct ds_seqlock __arena *sl)
+{
+	return arena_atomic_load(&sl->seq, ARENA_ACQUIRE);
+}
+
+static inline bool ds_seqlock_read_retry_c(struct ds_seqlock __arena *sl, __u64 start)
+{
+	/* Order the data loads before the second sequence load */
+	__atomic_thread_fence(ARENA_ACQUIRE);
+	return (start & 1) || arena_atomic_load(&sl->seq, ARENA_RELAXED) != start;
+}
+#endif
+
+static inline __u64 ds_seqlock_read_begin(struct ds_seqlock __arena *sl)
+{
+#ifdef __BPF__
+	return ds_seqlock_read_begin_lkmm(sl);
+#else
+	return ds_seqlock_read_begin_c(sl);
+#endif
+}
+
+static inline bool ds_seqlock_read_retry(struct ds_seqlock __arena *sl, __u64 start)
+{
+#ifdef __BPF__
+	return ds_seqlock_read_retry_lkmm(sl, start);
+#else
+	return ds_seqlock_read_retry_c(sl, start);
+#endif
+}
+
+/* ========================================================================
+ * PER-LANE STATISTICS
+ * ======================================================================== */
+
+/**
+ * struct ds_lane_stats - One consistent view of a lane's counters
+ * @ops: Operations attempted (always successes + failures)
+ * @successes: Operations that returned DS_SUCCESS
+ * @failures: Operations that returned an error
+ * @last_ns: Timestamp of the most recent update
+ */
+struct ds_lane_stats {
+	__u64 ops;
+	__u64 successes;
+	__u64 failures;
+	__u64 last_ns;
+};
+
+/**
+ * struct ds_lane_stats_slot - Seqlocked per-CPU record (one cache line)
+ */
+struct ds_lane_stats_slot {
+	struct ds_seqlock lock;
+	struct ds_lane_stats stats;
+	__u64 pad[3];
+};
+
+/**
+ * struct ds_lane_stats_pcpu - Statistics for one lane
+ * @slots: Per-CPU records
+ * @dropped: Updates skipped because the record was held by another writer
+ */
+struct ds_lane_stats_pcpu {
+	struct ds_lane_stats_slot slots[DS_LANE_STATS_SLOTS];
+	__u64 dropped;
+};
+
+/**
+ * ds_lane_stats_update_lkmm - Account one lane operation
+ * @lane: Lane statistics
+ * @result: Operation result (DS_SUCCESS counts as a success)
+ *
+ * Costs one uncontended CAS and a release store on the local CPU's line.
+ * A collision with a preempted writer on the same record is counted in
+ * @lane->dropped rather than waited out.
+ */
+#ifdef __BPF__
+static inline void ds_lane_stats_update_lkmm(struct ds_lane_stats_pcpu __arena *lane, int result)
+{
+	struct ds_lane_stats_slot __arena *slot;
+	__u32 cpu = bpf_get_smp_processor_id() & (DS_LANE_STATS_SLOTS - 1);
+	__u64 seq;
+
+	cast_kern(lane);
+	slot = &lane->slots[cpu];
+	cast_kern(slot);
+
+	if (ds_seqlock_write_begin_lkmm(&slot->lock, &seq) != DS_SUCCESS) {
+		arena_atomic_inc(&lane->dropped);
+		return;
+	}
+
+	WRITE_ONCE(slot->stats.ops, slot->stats.ops + 1);
+	if (result == DS_SUCCESS)
+		WRITE_ONCE(slot->stats.successes, slot->stats.successes + 1);
+	else
+		WRITE_ONCE(slot->stats.failures, slot->stats.failures + 1);
+	WRITE_ONCE(slot->stats.last_ns, bpf_ktime_get_ns());
+
+	ds_seqlock_write_end_lkmm(&slot->lock, seq);
+}
+#endif /* __BPF__ */
+
+#ifndef __BPF__
+/**
+ * ds_lane_stats_update_c - Userspace writer; @cpu selects the record
+ */
+static inline void ds_lane_stats_update_c(struct ds_lane_stats_pcpu __arena *lane,
+					  __u32 cpu, int result, __u64 now_ns)
+{
+	struct ds_lane_stats_slot __arena *slot = &lane->slots[cpu & (DS_LANE_STATS_SLOTS - 1)];
+	__u64 seq;
+
+	if (ds_seqlock_write_begin_c(&slot->lock, &seq) != DS_SUCCESS) {
+		arena_atomic_inc(&lane->dropped);
+		return;
+	}
+
+	arena_atomic_store(&slot->stats.ops, slot->stats.ops + 1, ARENA_RELAXED);
+	if (result == DS_SUCCESS)
+		arena_atomic_store(&slot->stats.successes, slot->stats.successes + 1, ARENA_RELAXED);
+	else
+		arena_atomic_store(&slot->stats.failures, slot->stats.failures + 1, ARENA_RELAXED);
+	arena_atomic_store(&slot->stats.last_ns, now_ns, ARENA_RELAXED);
+
+	ds_seqlock_write_end_c(&slot->lock, seq);
+}
+
+/**
+ * ds_lane_stats_read_slot_c - Consistent copy of one per-CPU record
+ * @slot: Record to read
+ * @out: Destination
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_BUSY if a writer held the record for
+ *          all DS_SEQLOCK_READ_RETRIES attempts
+ */
+static inline int ds_lane_stats_read_slot_c(struct ds_lane_stats_slot __arena *slot,
+					    struct ds_lane_stats *out)
+{
+	for (int i = 0; i < DS_SEQLOCK_READ_RETRIES; i++) {
+		__u64 start = ds_seqlock_read_begin_c(&slot->lock);
+
+		out->ops = arena_atomic_load(&slot->stats.ops, ARENA_RELAXED);
+		out->successes = arena_atomic_load(&slot->stats.successes, ARENA_RELAXED);
+		out->failures = arena_atomic_load(&slot->stats.failures, ARENA_RELAXED);
+		out->last_ns = arena_atomic_load(&slot->stats.last_ns, ARENA_RELAXED);
+
+		if (!ds_seqlock_read_retry_c(&slot->lock, start))
+			return DS_SUCCESS;
+	}
+
+	return DS_ERROR_BUSY;
+}
+
+/**
+ * ds_lane_stats_snapshot_c - Sum every per-CPU record of a lane
+ * @lane: Lane statistics
+ * @out: Destination; last_ns is the newest per-CPU timestamp
+ *
+ * Each record is read consistently, so invariants that hold per update
+ * (ops == successes + failures) hold in the sum.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_BUSY if some record stayed busy (its
+ *          contribution is then missing from @out)
+ */
+static inline int ds_lane_stats_snapshot_c(struct ds_lane_stats_pcpu __arena *lane,
+					   struct ds_lane_stats *out)
+{
+	int ret = DS_SUCCESS;
+
+	out->ops = 0;
+	out->successes = 0;
+	out->failures = 0;
+	out->last_ns = 0;
+
+	for (int i = 0; i < DS_LANE_STATS_SLOTS; i++) {
+		struct ds_lane_stats s;
+
+		if (ds_lane_stats_read_slot_c(&lane->slots[i], &s) != DS_SUCCESS) {
+			ret = DS_ERROR_BUSY;
+			continue;
+		}
+
+		out->ops += s.ops;
+		out->successes += s.successes;
+		out->failures += s.failures;
+		if (s.last_ns > out->last_ns)
+			out->last_ns = s.last_ns;
+	}
+
+	return ret;
+}
+#endif /* !__BPF__ */
+
+#endif /* DS_SEQLOCK_H */
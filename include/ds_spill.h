@@ -0,0 +1,611 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Spill-to-Disk Overflow for KU Lanes (userspace)
+ *
+ * A KU lane is a bounded ring. When the consumer stalls (slow downstream,
+ * GC pause, reconnect), the lane fills and the BPF producer starts to see
+ * DS_ERROR_FULL, which loses events. The spill stage keeps the lane from
+ * filling by draining it to disk and replaying it later:
+ *
+ *   BPF ──> lane ──┬── spill thread ──> segment files (append-only)
+ *                  │                         │
+ *                  └──── consumer <── replay ┘   (files first, then lane)
+ *
+ * - The spill thread polls the lane depth. At the high watermark it
+ *   starts moving batches into the current segment, and it stops again
+ *   at the low watermark.
+ * - Segments are preallocated files of a fixed size. They are mapped
+ *   MAP_SHARED and records are appended with memcpy. With DS_SPILL_F_DIRECT
+ *   the writer uses O_DIRECT pwrite() of block-aligned batches instead,
+ *   which keeps a long spill from flooding the page cache. That mode
+ *   needs _GNU_SOURCE for O_DIRECT.
+ * - Record format: a 4 KiB segment header, then batches. Each batch is a
+ *   24-byte header {magic, nr, bytes, spill_ns} followed by nr 16-byte
+ *   ds_kv entries. An END batch seals the segment. @bytes includes
+ *   alignment padding, so the reader always skips by @bytes.
+ * - Order: the lane is popped under a token that the spill thread and the
+ *   consumer take in turn. Anything in the files was popped before
+ *   anything still in the lane, so the consumer reads the files to the
+ *   end before it takes the token and pops the lane. A fully replayed
+ *   segment is unlinked.
+ *
+ * Bandwidth (bytes appended per ns spent writing) and replay latency
+ * (spill to read back, per entry) are kept in struct ds_spill_stats.
+ */
+#ifndef DS_SPILL_H
+#define DS_SPILL_H
+
+#pragma once
+
+#ifndef __BPF__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ds_api.h"
+#include "ds_metrics.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+#define DS_SPILL_MAGIC_SEGMENT	0x53505344U /* "DSPS" */
+#define DS_SPILL_MAGIC_BATCH	0x42505344U /* "DSPB" */
+#define DS_SPILL_MAGIC_END	0x45505344U /* "DSPE" */
+#define DS_SPILL_VERSION	1
+
+/* Segment header size and O_DIRECT block alignment */
+#define DS_SPILL_ALIGN		4096U
+
+/* Entries per spilled batch */
+#define DS_SPILL_MAX_BATCH	256U
+
+/* Segments that may exist at once (written but not yet replayed) */
+#define DS_SPILL_MAX_SEGMENTS	64U
+
+#define DS_SPILL_DEFAULT_SEGMENT_BYTES (64ULL << 20)
+
+/* Flags */
+#define DS_SPILL_F_DIRECT	(1U << 0) /* O_DIRECT writes instead of memcpy into the map */
+
+/* Replay latency histogram: bucket b counts [2^b, 2^(b+1)) ns */
+#define DS_SPILL_LAT_BUCKETS	40
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/* Lane access: pop one entry (DS_SUCCESS / DS_ERROR_NOT_FOUND), current depth */
+typedef int (*ds_spill_pop_fn)(void *lane, struct ds_kv *out);
+typedef __u32 (*ds_spill_depth_fn)(void *lane);
+
+/* On-disk headers (little-endian host layout) */
+struct ds_spill_segment_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 seq;
+	__u32 entry_size;
+	__u64 segment_bytes;
+};
+
+struct ds_spill_batch_hdr {
+	__u32 magic;
+	__u32 nr;
+	__u32 bytes;
+	__u32 pad;
+	__u64 spill_ns;
+};
+
+/**
+ * struct ds_spill_segment - One segment file
+ * @fd: File descriptor (O_DIRECT in direct mode)
+ * @map: Shared read(-write) mapping of the whole file
+ * @committed: Bytes readable from the start of the file (release-published)
+ * @wr_off: Writer-private append offset (== @committed in mmap mode)
+ */
+struct ds_spill_segment {
+	int fd;
+	__u8 *map;
+	_Atomic __u64 committed;
+	__u64 wr_off;
+};
+
+/**
+ * struct ds_spill_stats - Counters (writer fields by the spill thread,
+ *                         replay fields by the consumer)
+ */
+struct ds_spill_stats {
+	__u64 spill_episodes;	/* high-watermark crossings */
+	__u64 spilled;		/* entries written to segments */
+	__u64 batches;
+	__u64 bytes_written;	/* including headers and padding */
+	__u64 write_ns;		/* time spent appending */
+	__u64 segments;		/* segment files created */
+	__u64 window_full;	/* polls refused: DS_SPILL_MAX_SEGMENTS unread */
+	__u64 errors;		/* I/O failures */
+	__u64 replayed;		/* entries read back */
+	__u64 direct;		/* entries the consumer popped from the lane */
+	__u64 replay_lat_sum_ns;
+	__u64 replay_lat_max_ns;
+	__u64 replay_hist[DS_SPILL_LAT_BUCKETS];
+};
+
+/**
+ * struct ds_spill - Spill stage state
+ * @lane: Lane being protected; popped only under @token
+ * @high_wm: Depth at which spilling starts
+ * @low_wm: Depth at which spilling stops
+ * @w_seq: Segment being written (published to the reader)
+ * @r_seq: Segment being replayed (consumer-private)
+ * @r_off: Next batch offset in segment @r_seq
+ * @r_batch: Offset of the batch being replayed, 0 if none
+ * @r_idx: Next entry inside that batch
+ */
+struct ds_spill {
+	char dir[256];
+	__u64 segment_bytes;
+	__u32 flags;
+	__u32 batch;
+	void *lane;
+	ds_spill_pop_fn pop;
+	ds_spill_depth_fn depth;
+	__u32 high_wm;
+	__u32 low_wm;
+	bool spilling;
+	_Atomic int token;
+	_Atomic __u32 w_seq;
+	_Atomic __u32 r_seq_pub;
+	__u32 r_seq;
+	__u64 r_off;
+	__u64 r_batch;
+	__u32 r_idx;
+	__u8 *stage;
+	struct ds_spill_segment segs[DS_SPILL_MAX_SEGMENTS];
+	struct ds_spill_stats stats;
+};
+
+/* ========================================================================
+ * SEGMENT FILES
+ * ======================================================================== */
+
+static inline struct ds_spill_segment *ds_spill_seg(struct ds_spill *s, __u32 seq)
+{
+	return &s->segs[seq % DS_SPILL_MAX_SEGMENTS];
+}
+
+static inline void ds_spill_seg_path(struct ds_spill *s, __u32 seq, char *buf, size_t len)
+{
+	snprintf(buf, len, "%s/spill-%08u.seg", s->dir, seq);
+}
+
+static inline __u32 ds_spill_batch_bytes(struct ds_spill *s, __u32 nr)
+{
+	__u32 bytes = (__u32)(sizeof(struct ds_spill_batch_hdr) + nr * sizeof(struct ds_kv));
+
+	if (s->flags & DS_SPILL_F_DIRECT)
+		return (bytes + DS_SPILL_ALIGN - 1) & ~(DS_SPILL_ALIGN - 1);
+	return bytes;
+}
+
+/* Append @bytes from @buf at the segment write offset and publish them */
+static inline int ds_spill_seg_write(struct ds_spill *s, struct ds_spill_segment *seg,
+				     const void *buf, __u32 bytes)
+{
+	if (s->flags & DS_SPILL_F_DIRECT) {
+		if (pwrite(seg->fd, buf, bytes, (off_t)seg->wr_off) != (ssize_t)bytes)
+			return DS_ERROR_INVALID;
+	} else {
+		memcpy(seg->map + seg->wr_off, buf, bytes);
+	}
+
+	seg->wr_off += bytes;
+	atomic_store_explicit(&seg->committed, seg->wr_off, memory_order_release);
+	return DS_SUCCESS;
+}
+
+/* Create, preallocate and map segment @seq, then write its header */
+static inline int ds_spill_seg_open(struct ds_spill *s, __u32 seq)
+{
+	struct ds_spill_segment *seg = ds_spill_seg(s, seq);
+	struct ds_spill_segment_hdr *hdr = (struct ds_spill_segment_hdr *)s->stage;
+	int oflags = O_RDWR | O_CREAT | O_TRUNC;
+	char path[300];
+
+#ifdef O_DIRECT
+	if (s->flags & DS_SPILL_F_DIRECT)
+		oflags |= O_DIRECT;
+#endif
+
+	ds_spill_seg_path(s, seq, path, sizeof(path));
+	seg->fd = open(path, oflags, 0600);
+	if (seg->fd < 0)
+		return DS_ERROR_INVALID;
+
+	if (posix_fallocate(seg->fd, 0, (off_t)s->segment_bytes) != 0)
+		goto fail;
+
+	seg->map = mmap(NULL, s->segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+	if (seg->map == MAP_FAILED) {
+		seg->map = NULL;
+		goto fail;
+	}
+
+	seg->wr_off = 0;
+	atomic_store_explicit(&seg->committed, 0, memory_order_relaxed);
+
+	memset(s->stage, 0, DS_SPILL_ALIGN);
+	hdr->magic = DS_SPILL_MAGIC_SEGMENT;
+	hdr->version = DS_SPILL_VERSION;
+	hdr->seq = seq;
+	hdr->entry_size = sizeof(struct ds_kv);
+	hdr->segment_bytes = s->segment_bytes;
+	if (ds_spill_seg_write(s, seg, s->stage, DS_SPILL_ALIGN) != DS_SUCCESS)
+		goto fail;
+
+	s->stats.segments++;
+	return DS_SUCCESS;
+
+fail:
+	if (seg->map)
+		munmap(seg->map, s->segment_bytes);
+	seg->map = NULL;
+	close(seg->fd);
+	unlink(path);
+	return DS_ERROR_INVALID;
+}
+
+static inline void ds_spill_seg_close(struct ds_spill *s, __u32 seq, bool remove)
+{
+	struct ds_spill_segment *seg = ds_spill_seg(s, seq);
+	char path[300];
+
+	if (!seg->map)
+		return;
+
+	munmap(seg->map, s->segment_bytes);
+	close(seg->fd);
+	seg->map = NULL;
+	if (remove) {
+		ds_spill_seg_path(s, seq, path, sizeof(path));
+		unlink(path);
+	}
+}
+
+/* ========================================================================
+ * LANE TOKEN
+ * ======================================================================== */
+
+static inline bool ds_spill_token_try(struct ds_spill *s)
+{
+	int expected = 0;
+
+	return atomic_compare_exchange_strong_explicit(&s->token, &expected, 1,
+						       memory_order_acquire,
+						       memory_order_relaxed);
+}
+
+static inline void ds_spill_token_release(struct ds_spill *s)
+{
+	atomic_store_explicit(&s->token, 0, memory_order_release);
+}
+
+/* ========================================================================
+ * API
+ * ======================================================================== */
+
+/**
+ * ds_spill_init - Set up a spill stage for one lane
+ * @s: Spill state
+ * @dir: Existing directory for segment files
+ * @lane: Lane handle passed to @pop and @depth
+ * @pop: Pop one entry from the lane
+ * @depth: Current lane depth
+ * @capacity: Lane capacity; watermarks are 3/4 and 1/4 of it
+ * @segment_bytes: Segment size (multiple of DS_SPILL_ALIGN), 0 for default
+ * @flags: DS_SPILL_F_* flags
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOMEM or DS_ERROR_INVALID
+ */
+static inline int ds_spill_init(struct ds_spill *s, const char *dir, void *lane,
+				ds_spill_pop_fn pop, ds_spill_depth_fn depth, __u32 capacity,
+				__u64 segment_bytes, __u32 flags)
+{
+	if (!s || !dir || !lane || !pop || !depth || capacity < 4)
+		return DS_ERROR_INVALID;
+#ifndef O_DIRECT
+	if (flags & DS_SPILL_F_DIRECT)
+		return DS_ERROR_INVALID;
+#endif
+
+	memset(s, 0, sizeof(*s));
+	s->flags = flags;
+	if (!segment_bytes)
+		segment_bytes = DS_SPILL_DEFAULT_SEGMENT_BYTES;
+	if (segment_bytes % DS_SPILL_ALIGN ||
+	    segment_bytes < 2 * DS_SPILL_ALIGN + ds_spill_batch_bytes(s, DS_SPILL_MAX_BATCH))
+		return DS_ERROR_INVALID;
+
+	snprintf(s->dir, sizeof(s->dir), "%s", dir);
+	s->segment_bytes = segment_bytes;
+	s->batch = DS_SPILL_MAX_BATCH;
+	s->lane = lane;
+	s->pop = pop;
+	s->depth = depth;
+	s->high_wm = capacity - capacity / 4;
+	s->low_wm = capacity / 4;
+	s->r_off = DS_SPILL_ALIGN;
+
+	/* Staging buffer: aligned for O_DIRECT, one full batch plus padding */
+	if (posix_memalign((void **)&s->stage, DS_SPILL_ALIGN,
+			   ds_spill_batch_bytes(s, DS_SPILL_MAX_BATCH) + DS_SPILL_ALIGN) != 0)
+		return DS_ERROR_NOMEM;
+
+	if (ds_spill_seg_open(s, 0) != DS_SUCCESS) {
+		free(s->stage);
+		s->stage = NULL;
+		return DS_ERROR_INVALID;
+	}
+	return DS_SUCCESS;
+}
+
+/* Seal the current segment with END and open the next one */
+static inline int ds_spill_roll(struct ds_spill *s, __u64 now)
+{
+	__u32 seq = atomic_load_explicit(&s->w_seq, memory_order_relaxed);
+	struct ds_spill_batch_hdr *end = (struct ds_spill_batch_hdr *)s->stage;
+	__u32 bytes = ds_spill_batch_bytes(s, 0);
+
+	/* The reader must have left the slot the next segment reuses */
+	if (seq + 1 - atomic_load_explicit(&s->r_seq_pub, memory_order_acquire) >=
+	    DS_SPILL_MAX_SEGMENTS) {
+		s->stats.window_full++;
+		return DS_ERROR_FULL;
+	}
+
+	if (ds_spill_seg_open(s, seq + 1) != DS_SUCCESS)
+		return DS_ERROR_INVALID;
+
+	memset(s->stage, 0, bytes);
+	end->magic = DS_SPILL_MAGIC_END;
+	end->bytes = bytes;
+	end->spill_ns = now;
+	if (ds_spill_seg_write(s, ds_spill_seg(s, seq), s->stage, bytes) != DS_SUCCESS)
+		return DS_ERROR_INVALID;
+
+	atomic_store_explicit(&s->w_seq, seq + 1, memory_order_release);
+	return DS_SUCCESS;
+}
+
+/**
+ * ds_spill_poll - Spill thread step: move one batch to disk if needed
+ * @s: Spill state
+ *
+ * Call in a loop from the thread that owns the spill stage.
+ *
+ * Returns: Entries spilled (0 if below the watermark or the lane is busy)
+ */
+static inline __u32 ds_spill_poll(struct ds_spill *s)
+{
+	struct ds_spill_batch_hdr *hdr = (struct ds_spill_batch_hdr *)s->stage;
+	struct ds_kv *entries = (struct ds_kv *)(hdr + 1);
+	struct ds_spill_segment *seg;
+	__u32 depth = s->depth(s->lane);
+	__u32 nr = 0, bytes;
+	__u64 start;
+
+	if (!s->spilling && depth >= s->high_wm) {
+		s->spilling = true;
+		s->stats.spill_episodes++;
+	} else if (s->spilling && depth <= s->low_wm) {
+		s->spilling = false;
+	}
+	if (!s->spilling)
+		return 0;
+
+	start = ds_metrics_clock();
+	seg = ds_spill_seg(s, atomic_load_explicit(&s->w_seq, memory_order_relaxed));
+	if (seg->wr_off + ds_spill_batch_bytes(s, s->batch) + ds_spill_batch_bytes(s, 0) >
+	    s->segment_bytes) {
+		if (ds_spill_roll(s, start) != DS_SUCCESS)
+			return 0;
+		seg = ds_spill_seg(s, atomic_load_explicit(&s->w_seq, memory_order_relaxed));
+	}
+
+	if (!ds_spill_token_try(s))
+		return 0;
+	while (nr < s->batch && s->pop(s->lane, &entries[nr]) == DS_SUCCESS)
+		nr++;
+
+	if (nr) {
+		bytes = ds_spill_batch_bytes(s, nr);
+		memset((__u8 *)entries + nr * sizeof(struct ds_kv), 0,
+		       bytes - sizeof(*hdr) - nr * sizeof(struct ds_kv));
+		hdr->magic = DS_SPILL_MAGIC_BATCH;
+		hdr->nr = nr;
+		hdr->bytes = bytes;
+		hdr->pad = 0;
+		hdr->spill_ns = start;
+
+		/* Publish before releasing the token so the consumer sees it first */
+		if (ds_spill_seg_write(s, seg, s->stage, bytes) != DS_SUCCESS) {
+			/* Popped entries cannot go back; count them as lost */
+			s->stats.errors += nr;
+			nr = 0;
+		} else {
+			s->stats.spilled += nr;
+			s->stats.batches++;
+			s->stats.bytes_written += bytes;
+		}
+	}
+	ds_spill_token_release(s);
+
+	s->stats.write_ns += ds_metrics_clock() - start;
+	return nr;
+}
+
+static inline void ds_spill_account_replay(struct ds_spill *s, __u64 spill_ns)
+{
+	__u64 lat = ds_metrics_clock() - spill_ns;
+	__u32 b = lat ? 63 - (__u32)__builtin_clzll(lat) : 0;
+
+	s->stats.replayed++;
+	s->stats.replay_lat_sum_ns += lat;
+	if (lat > s->stats.replay_lat_max_ns)
+		s->stats.replay_lat_max_ns = lat;
+	s->stats.replay_hist[b < DS_SPILL_LAT_BUCKETS ? b : DS_SPILL_LAT_BUCKETS - 1]++;
+}
+
+/* Consumer: next spilled entry, if any has been committed */
+static inline bool ds_spill_replay_next(struct ds_spill *s, struct ds_kv *out)
+{
+	for (;;) {
+		struct ds_spill_segment *seg = ds_spill_seg(s, s->r_seq);
+		struct ds_spill_batch_hdr *hdr;
+
+		if (s->r_batch) {
+			hdr = (struct ds_spill_batch_hdr *)(seg->map + s->r_batch);
+			if (s->r_idx < hdr->nr) {
+				*out = ((struct ds_kv *)(hdr + 1))[s->r_idx++];
+				ds_spill_account_replay(s, hdr->spill_ns);
+				return true;
+			}
+			s->r_batch = 0;
+		}
+
+		if (s->r_off >= atomic_load_explicit(&seg->committed, memory_order_acquire))
+			return false;
+
+		hdr = (struct ds_spill_batch_hdr *)(seg->map + s->r_off);
+		if (hdr->magic == DS_SPILL_MAGIC_END) {
+			/* Fully replayed: drop the file and move on */
+			ds_spill_seg_close(s, s->r_seq, true);
+			s->r_seq++;
+			s->r_off = DS_SPILL_ALIGN;
+			atomic_store_explicit(&s->r_seq_pub, s->r_seq, memory_order_release);
+			continue;
+		}
+		if (hdr->magic != DS_SPILL_MAGIC_BATCH || !hdr->bytes) {
+			s->stats.errors++;
+			return false;
+		}
+
+		s->r_batch = s->r_off;
+		s->r_idx = 0;
+		s->r_off += hdr->bytes;
+	}
+}
+
+/**
+ * ds_spill_pop - Consumer pop: spilled entries first, then the lane
+ * @s: Spill state
+ * @out: Entry
+ *
+ * Single consumer thread. Entries come out in lane order.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_NOT_FOUND if nothing is available now
+ */
+static inline int ds_spill_pop(struct ds_spill *s, struct ds_kv *out)
+{
+	int ret;
+
+	if (ds_spill_replay_next(s, out))
+		return DS_SUCCESS;
+
+	if (!ds_spill_token_try(s))
+		return DS_ERROR_NOT_FOUND;
+
+	/* The spill thread may have appended between the check and the token */
+	if (ds_spill_replay_next(s, out)) {
+		ds_spill_token_release(s);
+		return DS_SUCCESS;
+	}
+
+	ret = s->pop(s->lane, out);
+	ds_spill_token_release(s);
+	if (ret == DS_SUCCESS)
+		s->stats.direct++;
+	return ret;
+}
+
+/* Entries spilled but not yet replayed (approximate while running) */
+static inline __u64 ds_spill_backlog(struct ds_spill *s)
+{
+	return s->stats.spilled - s->stats.replayed;
+}
+
+/* Spill bandwidth in MB/s over the time spent writing */
+static inline double ds_spill_bandwidth_mbps(const struct ds_spill_stats *st)
+{
+	return st->write_ns ? (double)st->bytes_written * 1e3 / (double)st->write_ns : 0.0;
+}
+
+/* Upper bound of the bucket holding the @pct percentile of replay latency */
+static inline __u64 ds_spill_replay_percentile_ns(const struct ds_spill_stats *st,
+						  unsigned int pct)
+{
+	__u64 rank = (st->replayed * pct + 99) / 100, seen = 0;
+
+	if (!st->replayed)
+		return 0;
+	for (__u32 b = 0; b < DS_SPILL_LAT_BUCKETS; b++) {
+		seen += st->replay_hist[b];
+		if (seen >= rank)
+			return (2ull << b) - 1 < st->replay_lat_max_ns ? (2ull << b) - 1 :
+									  st->replay_lat_max_ns;
+	}
+	return st->replay_lat_max_ns;
+}
+
+static inline void ds_spill_print(struct ds_spill *s)
+{
+	const struct ds_spill_stats *st = &s->stats;
+
+	printf("Spill: episodes=%llu spilled=%llu replayed=%llu direct=%llu errors=%llu\n",
+	       (unsigned long long)st->spill_episodes, (unsigned long long)st->spilled,
+	       (unsigned long long)st->replayed, (unsigned long long)st->direct,
+	       (unsigned long long)st->errors);
+	printf("  write: %llu batches, %.1f MB in %llu segments, %.1f MB/s%s\n",
+	       (unsigned long long)st->batches, (double)st->bytes_written / 1e6,
+	       (unsigned long long)st->segments, ds_spill_bandwidth_mbps(st),
+	       s->flags & DS_SPILL_F_DIRECT ? " (O_DIRECT)" : "");
+	printf("  replay latency: avg %.1f us, p99 <= %.1f us, max %.1f us\n",
+	       st->replayed ? (double)st->replay_lat_sum_ns / (double)st->replayed / 1e3 : 0.0,
+	       (double)ds_spill_replay_percentile_ns(st, 99) / 1e3,
+	       (double)st->replay_lat_max_ns / 1e3);
+}
+
+/**
+ * ds_spill_destroy - Unmap and remove every segment
+ * @s: Spill state (both threads stopped)
+ *
+ * Entries not yet replayed are discarded with their files.
+ */
+static inline void ds_spill_destroy(struct ds_spill *s)
+{
+	__u32 w = atomic_load(&s->w_seq);
+
+	for (__u32 seq = s->r_seq; seq <= w; seq++)
+		ds_spill_seg_close(s, seq, true);
+	free(s->stage);
+	s->stage = NULL;
+}
+
+static inline const struct ds_metadata *ds_spill_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "spill",
+		.description = "Append-only mmap segment spill and in-order replay for KU lanes",
+		.node_size = sizeof(struct ds_kv),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_SPILL_H */
@@ -0,0 +1,1057 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Hierarchical Timer Wheel for BPF Arena
+ *
+ * Schedules (key, value) events for delivery at a deadline and emits them
+ * into a Vyukhov lane when they expire, e.g. a follow-up check N ms after
+ * an inode_create event.
+ *
+ * Layout: DS_TIMER_WHEEL_LEVELS levels of DS_TIMER_WHEEL_SLOTS slots. A
+ * level-L slot covers 64^L ticks; a timer lives at the lowest level whose
+ * span reaches its deadline and is cascaded one level down when the wheel
+ * reaches the start of that slot. Every operation is O(1) per timer:
+ *
+ *   schedule (any CPU/thread): one CAS push onto the incoming list
+ *   cancel   (any CPU/thread): one CAS on the timer's state word
+ *   advance  (single advancer: BPF timer callback or userspace tick):
+ *            drain incoming into slots, cascade, expire level-0 slot
+ *   reclaim  (sleepable BPF or userspace): free dead timers
+ *
+ * Slots are private to the advancer, so they are plain singly linked
+ * lists. Producers never touch slots: they push onto an MPSC stack that
+ * the advancer takes whole with one exchange, which is ABA-safe. Cancel is
+ * lazy: the timer is marked and freed when the advancer next sees it.
+ *
+ * The state word packs a per-timer id with the state, so a cancel through
+ * a stale handle (the timer already fired and its memory was reused)
+ * fails its CAS instead of cancelling an unrelated timer.
+ *
+ * bpf_arena_free() may release pages and is only allowed in sleepable
+ * programs, while bpf_timer callbacks are not sleepable. The advancer
+ * therefore never frees: dead timers go onto a reclaim stack that a
+ * sleepable program (or userspace) drains with ds_timer_wheel_reclaim().
+ * A push that gives up is counted in reclaim_busy and retried on the
+ * next advance.
+ */
+#ifndef DS_TIMER_WHEEL_H
+#define DS_TIMER_WHEEL_H
+
+#pragma once
+
+#include "ds_api.h"
+#include "ds_vyukhov.h"
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+#define DS_TIMER_WHEEL_LEVELS 4
+#define DS_TIMER_WHEEL_SLOT_BITS 6
+#define DS_TIMER_WHEEL_SLOTS (1U << DS_TIMER_WHEEL_SLOT_BITS)
+#define DS_TIMER_WHEEL_SLOT_MASK (DS_TIMER_WHEEL_SLOTS - 1)
+
+/* Longest delay the wheel can place directly (ticks); longer ones re-cascade */
+#define DS_TIMER_WHEEL_MAX_DELTA \
+	((1ULL << (DS_TIMER_WHEEL_LEVELS * DS_TIMER_WHEEL_SLOT_BITS)) - 1)
+
+/* Ticks processed per advance call; a late wheel catches up over calls */
+#define DS_TIMER_WHEEL_TICK_BUDGET 1024
+
+/* Bound on CAS retries when pushing onto a shared list */
+#define DS_TIMER_WHEEL_PUSH_RETRIES 64
+
+/* Timer states (low 2 bits of the state word; the id sits above) */
+#define DS_TIMER_PENDING   1
+#define DS_TIMER_CANCELLED 2
+#define DS_TIMER_FIRED     3
+#define DS_TIMER_STATE_BITS 2
+#define DS_TIMER_STATE_MASK ((1ULL << DS_TIMER_STATE_BITS) - 1)
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+struct ds_timer_wheel_timer;
+
+typedef struct ds_timer_wheel_timer __arena ds_timer_wheel_timer_t;
+
+/**
+ * struct ds_timer_wheel_timer - One scheduled event
+ * @next: Link in the incoming, slot, backlog or reclaim list
+ * @expires: Absolute deadline in wheel ticks
+ * @state: (id << DS_TIMER_STATE_BITS) | DS_TIMER_*
+ * @data: Payload emitted into the lane on expiry
+ */
+struct ds_timer_wheel_timer {
+	ds_timer_wheel_timer_t *next;
+	__u64 expires;
+	__u64 state;
+	struct ds_kv data;
+};
+
+/**
+ * struct ds_timer_wheel_handle - Caller-side reference used to cancel
+ */
+struct ds_timer_wheel_handle {
+	ds_timer_wheel_timer_t *timer;
+	__u64 id;
+};
+
+/**
+ * struct ds_timer_wheel - Wheel control block
+ * @tick_ns: Tick length
+ * @base_ns: Clock value of tick 0
+ * @cur: Next tick to process (advancer-owned)
+ * @incoming: MPSC stack of newly scheduled timers
+ * @reclaim: Fired/cancelled timers waiting for ds_timer_wheel_reclaim()
+ * @backlog: Expired timers the lane had no room for (advancer-owned)
+ * @dead: Dead timers whose reclaim push gave up (advancer-owned)
+ * @next_id: Timer id allocator
+ * @scheduled: Timers scheduled
+ * @cancelled: Successful cancels
+ * @fired: Timers that expired and were handed to the lane
+ * @lane_full: Emits deferred because the lane was full
+ * @freed: Timers returned to the allocator
+ * @reclaim_busy: Reclaim pushes that gave up and parked on @dead
+ * @slots: Per-level slot list heads (advancer-owned)
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
+ */
+struct ds_timer_wheel {
+	__u64 tick_ns;
+	__u64 base_ns;
+	__u64 cur;
+	ds_timer_wheel_timer_t *incoming;
+	ds_timer_wheel_timer_t *reclaim;
+	ds_timer_wheel_timer_t *backlog;
+	ds_timer_wheel_timer_t *dead;
+	__u64 next_id;
+	__u64 scheduled;
+	__u64 cancelled;
+	__u64 fired;
+	__u64 lane_full;
+	__u64 freed;
+	__u64 reclaim_busy;
+	ds_timer_wheel_timer_t *slots[DS_TIMER_WHEEL_LEVELS][DS_TIMER_WHEEL_SLOTS];
+	DS_OP_STATS_FIELD
+};
+
+/* ========================================================================
+ * HELPERS
+ * ======================================================================== */
+
+/* Deadline in ns -> first tick at or after it */
+static inline __u64 ds_timer_wheel_ns_to_tick(struct ds_timer_wheel __arena *wheel, __u64 ns)
+{
+	if (ns <= wheel->base_ns)
+		return 0;
+	return (ns - wheel->base_ns + wheel->tick_ns - 1) / wheel->tick_ns;
+}
+
+/* Clock value -> last tick that has fully started (floor); 0 before base */
+static inline __u64 ds_timer_wheel_now_tick(struct ds_timer_wheel __arena *wheel, __u64 ns)
+{
+	if (ns <= wheel->base_ns)
+		return 0;
+	return (ns - wheel->base_ns) / wheel->tick_ns;
+}
+
+/*
+ * Choose the slot for @t relative to tick @cur. Level L is the lowest one
+ * with (expires - cur) < 64^(L+1); its slot index is (expires >> 6L) & 63,
+ * which the advancer cascades exactly at tick (expires >> 6L) << 6L.
+ * Advancer-only.
+ */
+static inline ds_timer_wheel_timer_t * __arena *
+ds_timer_wheel_slot_for(struct ds_timer_wheel __arena *wheel, __u64 cur, __u64 expires)
+{
+	__u64 delta;
+	__u32 level = 0;
+
+	if (expires < cur)
+		expires = cur;
+	delta = expires - cur;
+	if (delta > DS_TIMER_WHEEL_MAX_DELTA) {
+		expires = cur + DS_TIMER_WHEEL_MAX_DELTA;
+		delta = DS_TIMER_WHEEL_MAX_DELTA;
+	}
+
+	while (level < DS_TIMER_WHEEL_LEVELS - 1 &&
+	       (delta >> ((level + 1) * DS_TIMER_WHEEL_SLOT_BITS)) != 0)
+		level++;
+
+	return &wheel->slots[level][(expires >> (level * DS_TIMER_WHEEL_SLOT_BITS)) &
+				    DS_TIMER_WHEEL_SLOT_MASK];
+}
+
+/* ========================================================================
+ * INIT
+ * ======================================================================== */
+
+/**
+ * ds_timer_wheel_init_lkmm - Initialize an empty wheel
+ * @wheel: Wheel to initialize
+ * @tick_ns: Tick length in ns (> 0)
+ * @now_ns: Current clock value; becomes tick 0
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_INVALID
+ */
+static inline int __ds_timer_wheel_init_lkmm(struct ds_timer_wheel __arena *wheel,
+					     __u64 tick_ns, __u64 now_ns)
+{
+	cast_kern(wheel);
+	if (!wheel || !tick_ns)
+		return DS_ERROR_INVALID;
+
+	wheel->tick_ns = tick_ns;
+	wheel->base_ns = now_ns;
+	wheel->cur = 0;
+	wheel->next_id = 0;
+	wheel->scheduled = 0;
+	wheel->cancelled = 0;
+	wheel->fired = 0;
+	wheel->lane_full = 0;
+	wheel->freed = 0;
+	wheel->reclaim_busy = 0;
+	wheel->backlog = NULL;
+	wheel->dead = NULL;
+	wheel->reclaim = NULL;
+
+	for (__u32 l = 0; l < DS_TIMER_WHEEL_LEVELS && can_loop; l++)
+		for (__u32 s = 0; s < DS_TIMER_WHEEL_SLOTS && can_loop; s++)
+			wheel->slots[l][s] = NULL;
+
+	smp_store_release(&wheel->incoming, NULL);
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_init_lkmm(struct ds_timer_wheel __arena *wheel,
+					   __u64 tick_ns, __u64 now_ns)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_INIT,
+			       __ds_timer_wheel_init_lkmm(wheel, tick_ns, now_ns));
+}
+
+#ifndef __BPF__
+static inline int __ds_timer_wheel_init_c(struct ds_timer_wheel __arena *wheel,
+					  __u64 tick_ns, __u64 now_ns)
+{
+	if (!wheel || !tick_ns)
+		return DS_ERROR_INVALID;
+
+	wheel->tick_ns = tick_ns;
+	wheel->base_ns = now_ns;
+	wheel->cur = 0;
+	wheel->next_id = 0;
+	wheel->scheduled = 0;
+	wheel->cancelled = 0;
+	wheel->fired = 0;
+	wheel->lane_full = 0;
+	wheel->freed = 0;
+	wheel->reclaim_busy = 0;
+	wheel->backlog = NULL;
+	wheel->dead = NULL;
+	wheel->reclaim = NULL;
+
+	for (__u32 l = 0; l < DS_TIMER_WHEEL_LEVELS; l++)
+		for (__u32 s = 0; s < DS_TIMER_WHEEL_SLOTS; s++)
+			wheel->slots[l][s] = NULL;
+
+	arena_atomic_store(&wheel->incoming, NULL, ARENA_RELEASE);
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_init_c(struct ds_timer_wheel __arena *wheel,
+					__u64 tick_ns, __u64 now_ns)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_INIT, __ds_timer_wheel_init_c(wheel, tick_ns, now_ns));
+}
+#endif
+
+static inline int ds_timer_wheel_init(struct ds_timer_wheel __arena *wheel,
+				      __u64 tick_ns, __u64 now_ns)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_init_lkmm(wheel, tick_ns, now_ns);
+#else
+	return ds_timer_wheel_init_c(wheel, tick_ns, now_ns);
+#endif
+}
+
+/* ========================================================================
+ * SHARED LIST PUSH (MPSC stack, consumer takes all with exchange)
+ * ======================================================================== */
+
+static inline int ds_timer_wheel_push_lkmm(ds_timer_wheel_timer_t * __arena *list,
+					   ds_timer_wheel_timer_t *t)
+{
+	for (int i = 0; i < DS_TIMER_WHEEL_PUSH_RETRIES && can_loop; i++) {
+		ds_timer_wheel_timer_t *old = READ_ONCE(*list);
+
+		WRITE_ONCE(t->next, old);
+		if (arena_atomic_cmpxchg(list, old, t, ARENA_RELEASE, ARENA_RELAXED) == old)
+			return DS_SUCCESS;
+	}
+	return DS_ERROR_BUSY;
+}
+
+#ifndef __BPF__
+static inline int ds_timer_wheel_push_c(ds_timer_wheel_timer_t * __arena *list,
+					ds_timer_wheel_timer_t *t)
+{
+	for (int i = 0; i < DS_TIMER_WHEEL_PUSH_RETRIES; i++) {
+		ds_timer_wheel_timer_t *old = arena_atomic_load(list, ARENA_RELAXED);
+
+		arena_atomic_store(&t->next, old, ARENA_RELAXED);
+		if (arena_atomic_cmpxchg(list, old, t, ARENA_RELEASE, ARENA_RELAXED) == old)
+			return DS_SUCCESS;
+	}
+	return DS_ERROR_BUSY;
+}
+#endif
+
+/*
+ * Hand a dead timer to reclaim (advancer-only). A push that keeps losing
+ * to reclaimers parks the timer on @dead; the next advance retries it, so
+ * nothing leaks.
+ */
+static inline void ds_timer_wheel_retire_lkmm(struct ds_timer_wheel __arena *wheel,
+					      ds_timer_wheel_timer_t *t)
+{
+	if (ds_timer_wheel_push_lkmm(&wheel->reclaim, t) == DS_SUCCESS)
+		return;
+	wheel->reclaim_busy++;
+	cast_kern(t);
+	t->next = wheel->dead;
+	wheel->dead = t;
+}
+
+#ifndef __BPF__
+static inline void ds_timer_wheel_retire_c(struct ds_timer_wheel __arena *wheel,
+					   ds_timer_wheel_timer_t *t)
+{
+	if (ds_timer_wheel_push_c(&wheel->reclaim, t) == DS_SUCCESS)
+		return;
+	arena_atomic_store(&wheel->reclaim_busy, wheel->reclaim_busy + 1, ARENA_RELAXED);
+	t->next = wheel->dead;
+	wheel->dead = t;
+}
+#endif
+
+/* ========================================================================
+ * SCHEDULE / CANCEL (any context)
+ * ======================================================================== */
+
+/**
+ * ds_timer_wheel_schedule_lkmm - Schedule an event
+ * @wheel: Wheel
+ * @expires_ns: Absolute deadline on the wheel's clock
+ * @key: Payload key emitted on expiry
+ * @value: Payload value emitted on expiry
+ * @handle: Output for ds_timer_wheel_cancel(); may be NULL
+ *
+ * Allocates, so must run in a sleepable program or userspace. Deadlines
+ * already in the past fire on the next advance.
+ *
+ * Returns: DS_SUCCESS, DS_ERROR_NOMEM, DS_ERROR_BUSY (push contention),
+ *          DS_ERROR_INVALID
+ */
+static inline int __ds_timer_wheel_schedule_lkmm(struct ds_timer_wheel __arena *wheel,
+						 __u64 expires_ns, __u64 key, __u64 value,
+						 struct ds_timer_wheel_handle *handle)
+{
+	ds_timer_wheel_timer_t *t;
+	__u64 id;
+
+	if (!wheel || !wheel->tick_ns)
+		return DS_ERROR_INVALID;
+
+	t = bpf_arena_alloc(sizeof(*t));
+	if (!t)
+		return DS_ERROR_NOMEM;
+
+	id = arena_atomic_add(&wheel->next_id, 1, ARENA_RELAXED) + 1;
+
+	cast_kern(t);
+	t->expires = ds_timer_wheel_ns_to_tick(wheel, expires_ns);
+	t->state = (id << DS_TIMER_STATE_BITS) | DS_TIMER_PENDING;
+	t->data.key = key;
+	t->data.value = value;
+	cast_user(t);
+
+	if (ds_timer_wheel_push_lkmm(&wheel->incoming, t) != DS_SUCCESS) {
+		bpf_arena_free(t);
+		return DS_ERROR_BUSY;
+	}
+
+	arena_atomic_inc(&wheel->scheduled);
+	if (handle) {
+		handle->timer = t;
+		handle->id = id;
+	}
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_schedule_lkmm(struct ds_timer_wheel __arena *wheel,
+					       __u64 expires_ns, __u64 key, __u64 value,
+					       struct ds_timer_wheel_handle *handle)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_INSERT,
+			       __ds_timer_wheel_schedule_lkmm(wheel, expires_ns, key, value, handle));
+}
+
+#ifndef __BPF__
+static inline int __ds_timer_wheel_schedule_c(struct ds_timer_wheel __arena *wheel,
+					      __u64 expires_ns, __u64 key, __u64 value,
+					      struct ds_timer_wheel_handle *handle)
+{
+	ds_timer_wheel_timer_t *t;
+	__u64 id;
+
+	if (!wheel || !wheel->tick_ns)
+		return DS_ERROR_INVALID;
+
+	t = bpf_arena_alloc(sizeof(*t));
+	if (!t)
+		return DS_ERROR_NOMEM;
+
+	id = arena_atomic_add(&wheel->next_id, 1, ARENA_RELAXED) + 1;
+
+	t->expires = ds_timer_wheel_ns_to_tick(wheel, expires_ns);
+	t->state = (id << DS_TIMER_STATE_BITS) | DS_TIMER_PENDING;
+	t->data.key = key;
+	t->data.value = value;
+
+	if (ds_timer_wheel_push_c(&wheel->incoming, t) != DS_SUCCESS) {
+		bpf_arena_free(t);
+		return DS_ERROR_BUSY;
+	}
+
+	arena_atomic_inc(&wheel->scheduled);
+	if (handle) {
+		handle->timer = t;
+		handle->id = id;
+	}
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_schedule_c(struct ds_timer_wheel __arena *wheel,
+					    __u64 expires_ns, __u64 key, __u64 value,
+					    struct ds_timer_wheel_handle *handle)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_INSERT,
+			       __ds_timer_wheel_schedule_c(wheel, expires_ns, key, value, handle));
+}
+#endif
+
+static inline int ds_timer_wheel_schedule(struct ds_timer_wheel __arena *wheel,
+					  __u64 expires_ns, __u64 key, __u64 value,
+					  struct ds_timer_wheel_handle *handle)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_schedule_lkmm(wheel, expires_ns, key, value, handle);
+#else
+	return ds_timer_wheel_schedule_c(wheel, expires_ns, key, value, handle);
+#endif
+}
+
+/**
+ * ds_timer_wheel_cancel_lkmm - Cancel a pending event
+ * @wheel: Wheel
+ * @handle: Handle filled in by ds_timer_wheel_schedule()
+ *
+ * One CAS; the timer is unlinked and freed later by the advancer and
+ * reclaim. Races with expiry are decided by the same state word, so an
+ * event is either cancelled or emitted, never both.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_NOT_FOUND if it already fired, was
+ *          already cancelled, or the handle is stale
+ */
+static inline int __ds_timer_wheel_cancel_lkmm(struct ds_timer_wheel __arena *wheel,
+					       struct ds_timer_wheel_handle *handle)
+{
+	ds_timer_wheel_timer_t *t;
+	__u64 pending, cancelled;
+
+	if (!wheel || !handle || !handle->timer)
+		return DS_ERROR_INVALID;
+
+	t = handle->timer;
+	cast_kern(t);
+	pending = (handle->id << DS_TIMER_STATE_BITS) | DS_TIMER_PENDING;
+	cancelled = (handle->id << DS_TIMER_STATE_BITS) | DS_TIMER_CANCELLED;
+
+	if (arena_atomic_cmpxchg(&t->state, pending, cancelled,
+				 ARENA_RELAXED, ARENA_RELAXED) != pending)
+		return DS_ERROR_NOT_FOUND;
+
+	arena_atomic_inc(&wheel->cancelled);
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_cancel_lkmm(struct ds_timer_wheel __arena *wheel,
+					     struct ds_timer_wheel_handle *handle)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_DELETE, __ds_timer_wheel_cancel_lkmm(wheel, handle));
+}
+
+#ifndef __BPF__
+static inline int __ds_timer_wheel_cancel_c(struct ds_timer_wheel __arena *wheel,
+					    struct ds_timer_wheel_handle *handle)
+{
+	__u64 pending, cancelled;
+
+	if (!wheel || !handle || !handle->timer)
+		return DS_ERROR_INVALID;
+
+	pending = (handle->id << DS_TIMER_STATE_BITS) | DS_TIMER_PENDING;
+	cancelled = (handle->id << DS_TIMER_STATE_BITS) | DS_TIMER_CANCELLED;
+
+	if (arena_atomic_cmpxchg(&handle->timer->state, pending, cancelled,
+				 ARENA_RELAXED, ARENA_RELAXED) != pending)
+		return DS_ERROR_NOT_FOUND;
+
+	arena_atomic_inc(&wheel->cancelled);
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_cancel_c(struct ds_timer_wheel __arena *wheel,
+					  struct ds_timer_wheel_handle *handle)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_DELETE, __ds_timer_wheel_cancel_c(wheel, handle));
+}
+#endif
+
+static inline int ds_timer_wheel_cancel(struct ds_timer_wheel __arena *wheel,
+					struct ds_timer_wheel_handle *handle)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_cancel_lkmm(wheel, handle);
+#else
+	return ds_timer_wheel_cancel_c(wheel, handle);
+#endif
+}
+
+/* ========================================================================
+ * ADVANCE (single advancer)
+ * ======================================================================== */
+
+/*
+ * Expire one timer: claim it with PENDING -> FIRED (losing to a cancel
+ * sends it to reclaim), then hand the payload to the lane. A full lane
+ * parks the timer on the backlog for the next advance.
+ * Returns 1 if the payload reached the lane.
+ */
+static inline int ds_timer_wheel_fire_lkmm(struct ds_timer_wheel __arena *wheel,
+					   struct ds_vyukhov_head __arena *lane,
+					   ds_timer_wheel_timer_t *t)
+{
+	__u64 state = READ_ONCE(t->state);
+
+	if ((state & DS_TIMER_STATE_MASK) == DS_TIMER_PENDING) {
+		__u64 fired = (state & ~DS_TIMER_STATE_MASK) | DS_TIMER_FIRED;
+
+		if (arena_atomic_cmpxchg(&t->state, state, fired,
+					 ARENA_RELAXED, ARENA_RELAXED) == state)
+			state = fired;
+		else
+			state = READ_ONCE(t->state);
+	}
+
+	if ((state & DS_TIMER_STATE_MASK) != DS_TIMER_FIRED) {
+		ds_timer_wheel_retire_lkmm(wheel, t);
+		return 0;
+	}
+
+	if (lane && ds_vyukhov_insert_lkmm(lane, t->data.key, t->data.value) != DS_SUCCESS) {
+		wheel->lane_full++;
+		t->next = wheel->backlog;
+		wheel->backlog = t;
+		return 0;
+	}
+
+	wheel->fired++;
+	ds_timer_wheel_retire_lkmm(wheel, t);
+	return 1;
+}
+
+/* Re-place a detached list relative to @cur; cancelled timers are dropped */
+static inline void ds_timer_wheel_place_list_lkmm(struct ds_timer_wheel __arena *wheel,
+						  ds_timer_wheel_timer_t *t, __u64 cur)
+{
+	while (t && can_loop) {
+		ds_timer_wheel_timer_t *next;
+		ds_timer_wheel_timer_t * __arena *slot;
+
+		cast_kern(t);
+		next = t->next;
+		if ((READ_ONCE(t->state) & DS_TIMER_STATE_MASK) == DS_TIMER_CANCELLED) {
+			ds_timer_wheel_retire_lkmm(wheel, t);
+		} else {
+			slot = ds_timer_wheel_slot_for(wheel, cur, t->expires);
+			t->next = *slot;
+			*slot = t;
+		}
+		t = next;
+	}
+}
+
+/**
+ * ds_timer_wheel_advance_lkmm - Move the wheel up to @now_ns
+ * @wheel: Wheel
+ * @now_ns: Current time on the wheel's clock
+ * @lane: Vyukhov lane that receives expired payloads; NULL only counts
+ *
+ * Processes at most DS_TIMER_WHEEL_TICK_BUDGET ticks. Does not allocate
+ * or free, so it may run from a bpf_timer callback.
+ *
+ * Returns: Number of payloads emitted into @lane
+ */
+static inline __u64 __ds_timer_wheel_advance_lkmm(struct ds_timer_wheel __arena *wheel,
+						  __u64 now_ns,
+						  struct ds_vyukhov_head __arena *lane)
+{
+	ds_timer_wheel_timer_t *list;
+	__u64 now_tick, emitted = 0;
+	__u32 ticks = 0;
+
+	if (!wheel || !wheel->tick_ns)
+		return 0;
+
+	/* Retry reclaim pushes that gave up last time */
+	list = wheel->dead;
+	wheel->dead = NULL;
+	while (list && can_loop) {
+		ds_timer_wheel_timer_t *next;
+
+		cast_kern(list);
+		next = list->next;
+		ds_timer_wheel_retire_lkmm(wheel, list);
+		list = next;
+	}
+
+	/* Retry payloads the lane had no room for last time */
+	list = wheel->backlog;
+	wheel->backlog = NULL;
+	while (list && can_loop) {
+		ds_timer_wheel_timer_t *next;
+
+		cast_kern(list);
+		next = list->next;
+		if (lane && ds_vyukhov_insert_lkmm(lane, list->data.key, list->data.value) != DS_SUCCESS) {
+			list->next = wheel->backlog;
+			wheel->backlog = list;
+		} else {
+			wheel->fired++;
+			emitted++;
+			ds_timer_wheel_retire_lkmm(wheel, list);
+		}
+		list = next;
+	}
+
+	/* Take everything scheduled since the last advance */
+	list = arena_atomic_exchange(&wheel->incoming, NULL, ARENA_ACQUIRE);
+	ds_timer_wheel_place_list_lkmm(wheel, list, wheel->cur);
+
+	now_tick = ds_timer_wheel_now_tick(wheel, now_ns);
+	while (wheel->cur <= now_tick && ticks < DS_TIMER_WHEEL_TICK_BUDGET && can_loop) {
+		__u64 cur = wheel->cur;
+
+		/* Cascade from the top so timers can fall several levels at once */
+		for (int l = DS_TIMER_WHEEL_LEVELS - 1; l >= 1 && can_loop; l--) {
+			__u32 shift = l * DS_TIMER_WHEEL_SLOT_BITS;
+			ds_timer_wheel_timer_t * __arena *slot;
+
+			if (cur & ((1ULL << shift) - 1))
+				continue;
+			slot = &wheel->slots[l][(cur >> shift) & DS_TIMER_WHEEL_SLOT_MASK];
+			list = *slot;
+			*slot = NULL;
+			ds_timer_wheel_place_list_lkmm(wheel, list, cur);
+		}
+
+		list = wheel->slots[0][cur & DS_TIMER_WHEEL_SLOT_MASK];
+		wheel->slots[0][cur & DS_TIMER_WHEEL_SLOT_MASK] = NULL;
+		while (list && can_loop) {
+			ds_timer_wheel_timer_t *next;
+
+			cast_kern(list);
+			next = list->next;
+			if (list->expires > cur) {
+				/* Clamped long delay: go round again */
+				ds_timer_wheel_timer_t * __arena *slot =
+					ds_timer_wheel_slot_for(wheel, cur + 1, list->expires);
+
+				list->next = *slot;
+				*slot = list;
+			} else {
+				emitted += ds_timer_wheel_fire_lkmm(wheel, lane, list);
+			}
+			list = next;
+		}
+
+		WRITE_ONCE(wheel->cur, cur + 1);
+		ticks++;
+	}
+
+	return emitted;
+}
+
+static inline __u64 ds_timer_wheel_advance_lkmm(struct ds_timer_wheel __arena *wheel,
+						__u64 now_ns,
+						struct ds_vyukhov_head __arena *lane)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_POP,
+			       __ds_timer_wheel_advance_lkmm(wheel, now_ns, lane));
+}
+
+#ifndef __BPF__
+static inline int ds_timer_wheel_fire_c(struct ds_timer_wheel __arena *wheel,
+					struct ds_vyukhov_head __arena *lane,
+					ds_timer_wheel_timer_t *t)
+{
+	__u64 state = arena_atomic_load(&t->state, ARENA_RELAXED);
+
+	if ((state & DS_TIMER_STATE_MASK) == DS_TIMER_PENDING) {
+		__u64 fired = (state & ~DS_TIMER_STATE_MASK) | DS_TIMER_FIRED;
+
+		if (arena_atomic_cmpxchg(&t->state, state, fired,
+					 ARENA_RELAXED, ARENA_RELAXED) == state)
+			state = fired;
+		else
+			state = arena_atomic_load(&t->state, ARENA_RELAXED);
+	}
+
+	if ((state & DS_TIMER_STATE_MASK) != DS_TIMER_FIRED) {
+		ds_timer_wheel_retire_c(wheel, t);
+		return 0;
+	}
+
+	if (lane && ds_vyukhov_insert_c(lane, t->data.key, t->data.value) != DS_SUCCESS) {
+		wheel->lane_full++;
+		t->next = wheel->backlog;
+		wheel->backlog = t;
+		return 0;
+	}
+
+	arena_atomic_store(&wheel->fired, wheel->fired + 1, ARENA_RELAXED);
+	ds_timer_wheel_retire_c(wheel, t);
+	return 1;
+}
+
+static inline void ds_timer_wheel_place_list_c(struct ds_timer_wheel __arena *wheel,
+					       ds_timer_wheel_timer_t *t, __u64 cur)
+{
+	while (t) {
+		ds_timer_wheel_timer_t *next = t->next;
+		ds_timer_wheel_timer_t * __arena *slot;
+
+		if ((arena_atomic_load(&t->state, ARENA_RELAXED) & DS_TIMER_STATE_MASK) ==
+		    DS_TIMER_CANCELLED) {
+			ds_timer_wheel_retire_c(wheel, t);
+		} else {
+			slot = ds_timer_wheel_slot_for(wheel, cur, t->expires);
+			t->next = *slot;
+			*slot = t;
+		}
+		t = next;
+	}
+}
+
+static inline __u64 __ds_timer_wheel_advance_c(struct ds_timer_wheel __arena *wheel,
+					       __u64 now_ns,
+					       struct ds_vyukhov_head __arena *lane)
+{
+	ds_timer_wheel_timer_t *list;
+	__u64 now_tick, emitted = 0;
+	__u32 ticks = 0;
+
+	if (!wheel || !wheel->tick_ns)
+		return 0;
+
+	list = wheel->dead;
+	wheel->dead = NULL;
+	while (list) {
+		ds_timer_wheel_timer_t *next = list->next;
+
+		ds_timer_wheel_retire_c(wheel, list);
+		list = next;
+	}
+
+	list = wheel->backlog;
+	wheel->backlog = NULL;
+	while (list) {
+		ds_timer_wheel_timer_t *next = list->next;
+
+		if (lane && ds_vyukhov_insert_c(lane, list->data.key, list->data.value) != DS_SUCCESS) {
+			list->next = wheel->backlog;
+			wheel->backlog = list;
+		} else {
+			arena_atomic_store(&wheel->fired, wheel->fired + 1, ARENA_RELAXED);
+			emitted++;
+			ds_timer_wheel_retire_c(wheel, list);
+		}
+		list = next;
+	}
+
+	list = arena_atomic_exchange(&wheel->incoming, NULL, ARENA_ACQUIRE);
+	ds_timer_wheel_place_list_c(wheel, list, wheel->cur);
+
+	now_tick = ds_timer_wheel_now_tick(wheel, now_ns);
+	while (wheel->cur <= now_tick && ticks < DS_TIMER_WHEEL_TICK_BUDGET) {
+		__u64 cur = wheel->cur;
+
+		for (int l = DS_TIMER_WHEEL_LEVELS - 1; l >= 1; l--) {
+			__u32 shift = l * DS_TIMER_WHEEL_SLOT_BITS;
+			ds_timer_wheel_timer_t * __arena *slot;
+
+			if (cur & ((1ULL << shift) - 1))
+				continue;
+			slot = &wheel->slots[l][(cur >> shift) & DS_TIMER_WHEEL_SLOT_MASK];
+			list = *slot;
+			*slot = NULL;
+			ds_timer_wheel_place_list_c(wheel, list, cur);
+		}
+
+		list = wheel->slots[0][cur & DS_TIMER_WHEEL_SLOT_MASK];
+		wheel->slots[0][cur & DS_TIMER_WHEEL_SLOT_MASK] = NULL;
+		while (list) {
+			ds_timer_wheel_timer_t *next = list->next;
+
+			if (list->expires > cur) {
+				ds_timer_wheel_timer_t * __arena *slot =
+					ds_timer_wheel_slot_for(wheel, cur + 1, list->expires);
+
+				list->next = *slot;
+				*slot = list;
+			} else {
+				emitted += ds_timer_wheel_fire_c(wheel, lane, list);
+			}
+			list = next;
+		}
+
+		arena_atomic_store(&wheel->cur, cur + 1, ARENA_RELAXED);
+		ticks++;
+	}
+
+	return emitted;
+}
+
+static inline __u64 ds_timer_wheel_advance_c(struct ds_timer_wheel __arena *wheel,
+					     __u64 now_ns,
+					     struct ds_vyukhov_head __arena *lane)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_POP, __ds_timer_wheel_advance_c(wheel, now_ns, lane));
+}
+#endif
+
+static inline __u64 ds_timer_wheel_advance(struct ds_timer_wheel __arena *wheel,
+					   __u64 now_ns,
+					   struct ds_vyukhov_head __arena *lane)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_advance_lkmm(wheel, now_ns, lane);
+#else
+	return ds_timer_wheel_advance_c(wheel, now_ns, lane);
+#endif
+}
+
+/* ========================================================================
+ * RECLAIM (sleepable BPF or userspace)
+ * ======================================================================== */
+
+/**
+ * ds_timer_wheel_reclaim_lkmm - Free fired and cancelled timers
+ * @wheel: Wheel
+ *
+ * Any number of reclaimers may run; each takes the whole list at once.
+ *
+ * Returns: Number of timers freed
+ */
+static inline __u64 __ds_timer_wheel_reclaim_lkmm(struct ds_timer_wheel __arena *wheel)
+{
+	ds_timer_wheel_timer_t *t;
+	__u64 n = 0;
+
+	if (!wheel)
+		return 0;
+
+	t = arena_atomic_exchange(&wheel->reclaim, NULL, ARENA_ACQUIRE);
+	while (t && can_loop) {
+		ds_timer_wheel_timer_t *next;
+
+		cast_kern(t);
+		next = t->next;
+		bpf_arena_free(t);
+		t = next;
+		n++;
+	}
+
+	if (n)
+		arena_atomic_add(&wheel->freed, n, ARENA_RELAXED);
+	return n;
+}
+
+static inline __u64 ds_timer_wheel_reclaim_lkmm(struct ds_timer_wheel __arena *wheel)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_ITERATE, __ds_timer_wheel_reclaim_lkmm(wheel));
+}
+
+#ifndef __BPF__
+static inline __u64 __ds_timer_wheel_reclaim_c(struct ds_timer_wheel __arena *wheel)
+{
+	ds_timer_wheel_timer_t *t;
+	__u64 n = 0;
+
+	if (!wheel)
+		return 0;
+
+	t = arena_atomic_exchange(&wheel->reclaim, NULL, ARENA_ACQUIRE);
+	while (t) {
+		ds_timer_wheel_timer_t *next = t->next;
+
+		bpf_arena_free(t);
+		t = next;
+		n++;
+	}
+
+	if (n)
+		arena_atomic_add(&wheel->freed, n, ARENA_RELAXED);
+	return n;
+}
+
+static inline __u64 ds_timer_wheel_reclaim_c(struct ds_timer_wheel __arena *wheel)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_ITERATE, __ds_timer_wheel_reclaim_c(wheel));
+}
+#endif
+
+static inline __u64 ds_timer_wheel_reclaim(struct ds_timer_wheel __arena *wheel)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_reclaim_lkmm(wheel);
+#else
+	return ds_timer_wheel_reclaim_c(wheel);
+#endif
+}
+
+/* ========================================================================
+ * VERIFY / METADATA
+ * ======================================================================== */
+
+#ifndef __BPF__
+/**
+ * ds_timer_wheel_verify_c - Check slot placement (advancer must be idle)
+ * @wheel: Wheel
+ *
+ * Every pending timer in a level-L slot must not be due before that slot
+ * is cascaded, and level-0 timers must sit in the slot of their deadline.
+ *
+ * Returns: DS_SUCCESS or DS_ERROR_CORRUPT
+ */
+static inline int __ds_timer_wheel_verify_c(struct ds_timer_wheel __arena *wheel)
+{
+	for (__u32 l = 0; l < DS_TIMER_WHEEL_LEVELS; l++) {
+		__u32 shift = l * DS_TIMER_WHEEL_SLOT_BITS;
+
+		for (__u32 s = 0; s < DS_TIMER_WHEEL_SLOTS; s++) {
+			for (ds_timer_wheel_timer_t *t = wheel->slots[l][s]; t; t = t->next) {
+				__u64 e = t->expires < wheel->cur ? wheel->cur : t->expires;
+
+				if (l == 0 && t->expires >= wheel->cur &&
+				    (e & DS_TIMER_WHEEL_SLOT_MASK) != s)
+					return DS_ERROR_CORRUPT;
+				/* Level L is cascaded at tick (e >> shift) << shift */
+				if (l > 0 && (t->expires >> shift) < (wheel->cur >> shift))
+					return DS_ERROR_CORRUPT;
+				if (l > 0 && (t->expires >> shift) == (wheel->cur >> shift) &&
+				    (wheel->cur & ((1ULL << shift) - 1)))
+					return DS_ERROR_CORRUPT;
+			}
+		}
+	}
+
+	return DS_SUCCESS;
+}
+
+static inline int ds_timer_wheel_verify_c(struct ds_timer_wheel __arena *wheel)
+{
+	return DS_OP_STATS_RUN(wheel, DS_OP_VERIFY, __ds_timer_wheel_verify_c(wheel));
+}
+#endif
+
+static inline const struct ds_metadata *ds_timer_wheel_get_metadata(void)
+{
+	static const struct ds_metadata metadata = {
+		.name = "timer_wheel",
+		.description = "Hierarchical timer wheel emitting expired events into a lane",
+		.node_size = sizeof(struct ds_timer_wheel_timer),
+		.requires_locking = 0,
+	};
+	return &metadata;
+}
+
+/**
+ * ds_timer_wheel_stats - Pending timers, timer memory and per-op counters
+ * @wheel: Wheel
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * current_elements is scheduled minus cancelled minus fired; memory_used
+ * covers every timer not yet freed by ds_timer_wheel_reclaim(). Advance
+ * counts as DS_OP_POP and reclaim as DS_OP_ITERATE.
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_timer_wheel_stats_lkmm(struct ds_timer_wheel __arena *wheel,
+					    struct ds_stats *stats)
+{
+	__u64 scheduled;
+
+	if (!wheel || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(wheel), stats);
+	cast_kern(wheel);
+	scheduled = READ_ONCE(wheel->scheduled);
+	stats->current_elements = scheduled - READ_ONCE(wheel->cancelled) - READ_ONCE(wheel->fired);
+	stats->max_elements = 0;
+	stats->memory_used = (scheduled - READ_ONCE(wheel->freed)) *
+			     sizeof(struct ds_timer_wheel_timer);
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_timer_wheel_stats_c(struct ds_timer_wheel __arena *wheel,
+					 struct ds_stats *stats)
+{
+	__u64 scheduled;
+
+	if (!wheel || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(wheel), stats);
+	scheduled = arena_atomic_load(&wheel->scheduled, ARENA_RELAXED);
+	stats->current_elements = scheduled - arena_atomic_load(&wheel->cancelled, ARENA_RELAXED) -
+				  arena_atomic_load(&wheel->fired, ARENA_RELAXED);
+	stats->max_elements = 0;
+	stats->memory_used = (scheduled - arena_atomic_load(&wheel->freed, ARENA_RELAXED)) *
+			     sizeof(struct ds_timer_wheel_timer);
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_timer_wheel_stats(struct ds_timer_wheel __arena *wheel,
+				       struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_timer_wheel_stats_lkmm(wheel, stats);
+#else
+	return ds_timer_wheel_stats_c(wheel, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_timer_wheel_reset_stats(struct ds_timer_wheel __arena *wheel)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(wheel));
+}
+
+#endif /* DS_TIMER_WHEEL_H */
@@ -0,0 +1,469 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Flight Recorder: Per-CPU / Per-Thread Operation Trace in the Arena
+ *
+ * ds_metrics keeps latency averages; a latency spike needs the
+ * interleaving that caused it. The flight recorder keeps the last
+ * DS_TRACE_SLOTS operations of every writer in overwriting rings:
+ *
+ *   - BPF programs write to the ring of the CPU they run on
+ *     (ds_trace_record_lkmm), userspace threads to a ring they register
+ *     once (ds_trace_register_c / ds_trace_record_c)
+ *   - each event is {start, duration, cpu, op, lane, result, retries}
+ *   - writers never wait: a slot is claimed by bumping the ring's head
+ *     on its own cache line (a plain store for a userspace ring its
+ *     thread owns, a fetch-add otherwise), old events are overwritten,
+ *     and a per-slot sequence lets the reader drop a slot that was
+ *     rewritten while it was being copied
+ *
+ * Retry counts come from the data structure itself: include this header
+ * before ds_vyukhov.h and its _lkmm and _c operations report how many
+ * CAS rounds they took through DS_TRACE_RETRIES(). Without it the hook
+ * compiles to nothing.
+ *
+ * Recording is off until userspace sets @enabled, so the cost when
+ * disabled is one load. When on, it reuses the timestamps the caller
+ * already took for ds_metrics (see DS_TRACE_RECORD_OP_C/_LKMM), so the
+ * added work is the slot claim and a 24-byte store; bench_trace checks
+ * it against a 20 ns budget.
+ *
+ * ds_trace_export_chrome_c() writes the rings as Chrome trace JSON
+ * ("X" events), which chrome://tracing and ui.perfetto.dev both open.
+ */
+#ifndef DS_TRACE_H
+#define DS_TRACE_H
+
+#pragma once
+
+#if defined(DS_VYUKHOV_H)
+#error "include ds_trace.h before the data structure headers it traces"
+#endif
+
+#include "ds_api.h"
+#include "ds_metrics.h"
+
+#ifndef __BPF__
+#include <stdio.h>
+#endif
+
+/* ========================================================================
+ * CONSTANTS
+ * ======================================================================== */
+
+/* Events kept per ring; power of 2 */
+#define DS_TRACE_SLOTS 512
+
+/* Kernel rings, one per CPU; CPUs beyond this share rings. Power of 2. */
+#define DS_TRACE_CPUS 16
+
+/* Userspace rings; threads beyond this share rings. Power of 2. */
+#define DS_TRACE_THREADS 16
+
+/* Set in a userspace ring index once more threads than rings registered */
+#define DS_TRACE_RING_SHARED (1U << 31)
+
+/* Lane ids are caller-defined; the exporter names up to this many */
+#define DS_TRACE_MAX_LANES 16
+
+/* ========================================================================
+ * DATA STRUCTURES
+ * ======================================================================== */
+
+/**
+ * struct ds_trace_event - One recorded operation (24 bytes)
+ * @start_ns: CLOCK_MONOTONIC at operation start (bpf_ktime_get_ns in BPF)
+ * @dur_ns: Operation duration, saturated at 4 s
+ * @seq: Low 32 bits of (ring position + 1); 0 while being written
+ * @cpu: CPU the operation ran on
+ * @op: enum ds_op_type
+ * @lane: Caller-defined lane id
+ * @result: DS_* result code
+ * @retries: CAS rounds the operation needed (0 if not reported)
+ */
+struct ds_trace_event {
+	__u64 start_ns;
+	__u32 dur_ns;
+	__u32 seq;
+	__u16 cpu;
+	__u8 op;
+	__u8 lane;
+	__s16 result;
+	__u16 retries;
+};
+
+/**
+ * struct ds_trace_ring - Overwriting event ring of one CPU or thread
+ * @head: Events ever claimed; the next slot is head & (SLOTS - 1)
+ */
+struct ds_trace_ring {
+	__u64 head;
+	__u64 pad[7];
+	struct ds_trace_event events[DS_TRACE_SLOTS];
+};
+
+/**
+ * struct ds_trace_store - All rings of one program (lives in the arena)
+ * @enabled: Non-zero while recording
+ * @nr_threads: Userspace rings handed out by ds_trace_register_c()
+ * @kern: Rings written by BPF programs, indexed by CPU
+ * @user: Rings written by userspace threads
+ */
+struct ds_trace_store {
+	__u32 enabled;
+	__u32 nr_threads;
+	__u64 pad[7];
+	struct ds_trace_ring kern[DS_TRACE_CPUS];
+	struct ds_trace_ring user[DS_TRACE_THREADS];
+};
+
+/* ========================================================================
+ * RETRY HOOK
+ * ======================================================================== */
+
+/*
+ * Retry counts not yet recorded, per CPU in BPF (programs run with
+ * migration disabled) and per thread in userspace. Added by the data
+ * structure, taken and cleared by the next record call. Sleepable
+ * programs can be preempted between the two, so in BPF both are atomic
+ * and an interleaved operation on the same CPU adds to the same count.
+ */
+#undef DS_TRACE_RETRIES
+
+#ifdef __BPF__
+static __u32 ds_trace_retries[DS_TRACE_CPUS];
+
+#define DS_TRACE_RETRIES(n) \
+	arena_atomic_add(&ds_trace_retries[bpf_get_smp_processor_id() & (DS_TRACE_CPUS - 1)], \
+			 (__u32)(n), ARENA_RELAXED)
+#else
+static __thread __u32 ds_trace_retries;
+
+#define DS_TRACE_RETRIES(n) (ds_trace_retries = (__u32)(n))
+#endif
+
+/* ========================================================================
+ * RECORDING
+ * ======================================================================== */
+
+static inline __u32 ds_trace_dur(__u64 dur_ns)
+{
+	return dur_ns > 0xffffffffULL ? 0xffffffffU : (__u32)dur_ns;
+}
+
+#ifdef __BPF__
+/**
+ * ds_trace_record_lkmm - Record one operation from a BPF program
+ * @trace: Trace store
+ * @start_ns: Operation start
+ * @dur_ns: Operation duration
+ * @op: enum ds_op_type
+ * @lane: Lane id
+ * @result: DS_* result code
+ *
+ * The slot claim is a fetch-add (fully ordered in LKMM). The sequence is
+ * cleared and a write barrier keeps the body stores after it, so a reader
+ * that copies a half-written body sees the cleared sequence on its
+ * re-check. The body is published by a release store of the sequence.
+ */
+static inline void ds_trace_record_lkmm(struct ds_trace_store __arena *trace, __u64 start_ns,
+					__u64 dur_ns, int op, int lane, int result)
+{
+	struct ds_trace_event __arena *ev;
+	struct ds_trace_ring __arena *ring;
+	__u32 cpu = bpf_get_smp_processor_id();
+	__u32 retries;
+	__u64 pos;
+
+	if (!trace)
+		return;
+	cast_kern(trace);
+	if (!READ_ONCE(trace->enabled))
+		return;
+
+	retries = arena_atomic_exchange(&ds_trace_retries[cpu & (DS_TRACE_CPUS - 1)], 0,
+					ARENA_RELAXED);
+
+	ring = &trace->kern[cpu & (DS_TRACE_CPUS - 1)];
+	cast_kern(ring);
+	pos = arena_atomic_add(&ring->head, 1, ARENA_RELAXED);
+	ev = &ring->events[pos & (DS_TRACE_SLOTS - 1)];
+	cast_kern(ev);
+
+	WRITE_ONCE(ev->seq, 0);
+	arena_smp_wmb();
+	ev->start_ns = start_ns;
+	ev->dur_ns = ds_trace_dur(dur_ns);
+	ev->cpu = (__u16)cpu;
+	ev->op = (__u8)op;
+	ev->lane = (__u8)lane;
+	ev->result = (__s16)result;
+	ev->retries = retries > 0xffff ? 0xffff : (__u16)retries;
+	smp_store_release(&ev->seq, (__u32)(pos + 1));
+}
+
+/**
+ * DS_TRACE_RECORD_OP_LKMM - DS_METRICS_RECORD_OP that also traces
+ * @metrics: ds_metrics_store
+ * @cat: ds_metrics_category
+ * @trace: ds_trace_store
+ * @op: enum ds_op_type
+ * @lane: Lane id
+ * @op_block: Code block that performs the operation
+ * @result_var: Variable that holds the operation result after op_block
+ */
+#define DS_TRACE_RECORD_OP_LKMM(metrics, cat, trace, op, lane, op_block, result_var) \
+do { \
+	__u64 __start = DS_METRICS_CLOCK_START(); \
+	op_block; \
+	__u64 __elapsed = DS_METRICS_CLOCK_END(__start); \
+	ds_metrics_record(metrics, cat, __elapsed, result_var); \
+	ds_trace_record_lkmm(trace, __start, __elapsed, op, lane, result_var); \
+} while (0)
+#endif /* __BPF__ */
+
+#ifndef __BPF__
+/**
+ * ds_trace_register_c - Hand the calling thread its own userspace ring
+ *
+ * The first DS_TRACE_THREADS callers each own a ring and claim slots
+ * without atomics. Later callers share rings, flagged with
+ * DS_TRACE_RING_SHARED so their claims use a fetch-add.
+ *
+ * Returns: The ring index to pass to ds_trace_record_c()
+ */
+static inline __u32 ds_trace_register_c(struct ds_trace_store __arena *trace)
+{
+	__u32 n = arena_atomic_add(&trace->nr_threads, 1, ARENA_RELAXED);
+
+	if (n < DS_TRACE_THREADS)
+		return n;
+	return (n & (DS_TRACE_THREADS - 1)) | DS_TRACE_RING_SHARED;
+}
+
+/**
+ * ds_trace_record_c - Record one operation from userspace
+ * @trace: Trace store
+ * @ring_idx: Ring from ds_trace_register_c()
+ * @cpu: CPU the caller runs on (e.g. sched_getcpu())
+ *
+ * Other arguments as for ds_trace_record_lkmm().
+ */
+static inline void ds_trace_record_c(struct ds_trace_store __arena *trace, __u32 ring_idx,
+				     __u32 cpu, __u64 start_ns, __u64 dur_ns, int op, int lane,
+				     int result)
+{
+	struct ds_trace_event __arena *ev;
+	struct ds_trace_ring __arena *ring;
+	__u32 retries = ds_trace_retries;
+	__u64 pos;
+
+	if (!trace || !arena_atomic_load(&trace->enabled, ARENA_RELAXED))
+		return;
+
+	ds_trace_retries = 0;
+	ring = &trace->user[ring_idx & (DS_TRACE_THREADS - 1)];
+	if (ring_idx & DS_TRACE_RING_SHARED) {
+		pos = arena_atomic_add(&ring->head, 1, ARENA_RELAXED);
+	} else {
+		pos = arena_atomic_load(&ring->head, ARENA_RELAXED);
+		arena_atomic_store(&ring->head, pos + 1, ARENA_RELAXED);
+	}
+	ev = &ring->events[pos & (DS_TRACE_SLOTS - 1)];
+
+	arena_atomic_store(&ev->seq, 0, ARENA_RELAXED);
+	arena_smp_wmb();
+	ev->start_ns = start_ns;
+	ev->dur_ns = ds_trace_dur(dur_ns);
+	ev->cpu = (__u16)cpu;
+	ev->op = (__u8)op;
+	ev->lane = (__u8)lane;
+	ev->result = (__s16)result;
+	ev->retries = retries > 0xffff ? 0xffff : (__u16)retries;
+	arena_atomic_store(&ev->seq, (__u32)(pos + 1), ARENA_RELEASE);
+}
+
+/**
+ * DS_TRACE_RECORD_OP_C - Userspace counterpart of DS_TRACE_RECORD_OP_LKMM
+ * @ring_idx: Ring from ds_trace_register_c()
+ * @cpu: CPU the caller runs on
+ */
+#define DS_TRACE_RECORD_OP_C(metrics, cat, trace, ring_idx, cpu, op, lane, op_block, result_var) \
+do { \
+	__u64 __start = DS_METRICS_CLOCK_START(); \
+	op_block; \
+	__u64 __elapsed = DS_METRICS_CLOCK_END(__start); \
+	ds_metrics_record(metrics, cat, __elapsed, result_var); \
+	ds_trace_record_c(trace, ring_idx, cpu, __start, __elapsed, op, lane, result_var); \
+} while (0)
+
+/* ========================================================================
+ * USERSPACE-ONLY READER AND EXPORTER
+ * ======================================================================== */
+
+/**
+ * ds_trace_read_ring_c - Copy the retained events of one ring, oldest first
+ * @ring: Ring to read
+ * @out: Destination, DS_TRACE_SLOTS entries
+ *
+ * Safe while writers run. An event whose slot is rewritten during the
+ * copy fails the sequence re-check and is left out.
+ *
+ * Returns: Number of events copied
+ */
+static inline __u32 ds_trace_read_ring_c(struct ds_trace_ring __arena *ring,
+					 struct ds_trace_event *out)
+{
+	__u64 head = arena_atomic_load(&ring->head, ARENA_ACQUIRE);
+	__u64 first = head > DS_TRACE_SLOTS ? head - DS_TRACE_SLOTS : 0;
+	__u32 n = 0;
+
+	for (__u64 pos = first; pos < head; pos++) {
+		struct ds_trace_event __arena *ev = &ring->events[pos & (DS_TRACE_SLOTS - 1)];
+		__u32 want = (__u32)(pos + 1);
+
+		if (arena_atomic_load(&ev->seq, ARENA_ACQUIRE) != want)
+			continue;
+		out[n] = *ev;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (arena_atomic_load(&ev->seq, ARENA_RELAXED) != want)
+			continue;
+		n++;
+	}
+
+	return n;
+}
+
+static inline const char *ds_trace_op_name(int op)
+{
+	switch (op) {
+	case DS_OP_INIT:	return "init";
+	case DS_OP_INSERT:	return "insert";
+	case DS_OP_DELETE:	return "delete";
+	case DS_OP_POP:		return "pop";
+	case DS_OP_SEARCH:	return "search";
+	case DS_OP_VERIFY:	return "verify";
+	case DS_OP_ITERATE:	return "iterate";
+	default:		return "op";
+	}
+}
+
+static inline const char *ds_trace_result_name(int result)
+{
+	switch (result) {
+	case DS_SUCCESS:		return "ok";
+	case DS_ERROR_NOT_FOUND:	return "not_found";
+	case DS_ERROR_EXISTS:		return "exists";
+	case DS_ERROR_NOMEM:		return "nomem";
+	case DS_ERROR_INVALID:		return "invalid";
+	case DS_ERROR_CORRUPT:		return "corrupt";
+	case DS_ERROR_BUSY:		return "busy";
+	case DS_ERROR_FULL:		return "full";
+	default:			return "error";
+	}
+}
+
+static inline void ds_trace_export_ring_c(FILE *f, struct ds_trace_ring __arena *ring,
+					  int pid, int tid, __u64 base_ns,
+					  const char *const *lane_names, int nr_lanes,
+					  struct ds_trace_event *buf, __u64 *written)
+{
+	__u32 n = ds_trace_read_ring_c(ring, buf);
+
+	for (__u32 i = 0; i < n; i++) {
+		const struct ds_trace_event *ev = &buf[i];
+		const char *lane = ev->lane < nr_lanes && lane_names ? lane_names[ev->lane] : NULL;
+
+		fprintf(f, "%s{\"name\":\"%s", *written ? ",\n" : "",
+			ds_trace_op_name(ev->op));
+		if (lane)
+			fprintf(f, " %s\",\"cat\":\"%s\"", lane, lane);
+		else
+			fprintf(f, " lane%u\",\"cat\":\"lane%u\"", ev->lane, ev->lane);
+		fprintf(f, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"cpu\":%u,\"result\":\"%s\",\"retries\":%u}}",
+			pid, tid,
+			(double)(ev->start_ns - base_ns) / 1e3, (double)ev->dur_ns / 1e3,
+			ev->cpu, ds_trace_result_name(ev->result), ev->retries);
+		(*written)++;
+	}
+}
+
+static inline void ds_trace_export_meta_c(FILE *f, int pid, int tid, const char *what,
+					  const char *name, int idx)
+{
+	fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d", what, pid);
+	if (tid >= 0)
+		fprintf(f, ",\"tid\":%d", tid);
+	if (idx >= 0)
+		fprintf(f, ",\"args\":{\"name\":\"%s %d\"}}", name, idx);
+	else
+		fprintf(f, ",\"args\":{\"name\":\"%s\"}}", name);
+}
+
+/**
+ * ds_trace_export_chrome_c - Write every ring as Chrome trace JSON
+ * @trace: Trace store
+ * @f: Output file
+ * @lane_names: Names for lane ids 0..@nr_lanes-1 (may be NULL)
+ * @nr_lanes: Entries in @lane_names
+ *
+ * BPF rings become process 1 with one track per CPU, userspace rings
+ * process 2 with one track per registered thread. Timestamps are in
+ * microseconds from the oldest retained event. Recording is not paused;
+ * events written during the export may or may not appear.
+ *
+ * Returns: Number of events written, or DS_ERROR_NOMEM
+ */
+static inline long ds_trace_export_chrome_c(struct ds_trace_store __arena *trace, FILE *f,
+					    const char *const *lane_names, int nr_lanes)
+{
+	struct ds_trace_event *buf;
+	__u64 base_ns = ~0ULL;
+	__u64 written = 0;
+	__u32 nr_threads;
+
+	buf = malloc(sizeof(*buf) * DS_TRACE_SLOTS);
+	if (!buf)
+		return DS_ERROR_NOMEM;
+	if (nr_lanes > DS_TRACE_MAX_LANES)
+		nr_lanes = DS_TRACE_MAX_LANES;
+
+	nr_threads = arena_atomic_load(&trace->nr_threads, ARENA_RELAXED);
+	if (nr_threads > DS_TRACE_THREADS)
+		nr_threads = DS_TRACE_THREADS;
+
+	for (int i = 0; i < DS_TRACE_CPUS + DS_TRACE_THREADS; i++) {
+		struct ds_trace_ring __arena *ring =
+			i < DS_TRACE_CPUS ? &trace->kern[i] : &trace->user[i - DS_TRACE_CPUS];
+		__u32 n = ds_trace_read_ring_c(ring, buf);
+
+		if (n && buf[0].start_ns < base_ns)
+			base_ns = buf[0].start_ns;
+	}
+	if (base_ns == ~0ULL)
+		base_ns = 0;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for (int cpu = 0; cpu < DS_TRACE_CPUS; cpu++)
+		ds_trace_export_ring_c(f, &trace->kern[cpu], 1, cpu, base_ns,
+				       lane_names, nr_lanes, buf, &written);
+	for (__u32 t = 0; t < DS_TRACE_THREADS; t++)
+		ds_trace_export_ring_c(f, &trace->user[t], 2, (int)t, base_ns,
+				       lane_names, nr_lanes, buf, &written);
+
+	/* Metadata last: the separator logic only has to know about events */
+	fprintf(f, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+		"\"args\":{\"name\":\"BPF (per CPU)\"}}", written ? ",\n" : "");
+	ds_trace_export_meta_c(f, 2, -1, "process_name", "userspace (per thread)", -1);
+	for (int cpu = 0; cpu < DS_TRACE_CPUS; cpu++)
+		ds_trace_export_meta_c(f, 1, cpu, "thread_name", "cpu", cpu);
+	for (__u32 t = 0; t < nr_threads; t++)
+		ds_trace_export_meta_c(f, 2, (int)t, "thread_name", "thread", (int)t);
+	fprintf(f, "\n]}\n");
+
+	free(buf);
+	return (long)written;
+}
+
+#endif /* !__BPF__ */
+
+#endif /* DS_TRACE_H */
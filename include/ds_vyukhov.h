@@ -35,6 +35,11 @@
  * - Consumer can read if: sequence == dequeue_pos + 1
  * - After write: sequence = pos + 1
  * - After read: sequence = pos + mask + 1 (wraps to next lap)
+ *
+ * The stored value is relative to the cell's index: cell i holds
+ * sequence - i, and DS_VYUKHOV_SEQ_LOAD/STORE add and subtract i. The
+ * first lap wants sequence == i, which is the stored 0 of a freshly
+ * allocated (zeroed) arena buffer, so init never walks the cells.
  */
 struct ds_vyukhov_node {
 	__u64 sequence;
@@ -50,6 +55,7 @@ struct ds_vyukhov_node {
  * @buffer_mask: Capacity - 1 (for fast modulo)
  * @buffer: Pointer to the ring buffer array
  * @count: Current number of elements (approximate, for observability)
+ * @op_stats: Per-operation counters (DS_OP_STATS only)
  * 
  * The padding ensures that enqueue_pos and dequeue_pos reside on different
  * cache lines to minimize contention between producers and consumers.
@@ -69,6 +75,7 @@ struct ds_vyukhov_head {
 	
 	/* Statistics (approximate) */
 	__u64 count;
+	DS_OP_STATS_FIELD
 };
 
 typedef struct ds_vyukhov_head __arena ds_vyukhov_head_t;
@@ -84,6 +91,10 @@ typedef struct ds_vyukhov_node __arena ds_vyukhov_node_t;
 /* Default capacity if not specified */
 #define DS_VYUKHOV_DEFAULT_CAPACITY 256
 
+/* Index-relative sequence access (see struct ds_vyukhov_node) */
+#define DS_VYUKHOV_SEQ_LOAD(raw, idx) ((raw) + (idx))
+#define DS_VYUKHOV_SEQ_STORE(seq, idx) ((seq) - (idx))
+
 /* ========================================================================
  * API IMPLEMENTATION
  * ======================================================================== */
@@ -93,13 +104,16 @@ typedef struct ds_vyukhov_node __arena ds_vyukhov_node_t;
  * @head: Queue head to initialize
  * @capacity: Queue capacity (must be power of 2, e.g., 1024)
  * 
- * Allocates the ring buffer and initializes sequence numbers.
- * Each cell's sequence is set to its index for the first lap.
+ * Allocates the ring buffer. ds_arena_alloc_array() returns it zeroed,
+ * recycled fragments included, and a stored sequence of 0 means "cell i,
+ * first lap", so this is O(1) in the capacity:
+ * no cell is touched until its first insert.
  * 
  * Returns: DS_SUCCESS on success, DS_ERROR_INVALID if capacity is invalid,
- *          DS_ERROR_NOMEM if allocation fails
+ *          DS_ERROR_NOMEM if allocation fails or the buffer could not be
+ *          cleared within the program's loop budget
  */
-static inline int ds_vyukhov_init_lkmm(struct ds_vyukhov_head __arena *head, __u32 capacity)
+static inline int __ds_vyukhov_init_lkmm(struct ds_vyukhov_head __arena *head, __u32 capacity)
 {
 	cast_kern(head);
 	
@@ -117,25 +131,20 @@ static inline int ds_vyukhov_init_lkmm(struct ds_vyukhov_head __arena *head, __u
 	WRITE_ONCE(head->count, 0);
 	
 	/* Allocate the ring buffer */
-	head->buffer = bpf_arena_alloc(capacity * sizeof(struct ds_vyukhov_node));
+	head->buffer = ds_arena_alloc_array((__u64)capacity * sizeof(struct ds_vyukhov_node));
 	if (!head->buffer)
 		return DS_ERROR_NOMEM;
 	
-	cast_kern(head->buffer);
-	
-	/* Initialize sequence counters - cell i gets sequence i 
-	 * Note: data fields are already zeroed by arena allocation */
-	for (__u32 i = 0; i < capacity && can_loop; i++) {
-		struct ds_vyukhov_node __arena *cell = &head->buffer[i];
-		cast_kern(cell);
-		WRITE_ONCE(cell->sequence, i);
-	}
-	
 	return DS_SUCCESS;
 }
 
+static inline int ds_vyukhov_init_lkmm(struct ds_vyukhov_head __arena *head, __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_vyukhov_init_lkmm(head, capacity));
+}
+
 #ifndef __BPF__
-static inline int ds_vyukhov_init_c(struct ds_vyukhov_head __arena *head, __u32 capacity)
+static inline int __ds_vyukhov_init_c(struct ds_vyukhov_head __arena *head, __u32 capacity)
 {
 	cast_kern(head);
 
@@ -150,20 +159,17 @@ static inline int ds_vyukhov_init_c(struct ds_vyukhov_head __arena *head, __u32
 	arena_atomic_store(&head->dequeue_pos, 0, ARENA_RELAXED);
 	arena_atomic_store(&head->count, 0, ARENA_RELAXED);
 
-	head->buffer = bpf_arena_alloc(capacity * sizeof(struct ds_vyukhov_node));
+	head->buffer = ds_arena_alloc_array((__u64)capacity * sizeof(struct ds_vyukhov_node));
 	if (!head->buffer)
 		return DS_ERROR_NOMEM;
 
-	cast_kern(head->buffer);
-
-	for (__u32 i = 0; i < capacity && can_loop; i++) {
-		struct ds_vyukhov_node __arena *cell = &head->buffer[i];
-		cast_kern(cell);
-		arena_atomic_store(&cell->sequence, i, ARENA_RELAXED);
-	}
-
 	return DS_SUCCESS;
 }
+
+static inline int ds_vyukhov_init_c(struct ds_vyukhov_head __arena *head, __u32 capacity)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INIT, __ds_vyukhov_init_c(head, capacity));
+}
 #endif
 
 static inline int ds_vyukhov_init(struct ds_vyukhov_head __arena *head, __u32 capacity)
@@ -189,8 +195,8 @@ static inline int ds_vyukhov_init(struct ds_vyukhov_head __arena *head, __u32 ca
  *          DS_ERROR_NOMEM if queue is full
  *          DS_ERROR_BUSY if max retries exceeded
  */
-static inline int ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
-                                         __u64 key, __u64 value)
+static inline int __ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
+					   __u64 key, __u64 value)
 {
 	struct ds_vyukhov_node __arena *cell;
 	__u64 pos;
@@ -208,7 +214,7 @@ static inline int ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
 		cell = &head->buffer[pos & mask];
 		cast_kern(cell);
 		
-		__u64 seq = smp_load_acquire(&cell->sequence);
+		__u64 seq = DS_VYUKHOV_SEQ_LOAD(smp_load_acquire(&cell->sequence), pos & mask);
 		__s64 dif = (__s64)seq - (__s64)pos;
 		
 		if (dif == 0) {
@@ -222,17 +228,20 @@ static inline int ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
 				cell->data.value = value;
 				
 				/* Release to consumer: sequence = pos + 1 */
-				smp_store_release(&cell->sequence, pos + 1);
+				smp_store_release(&cell->sequence,
+						  DS_VYUKHOV_SEQ_STORE(pos + 1, pos & mask));
 				
 				/* Update approximate count (relaxed: just statistics) */
 				arena_atomic_inc(&head->count);
 				
+				DS_TRACE_RETRIES(retries);
 				return DS_SUCCESS;
 			}
 			/* CAS failed, another producer claimed it. Retry. */
 		}
 		else if (dif < 0) {
 			/* Sequence < pos: Queue is full */
+			DS_TRACE_RETRIES(retries);
 			return DS_ERROR_NOMEM;
 		}
 		/* else: dif > 0, rare race condition, reload and retry */
@@ -242,12 +251,19 @@ static inline int ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
 	}
 	
 	/* Max retries exceeded */
+	DS_TRACE_RETRIES(retries);
 	return DS_ERROR_BUSY;
 }
 
+static inline int ds_vyukhov_insert_lkmm(struct ds_vyukhov_head __arena *head,
+                                         __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_vyukhov_insert_lkmm(head, key, value));
+}
+
 #ifndef __BPF__
-static inline int ds_vyukhov_insert_c(struct ds_vyukhov_head __arena *head,
-					 __u64 key, __u64 value)
+static inline int __ds_vyukhov_insert_c(struct ds_vyukhov_head __arena *head,
+					   __u64 key, __u64 value)
 {
 	struct ds_vyukhov_node __arena *cell;
 	__u64 pos;
@@ -264,10 +280,12 @@ static inline int ds_vyukhov_insert_c(struct ds_vyukhov_head __arena *head,
 		cell = &head->buffer[pos & mask];
 		cast_kern(cell);
 
-		__u64 seq = arena_atomic_load(&cell->sequence, ARENA_ACQUIRE);
+		__u64 seq = DS_VYUKHOV_SEQ_LOAD(arena_atomic_load(&cell->sequence, ARENA_ACQUIRE),
+						pos & mask);
 		__s64 dif = (__s64)seq - (__s64)pos;
 
 		if (dif == 0) {
+			DS_PREEMPT_POINT();
 			__u64 old_pos = arena_atomic_cmpxchg(&head->enqueue_pos, pos, pos + 1,
 							     ARENA_RELAXED, ARENA_RELAXED);
 
@@ -275,19 +293,31 @@ static inline int ds_vyukhov_insert_c(struct ds_vyukhov_head __arena *head,
 				cell->data.key = key;
 				cell->data.value = value;
 
-				arena_atomic_store(&cell->sequence, pos + 1, ARENA_RELEASE);
+				/* Consumers of this cell wait until the store below */
+				DS_PREEMPT_POINT();
+				arena_atomic_store(&cell->sequence,
+						   DS_VYUKHOV_SEQ_STORE(pos + 1, pos & mask), ARENA_RELEASE);
 				arena_atomic_inc(&head->count);
+				DS_TRACE_RETRIES(retries);
 				return DS_SUCCESS;
 			}
 		} else if (dif < 0) {
+			DS_TRACE_RETRIES(retries);
 			return DS_ERROR_NOMEM;
 		}
 
 		pos = arena_atomic_load(&head->enqueue_pos, ARENA_RELAXED);
 	}
 
+	DS_TRACE_RETRIES(retries);
 	return DS_ERROR_BUSY;
 }
+
+static inline int ds_vyukhov_insert_c(struct ds_vyukhov_head __arena *head,
+					 __u64 key, __u64 value)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_INSERT, __ds_vyukhov_insert_c(head, key, value));
+}
 #endif
 
 static inline int ds_vyukhov_insert(struct ds_vyukhov_head __arena *head,
@@ -314,7 +344,7 @@ static inline int ds_vyukhov_insert(struct ds_vyukhov_head __arena *head,
  *          DS_ERROR_NOT_FOUND if queue is empty
  *          DS_ERROR_BUSY if max retries exceeded
  */
-static inline int ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
+static inline int __ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
 {
 	struct ds_vyukhov_node __arena *cell;
 	__u64 pos;
@@ -332,7 +362,7 @@ static inline int ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, stru
 		cell = &head->buffer[pos & mask];
 		cast_kern(cell);
 		
-		__u64 seq = smp_load_acquire(&cell->sequence);
+		__u64 seq = DS_VYUKHOV_SEQ_LOAD(smp_load_acquire(&cell->sequence), pos & mask);
 		__s64 dif = (__s64)seq - (__s64)(pos + 1);
 		
 		if (dif == 0) {
@@ -347,17 +377,20 @@ static inline int ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, stru
 				data->value = cell->data.value;
 				
 				/* Release to producer: sequence = pos + mask + 1 (next lap) */
-				smp_store_release(&cell->sequence, pos + mask + 1);
+				smp_store_release(&cell->sequence,
+						  DS_VYUKHOV_SEQ_STORE(pos + mask + 1, pos & mask));
 				
 				/* Update approximate count (relaxed: just statistics) */
 				arena_atomic_dec(&head->count);
 				
+				DS_TRACE_RETRIES(retries);
 				return DS_SUCCESS;
 			}
 			/* CAS failed, another consumer claimed it. Retry. */
 		}
 		else if (dif < 0) {
 			/* Sequence < pos + 1: Queue is empty */
+			DS_TRACE_RETRIES(retries);
 			return DS_ERROR_NOT_FOUND;
 		}
 		/* else: dif > 0, rare race condition, reload and retry */
@@ -367,11 +400,17 @@ static inline int ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, stru
 	}
 	
 	/* Max retries exceeded */
+	DS_TRACE_RETRIES(retries);
 	return DS_ERROR_BUSY;
 }
 
+static inline int ds_vyukhov_pop_lkmm(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_vyukhov_pop_lkmm(head, data));
+}
+
 #ifndef __BPF__
-static inline int ds_vyukhov_pop_c(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
+static inline int __ds_vyukhov_pop_c(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
 {
 	struct ds_vyukhov_node __arena *cell;
 	__u64 pos;
@@ -388,10 +427,12 @@ static inline int ds_vyukhov_pop_c(struct ds_vyukhov_head __arena *head, struct
 		cell = &head->buffer[pos & mask];
 		cast_kern(cell);
 
-		__u64 seq = arena_atomic_load(&cell->sequence, ARENA_ACQUIRE);
+		__u64 seq = DS_VYUKHOV_SEQ_LOAD(arena_atomic_load(&cell->sequence, ARENA_ACQUIRE),
+						pos & mask);
 		__s64 dif = (__s64)seq - (__s64)(pos + 1);
 
 		if (dif == 0) {
+			DS_PREEMPT_POINT();
 			__u64 old_pos = arena_atomic_cmpxchg(&head->dequeue_pos, pos, pos + 1,
 							     ARENA_RELAXED, ARENA_RELAXED);
 
@@ -400,19 +441,30 @@ static inline int ds_vyukhov_pop_c(struct ds_vyukhov_head __arena *head, struct
 				data->key = cell->data.key;
 				data->value = cell->data.value;
 
-				arena_atomic_store(&cell->sequence, pos + mask + 1, ARENA_RELEASE);
+				DS_PREEMPT_POINT();
+				arena_atomic_store(&cell->sequence,
+						   DS_VYUKHOV_SEQ_STORE(pos + mask + 1, pos & mask),
+						   ARENA_RELEASE);
 				arena_atomic_dec(&head->count);
+				DS_TRACE_RETRIES(retries);
 				return DS_SUCCESS;
 			}
 		} else if (dif < 0) {
+			DS_TRACE_RETRIES(retries);
 			return DS_ERROR_NOT_FOUND;
 		}
 
 		pos = arena_atomic_load(&head->dequeue_pos, ARENA_RELAXED);
 	}
 
+	DS_TRACE_RETRIES(retries);
 	return DS_ERROR_BUSY;
 }
+
+static inline int ds_vyukhov_pop_c(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_POP, __ds_vyukhov_pop_c(head, data));
+}
 #endif
 
 static inline int ds_vyukhov_pop(struct ds_vyukhov_head __arena *head, struct ds_kv *data)
@@ -435,7 +487,7 @@ static inline int ds_vyukhov_pop(struct ds_vyukhov_head __arena *head, struct ds
  * 
  * Returns: DS_SUCCESS if found, DS_ERROR_NOT_FOUND otherwise
  */
-static inline int ds_vyukhov_search_lkmm(struct ds_vyukhov_head __arena *head, __u64 key)
+static inline int __ds_vyukhov_search_lkmm(struct ds_vyukhov_head __arena *head, __u64 key)
 {
 	__u64 start, end, mask;
 	
@@ -459,8 +511,13 @@ static inline int ds_vyukhov_search_lkmm(struct ds_vyukhov_head __arena *head, _
 	return DS_ERROR_NOT_FOUND;
 }
 
+static inline int ds_vyukhov_search_lkmm(struct ds_vyukhov_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_vyukhov_search_lkmm(head, key));
+}
+
 #ifndef __BPF__
-static inline int ds_vyukhov_search_c(struct ds_vyukhov_head __arena *head, __u64 key)
+static inline int __ds_vyukhov_search_c(struct ds_vyukhov_head __arena *head, __u64 key)
 {
 	__u64 start, end, mask;
 
@@ -481,6 +538,11 @@ static inline int ds_vyukhov_search_c(struct ds_vyukhov_head __arena *head, __u6
 
 	return DS_ERROR_NOT_FOUND;
 }
+
+static inline int ds_vyukhov_search_c(struct ds_vyukhov_head __arena *head, __u64 key)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_SEARCH, __ds_vyukhov_search_c(head, key));
+}
 #endif
 
 static inline int ds_vyukhov_search(struct ds_vyukhov_head __arena *head, __u64 key)
@@ -504,7 +566,7 @@ static inline int ds_vyukhov_search(struct ds_vyukhov_head __arena *head, __u64
  * 
  * Returns: DS_SUCCESS if valid, DS_ERROR_CORRUPT otherwise
  */
-static inline int ds_vyukhov_verify_lkmm(struct ds_vyukhov_head __arena *head)
+static inline int __ds_vyukhov_verify_lkmm(struct ds_vyukhov_head __arena *head)
 {
 	if (!head)
 		return DS_ERROR_INVALID;
@@ -536,8 +598,13 @@ static inline int ds_vyukhov_verify_lkmm(struct ds_vyukhov_head __arena *head)
 	return DS_SUCCESS;
 }
 
+static inline int ds_vyukhov_verify_lkmm(struct ds_vyukhov_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_vyukhov_verify_lkmm(head));
+}
+
 #ifndef __BPF__
-static inline int ds_vyukhov_verify_c(struct ds_vyukhov_head __arena *head)
+static inline int __ds_vyukhov_verify_c(struct ds_vyukhov_head __arena *head)
 {
 	if (!head)
 		return DS_ERROR_INVALID;
@@ -564,6 +631,11 @@ static inline int ds_vyukhov_verify_c(struct ds_vyukhov_head __arena *head)
 
 	return DS_SUCCESS;
 }
+
+static inline int ds_vyukhov_verify_c(struct ds_vyukhov_head __arena *head)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_VERIFY, __ds_vyukhov_verify_c(head));
+}
 #endif
 
 static inline int ds_vyukhov_verify(struct ds_vyukhov_head __arena *head)
@@ -609,9 +681,9 @@ static inline const struct ds_metadata* ds_vyukhov_get_metadata(void)
  */
 typedef int (*ds_vyukhov_iter_fn)(__u64 key, __u64 value, void *ctx);
 
-static inline __u64 ds_vyukhov_iterate_lkmm(struct ds_vyukhov_head __arena *head,
-					    ds_vyukhov_iter_fn fn,
-					    void *ctx)
+static inline __u64 __ds_vyukhov_iterate_lkmm(struct ds_vyukhov_head __arena *head,
+					      ds_vyukhov_iter_fn fn,
+					      void *ctx)
 {
 	__u64 count = 0;
 	
@@ -638,10 +710,17 @@ static inline __u64 ds_vyukhov_iterate_lkmm(struct ds_vyukhov_head __arena *head
 	return count;
 }
 
+static inline __u64 ds_vyukhov_iterate_lkmm(struct ds_vyukhov_head __arena *head,
+					    ds_vyukhov_iter_fn fn,
+					    void *ctx)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_ITERATE, __ds_vyukhov_iterate_lkmm(head, fn, ctx));
+}
+
 #ifndef __BPF__
-static inline __u64 ds_vyukhov_iterate_c(struct ds_vyukhov_head __arena *head,
-					 ds_vyukhov_iter_fn fn,
-					 void *ctx)
+static inline __u64 __ds_vyukhov_iterate_c(struct ds_vyukhov_head __arena *head,
+					   ds_vyukhov_iter_fn fn,
+					   void *ctx)
 {
 	__u64 count = 0;
 
@@ -665,6 +744,13 @@ static inline __u64 ds_vyukhov_iterate_c(struct ds_vyukhov_head __arena *head,
 
 	return count;
 }
+
+static inline __u64 ds_vyukhov_iterate_c(struct ds_vyukhov_head __arena *head,
+					 ds_vyukhov_iter_fn fn,
+					 void *ctx)
+{
+	return DS_OP_STATS_RUN(head, DS_OP_ITERATE, __ds_vyukhov_iterate_c(head, fn, ctx));
+}
 #endif
 
 static inline __u64 ds_vyukhov_iterate(struct ds_vyukhov_head __arena *head,
@@ -678,4 +764,57 @@ static inline __u64 ds_vyukhov_iterate(struct ds_vyukhov_head __arena *head,
 #endif
 }
 
+/**
+ * ds_vyukhov_stats - Occupancy, cell memory and per-op counters
+ * @head: Queue
+ * @stats: Filled in; ops[] stay zero unless built with DS_OP_STATS
+ *
+ * Returns: DS_SUCCESS, or DS_ERROR_INVALID if an argument is NULL
+ */
+static inline int ds_vyukhov_stats_lkmm(struct ds_vyukhov_head __arena *head,
+					struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = READ_ONCE(head->enqueue_pos) - READ_ONCE(head->dequeue_pos);
+	stats->max_elements = 0;
+	stats->memory_used = head->buffer ? (head->buffer_mask + 1) * sizeof(struct ds_vyukhov_node) : 0;
+	return DS_SUCCESS;
+}
+
+#ifndef __BPF__
+static inline int ds_vyukhov_stats_c(struct ds_vyukhov_head __arena *head,
+				     struct ds_stats *stats)
+{
+	if (!head || !stats)
+		return DS_ERROR_INVALID;
+
+	ds_op_stats_read(DS_OP_STATS_ADDR(head), stats);
+	cast_kern(head);
+	stats->current_elements = arena_atomic_load(&head->enqueue_pos, ARENA_RELAXED) -
+				  arena_atomic_load(&head->dequeue_pos, ARENA_RELAXED);
+	stats->max_elements = 0;
+	stats->memory_used = head->buffer ? (head->buffer_mask + 1) * sizeof(struct ds_vyukhov_node) : 0;
+	return DS_SUCCESS;
+}
+#endif
+
+static inline int ds_vyukhov_stats(struct ds_vyukhov_head __arena *head, struct ds_stats *stats)
+{
+#ifdef __BPF__
+	return ds_vyukhov_stats_lkmm(head, stats);
+#else
+	return ds_vyukhov_stats_c(head, stats);
+#endif
+}
+
+/* Zero the per-op counters; a no-op without DS_OP_STATS */
+static inline void ds_vyukhov_reset_stats(struct ds_vyukhov_head __arena *head)
+{
+	ds_op_stats_reset(DS_OP_STATS_ADDR(head));
+}
+
 #endif /* DS_VYUKHOV_H */
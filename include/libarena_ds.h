@@ -12,6 +12,120 @@
 #define round_up(x, y) ((((x)-1) | __round_mask(x, y))+1)
 #endif
 
+/*
+ * bpf_arena_alloc() packs objects into one page and cannot serve
+ * PAGE_SIZE - 8 bytes or more. bpf_arena_alloc_large() hands out a run of
+ * whole, zeroed, contiguous pages instead; free it with
+ * bpf_arena_free_large() and the same size. Runs are capped so one call
+ * cannot take the whole arena.
+ */
+#ifndef ARENA_LARGE_MAX_PAGES
+#define ARENA_LARGE_MAX_PAGES 4096
+#endif
+
+/*
+ * Page footer: the last 8 bytes of a fragment page count its live objects
+ * in the low 48 bits. With ARENA_REMOTE_FREE the top 16 bits name the
+ * allocator that carves the page (see below); they never change while the
+ * page is in use.
+ *
+ * Each allocator holds one count on its current page until it moves on, so
+ * freeing every object on a page never releases it while it is still being
+ * carved. Under ARENA_PAGE_OWNER, ARENA_REMOTE_FREE or
+ * ARENA_NOSLEEP_RESERVE (where a non-sleepable program can interrupt a
+ * sleepable one on the same CPU), more than one context updates the count,
+ * so it is atomic.
+ */
+#define ARENA_OBJ_CNT_BITS 48
+#define ARENA_OBJ_CNT_MASK ((1ULL << ARENA_OBJ_CNT_BITS) - 1)
+#define ARENA_PAGE_HOLD 1
+
+#if defined(ARENA_PAGE_OWNER) || defined(ARENA_REMOTE_FREE) || \
+    defined(ARENA_NOSLEEP_RESERVE)
+#define arena_obj_get(cnt) __atomic_fetch_add((cnt), 1, __ATOMIC_RELAXED)
+#define arena_obj_put_n(cnt, n) \
+	((__atomic_sub_fetch((cnt), (n), __ATOMIC_ACQ_REL) & ARENA_OBJ_CNT_MASK) == 0)
+#else
+#define arena_obj_get(cnt) ((*(cnt))++)
+#define arena_obj_put_n(cnt, n) (((*(cnt)) -= (n)) == 0)
+#endif
+#define arena_obj_put(cnt) arena_obj_put_n(cnt, 1)
+
+#ifdef ARENA_REMOTE_FREE
+/*
+ * Deferred remote frees, after mimalloc's thread-free lists. An object
+ * freed by anyone other than the allocator carving its page is pushed
+ * onto that allocator's list. The push is one CAS on the list head, and
+ * the object's first word is the link. The page footer is only read. The
+ * owner takes the whole list with one exchange on its next allocation and
+ * drops the counts page by page, with one RMW per run of objects from the
+ * same page. So in a relay, the producer's footer lines stay with the
+ * producer.
+ *
+ * Owners are the kernel CPUs (masked to ARENA_REMOTE_CPUS) and the
+ * userspace allocator. Objects on a list still hold their page, so an
+ * owner that never allocates again keeps those pages until it does.
+ *
+ * The lists live in the BPF program's arena globals
+ * (arena_remote_free_state). Userspace passes the skeleton's copy to
+ * bpf_arena_userspace_set_remote().
+ */
+#define ARENA_REMOTE_CPUS 64
+#define ARENA_REMOTE_USER ARENA_REMOTE_CPUS
+#define ARENA_REMOTE_OWNERS (ARENA_REMOTE_CPUS + 1)
+#define ARENA_REMOTE_RETRIES 100
+
+/* Footer tag for @owner; 0 means untagged (always freed in place) */
+#define ARENA_PAGE_TAG(owner) ((__u64)((owner) + 1) << ARENA_OBJ_CNT_BITS)
+#define ARENA_PAGE_OWNER_OF(footer) ((__u32)((footer) >> ARENA_OBJ_CNT_BITS) - 1)
+
+/**
+ * struct arena_remote_list - One owner's pending remote frees
+ * @head: Last object pushed, linked through word 0
+ * @pushed: Objects pushed by non-owners
+ * @drained: Objects the owner took back
+ * @batches: Drains that found at least one object
+ * @page_puts: Footer updates those drains made
+ */
+struct arena_remote_list {
+	void __arena *head;
+	__u64 pushed;
+	__u64 drained;
+	__u64 batches;
+	__u64 page_puts;
+	char pad[24];	/* one cache line per owner */
+};
+
+struct arena_remote_free {
+	struct arena_remote_list owner[ARENA_REMOTE_OWNERS];
+};
+#else
+#define ARENA_PAGE_TAG(owner) 0ULL
+#endif
+
+#ifdef ARENA_ALLOC_STATS
+/**
+ * struct arena_alloc_stats - Page-source traffic of one side's allocators
+ * @page_allocs: Fragment pages and large runs taken from the page source
+ * @page_frees: Fragment pages and large runs given back to it
+ * @pages_out: Pages taken minus pages given back
+ * @failures: Refills and runs the page source could not serve
+ *
+ * Opt-in (define ARENA_ALLOC_STATS before this header) for benchmarks that
+ * want page-allocator call rates. Counts are relaxed atomics, updated only
+ * on the page paths, so the per-object fast path is unchanged.
+ */
+struct arena_alloc_stats {
+	__u64 page_allocs;
+	__u64 page_frees;
+	__s64 pages_out;
+	__u64 failures;
+};
+
+#define arena_alloc_stat_add(st, field, n) \
+	__atomic_fetch_add(&(st)->field, (n), __ATOMIC_RELAXED)
+#endif
+
 #ifdef __BPF__
 
 /* ========================================================================
@@ -130,36 +244,247 @@
 #define arena_atomic_dec(ptr) arena_atomic_sub((ptr), 1, ARENA_RELAXED)
 #define arena_memory_barrier() __atomic_thread_fence(ARENA_SEQ_CST)
 
+/**
+ * arena_smp_mb - Full memory barrier (bpf_full_barrier())
+ *
+ * arena_smp_rmb() and arena_smp_wmb() order loads and stores only. x86 is
+ * TSO, so they are compiler barriers there; other targets get the full
+ * barrier. Userspace maps all three to C11 fences.
+ */
+#define arena_smp_mb() bpf_full_barrier()
+#ifdef __TARGET_ARCH_x86
+#define arena_smp_rmb() barrier()
+#define arena_smp_wmb() barrier()
+#else
+#define arena_smp_rmb() bpf_full_barrier()
+#define arena_smp_wmb() bpf_full_barrier()
+#endif
+
 /* ========================================================================
  * BPF ARENA MEMORY ALLOCATOR
  * ======================================================================== */
 
 #define NR_CPUS (sizeof(struct cpumask) * 8)
 
-static void __arena * __arena page_frag_cur_page[NR_CPUS];
-static int __arena page_frag_cur_offset[NR_CPUS];
+/*
+ * Fragment state classes. With ARENA_NOSLEEP_RESERVE, sleepable and
+ * non-sleepable programs both allocate. A sleepable program can be
+ * preempted in the middle of bpf_arena_alloc() and a non-sleepable one can
+ * then run on the same CPU, so each kind bumps its own page and offset.
+ */
+#define ARENA_FRAG_SLEEPABLE 0
+#define ARENA_FRAG_ATOMIC 1
+#ifdef ARENA_NOSLEEP_RESERVE
+#define ARENA_FRAG_CLASSES 2
+#else
+#define ARENA_FRAG_CLASSES 1
+#endif
+
+static void __arena * __arena page_frag_cur_page[ARENA_FRAG_CLASSES][NR_CPUS];
+static int __arena page_frag_cur_offset[ARENA_FRAG_CLASSES][NR_CPUS];
+
+#ifdef ARENA_NOSLEEP_RESERVE
+/*
+ * Pages come from and go back to the per-CPU reserve in ds_page_reserve.h,
+ * which the program includes after this header, so bpf_arena_alloc() and
+ * bpf_arena_free() never call a sleepable kfunc.
+ */
+static void __arena *ds_page_reserve_take(__u32 cpu);
+static void ds_page_reserve_give_back(void __arena *page);
+
+/* Non-zero while a non-sleepable program on this CPU is between enter/exit */
+static __u32 __arena page_frag_atomic[NR_CPUS];
+#endif
+
+/* Fragment state class the current program on @cpu allocates from */
+static inline __u32 bpf_arena_frag_class(__u32 cpu)
+{
+#ifdef ARENA_NOSLEEP_RESERVE
+	return READ_ONCE(page_frag_atomic[cpu]) ? ARENA_FRAG_ATOMIC : ARENA_FRAG_SLEEPABLE;
+#else
+	(void)cpu;
+	return ARENA_FRAG_SLEEPABLE;
+#endif
+}
+
+/**
+ * bpf_arena_frag_atomic_enter - Allocate from this CPU's non-sleepable state
+ *
+ * Non-sleepable programs that allocate under ARENA_NOSLEEP_RESERVE call
+ * this on entry and bpf_arena_frag_atomic_exit() with its result before
+ * returning. They run to completion on their CPU, so a sleepable program
+ * they interrupt sees its own state again afterwards. Programs that can
+ * run in NMI must not allocate.
+ *
+ * Returns: The previous setting, for bpf_arena_frag_atomic_exit()
+ */
+static inline __u32 bpf_arena_frag_atomic_enter(void)
+{
+#ifdef ARENA_NOSLEEP_RESERVE
+	__u32 cpu = bpf_get_smp_processor_id();
+	__u32 prev;
+
+	if (cpu >= NR_CPUS)
+		return 0;
+	prev = READ_ONCE(page_frag_atomic[cpu]);
+	WRITE_ONCE(page_frag_atomic[cpu], 1);
+	return prev;
+#else
+	return 0;
+#endif
+}
+
+static inline void bpf_arena_frag_atomic_exit(__u32 prev)
+{
+#ifdef ARENA_NOSLEEP_RESERVE
+	__u32 cpu = bpf_get_smp_processor_id();
+
+	if (cpu < NR_CPUS)
+		WRITE_ONCE(page_frag_atomic[cpu], prev);
+#else
+	(void)prev;
+#endif
+}
+
+#ifdef ARENA_PAGE_OWNER
+/*
+ * Pages are claimed from and released to the ownership map shared with
+ * userspace (ds_page_owner.h, included after this header).
+ */
+static void __arena *ds_page_owner_alloc_pages(__u32 n);
+static void ds_page_owner_free_pages(void __arena *page, __u32 n);
+#endif
+
+static inline void bpf_arena_free(void __arena *addr);
+
+#ifdef ARENA_ALLOC_STATS
+struct arena_alloc_stats __arena arena_alloc_stats;
+#define ARENA_STAT_ADD(field, n) arena_alloc_stat_add(&arena_alloc_stats, field, n)
+#else
+#define ARENA_STAT_ADD(field, n) do { } while (0)
+#endif
+
+/* Return a fragment page whose last object is gone */
+static inline void bpf_arena_release_page(void __arena *page)
+{
+	ARENA_STAT_ADD(page_frees, 1);
+	ARENA_STAT_ADD(pages_out, -1);
+#ifdef ARENA_NOSLEEP_RESERVE
+	ds_page_reserve_give_back(page);
+#elif defined(ARENA_PAGE_OWNER)
+	ds_page_owner_free_pages(page, 1);
+#else
+	bpf_arena_free_pages(&arena, page, 1);
+#endif
+}
+
+#ifdef ARENA_REMOTE_FREE
+struct arena_remote_free __arena arena_remote_free_state;
+
+static inline void bpf_arena_remote_put(void __arena *page, __u64 n)
+{
+	__u64 __arena *obj_cnt;
+
+	if (!page || !n)
+		return;
+	obj_cnt = page + PAGE_SIZE - 8;
+	if (arena_obj_put_n(obj_cnt, n))
+		bpf_arena_release_page(page);
+}
+
+/* Owner side: take back everything non-owners freed since the last drain */
+static inline void bpf_arena_remote_drain(__u32 cpu)
+{
+	struct arena_remote_list __arena *rl =
+		&arena_remote_free_state.owner[cpu & (ARENA_REMOTE_CPUS - 1)];
+	void __arena *obj, *page = NULL;
+	__u64 n = 0, total = 0, puts = 0;
+
+	if (!READ_ONCE(rl->head))
+		return;
+	obj = arena_atomic_exchange(&rl->head, NULL, ARENA_ACQUIRE);
+
+	while (obj && can_loop) {
+		void __arena * __arena *link = obj;
+		void __arena *p = (void __arena *)(((long)obj) & ~(PAGE_SIZE - 1));
+
+		cast_kern(link);
+		if (p != page) {
+			puts += !!n;
+			bpf_arena_remote_put(page, n);
+			page = p;
+			n = 0;
+		}
+		n++;
+		total++;
+		obj = READ_ONCE(*link);
+	}
+	puts += !!n;
+	bpf_arena_remote_put(page, n);
+
+	arena_atomic_add(&rl->drained, total, ARENA_RELAXED);
+	arena_atomic_add(&rl->page_puts, puts, ARENA_RELAXED);
+	arena_atomic_inc(&rl->batches);
+}
+
+/* Non-owner side: false if the push lost every CAS (caller frees in place) */
+static inline bool bpf_arena_remote_push(__u32 owner, void __arena *obj)
+{
+	struct arena_remote_list __arena *rl = &arena_remote_free_state.owner[owner];
+	void __arena * __arena *link = obj;
+	void __arena *old;
+
+	if (owner >= ARENA_REMOTE_OWNERS)
+		return false;
+	cast_kern(link);
+	for (int i = 0; i < ARENA_REMOTE_RETRIES && can_loop; i++) {
+		old = READ_ONCE(rl->head);
+		WRITE_ONCE(*link, old);
+		if (arena_atomic_cmpxchg(&rl->head, old, obj, ARENA_RELEASE, ARENA_RELAXED) == old) {
+			arena_atomic_inc(&rl->pushed);
+			return true;
+		}
+	}
+	return false;
+}
+#endif
 
 /* Helper function to handle the "Slow Path" allocation */
-static inline void __arena* bpf_arena_refill_page(int cpu)
+static inline void __arena* bpf_arena_refill_page(__u32 cls, int cpu)
 {
     void __arena *page;
+    void __arena *old = page_frag_cur_page[cls][cpu];
     __u64 __arena *obj_cnt;
 
     // 1. Allocate a fresh page
+#ifdef ARENA_NOSLEEP_RESERVE
+    page = ds_page_reserve_take(cpu);
+#elif defined(ARENA_PAGE_OWNER)
+    page = ds_page_owner_alloc_pages(1);
+#else
     page = bpf_arena_alloc_pages(&arena, NULL, 1, NUMA_NO_NODE, 0);
-    if (!page)
+#endif
+    if (!page) {
+        ARENA_STAT_ADD(failures, 1);
         return NULL;
+    }
+    ARENA_STAT_ADD(page_allocs, 1);
+    ARENA_STAT_ADD(pages_out, 1);
 
     // 2. Prepare the page
     cast_kern(page);
 
     // 3. Update global per-CPU state
-    page_frag_cur_page[cpu] = page;
-    page_frag_cur_offset[cpu] = PAGE_SIZE - 8;
+    page_frag_cur_page[cls][cpu] = page;
+    page_frag_cur_offset[cls][cpu] = PAGE_SIZE - 8;
 
     // 4. Initialize object counter at the end of the page
     obj_cnt = page + PAGE_SIZE - 8;
-    *obj_cnt = 0;
+    *obj_cnt = ARENA_PAGE_HOLD | ARENA_PAGE_TAG(cpu & (ARENA_REMOTE_CPUS - 1));
+
+    // 5. Drop the hold on the page we moved off (frees it if it was the last)
+    if (old)
+        bpf_arena_free(old);
 
     return page;
 }
@@ -169,19 +494,26 @@ static inline void __arena* bpf_arena_alloc(unsigned int size)
 {
     __u64 __arena *obj_cnt;
     __u32 cpu = bpf_get_smp_processor_id();
-    void __arena *page = page_frag_cur_page[cpu];
-    int __arena *cur_offset = &page_frag_cur_offset[cpu];
+    __u32 cls = bpf_arena_frag_class(cpu);
+    void __arena *page;
+    int __arena *cur_offset = &page_frag_cur_offset[cls][cpu];
     int offset;
 
     size = round_up(size, 8);
     if (size >= PAGE_SIZE - 8)
         return NULL;
 
+#ifdef ARENA_REMOTE_FREE
+    // Take back objects other CPUs and userspace freed from our pages
+    bpf_arena_remote_drain(cpu);
+#endif
+    page = page_frag_cur_page[cls][cpu];
+
     // CHECK: Do we need to refill?
     // Condition A: We don't have a page yet (!page)
     // Condition B: We have a page, but not enough space (*cur_offset - size < 0)
     if (!page || (*cur_offset - size < 0)) {
-        page = bpf_arena_refill_page(cpu);
+        page = bpf_arena_refill_page(cls, cpu);
         if (!page)
             return NULL;
         // Note: The refill helper has already reset *cur_offset to (PAGE_SIZE - 8)
@@ -194,7 +526,7 @@ static inline void __arena* bpf_arena_alloc(unsigned int size)
     offset = *cur_offset - size;
     obj_cnt = page + PAGE_SIZE - 8;
 
-    (*obj_cnt)++;
+    arena_obj_get(obj_cnt);
     *cur_offset = offset;
 
     return page + offset;
@@ -202,12 +534,62 @@ static inline void __arena* bpf_arena_alloc(unsigned int size)
 
 static inline void bpf_arena_free(void __arena *addr)
 {
+	void __arena *page;
 	__u64 __arena *obj_cnt;
 
-	addr = (void __arena *)(((long)addr) & ~(PAGE_SIZE - 1));
-	obj_cnt = addr + PAGE_SIZE - 8;
-	if (--(*obj_cnt) == 0)
-		bpf_arena_free_pages(&arena, addr, 1);
+	page = (void __arena *)(((long)addr) & ~(PAGE_SIZE - 1));
+	obj_cnt = page + PAGE_SIZE - 8;
+#ifdef ARENA_REMOTE_FREE
+	{
+		__u32 owner = ARENA_PAGE_OWNER_OF(READ_ONCE(*obj_cnt));
+
+		if (owner < ARENA_REMOTE_OWNERS &&
+		    owner != (bpf_get_smp_processor_id() & (ARENA_REMOTE_CPUS - 1)) &&
+		    bpf_arena_remote_push(owner, addr))
+			return;
+	}
+#endif
+	if (arena_obj_put(obj_cnt))
+		bpf_arena_release_page(page);
+}
+
+/* Sleepable context only, like bpf_arena_refill_page() */
+static inline void __arena* bpf_arena_alloc_large(__u64 size)
+{
+	__u64 page_cnt = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	void __arena *run;
+
+	if (!size || page_cnt > ARENA_LARGE_MAX_PAGES)
+		return NULL;
+
+#ifdef ARENA_PAGE_OWNER
+	run = ds_page_owner_alloc_pages((__u32)page_cnt);
+#else
+	run = bpf_arena_alloc_pages(&arena, NULL, (__u32)page_cnt, NUMA_NO_NODE, 0);
+#endif
+	if (!run) {
+		ARENA_STAT_ADD(failures, 1);
+		return NULL;
+	}
+	ARENA_STAT_ADD(page_allocs, 1);
+	ARENA_STAT_ADD(pages_out, (__s64)page_cnt);
+	return run;
+}
+
+static inline void bpf_arena_free_large(void __arena *addr, __u64 size)
+{
+	__u64 page_cnt = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	if (!addr || !size || page_cnt > ARENA_LARGE_MAX_PAGES)
+		return;
+
+	ARENA_STAT_ADD(page_frees, 1);
+	ARENA_STAT_ADD(pages_out, -(__s64)page_cnt);
+#ifdef ARENA_PAGE_OWNER
+	ds_page_owner_free_pages(addr, (__u32)page_cnt);
+#else
+	bpf_arena_free_pages(&arena, addr, (__u32)page_cnt);
+#endif
 }
 
 #else /* !__BPF__ */
@@ -217,8 +599,10 @@ static inline void bpf_arena_free(void __arena *addr)
  * ======================================================================== */
 
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -238,6 +622,55 @@ static void *bpf_arena_userspace_cur_page;
 static size_t bpf_arena_userspace_cur_offset;
 static atomic_flag bpf_arena_userspace_lock = ATOMIC_FLAG_INIT;
 
+/*
+ * Page runs returned by bpf_arena_free_large(), reused first-fit. The
+ * table starts with ARENA_LARGE_FREE_RUNS entries in place and doubles on
+ * the heap when a free finds it full. Only a failed malloc() loses a run:
+ * its pages stay unused until the range is reset and are counted in
+ * bpf_arena_userspace_lost_pages.
+ */
+#ifndef ARENA_LARGE_FREE_RUNS
+#define ARENA_LARGE_FREE_RUNS 64
+#endif
+
+struct bpf_arena_userspace_run {
+	size_t off;
+	size_t pages;
+};
+
+static struct bpf_arena_userspace_run bpf_arena_userspace_free_runs_init[ARENA_LARGE_FREE_RUNS];
+static struct bpf_arena_userspace_run *bpf_arena_userspace_free_runs =
+	bpf_arena_userspace_free_runs_init;
+static unsigned int bpf_arena_userspace_free_runs_cap = ARENA_LARGE_FREE_RUNS;
+static unsigned int bpf_arena_userspace_nr_free_runs;
+static size_t bpf_arena_userspace_lost_pages;
+
+#ifdef ARENA_ALLOC_STATS
+static struct arena_alloc_stats bpf_arena_userspace_stats;
+#define ARENA_STAT_ADD(field, n) arena_alloc_stat_add(&bpf_arena_userspace_stats, field, n)
+#else
+#define ARENA_STAT_ADD(field, n) do { } while (0)
+#endif
+
+#ifdef ARENA_PAGE_OWNER
+/*
+ * Pages are claimed from the ownership map the BPF program shares
+ * (ds_page_owner.h, included after this header) instead of bumped from
+ * the range, and a page whose last object is freed goes back to it. As on
+ * the BPF side, the allocator holds one count on its current page.
+ */
+struct ds_page_owner;
+static struct ds_page_owner *bpf_arena_userspace_owner;
+static void *ds_page_owner_user_alloc(struct ds_page_owner *o, __u32 n);
+static void ds_page_owner_user_free(struct ds_page_owner *o, void *page, __u32 n);
+
+/* Call after bpf_arena_userspace_set_range() and ds_page_owner_init_c() */
+static inline void bpf_arena_userspace_set_owner(struct ds_page_owner *o)
+{
+	bpf_arena_userspace_owner = o;
+}
+#endif
+
 static inline void bpf_arena_userspace_set_range(void *base, size_t size)
 {
 	uintptr_t start;
@@ -271,8 +704,118 @@ static inline void bpf_arena_userspace_set_range(void *base, size_t size)
 	bpf_arena_userspace_next_page_off = 0;
 	bpf_arena_userspace_cur_page = NULL;
 	bpf_arena_userspace_cur_offset = 0;
+	bpf_arena_userspace_nr_free_runs = 0;
+	bpf_arena_userspace_lost_pages = 0;
 }
 
+/* Called with bpf_arena_userspace_lock held and the table full */
+static inline bool bpf_arena_userspace_grow_free_runs(void)
+{
+	unsigned int cap = bpf_arena_userspace_free_runs_cap * 2;
+	struct bpf_arena_userspace_run *runs;
+
+	runs = malloc((size_t)cap * sizeof(*runs));
+	if (!runs)
+		return false;
+	memcpy(runs, bpf_arena_userspace_free_runs,
+	       (size_t)bpf_arena_userspace_nr_free_runs * sizeof(*runs));
+	if (bpf_arena_userspace_free_runs != bpf_arena_userspace_free_runs_init)
+		free(bpf_arena_userspace_free_runs);
+	bpf_arena_userspace_free_runs = runs;
+	bpf_arena_userspace_free_runs_cap = cap;
+	return true;
+}
+
+/* Return a fragment page whose last object is gone */
+static inline void bpf_arena_userspace_release_page(void *page)
+{
+#ifdef ARENA_PAGE_OWNER
+	ARENA_STAT_ADD(page_frees, 1);
+	ARENA_STAT_ADD(pages_out, -1);
+	ds_page_owner_user_free(bpf_arena_userspace_owner, page, 1);
+#else
+	(void)page;	/* the bump range never hands a page out twice */
+#endif
+}
+
+#ifdef ARENA_REMOTE_FREE
+static struct arena_remote_free *bpf_arena_userspace_remote;
+
+/* The BPF program's arena_remote_free_state, e.g. from the skeleton */
+static inline void bpf_arena_userspace_set_remote(struct arena_remote_free *rf)
+{
+	bpf_arena_userspace_remote = rf;
+}
+
+static inline void bpf_arena_userspace_remote_put(void *page, __u64 n)
+{
+	unsigned long long *obj_cnt;
+
+	if (!page || !n)
+		return;
+	obj_cnt = (unsigned long long *)((char *)page + bpf_arena_userspace_page_size - 8);
+	if (arena_obj_put_n(obj_cnt, n))
+		bpf_arena_userspace_release_page(page);
+}
+
+/* Owner side, under the allocator lock; see bpf_arena_remote_drain() */
+static inline void bpf_arena_userspace_remote_drain(void)
+{
+	struct arena_remote_list *rl;
+	void *obj, *page = NULL;
+	__u64 n = 0, total = 0, puts = 0;
+
+	if (!bpf_arena_userspace_remote)
+		return;
+	rl = &bpf_arena_userspace_remote->owner[ARENA_REMOTE_USER];
+	if (!__atomic_load_n(&rl->head, __ATOMIC_RELAXED))
+		return;
+	obj = __atomic_exchange_n(&rl->head, NULL, __ATOMIC_ACQUIRE);
+
+	while (obj) {
+		void *p = (void *)((uintptr_t)obj & ~(uintptr_t)(bpf_arena_userspace_page_size - 1));
+
+		if (p != page) {
+			puts += !!n;
+			bpf_arena_userspace_remote_put(page, n);
+			page = p;
+			n = 0;
+		}
+		n++;
+		total++;
+		obj = *(void **)obj;
+	}
+	puts += !!n;
+	bpf_arena_userspace_remote_put(page, n);
+
+	__atomic_fetch_add(&rl->drained, total, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&rl->page_puts, puts, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&rl->batches, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Non-owner side: queue @obj for @owner. Returns false if no lists are set
+ * up, and the caller then frees in place. Also used directly by tests and
+ * benchmarks that stand in for the kernel.
+ */
+static inline bool bpf_arena_remote_push(__u32 owner, void __arena *obj)
+{
+	struct arena_remote_list *rl;
+	void *old;
+
+	if (!bpf_arena_userspace_remote || owner >= ARENA_REMOTE_OWNERS)
+		return false;
+	rl = &bpf_arena_userspace_remote->owner[owner];
+	old = __atomic_load_n(&rl->head, __ATOMIC_RELAXED);
+	do {
+		*(void **)obj = old;
+	} while (!__atomic_compare_exchange_n(&rl->head, &old, obj, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	__atomic_fetch_add(&rl->pushed, 1, __ATOMIC_RELAXED);
+	return true;
+}
+#endif
+
 static inline void __arena* bpf_arena_alloc(unsigned int size __attribute__((unused)))
 {
 	void *page;
@@ -292,29 +835,52 @@ static inline void __arena* bpf_arena_alloc(unsigned int size __attribute__((unu
 	while (atomic_flag_test_and_set_explicit(&bpf_arena_userspace_lock, memory_order_acquire)) {
 	}
 
+#ifdef ARENA_REMOTE_FREE
+	bpf_arena_userspace_remote_drain();
+#endif
+
 	page = bpf_arena_userspace_cur_page;
 	if (!page || bpf_arena_userspace_cur_offset < aligned) {
-		if (bpf_arena_userspace_next_page_off > bpf_arena_userspace_size ||
-		    bpf_arena_userspace_page_size >
+		void *old = page;
+
+#ifdef ARENA_PAGE_OWNER
+		page = ds_page_owner_user_alloc(bpf_arena_userspace_owner, 1);
+#else
+		page = NULL;
+		if (bpf_arena_userspace_next_page_off <= bpf_arena_userspace_size &&
+		    bpf_arena_userspace_page_size <=
 			bpf_arena_userspace_size - bpf_arena_userspace_next_page_off) {
+			page = (char *)bpf_arena_userspace_base + bpf_arena_userspace_next_page_off;
+			bpf_arena_userspace_next_page_off += bpf_arena_userspace_page_size;
+		}
+#endif
+		if (!page) {
+			ARENA_STAT_ADD(failures, 1);
 			atomic_flag_clear_explicit(&bpf_arena_userspace_lock, memory_order_release);
 			return NULL;
 		}
-
-		page = (char *)bpf_arena_userspace_base + bpf_arena_userspace_next_page_off;
-		bpf_arena_userspace_next_page_off += bpf_arena_userspace_page_size;
+		ARENA_STAT_ADD(page_allocs, 1);
+		ARENA_STAT_ADD(pages_out, 1);
 		bpf_arena_userspace_cur_page = page;
 		bpf_arena_userspace_cur_offset = bpf_arena_userspace_page_size - 8;
 
 		obj_cnt = (unsigned long long *)((char *)page +
 						bpf_arena_userspace_page_size - 8);
-		*obj_cnt = 0;
+		*obj_cnt = ARENA_PAGE_HOLD | ARENA_PAGE_TAG(ARENA_REMOTE_USER);
+
+		/* Drop the hold on the old page; the other side may have freed the rest */
+		if (old) {
+			obj_cnt = (unsigned long long *)((char *)old +
+							bpf_arena_userspace_page_size - 8);
+			if (arena_obj_put(obj_cnt))
+				bpf_arena_userspace_release_page(old);
+		}
 	}
 
 	offset = bpf_arena_userspace_cur_offset - aligned;
 	obj_cnt = (unsigned long long *)((char *)page +
 					bpf_arena_userspace_page_size - 8);
-	(*obj_cnt)++;
+	arena_obj_get(obj_cnt);
 	bpf_arena_userspace_cur_offset = offset;
 
 	atomic_flag_clear_explicit(&bpf_arena_userspace_lock, memory_order_release);
@@ -334,8 +900,119 @@ static inline void bpf_arena_free(void __arena *addr __attribute__((unused)))
 	obj_cnt = (unsigned long long *)((char *)page +
 					bpf_arena_userspace_page_size - 8);
 
+#ifdef ARENA_REMOTE_FREE
+	{
+		__u32 owner = ARENA_PAGE_OWNER_OF(__atomic_load_n(obj_cnt, __ATOMIC_RELAXED));
+
+		/* A page a kernel CPU carves: queue the object for that CPU */
+		if (owner < ARENA_REMOTE_USER && bpf_arena_remote_push(owner, addr))
+			return;
+	}
+#endif
+
+#if defined(ARENA_PAGE_OWNER) || defined(ARENA_REMOTE_FREE)
+	if (arena_obj_put(obj_cnt))
+		bpf_arena_userspace_release_page(page);
+#else
 	if (*obj_cnt > 0)
 		(*obj_cnt)--;
+#endif
+}
+
+static inline void __arena* bpf_arena_alloc_large(__u64 size)
+{
+	size_t pg = bpf_arena_userspace_page_size;
+	size_t pages, off = 0;
+	int found = 0;
+
+	if (!bpf_arena_userspace_base || !pg || !size)
+		return NULL;
+	pages = (size_t)((size + pg - 1) / pg);
+	if (pages > ARENA_LARGE_MAX_PAGES)
+		return NULL;
+
+#ifdef ARENA_PAGE_OWNER
+	{
+		void *run = ds_page_owner_user_alloc(bpf_arena_userspace_owner, (__u32)pages);
+
+		if (!run) {
+			ARENA_STAT_ADD(failures, 1);
+			return NULL;
+		}
+		ARENA_STAT_ADD(page_allocs, 1);
+		ARENA_STAT_ADD(pages_out, (__s64)pages);
+		return run;
+	}
+#endif
+
+	while (atomic_flag_test_and_set_explicit(&bpf_arena_userspace_lock, memory_order_acquire)) {
+	}
+
+	for (unsigned int i = 0; i < bpf_arena_userspace_nr_free_runs; i++) {
+		struct bpf_arena_userspace_run *run = &bpf_arena_userspace_free_runs[i];
+
+		if (run->pages < pages)
+			continue;
+		off = run->off;
+		run->off += pages * pg;
+		run->pages -= pages;
+		if (!run->pages)
+			*run = bpf_arena_userspace_free_runs[--bpf_arena_userspace_nr_free_runs];
+		found = 1;
+		break;
+	}
+
+	if (!found) {
+		if (bpf_arena_userspace_next_page_off > bpf_arena_userspace_size ||
+		    pages * pg > bpf_arena_userspace_size - bpf_arena_userspace_next_page_off) {
+			ARENA_STAT_ADD(failures, 1);
+			atomic_flag_clear_explicit(&bpf_arena_userspace_lock, memory_order_release);
+			return NULL;
+		}
+		off = bpf_arena_userspace_next_page_off;
+		bpf_arena_userspace_next_page_off += pages * pg;
+	}
+
+	ARENA_STAT_ADD(page_allocs, 1);
+	ARENA_STAT_ADD(pages_out, (__s64)pages);
+	atomic_flag_clear_explicit(&bpf_arena_userspace_lock, memory_order_release);
+
+	/* Fresh pages are zero like the kernel's; reused runs are cleared to match */
+	if (found)
+		memset((char *)bpf_arena_userspace_base + off, 0, pages * pg);
+	return (void __arena *)((char *)bpf_arena_userspace_base + off);
+}
+
+static inline void bpf_arena_free_large(void __arena *addr, __u64 size)
+{
+	size_t pg = bpf_arena_userspace_page_size;
+	size_t off, pages;
+
+	if (!addr || !pg || !size || !bpf_arena_userspace_base)
+		return;
+	off = (size_t)((char *)addr - (char *)bpf_arena_userspace_base);
+	pages = (size_t)((size + pg - 1) / pg);
+	if (pages > ARENA_LARGE_MAX_PAGES)
+		return;
+
+	ARENA_STAT_ADD(page_frees, 1);
+	ARENA_STAT_ADD(pages_out, -(__s64)pages);
+#ifdef ARENA_PAGE_OWNER
+	ds_page_owner_user_free(bpf_arena_userspace_owner, addr, (__u32)pages);
+	return;
+#endif
+
+	while (atomic_flag_test_and_set_explicit(&bpf_arena_userspace_lock, memory_order_acquire)) {
+	}
+
+	if (bpf_arena_userspace_nr_free_runs < bpf_arena_userspace_free_runs_cap ||
+	    bpf_arena_userspace_grow_free_runs())
+		bpf_arena_userspace_free_runs[bpf_arena_userspace_nr_free_runs++] =
+			(struct bpf_arena_userspace_run){ .off = off, .pages = pages };
+	else
+		bpf_arena_userspace_lost_pages += pages;
+
+	atomic_flag_clear_explicit(&bpf_arena_userspace_lock, memory_order_release);
 }
 
 /* ========================================================================
@@ -384,6 +1061,12 @@ static inline void bpf_arena_free(void __arena *addr __attribute__((unused)))
 #define arena_atomic_dec(ptr) arena_atomic_sub((ptr), 1, ARENA_RELAXED)
 #define arena_memory_barrier() __atomic_thread_fence(ARENA_SEQ_CST)
 
+/* C11 fences: rmb keeps earlier loads before later accesses, wmb keeps
+ * earlier accesses before later stores */
+#define arena_smp_mb() __atomic_thread_fence(ARENA_SEQ_CST)
+#define arena_smp_rmb() __atomic_thread_fence(ARENA_ACQUIRE)
+#define arena_smp_wmb() __atomic_thread_fence(ARENA_RELEASE)
+
 #endif /* __BPF__ */
 
 /* ========================================================================
@@ -0,0 +1,533 @@
+#!/usr/bin/env python3
+"""
+Memory-order relaxation explorer.
+
+Enumerates the ordering arguments of one data structure header
+(arena_atomic_* orders in the _c functions, smp_load_acquire /
+smp_store_release in the _lkmm functions), builds one variant per
+single-step weakening, and judges each variant:
+
+  1. litmus: docs/litmus/*.litmus files that declare a matching
+     "relax-site" are rewritten the same way and run under herd7 with the
+     Linux kernel memory model; any outcome other than "Never" rejects
+     the variant. Skipped when herd7 or the LKMM cat files are missing.
+  2. stress: the usertest is rebuilt at -O2 against the variant with
+     no-sleep knobs and run several times; a non-zero exit or a
+     produced/consumed mismatch rejects it.
+  3. bench: surviving _c variants are benchmarked against the unmodified
+     header (median of several runs) and ranked by speedup.
+
+A stress pass is evidence, not proof: on x86 acquire and release compile
+to plain moves, so only the litmus step can reject most weakenings there.
+_lkmm functions only run in BPF, so they are judged by the litmus step
+alone.
+
+Example:
+  scripts/relax_explorer.py                       # ds_vyukhov.h defaults
+  scripts/relax_explorer.py --list
+  LKMM_DIR=~/linux/tools/memory-model scripts/relax_explorer.py --runs 5
+"""
+
+from __future__ import annotations
+
+import argparse
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+from dataclasses import dataclass, field
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+import usertests  # noqa: E402
+
+
+DEFAULT_HEADER = "include/ds_vyukhov.h"
+DEFAULT_STRESS = "usertest/usertest_vyukhov.c"
+DEFAULT_STRESS_DEFINES = [
+	"USERTEST_NUM_PRODUCERS=4",
+	"USERTEST_NUM_CONSUMERS=4",
+	"USERTEST_ITEMS_PER_PRODUCER=20000",
+	"USERTEST_PRODUCER_SLEEP_SEC=0",
+	"USERTEST_POLL_US=0",
+	"USERTEST_VYUKHOV_CAPACITY=16u",
+]
+DEFAULT_BENCH = "bench/bench_vyukhov.c"
+DEFAULT_BENCH_ARGS = "-t 2 -n 1000000"
+DEFAULT_TIMEOUT_SEC = 120
+
+CFLAGS = ["-g", "-Wall", "-Wextra", "-O2", "-DLKMM_OPTIMIZED"]
+
+# One weakening step per order; the explorer tries each neighbour separately
+WEAKER = {
+	"ARENA_SEQ_CST": ["ARENA_ACQ_REL"],
+	"ARENA_ACQ_REL": ["ARENA_ACQUIRE", "ARENA_RELEASE"],
+	"ARENA_ACQUIRE": ["ARENA_RELAXED"],
+	"ARENA_RELEASE": ["ARENA_RELAXED"],
+}
+
+# Orders a plain load / store may carry
+LOAD_ORDERS = {"ARENA_RELAXED", "ARENA_ACQUIRE", "ARENA_SEQ_CST"}
+STORE_ORDERS = {"ARENA_RELAXED", "ARENA_RELEASE", "ARENA_SEQ_CST"}
+ORDER_RANK = {"ARENA_RELAXED": 0, "ARENA_ACQUIRE": 1, "ARENA_RELEASE": 1,
+	      "ARENA_ACQ_REL": 2, "ARENA_SEQ_CST": 3}
+
+# call name -> (kind, index of the first order argument, number of orders)
+C_CALLS = {
+	"arena_atomic_load": ("load", 1, 1),
+	"arena_atomic_store": ("store", 2, 1),
+	"arena_atomic_cmpxchg": ("rmw", 3, 2),
+	"arena_atomic_exchange": ("rmw", 2, 1),
+	"arena_atomic_add": ("rmw", 2, 1),
+	"arena_atomic_sub": ("rmw", 2, 1),
+	"arena_atomic_and": ("rmw", 2, 1),
+	"arena_atomic_or": ("rmw", 2, 1),
+}
+LKMM_CALLS = {
+	"smp_load_acquire": "load",
+	"smp_store_release": "store",
+}
+
+FUNC_RE = re.compile(r"^static inline [^(\n]*?\b(\w+)\(", re.MULTILINE)
+CALL_RE = re.compile(r"\b(" + "|".join(list(C_CALLS) + list(LKMM_CALLS)) + r")\s*\(")
+OBSERVATION_RE = re.compile(r"^Observation \S+ (Never|Sometimes|Always)\b", re.MULTILINE)
+
+
+def repo_root() -> Path:
+	return Path(__file__).resolve().parents[1]
+
+
+@dataclass
+class Site:
+	func: str
+	api: str		# "c" or "lkmm"
+	op: str			# function name without ds_<name>_ prefix and api suffix
+	field: str		# last member named by the address argument
+	kind: str		# load / store / rmw
+	line: int
+	order: str		# current order (ARENA_* or the smp_* primitive)
+	start: int		# text span to replace
+	end: int
+	role: str = ""		# "success" / "failure" for cmpxchg
+
+	def label(self) -> str:
+		role = f" ({self.role})" if self.role else ""
+		return f"{self.func}:{self.line} {self.field} {self.kind}{role}"
+
+
+@dataclass
+class Variant:
+	site: Site
+	new: str
+	text: str		# full header text with the weakening applied
+	verdict: str = "pending"
+	reason: str = ""
+	evidence: list[str] = field(default_factory=list)
+	mops: float | None = None
+
+	def change(self) -> str:
+		if self.site.api == "lkmm":
+			return "-> " + self.new
+		return f"{short(self.site.order)} -> {short(self.new)}"
+
+
+def short(order: str) -> str:
+	return order.replace("ARENA_", "")
+
+
+def split_args(text: str, open_idx: int) -> tuple[list[tuple[int, int]], int]:
+	"""Spans of the top-level arguments of the call whose '(' is at open_idx."""
+	depth = 0
+	spans: list[tuple[int, int]] = []
+	start = open_idx + 1
+	for i in range(open_idx, len(text)):
+		c = text[i]
+		if c == "(":
+			depth += 1
+		elif c == ")":
+			depth -= 1
+			if depth == 0:
+				spans.append((start, i))
+				return spans, i + 1
+		elif c == "," and depth == 1:
+			spans.append((start, i))
+			start = i + 1
+	raise ValueError(f"unbalanced call at offset {open_idx}")
+
+
+def last_member(expr: str) -> str:
+	names = re.findall(r"[A-Za-z_]\w*", expr)
+	return names[-1] if names else expr.strip()
+
+
+def enumerate_sites(text: str, prefix: str) -> list[Site]:
+	funcs = [(m.start(), m.group(1)) for m in FUNC_RE.finditer(text)]
+	sites: list[Site] = []
+
+	for idx, (fstart, fname) in enumerate(funcs):
+		fend = funcs[idx + 1][0] if idx + 1 < len(funcs) else len(text)
+		if fname.endswith("_c"):
+			api, base = "c", fname[:-2]
+		elif fname.endswith("_lkmm"):
+			api, base = "lkmm", fname[:-5]
+		else:
+			continue
+		op = base[len(prefix):] if base.startswith(prefix) else base
+
+		for m in CALL_RE.finditer(text, fstart, fend):
+			name = m.group(1)
+			spans, _ = split_args(text, m.end() - 1)
+			line = text.count("\n", 0, m.start()) + 1
+			fld = last_member(text[spans[0][0]:spans[0][1]])
+
+			if api == "lkmm" and name in LKMM_CALLS:
+				sites.append(Site(fname, api, op, fld, LKMM_CALLS[name], line,
+						  name, m.start(), spans[-1][1] + 1))
+				continue
+			if api != "c" or name not in C_CALLS:
+				continue
+
+			kind, first, count = C_CALLS[name]
+			for k in range(count):
+				if first + k >= len(spans):
+					break
+				s, e = spans[first + k]
+				order = text[s:e].strip()
+				if order not in ORDER_RANK:
+					continue
+				role = "" if count == 1 else ("success" if k == 0 else "failure")
+				lead = len(text[s:e]) - len(text[s:e].lstrip())
+				sites.append(Site(fname, api, op, fld, kind, line, order,
+						  s + lead, s + lead + len(order), role))
+	return sites
+
+
+def lkmm_relaxed(text: str, site: Site) -> str:
+	"""smp_load_acquire(p) -> READ_ONCE(*(p)); smp_store_release(p, v) -> WRITE_ONCE(*(p), v)."""
+	call = text[site.start:site.end]
+	spans, _ = split_args(call, call.index("("))
+	args = [call[s:e].strip() for s, e in spans]
+	if site.kind == "load":
+		return f"READ_ONCE(*({args[0]}))"
+	return f"WRITE_ONCE(*({args[0]}), {args[1]})"
+
+
+def weakenings(text: str, sites: list[Site]) -> list[Variant]:
+	variants: list[Variant] = []
+	for site in sites:
+		if site.api == "lkmm":
+			new_call = lkmm_relaxed(text, site)
+			variants.append(Variant(site, "READ_ONCE" if site.kind == "load" else "WRITE_ONCE",
+						text[:site.start] + new_call + text[site.end:]))
+			continue
+		for new in WEAKER.get(site.order, []):
+			if site.kind == "load" and new not in LOAD_ORDERS:
+				continue
+			if site.kind == "store" and new not in STORE_ORDERS:
+				continue
+			if site.role == "failure" and new in ("ARENA_RELEASE", "ARENA_ACQ_REL"):
+				continue
+			variants.append(Variant(site, new, text[:site.start] + new + text[site.end:]))
+	return variants
+
+
+# ------------------------------------------------------------------------
+# Litmus
+# ------------------------------------------------------------------------
+
+@dataclass
+class Litmus:
+	path: Path
+	text: str
+	apis: set[str]
+	sites: list[tuple[str, str, str, str]]	# (op, field, kind, exact text)
+
+
+def load_litmus(paths: list[Path]) -> list[Litmus]:
+	tests = []
+	for p in paths:
+		text = p.read_text(encoding="utf-8")
+		apis_m = re.search(r"relax-api:\s*([\w ]+)", text)
+		sites = [(m.group(1), m.group(2), m.group(3), m.group(4).strip())
+			 for m in re.finditer(r"relax-site:\s*(\w+)\s+(\w+)\s+(\w+)\s*=\s*(.+)", text)]
+		if not apis_m or not sites:
+			continue
+		tests.append(Litmus(p, text, set(apis_m.group(1).split()), sites))
+	return tests
+
+
+def litmus_rewrite(body: str, kind: str, exact: str, new: str) -> str:
+	"""Weaken every occurrence of @exact in the litmus body (after the header comment)."""
+	m = re.match(r"(\w+)\((.*)\)$", exact)
+	if not m:
+		return body
+	args = [a.strip() for a in m.group(2).split(",")]
+	if new in ("ARENA_RELAXED", "READ_ONCE", "WRITE_ONCE"):
+		if kind == "load":
+			repl = f"READ_ONCE(*{args[0]})"
+		elif kind == "store":
+			repl = f"WRITE_ONCE(*{args[0]}, {args[1]})"
+		else:
+			repl = f"{m.group(1)}_relaxed({m.group(2)})"
+	elif kind == "rmw":
+		suffix = {"ARENA_ACQUIRE": "_acquire", "ARENA_RELEASE": "_release"}.get(new, "")
+		repl = f"{m.group(1)}{suffix}({m.group(2)})"
+	else:
+		return body
+	return body.replace(exact, repl)
+
+
+def herd7_available(lkmm_dir: Path | None) -> str | None:
+	if not shutil.which("herd7"):
+		return "herd7 not in PATH"
+	if not lkmm_dir or not (lkmm_dir / "linux-kernel.cfg").exists():
+		return "LKMM cat files not found (set LKMM_DIR or --lkmm-dir to tools/memory-model)"
+	return None
+
+
+def run_herd7(text: str, name: str, lkmm_dir: Path, workdir: Path) -> str:
+	path = workdir / f"{name}.litmus"
+	path.write_text(text, encoding="utf-8")
+	p = subprocess.run(["herd7", "-conf", "linux-kernel.cfg", str(path)], cwd=str(lkmm_dir),
+			   stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True,
+			   timeout=DEFAULT_TIMEOUT_SEC)
+	m = OBSERVATION_RE.search(p.stdout)
+	return m.group(1) if m else "error"
+
+
+def check_litmus(v: Variant, tests: list[Litmus], lkmm_dir: Path, workdir: Path) -> None:
+	s = v.site
+	covered = False
+	for t in tests:
+		if s.api not in t.apis:
+			continue
+		header_end = t.text.find("*)") + 2
+		body = t.text[header_end:]
+		new_body = body
+		for op, fld, kind, exact in t.sites:
+			if (op, fld, kind) == (s.op, s.field, s.kind):
+				new_body = litmus_rewrite(new_body, kind, exact, v.new)
+		if new_body == body:
+			continue
+		covered = True
+		result = run_herd7(t.text[:header_end] + new_body, t.path.stem, lkmm_dir, workdir)
+		if result != "Never":
+			v.verdict, v.reason = "rejected", f"litmus {t.path.name}: {result}"
+			return
+	if covered:
+		v.evidence.append("litmus")
+
+
+def check_litmus_baseline(tests: list[Litmus], lkmm_dir: Path, workdir: Path) -> list[str]:
+	bad = []
+	for t in tests:
+		result = run_herd7(t.text, t.path.stem, lkmm_dir, workdir)
+		if result != "Never":
+			bad.append(f"{t.path.name}: {result}")
+	return bad
+
+
+# ------------------------------------------------------------------------
+# Build / stress / bench
+# ------------------------------------------------------------------------
+
+def make_include(root: Path, header: Path, text: str, workdir: Path) -> Path:
+	inc = workdir / "include"
+	if inc.exists():
+		shutil.rmtree(inc)
+	shutil.copytree(root / "include", inc)
+	(inc / header.name).write_text(text, encoding="utf-8")
+	return inc
+
+
+def compile_one(src: Path, out: Path, inc: Path, extra: list[str]) -> str | None:
+	cmd = ["gcc", *CFLAGS, "-I", str(inc), *extra, str(src), "-o", str(out), "-lpthread"]
+	p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+	return None if p.returncode == 0 else p.stdout.strip().splitlines()[-1]
+
+
+def run_stress(exe: Path, runs: int) -> str | None:
+	for i in range(runs):
+		try:
+			p = subprocess.run([str(exe)], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+					   text=True, timeout=DEFAULT_TIMEOUT_SEC)
+		except subprocess.TimeoutExpired:
+			return f"run {i + 1}: timeout"
+		parsed = usertests.parse_output(p.stdout)
+		if p.returncode != 0:
+			return f"run {i + 1}: rc={p.returncode}"
+		if parsed.done_produced is None or parsed.done_produced != parsed.done_consumed:
+			return f"run {i + 1}: produced/consumed counts differ"
+		if not usertests.multiset_eq(parsed.produced_pairs, parsed.consumed_pairs):
+			return f"run {i + 1}: produced/consumed pairs differ"
+	return None
+
+
+def run_bench(exe: Path, args: list[str], runs: int) -> float | None:
+	samples = []
+	for _ in range(runs):
+		p = subprocess.run([str(exe), *args], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+				   text=True, timeout=DEFAULT_TIMEOUT_SEC)
+		rows = [l.split() for l in p.stdout.splitlines() if re.match(r"^\s*\d+\s", l)]
+		if p.returncode != 0 or not rows or rows[-1][-1] != "ok":
+			return None
+		samples.append(float(rows[-1][1]))
+	return statistics.median(samples)
+
+
+def build_and_measure(root: Path, header: Path, text: str, args, workdir: Path,
+		      stress_only: bool = False) -> tuple[str | None, float | None]:
+	"""Returns (failure reason or None, bench Mops or None)."""
+	inc = make_include(root, header, text, workdir)
+	stress_exe = workdir / "stress"
+	defines = [f"-D{d}" for d in args.stress_define]
+	err = compile_one(root / args.stress, stress_exe, inc, defines)
+	if err:
+		return f"build: {err}", None
+	err = run_stress(stress_exe, args.runs)
+	if err:
+		return f"stress {err}", None
+	if stress_only or not args.bench:
+		return None, None
+
+	bench_exe = workdir / "bench"
+	err = compile_one(root / args.bench, bench_exe, inc, ["-I", str(root / "bench")])
+	if err:
+		return f"build: {err}", None
+	return None, run_bench(bench_exe, args.bench_args.split(), args.bench_runs)
+
+
+# ------------------------------------------------------------------------
+# Report
+# ------------------------------------------------------------------------
+
+def report(variants: list[Variant], baseline: float | None, litmus_note: str | None) -> None:
+	kept = [v for v in variants if v.verdict == "kept"]
+	rejected = [v for v in variants if v.verdict == "rejected"]
+	unjudged = [v for v in variants if v.verdict == "unjudged"]
+
+	def key(v: Variant):
+		proven = "litmus" in v.evidence
+		speed = (v.mops / baseline) if (v.mops and baseline) else 0.0
+		return (not proven, -speed)
+
+	print("=" * 96)
+	print("  Surviving relaxations, ranked (litmus-checked first, then by speedup)")
+	if baseline:
+		print(f"  Baseline: {baseline:.2f} Mops/s")
+	if litmus_note:
+		print(f"  Litmus step skipped: {litmus_note}")
+	print("  Stress-only rows are unproven: they passed, they were not shown safe")
+	print("=" * 96)
+	print(f"{'Rank':>4}  {'Site':<46} {'Change':<22} {'Evidence':<14} {'Mops/s':>7} {'Speedup':>8}")
+	for i, v in enumerate(sorted(kept, key=key), 1):
+		mops = f"{v.mops:.2f}" if v.mops else "-"
+		speed = f"{v.mops / baseline:.3f}x" if (v.mops and baseline) else "-"
+		print(f"{i:>4}  {v.site.label():<46} {v.change():<22} {'+'.join(v.evidence) or '-':<14} "
+		      f"{mops:>7} {speed:>8}")
+	if not kept:
+		print("  (none)")
+
+	print("-" * 96)
+	print("  Rejected")
+	print("-" * 96)
+	for v in rejected:
+		print(f"      {v.site.label():<46} {v.change():<22} {v.reason}")
+	if not rejected:
+		print("  (none)")
+	if unjudged:
+		print("-" * 96)
+		print("  Not judged")
+		print("-" * 96)
+		for v in unjudged:
+			print(f"      {v.site.label():<46} {v.change():<22} {v.reason}")
+	print("=" * 96)
+
+
+def main(argv: list[str]) -> int:
+	parser = argparse.ArgumentParser(description="Find memory-order relaxations that stay correct and measure them.")
+	parser.add_argument("--header", default=DEFAULT_HEADER, help="Header to explore (default: %(default)s)")
+	parser.add_argument("--stress", default=DEFAULT_STRESS, help="Usertest source used as the stress test")
+	parser.add_argument("--stress-define", action="append", default=None, metavar="NAME=VALUE",
+			    help="-D knob for the stress build (repeatable; default: no-sleep vyukhov knobs)")
+	parser.add_argument("--bench", default=DEFAULT_BENCH, help="Benchmark source ('' to skip benchmarking)")
+	parser.add_argument("--bench-args", default=DEFAULT_BENCH_ARGS, help="Benchmark arguments")
+	parser.add_argument("--runs", type=int, default=3, help="Stress runs per variant")
+	parser.add_argument("--bench-runs", type=int, default=3, help="Benchmark runs per variant (median)")
+	parser.add_argument("--litmus", default="docs/litmus/*.litmus", help="Litmus glob, relative to the repo")
+	parser.add_argument("--lkmm-dir", default=os.environ.get("LKMM_DIR"),
+			    help="Kernel tools/memory-model directory (default: $LKMM_DIR)")
+	parser.add_argument("--only", default=None, help="Only sites whose function matches this regex")
+	parser.add_argument("--list", action="store_true", help="List ordering sites and exit")
+	parser.add_argument("--keep", action="store_true", help="Keep the work directory")
+	args = parser.parse_args(argv)
+	if args.stress_define is None:
+		args.stress_define = DEFAULT_STRESS_DEFINES
+
+	root = repo_root()
+	header = root / args.header
+	text = header.read_text(encoding="utf-8")
+	prefix = header.stem + "_"
+	sites = enumerate_sites(text, prefix)
+	if args.only:
+		sites = [s for s in sites if re.search(args.only, s.func)]
+
+	if args.list:
+		for s in sites:
+			print(f"{s.label():<50} api={s.api:<4} order={short(s.order)}")
+		return 0
+
+	variants = weakenings(text, sites)
+	lkmm_dir = Path(args.lkmm_dir).expanduser() if args.lkmm_dir else None
+	litmus_note = herd7_available(lkmm_dir)
+	tests = load_litmus(sorted(root.glob(args.litmus)))
+	if not tests and not litmus_note:
+		litmus_note = f"no litmus files with relax-site tags match {args.litmus}"
+
+	workdir = Path(tempfile.mkdtemp(prefix="relax_explorer."))
+	try:
+		if not litmus_note:
+			bad = check_litmus_baseline(tests, lkmm_dir, workdir)
+			if bad:
+				sys.stderr.write("Unmodified litmus tests do not hold: " + "; ".join(bad) + "\n")
+				return 1
+
+		print(f"{args.header}: {len(sites)} ordering sites, {len(variants)} single-step weakenings")
+		err, baseline = build_and_measure(root, header, text, args, workdir)
+		if err:
+			sys.stderr.write(f"Unmodified header fails: {err}\n")
+			return 1
+
+		for n, v in enumerate(variants, 1):
+			print(f"[{n}/{len(variants)}] {v.site.label()} {v.change()}", flush=True)
+			if not litmus_note:
+				check_litmus(v, tests, lkmm_dir, workdir)
+				if v.verdict == "rejected":
+					continue
+			if v.site.api == "c":
+				err, v.mops = build_and_measure(root, header, v.text, args, workdir)
+				if err:
+					v.verdict, v.reason = "rejected", err
+					continue
+				v.evidence.append("stress")
+			elif "litmus" not in v.evidence:
+				# _lkmm code only runs in BPF, so the litmus step is all there is
+				v.verdict = "unjudged"
+				v.reason = litmus_note or "no litmus test covers this site"
+				continue
+			v.verdict = "kept"
+	finally:
+		if args.keep:
+			print(f"Work directory kept at {workdir}")
+		else:
+			shutil.rmtree(workdir, ignore_errors=True)
+
+	report(variants, baseline, litmus_note)
+	return 0
+
+
+if __name__ == "__main__":
+	raise SystemExit(main(sys.argv[1:]))
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF-side arena allocator microbenchmark
+ *
+ * No attach points: every program is SEC("syscall") and run from the
+ * loader with BPF_PROG_TEST_RUN, one call per thread and step. Timing is
+ * taken with bpf_ktime_get_ns() inside the program, so the syscall itself
+ * is not measured. The context is a single __u32: the caller's row, which
+ * picks its slot array and result counters (one row per loader thread,
+ * each thread pinned to its own CPU).
+ *
+ * The allocator is the default build: fragment pages straight from
+ * bpf_arena_alloc_pages(), page-source calls counted by ARENA_ALLOC_STATS.
+ */
+
+#define BPF_NO_KFUNC_PROTOTYPES
+#include <vmlinux.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "bpf_experimental.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARENA);
+	__uint(map_flags, BPF_F_MMAPABLE);
+	__uint(max_entries, 16384); /* 64 MB: slot arrays plus every live object */
+#ifdef __TARGET_ARCH_arm64
+	__ulong(map_extra, 0x1ull << 32);
+#else
+	__ulong(map_extra, 0x1ull << 44);
+#endif
+} arena SEC(".maps");
+
+#define ARENA_ALLOC_STATS
+
+#include "libarena_ds.h"
+#include "ds_api.h"
+
+/* Keep in sync with skeleton_arena_alloc.c */
+#define BENCH_ROWS 64
+#define BENCH_MAX_BATCH 1024
+#define BENCH_HIST_BUCKETS 32
+#define BENCH_FRAG_OBJS 16384
+#define BENCH_FRAG_MAX_SIZE 512
+
+__u32 config_size = 64;
+__u32 config_batch = 256;
+__u32 config_rounds = 1;
+__u32 config_rows = 1;		/* threads in this run */
+__u32 config_victim = 1;	/* bench_drain frees row (row + victim) % rows */
+__u32 config_free_pct = 50;
+
+/* Per row; the loader clears them between runs */
+__u64 result_objs[BENCH_ROWS];
+__u64 result_alloc_ns[BENCH_ROWS];
+__u64 result_free_ns[BENCH_ROWS];
+__u64 result_failures[BENCH_ROWS];
+__u64 result_alloc_hist[BENCH_ROWS][BENCH_HIST_BUCKETS];	/* log2 ns */
+__u64 result_free_hist[BENCH_ROWS][BENCH_HIST_BUCKETS];
+
+/* bench_frag output */
+__s64 frag_pages_full;
+__s64 frag_pages_freed;
+__s64 frag_pages_refill;
+__u64 frag_live_bytes;
+__u64 frag_live_objs;
+
+void __arena * __arena bench_slots[BENCH_ROWS][BENCH_MAX_BATCH];
+void __arena * __arena frag_slots[BENCH_FRAG_OBJS];
+__u32 __arena frag_size[BENCH_FRAG_OBJS];
+
+static __always_inline __u32 bench_row(__u32 *ctx)
+{
+	return *ctx & (BENCH_ROWS - 1);
+}
+
+static __always_inline __u32 bench_batch(void)
+{
+	return config_batch < BENCH_MAX_BATCH ? config_batch : BENCH_MAX_BATCH;
+}
+
+static __always_inline __u32 bench_log2(__u64 ns)
+{
+	__u32 b = 0;
+
+	while (ns > 1 && b < BENCH_HIST_BUCKETS - 1 && can_loop) {
+		ns >>= 1;
+		b++;
+	}
+	return b;
+}
+
+/* Fill @row's slots; returns the number allocated */
+static __always_inline __u32 bench_fill_row(__u32 row, __u32 n)
+{
+	__u32 i;
+
+	for (i = 0; i < n && can_loop; i++) {
+		void __arena *p = bpf_arena_alloc(config_size);
+
+		if (!p) {
+			result_failures[row]++;
+			break;
+		}
+		bench_slots[row][i] = p;
+	}
+	return i;
+}
+
+static __always_inline void bench_free_row(__u32 row, __u32 n)
+{
+	for (__u32 i = 0; i < n && can_loop; i++) {
+		void __arena *p = bench_slots[row][i & (BENCH_MAX_BATCH - 1)];
+
+		if (p)
+			bpf_arena_free(p);
+		bench_slots[row][i & (BENCH_MAX_BATCH - 1)] = NULL;
+	}
+}
+
+/* Throughput: config_rounds x (allocate a batch, free it in order) */
+SEC("syscall")
+int bench_pairs(__u32 *ctx)
+{
+	__u32 row = bench_row(ctx), n, batch = bench_batch();
+	__u64 t0, t1;
+
+	for (__u32 r = 0; r < config_rounds && can_loop; r++) {
+		t0 = bpf_ktime_get_ns();
+		n = bench_fill_row(row, batch);
+		t1 = bpf_ktime_get_ns();
+		bench_free_row(row, n);
+		result_alloc_ns[row] += t1 - t0;
+		result_free_ns[row] += bpf_ktime_get_ns() - t1;
+		result_objs[row] += n;
+		if (n < batch)
+			return DS_ERROR_NOMEM;
+	}
+	return DS_SUCCESS;
+}
+
+/* Latency: one batch with every alloc and free timed into a log2 histogram */
+SEC("syscall")
+int bench_timed(__u32 *ctx)
+{
+	__u32 row = bench_row(ctx), batch = bench_batch(), i;
+	__u64 t0;
+
+	for (i = 0; i < batch && can_loop; i++) {
+		void __arena *p;
+
+		t0 = bpf_ktime_get_ns();
+		p = bpf_arena_alloc(config_size);
+		result_alloc_hist[row][bench_log2(bpf_ktime_get_ns() - t0)]++;
+		if (!p) {
+			result_failures[row]++;
+			break;
+		}
+		bench_slots[row][i & (BENCH_MAX_BATCH - 1)] = p;
+	}
+	batch = i;
+	for (i = 0; i < batch && can_loop; i++) {
+		void __arena *p = bench_slots[row][i & (BENCH_MAX_BATCH - 1)];
+
+		t0 = bpf_ktime_get_ns();
+		bpf_arena_free(p);
+		result_free_hist[row][bench_log2(bpf_ktime_get_ns() - t0)]++;
+		bench_slots[row][i & (BENCH_MAX_BATCH - 1)] = NULL;
+	}
+	return DS_SUCCESS;
+}
+
+/* Cross free, step 1: allocate a batch into this row's slots */
+SEC("syscall")
+int bench_fill(__u32 *ctx)
+{
+	__u32 row = bench_row(ctx), batch = bench_batch(), n;
+	__u64 t0 = bpf_ktime_get_ns();
+
+	n = bench_fill_row(row, batch);
+	result_alloc_ns[row] += bpf_ktime_get_ns() - t0;
+	result_objs[row] += n;
+	return n == batch ? DS_SUCCESS : DS_ERROR_NOMEM;
+}
+
+/*
+ * Cross free, step 2: free another row's batch. The loader runs every
+ * row's fill before any drain, so no footer sees two CPUs at once.
+ */
+SEC("syscall")
+int bench_drain(__u32 *ctx)
+{
+	__u32 row = bench_row(ctx);
+	__u32 victim = config_rows ? (row + config_victim) % config_rows : row;
+	__u64 t0 = bpf_ktime_get_ns();
+
+	bench_free_row(victim & (BENCH_ROWS - 1), bench_batch());
+	result_free_ns[row] += bpf_ktime_get_ns() - t0;
+	return DS_SUCCESS;
+}
+
+/*
+ * Fragmentation: BENCH_FRAG_OBJS objects of 8..BENCH_FRAG_MAX_SIZE bytes,
+ * free config_free_pct% of them in random order, then allocate as many
+ * again. Pages held are read from arena_alloc_stats.pages_out.
+ */
+SEC("syscall")
+int bench_frag(void *ctx)
+{
+	__u32 nr_free = (__u32)((__u64)BENCH_FRAG_OBJS * config_free_pct / 100);
+	__s64 base = arena_alloc_stats.pages_out;
+	int ret = DS_ERROR_NOMEM;
+	__u32 i;
+
+	(void)ctx;
+	if (nr_free > BENCH_FRAG_OBJS)
+		nr_free = BENCH_FRAG_OBJS;
+
+	for (i = 0; i < BENCH_FRAG_OBJS && can_loop; i++) {
+		frag_size[i] = 8 + bpf_get_prandom_u32() % (BENCH_FRAG_MAX_SIZE - 7);
+		frag_slots[i] = bpf_arena_alloc(frag_size[i]);
+		if (!frag_slots[i])
+			goto out;
+	}
+	frag_pages_full = arena_alloc_stats.pages_out - base;
+
+	/* Fisher-Yates prefix: the first nr_free slots are a random subset */
+	for (i = 0; i < nr_free && can_loop; i++) {
+		__u32 j = (i + bpf_get_prandom_u32() % (BENCH_FRAG_OBJS - i)) & (BENCH_FRAG_OBJS - 1);
+		__u32 k = i & (BENCH_FRAG_OBJS - 1);
+		void __arena *p = frag_slots[k];
+		__u32 s = frag_size[k];
+
+		frag_slots[k] = frag_slots[j];
+		frag_size[k] = frag_size[j];
+		frag_slots[j] = p;
+		frag_size[j] = s;
+		bpf_arena_free(frag_slots[k]);
+	}
+
+	frag_live_bytes = 0;
+	for (i = nr_free; i < BENCH_FRAG_OBJS && can_loop; i++)
+		frag_live_bytes += round_up(frag_size[i], 8);
+	frag_live_objs = BENCH_FRAG_OBJS - nr_free;
+	frag_pages_freed = arena_alloc_stats.pages_out - base;
+
+	for (i = 0; i < nr_free && can_loop; i++) {
+		__u32 k = i & (BENCH_FRAG_OBJS - 1);
+
+		frag_slots[k] = bpf_arena_alloc(frag_size[k]);
+	}
+	frag_pages_refill = arena_alloc_stats.pages_out - base;
+	ret = DS_SUCCESS;
+
+out:
+	for (i = 0; i < BENCH_FRAG_OBJS && can_loop; i++) {
+		if (frag_slots[i])
+			bpf_arena_free(frag_slots[i]);
+		frag_slots[i] = NULL;
+	}
+	return ret;
+}
+
+char _license[] SEC("license") = "GPL";
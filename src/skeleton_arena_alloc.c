@@ -0,0 +1,448 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+/* Same counters as skeleton_arena_alloc.bpf.c, read from the arena */
+#define ARENA_ALLOC_STATS
+
+#include "ds_api.h"
+#include "skeleton_arena_alloc.skel.h"
+
+/* Keep in sync with skeleton_arena_alloc.bpf.c */
+#define BENCH_ROWS 64
+#define BENCH_MAX_BATCH 1024
+#define BENCH_HIST_BUCKETS 32
+#define BENCH_FRAG_OBJS 16384
+#define BENCH_FRAG_MAX_SIZE 512
+
+/* can_loop allows ~8M iterations per run; stay well under it */
+#define BENCH_OBJS_PER_CALL 65536
+
+struct test_config {
+	__u64 ops;
+	__u32 batch;
+	int max_threads;
+	__u32 scale_size;
+};
+
+static struct test_config config = {
+	.ops = 2000000,
+	.batch = 256,
+	.max_threads = 0,	/* 0: online CPUs */
+	.scale_size = 64,
+};
+
+static const __u32 sizes[] = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048 };
+static const __u32 frag_pcts[] = { 50, 75, 90, 99 };
+
+static struct skeleton_arena_alloc_bpf *skel;
+
+struct worker {
+	pthread_t thread;
+	__u32 row;
+	__u32 nr;
+	bool cross;
+	int err;
+};
+
+static struct worker workers[BENCH_ROWS];
+static pthread_barrier_t round_barrier;
+
+struct page_calls {
+	__u64 allocs;
+	__u64 frees;
+};
+
+/* Page-source calls per 1000 objects */
+struct page_rates {
+	double allocs;
+	double frees;
+};
+
+static int nr_cpus(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int)n : 1;
+}
+
+static void pin_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void print_rule(void)
+{
+	printf("============================================================\n");
+}
+
+/* The program sees @row as its context */
+static int run_prog(struct bpf_program *prog, __u32 row)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts, .ctx_in = &row, .ctx_size_in = sizeof(row));
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(prog), &opts);
+	if (err)
+		return err;
+	return opts.retval == DS_SUCCESS ? 0 : -ENOMEM;
+}
+
+static struct page_calls page_calls_now(void)
+{
+	struct arena_alloc_stats *st = &skel->arena->arena_alloc_stats;
+
+	return (struct page_calls){
+		.allocs = __atomic_load_n(&st->page_allocs, __ATOMIC_RELAXED),
+		.frees = __atomic_load_n(&st->page_frees, __ATOMIC_RELAXED),
+	};
+}
+
+static double per_k(__u64 n, __u64 objs)
+{
+	return objs ? (double)n * 1000.0 / (double)objs : 0.0;
+}
+
+static double mops(__u64 objs, __u64 ns)
+{
+	return ns ? (double)objs * 1e3 / (double)ns : 0.0;
+}
+
+static void clear_results(void)
+{
+	memset(skel->bss->result_objs, 0, sizeof(skel->bss->result_objs));
+	memset(skel->bss->result_alloc_ns, 0, sizeof(skel->bss->result_alloc_ns));
+	memset(skel->bss->result_free_ns, 0, sizeof(skel->bss->result_free_ns));
+	memset(skel->bss->result_failures, 0, sizeof(skel->bss->result_failures));
+	memset(skel->bss->result_alloc_hist, 0, sizeof(skel->bss->result_alloc_hist));
+	memset(skel->bss->result_free_hist, 0, sizeof(skel->bss->result_free_hist));
+}
+
+/* Upper bound of the log2 bucket holding the @pct-th percentile */
+static __u64 hist_pct(const __u64 *hist, __u32 pct)
+{
+	__u64 total = 0, seen = 0;
+
+	for (int b = 0; b < BENCH_HIST_BUCKETS; b++)
+		total += hist[b];
+	for (int b = 0; b < BENCH_HIST_BUCKETS; b++) {
+		seen += hist[b];
+		if (total && seen * 100 >= total * pct)
+			return 2ull << b;
+	}
+	return 0;
+}
+
+/* Calls bench_pairs until @objs objects went through @row */
+static int run_pairs(__u32 row, __u64 objs)
+{
+	int err = 0;
+
+	while (!err && skel->bss->result_objs[row] < objs)
+		err = run_prog(skel->progs.bench_pairs, row);
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * Size classes
+ * ------------------------------------------------------------------------ */
+
+static int run_size(__u32 size)
+{
+	struct page_calls before, after;
+	__u64 objs;
+	int err;
+
+	clear_results();
+	skel->data->config_size = size;
+	skel->data->config_rounds = BENCH_OBJS_PER_CALL / config.batch ?: 1;
+
+	before = page_calls_now();
+	err = run_pairs(0, config.ops);
+	after = page_calls_now();
+	if (!err)
+		err = run_prog(skel->progs.bench_timed, 0);
+	if (err)
+		return err;
+
+	objs = skel->bss->result_objs[0];
+	printf("%6u %10.2f %9.2f %8llu %8llu %8llu %8llu %9.2f %9.2f\n", size,
+	       mops(objs, skel->bss->result_alloc_ns[0]), mops(objs, skel->bss->result_free_ns[0]),
+	       (unsigned long long)hist_pct(skel->bss->result_alloc_hist[0], 50),
+	       (unsigned long long)hist_pct(skel->bss->result_alloc_hist[0], 99),
+	       (unsigned long long)hist_pct(skel->bss->result_free_hist[0], 50),
+	       (unsigned long long)hist_pct(skel->bss->result_free_hist[0], 99),
+	       per_k(after.allocs - before.allocs, objs), per_k(after.frees - before.frees, objs));
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Scaling and cross-thread free
+ * ------------------------------------------------------------------------ */
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	__u64 per = config.ops / w->nr;
+
+	pin_cpu((int)w->row);
+	pthread_barrier_wait(&round_barrier);
+
+	if (!w->cross) {
+		w->err = run_pairs(w->row, per);
+		return NULL;
+	}
+
+	/*
+	 * Every fill lands before any drain, and every drain before the next
+	 * fill. A failed row keeps meeting the barriers so the others finish.
+	 */
+	for (__u64 r = 0; r < (per + config.batch - 1) / config.batch; r++) {
+		if (!w->err)
+			w->err = run_prog(skel->progs.bench_fill, w->row);
+		pthread_barrier_wait(&round_barrier);
+		if (!w->err)
+			w->err = run_prog(skel->progs.bench_drain, w->row);
+		pthread_barrier_wait(&round_barrier);
+	}
+	return NULL;
+}
+
+/* Aggregate Mops over alloc+free pairs; the slowest row sets the time */
+static int run_threads(__u32 nr, bool cross, __u32 victim, double *out, struct page_rates *pr)
+{
+	struct page_calls before, after;
+	__u64 objs = 0, max_ns = 0;
+	int err = 0;
+
+	clear_results();
+	skel->data->config_size = config.scale_size;
+	skel->data->config_rows = nr;
+	skel->data->config_victim = victim;
+	skel->data->config_rounds = BENCH_OBJS_PER_CALL / config.batch ?: 1;
+
+	before = page_calls_now();
+	pthread_barrier_init(&round_barrier, NULL, nr);
+	for (__u32 t = 0; t < nr; t++) {
+		workers[t] = (struct worker){ .row = t, .nr = nr, .cross = cross };
+		if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) != 0)
+			return -errno;
+	}
+	for (__u32 t = 0; t < nr; t++) {
+		__u64 ns;
+
+		pthread_join(workers[t].thread, NULL);
+		ns = skel->bss->result_alloc_ns[t] + skel->bss->result_free_ns[t];
+		objs += skel->bss->result_objs[t];
+		if (ns > max_ns)
+			max_ns = ns;
+		if (workers[t].err && !err)
+			err = workers[t].err;
+	}
+	pthread_barrier_destroy(&round_barrier);
+	after = page_calls_now();
+
+	*out = mops(objs, max_ns);
+	pr->allocs = per_k(after.allocs - before.allocs, objs);
+	pr->frees = per_k(after.frees - before.frees, objs);
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * Fragmentation
+ * ------------------------------------------------------------------------ */
+
+static int run_frag(__u32 pct)
+{
+	struct skeleton_arena_alloc_bpf__bss *bss = skel->bss;
+	int err;
+
+	skel->data->config_free_pct = pct;
+	err = run_prog(skel->progs.bench_frag, 0);
+	if (err)
+		return err;
+
+	printf("%5u%% %8lld %10lld %10lld %8.1f%% %10lld %10llu\n", pct,
+	       (long long)bss->frag_pages_full, (long long)bss->frag_pages_freed,
+	       (long long)bss->frag_pages_refill,
+	       bss->frag_pages_freed > 0 ?
+		       100.0 * (double)bss->frag_live_bytes /
+			       ((double)bss->frag_pages_freed * (double)sysconf(_SC_PAGESIZE)) : 0.0,
+	       (long long)(bss->frag_pages_refill - bss->frag_pages_freed),
+	       (unsigned long long)bss->frag_live_objs);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static int run_all(void)
+{
+	struct arena_alloc_stats *st = &skel->arena->arena_alloc_stats;
+	struct page_rates pr;
+	double rate;
+	int err;
+
+	print_rule();
+	printf("  BPF size classes: CPU 0, %llu objects, %u live per batch\n",
+	       (unsigned long long)config.ops, config.batch);
+	printf("  ns = log2 bucket bound, incl. one bpf_ktime_get_ns(); pages per 1000 objects\n");
+	print_rule();
+	printf("%6s %10s %9s %8s %8s %8s %8s %9s %9s\n", "Size", "Alloc Mops", "Free Mops",
+	       "a p50", "a p99", "f p50", "f p99", "Pg alloc", "Pg free");
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		err = run_size(sizes[i]);
+		if (err)
+			return err;
+	}
+
+	print_rule();
+	printf("  BPF scaling: %u B alloc+free pairs, one thread per CPU 0..N-1\n", config.scale_size);
+	print_rule();
+	printf("%7s %10s %9s %9s\n", "Threads", "Mpairs/s", "Pg alloc", "Pg free");
+	for (int t = 1;; t = t * 2 < config.max_threads ? t * 2 : config.max_threads) {
+		err = run_threads((__u32)t, false, 0, &rate, &pr);
+		if (err)
+			return err;
+		printf("%7d %10.2f %9.2f %9.2f\n", t, rate, pr.allocs, pr.frees);
+		if (t == config.max_threads)
+			break;
+	}
+
+	print_rule();
+	if (config.max_threads < 2) {
+		printf("  BPF cross free: skipped, needs 2 CPUs\n");
+	} else {
+		printf("  BPF cross free: %d CPUs allocate %u each, then free own or neighbour's batch\n",
+		       config.max_threads, config.batch);
+		print_rule();
+		printf("%-10s %10s %9s %9s\n", "Free", "Mpairs/s", "Pg alloc", "Pg free");
+		for (__u32 victim = 0; victim < 2; victim++) {
+			err = run_threads((__u32)config.max_threads, true, victim, &rate, &pr);
+			if (err)
+				return err;
+			printf("%-10s %10.2f %9.2f %9.2f\n", victim ? "neighbour" : "own", rate,
+			       pr.allocs, pr.frees);
+		}
+	}
+
+	print_rule();
+	printf("  BPF fragmentation: %d objects of 8..%d B, a random share freed, then refilled\n",
+	       BENCH_FRAG_OBJS, BENCH_FRAG_MAX_SIZE);
+	printf("  Fill = live bytes / held pages; Refill pg = new pages for the refill\n");
+	print_rule();
+	printf("%6s %8s %10s %10s %9s %10s %10s\n", "Freed", "Pages", "After free", "After fill",
+	       "Fill", "Refill pg", "Live objs");
+	for (size_t i = 0; i < sizeof(frag_pcts) / sizeof(frag_pcts[0]); i++) {
+		err = run_frag(frag_pcts[i]);
+		if (err)
+			return err;
+	}
+
+	print_rule();
+	printf("Page source: allocs=%llu frees=%llu out=%lld failures=%llu\n",
+	       (unsigned long long)st->page_allocs, (unsigned long long)st->page_frees,
+	       (long long)st->pages_out, (unsigned long long)st->failures);
+	print_rule();
+	return 0;
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("BPF arena allocator microbenchmark (SEC(\"syscall\") programs via test_run)\n\n");
+	printf("OPTIONS:\n");
+	printf("  -n N    Objects per run (default: %llu)\n", (unsigned long long)config.ops);
+	printf("  -b N    Objects live per batch, 1..%d (default: %u)\n", BENCH_MAX_BATCH, config.batch);
+	printf("  -t N    Max threads (one per CPU) for scaling and cross free (default: online CPUs)\n");
+	printf("  -s B    Object size for scaling and cross free (default: %u)\n", config.scale_size);
+	printf("  -h      Show this help\n\n");
+	printf("bench_arena_alloc runs the same sections against the userspace allocator.\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:b:t:s:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			config.ops = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			config.batch = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			config.max_threads = atoi(optarg);
+			break;
+		case 's':
+			config.scale_size = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	/* Per-CPU allocator state: two threads must never share a CPU */
+	if (!config.max_threads)
+		config.max_threads = nr_cpus();
+	if (config.max_threads > BENCH_ROWS)
+		config.max_threads = BENCH_ROWS;
+	if (!config.ops || !config.batch || config.batch > BENCH_MAX_BATCH ||
+	    config.max_threads < 1 || config.max_threads > nr_cpus() ||
+	    !config.scale_size || config.scale_size > 2048) {
+		print_usage(argv[0]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	printf("Loading BPF program for the arena allocator benchmark...\n");
+	skel = skeleton_arena_alloc_bpf__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	skel->data->config_batch = config.batch;
+
+	err = skeleton_arena_alloc_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
+		goto cleanup;
+	}
+
+	err = run_all();
+	if (err)
+		fprintf(stderr, "Benchmark run failed: %d (arena exhausted?)\n", err);
+
+cleanup:
+	skeleton_arena_alloc_bpf__destroy(skel);
+	return err ? 1 : 0;
+}
@@ -101,4 +101,7 @@ int bpf_ck_ring_spsc_consume(struct pt_regs *ctx)
 	return ret;
 }
 
+/* Kernel half of the metrics calibration, run once before attaching */
+DS_METRICS_CALIBRATE_PROG(&global_metrics)
+
 char _license[] SEC("license") = "GPL";
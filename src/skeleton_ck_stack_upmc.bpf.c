@@ -92,4 +92,7 @@ int bpf_ck_stack_upmc_consume(struct pt_regs *ctx)
 	return ret;
 }
 
+/* Kernel half of the metrics calibration, run once before attaching */
+DS_METRICS_CALIBRATE_PROG(&global_metrics)
+
 char LICENSE[] SEC("license") = "GPL";
@@ -16,11 +16,13 @@
 #include "ds_api.h"
 #include "ds_ck_stack_upmc.h"
 #include "ds_metrics.h"
+#include "ds_prog_stats.h"
 #include "skeleton_ck_stack_upmc.skel.h"
 
 struct test_config {
 	bool verify;
 	bool print_stats;
+	bool prog_stats;
 };
 
 static struct test_config config = {
@@ -30,6 +32,8 @@ static struct test_config config = {
 
 static struct skeleton_ck_stack_upmc_bpf *skel;
 static volatile sig_atomic_t stop_test;
+static struct ds_prog_stats prog_stats = { .stats_fd = -1 };
+static int consume_stats_idx = -1;
 static pthread_t relay_thread;
 static bool relay_thread_started;
 static __u64 ku_dequeued_count;
@@ -156,6 +160,7 @@ static void trigger_kernel_consumer_on_exit(void)
 	__u64 target_consumed;
 	__u64 attempts = 0;
 	__u64 max_attempts;
+	__u64 start_ns;
 
 	initial_consumed = skel->bss->total_kernel_consumed;
 	target_consumed = initial_consumed + uk_enqueued_count;
@@ -168,11 +173,14 @@ static void trigger_kernel_consumer_on_exit(void)
 		return;
 	}
 
+	start_ns = ds_metrics_clock();
 	while (attempts < max_attempts &&
 	       skel->bss->total_kernel_consumed < target_consumed) {
 		ck_stack_upmc_kernel_consume_trigger();
 		attempts++;
 	}
+	ds_prog_stats_set_wall(&prog_stats, consume_stats_idx, ds_metrics_clock() - start_ns,
+			       attempts);
 
 	printf("MainThread: consume triggers=%llu consumed=%llu target=%llu\n",
 	       (unsigned long long)attempts,
@@ -229,6 +237,15 @@ static void print_statistics(void)
 	printf("  KU count=%llu\n", (unsigned long long)head_ku->count);
 	printf("  UK count=%llu\n", (unsigned long long)head_uk->count);
 	ds_metrics_print(&skel->arena->global_metrics, "CK Stack UPMC");
+	ds_prog_stats_print(&prog_stats, &skel->arena->global_metrics);
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_ck_stack_upmc_stats_c(head_ku, &op_stats) == DS_SUCCESS)
+		ds_print_stats("CK Stack UPMC KU", &op_stats);
+	if (ds_ck_stack_upmc_stats_c(head_uk, &op_stats) == DS_SUCCESS)
+		ds_print_stats("CK Stack UPMC UK", &op_stats);
+#endif
 	printf("============================================================\n\n");
 }
 
@@ -239,6 +256,7 @@ static void print_usage(const char *prog)
 	printf("OPTIONS:\n");
 	printf("  -v      Verify both lanes on exit\n");
 	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -S      Also report per-run BPF program cost (BPF_ENABLE_STATS)\n");
 	printf("  -h      Show this help\n\n");
 	printf("Flow:\n");
 	printf("  inode_create -> CKStackUPMCKU (kernel producer)\n");
@@ -250,7 +268,7 @@ static int parse_args(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "vsh")) != -1) {
+	while ((opt = getopt(argc, argv, "vsSh")) != -1) {
 		switch (opt) {
 		case 'v':
 			config.verify = true;
@@ -258,6 +276,9 @@ static int parse_args(int argc, char **argv)
 		case 's':
 			config.print_stats = true;
 			break;
+		case 'S':
+			config.prog_stats = true;
+			break;
 		case 'h':
 			print_usage(argv[0]);
 			exit(0);
@@ -293,6 +314,15 @@ int main(int argc, char **argv)
 		goto cleanup;
 	}
 
+	if (ds_metrics_calibrate_run(&skel->arena->global_metrics,
+				     bpf_program__fd(skel->progs.metrics_calibrate)))
+		fprintf(stderr, "Metrics calibration failed; latencies are not corrected\n");
+	/* -S: count kernel run time from here on, before anything is attached */
+	if (config.prog_stats)
+		consume_stats_idx = DS_PROG_STATS_SETUP(&prog_stats,
+			DS_PROG_STATS_PROG(skel, lsm_inode_create, DS_METRICS_LKMM_PRODUCER),
+			DS_PROG_STATS_PROG(skel, bpf_ck_stack_upmc_consume, DS_METRICS_LKMM_CONSUMER));
+
 	err = attach_programs();
 	if (err) {
 		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
@@ -326,6 +356,7 @@ int main(int argc, char **argv)
 	err = 0;
 
 cleanup:
+	ds_prog_stats_close(&prog_stats);
 	skeleton_ck_stack_upmc_bpf__destroy(skel);
 	return err;
 }
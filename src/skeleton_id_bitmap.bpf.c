@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * ID bitmap skeleton: every in-flight openat() holds a small integer
+ * handle from ds_id_bitmap. sys_enter_openat acquires one and parks it in
+ * a hash map keyed by pid_tgid; sys_exit_openat releases it. Both sides
+ * are non-sleepable and never allocate.
+ */
+
+#define BPF_NO_KFUNC_PROTOTYPES
+#include <vmlinux.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "bpf_experimental.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARENA);
+	__uint(map_flags, BPF_F_MMAPABLE);
+	__uint(max_entries, 1000);
+#ifdef __TARGET_ARCH_arm64
+	__ulong(map_extra, 0x1ull << 32);
+#else
+	__ulong(map_extra, 0x1ull << 44);
+#endif
+} arena SEC(".maps");
+
+#include "libarena_ds.h"
+#include "ds_api.h"
+#include "ds_id_bitmap.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, 16384);
+	__type(key, __u64);
+	__type(value, __u32);
+} inflight SEC(".maps");
+
+__u32 config_nr_ids = 4096;
+
+struct ds_id_bitmap __arena global_ids;
+
+__u64 total_acquired = 0;
+__u64 total_acquire_failures = 0;
+__u64 total_released = 0;
+__u64 total_release_failures = 0;
+__u64 total_untracked = 0;
+bool initialized = false;
+
+/* Run once from userspace via BPF_PROG_TEST_RUN before attaching */
+SEC("syscall")
+int init_ids(void *ctx)
+{
+	int ret;
+
+	(void)ctx;
+
+	ret = ds_id_bitmap_init_lkmm(&global_ids, config_nr_ids);
+	if (ret != DS_SUCCESS)
+		return ret;
+
+	initialized = true;
+	return DS_SUCCESS;
+}
+
+SEC("tp/syscalls/sys_enter_openat")
+int tp_enter_openat(void *ctx)
+{
+	__u64 key = bpf_get_current_pid_tgid();
+	__u32 id;
+
+	(void)ctx;
+
+	if (!initialized)
+		return 0;
+
+	if (ds_id_bitmap_acquire_lkmm(&global_ids, &id) != DS_SUCCESS) {
+		total_acquire_failures++;
+		return 0;
+	}
+
+	/* A slot left by an enter without exit keeps its ID; give ours back */
+	if (bpf_map_update_elem(&inflight, &key, &id, BPF_NOEXIST)) {
+		ds_id_bitmap_release_lkmm(&global_ids, id);
+		total_untracked++;
+		return 0;
+	}
+
+	total_acquired++;
+	return 0;
+}
+
+SEC("tp/syscalls/sys_exit_openat")
+int tp_exit_openat(void *ctx)
+{
+	__u64 key = bpf_get_current_pid_tgid();
+	__u32 *id;
+
+	(void)ctx;
+
+	id = bpf_map_lookup_elem(&inflight, &key);
+	if (!id)
+		return 0;
+
+	if (ds_id_bitmap_release_lkmm(&global_ids, *id) == DS_SUCCESS)
+		total_released++;
+	else
+		total_release_failures++;
+	bpf_map_delete_elem(&inflight, &key);
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
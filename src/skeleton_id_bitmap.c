@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "ds_api.h"
+#include "ds_id_bitmap.h"
+#include "skeleton_id_bitmap.skel.h"
+
+struct test_config {
+	bool verify;
+	bool print_stats;
+	__u32 nr_ids;
+};
+
+static struct test_config config = {
+	.verify = false,
+	.print_stats = true,
+	.nr_ids = 4096,
+};
+
+static struct skeleton_id_bitmap_bpf *skel;
+static volatile sig_atomic_t stop_test;
+
+static void signal_handler(int sig)
+{
+	(void)sig;
+	stop_test = 1;
+}
+
+static int init_ids(void)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.init_ids), &opts);
+	if (err)
+		return err;
+	return opts.retval == DS_SUCCESS ? 0 : -1;
+}
+
+static int attach_programs(void)
+{
+	struct bpf_link *link;
+	int err;
+
+	link = bpf_program__attach(skel->progs.tp_enter_openat);
+	err = libbpf_get_error(link);
+	if (err)
+		return err;
+	skel->links.tp_enter_openat = link;
+
+	link = bpf_program__attach(skel->progs.tp_exit_openat);
+	err = libbpf_get_error(link);
+	if (err)
+		return err;
+	skel->links.tp_exit_openat = link;
+
+	return 0;
+}
+
+static void detach_programs(void)
+{
+	bpf_link__destroy(skel->links.tp_enter_openat);
+	skel->links.tp_enter_openat = NULL;
+	bpf_link__destroy(skel->links.tp_exit_openat);
+	skel->links.tp_exit_openat = NULL;
+}
+
+/* Handles still parked in the map: syscalls cut off by the detach */
+static __u32 count_inflight(void)
+{
+	int fd = bpf_map__fd(skel->maps.inflight);
+	__u64 key, next;
+	__u64 *prev = NULL;
+	__u32 n = 0;
+
+	while (bpf_map_get_next_key(fd, prev, &next) == 0) {
+		n++;
+		key = next;
+		prev = &key;
+	}
+	return n;
+}
+
+/* Run after detach: the bitmap is quiescent */
+static int verify_data_structure(void)
+{
+	struct ds_id_bitmap *ids = &skel->arena->global_ids;
+	__u32 held = ds_id_bitmap_count_c(ids);
+	__u32 parked = count_inflight();
+	int result;
+
+	printf("Verifying ID bitmap from userspace...\n");
+
+	result = ds_id_bitmap_verify_c(ids);
+	if (result == DS_SUCCESS && held == parked &&
+	    !skel->bss->total_release_failures) {
+		printf("Verification PASSED (held=%u parked=%u)\n", held, parked);
+		return DS_SUCCESS;
+	}
+
+	printf("Verification FAILED (result=%d held=%u parked=%u release_failures=%llu)\n",
+	       result, held, parked, (unsigned long long)skel->bss->total_release_failures);
+	return DS_ERROR_INVALID;
+}
+
+static void print_statistics(void)
+{
+	printf("\n============================================================\n");
+	printf("                  ID BITMAP STATISTICS                      \n");
+	printf("============================================================\n");
+	printf("Pool: %u IDs\n", config.nr_ids);
+	printf("sys_enter_openat (acquire):\n");
+	printf("  acquired=%llu failures=%llu untracked=%llu\n",
+	       (unsigned long long)skel->bss->total_acquired,
+	       (unsigned long long)skel->bss->total_acquire_failures,
+	       (unsigned long long)skel->bss->total_untracked);
+	printf("sys_exit_openat (release):\n");
+	printf("  released=%llu failures=%llu\n",
+	       (unsigned long long)skel->bss->total_released,
+	       (unsigned long long)skel->bss->total_release_failures);
+	printf("Held at exit: %u\n", ds_id_bitmap_count_c(&skel->arena->global_ids));
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_id_bitmap_stats_c(&skel->arena->global_ids, &op_stats) == DS_SUCCESS)
+		ds_print_stats("ID bitmap", &op_stats);
+#endif
+	printf("============================================================\n\n");
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("ID bitmap test (one handle per in-flight openat)\n\n");
+	printf("OPTIONS:\n");
+	printf("  -n NUM  Pool size, 1..%u (default: %u)\n", DS_ID_BITMAP_MAX_IDS,
+	       config.nr_ids);
+	printf("  -v      Verify the bitmap on exit\n");
+	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -h      Show this help\n\n");
+	printf("Flow:\n");
+	printf("  sys_enter_openat -> acquire ID, park it under pid_tgid\n");
+	printf("  sys_exit_openat  -> release the parked ID\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:vsh")) != -1) {
+		switch (opt) {
+		case 'n':
+			config.nr_ids = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			config.verify = true;
+			break;
+		case 's':
+			config.print_stats = true;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!config.nr_ids || config.nr_ids > DS_ID_BITMAP_MAX_IDS) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	printf("Loading BPF program for ID bitmap...\n");
+	skel = skeleton_id_bitmap_bpf__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	skel->data->config_nr_ids = config.nr_ids;
+
+	err = skeleton_id_bitmap_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
+		goto cleanup;
+	}
+
+	err = init_ids();
+	if (err) {
+		fprintf(stderr, "Failed to initialize ID bitmap: %d\n", err);
+		goto cleanup;
+	}
+
+	err = attach_programs();
+	if (err) {
+		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
+		goto cleanup;
+	}
+
+	printf("MainThread: attached. Every openat() holds an ID while it runs.\n");
+	printf("Press Ctrl+C to stop.\n");
+
+	while (!stop_test)
+		pause();
+
+	detach_programs();
+
+	if (config.verify)
+		verify_data_structure();
+	if (config.print_stats)
+		print_statistics();
+
+	err = 0;
+
+cleanup:
+	skeleton_id_bitmap_bpf__destroy(skel);
+	return err;
+}
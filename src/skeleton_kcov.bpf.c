@@ -25,7 +25,7 @@ struct {
 
 /* Buffer size in words (area[0] = counter + area[1..N] = data).
  * With KCOV_WORDS_PER_ENTRY=2: (509-1)/2 = 254 usable entries.
- * Total bytes: 509 × 8 = 4072 < PAGE_SIZE-8 = 4088 (allocator limit). */
+ * Total bytes: 509 × 8 = 4072, one arena page; larger sizes take a page run. */
 int config_buf_size = 509;
 
 struct ds_kcov_buf __arena global_ds_head_ku;
@@ -102,4 +102,7 @@ int bpf_kcov_consume(struct pt_regs *ctx)
 	return ret;
 }
 
+/* Kernel half of the metrics calibration, run once before attaching */
+DS_METRICS_CALIBRATE_PROG(&global_metrics)
+
 char _license[] SEC("license") = "GPL";
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * LRU skeleton: a per-process cache shared by kernel hooks and userspace.
+ * sys_enter_openat looks the calling process up and caches its first-seen
+ * time on a miss; sched_process_exit drops the entry when the process
+ * leader exits. Userspace consults the same cache with the _c calls.
+ */
+
+#define BPF_NO_KFUNC_PROTOTYPES
+#include <vmlinux.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "bpf_experimental.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARENA);
+	__uint(map_flags, BPF_F_MMAPABLE);
+	__uint(max_entries, 1000);
+#ifdef __TARGET_ARCH_arm64
+	__ulong(map_extra, 0x1ull << 32);
+#else
+	__ulong(map_extra, 0x1ull << 44);
+#endif
+} arena SEC(".maps");
+
+#include "libarena_ds.h"
+#include "ds_api.h"
+#include "ds_lru.h"
+
+__u32 config_capacity = 1024;
+
+struct ds_lru_head __arena global_cache;
+
+__u64 total_lookups = 0;
+__u64 total_hits = 0;
+__u64 total_inserts = 0;
+__u64 total_insert_failures = 0;
+__u64 total_deletes = 0;
+bool initialized = false;
+
+/* Run once from userspace via BPF_PROG_TEST_RUN before attaching */
+SEC("syscall")
+int init_cache(void *ctx)
+{
+	int ret;
+
+	(void)ctx;
+
+	ret = ds_lru_init_lkmm(&global_cache, config_capacity);
+	if (ret != DS_SUCCESS)
+		return ret;
+
+	initialized = true;
+	return DS_SUCCESS;
+}
+
+SEC("tp/syscalls/sys_enter_openat")
+int tp_enter_openat(void *ctx)
+{
+	__u64 tgid = bpf_get_current_pid_tgid() >> 32;
+
+	(void)ctx;
+
+	if (!initialized)
+		return 0;
+
+	total_lookups++;
+	if (ds_lru_lookup_lkmm(&global_cache, tgid, NULL) == DS_SUCCESS) {
+		total_hits++;
+		return 0;
+	}
+
+	if (ds_lru_insert_lkmm(&global_cache, tgid, bpf_ktime_get_ns()) == DS_SUCCESS)
+		total_inserts++;
+	else
+		total_insert_failures++;
+	return 0;
+}
+
+SEC("tp/sched/sched_process_exit")
+int tp_process_exit(void *ctx)
+{
+	__u64 pid_tgid = bpf_get_current_pid_tgid();
+
+	(void)ctx;
+
+	if (!initialized || (__u32)pid_tgid != (__u32)(pid_tgid >> 32))
+		return 0;
+
+	if (ds_lru_delete_lkmm(&global_cache, pid_tgid >> 32) == DS_SUCCESS)
+		total_deletes++;
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
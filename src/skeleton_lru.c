@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "ds_api.h"
+#include "ds_lru.h"
+#include "skeleton_lru.skel.h"
+
+struct test_config {
+	bool verify;
+	bool print_stats;
+	__u32 capacity;
+};
+
+static struct test_config config = {
+	.verify = false,
+	.print_stats = true,
+	.capacity = 1024,
+};
+
+static struct skeleton_lru_bpf *skel;
+static volatile sig_atomic_t stop_test;
+static __u64 user_lookups;
+static __u64 user_hits;
+
+static void signal_handler(int sig)
+{
+	(void)sig;
+	stop_test = 1;
+}
+
+static int init_cache(void)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.init_cache), &opts);
+	if (err)
+		return err;
+	return opts.retval == DS_SUCCESS ? 0 : -1;
+}
+
+static int attach_programs(void)
+{
+	struct bpf_link *link;
+	int err;
+
+	link = bpf_program__attach(skel->progs.tp_enter_openat);
+	err = libbpf_get_error(link);
+	if (err)
+		return err;
+	skel->links.tp_enter_openat = link;
+
+	link = bpf_program__attach(skel->progs.tp_process_exit);
+	err = libbpf_get_error(link);
+	if (err)
+		return err;
+	skel->links.tp_process_exit = link;
+
+	return 0;
+}
+
+static void detach_programs(void)
+{
+	bpf_link__destroy(skel->links.tp_enter_openat);
+	skel->links.tp_enter_openat = NULL;
+	bpf_link__destroy(skel->links.tp_process_exit);
+	skel->links.tp_process_exit = NULL;
+}
+
+/* Consult the kernel-filled cache from userspace, once a second */
+static void poll_cache(void)
+{
+	struct ds_lru_head *cache = &skel->arena->global_cache;
+	__u64 first_seen;
+
+	while (!stop_test) {
+		user_lookups++;
+		if (ds_lru_lookup_c(cache, (__u64)getpid(), &first_seen) == DS_SUCCESS)
+			user_hits++;
+		sleep(1);
+	}
+}
+
+/* Run after detach: the cache is quiescent */
+static int verify_data_structure(void)
+{
+	int result;
+
+	printf("Verifying LRU cache from userspace...\n");
+
+	result = ds_lru_verify_c(&skel->arena->global_cache);
+	if (result == DS_SUCCESS) {
+		printf("Verification PASSED\n");
+		return DS_SUCCESS;
+	}
+
+	printf("Verification FAILED (result=%d)\n", result);
+	return DS_ERROR_INVALID;
+}
+
+static void print_statistics(void)
+{
+	struct ds_lru_head *cache = &skel->arena->global_cache;
+	__u64 lookups = skel->bss->total_lookups;
+
+	printf("\n============================================================\n");
+	printf("                    LRU CACHE STATISTICS                    \n");
+	printf("============================================================\n");
+	printf("Cache: capacity=%u live=%llu evictions=%llu\n", config.capacity,
+	       (unsigned long long)cache->count, (unsigned long long)cache->evictions);
+	printf("sys_enter_openat (lookup, insert on miss):\n");
+	printf("  lookups=%llu hits=%llu (%.1f%%) inserts=%llu insert_failures=%llu\n",
+	       (unsigned long long)lookups, (unsigned long long)skel->bss->total_hits,
+	       lookups ? 100.0 * (double)skel->bss->total_hits / (double)lookups : 0.0,
+	       (unsigned long long)skel->bss->total_inserts,
+	       (unsigned long long)skel->bss->total_insert_failures);
+	printf("sched_process_exit (delete):\n");
+	printf("  deletes=%llu\n", (unsigned long long)skel->bss->total_deletes);
+	printf("Userspace (own pid):\n");
+	printf("  lookups=%llu hits=%llu\n", (unsigned long long)user_lookups,
+	       (unsigned long long)user_hits);
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_lru_stats_c(cache, &op_stats) == DS_SUCCESS)
+		ds_print_stats("LRU", &op_stats);
+#endif
+	printf("============================================================\n\n");
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("CLOCK LRU test (per-process cache shared by BPF and userspace)\n\n");
+	printf("OPTIONS:\n");
+	printf("  -c NUM  Cache capacity, power of 2 >= %u (default: %u)\n", DS_LRU_WAYS,
+	       config.capacity);
+	printf("  -v      Verify the cache on exit\n");
+	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -h      Show this help\n\n");
+	printf("Flow:\n");
+	printf("  sys_enter_openat   -> lookup tgid, insert first-seen time on miss\n");
+	printf("  sched_process_exit -> delete the exiting process\n");
+	printf("  MainThread looks up its own pid once a second\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:vsh")) != -1) {
+		switch (opt) {
+		case 'c':
+			config.capacity = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			config.verify = true;
+			break;
+		case 's':
+			config.print_stats = true;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (config.capacity < DS_LRU_WAYS || (config.capacity & (config.capacity - 1))) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	printf("Loading BPF program for LRU cache...\n");
+	skel = skeleton_lru_bpf__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	skel->data->config_capacity = config.capacity;
+
+	err = skeleton_lru_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
+		goto cleanup;
+	}
+
+	err = init_cache();
+	if (err) {
+		fprintf(stderr, "Failed to initialize LRU cache: %d\n", err);
+		goto cleanup;
+	}
+
+	err = attach_programs();
+	if (err) {
+		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
+		goto cleanup;
+	}
+
+	printf("MainThread: attached. Every openat() consults the cache.\n");
+	printf("Press Ctrl+C to stop.\n");
+
+	poll_cache();
+
+	detach_programs();
+
+	if (config.verify)
+		verify_data_structure();
+	if (config.print_stats)
+		print_statistics();
+
+	err = 0;
+
+cleanup:
+	skeleton_lru_bpf__destroy(skel);
+	return err;
+}
@@ -33,9 +33,34 @@ struct {
 #endif
 } arena SEC(".maps");
 
+/*
+ * Queue nodes come from per-CPU page reserves refilled by a bpf_wq, so the
+ * non-sleepable tracepoint producer below can allocate them too.
+ */
+#define ARENA_NOSLEEP_RESERVE
+
+/*
+ * The reserve worker and the userspace relay take pages from one shared
+ * ownership map, so both can use the whole arena and reuse each other's
+ * freed pages (the kernel consumer frees nodes userspace allocated).
+ */
+#define ARENA_PAGE_OWNER
+
+/*
+ * Nodes the kernel consumer frees on another CPU than the one that carved
+ * them, or that userspace allocated, go onto the owner's remote-free list
+ * instead of updating its page footer in place.
+ */
+#define ARENA_REMOTE_FREE
+
 /* Include arena library and API definitions */
 #include "libarena_ds.h"
 #include "ds_api.h"
+#include "ds_page_owner.h"
+#include "ds_page_reserve.h"
+#ifdef DS_PHASES
+#include "ds_phase.h"    /* must precede ds_msqueue.h */
+#endif
 
 /* ========================================================================
  * DS_API_INSERT: Include your data structure headers here
@@ -55,9 +80,16 @@ struct ds_msqueue __arena global_ds_queue_uk;
 
 struct ds_metrics_store __arena global_metrics;
 
+/* Page reserve geometry, set by the loader before start_reserve runs */
+__u32 config_reserve_cpus = 1;
+__u32 config_reserve_depth = 8;
+__u32 config_reserve_low = 4;
+
 /* Statistics and control */
 __u64 total_kernel_prod_ops = 0;
 __u64 total_kernel_prod_failures = 0;
+__u64 total_kernel_tp_ops = 0;
+__u64 total_kernel_tp_failures = 0;
 __u64 total_kernel_consume_ops = 0;
 __u64 total_kernel_consume_failures = 0;
 __u64 total_kernel_consumed = 0;
@@ -71,7 +103,8 @@ bool initialized_ku = false;
  * lsm_inode_create - Hook file creation (sleepable LSM)
  * 
  * This runs in sleepable context when any process creates a file.
- * Can safely call bpf_arena_alloc_pages() ✓
+ * Allocates from the page reserve like tp_unlinkat; being sleepable is
+ * no longer required.
  */
 SEC("lsm.s/inode_create")
 int BPF_PROG(lsm_inode_create, struct inode *dir, struct dentry *dentry, umode_t mode)
@@ -112,6 +145,42 @@ int BPF_PROG(lsm_inode_create, struct inode *dir, struct dentry *dentry, umode_t
 	return 0; /* LSM returns 0 to allow operation */
 }
 
+/**
+ * tp_unlinkat - Second KU producer, non-sleepable
+ *
+ * A plain tracepoint cannot call bpf_arena_alloc_pages(); the node for
+ * each insert comes from this CPU's page reserve. An exhausted reserve
+ * shows up as a failed insert here and in the reserve's counters. It can
+ * interrupt lsm_inode_create in the middle of an allocation, so it carves
+ * nodes from its own fragment page (bpf_arena_frag_atomic_enter()).
+ */
+SEC("tp/syscalls/sys_enter_unlinkat")
+int tp_unlinkat(void *ctx)
+{
+	__u64 pid, ts;
+	__u32 frag;
+	int result;
+
+	(void)ctx;
+
+	if (!initialized_ku)
+		return 0;
+
+	pid = bpf_get_current_pid_tgid() >> 32;
+	ts = bpf_ktime_get_ns();
+	frag = bpf_arena_frag_atomic_enter();
+	DS_METRICS_RECORD_OP(&global_metrics, DS_METRICS_LKMM_PRODUCER, {
+		result = ds_msqueue_insert_lkmm(&global_ds_queue_ku, pid, ts);
+	}, result);
+	bpf_arena_frag_atomic_exit(frag);
+
+	total_kernel_tp_ops++;
+	if (result != DS_SUCCESS)
+		total_kernel_tp_failures++;
+
+	return 0;
+}
+
 SEC("uprobe.s")
 int bpf_msq_consume(struct pt_regs *ctx)
 {
@@ -149,4 +218,33 @@ int bpf_msq_consume(struct pt_regs *ctx)
  * INITIALIZATION PROGRAM
  * ======================================================================== */
 
+/*
+ * Run once from userspace via BPF_PROG_TEST_RUN before attaching. Sleepable:
+ * fills the page reserves, then builds the KU queue from them.
+ */
+SEC("syscall")
+int start_reserve(void *ctx)
+{
+	int ret;
+
+	(void)ctx;
+
+	ret = ds_page_reserve_start(config_reserve_cpus, config_reserve_depth,
+				    config_reserve_low);
+	if (ret != DS_SUCCESS)
+		return ret;
+
+	if (!initialized_ku) {
+		ret = ds_msqueue_init_lkmm(&global_ds_queue_ku);
+		if (ret != DS_SUCCESS)
+			return ret;
+		initialized_ku = true;
+	}
+
+	return DS_SUCCESS;
+}
+
+/* Kernel half of the metrics calibration, run once before attaching */
+DS_METRICS_CALIBRATE_PROG(&global_metrics)
+
 char _license[] SEC("license") = "GPL";
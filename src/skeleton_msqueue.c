@@ -4,7 +4,9 @@
  *
  * A) MainThread loads and attaches BPF programs.
  * B) MainThread spawns UserThread (busy relay loop).
- * C) inode_create produces onto MSQueueKU in kernel.
+ * C) inode_create (lsm.s) and unlinkat (plain tracepoint) produce onto
+ *    MSQueueKU in kernel; nodes come from per-CPU page reserves, which
+ *    share the arena's pages with UserThread through one ownership map.
  * D) UserThread pops KU and inserts onto MSQueueUK.
  * E) On Ctrl+C, MainThread triggers uprobe for kernel consumer.
  */
@@ -23,23 +25,38 @@
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
 
+/* Same page source and remote-free lists as skeleton_msqueue.bpf.c */
+#define ARENA_PAGE_OWNER
+#define ARENA_REMOTE_FREE
+
 #include "ds_api.h"
+#ifdef DS_PHASES
+#include "ds_phase.h"
+#endif
 #include "ds_msqueue.h"
 #include "ds_metrics.h"
+#include "ds_prog_stats.h"
+#include "ds_page_owner.h"
+#include "ds_page_reserve.h"
 #include "skeleton_msqueue.skel.h"
 
 struct test_config {
 	bool verify;
 	bool print_stats;
+	bool prog_stats;
+	__u32 reserve_depth;
 };
 
 static struct test_config config = {
 	.verify = false,
 	.print_stats = true,
+	.reserve_depth = 8,
 };
 
 static struct skeleton_msqueue_bpf *skel;
 static volatile sig_atomic_t stop_test;
+static struct ds_prog_stats prog_stats = { .stats_fd = -1 };
+static int consume_stats_idx = -1;
 static pthread_t relay_thread;
 static bool relay_thread_started;
 static __u64 ku_dequeued_count;
@@ -60,6 +77,7 @@ static int setup_userspace_allocator(void)
 {
 	size_t arena_bytes;
 	size_t alloc_bytes;
+	size_t reserved;
 	void *alloc_base;
 	long page_size;
 
@@ -75,12 +93,60 @@ static int setup_userspace_allocator(void)
 	alloc_bytes = arena_bytes - (size_t)page_size;
 	bpf_arena_userspace_set_range(alloc_base, alloc_bytes);
 
-	printf("Arena alloc range: base=%p size=%zu KB\n", alloc_base, alloc_bytes / 1024);
+	/*
+	 * Pages are handed out through the ownership map shared with the BPF
+	 * side. Only the pages under the arena globals stay out of it.
+	 */
+	reserved = (sizeof(*skel->arena) + (size_t)page_size - 1) / (size_t)page_size;
+	if (ds_page_owner_init_c(&skel->arena->ds_page_owner_state, skel->arena,
+				 bpf_map__max_entries(skel->maps.arena),
+				 reserved ? (__u32)reserved : 1) != DS_SUCCESS)
+		return -1;
+	bpf_arena_userspace_set_owner(&skel->arena->ds_page_owner_state);
+	bpf_arena_userspace_set_remote(&skel->arena->arena_remote_free_state);
+
+	printf("Arena pages: %u shared by kernel and userspace, %zu reserved for globals\n",
+	       skel->arena->ds_page_owner_state.nr_pages, reserved ? reserved : 1);
 	return 0;
 }
 
+static void print_remote_free(void)
+{
+	const struct arena_remote_free *rf = &skel->arena->arena_remote_free_state;
+	__u64 pushed = 0, drained = 0, batches = 0, puts = 0;
+
+	for (int i = 0; i < ARENA_REMOTE_CPUS; i++) {
+		pushed += rf->owner[i].pushed;
+		drained += rf->owner[i].drained;
+		batches += rf->owner[i].batches;
+		puts += rf->owner[i].page_puts;
+	}
+
+	printf("Remote frees (pushed/drained/drains/footer updates):\n");
+	printf("  kernel owners: %llu/%llu/%llu/%llu\n",
+	       (unsigned long long)pushed, (unsigned long long)drained,
+	       (unsigned long long)batches, (unsigned long long)puts);
+	printf("  user owner:    %llu/%llu/%llu/%llu\n",
+	       (unsigned long long)rf->owner[ARENA_REMOTE_USER].pushed,
+	       (unsigned long long)rf->owner[ARENA_REMOTE_USER].drained,
+	       (unsigned long long)rf->owner[ARENA_REMOTE_USER].batches,
+	       (unsigned long long)rf->owner[ARENA_REMOTE_USER].page_puts);
+}
+
+static int start_reserve(void)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.start_reserve), &opts);
+	if (err)
+		return err;
+	return opts.retval == DS_SUCCESS ? 0 : -1;
+}
+
 static int attach_programs(void)
 {
+	struct bpf_link *tp_link;
 	struct bpf_link *lsm_link;
 	struct bpf_link *consume_link;
 	struct bpf_uprobe_opts uprobe_opts = {
@@ -95,6 +161,12 @@ static int attach_programs(void)
 		return err;
 	skel->links.lsm_inode_create = lsm_link;
 
+	tp_link = bpf_program__attach(skel->progs.tp_unlinkat);
+	err = libbpf_get_error(tp_link);
+	if (err)
+		return err;
+	skel->links.tp_unlinkat = tp_link;
+
 	consume_link = bpf_program__attach_uprobe_opts(
 		skel->progs.bpf_msq_consume,
 		getpid(),
@@ -167,6 +239,7 @@ static void trigger_kernel_consumer_on_exit(void)
 	__u64 target_consumed;
 	__u64 attempts = 0;
 	__u64 max_attempts;
+	__u64 start_ns;
 
 	initial_consumed = skel->bss->total_kernel_consumed;
 	target_consumed = initial_consumed + uk_enqueued_count;
@@ -179,11 +252,14 @@ static void trigger_kernel_consumer_on_exit(void)
 		return;
 	}
 
+	start_ns = ds_metrics_clock();
 	while (attempts < max_attempts &&
 	       skel->bss->total_kernel_consumed < target_consumed) {
 		msq_kernel_consume_trigger();
 		attempts++;
 	}
+	ds_prog_stats_set_wall(&prog_stats, consume_stats_idx, ds_metrics_clock() - start_ns,
+			       attempts);
 
 	printf("MainThread: consume triggers=%llu consumed=%llu target=%llu\n",
 	       (unsigned long long)attempts,
@@ -227,6 +303,11 @@ static void print_statistics(void)
 	       (unsigned long long)skel->bss->total_kernel_prod_ops,
 	       (unsigned long long)skel->bss->total_kernel_prod_failures);
 
+	printf("Kernel producer (unlinkat tracepoint -> KU, non-sleepable):\n");
+	printf("  ops=%llu failures=%llu\n",
+	       (unsigned long long)skel->bss->total_kernel_tp_ops,
+	       (unsigned long long)skel->bss->total_kernel_tp_failures);
+
 	printf("Kernel consumer (uprobe pop from UK):\n");
 	printf("  ops=%llu failures=%llu consumed=%llu\n",
 	       (unsigned long long)skel->bss->total_kernel_consume_ops,
@@ -241,7 +322,23 @@ static void print_statistics(void)
 	printf("Queue states:\n");
 	printf("  KU count=%llu\n", (unsigned long long)queue_ku->count);
 	printf("  UK count=%llu\n", (unsigned long long)queue_uk->count);
+	ds_page_reserve_print(&skel->arena->ds_page_reserve_state);
+	ds_page_owner_print(&skel->arena->ds_page_owner_state);
+	print_remote_free();
 	ds_metrics_print(&skel->arena->global_metrics, "MSQueue");
+	ds_prog_stats_print(&prog_stats, &skel->arena->global_metrics);
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_msqueue_stats_c(queue_ku, &op_stats) == DS_SUCCESS)
+		ds_print_stats("MSQueue KU", &op_stats);
+	if (ds_msqueue_stats_c(queue_uk, &op_stats) == DS_SUCCESS)
+		ds_print_stats("MSQueue UK", &op_stats);
+#endif
+#ifdef DS_PHASES
+	ds_phase_print("MSQueue kernel", &skel->arena->ds_phase_state);
+	ds_phase_print("MSQueue user", DS_PHASE_STATE);
+#endif
 	printf("============================================================\n\n");
 }
 
@@ -250,11 +347,14 @@ static void print_usage(const char *prog)
 	printf("Usage: %s [OPTIONS]\n\n", prog);
 	printf("MSQueue relay test (kernel->user->kernel lanes)\n\n");
 	printf("OPTIONS:\n");
+	printf("  -r N    Page reserve per CPU, 2..%d (default: %u)\n",
+	       DS_PAGE_RESERVE_DEPTH, config.reserve_depth);
 	printf("  -v      Verify both queues on exit\n");
 	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -S      Also report per-run BPF program cost (BPF_ENABLE_STATS)\n");
 	printf("  -h      Show this help\n\n");
 	printf("Flow:\n");
-	printf("  inode_create -> MSQueueKU (kernel producer)\n");
+	printf("  inode_create, unlinkat -> MSQueueKU (kernel producers)\n");
 	printf("  UserThread relays KU -> UK (busy loop)\n");
 	printf("  Ctrl+C triggers uprobe-based kernel consumer on UK\n");
 }
@@ -263,14 +363,20 @@ static int parse_args(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "vsh")) != -1) {
+	while ((opt = getopt(argc, argv, "r:vsSh")) != -1) {
 		switch (opt) {
+		case 'r':
+			config.reserve_depth = (__u32)strtoul(optarg, NULL, 0);
+			break;
 		case 'v':
 			config.verify = true;
 			break;
 		case 's':
 			config.print_stats = true;
 			break;
+		case 'S':
+			config.prog_stats = true;
+			break;
 		case 'h':
 			print_usage(argv[0]);
 			exit(0);
@@ -280,11 +386,17 @@ static int parse_args(int argc, char **argv)
 		}
 	}
 
+	if (config.reserve_depth < 2 || config.reserve_depth > DS_PAGE_RESERVE_DEPTH) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
 	return 0;
 }
 
 int main(int argc, char **argv)
 {
+	int nr_cpus;
 	int err;
 
 	if (parse_args(argc, argv) < 0)
@@ -294,18 +406,46 @@ int main(int argc, char **argv)
 	signal(SIGTERM, signal_handler);
 
 	printf("Loading BPF program for integrated MSQueue relay...\n");
-	skel = skeleton_msqueue_bpf__open_and_load();
+	skel = skeleton_msqueue_bpf__open();
 	if (!skel) {
-		fprintf(stderr, "Failed to open and load BPF skeleton\n");
+		fprintf(stderr, "Failed to open BPF skeleton\n");
 		return 1;
 	}
 
+	nr_cpus = libbpf_num_possible_cpus();
+	skel->data->config_reserve_cpus =
+		nr_cpus > 0 && nr_cpus < DS_PAGE_RESERVE_CPUS ? nr_cpus : DS_PAGE_RESERVE_CPUS;
+	skel->data->config_reserve_depth = config.reserve_depth;
+	skel->data->config_reserve_low = config.reserve_depth / 2;
+
+	err = skeleton_msqueue_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
+		goto cleanup;
+	}
+
 	err = setup_userspace_allocator();
 	if (err) {
 		fprintf(stderr, "Failed to set userspace arena allocator range\n");
 		goto cleanup;
 	}
 
+	err = start_reserve();
+	if (err) {
+		fprintf(stderr, "Failed to fill page reserves: %d\n", err);
+		goto cleanup;
+	}
+
+	if (ds_metrics_calibrate_run(&skel->arena->global_metrics,
+				     bpf_program__fd(skel->progs.metrics_calibrate)))
+		fprintf(stderr, "Metrics calibration failed; latencies are not corrected\n");
+	/* -S: count kernel run time from here on, before anything is attached */
+	if (config.prog_stats)
+		consume_stats_idx = DS_PROG_STATS_SETUP(&prog_stats,
+			DS_PROG_STATS_PROG(skel, lsm_inode_create, DS_METRICS_LKMM_PRODUCER),
+			DS_PROG_STATS_PROG(skel, tp_unlinkat, DS_METRICS_LKMM_PRODUCER),
+			DS_PROG_STATS_PROG(skel, bpf_msq_consume, DS_METRICS_LKMM_CONSUMER));
+
 	err = attach_programs();
 	if (err) {
 		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
@@ -320,7 +460,7 @@ int main(int argc, char **argv)
 	}
 	relay_thread_started = true;
 
-	printf("MainThread: attached. Trigger inode_create events in another shell.\n");
+	printf("MainThread: attached. Trigger inode_create/unlinkat events in another shell.\n");
 	printf("Press Ctrl+C to stop and invoke kernel consumer trigger.\n");
 
 	while (!stop_test)
@@ -339,6 +479,7 @@ int main(int argc, char **argv)
 	err = 0;
 
 cleanup:
+	ds_prog_stats_close(&prog_stats);
 	skeleton_msqueue_bpf__destroy(skel);
 	return err;
 }
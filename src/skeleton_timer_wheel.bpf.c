@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define BPF_NO_KFUNC_PROTOTYPES
+#include <vmlinux.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "bpf_experimental.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARENA);
+	__uint(map_flags, BPF_F_MMAPABLE);
+	__uint(max_entries, 1000);
+#ifdef __TARGET_ARCH_arm64
+	__ulong(map_extra, 0x1ull << 32);
+#else
+	__ulong(map_extra, 0x1ull << 44);
+#endif
+} arena SEC(".maps");
+
+#include "libarena_ds.h"
+#include "ds_api.h"
+#include "ds_vyukhov.h"
+#include "ds_timer_wheel.h"
+
+#define CLOCK_MONOTONIC 1
+
+struct tick_timer {
+	struct bpf_timer timer;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, int);
+	__type(value, struct tick_timer);
+} tick_map SEC(".maps");
+
+int config_queue_capacity = 128;
+__u64 config_tick_ns = 1000000;   /* 1 ms */
+__u64 config_delay_ns = 100000000; /* 100 ms follow-up */
+
+struct ds_timer_wheel __arena global_wheel;
+struct ds_vyukhov_head __arena global_ds_head_ku;
+
+__u64 total_kernel_sched_ops = 0;
+__u64 total_kernel_sched_failures = 0;
+__u64 total_kernel_reclaimed = 0;
+__u64 total_ticks = 0;
+__u64 total_emitted = 0;
+bool initialized = false;
+
+/* Non-sleepable: advances and emits, never allocates or frees */
+static int wheel_tick(void *map, int *key, struct tick_timer *val)
+{
+	(void)map;
+	(void)key;
+
+	total_emitted += ds_timer_wheel_advance_lkmm(&global_wheel, bpf_ktime_get_ns(),
+						     &global_ds_head_ku);
+	total_ticks++;
+	bpf_timer_start(&val->timer, config_tick_ns, 0);
+	return 0;
+}
+
+/* Run once from userspace via BPF_PROG_TEST_RUN before attaching */
+SEC("syscall")
+int start_wheel(void *ctx)
+{
+	struct tick_timer *t;
+	int key = 0;
+	int ret;
+
+	(void)ctx;
+
+	ret = ds_timer_wheel_init_lkmm(&global_wheel, config_tick_ns, bpf_ktime_get_ns());
+	if (ret != DS_SUCCESS)
+		return ret;
+	ret = ds_vyukhov_init_lkmm(&global_ds_head_ku, config_queue_capacity);
+	if (ret != DS_SUCCESS)
+		return ret;
+
+	t = bpf_map_lookup_elem(&tick_map, &key);
+	if (!t)
+		return DS_ERROR_INVALID;
+	if (bpf_timer_init(&t->timer, &tick_map, CLOCK_MONOTONIC) ||
+	    bpf_timer_set_callback(&t->timer, wheel_tick) ||
+	    bpf_timer_start(&t->timer, config_tick_ns, 0))
+		return DS_ERROR_INVALID;
+
+	initialized = true;
+	return DS_SUCCESS;
+}
+
+SEC("lsm.s/inode_create")
+int BPF_PROG(lsm_inode_create, struct inode *dir, struct dentry *dentry, umode_t mode)
+{
+	__u64 now, pid;
+	int result;
+
+	(void)dir;
+	(void)dentry;
+	(void)mode;
+
+	if (!initialized)
+		return 0;
+
+	/* Sleepable context: free what the timer callback retired */
+	total_kernel_reclaimed += ds_timer_wheel_reclaim_lkmm(&global_wheel);
+
+	pid = bpf_get_current_pid_tgid() >> 32;
+	now = bpf_ktime_get_ns();
+	result = ds_timer_wheel_schedule_lkmm(&global_wheel, now + config_delay_ns,
+					      pid, now + config_delay_ns, NULL);
+
+	total_kernel_sched_ops++;
+	if (result != DS_SUCCESS)
+		total_kernel_sched_failures++;
+
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "ds_api.h"
+#include "ds_vyukhov.h"
+#include "ds_timer_wheel.h"
+#include "skeleton_timer_wheel.skel.h"
+
+struct test_config {
+	bool verify;
+	bool print_stats;
+	__u64 tick_ns;
+	__u64 delay_ns;
+};
+
+static struct test_config config = {
+	.verify = false,
+	.print_stats = true,
+	.tick_ns = 1000000,
+	.delay_ns = 100000000,
+};
+
+static struct skeleton_timer_wheel_bpf *skel;
+static volatile sig_atomic_t stop_test;
+static pthread_t relay_thread;
+static bool relay_thread_started;
+static __u64 ku_dequeued_count;
+static __u64 late_total_ns;
+static __u64 late_max_ns;
+static __u64 early_count;
+
+static void signal_handler(int sig)
+{
+	(void)sig;
+	stop_test = 1;
+}
+
+/* bpf_ktime_get_ns() and CLOCK_MONOTONIC share a time base */
+static __u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ull + (__u64)ts.tv_nsec;
+}
+
+static int start_wheel(void)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, opts);
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.start_wheel), &opts);
+	if (err)
+		return err;
+	return opts.retval == DS_SUCCESS ? 0 : -1;
+}
+
+static int attach_programs(void)
+{
+	struct bpf_link *lsm_link;
+	int err;
+
+	lsm_link = bpf_program__attach_lsm(skel->progs.lsm_inode_create);
+	err = libbpf_get_error(lsm_link);
+	if (err)
+		return err;
+	skel->links.lsm_inode_create = lsm_link;
+
+	return 0;
+}
+
+/* Drain expired follow-ups and measure how late each one was delivered */
+static void *relay_worker(void *arg)
+{
+	struct ds_vyukhov_head *head_ku = &skel->arena->global_ds_head_ku;
+	struct ds_kv data;
+	int ret;
+
+	(void)arg;
+
+	printf("UserThread: draining expired timers from KU lane\n");
+
+	while (!stop_test) {
+		ret = ds_vyukhov_pop_c(head_ku, &data);
+		if (ret != DS_SUCCESS)
+			continue;
+
+		__u64 now = now_ns();
+
+		ku_dequeued_count++;
+		if (now < data.value) {
+			early_count++;
+			continue;
+		}
+		late_total_ns += now - data.value;
+		if (now - data.value > late_max_ns)
+			late_max_ns = now - data.value;
+	}
+
+	return NULL;
+}
+
+static int verify_data_structure(void)
+{
+	struct ds_vyukhov_head *head_ku = &skel->arena->global_ds_head_ku;
+	int ku_result;
+
+	printf("Verifying KU lane from userspace...\n");
+
+	ku_result = ds_vyukhov_verify_c(head_ku);
+	if (ku_result == DS_SUCCESS && early_count == 0) {
+		printf("Verification PASSED (KU=%d early=0)\n", ku_result);
+		return DS_SUCCESS;
+	}
+
+	printf("Verification FAILED (KU=%d early=%llu)\n", ku_result,
+	       (unsigned long long)early_count);
+	return DS_ERROR_INVALID;
+}
+
+static void print_statistics(void)
+{
+	struct ds_timer_wheel *wheel = &skel->arena->global_wheel;
+
+	printf("\n============================================================\n");
+	printf("                 TIMER WHEEL STATISTICS                     \n");
+	printf("============================================================\n");
+	printf("Kernel scheduler (inode_create -> wheel, +%llu ms):\n",
+	       (unsigned long long)(config.delay_ns / 1000000));
+	printf("  ops=%llu failures=%llu reclaimed=%llu\n",
+	       (unsigned long long)skel->bss->total_kernel_sched_ops,
+	       (unsigned long long)skel->bss->total_kernel_sched_failures,
+	       (unsigned long long)skel->bss->total_kernel_reclaimed);
+
+	printf("Timer callback (wheel -> KU, every %llu us):\n",
+	       (unsigned long long)(config.tick_ns / 1000));
+	printf("  ticks=%llu emitted=%llu\n",
+	       (unsigned long long)skel->bss->total_ticks,
+	       (unsigned long long)skel->bss->total_emitted);
+
+	printf("Wheel: scheduled=%llu cancelled=%llu fired=%llu lane_full=%llu freed=%llu"
+	       " reclaim_busy=%llu\n",
+	       (unsigned long long)wheel->scheduled, (unsigned long long)wheel->cancelled,
+	       (unsigned long long)wheel->fired, (unsigned long long)wheel->lane_full,
+	       (unsigned long long)wheel->freed, (unsigned long long)wheel->reclaim_busy);
+
+	printf("Userspace relay:\n");
+	printf("  KU popped=%llu early=%llu\n",
+	       (unsigned long long)ku_dequeued_count, (unsigned long long)early_count);
+	if (ku_dequeued_count > early_count)
+		printf("  lateness avg=%llu us max=%llu us\n",
+		       (unsigned long long)(late_total_ns / (ku_dequeued_count - early_count) / 1000),
+		       (unsigned long long)(late_max_ns / 1000));
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_timer_wheel_stats_c(wheel, &op_stats) == DS_SUCCESS)
+		ds_print_stats("Timer wheel", &op_stats);
+#endif
+	printf("============================================================\n\n");
+}
+
+static void print_usage(const char *prog)
+{
+	printf("Usage: %s [OPTIONS]\n\n", prog);
+	printf("Timer wheel test (deadline follow-ups for inode_create)\n\n");
+	printf("OPTIONS:\n");
+	printf("  -d MS   Follow-up delay after each event (default: %llu)\n",
+	       (unsigned long long)(config.delay_ns / 1000000));
+	printf("  -t US   Wheel tick / BPF timer period (default: %llu)\n",
+	       (unsigned long long)(config.tick_ns / 1000));
+	printf("  -v      Verify the lane on exit\n");
+	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -h      Show this help\n\n");
+	printf("Flow:\n");
+	printf("  inode_create -> schedule(now + delay)\n");
+	printf("  bpf_timer callback advances the wheel -> VyukhovKU\n");
+	printf("  UserThread drains KU and reports delivery lateness\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:t:vsh")) != -1) {
+		switch (opt) {
+		case 'd':
+			config.delay_ns = strtoull(optarg, NULL, 0) * 1000000ull;
+			break;
+		case 't':
+			config.tick_ns = strtoull(optarg, NULL, 0) * 1000ull;
+			break;
+		case 'v':
+			config.verify = true;
+			break;
+		case 's':
+			config.print_stats = true;
+			break;
+		case 'h':
+			print_usage(argv[0]);
+			exit(0);
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (!config.tick_ns) {
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int err;
+
+	if (parse_args(argc, argv) < 0)
+		return 1;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	printf("Loading BPF program for timer wheel...\n");
+	skel = skeleton_timer_wheel_bpf__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	skel->data->config_tick_ns = config.tick_ns;
+	skel->data->config_delay_ns = config.delay_ns;
+
+	err = skeleton_timer_wheel_bpf__load(skel);
+	if (err) {
+		fprintf(stderr, "Failed to load BPF skeleton: %d\n", err);
+		goto cleanup;
+	}
+
+	err = start_wheel();
+	if (err) {
+		fprintf(stderr, "Failed to start timer wheel: %d\n", err);
+		goto cleanup;
+	}
+
+	err = attach_programs();
+	if (err) {
+		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
+		goto cleanup;
+	}
+
+	err = pthread_create(&relay_thread, NULL, relay_worker, NULL);
+	if (err) {
+		fprintf(stderr, "Failed to create relay thread: %s\n", strerror(err));
+		err = -1;
+		goto cleanup;
+	}
+	relay_thread_started = true;
+
+	printf("MainThread: attached. Trigger inode_create events in another shell.\n");
+	printf("Press Ctrl+C to stop.\n");
+
+	while (!stop_test)
+		pause();
+
+	if (relay_thread_started)
+		pthread_join(relay_thread, NULL);
+
+	if (config.verify)
+		verify_data_structure();
+	if (config.print_stats)
+		print_statistics();
+
+	err = 0;
+
+cleanup:
+	skeleton_timer_wheel_bpf__destroy(skel);
+	return err;
+}
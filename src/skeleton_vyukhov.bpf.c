@@ -20,8 +20,15 @@ struct {
 
 #include "libarena_ds.h"
 #include "ds_api.h"
+#include "ds_trace.h"
 #include "ds_vyukhov.h"
 #include "ds_metrics.h"
+#include "ds_seqlock.h"
+#include "ds_filter.h"
+
+/* Trace lane ids: the order publish_lanes() in skeleton_vyukhov.c uses */
+#define VYUKHOV_LANE_KU 0
+#define VYUKHOV_LANE_UK 1
 
 int config_key_range = 1000;
 int config_queue_capacity = 128;
@@ -29,6 +36,10 @@ int config_queue_capacity = 128;
 struct ds_vyukhov_head __arena global_ds_head_ku;
 struct ds_vyukhov_head __arena global_ds_head_uk;
 struct ds_metrics_store __arena global_metrics;
+struct ds_lane_stats_pcpu __arena global_stats_ku;
+struct ds_lane_stats_pcpu __arena global_stats_uk;
+struct ds_filter_rules __arena global_filter;
+struct ds_trace_store __arena global_trace;
 
 __u64 total_kernel_prod_ops = 0;
 __u64 total_kernel_prod_failures = 0;
@@ -42,6 +53,7 @@ int BPF_PROG(lsm_inode_create, struct inode *dir, struct dentry *dentry, umode_t
 {
 	struct ds_vyukhov_head __arena *head = &global_ds_head_ku;
 	int result;
+	int verdict;
 	__u64 pid;
 	__u64 ts;
 
@@ -59,14 +71,24 @@ int BPF_PROG(lsm_inode_create, struct inode *dir, struct dentry *dentry, umode_t
 	}
 
 	pid = bpf_get_current_pid_tgid() >> 32;
+
+	/* Userspace rules decide before anything reaches the KU lane */
+	verdict = ds_filter_check_lkmm(&global_filter, pid, bpf_get_current_cgroup_id(),
+				       bpf_get_prandom_u32());
+	ds_metrics_count_filter(&global_metrics, verdict);
+	if (verdict != DS_FILTER_ENQUEUE)
+		return 0;
+
 	ts = bpf_ktime_get_ns();
-	DS_METRICS_RECORD_OP(&global_metrics, DS_METRICS_LKMM_PRODUCER, {
+	DS_TRACE_RECORD_OP_LKMM(&global_metrics, DS_METRICS_LKMM_PRODUCER, &global_trace,
+				DS_OP_INSERT, VYUKHOV_LANE_KU, {
 		result = ds_vyukhov_insert_lkmm(head, pid, ts);
 	}, result);
 
 	total_kernel_prod_ops++;
 	if (result != DS_SUCCESS)
 		total_kernel_prod_failures++;
+	ds_lane_stats_update_lkmm(&global_stats_ku, result);
 
 	return 0;
 }
@@ -86,10 +108,12 @@ int bpf_vyukhov_consume(struct pt_regs *ctx)
 		return DS_ERROR_INVALID;
 	}
 
-	DS_METRICS_RECORD_OP(&global_metrics, DS_METRICS_LKMM_CONSUMER, {
+	DS_TRACE_RECORD_OP_LKMM(&global_metrics, DS_METRICS_LKMM_CONSUMER, &global_trace,
+				DS_OP_POP, VYUKHOV_LANE_UK, {
 		ret = ds_vyukhov_pop_lkmm(head, &out);
 	}, ret);
 	total_kernel_consume_ops++;
+	ds_lane_stats_update_lkmm(&global_stats_uk, ret);
 	if (ret == DS_SUCCESS) {
 		total_kernel_consumed++;
 		bpf_printk("vyukhov consume key=%llu value=%llu\n", out.key, out.value);
@@ -100,4 +124,7 @@ int bpf_vyukhov_consume(struct pt_regs *ctx)
 	return ret;
 }
 
+/* Kernel half of the metrics calibration, run once before attaching */
+DS_METRICS_CALIBRATE_PROG(&global_metrics)
+
 char _license[] SEC("license") = "GPL";
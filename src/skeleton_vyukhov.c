@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,15 +17,34 @@
 #include <bpf/libbpf.h>
 
 #include "ds_api.h"
+#include "ds_trace.h"
 #include "ds_vyukhov.h"
 #include "ds_metrics.h"
+#include "ds_prog_stats.h"
+#include "ds_seqlock.h"
+#include "ds_filter.h"
+#include "ds_lane_dir.h"
 #include "skeleton_vyukhov.skel.h"
 
 #define VYUKHOV_QUEUE_CAPACITY 128
+#define VYUKHOV_MAX_FILTER_PIDS 64
+#define VYUKHOV_PIN_PATH_LEN 256
+
+/* Trace lane ids, in publish_lanes() order (skeleton_vyukhov.bpf.c matches) */
+#define VYUKHOV_LANE_KU 0
+#define VYUKHOV_LANE_UK 1
 
 struct test_config {
 	bool verify;
 	bool print_stats;
+	bool prog_stats;
+	__u64 filter_pids[VYUKHOV_MAX_FILTER_PIDS];
+	int nr_filter_pids;
+	__u64 filter_cgroup;
+	__u32 sample_rate;
+	const char *pin_dir;
+	bool persist;
+	const char *trace_path;
 };
 
 static struct test_config config = {
@@ -32,10 +54,21 @@ static struct test_config config = {
 
 static struct skeleton_vyukhov_bpf *skel;
 static volatile sig_atomic_t stop_test;
+static struct ds_prog_stats prog_stats = { .stats_fd = -1 };
+static int consume_stats_idx = -1;
 static pthread_t relay_thread;
 static bool relay_thread_started;
 static __u64 ku_dequeued_count;
 static __u64 uk_enqueued_count;
+static char arena_pin_path[VYUKHOV_PIN_PATH_LEN];
+static bool lane_dir_ready;
+static bool warm_start;
+static __u64 alloc_prev_used;
+static __u64 start_ns;
+static __u64 first_event_ns;
+static __u64 prev_detach_ns;
+static __u64 restart_backlog;
+static const char *const lane_names[] = { "ku", "uk" };
 
 __attribute__((noinline)) void vyukhov_kernel_consume_trigger(void)
 {
@@ -48,6 +81,34 @@ static void signal_handler(int sig)
 	stop_test = 1;
 }
 
+static void *arena_base(void)
+{
+	return (void *)(unsigned long)bpf_map__map_extra(skel->maps.arena);
+}
+
+static size_t arena_size(void)
+{
+	return (size_t)bpf_map__max_entries(skel->maps.arena) * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void pin_path(char *buf, const char *name)
+{
+	snprintf(buf, VYUKHOV_PIN_PATH_LEN, "%s/%s", config.pin_dir, name);
+}
+
+/* Allocator bytes handed out so far, across restarts; a successor starts past them */
+static __u64 alloc_used(void)
+{
+	return alloc_prev_used + bpf_arena_userspace_next_page_off;
+}
+
+static void record_alloc_used(void)
+{
+	if (lane_dir_ready)
+		ds_lane_dir_at(arena_base())->alloc_used = alloc_used();
+}
+
+/* Format the lane directory and hand the pages behind it to the allocator */
 static int setup_userspace_allocator(void)
 {
 	size_t arena_bytes;
@@ -59,18 +120,215 @@ static int setup_userspace_allocator(void)
 	if (page_size <= 0)
 		return -1;
 
-	arena_bytes = (size_t)bpf_map__max_entries(skel->maps.arena) * (size_t)page_size;
-	if (arena_bytes <= (size_t)page_size)
+	arena_bytes = arena_size();
+	if (sizeof(*skel->arena) > DS_LANE_DIR_OFFSET ||
+	    ds_lane_dir_init(arena_base(), arena_bytes) != DS_SUCCESS)
 		return -1;
 
-	alloc_base = (void *)((char *)skel->arena + (size_t)page_size);
-	alloc_bytes = arena_bytes - (size_t)page_size;
+	lane_dir_ready = true;
+
+	alloc_base = ds_lane_dir_end(arena_base());
+	alloc_bytes = arena_bytes - DS_LANE_DIR_OFFSET - DS_LANE_DIR_BYTES;
 	bpf_arena_userspace_set_range(alloc_base, alloc_bytes);
 
 	printf("Arena alloc range: base=%p size=%zu KB\n", alloc_base, alloc_bytes / 1024);
 	return 0;
 }
 
+/* Publish the -p/-g/-r rules before the hook is attached */
+static int setup_filter(void)
+{
+	struct ds_filter_rules *rules = &skel->arena->global_filter;
+	__u32 flags = 0;
+	int err;
+
+	err = ds_filter_init_c(rules);
+	if (err)
+		return err;
+
+	for (int i = 0; i < config.nr_filter_pids; i++) {
+		err = ds_filter_pid_set_c(rules, config.filter_pids[i], 0);
+		if (err)
+			return err;
+	}
+	if (config.nr_filter_pids)
+		flags |= DS_FILTER_PID_ALLOW;
+
+	if (config.filter_cgroup) {
+		err = ds_filter_cgroup_set_c(rules, config.filter_cgroup, 0);
+		if (err)
+			return err;
+		flags |= DS_FILTER_CGROUP_ALLOW;
+	}
+
+	if (flags || config.sample_rate > 1)
+		printf("Source filter: pids=%d cgroup=%llu sample=1/%u\n",
+		       config.nr_filter_pids, (unsigned long long)config.filter_cgroup,
+		       config.sample_rate > 1 ? config.sample_rate : 1);
+
+	return ds_filter_set_mode_c(rules, flags, config.sample_rate);
+}
+
+/* Name both lanes in the directory and, with -P, pin the arena for other processes */
+static int publish_lanes(void)
+{
+	struct ds_lane_dir *dir = ds_lane_dir_at(arena_base());
+	int err;
+
+	err = ds_lane_dir_publish(dir, "ku", DS_LANE_KIND_VYUKHOV, &skel->arena->global_ds_head_ku,
+				  VYUKHOV_QUEUE_CAPACITY, DS_LANE_F_KU);
+	if (!err)
+		err = ds_lane_dir_publish(dir, "uk", DS_LANE_KIND_VYUKHOV,
+					  &skel->arena->global_ds_head_uk,
+					  VYUKHOV_QUEUE_CAPACITY, DS_LANE_F_UK);
+	if (err || !config.pin_dir)
+		return err;
+
+	snprintf(arena_pin_path, sizeof(arena_pin_path), "%s/arena", config.pin_dir);
+	err = bpf_map__pin(skel->maps.arena, arena_pin_path);
+	if (err) {
+		arena_pin_path[0] = '\0';
+		return err;
+	}
+
+	printf("Arena pinned at %s (map_extra=%p, lanes: ku uk)\n", arena_pin_path, arena_base());
+	return 0;
+}
+
+/*
+ * -R, first start: also pin .bss (the kernel counters), the LSM program and
+ * its link. The pinned link keeps inode_create feeding KU after this
+ * process exits. The uprobe is per-pid, so every relay attaches its own.
+ */
+static int pin_for_restart(void)
+{
+	char path[VYUKHOV_PIN_PATH_LEN];
+	int err;
+
+	pin_path(path, "bss");
+	err = bpf_map__pin(skel->maps.bss, path);
+	if (err)
+		return err;
+	pin_path(path, "prog_lsm_inode_create");
+	err = bpf_program__pin(skel->progs.lsm_inode_create, path);
+	if (err)
+		return err;
+	pin_path(path, "link_lsm_inode_create");
+	err = bpf_link__pin(skel->links.lsm_inode_create, path);
+	if (err)
+		return err;
+
+	printf("Hot restart: programs, link and maps pinned in %s\n", config.pin_dir);
+	return 0;
+}
+
+/* -R, later starts: load against the pinned arena and .bss instead of fresh maps */
+static struct skeleton_vyukhov_bpf *open_and_load_warm(void)
+{
+	char path[VYUKHOV_PIN_PATH_LEN];
+	struct skeleton_vyukhov_bpf *s;
+	int arena_fd, bss_fd, err;
+
+	s = skeleton_vyukhov_bpf__open();
+	if (!s)
+		return NULL;
+
+	pin_path(path, "arena");
+	arena_fd = bpf_obj_get(path);
+	pin_path(path, "bss");
+	bss_fd = bpf_obj_get(path);
+
+	err = arena_fd < 0 || bss_fd < 0 ||
+	      bpf_map__reuse_fd(s->maps.arena, arena_fd) ||
+	      bpf_map__reuse_fd(s->maps.bss, bss_fd);
+	if (!err) {
+		/* The pinned link keeps running the first relay's LSM program */
+		bpf_program__set_autoload(s->progs.lsm_inode_create, false);
+		err = skeleton_vyukhov_bpf__load(s);
+	}
+
+	if (arena_fd >= 0)
+		close(arena_fd);
+	if (bss_fd >= 0)
+		close(bss_fd);
+	if (err) {
+		skeleton_vyukhov_bpf__destroy(s);
+		return NULL;
+	}
+	return s;
+}
+
+/*
+ * Warm start: map the pinned arena at map_extra, find the globals through
+ * the "ku" directory entry, and continue the allocator where the previous
+ * relay stopped. The lanes keep their indices, so the relay drains from
+ * where the last one left off, including everything BPF queued meanwhile.
+ */
+static int reattach_arena(void)
+{
+	struct ds_lane_dir_entry *ku;
+	struct ds_arena_view view;
+	struct ds_lane_dir *dir;
+	int err;
+
+	/* libbpf does not mmap an arena whose fd was reused */
+	if (!skel->arena) {
+		err = ds_arena_view_map(&view, bpf_map__fd(skel->maps.arena), arena_base(),
+					arena_size());
+		if (err)
+			return err;
+	}
+
+	dir = ds_lane_dir_at(arena_base());
+	ku = ds_lane_dir_lookup(dir, "ku");
+	if (!ku)
+		return DS_ERROR_NOT_FOUND;
+
+	skel->arena = (void *)((char *)ds_lane_head(ku) -
+			       offsetof(__typeof__(*skel->arena), global_ds_head_ku));
+	lane_dir_ready = true;
+
+	prev_detach_ns = ds_lane_dir_reattach(dir);
+	restart_backlog = skel->arena->global_ds_head_ku.count;
+	alloc_prev_used = dir->alloc_used;
+	bpf_arena_userspace_set_range((char *)ds_lane_dir_end(arena_base()) + alloc_prev_used,
+				      arena_size() - DS_LANE_DIR_OFFSET - DS_LANE_DIR_BYTES -
+				      alloc_prev_used);
+
+	printf("Hot restart #%llu: re-attached to %s/arena, KU backlog=%llu%s\n",
+	       (unsigned long long)dir->restarts, config.pin_dir,
+	       (unsigned long long)restart_backlog,
+	       prev_detach_ns ? "" : " (previous relay did not detach cleanly)");
+	if (config.nr_filter_pids || config.filter_cgroup || config.sample_rate)
+		printf("Hot restart: keeping the pinned filter rules; -p/-g/-r ignored\n");
+	return 0;
+}
+
+/*
+ * Closed lanes tell attached consumers to drain and detach; the pin goes
+ * away. With -R everything stays pinned and the lanes stay open for the
+ * next relay.
+ */
+static void unpublish_lanes(void)
+{
+	struct ds_lane_dir *dir;
+
+	if (!lane_dir_ready)
+		return;
+
+	dir = ds_lane_dir_at(arena_base());
+	if (config.persist) {
+		ds_lane_dir_detach(dir, alloc_used());
+		printf("Hot restart: relay detached; lanes stay pinned in %s\n", config.pin_dir);
+		return;
+	}
+
+	for (__u32 i = 0; i < dir->nr_lanes; i++)
+		ds_lane_dir_set_flags(dir, &dir->lanes[i], DS_LANE_F_CLOSED, 0);
+	if (arena_pin_path[0])
+		bpf_map__unpin(skel->maps.arena, arena_pin_path);
+}
+
 static int attach_programs(void)
 {
 	struct bpf_link *lsm_link;
@@ -81,12 +339,16 @@ static int attach_programs(void)
 	};
 	int err;
 
+	if (warm_start)
+		goto attach_uprobe;
+
 	lsm_link = bpf_program__attach_lsm(skel->progs.lsm_inode_create);
 	err = libbpf_get_error(lsm_link);
 	if (err)
 		return err;
 	skel->links.lsm_inode_create = lsm_link;
 
+attach_uprobe:
 	consume_link = bpf_program__attach_uprobe_opts(
 		skel->progs.bpf_vyukhov_consume,
 		getpid(),
@@ -105,6 +367,8 @@ static void *relay_worker(void *arg)
 {
 	struct ds_vyukhov_head *head_ku = &skel->arena->global_ds_head_ku;
 	struct ds_vyukhov_head *head_uk = &skel->arena->global_ds_head_uk;
+	struct ds_trace_store *trace = &skel->arena->global_trace;
+	__u32 ring = ds_trace_register_c(trace);
 	struct ds_kv data;
 	bool uk_initialized = false;
 	int ret;
@@ -127,18 +391,28 @@ static void *relay_worker(void *arg)
 				ret = ds_vyukhov_init_c(head_uk, VYUKHOV_QUEUE_CAPACITY);
 				if (ret != DS_SUCCESS)
 					continue;
+				record_alloc_used();
 			}
 			uk_initialized = true;
 		}
 
-		DS_METRICS_RECORD_OP(&skel->arena->global_metrics, DS_METRICS_USER_CONSUMER, {
+		DS_TRACE_RECORD_OP_C(&skel->arena->global_metrics, DS_METRICS_USER_CONSUMER, trace,
+				     ring, (__u32)sched_getcpu(), DS_OP_POP, VYUKHOV_LANE_KU, {
 			ret = ds_vyukhov_pop_c(head_ku, &data);
 		}, ret);
 		if (ret == DS_SUCCESS) {
 			int ins_ret;
 
-			ku_dequeued_count++;
-			DS_METRICS_RECORD_OP(&skel->arena->global_metrics, DS_METRICS_USER_PRODUCER, {
+			if (!ku_dequeued_count++) {
+				first_event_ns = ds_metrics_clock();
+				if (warm_start)
+					printf("UserThread: first event %.3f ms after start%s\n",
+					       (double)(first_event_ns - start_ns) / 1e6,
+					       prev_detach_ns ? "" : " (no clean detach to measure from)");
+			}
+			DS_TRACE_RECORD_OP_C(&skel->arena->global_metrics, DS_METRICS_USER_PRODUCER,
+					     trace, ring, (__u32)sched_getcpu(), DS_OP_INSERT,
+					     VYUKHOV_LANE_UK, {
 				ins_ret = ds_vyukhov_insert_c(head_uk, data.key, data.value);
 			}, ins_ret);
 			if (ins_ret == DS_SUCCESS)
@@ -159,6 +433,7 @@ static void trigger_kernel_consumer_on_exit(void)
 	__u64 target_consumed;
 	__u64 attempts = 0;
 	__u64 max_attempts;
+	__u64 start_ns;
 
 	initial_consumed = skel->bss->total_kernel_consumed;
 	target_consumed = initial_consumed + uk_enqueued_count;
@@ -171,11 +446,14 @@ static void trigger_kernel_consumer_on_exit(void)
 		return;
 	}
 
+	start_ns = ds_metrics_clock();
 	while (attempts < max_attempts &&
 	       skel->bss->total_kernel_consumed < target_consumed) {
 		vyukhov_kernel_consume_trigger();
 		attempts++;
 	}
+	ds_prog_stats_set_wall(&prog_stats, consume_stats_idx, ds_metrics_clock() - start_ns,
+			       attempts);
 
 	printf("MainThread: consume triggers=%llu consumed=%llu target=%llu\n",
 	       (unsigned long long)attempts,
@@ -210,6 +488,7 @@ static void print_statistics(void)
 {
 	struct ds_vyukhov_head *head_ku = &skel->arena->global_ds_head_ku;
 	struct ds_vyukhov_head *head_uk = &skel->arena->global_ds_head_uk;
+	struct ds_lane_stats lane;
 
 	printf("\n============================================================\n");
 	printf("                   VYUKHOV RELAY STATISTICS                 \n");
@@ -225,18 +504,73 @@ static void print_statistics(void)
 	       (unsigned long long)skel->bss->total_kernel_consume_failures,
 	       (unsigned long long)skel->bss->total_kernel_consumed);
 
+	if (ds_lane_stats_snapshot_c(&skel->arena->global_stats_ku, &lane) != DS_SUCCESS)
+		printf("  (KU lane snapshot incomplete: record held by a stalled writer)\n");
+	printf("KU lane snapshot: ops=%llu ok=%llu failed=%llu dropped=%llu\n",
+	       (unsigned long long)lane.ops, (unsigned long long)lane.successes,
+	       (unsigned long long)lane.failures,
+	       (unsigned long long)skel->arena->global_stats_ku.dropped);
+	if (ds_lane_stats_snapshot_c(&skel->arena->global_stats_uk, &lane) != DS_SUCCESS)
+		printf("  (UK lane snapshot incomplete: record held by a stalled writer)\n");
+	printf("UK lane snapshot: ops=%llu ok=%llu failed=%llu dropped=%llu\n",
+	       (unsigned long long)lane.ops, (unsigned long long)lane.successes,
+	       (unsigned long long)lane.failures,
+	       (unsigned long long)skel->arena->global_stats_uk.dropped);
+
 	printf("Userspace relay:\n");
 	printf("  KU popped=%llu UK pushed=%llu\n",
 	       (unsigned long long)ku_dequeued_count,
 	       (unsigned long long)uk_enqueued_count);
 
+	if (warm_start && first_event_ns) {
+		printf("Hot restart:\n");
+		printf("  backlog at re-attach=%llu start->first event=%.3f ms",
+		       (unsigned long long)restart_backlog,
+		       (double)(first_event_ns - start_ns) / 1e6);
+		if (prev_detach_ns)
+			printf(" previous detach->first event=%.3f ms",
+			       (double)(first_event_ns - prev_detach_ns) / 1e6);
+		printf("\n");
+	}
+
 	printf("Queue states:\n");
 	printf("  KU count=%llu\n", (unsigned long long)head_ku->count);
 	printf("  UK count=%llu\n", (unsigned long long)head_uk->count);
 	ds_metrics_print(&skel->arena->global_metrics, "Vyukhov MPMC");
+	ds_prog_stats_print(&prog_stats, &skel->arena->global_metrics);
+#ifdef DS_OP_STATS
+	struct ds_stats op_stats;
+
+	if (ds_vyukhov_stats_c(head_ku, &op_stats) == DS_SUCCESS)
+		ds_print_stats("Vyukhov MPMC KU", &op_stats);
+	if (ds_vyukhov_stats_c(head_uk, &op_stats) == DS_SUCCESS)
+		ds_print_stats("Vyukhov MPMC UK", &op_stats);
+#endif
 	printf("============================================================\n\n");
 }
 
+/* -T: write the flight recorder rings for chrome://tracing or Perfetto */
+static void export_trace(void)
+{
+	struct ds_trace_store *trace = &skel->arena->global_trace;
+	long written;
+	FILE *f;
+
+	arena_atomic_store(&trace->enabled, 0, ARENA_RELAXED);
+	f = fopen(config.trace_path, "w");
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", config.trace_path, strerror(errno));
+		return;
+	}
+
+	written = ds_trace_export_chrome_c(trace, f, lane_names, 2);
+	fclose(f);
+	if (written < 0)
+		fprintf(stderr, "Failed to export trace: %ld\n", written);
+	else
+		printf("Flight recorder: %ld events written to %s\n", written, config.trace_path);
+}
+
 static void print_usage(const char *prog)
 {
 	printf("Usage: %s [OPTIONS]\n\n", prog);
@@ -244,9 +578,21 @@ static void print_usage(const char *prog)
 	printf("OPTIONS:\n");
 	printf("  -v      Verify both queues on exit\n");
 	printf("  -s      Print statistics on exit (default: enabled)\n");
+	printf("  -S      Also report per-run BPF program cost (BPF_ENABLE_STATS)\n");
+	printf("  -p PID  Only enqueue events from PID (repeatable, up to %d)\n",
+	       VYUKHOV_MAX_FILTER_PIDS);
+	printf("  -g ID   Only enqueue events from cgroup ID\n");
+	printf("  -r N    Enqueue about 1 in N events\n");
+	printf("  -P DIR  Pin the arena at DIR/arena for external lane consumers\n");
+	printf("  -R DIR  Hot restart: pin programs, link and maps in DIR and keep them on\n");
+	printf("          exit; a later -R DIR relay re-attaches and keeps draining\n");
+	printf("          (rm -r DIR to tear down)\n");
+	printf("  -T FILE Record every lane operation in the flight recorder and write\n");
+	printf("          the last %d per CPU/thread to FILE as Chrome trace JSON\n",
+	       DS_TRACE_SLOTS);
 	printf("  -h      Show this help\n\n");
 	printf("Flow:\n");
-	printf("  inode_create -> VyukhovKU (kernel producer)\n");
+	printf("  inode_create -> filter rules -> VyukhovKU (kernel producer)\n");
 	printf("  UserThread relays KU -> UK (busy loop)\n");
 	printf("  Ctrl+C triggers uprobe-based kernel consumer on UK\n");
 }
@@ -255,7 +601,7 @@ static int parse_args(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "vsh")) != -1) {
+	while ((opt = getopt(argc, argv, "vsSp:g:r:P:R:T:h")) != -1) {
 		switch (opt) {
 		case 'v':
 			config.verify = true;
@@ -263,6 +609,32 @@ static int parse_args(int argc, char **argv)
 		case 's':
 			config.print_stats = true;
 			break;
+		case 'S':
+			config.prog_stats = true;
+			break;
+		case 'p':
+			if (config.nr_filter_pids >= VYUKHOV_MAX_FILTER_PIDS) {
+				fprintf(stderr, "Too many -p PIDs (max %d)\n", VYUKHOV_MAX_FILTER_PIDS);
+				return -1;
+			}
+			config.filter_pids[config.nr_filter_pids++] = strtoull(optarg, NULL, 0);
+			break;
+		case 'g':
+			config.filter_cgroup = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			config.sample_rate = (__u32)strtoul(optarg, NULL, 0);
+			break;
+		case 'P':
+			config.pin_dir = optarg;
+			break;
+		case 'R':
+			config.pin_dir = optarg;
+			config.persist = true;
+			break;
+		case 'T':
+			config.trace_path = optarg;
+			break;
 		case 'h':
 			print_usage(argv[0]);
 			exit(0);
@@ -285,25 +657,73 @@ int main(int argc, char **argv)
 	signal(SIGINT, signal_handler);
 	signal(SIGTERM, signal_handler);
 
+	start_ns = ds_metrics_clock();
+	if (config.persist) {
+		snprintf(arena_pin_path, sizeof(arena_pin_path), "%s/arena", config.pin_dir);
+		warm_start = access(arena_pin_path, F_OK) == 0;
+		arena_pin_path[0] = '\0';
+	}
+
 	printf("Loading BPF program for Vyukhov relay...\n");
-	skel = skeleton_vyukhov_bpf__open_and_load();
+	skel = warm_start ? open_and_load_warm() : skeleton_vyukhov_bpf__open_and_load();
 	if (!skel) {
 		fprintf(stderr, "Failed to open and load BPF skeleton\n");
 		return 1;
 	}
 
-	err = setup_userspace_allocator();
-	if (err) {
-		fprintf(stderr, "Failed to set userspace arena allocator range\n");
-		goto cleanup;
+	if (warm_start) {
+		err = reattach_arena();
+		if (err) {
+			fprintf(stderr, "Failed to re-attach to the pinned arena: %d\n", err);
+			goto cleanup;
+		}
+	} else {
+		err = setup_userspace_allocator();
+		if (err) {
+			fprintf(stderr, "Failed to set userspace arena allocator range\n");
+			goto cleanup;
+		}
+
+		err = setup_filter();
+		if (err) {
+			fprintf(stderr, "Failed to publish filter rules: %d\n", err);
+			goto cleanup;
+		}
+
+		err = publish_lanes();
+		if (err) {
+			fprintf(stderr, "Failed to publish lanes: %d\n", err);
+			goto cleanup;
+		}
+		record_alloc_used();
 	}
 
+	if (config.trace_path)
+		arena_atomic_store(&skel->arena->global_trace.enabled, 1, ARENA_RELEASE);
+
+	if (ds_metrics_calibrate_run(&skel->arena->global_metrics,
+				     bpf_program__fd(skel->progs.metrics_calibrate)))
+		fprintf(stderr, "Metrics calibration failed; latencies are not corrected\n");
+	/* -S: count kernel run time from here on, before anything is attached */
+	if (config.prog_stats)
+		consume_stats_idx = DS_PROG_STATS_SETUP(&prog_stats,
+			DS_PROG_STATS_PROG(skel, lsm_inode_create, DS_METRICS_LKMM_PRODUCER),
+			DS_PROG_STATS_PROG(skel, bpf_vyukhov_consume, DS_METRICS_LKMM_CONSUMER));
+
 	err = attach_programs();
 	if (err) {
 		fprintf(stderr, "Failed to attach BPF programs: %d\n", err);
 		goto cleanup;
 	}
 
+	if (config.persist && !warm_start) {
+		err = pin_for_restart();
+		if (err) {
+			fprintf(stderr, "Failed to pin for hot restart: %d\n", err);
+			goto cleanup;
+		}
+	}
+
 	err = pthread_create(&relay_thread, NULL, relay_worker, NULL);
 	if (err) {
 		fprintf(stderr, "Failed to create relay thread: %s\n", strerror(err));
@@ -321,16 +741,22 @@ int main(int argc, char **argv)
 	if (relay_thread_started)
 		pthread_join(relay_thread, NULL);
 
-	trigger_kernel_consumer_on_exit();
+	/* With -R, UK entries wait for the next relay instead */
+	if (!config.persist)
+		trigger_kernel_consumer_on_exit();
 
 	if (config.verify)
 		verify_data_structure();
 	if (config.print_stats)
 		print_statistics();
+	if (config.trace_path)
+		export_trace();
 
 	err = 0;
 
 cleanup:
+	unpublish_lanes();
+	ds_prog_stats_close(&prog_stats);
 	skeleton_vyukhov_bpf__destroy(skel);
 	return err;
 }
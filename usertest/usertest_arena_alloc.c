@@ -0,0 +1,279 @@
+#include "usertest_common.h"
+
+#include <sys/mman.h>
+
+/*
+ * This test exercises the real userspace allocator in libarena_ds.h, not
+ * the bump allocator usertest_common.h redirects to, so drop the redirect
+ * before the DS headers bind to it.
+ */
+#undef bpf_arena_alloc
+#undef bpf_arena_free
+#undef bpf_arena_alloc_large
+#undef bpf_arena_free_large
+
+#include "ds_ck_ring_spsc.h"
+#include "ds_folly_spsc.h"
+#include "ds_io_uring.h"
+#include "ds_kcov.h"
+#include "ds_vyukhov.h"
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 2
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 30000
+#define USERTEST_POLL_US 50
+#define USERTEST_RING_CAPACITY 65536u
+#define USERTEST_ARENA_MB 64u
+
+struct ctx {
+	struct ds_vyukhov_head q;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic int burst_done;
+	uint64_t expected;
+	uint64_t full;	/* inserts that found the ring full during the burst */
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static size_t page_size(void)
+{
+	return bpf_arena_userspace_page_size;
+}
+
+static bool page_aligned(const void *p)
+{
+	return ((uintptr_t)p & (page_size() - 1)) == 0;
+}
+
+static bool all_zero(const void *p, size_t bytes)
+{
+	const unsigned char *b = p;
+
+	for (size_t i = 0; i < bytes; i++)
+		if (b[i])
+			return false;
+	return true;
+}
+
+/* Runs are page-aligned, zeroed, disjoint from small objects, and reused after free */
+static int check_large_runs(void)
+{
+	size_t pg = page_size();
+	void *small, *one, *three, *again;
+
+	small = bpf_arena_alloc(64);
+	one = bpf_arena_alloc_large(pg);
+	three = bpf_arena_alloc_large(2 * pg + 1);
+	if (!small || !one || !three || !page_aligned(one) || !page_aligned(three) ||
+	    !all_zero(three, 3 * pg)) {
+		fprintf(stderr, "arena_alloc: large alloc failed or misaligned\n");
+		return -1;
+	}
+	if (((char *)small >= (char *)one && (char *)small < (char *)one + pg) ||
+	    ((char *)small >= (char *)three && (char *)small < (char *)three + 3 * pg)) {
+		fprintf(stderr, "arena_alloc: small object %p inside a page run\n", small);
+		return -1;
+	}
+	if (bpf_arena_alloc(page_size() - 8) != NULL ||
+	    bpf_arena_alloc_large((__u64)(ARENA_LARGE_MAX_PAGES + 1) * pg) != NULL) {
+		fprintf(stderr, "arena_alloc: size limits not enforced\n");
+		return -1;
+	}
+
+	memset(three, 0xab, 3 * pg);
+	bpf_arena_free_large(three, 2 * pg + 1);
+	again = bpf_arena_alloc_large(2 * pg);
+	if (again != three || !all_zero(again, 2 * pg)) {
+		fprintf(stderr, "arena_alloc: freed run not reused zeroed (%p vs %p)\n", again, three);
+		return -1;
+	}
+	bpf_arena_free_large(again, 2 * pg);
+	bpf_arena_free_large(one, pg);
+
+	fprintf(stdout, "validation: page runs aligned, zeroed, reused after free\n");
+	return 0;
+}
+
+/* More freed runs than the initial table holds are all kept and reused */
+static int check_free_run_overflow(void)
+{
+	enum { NR_RUNS = 2 * ARENA_LARGE_FREE_RUNS + 1 };
+	static void *runs[NR_RUNS];
+	size_t pg = page_size();
+	size_t top;
+
+	for (int i = 0; i < NR_RUNS; i++) {
+		runs[i] = bpf_arena_alloc_large(pg);
+		if (!runs[i]) {
+			fprintf(stderr, "arena_alloc: run %d not allocated\n", i);
+			return -1;
+		}
+	}
+	for (int i = 0; i < NR_RUNS; i++)
+		bpf_arena_free_large(runs[i], pg);
+
+	top = bpf_arena_userspace_next_page_off;
+	for (int i = 0; i < NR_RUNS; i++)
+		runs[i] = bpf_arena_alloc_large(pg);
+	if (bpf_arena_userspace_next_page_off != top || bpf_arena_userspace_lost_pages) {
+		fprintf(stderr, "arena_alloc: freed runs lost (bumped=%zu lost=%zu)\n",
+			(bpf_arena_userspace_next_page_off - top) / pg, bpf_arena_userspace_lost_pages);
+		return -1;
+	}
+	for (int i = 0; i < NR_RUNS; i++)
+		bpf_arena_free_large(runs[i], pg);
+
+	fprintf(stdout, "validation: %d freed runs kept (table of %u)\n", NR_RUNS,
+		bpf_arena_userspace_free_runs_cap);
+	return 0;
+}
+
+/* Every ring header takes its 64K-slot array from a page run */
+static int check_ring_inits(void)
+{
+	struct ds_ck_ring_spsc_head ck = {0};
+	struct ds_spsc_queue_head folly = {0};
+	struct ds_io_uring_ring_head uring = {0};
+	struct ds_kcov_buf kcov = {0};
+
+	if (ds_ck_ring_spsc_init_c(&ck, USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    ds_spsc_init_c(&folly, USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    ds_io_uring_init_c(&uring, USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    ds_kcov_init_c(&kcov, 1 + 2ull * USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    !page_aligned(ck.slots) || !page_aligned(folly.records) ||
+	    !page_aligned(uring.entries) || !page_aligned(kcov.area)) {
+		fprintf(stderr, "arena_alloc: %u-slot ring init failed\n", USERTEST_RING_CAPACITY);
+		return -1;
+	}
+
+	ds_arena_free_array(ck.slots, (__u64)USERTEST_RING_CAPACITY * sizeof(struct ds_kv));
+	ds_arena_free_array(folly.records, (__u64)USERTEST_RING_CAPACITY * sizeof(struct ds_kv));
+	ds_arena_free_array(uring.entries, (__u64)USERTEST_RING_CAPACITY * sizeof(struct ds_kv));
+	ds_arena_free_array(kcov.area, (1 + 2ull * USERTEST_RING_CAPACITY) * sizeof(__u64));
+	fprintf(stdout, "validation: ck_ring/folly/io_uring/kcov init at %u slots\n",
+		USERTEST_RING_CAPACITY);
+	return 0;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			int rc = ds_vyukhov_insert_c(&c->q, key, value);
+			if (rc == DS_SUCCESS)
+				break;
+			if (rc != DS_ERROR_NOMEM && rc != DS_ERROR_BUSY) {
+				fprintf(stderr, "arena_alloc: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			if (rc == DS_ERROR_NOMEM)
+				__atomic_fetch_add(&c->full, 1, __ATOMIC_RELAXED);
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	struct ds_kv out;
+
+	/* The whole burst lands before anyone drains it */
+	while (!atomic_load_explicit(&c->burst_done, memory_order_acquire))
+		usertest_sleep_us(USERTEST_POLL_US);
+
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		int rc = ds_vyukhov_pop_c(&c->q, &out);
+		if (rc == DS_SUCCESS) {
+			uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)out.key, (uint64_t)out.value, (uint64_t)n);
+			continue;
+		}
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_BUSY) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "arena_alloc: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+int main(void)
+{
+	pthread_t prod[USERTEST_NUM_PRODUCERS];
+	pthread_t cons[USERTEST_NUM_CONSUMERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	size_t bytes = (size_t)USERTEST_ARENA_MB << 20;
+	struct ctx c = {0};
+	void *mem;
+
+	usertest_print_config("Arena large allocation", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS_PER_PRODUCER);
+
+	mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	bpf_arena_userspace_set_range(mem, bytes);
+
+	if (check_large_runs() || check_free_run_overflow() || check_ring_inits())
+		return 1;
+
+	if (ds_vyukhov_init_c(&c.q, USERTEST_RING_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "arena_alloc: %u-cell vyukhov init failed\n", USERTEST_RING_CAPACITY);
+		return 1;
+	}
+	c.expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&cons[i], NULL, consumer_thread, &c) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = &c, .tid = i };
+		if (pthread_create(&prod[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(prod[i], NULL);
+	atomic_store_explicit(&c.burst_done, 1, memory_order_release);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(cons[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+	fprintf(stdout, "validation: %" PRIu64 "-entry burst into %u cells, %" PRIu64 " full\n",
+		c.expected, USERTEST_RING_CAPACITY, c.full);
+
+	ds_arena_free_array(c.q.buffer,
+			    (__u64)USERTEST_RING_CAPACITY * sizeof(struct ds_vyukhov_node));
+	return atomic_load(&c.consumed) == c.expected && c.full == 0 ? 0 : 1;
+}
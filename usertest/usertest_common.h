@@ -84,12 +84,53 @@ static inline void usertest_arena_free(void *addr __attribute__((unused)))
 	/* No reclamation in arena model */
 }
 
+/* Page-aligned, like the real allocator's page runs */
+static inline void *usertest_arena_alloc_large(__u64 size)
+{
+	const size_t pg = 4096;
+	size_t n = ((size_t)size + pg - 1) & ~(pg - 1);
+	size_t off, start;
+
+	pthread_once(&usertest_arena_once, usertest_arena_init_once);
+
+	off = atomic_fetch_add_explicit(&usertest_arena_off, n + pg, memory_order_relaxed);
+	start = (((uintptr_t)usertest_arena_base + off + pg - 1) & ~(uintptr_t)(pg - 1)) -
+		(uintptr_t)usertest_arena_base;
+	if (start + n > usertest_arena_bytes)
+		return NULL;
+	return (void *)(usertest_arena_base + start);
+}
+
+static inline void usertest_arena_free_large(void *addr __attribute__((unused)),
+					     __u64 size __attribute__((unused)))
+{
+}
+
+static void usertest_arena_external(void)
+{
+}
+
+/*
+ * Serve allocations from caller-provided memory (e.g. a MAP_SHARED region
+ * that other processes map too) instead of the heap. Call before the first
+ * allocation.
+ */
+static inline void usertest_arena_use(void *base, size_t bytes)
+{
+	pthread_once(&usertest_arena_once, usertest_arena_external);
+	usertest_arena_base = (unsigned char *)base;
+	usertest_arena_bytes = bytes;
+	atomic_store_explicit(&usertest_arena_off, 0, memory_order_relaxed);
+}
+
 /*
  * Redirect DS headers to use our userspace arena allocation without changing
  * anything in include/.
  */
 #define bpf_arena_alloc usertest_arena_alloc
 #define bpf_arena_free usertest_arena_free
+#define bpf_arena_alloc_large usertest_arena_alloc_large
+#define bpf_arena_free_large usertest_arena_free_large
 
 /*
  * Note: smp_store_release and smp_load_acquire are now provided by
@@ -0,0 +1,234 @@
+#include "usertest_common.h"
+
+#include "ds_filter.h"
+#include "ds_vyukhov.h"
+
+#define USERTEST_NUM_PRODUCERS 4
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_EVENTS_PER_PRODUCER 4000
+#define USERTEST_LANE_CAPACITY 256u
+#define USERTEST_RULE_UPDATES 200
+#define USERTEST_NUM_PIDS 8u
+#define USERTEST_PID_BASE 1000u
+#define USERTEST_CGROUP_BASE 50u
+
+struct ctx {
+	struct ds_filter_rules rules;
+	struct ds_vyukhov_head lane;
+	struct ds_metrics_store metrics;
+	_Atomic uint64_t produced;
+	_Atomic int producers_done;
+	uint64_t consumed;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static struct ctx g_ctx;
+
+/* Simulated lsm_inode_create: check the rules, count, enqueue survivors */
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+	uint64_t rnd = 0x9e3779b97f4a7c15ull * (uint64_t)(pa->tid + 1);
+
+	for (int i = 0; i < USERTEST_EVENTS_PER_PRODUCER; i++) {
+		__u64 pid = USERTEST_PID_BASE + (__u64)(i % USERTEST_NUM_PIDS);
+		__u64 cgroup = USERTEST_CGROUP_BASE + (__u64)pa->tid;
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)i;
+		int verdict;
+
+		rnd ^= rnd >> 12;
+		rnd ^= rnd << 25;
+		rnd ^= rnd >> 27;
+
+		verdict = ds_filter_check_c(&c->rules, pid, cgroup, (__u32)(rnd >> 32));
+		ds_metrics_count_filter(&c->metrics, verdict);
+		if (verdict != DS_FILTER_ENQUEUE)
+			continue;
+
+		while (ds_vyukhov_insert_c(&c->lane, key, pid) != DS_SUCCESS)
+			usertest_sleep_us(20);
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, key, (uint64_t)pid);
+	}
+
+	atomic_fetch_add(&c->producers_done, 1);
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	struct ds_kv out;
+
+	for (;;) {
+		if (ds_vyukhov_pop_c(&c->lane, &out) == DS_SUCCESS) {
+			c->consumed++;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64
+				" (n=%" PRIu64 ")\n", (uint64_t)out.key, (uint64_t)out.value,
+				c->consumed);
+			continue;
+		}
+		if (atomic_load(&c->producers_done) == USERTEST_NUM_PRODUCERS &&
+		    c->consumed == atomic_load(&c->produced))
+			break;
+		usertest_sleep_us(20);
+	}
+
+	return NULL;
+}
+
+/* Rule churn while the producers read: sets, rates and mode change in place */
+static void *writer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	for (int k = 0; k < USERTEST_RULE_UPDATES; k++) {
+		__u64 pid = USERTEST_PID_BASE + (__u64)(k % USERTEST_NUM_PIDS);
+		__u64 cgroup = USERTEST_CGROUP_BASE + (__u64)(k % USERTEST_NUM_PRODUCERS);
+
+		if (k % 2)
+			ds_filter_pid_del_c(&c->rules, pid);
+		else
+			ds_filter_pid_set_c(&c->rules, pid, (__u32)(k % 3));
+		ds_filter_cgroup_set_c(&c->rules, cgroup, (__u32)(1 + k % 4));
+		ds_filter_set_mode_c(&c->rules, (k / 50) % 2 ? 0 : DS_FILTER_PID_DENY,
+				     (__u32)(k % 5));
+		if (k % 8 == 7)
+			ds_filter_reclaim_c(&c->rules);
+		usertest_sleep_us(100);
+	}
+
+	return NULL;
+}
+
+static int expect(struct ctx *c, __u64 pid, __u64 cgroup, __u32 rnd, int want)
+{
+	int got = ds_filter_check_c(&c->rules, pid, cgroup, rnd);
+
+	if (got != want) {
+		fprintf(stderr, "filter: pid=%llu cgroup=%llu rnd=%u verdict=%d want=%d\n",
+			(unsigned long long)pid, (unsigned long long)cgroup, rnd, got, want);
+		return 1;
+	}
+	return 0;
+}
+
+static int kept_of_100(struct ctx *c, __u64 pid, __u64 cgroup)
+{
+	int kept = 0;
+
+	for (__u32 r = 0; r < 100; r++)
+		kept += ds_filter_check_c(&c->rules, pid, cgroup, r) == DS_FILTER_ENQUEUE;
+	return kept;
+}
+
+/* Deterministic rule semantics on a fresh table */
+static int semantics_phase(struct ctx *c)
+{
+	int bad = 0;
+
+	if (ds_filter_init_c(&c->rules) != DS_SUCCESS)
+		return 1;
+
+	bad |= expect(c, 10, 7, 1, DS_FILTER_ENQUEUE);
+
+	ds_filter_pid_set_c(&c->rules, 10, 0);
+	ds_filter_set_mode_c(&c->rules, DS_FILTER_PID_ALLOW, 0);
+	bad |= expect(c, 10, 7, 1, DS_FILTER_ENQUEUE);
+	bad |= expect(c, 11, 7, 1, DS_FILTER_DROP_PID);
+
+	ds_filter_set_mode_c(&c->rules, DS_FILTER_PID_DENY, 0);
+	bad |= expect(c, 10, 7, 1, DS_FILTER_DROP_PID);
+	bad |= expect(c, 11, 7, 1, DS_FILTER_ENQUEUE);
+
+	ds_filter_cgroup_set_c(&c->rules, 7, 0);
+	ds_filter_set_mode_c(&c->rules, DS_FILTER_CGROUP_ALLOW, 0);
+	bad |= expect(c, 11, 7, 1, DS_FILTER_ENQUEUE);
+	bad |= expect(c, 11, 8, 1, DS_FILTER_DROP_CGROUP);
+
+	/* Rates: default 4, PID 10 overrides with 2, cgroup 9 with 10 */
+	ds_filter_pid_set_c(&c->rules, 10, 2);
+	ds_filter_cgroup_set_c(&c->rules, 9, 10);
+	ds_filter_set_mode_c(&c->rules, 0, 4);
+	bad |= kept_of_100(c, 11, 8) != 25;
+	bad |= kept_of_100(c, 10, 8) != 50;
+	bad |= kept_of_100(c, 11, 9) != 10;
+	bad |= kept_of_100(c, 10, 9) != 50;
+
+	ds_filter_pid_del_c(&c->rules, 10);
+	bad |= kept_of_100(c, 10, 8) != 25;
+
+	bad |= ds_filter_set_mode_c(&c->rules, DS_FILTER_PID_ALLOW | DS_FILTER_PID_DENY, 0) !=
+	       DS_ERROR_INVALID;
+	bad |= ds_filter_verify(&c->rules) != DS_SUCCESS;
+	ds_filter_reclaim_c(&c->rules);
+
+	fprintf(stdout, "validation: semantics %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
+
+int main(void)
+{
+	struct ctx *c = &g_ctx;
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	pthread_t consumer, writer;
+	uint64_t seen = 0, enqueued;
+
+	usertest_print_config("Source filter", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_EVENTS_PER_PRODUCER);
+
+	if (semantics_phase(c))
+		return 1;
+
+	/* Start from: deny PID 1003, keep 1 in 2 */
+	if (ds_filter_init_c(&c->rules) != DS_SUCCESS ||
+	    ds_filter_pid_set_c(&c->rules, USERTEST_PID_BASE + 3, 0) != DS_SUCCESS ||
+	    ds_filter_set_mode_c(&c->rules, DS_FILTER_PID_DENY, 2) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(&c->lane, USERTEST_LANE_CAPACITY) != DS_SUCCESS)
+		return 1;
+
+	if (pthread_create(&consumer, NULL, consumer_thread, c) != 0 ||
+	    pthread_create(&writer, NULL, writer_thread, c) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	pthread_join(writer, NULL);
+	pthread_join(consumer, NULL);
+
+	for (int v = 0; v < DS_METRICS_FILTER_NUM; v++)
+		seen += c->metrics.filter[v];
+	enqueued = c->metrics.filter[DS_METRICS_FILTER_ENQUEUED];
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), c->consumed);
+	fprintf(stdout, "validation: seen=%" PRIu64 " enqueued=%" PRIu64 " pid=%" PRIu64
+		" cgroup=%" PRIu64 " sampled=%" PRIu64 "\n", seen, enqueued,
+		(uint64_t)c->metrics.filter[DS_METRICS_FILTER_DROP_PID],
+		(uint64_t)c->metrics.filter[DS_METRICS_FILTER_DROP_CGROUP],
+		(uint64_t)c->metrics.filter[DS_METRICS_FILTER_DROP_SAMPLE]);
+
+	if (seen != (uint64_t)USERTEST_NUM_PRODUCERS * USERTEST_EVENTS_PER_PRODUCER ||
+	    enqueued != c->consumed || enqueued == seen || !enqueued ||
+	    ds_filter_verify(&c->rules) != DS_SUCCESS)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include "usertest_common.h"
+
+#include <sched.h>
+
+#include "ds_id_bitmap.h"
+#include "ds_vyukhov.h"
+
+#define USERTEST_NUM_PRODUCERS 4
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 5000
+/* Fewer IDs than in-flight capacity so producers run the pool dry */
+#define USERTEST_NR_IDS 100
+#define USERTEST_LANE_CAPACITY 128
+#define USERTEST_FILL_IDS 4999
+
+#define USERTEST_TOTAL_ITEMS (USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER)
+
+struct ctx {
+	struct ds_id_bitmap ids;
+	struct ds_vyukhov_head lane;
+	_Atomic uint8_t owner[USERTEST_NR_IDS];
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic uint64_t duplicates;
+	_Atomic uint64_t pool_empty;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static struct ctx g_ctx;
+static struct ds_id_bitmap g_fill;
+
+/* Producers hold an ID while its event is in flight; consumers return it */
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t value = (uint64_t)pa->tid * 1000000u + (uint64_t)i;
+		__u32 id;
+		int ret;
+
+		while ((ret = ds_id_bitmap_acquire_c(&c->ids, (__u32)pa->tid, &id)) != DS_SUCCESS) {
+			if (ret == DS_ERROR_FULL)
+				atomic_fetch_add_explicit(&c->pool_empty, 1, memory_order_relaxed);
+			sched_yield();
+		}
+
+		if (atomic_exchange(&c->owner[id], 1) != 0)
+			atomic_fetch_add_explicit(&c->duplicates, 1, memory_order_relaxed);
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%u value=%" PRIu64 "\n", pa->tid, id, value);
+
+		while (ds_vyukhov_insert_c(&c->lane, id, value) != DS_SUCCESS)
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (atomic_load_explicit(&c->consumed, memory_order_relaxed) < USERTEST_TOTAL_ITEMS) {
+		struct ds_kv kv;
+
+		if (ds_vyukhov_pop_c(&c->lane, &kv) != DS_SUCCESS) {
+			sched_yield();
+			continue;
+		}
+
+		uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+		fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+			(uint64_t)kv.key, (uint64_t)kv.value, n);
+
+		if (atomic_exchange(&c->owner[kv.key], 0) != 1)
+			atomic_fetch_add_explicit(&c->duplicates, 1, memory_order_relaxed);
+		if (ds_id_bitmap_release_c(&c->ids, (__u32)kv.key) != DS_SUCCESS)
+			atomic_fetch_add_explicit(&c->duplicates, 1, memory_order_relaxed);
+	}
+
+	return NULL;
+}
+
+/* Single-threaded: exhaust a multi-leaf pool, check FULL, refill order */
+static int fill_phase(void)
+{
+	__u32 id, seen = 0;
+
+	if (ds_id_bitmap_init_c(&g_fill, USERTEST_FILL_IDS) != DS_SUCCESS)
+		return 1;
+
+	for (__u32 i = 0; i < USERTEST_FILL_IDS; i++) {
+		if (ds_id_bitmap_acquire_c(&g_fill, i % 7, &id) != DS_SUCCESS ||
+		    id >= USERTEST_FILL_IDS)
+			return 1;
+		seen++;
+	}
+	if (ds_id_bitmap_acquire_c(&g_fill, 0, &id) != DS_ERROR_FULL)
+		return 1;
+	if (ds_id_bitmap_count_c(&g_fill) != USERTEST_FILL_IDS ||
+	    ds_id_bitmap_verify_c(&g_fill) != DS_SUCCESS)
+		return 1;
+
+	/* Free one ID deep in the pool; any hint must find it again */
+	if (ds_id_bitmap_release_c(&g_fill, 4321) != DS_SUCCESS ||
+	    ds_id_bitmap_release_c(&g_fill, 4321) != DS_ERROR_NOT_FOUND ||
+	    ds_id_bitmap_release_c(&g_fill, USERTEST_FILL_IDS) != DS_ERROR_INVALID)
+		return 1;
+	if (ds_id_bitmap_acquire_c(&g_fill, 3, &id) != DS_SUCCESS || id != 4321)
+		return 1;
+
+	for (__u32 i = 0; i < USERTEST_FILL_IDS; i++)
+		if (ds_id_bitmap_release_c(&g_fill, i) != DS_SUCCESS)
+			return 1;
+
+	fprintf(stdout, "validation: fill ids=%u acquired=%u count_after=%u verify=%d\n",
+		USERTEST_FILL_IDS, seen, ds_id_bitmap_count_c(&g_fill),
+		ds_id_bitmap_verify_c(&g_fill));
+
+	if (ds_id_bitmap_count_c(&g_fill) != 0 || ds_id_bitmap_verify_c(&g_fill) != DS_SUCCESS)
+		return 1;
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx *c = &g_ctx;
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	pthread_t consumers[USERTEST_NUM_CONSUMERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+
+	usertest_print_config("ID bitmap", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_id_bitmap_init_c(&c->ids, USERTEST_NR_IDS) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(&c->lane, USERTEST_LANE_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "id_bitmap: init failed\n");
+		return 1;
+	}
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&consumers[i], NULL, consumer_thread, c) != 0) {
+			perror("pthread_create consumer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(consumers[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), (uint64_t)atomic_load(&c->consumed));
+	fprintf(stdout, "validation: duplicates=%" PRIu64 " pool_empty=%" PRIu64
+		" in_use=%u verify=%d\n",
+		(uint64_t)atomic_load(&c->duplicates), (uint64_t)atomic_load(&c->pool_empty),
+		ds_id_bitmap_count_c(&c->ids), ds_id_bitmap_verify_c(&c->ids));
+
+	if (atomic_load(&c->duplicates) != 0 || ds_id_bitmap_count_c(&c->ids) != 0 ||
+	    ds_id_bitmap_verify_c(&c->ids) != DS_SUCCESS)
+		return 1;
+
+	return fill_phase();
+}
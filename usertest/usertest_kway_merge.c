@@ -0,0 +1,195 @@
+#include "usertest_common.h"
+
+#include <sched.h>
+
+#include "ds_kway_merge.h"
+
+#define USERTEST_NUM_PRODUCERS 4
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS_PER_PRODUCER 2000
+#define USERTEST_LANE_CAPACITY 256
+#define USERTEST_WINDOW_NS 20000000ull /* 20 ms */
+#define USERTEST_POLL_BUDGET 64
+
+#define USERTEST_TOTAL_ITEMS (USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER)
+
+struct ctx {
+	struct ds_ck_ring_spsc_head lanes[USERTEST_NUM_PRODUCERS];
+	struct ds_kway_merge merge;
+	_Atomic uint64_t produced;
+	_Atomic int producers_done;
+	uint64_t consumed;
+	uint64_t last_ts;
+	uint64_t observed_out_of_order;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static struct ctx g_ctx;
+
+/* Each producer owns one lane, like a per-CPU BPF producer */
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)i;
+		uint64_t ts = usertest_now_ns();
+
+		while (ds_ck_ring_spsc_insert_c(&c->lanes[pa->tid], key, ts) != DS_SUCCESS)
+			sched_yield();
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, key, ts);
+
+		if (i % 64 == 0)
+			usertest_sleep_us(50);
+	}
+
+	atomic_fetch_add(&c->producers_done, 1);
+	return NULL;
+}
+
+static void emit_entry(void *arg, __u32 lane, const struct ds_kv *kv)
+{
+	struct ctx *c = arg;
+
+	(void)lane;
+	if (kv->value < c->last_ts)
+		c->observed_out_of_order++;
+	else
+		c->last_ts = kv->value;
+
+	c->consumed++;
+	fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+		(uint64_t)kv->key, (uint64_t)kv->value, c->consumed);
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (atomic_load(&c->producers_done) < USERTEST_NUM_PRODUCERS) {
+		if (!ds_kway_merge_poll(&c->merge, usertest_now_ns(), emit_entry, c,
+					USERTEST_POLL_BUDGET))
+			usertest_sleep_us(20);
+	}
+	ds_kway_merge_flush(&c->merge, emit_entry, c);
+
+	return NULL;
+}
+
+/* Deterministic lanes: interleaved timestamps, idle lane, late arrival */
+static void emit_check(void *arg, __u32 lane, const struct ds_kv *kv)
+{
+	uint64_t *last = arg;
+
+	(void)lane;
+	if (kv->value < *last)
+		*last = ~0ull;
+	else if (*last != ~0ull)
+		*last = kv->value;
+}
+
+static int ordering_phase(void)
+{
+	static struct ds_ck_ring_spsc_head lanes[3];
+	struct ds_ck_ring_spsc_head *ptrs[3] = { &lanes[0], &lanes[1], &lanes[2] };
+	static struct ds_kway_merge m;
+	uint64_t last = 0;
+	__u64 n;
+
+	for (int i = 0; i < 3; i++)
+		if (ds_ck_ring_spsc_init_c(&lanes[i], 64) != DS_SUCCESS)
+			return 1;
+	if (ds_kway_merge_init(&m, ptrs, 3, 1000) != DS_SUCCESS)
+		return 1;
+
+	/* Lane 0: 10,40,70..  lane 1: 20,50,80..  lane 2 idle */
+	for (__u64 t = 0; t < 10; t++) {
+		ds_ck_ring_spsc_insert_c(&lanes[0], t, 10 + 30 * t);
+		ds_ck_ring_spsc_insert_c(&lanes[1], t, 20 + 30 * t);
+	}
+
+	/* Lane 2 is empty, so nothing newer than now - W may go out yet */
+	n = ds_kway_merge_poll(&m, 1030, emit_check, &last, ~0ull);
+	if (n != 2 || last != 20)
+		return 1;
+
+	/* Lane 2 catches up; with every lane staged the merge need not wait */
+	for (__u64 t = 0; t < 10; t++)
+		ds_ck_ring_spsc_insert_c(&lanes[2], t, 30 + 30 * t);
+	n = ds_kway_merge_poll(&m, 1030, emit_check, &last, ~0ull);
+	if (n != 26 || last != 280 || m.violations != 0)
+		return 1;
+
+	/* A stalled producer delivers an entry older than the watermark */
+	ds_ck_ring_spsc_insert_c(&lanes[0], 99, 5);
+	ds_kway_merge_flush(&m, NULL, NULL);
+
+	fprintf(stdout, "validation: ordering emitted=%" PRIu64 " violations=%" PRIu64
+		" window_waits=%" PRIu64 "\n",
+		(uint64_t)m.emitted, (uint64_t)m.violations, (uint64_t)m.window_waits);
+
+	if (m.emitted != 31 || m.violations != 1 || m.lane_regressions != 1)
+		return 1;
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx *c = &g_ctx;
+	struct ds_ck_ring_spsc_head *ptrs[USERTEST_NUM_PRODUCERS];
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	pthread_t consumer;
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+
+	usertest_print_config("K-way merge", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		if (ds_ck_ring_spsc_init_c(&c->lanes[i], USERTEST_LANE_CAPACITY) != DS_SUCCESS)
+			return 1;
+		ptrs[i] = &c->lanes[i];
+	}
+	if (ds_kway_merge_init(&c->merge, ptrs, USERTEST_NUM_PRODUCERS,
+			       USERTEST_WINDOW_NS) != DS_SUCCESS)
+		return 1;
+
+	if (pthread_create(&consumer, NULL, consumer_thread, c) != 0) {
+		perror("pthread_create consumer");
+		return 1;
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	pthread_join(consumer, NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), c->consumed);
+	fprintf(stdout, "validation: violations=%" PRIu64 " observed=%" PRIu64
+		" lane_regressions=%" PRIu64 " window_waits=%" PRIu64 "\n",
+		(uint64_t)c->merge.violations, c->observed_out_of_order,
+		(uint64_t)c->merge.lane_regressions, (uint64_t)c->merge.window_waits);
+
+	/* Producer stalls beyond W are legal but must be reported exactly */
+	if (c->consumed != USERTEST_TOTAL_ITEMS ||
+	    c->merge.violations != c->observed_out_of_order ||
+	    c->merge.lane_regressions != 0)
+		return 1;
+
+	return ordering_phase();
+}
@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+#include "usertest_common.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "ds_ck_ring_spsc.h"
+#include "ds_lane_dir.h"
+#include "ds_vyukhov.h"
+
+/*
+ * Stand-in for a pinned arena: a memfd that the loader maps at a fixed
+ * address (as libbpf maps an arena at map_extra). Consumer processes drop
+ * the mapping they inherited from fork() and re-attach through
+ * ds_arena_view_map(), the same path ds_arena_view_open() takes after
+ * BPF_OBJ_GET.
+ */
+#define USERTEST_ARENA_ADDR ((void *)(1ULL << 44))
+#define USERTEST_ARENA_SIZE (8u << 20)
+
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_EVENT_CONSUMERS 2
+#define USERTEST_NUM_CONSUMERS (USERTEST_EVENT_CONSUMERS + 2)
+#define USERTEST_ITEMS_PER_PRODUCER 5000
+#define USERTEST_LANE_CAPACITY 256u
+#define USERTEST_RESTART_AFTER 1500u
+#define USERTEST_RESTART_GAP_US 20000u
+
+static const char *const lane_names[USERTEST_NUM_PRODUCERS] = { "events", "audit", "relay" };
+
+struct prod_arg {
+	struct ds_lane_dir *dir;
+	int tid;
+};
+
+static int pop_lane(struct ds_lane_dir_entry *e, struct ds_kv *out)
+{
+	if (e->kind == DS_LANE_KIND_CK_RING_SPSC)
+		return ds_ck_ring_spsc_pop(ds_lane_head(e), out);
+	return ds_vyukhov_pop_c(ds_lane_head(e), out);
+}
+
+static int push_lane(struct ds_lane_dir_entry *e, __u64 key, __u64 value)
+{
+	if (e->kind == DS_LANE_KIND_CK_RING_SPSC)
+		return ds_ck_ring_spsc_insert_c(ds_lane_head(e), key, value);
+	return ds_vyukhov_insert_c(ds_lane_head(e), key, value);
+}
+
+/*
+ * Producer 0 feeds the multi-consumer "events" lane, producer 1 the SPSC
+ * "audit" lane. Producer 2 feeds "relay" at a slower pace, so it is still
+ * producing while the relay consumer restarts.
+ */
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ds_lane_dir_entry *e = ds_lane_dir_lookup(pa->dir, lane_names[pa->tid]);
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)i;
+		uint64_t value = key * 7 + 1;
+
+		while (push_lane(e, key, value) != DS_SUCCESS)
+			usertest_sleep_us(20);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, key, value);
+		if (pa->tid == 2 && i % 16 == 15)
+			usertest_sleep_us(20);
+	}
+	return NULL;
+}
+
+/*
+ * Runs in a child process: re-map the arena, attach by name, drain until
+ * closed. A @restart of 1 plays a relay that hands over after
+ * USERTEST_RESTART_AFTER entries (ds_lane_dir_detach). A @restart of 2
+ * plays its successor, which re-attaches and times the gap to its first
+ * entry.
+ */
+static int consumer_process(int fd, const char *lane, int restart)
+{
+	struct ds_arena_view view;
+	struct ds_lane_dir_entry *e;
+	uint64_t last_audit = 0, n = 0, detached = 0, backlog = 0;
+	struct ds_kv out;
+	int bad = 0;
+
+	munmap(USERTEST_ARENA_ADDR, USERTEST_ARENA_SIZE);
+	if (ds_arena_view_map(&view, fd, USERTEST_ARENA_ADDR, USERTEST_ARENA_SIZE) != DS_SUCCESS)
+		return 2;
+
+	e = ds_lane_dir_lookup(view.dir, lane);
+	if (!e || ds_lane_claim(e) != DS_SUCCESS)
+		return 3;
+
+	if (restart == 2) {
+		detached = ds_lane_dir_reattach(view.dir);
+		backlog = arena_atomic_load(&((struct ds_vyukhov_head *)ds_lane_head(e))->count,
+					    ARENA_RELAXED);
+		if (!detached || !backlog)
+			return 5;
+	}
+
+	for (;;) {
+		bool closed = ds_lane_closed(e);
+
+		if (restart == 1 && n == USERTEST_RESTART_AFTER) {
+			ds_lane_dir_detach(view.dir, 0);
+			break;
+		}
+
+		if (pop_lane(e, &out) == DS_SUCCESS) {
+			/* The SPSC lane has one consumer, so it must see keys in order */
+			if (e->kind == DS_LANE_KIND_CK_RING_SPSC) {
+				bad |= n && out.key != last_audit + 1;
+				last_audit = out.key;
+			}
+			if (restart == 2 && !n)
+				fprintf(stdout, "validation: restart gap=%" PRIu64 "us backlog=%" PRIu64
+					" (queued while no relay ran)\n",
+					(uint64_t)(ds_lane_dir_clock() - detached) / 1000, backlog);
+			n++;
+			ds_lane_account(e, 1);
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (%s pid=%d)\n",
+				(uint64_t)out.key, (uint64_t)out.value, lane, (int)getpid());
+			continue;
+		}
+		if (closed)
+			break;
+		usertest_sleep_us(20);
+	}
+
+	ds_lane_release(e);
+	ds_arena_view_close(&view);
+	return bad ? 4 : 0;
+}
+
+static pid_t spawn_consumer(int fd, const char *lane, int restart)
+{
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0)
+		_exit(consumer_process(fd, lane, restart));
+	return pid;
+}
+
+static int wait_status(pid_t pid)
+{
+	int status;
+
+	if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		return -1;
+	return WEXITSTATUS(status);
+}
+
+/* Single-consumer claims: busy while held, taken over from a dead holder */
+static int claim_phase(int fd, struct ds_lane_dir *dir)
+{
+	struct ds_lane_dir_entry *audit = ds_lane_dir_lookup(dir, "audit");
+	pid_t pid;
+	int bad = 0;
+
+	/* A consumer that dies while holding the claim */
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		struct ds_arena_view view;
+
+		munmap(USERTEST_ARENA_ADDR, USERTEST_ARENA_SIZE);
+		if (ds_arena_view_map(&view, fd, USERTEST_ARENA_ADDR, USERTEST_ARENA_SIZE))
+			_exit(2);
+		_exit(ds_lane_claim(ds_lane_dir_lookup(view.dir, "audit")) ? 3 : 0);
+	}
+	bad |= wait_status(pid) != 0;
+	bad |= audit->owner_pid != (__u64)pid;
+
+	bad |= ds_lane_claim(audit) != DS_SUCCESS;
+	bad |= audit->owner_pid != (__u64)getpid();
+
+	/* A second live process is refused */
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0)
+		_exit(ds_lane_claim(audit) == DS_ERROR_BUSY ? 0 : 1);
+	bad |= wait_status(pid) != 0;
+
+	ds_lane_release(audit);
+	bad |= audit->owner_pid != 0;
+	audit->consumers = 0;
+
+	/* Mapping over a live arena is refused; a missing lane is not found */
+	bad |= ds_arena_view_map(&(struct ds_arena_view){ 0 }, fd, USERTEST_ARENA_ADDR,
+				 USERTEST_ARENA_SIZE) != DS_ERROR_BUSY;
+	bad |= ds_lane_dir_lookup(dir, "nope") != NULL;
+	bad |= ds_lane_dir_publish(dir, "audit", DS_LANE_KIND_VYUKHOV, audit, 0, 0) !=
+	       DS_ERROR_EXISTS;
+
+	fprintf(stdout, "validation: claims %s\n", bad ? "FAILED" : "ok");
+	return bad;
+}
+
+int main(void)
+{
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	pid_t consumers[USERTEST_NUM_CONSUMERS];
+	struct ds_vyukhov_head *events, *relay;
+	struct ds_ck_ring_spsc_head *audit;
+	struct ds_lane_dir *dir;
+	uint64_t consumed;
+	void *base;
+	int fd, bad = 0;
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	usertest_print_config("Lane directory (cross-process)", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS_PER_PRODUCER);
+
+	fd = memfd_create("usertest_lane_dir", 0);
+	if (fd < 0 || ftruncate(fd, USERTEST_ARENA_SIZE) != 0) {
+		perror("memfd");
+		return 1;
+	}
+	base = mmap(USERTEST_ARENA_ADDR, USERTEST_ARENA_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+	if (base != USERTEST_ARENA_ADDR) {
+		perror("mmap");
+		return 1;
+	}
+
+	/* Loader: directory, then lanes from the allocator range behind it */
+	if (ds_lane_dir_init(base, USERTEST_ARENA_SIZE) != DS_SUCCESS)
+		return 1;
+	dir = ds_lane_dir_at(base);
+	usertest_arena_use(ds_lane_dir_end(base),
+			   USERTEST_ARENA_SIZE - DS_LANE_DIR_OFFSET - DS_LANE_DIR_BYTES);
+
+	events = bpf_arena_alloc(sizeof(*events));
+	audit = bpf_arena_alloc(sizeof(*audit));
+	relay = bpf_arena_alloc(sizeof(*relay));
+	if (!events || !audit || !relay ||
+	    ds_vyukhov_init_c(events, USERTEST_LANE_CAPACITY) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(relay, USERTEST_LANE_CAPACITY) != DS_SUCCESS ||
+	    ds_ck_ring_spsc_init_c(audit, USERTEST_LANE_CAPACITY) != DS_SUCCESS ||
+	    ds_lane_dir_publish(dir, "events", DS_LANE_KIND_VYUKHOV, events,
+				USERTEST_LANE_CAPACITY, DS_LANE_F_KU) != DS_SUCCESS ||
+	    ds_lane_dir_publish(dir, "audit", DS_LANE_KIND_CK_RING_SPSC, audit,
+				USERTEST_LANE_CAPACITY,
+				DS_LANE_F_KU | DS_LANE_F_SINGLE_CONSUMER) != DS_SUCCESS ||
+	    ds_lane_dir_publish(dir, "relay", DS_LANE_KIND_VYUKHOV, relay,
+				USERTEST_LANE_CAPACITY, DS_LANE_F_KU) != DS_SUCCESS)
+		return 1;
+
+	if (claim_phase(fd, dir))
+		return 1;
+
+	for (int i = 0; i < USERTEST_EVENT_CONSUMERS; i++)
+		consumers[i] = spawn_consumer(fd, "events", 0);
+	consumers[USERTEST_EVENT_CONSUMERS] = spawn_consumer(fd, "audit", 0);
+	consumers[USERTEST_EVENT_CONSUMERS + 1] = spawn_consumer(fd, "relay", 1);
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .dir = dir, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+	/* Restart the relay consumer; the producer keeps going meanwhile */
+	if (wait_status(consumers[USERTEST_EVENT_CONSUMERS + 1]) != 0)
+		bad = 1;
+	usertest_sleep_us(USERTEST_RESTART_GAP_US);
+	consumers[USERTEST_EVENT_CONSUMERS + 1] = spawn_consumer(fd, "relay", 2);
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+
+	/* Producer side is done: tell every attached consumer to drain and detach */
+	for (__u32 i = 0; i < dir->nr_lanes; i++)
+		ds_lane_dir_set_flags(dir, &dir->lanes[i], DS_LANE_F_CLOSED, 0);
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		int status = wait_status(consumers[i]);
+
+		if (status != 0) {
+			fprintf(stderr, "consumer %d exited with %d\n", i, status);
+			bad = 1;
+		}
+	}
+
+	consumed = dir->lanes[0].consumed + dir->lanes[1].consumed + dir->lanes[2].consumed;
+	fprintf(stdout, "done: produced=%d consumed=%" PRIu64 "\n",
+		USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER, consumed);
+	fprintf(stdout, "validation: events=%" PRIu64 " audit=%" PRIu64 " relay=%" PRIu64
+		" attached=%u/%u/%u restarts=%" PRIu64 "\n",
+		(uint64_t)dir->lanes[0].consumed, (uint64_t)dir->lanes[1].consumed,
+		(uint64_t)dir->lanes[2].consumed, dir->lanes[0].consumers,
+		dir->lanes[1].consumers, dir->lanes[2].consumers, (uint64_t)dir->restarts);
+
+	bad |= consumed != USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER ||
+	       dir->lanes[1].consumed != USERTEST_ITEMS_PER_PRODUCER ||
+	       dir->lanes[0].consumers || dir->lanes[1].consumers || dir->lanes[2].consumers ||
+	       dir->lanes[1].owner_pid || dir->restarts != 1;
+
+	munmap(base, USERTEST_ARENA_SIZE);
+	close(fd);
+	return bad;
+}
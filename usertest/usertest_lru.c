@@ -0,0 +1,193 @@
+#include "usertest_common.h"
+
+#include "ds_lru.h"
+
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 6
+#define USERTEST_PRODUCER_SLEEP_SEC 1
+#define USERTEST_POLL_US 1000
+#define USERTEST_LRU_CAPACITY 128u
+#define USERTEST_LRU_EVICT_KEYS 4096u
+
+#define USERTEST_TOTAL_ITEMS (USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER)
+
+struct ctx {
+	struct ds_lru_head cache;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic uint8_t claimed[USERTEST_TOTAL_ITEMS];
+	uint64_t expected;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static uint64_t item_key(int tid, int i)
+{
+	return (uint64_t)tid * 1000u + (uint64_t)(i + 1);
+}
+
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = item_key(pa->tid, i);
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			int rc = ds_lru_insert_c(&c->cache, key, value);
+			if (rc == DS_SUCCESS)
+				break;
+			if (rc != DS_ERROR_BUSY) {
+				fprintf(stderr, "lru: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, (uint64_t)key, (uint64_t)value);
+
+		if (i + 1 < USERTEST_ITEMS_PER_PRODUCER)
+			sleep(USERTEST_PRODUCER_SLEEP_SEC);
+	}
+
+	return NULL;
+}
+
+/*
+ * Consumers poll the cache for every expected key and claim each key the
+ * first time it is observed. Capacity is far above the item count, so no
+ * entry is evicted during this phase.
+ */
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	for (;;) {
+		uint64_t done = atomic_load_explicit(&c->consumed, memory_order_relaxed);
+		if (done >= c->expected)
+			return NULL;
+
+		for (int idx = 0; idx < USERTEST_TOTAL_ITEMS; idx++) {
+			int tid = idx / USERTEST_ITEMS_PER_PRODUCER;
+			int i = idx % USERTEST_ITEMS_PER_PRODUCER;
+			uint64_t key = item_key(tid, i);
+			__u64 value;
+			int rc;
+
+			if (atomic_load_explicit(&c->claimed[idx], memory_order_relaxed))
+				continue;
+
+			rc = ds_lru_lookup_c(&c->cache, key, &value);
+			if (rc == DS_ERROR_NOT_FOUND)
+				continue;
+			if (rc != DS_SUCCESS) {
+				fprintf(stderr, "lru: lookup rc=%d\n", rc);
+				return (void *)1;
+			}
+
+			if (atomic_exchange_explicit(&c->claimed[idx], 1, memory_order_relaxed))
+				continue;
+
+			uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)key, (uint64_t)value, (uint64_t)n);
+		}
+
+		usertest_sleep_us(USERTEST_POLL_US);
+	}
+}
+
+/* Overfill the cache and check that CLOCK keeps it bounded and consistent. */
+static int eviction_phase(struct ctx *c)
+{
+	uint64_t hot_key = 1;
+	uint64_t hot_hits = 0;
+	uint64_t count;
+	uint64_t evictions;
+
+	for (uint64_t k = 0; k < USERTEST_LRU_EVICT_KEYS; k++) {
+		__u64 value;
+
+		if (ds_lru_insert_c(&c->cache, 1000000u + k, k) != DS_SUCCESS) {
+			fprintf(stderr, "lru: eviction insert failed\n");
+			return 1;
+		}
+		/* Keep one key hot so its reference bit shields it */
+		if (ds_lru_lookup_c(&c->cache, hot_key, &value) == DS_SUCCESS)
+			hot_hits++;
+	}
+
+	count = arena_atomic_load(&c->cache.count, ARENA_RELAXED);
+	evictions = arena_atomic_load(&c->cache.evictions, ARENA_RELAXED);
+
+	fprintf(stdout, "validation: count=%" PRIu64 " capacity=%u evictions=%" PRIu64
+		" hot_hits=%" PRIu64 " verify=%d\n",
+		count, USERTEST_LRU_CAPACITY, evictions, hot_hits, ds_lru_verify_c(&c->cache));
+
+	if (count > USERTEST_LRU_CAPACITY || evictions == 0)
+		return 1;
+	/* Single-threaded: the hot key must never be the CLOCK victim */
+	if (hot_hits != USERTEST_LRU_EVICT_KEYS)
+		return 1;
+	if (ds_lru_verify_c(&c->cache) != DS_SUCCESS)
+		return 1;
+	if (ds_lru_delete_c(&c->cache, hot_key) != DS_SUCCESS ||
+	    ds_lru_lookup_c(&c->cache, hot_key, NULL) != DS_ERROR_NOT_FOUND)
+		return 1;
+
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx c = {0};
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	pthread_t consumers[USERTEST_NUM_CONSUMERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+
+	usertest_print_config("CLOCK LRU cache", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_lru_init_c(&c.cache, USERTEST_LRU_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "lru: init failed\n");
+		return 1;
+	}
+
+	c.expected = (uint64_t)USERTEST_TOTAL_ITEMS;
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&consumers[i], NULL, consumer_thread, &c) != 0) {
+			perror("pthread_create consumer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = &c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(consumers[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	if (atomic_load(&c.consumed) != c.expected)
+		return 1;
+
+	return eviction_phase(&c);
+}
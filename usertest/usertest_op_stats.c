@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+/* Per-op counters are opt-in; they must be on before ds_api.h is seen */
+#ifndef DS_OP_STATS
+#define DS_OP_STATS
+#endif
+#include "usertest_common.h"
+
+#include "ds_id_bitmap.h"
+#include "ds_lru.h"
+#include "ds_msqueue.h"
+#include "ds_rcu_table.h"
+#include "ds_timer_wheel.h"
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 2000
+#define USERTEST_POLL_US 50
+#define USERTEST_SEARCHES 100
+#define USERTEST_LRU_CAPACITY 64
+#define USERTEST_LRU_KEYS 8
+#define USERTEST_TIMERS 3
+#define USERTEST_TICK_NS 1000ull
+#define USERTEST_LANE_CAPACITY 16
+#define USERTEST_NR_IDS 128
+
+struct ctx {
+	struct ds_msqueue q;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	uint64_t expected;
+};
+
+struct worker {
+	struct ctx *c;
+	int tid;
+	uint64_t ops; /* every call, failed ones included */
+	uint64_t failed;
+};
+
+static void *producer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	int rc;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)w->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			rc = ds_msqueue_insert_c(&c->q, key, value);
+			w->ops++;
+			if (rc == DS_SUCCESS)
+				break;
+			w->failed++;
+			if (rc != DS_ERROR_NOMEM && rc != DS_ERROR_BUSY) {
+				fprintf(stderr, "op_stats: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			w->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	struct ds_kv out;
+	int rc;
+
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		rc = ds_msqueue_pop_c(&c->q, &out);
+		w->ops++;
+		if (rc == DS_SUCCESS) {
+			uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)out.key, (uint64_t)out.value, (uint64_t)n);
+			continue;
+		}
+		w->failed++;
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_BUSY) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "op_stats: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+static int check_op(const struct ds_stats *s, int op, const char *name,
+		    uint64_t count, uint64_t failures)
+{
+	const struct ds_op_stats *o = &s->ops[op];
+
+	if (o->count != count || o->failures != failures || (count && !o->total_time_ns)) {
+		fprintf(stderr, "op_stats: %s count=%llu failures=%llu time=%llu, want %llu/%llu\n",
+			name, (unsigned long long)o->count, (unsigned long long)o->failures,
+			(unsigned long long)o->total_time_ns, (unsigned long long)count,
+			(unsigned long long)failures);
+		return -1;
+	}
+	return 0;
+}
+
+static int check_reset(const struct ds_stats *s)
+{
+	for (int op = 0; op < DS_OP_MAX; op++)
+		if (check_op(s, op, "reset", 0, 0))
+			return -1;
+	return 0;
+}
+
+/* Lookups count as SEARCH; misses and repeated deletes as failures */
+static int lru_phase(void)
+{
+	struct ds_lru_head lru = {0};
+	struct ds_stats s;
+	__u64 value;
+	int failed = 0;
+
+	if (ds_lru_init_c(&lru, USERTEST_LRU_CAPACITY) != DS_SUCCESS)
+		return 1;
+	for (__u64 k = 1; k <= USERTEST_LRU_KEYS; k++) {
+		if (ds_lru_insert_c(&lru, k, k * 10) != DS_SUCCESS ||
+		    ds_lru_lookup_c(&lru, k, &value) != DS_SUCCESS || value != k * 10)
+			failed = 1;
+	}
+	if (ds_lru_lookup_c(&lru, 1000, &value) != DS_ERROR_NOT_FOUND ||
+	    ds_lru_delete_c(&lru, 1) != DS_SUCCESS ||
+	    ds_lru_delete_c(&lru, 1) != DS_ERROR_NOT_FOUND ||
+	    ds_lru_verify_c(&lru) != DS_SUCCESS)
+		failed = 1;
+
+	if (ds_lru_stats(&lru, &s) != DS_SUCCESS)
+		return 1;
+	ds_print_stats("LRU", &s);
+	if (check_op(&s, DS_OP_INIT, "lru init", 1, 0) ||
+	    check_op(&s, DS_OP_INSERT, "lru insert", USERTEST_LRU_KEYS, 0) ||
+	    check_op(&s, DS_OP_SEARCH, "lru lookup", USERTEST_LRU_KEYS + 1, 1) ||
+	    check_op(&s, DS_OP_DELETE, "lru delete", 2, 1) ||
+	    check_op(&s, DS_OP_VERIFY, "lru verify", 1, 0) ||
+	    s.current_elements != USERTEST_LRU_KEYS - 1 ||
+	    s.memory_used != (USERTEST_LRU_CAPACITY / DS_LRU_WAYS) * sizeof(struct ds_lru_set))
+		failed = 1;
+
+	ds_lru_reset_stats(&lru);
+	if (ds_lru_stats(&lru, &s) != DS_SUCCESS || check_reset(&s))
+		failed = 1;
+	return failed;
+}
+
+/* Publish counts as INSERT and reclaim as ITERATE; publish's own reclaim does not */
+static int rcu_table_phase(void)
+{
+	struct ds_rcu_table_head table = {0};
+	ds_rcu_table_ver_t *ver;
+	struct ds_stats s;
+	__u64 value;
+	int failed = 0;
+
+	if (ds_rcu_table_init_c(&table) != DS_SUCCESS)
+		return 1;
+	if (ds_rcu_table_lookup_c(&table, 1, &value) != DS_ERROR_NOT_FOUND)
+		failed = 1;
+
+	ver = ds_rcu_table_ver_alloc_c();
+	if (!ver || ds_rcu_table_ver_set_c(ver, 1, 10) != DS_SUCCESS ||
+	    ds_rcu_table_publish_c(&table, ver) != DS_SUCCESS)
+		return 1;
+	ver = ds_rcu_table_ver_clone_c(&table);
+	if (!ver || ds_rcu_table_ver_set_c(ver, 2, 20) != DS_SUCCESS ||
+	    ds_rcu_table_publish_c(&table, ver) != DS_SUCCESS)
+		return 1;
+	if (ds_rcu_table_publish_c(&table, NULL) != DS_ERROR_INVALID ||
+	    ds_rcu_table_lookup_c(&table, 2, &value) != DS_SUCCESS || value != 20 ||
+	    ds_rcu_table_reclaim_c(&table) != 1 ||
+	    ds_rcu_table_verify_c(&table) != DS_SUCCESS)
+		failed = 1;
+
+	if (ds_rcu_table_stats(&table, &s) != DS_SUCCESS)
+		return 1;
+	ds_print_stats("RCU table", &s);
+	if (check_op(&s, DS_OP_INIT, "rcu_table init", 1, 0) ||
+	    check_op(&s, DS_OP_SEARCH, "rcu_table lookup", 2, 1) ||
+	    check_op(&s, DS_OP_INSERT, "rcu_table publish", 3, 1) ||
+	    check_op(&s, DS_OP_ITERATE, "rcu_table reclaim", 1, 0) ||
+	    check_op(&s, DS_OP_VERIFY, "rcu_table verify", 1, 0) ||
+	    s.current_elements != 2 || s.memory_used != sizeof(struct ds_rcu_table_ver))
+		failed = 1;
+
+	ds_rcu_table_reset_stats(&table);
+	if (ds_rcu_table_stats(&table, &s) != DS_SUCCESS || check_reset(&s))
+		failed = 1;
+	return failed;
+}
+
+/* Advance counts as POP and reclaim as ITERATE; neither returns an error */
+static int timer_wheel_phase(void)
+{
+	static struct ds_timer_wheel wheel;
+	struct ds_timer_wheel_handle h[USERTEST_TIMERS];
+	struct ds_vyukhov_head lane = {0};
+	struct ds_stats s;
+	int failed = 0;
+
+	if (ds_timer_wheel_init_c(&wheel, USERTEST_TICK_NS, 0) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(&lane, USERTEST_LANE_CAPACITY) != DS_SUCCESS)
+		return 1;
+	for (int i = 0; i < USERTEST_TIMERS; i++)
+		if (ds_timer_wheel_schedule_c(&wheel, 5 * USERTEST_TICK_NS, (__u64)i, 0,
+					      &h[i]) != DS_SUCCESS)
+			return 1;
+	if (ds_timer_wheel_cancel_c(&wheel, &h[0]) != DS_SUCCESS ||
+	    ds_timer_wheel_cancel_c(&wheel, &h[0]) != DS_ERROR_NOT_FOUND ||
+	    ds_timer_wheel_advance_c(&wheel, 10 * USERTEST_TICK_NS, &lane) != USERTEST_TIMERS - 1 ||
+	    ds_timer_wheel_reclaim_c(&wheel) != USERTEST_TIMERS ||
+	    ds_timer_wheel_verify_c(&wheel) != DS_SUCCESS)
+		failed = 1;
+
+	if (ds_timer_wheel_stats(&wheel, &s) != DS_SUCCESS)
+		return 1;
+	ds_print_stats("Timer wheel", &s);
+	if (check_op(&s, DS_OP_INIT, "timer_wheel init", 1, 0) ||
+	    check_op(&s, DS_OP_INSERT, "timer_wheel schedule", USERTEST_TIMERS, 0) ||
+	    check_op(&s, DS_OP_DELETE, "timer_wheel cancel", 2, 1) ||
+	    check_op(&s, DS_OP_POP, "timer_wheel advance", 1, 0) ||
+	    check_op(&s, DS_OP_ITERATE, "timer_wheel reclaim", 1, 0) ||
+	    check_op(&s, DS_OP_VERIFY, "timer_wheel verify", 1, 0) ||
+	    s.current_elements != 0 || s.memory_used != 0)
+		failed = 1;
+
+	ds_timer_wheel_reset_stats(&wheel);
+	if (ds_timer_wheel_stats(&wheel, &s) != DS_SUCCESS || check_reset(&s))
+		failed = 1;
+	return failed;
+}
+
+/* Acquire counts as INSERT and release as DELETE */
+static int id_bitmap_phase(void)
+{
+	static struct ds_id_bitmap ids;
+	struct ds_stats s;
+	__u32 id[3];
+	int failed = 0;
+
+	if (ds_id_bitmap_init_c(&ids, USERTEST_NR_IDS) != DS_SUCCESS)
+		return 1;
+	for (int i = 0; i < 3; i++)
+		if (ds_id_bitmap_acquire_c(&ids, 0, &id[i]) != DS_SUCCESS)
+			return 1;
+	if (ds_id_bitmap_release_c(&ids, id[1]) != DS_SUCCESS ||
+	    ds_id_bitmap_release_c(&ids, id[1]) != DS_ERROR_NOT_FOUND ||
+	    ds_id_bitmap_release_c(&ids, USERTEST_NR_IDS) != DS_ERROR_INVALID ||
+	    ds_id_bitmap_verify_c(&ids) != DS_SUCCESS)
+		failed = 1;
+
+	if (ds_id_bitmap_stats(&ids, &s) != DS_SUCCESS)
+		return 1;
+	ds_print_stats("ID bitmap", &s);
+	if (check_op(&s, DS_OP_INIT, "id_bitmap init", 1, 0) ||
+	    check_op(&s, DS_OP_INSERT, "id_bitmap acquire", 3, 0) ||
+	    check_op(&s, DS_OP_DELETE, "id_bitmap release", 3, 2) ||
+	    check_op(&s, DS_OP_VERIFY, "id_bitmap verify", 1, 0) ||
+	    s.current_elements != 2 || s.memory_used != (USERTEST_NR_IDS / 64) * sizeof(__u64))
+		failed = 1;
+
+	ds_id_bitmap_reset_stats(&ids);
+	if (ds_id_bitmap_stats(&ids, &s) != DS_SUCCESS || check_reset(&s))
+		failed = 1;
+	return failed;
+}
+
+int main(void)
+{
+	struct worker workers[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS] = {0};
+	pthread_t threads[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS];
+	uint64_t ins = 0, ins_failed = 0, pops = 0, pops_failed = 0;
+	struct ctx c = {0};
+	struct ds_stats s;
+	int failed = 0;
+
+	usertest_print_config("Per-op stats", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_msqueue_init_c(&c.q) != DS_SUCCESS) {
+		fprintf(stderr, "op_stats: init failed\n");
+		return 1;
+	}
+	c.expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		bool producer = i < USERTEST_NUM_PRODUCERS;
+
+		workers[i] = (struct worker){ .c = &c, .tid = i };
+		if (pthread_create(&threads[i], NULL, producer ? producer_thread : consumer_thread,
+				   &workers[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(threads[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	/* Misses only: the queue is empty by now */
+	for (int i = 0; i < USERTEST_SEARCHES; i++)
+		(void)ds_msqueue_search_c(&c.q, (uint64_t)i);
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		if (i < USERTEST_NUM_PRODUCERS) {
+			ins += workers[i].ops;
+			ins_failed += workers[i].failed;
+		} else {
+			pops += workers[i].ops;
+			pops_failed += workers[i].failed;
+		}
+	}
+
+	/* Every call from every thread is counted once, whichever slot it hit */
+	if (ds_msqueue_stats_c(&c.q, &s) != DS_SUCCESS)
+		return 1;
+	ds_print_stats("MS Queue", &s);
+	if (check_op(&s, DS_OP_INIT, "init", 1, 0) ||
+	    check_op(&s, DS_OP_INSERT, "insert", ins, ins_failed) ||
+	    check_op(&s, DS_OP_POP, "pop", pops, pops_failed) ||
+	    check_op(&s, DS_OP_SEARCH, "search", USERTEST_SEARCHES, USERTEST_SEARCHES) ||
+	    s.current_elements != 0)
+		failed = 1;
+	fprintf(stdout, "validation: inserts=%" PRIu64 " pops=%" PRIu64 " empty_pops=%" PRIu64 "\n",
+		ins, pops, pops_failed);
+
+	ds_msqueue_reset_stats(&c.q);
+	if (ds_msqueue_stats_c(&c.q, &s) != DS_SUCCESS || check_reset(&s))
+		failed = 1;
+
+	if (lru_phase() || rcu_table_phase() || timer_wheel_phase() || id_bitmap_phase())
+		failed = 1;
+
+	return !failed && atomic_load(&c.consumed) == c.expected ? 0 : 1;
+}
@@ -0,0 +1,327 @@
+/* Same page source as skeleton_msqueue: the ownership map */
+#define ARENA_PAGE_OWNER
+
+#include "usertest_common.h"
+
+#include <sys/mman.h>
+
+/*
+ * The real userspace allocator is under test, so drop the bump-allocator
+ * redirect before the DS headers bind to it.
+ */
+#undef bpf_arena_alloc
+#undef bpf_arena_free
+#undef bpf_arena_alloc_large
+#undef bpf_arena_free_large
+
+#include "ds_page_owner.h"
+#include "ds_vyukhov.h"
+
+/*
+ * Two sides share a small arena through one ds_page_owner map kept in its
+ * page 0, the way skeleton_msqueue does:
+ *
+ *   - producer 0 plays the kernel: it claims whole pages straight from the
+ *     map (as ds_page_owner_alloc_pages() does) and stamps every word.
+ *   - producer 1 is userspace: bpf_arena_alloc() with ARENA_PAGE_OWNER.
+ *   - the consumer frees both kinds, so user pages go back to the map
+ *     through bpf_arena_free() and kernel pages through a release.
+ *
+ * The arena is much smaller than what is in flight, so both sides hit a
+ * full map and have to reuse pages the other side released. A page owned
+ * twice shows up as a broken stamp or a clobbered user item.
+ *
+ * A second, larger arena then checks runs longer than one map word: a
+ * 64K-entry ring from bpf_arena_alloc_large(), and a claim that has to
+ * give back the words it took when a later word is busy.
+ */
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 2
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS_PER_PRODUCER 3000
+#define USERTEST_POLL_US 20
+#define USERTEST_ARENA_PAGES 48
+#define USERTEST_QUEUE_CAPACITY 64
+#define USERTEST_KERN_TID 0
+#define USERTEST_ITEM_MAGIC 0x6f776e6572697465ull
+#define USERTEST_LARGE_PAGES 512
+#define USERTEST_LARGE_RING (64 * 1024)
+
+struct item {
+	uint64_t magic;
+	uint64_t key;
+	uint64_t value;
+	uint64_t kern;		/* 1: a whole page claimed by the "kernel" */
+};
+
+struct ctx {
+	struct ds_vyukhov_head q;
+	struct ds_page_owner *owner;
+	size_t pg;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic int errors;
+	uint64_t expected;
+	uint64_t full[USERTEST_NUM_PRODUCERS];	/* allocations that found no page */
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static uint64_t stamp_of(const void *page)
+{
+	return USERTEST_ITEM_MAGIC ^ (uint64_t)(uintptr_t)page;
+}
+
+static struct item *kern_alloc(struct ctx *c)
+{
+	uint64_t *w;
+	__u32 idx;
+
+	if (ds_page_owner_claim_c(c->owner, 1, DS_PAGE_OWNER_KERN, &idx) != DS_SUCCESS)
+		return NULL;
+
+	w = (uint64_t *)(uintptr_t)(c->owner->base + (__u64)idx * c->pg);
+	for (size_t i = 0; i < c->pg / sizeof(*w); i++)
+		w[i] = stamp_of(w);
+	return (struct item *)w;
+}
+
+static bool kern_page_intact(struct ctx *c, const struct item *it)
+{
+	const uint64_t *w = (const uint64_t *)it;
+
+	/* The header words were overwritten by the producer */
+	for (size_t i = sizeof(*it) / sizeof(*w); i < c->pg / sizeof(*w); i++)
+		if (w[i] != stamp_of(w))
+			return false;
+	return true;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+	bool kern = pa->tid == USERTEST_KERN_TID;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+		struct item *it;
+
+		for (;;) {
+			it = kern ? kern_alloc(c) : bpf_arena_alloc(sizeof(*it));
+			if (it)
+				break;
+			c->full[pa->tid]++;
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		if (!kern && it->magic) {
+			fprintf(stderr, "page_owner: user item %p not zeroed\n", (void *)it);
+			atomic_fetch_add(&c->errors, 1);
+			return (void *)1;
+		}
+		it->magic = USERTEST_ITEM_MAGIC;
+		it->key = key;
+		it->value = value;
+		it->kern = kern;
+
+		while (ds_vyukhov_insert_c(&c->q, (__u64)(uintptr_t)it, 0) != DS_SUCCESS)
+			usertest_sleep_us(USERTEST_POLL_US);
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	struct ds_kv out;
+
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		int rc = ds_vyukhov_pop_c(&c->q, &out);
+		if (rc == DS_SUCCESS) {
+			struct item *it = (struct item *)(uintptr_t)out.key;
+			uint64_t n;
+
+			if (it->magic != USERTEST_ITEM_MAGIC || (it->kern && !kern_page_intact(c, it))) {
+				fprintf(stderr, "page_owner: %s page %p owned twice\n",
+					it->kern ? "kernel" : "user", (void *)it);
+				atomic_fetch_add(&c->errors, 1);
+				return (void *)1;
+			}
+			n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)it->key, (uint64_t)it->value, (uint64_t)n);
+
+			/* Scribble first: a reused page must come back zeroed or restamped */
+			if (it->kern) {
+				memset(it, 0xa5, c->pg);
+				ds_page_owner_release_c(c->owner,
+							(__u32)(((uintptr_t)it - c->owner->base) / c->pg),
+							1, DS_PAGE_OWNER_KERN);
+			} else {
+				memset(it, 0xa5, sizeof(*it));
+				bpf_arena_free(it);
+			}
+			continue;
+		}
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_BUSY) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "page_owner: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+/* Single-threaded: runs after the shared phase, on an arena of its own */
+static int large_run_phase(void)
+{
+	size_t pg = (size_t)sysconf(_SC_PAGESIZE);
+	size_t bytes = USERTEST_LARGE_PAGES * pg;
+	__u32 ring_pages = (__u32)((USERTEST_LARGE_RING * sizeof(struct ds_vyukhov_node) + pg - 1) / pg);
+	struct ds_vyukhov_head ring = {0};
+	struct ds_page_owner *o;
+	struct ds_kv out;
+	void *arena, *run;
+	__u32 idx;
+
+	arena = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+	o = arena;
+	bpf_arena_userspace_set_range((char *)arena + pg, bytes - pg);
+	if (ds_page_owner_init_c(o, arena, USERTEST_LARGE_PAGES, 1) != DS_SUCCESS)
+		return -1;
+	bpf_arena_userspace_set_owner(o);
+
+	/* Word 0 holds the reserved page, so the run starts at word 1 */
+	if (ds_vyukhov_init_c(&ring, USERTEST_LARGE_RING) != DS_SUCCESS ||
+	    (uintptr_t)ring.buffer != (uintptr_t)arena + 64 * pg ||
+	    ds_page_owner_count_c(o) != ring_pages) {
+		fprintf(stderr, "page_owner: %u-page ring not claimed (owned=%u)\n", ring_pages,
+			ds_page_owner_count_c(o));
+		return -1;
+	}
+	for (__u32 i = 0; i < USERTEST_LARGE_RING; i++)
+		if (ds_vyukhov_insert_c(&ring, i + 1, i) != DS_SUCCESS)
+			return -1;
+	for (__u32 i = 0; i < USERTEST_LARGE_RING; i++)
+		if (ds_vyukhov_pop_c(&ring, &out) != DS_SUCCESS || out.key != i + 1)
+			return -1;
+	bpf_arena_free_large(ring.buffer, (__u64)USERTEST_LARGE_RING * sizeof(struct ds_vyukhov_node));
+	if (ds_page_owner_count_c(o) != 0 || ds_page_owner_release_c(o, 65, 100, 1) != DS_ERROR_INVALID)
+		return -1;
+
+	/* A busy page in word 4 stops every 4-word run that would cover it */
+	o->hint = 4;
+	if (ds_page_owner_claim_c(o, 1, DS_PAGE_OWNER_KERN, &idx) != DS_SUCCESS || idx != 256)
+		return -1;
+	o->hint = 1;
+	if (bpf_arena_alloc_large(200 * pg) || ds_page_owner_count_c(o) != 1) {
+		fprintf(stderr, "page_owner: failed claim left %u pages owned\n",
+			ds_page_owner_count_c(o));
+		return -1;
+	}
+	run = bpf_arena_alloc_large(150 * pg);
+	if ((uintptr_t)run != (uintptr_t)arena + 64 * pg || ds_page_owner_count_c(o) != 151)
+		return -1;
+	bpf_arena_free_large(run, 150 * pg);
+	ds_page_owner_release_c(o, idx, 1, DS_PAGE_OWNER_KERN);
+
+	fprintf(stdout, "large runs: ring=%u pages, owned at end=%u\n", ring_pages,
+		ds_page_owner_count_c(o));
+	return ds_page_owner_count_c(o) == 0 ? 0 : -1;
+}
+
+int main(void)
+{
+	pthread_t prod[USERTEST_NUM_PRODUCERS];
+	pthread_t cons[USERTEST_NUM_CONSUMERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	struct ctx *c;
+	void *arena;
+	size_t bytes;
+	__u32 owned;
+
+	usertest_print_config("Page owner", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return 1;
+	c->pg = (size_t)sysconf(_SC_PAGESIZE);
+	bytes = USERTEST_ARENA_PAGES * c->pg;
+	arena = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (arena == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	/* Page 0 holds the map, as the arena globals do for a skeleton */
+	c->owner = arena;
+	bpf_arena_userspace_set_range((char *)arena + c->pg, bytes - c->pg);
+	if (ds_page_owner_init_c(c->owner, arena, USERTEST_ARENA_PAGES, 1) != DS_SUCCESS) {
+		fprintf(stderr, "page_owner: map init failed\n");
+		return 1;
+	}
+	bpf_arena_userspace_set_owner(c->owner);
+
+	if (ds_vyukhov_init_c(&c->q, USERTEST_QUEUE_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "page_owner: queue init failed\n");
+		return 1;
+	}
+	c->expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&cons[i], NULL, consumer_thread, c) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&prod[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(prod[i], NULL);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(cons[i], NULL);
+
+	/* Left owned: the queue's buffer page and the user allocator's current page */
+	owned = ds_page_owner_count_c(c->owner);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), (uint64_t)atomic_load(&c->consumed));
+	fprintf(stdout, "validation: kern claimed=%llu released=%llu full=%" PRIu64
+		" user claimed=%llu released=%llu full=%" PRIu64 " owned at end=%u\n",
+		(unsigned long long)c->owner->claimed[DS_PAGE_OWNER_KERN],
+		(unsigned long long)c->owner->released[DS_PAGE_OWNER_KERN], c->full[0],
+		(unsigned long long)c->owner->claimed[DS_PAGE_OWNER_USER],
+		(unsigned long long)c->owner->released[DS_PAGE_OWNER_USER], c->full[1], owned);
+
+	if (atomic_load(&c->errors) || atomic_load(&c->consumed) != c->expected ||
+	    c->owner->claimed[DS_PAGE_OWNER_KERN] != c->owner->released[DS_PAGE_OWNER_KERN] ||
+	    owned > 2)
+		return 1;
+
+	return large_run_phase() == 0 ? 0 : 1;
+}
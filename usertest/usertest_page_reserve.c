@@ -0,0 +1,265 @@
+#include "usertest_common.h"
+
+#include "ds_page_reserve.h"
+#include "ds_vyukhov.h"
+
+/*
+ * Threads stand in for the pieces of the BPF setup: each producer is a CPU
+ * that takes pages from its own reserve, the consumer frees them (retire),
+ * and a refiller thread plays the bpf_wq worker over a small page pool
+ * standing in for bpf_arena_alloc_pages(). The refiller only runs once
+ * kicked and sleeps between runs, so producers do run their reserves dry.
+ * There are fewer reserves than producers: a CPU id past nr_cpus has to
+ * land on a reserve the worker fills, or that producer never gets a page.
+ */
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 2
+#define USERTEST_RESERVE_CPUS 1
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS_PER_PRODUCER 2000
+#define USERTEST_POLL_US 20
+#define USERTEST_REFILL_US 200
+#define USERTEST_RESERVE_DEPTH 4
+#define USERTEST_RESERVE_LOW 2
+#define USERTEST_POOL_PAGES 64
+#define USERTEST_PAGE 4096
+#define USERTEST_ITEM_MAGIC 0x7265736572766531ull
+
+struct item {
+	uint64_t magic;
+	uint64_t key;
+	uint64_t value;
+	_Atomic uint64_t owned;
+};
+
+struct ctx {
+	struct ds_page_reserve r;
+	struct ds_vyukhov_head q;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic int stop_refill;
+	_Atomic int errors;
+	uint64_t expected;
+	uint64_t waits;		/* takes retried after an empty reserve */
+	/* Pool the refiller allocates from and frees to (refiller only) */
+	unsigned char (*pages)[USERTEST_PAGE];
+	int free_idx[USERTEST_POOL_PAGES];
+	int nr_free;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static bool page_zeroed(const void *p)
+{
+	const uint64_t *w = p;
+
+	for (size_t i = 0; i < USERTEST_PAGE / sizeof(*w); i++)
+		if (w[i])
+			return false;
+	return true;
+}
+
+/* One worker run: free what was retired, then top every reserve up */
+static void refill(struct ctx *c)
+{
+	void *page;
+
+	ds_page_reserve_refill_begin(&c->r);
+	page = ds_page_reserve_drain_c(&c->r);
+	while (page) {
+		void *next = *(void **)page;
+
+		c->free_idx[c->nr_free++] = (int)(((unsigned char *)page - c->pages[0]) / USERTEST_PAGE);
+		c->r.released++;
+		page = next;
+	}
+
+	/* As the worker does: only the nr_cpus reserves in use */
+	for (__u32 cpu = 0; cpu < c->r.nr_cpus; cpu++) {
+		while (ds_page_reserve_level(&c->r, cpu) < c->r.depth) {
+			if (!c->nr_free) {
+				c->r.refill_failed++;
+				return;
+			}
+			page = c->pages[c->free_idx[--c->nr_free]];
+			memset(page, 0, USERTEST_PAGE);
+			if (ds_page_reserve_put_c(&c->r, cpu, page) != DS_SUCCESS) {
+				c->free_idx[c->nr_free++] = (int)(((unsigned char *)page - c->pages[0]) /
+								  USERTEST_PAGE);
+				break;
+			}
+		}
+	}
+}
+
+static void *refill_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (!atomic_load_explicit(&c->stop_refill, memory_order_acquire)) {
+		if (arena_atomic_load(&c->r.refill_pending, ARENA_ACQUIRE))
+			refill(c);
+		usertest_sleep_us(USERTEST_REFILL_US);
+	}
+	return NULL;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)pa->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+		struct item *it;
+
+		for (;;) {
+			it = ds_page_reserve_take_c(&c->r, (__u32)pa->tid);
+			if (!it || ds_page_reserve_low(&c->r, (__u32)pa->tid))
+				ds_page_reserve_claim_refill(&c->r);
+			if (it)
+				break;
+			__atomic_fetch_add(&c->waits, 1, __ATOMIC_RELAXED);
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		/* A page handed out twice, or not zeroed, would show here */
+		if (!page_zeroed(it) || atomic_exchange(&it->owned, 1) != 0) {
+			fprintf(stderr, "page_reserve: page %p reused while live\n", (void *)it);
+			atomic_fetch_add(&c->errors, 1);
+			return (void *)1;
+		}
+		it->magic = USERTEST_ITEM_MAGIC;
+		it->key = key;
+		it->value = value;
+
+		while (ds_vyukhov_insert_c(&c->q, (__u64)(uintptr_t)it, 0) != DS_SUCCESS)
+			usertest_sleep_us(USERTEST_POLL_US);
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	struct ds_kv out;
+
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		int rc = ds_vyukhov_pop_c(&c->q, &out);
+		if (rc == DS_SUCCESS) {
+			struct item *it = (struct item *)(uintptr_t)out.key;
+			uint64_t n;
+
+			if (it->magic != USERTEST_ITEM_MAGIC ||
+			    atomic_exchange(&it->owned, 0) != 1) {
+				fprintf(stderr, "page_reserve: page %p corrupted\n", (void *)it);
+				atomic_fetch_add(&c->errors, 1);
+				return (void *)1;
+			}
+			n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)it->key, (uint64_t)it->value, (uint64_t)n);
+
+			/* Dirty the page; the refiller must zero it before reuse */
+			memset(it, 0xa5, USERTEST_PAGE);
+			ds_page_reserve_retire_c(&c->r, it);
+			ds_page_reserve_claim_refill(&c->r);
+			continue;
+		}
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_BUSY) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "page_reserve: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+int main(void)
+{
+	pthread_t prod[USERTEST_NUM_PRODUCERS];
+	pthread_t cons[USERTEST_NUM_CONSUMERS];
+	pthread_t refiller;
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	struct ctx *c;
+	__u64 exhausted = 0, pages_held = 0;
+
+	usertest_print_config("Page reserve", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	c = calloc(1, sizeof(*c));
+	if (!c || posix_memalign((void **)&c->pages, USERTEST_PAGE,
+				 (size_t)USERTEST_POOL_PAGES * USERTEST_PAGE) != 0) {
+		fprintf(stderr, "page_reserve: out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < USERTEST_POOL_PAGES; i++)
+		c->free_idx[c->nr_free++] = USERTEST_POOL_PAGES - 1 - i;
+
+	if (ds_page_reserve_init_c(&c->r, USERTEST_RESERVE_CPUS, USERTEST_RESERVE_DEPTH,
+				   USERTEST_RESERVE_LOW) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(&c->q, USERTEST_POOL_PAGES) != DS_SUCCESS) {
+		fprintf(stderr, "page_reserve: init failed\n");
+		return 1;
+	}
+	c->expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	/* ds_page_reserve_start(): fill every reserve before anyone takes */
+	refill(c);
+
+	if (pthread_create(&refiller, NULL, refill_thread, c) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&cons[i], NULL, consumer_thread, c) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&prod[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(prod[i], NULL);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(cons[i], NULL);
+	atomic_store_explicit(&c->stop_refill, 1, memory_order_release);
+	pthread_join(refiller, NULL);
+
+	/* Final run: every page is back in the pool or in a reserve */
+	refill(c);
+	for (__u32 cpu = 0; cpu < USERTEST_RESERVE_CPUS; cpu++) {
+		exhausted += c->r.cpu[cpu].exhausted;
+		pages_held += ds_page_reserve_level(&c->r, cpu);
+	}
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), (uint64_t)atomic_load(&c->consumed));
+	fprintf(stdout, "validation: exhausted=%" PRIu64 " waits=%" PRIu64 " kicks=%" PRIu64
+		" runs=%" PRIu64 " released=%" PRIu64 " pages accounted=%" PRIu64 "/%d\n",
+		(uint64_t)exhausted, c->waits, (uint64_t)c->r.kicks, (uint64_t)c->r.refill_runs,
+		(uint64_t)c->r.released, (uint64_t)(pages_held + (__u64)c->nr_free),
+		USERTEST_POOL_PAGES);
+
+	return atomic_load(&c->errors) == 0 && atomic_load(&c->consumed) == c->expected &&
+	       pages_held + (__u64)c->nr_free == USERTEST_POOL_PAGES ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+/* Phase markers are opt-in; ds_phase.h must come before ds_msqueue.h */
+#ifndef DS_PHASES
+#define DS_PHASES
+#endif
+#include "usertest_common.h"
+
+#include "ds_phase.h"
+#include "ds_msqueue.h"
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 2000
+#define USERTEST_POLL_US 50
+
+struct ctx {
+	struct ds_msqueue q;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	uint64_t expected;
+};
+
+struct worker {
+	struct ctx *c;
+	int tid;
+	uint64_t ops; /* every call, failed ones included */
+	uint64_t failed;
+	uint64_t empty; /* pops that found the queue empty */
+};
+
+static void *producer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	int rc;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)w->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			rc = ds_msqueue_insert_c(&c->q, key, value);
+			w->ops++;
+			if (rc == DS_SUCCESS)
+				break;
+			w->failed++;
+			if (rc != DS_ERROR_NOMEM && rc != DS_ERROR_INVALID) {
+				fprintf(stderr, "phase: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			w->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	struct ds_kv out;
+	int rc;
+
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		rc = ds_msqueue_pop_c(&c->q, &out);
+		w->ops++;
+		if (rc == DS_SUCCESS) {
+			uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)out.key, (uint64_t)out.value, (uint64_t)n);
+			continue;
+		}
+		w->failed++;
+		if (rc == DS_ERROR_NOT_FOUND)
+			w->empty++;
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_INVALID) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "phase: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+static int check_hits(const struct ds_phase_slot *s, int op, int phase, const char *name,
+		      uint64_t want)
+{
+	const struct ds_phase_cell *cell = &s->cell[op][phase];
+
+	if (cell->hits != want || (want && !cell->ns)) {
+		fprintf(stderr, "phase: %s hits=%llu ns=%llu, want %llu\n", name,
+			(unsigned long long)cell->hits, (unsigned long long)cell->ns,
+			(unsigned long long)want);
+		return -1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	struct worker workers[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS] = {0};
+	pthread_t threads[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS];
+	uint64_t ins = 0, ins_failed = 0, pops = 0, pops_ok = 0, pops_empty = 0;
+	struct ds_phase_slot sum;
+	struct ctx c = {0};
+	int failed = 0;
+
+	usertest_print_config("Phase markers", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_msqueue_init_c(&c.q) != DS_SUCCESS) {
+		fprintf(stderr, "phase: init failed\n");
+		return 1;
+	}
+	c.expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		bool producer = i < USERTEST_NUM_PRODUCERS;
+
+		workers[i] = (struct worker){ .c = &c, .tid = i };
+		if (pthread_create(&threads[i], NULL, producer ? producer_thread : consumer_thread,
+				   &workers[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(threads[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		if (i < USERTEST_NUM_PRODUCERS) {
+			ins += workers[i].ops;
+			ins_failed += workers[i].failed;
+		} else {
+			pops += workers[i].ops;
+			pops_ok += workers[i].ops - workers[i].failed;
+			pops_empty += workers[i].empty;
+		}
+	}
+
+	/*
+	 * Every call opens the timer once. An insert that got a node closes
+	 * alloc once, or twice if it also gave the node back. A completed op
+	 * closes cas once, and pop also closes cas when it finds the queue
+	 * empty. Retry hits depend on contention and are only printed.
+	 */
+	ds_phase_print("MS Queue", DS_PHASE_STATE);
+	ds_phase_read(DS_PHASE_STATE, &sum);
+	if (sum.ops[DS_OP_INSERT] != ins || sum.ops[DS_OP_POP] != pops) {
+		fprintf(stderr, "phase: ops insert=%llu pop=%llu, want %llu/%llu\n",
+			(unsigned long long)sum.ops[DS_OP_INSERT],
+			(unsigned long long)sum.ops[DS_OP_POP],
+			(unsigned long long)ins, (unsigned long long)pops);
+		failed = 1;
+	}
+	if (sum.cell[DS_OP_INSERT][DS_PHASE_ALLOC].hits < ins ||
+	    check_hits(&sum, DS_OP_INSERT, DS_PHASE_CAS, "insert cas", c.expected) ||
+	    check_hits(&sum, DS_OP_INSERT, DS_PHASE_FIXUP, "insert fixup", c.expected) ||
+	    check_hits(&sum, DS_OP_POP, DS_PHASE_CAS, "pop cas", pops_ok + pops_empty) ||
+	    check_hits(&sum, DS_OP_POP, DS_PHASE_ALLOC, "pop alloc", pops_ok) ||
+	    check_hits(&sum, DS_OP_POP, DS_PHASE_FIXUP, "pop fixup", pops_ok))
+		failed = 1;
+	fprintf(stdout, "validation: inserts=%" PRIu64 " insert_failures=%" PRIu64
+		" pops=%" PRIu64 " empty_pops=%" PRIu64 "\n", ins, ins_failed, pops, pops_empty);
+
+	return !failed && atomic_load(&c.consumed) == c.expected ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+#include "usertest_common.h"
+
+#include "ds_pipeline.h"
+
+#define USERTEST_NUM_PRODUCERS 1
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS_PER_PRODUCER 5000
+#define USERTEST_RING_CAPACITY 64u
+#define USERTEST_LINK_CAPACITY 16u
+#define USERTEST_BATCH 8u
+#define USERTEST_SLOW_EVERY 500
+#define USERTEST_SLOW_US 2000
+
+struct stage_ctx {
+	_Atomic uint64_t seen;
+	uint64_t next_key;
+	uint64_t order_failures;
+};
+
+struct ctx {
+	struct ds_ck_ring_spsc_head in;
+	struct ds_ck_ring_spsc_head out;
+	struct ds_pipeline pipe;
+	struct stage_ctx stage[3];
+	_Atomic uint64_t produced;
+	_Atomic uint64_t input_full;
+	uint64_t consumed;
+	uint64_t order_failures;
+};
+
+static struct ctx g_ctx;
+
+/* Every stage sees the stream in producer order */
+static int check_order(struct stage_ctx *sc, struct ds_kv *kv)
+{
+	if (kv->key != sc->next_key)
+		sc->order_failures++;
+	sc->next_key = kv->key + 1;
+	atomic_fetch_add_explicit(&sc->seen, 1, memory_order_relaxed);
+	return DS_PIPELINE_FORWARD;
+}
+
+static int stage_validate(void *arg, struct ds_kv *kv)
+{
+	return check_order(arg, kv);
+}
+
+static int stage_enrich(void *arg, struct ds_kv *kv)
+{
+	return check_order(arg, kv);
+}
+
+/* Last stage is periodically slow so back-pressure reaches the producer */
+static int stage_forward(void *arg, struct ds_kv *kv)
+{
+	if (kv->key % USERTEST_SLOW_EVERY == 0)
+		usertest_sleep_us(USERTEST_SLOW_US);
+	return check_order(arg, kv);
+}
+
+static void *producer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)i;
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			int rc = ds_ck_ring_spsc_insert_c(&c->in, key, value);
+			if (rc == DS_SUCCESS)
+				break;
+			if (rc != DS_ERROR_FULL) {
+				fprintf(stderr, "pipeline: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			atomic_fetch_add_explicit(&c->input_full, 1, memory_order_relaxed);
+			usertest_sleep_us(50);
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer: key=%" PRIu64 " value=%" PRIu64 "\n", key, value);
+	}
+
+	ds_pipeline_close_input(&c->pipe);
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	struct ds_kv out;
+
+	while (c->consumed < USERTEST_ITEMS_PER_PRODUCER) {
+		if (ds_ck_ring_spsc_delete_c(&c->out, &out) != DS_SUCCESS) {
+			usertest_sleep_us(100);
+			continue;
+		}
+		if (out.key != c->consumed)
+			c->order_failures++;
+		c->consumed++;
+		fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+			(uint64_t)out.key, (uint64_t)out.value, c->consumed);
+	}
+
+	return NULL;
+}
+
+static int drop_odd(void *arg, struct ds_kv *kv)
+{
+	(void)arg;
+	return (kv->key & 1) ? DS_PIPELINE_DROP : DS_PIPELINE_FORWARD;
+}
+
+static int add_one(void *arg, struct ds_kv *kv)
+{
+	(void)arg;
+	kv->value++;
+	return DS_PIPELINE_FORWARD;
+}
+
+/* Filter/rewrite semantics and a sink stage, fed synchronously */
+static int filter_phase(void)
+{
+	static struct ds_ck_ring_spsc_head in;
+	static struct ds_pipeline p;
+	const struct ds_pipeline_stage_stats *f, *e;
+
+	if (ds_ck_ring_spsc_init_c(&in, 256) != DS_SUCCESS ||
+	    ds_pipeline_init(&p, &in, NULL, 8, 4) != DS_SUCCESS ||
+	    ds_pipeline_add_stage(&p, "filter", drop_odd, NULL, -1) != DS_SUCCESS ||
+	    ds_pipeline_add_stage(&p, "rewrite", add_one, NULL, -1) != DS_SUCCESS ||
+	    ds_pipeline_add_stage(&p, "sink", NULL, NULL, -1) != DS_SUCCESS)
+		return 1;
+
+	for (__u64 i = 0; i < 200; i++)
+		if (ds_ck_ring_spsc_insert_c(&in, i, i) != DS_SUCCESS)
+			return 1;
+
+	if (ds_pipeline_start(&p) != DS_SUCCESS)
+		return 1;
+	ds_pipeline_close_input(&p);
+	ds_pipeline_wait(&p);
+
+	f = &p.stages[0].stats;
+	e = &p.stages[1].stats;
+	fprintf(stdout, "validation: filter in=%" PRIu64 " dropped=%" PRIu64
+		" sink_out=%" PRIu64 "\n", (uint64_t)f->items_in, (uint64_t)f->dropped,
+		(uint64_t)p.stages[2].stats.items_out);
+
+	if (f->items_in != 200 || f->dropped != 100 || e->items_in != 100 ||
+	    e->dropped != 0 || p.stages[2].stats.items_out != 100)
+		return 1;
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx *c = &g_ctx;
+	pthread_t producer, consumer;
+	const struct ds_pipeline_stage_stats *st;
+	uint64_t stalls = 0;
+
+	usertest_print_config("Pipeline", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_ck_ring_spsc_init_c(&c->in, USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    ds_ck_ring_spsc_init_c(&c->out, USERTEST_RING_CAPACITY) != DS_SUCCESS ||
+	    ds_pipeline_init(&c->pipe, &c->in, &c->out, USERTEST_LINK_CAPACITY,
+			     USERTEST_BATCH) != DS_SUCCESS)
+		return 1;
+
+	if (ds_pipeline_add_stage(&c->pipe, "validate", stage_validate, &c->stage[0], 0) ||
+	    ds_pipeline_add_stage(&c->pipe, "enrich", stage_enrich, &c->stage[1], 1) ||
+	    ds_pipeline_add_stage(&c->pipe, "forward", stage_forward, &c->stage[2], 2))
+		return 1;
+
+	if (ds_pipeline_start(&c->pipe) != DS_SUCCESS) {
+		fprintf(stderr, "pipeline: start failed\n");
+		return 1;
+	}
+
+	if (pthread_create(&consumer, NULL, consumer_thread, c) != 0 ||
+	    pthread_create(&producer, NULL, producer_thread, c) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	pthread_join(producer, NULL);
+	ds_pipeline_wait(&c->pipe);
+	pthread_join(consumer, NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), c->consumed);
+	ds_pipeline_print(&c->pipe);
+
+	for (int i = 0; i < 3; i++) {
+		st = &c->pipe.stages[i].stats;
+		if (st->items_in != USERTEST_ITEMS_PER_PRODUCER ||
+		    st->items_out != USERTEST_ITEMS_PER_PRODUCER ||
+		    c->stage[i].order_failures)
+			return 1;
+		if (i < 2)
+			stalls += st->stalls;
+	}
+
+	fprintf(stdout, "validation: upstream_stalls=%" PRIu64 " input_full=%" PRIu64
+		" order_failures=%" PRIu64 "\n", stalls,
+		(uint64_t)atomic_load(&c->input_full), c->order_failures);
+
+	/* The slow last stage must have pushed back through every link */
+	if (c->order_failures || !stalls || !atomic_load(&c->input_full))
+		return 1;
+
+	return filter_phase();
+}
@@ -0,0 +1,214 @@
+#include "usertest_common.h"
+
+#include "ds_rcu_table.h"
+
+#define USERTEST_NUM_PRODUCERS 1
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_VERSIONS 12
+#define USERTEST_TABLE_KEYS 16u
+#define USERTEST_POLL_US 200
+#define USERTEST_STRESS_VERSIONS 400
+
+struct ctx {
+	struct ds_rcu_table_head table;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic uint8_t claimed[USERTEST_VERSIONS + 1];
+	_Atomic uint64_t torn;
+	_Atomic uint64_t retries;
+	_Atomic bool stop;
+};
+
+/* Every key of version v maps to v * 1000 + key */
+static int build_and_publish(struct ctx *c, uint64_t v)
+{
+	ds_rcu_table_ver_t *ver = ds_rcu_table_ver_clone_c(&c->table);
+
+	if (!ver)
+		return DS_ERROR_NOMEM;
+
+	for (__u64 key = 1; key <= USERTEST_TABLE_KEYS; key++) {
+		int rc = ds_rcu_table_ver_set_c(ver, key, v * 1000u + key);
+		if (rc != DS_SUCCESS)
+			return rc;
+	}
+
+	return ds_rcu_table_publish_c(&c->table, ver);
+}
+
+static void *producer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	for (uint64_t v = 1; v <= USERTEST_VERSIONS; v++) {
+		if (build_and_publish(c, v) != DS_SUCCESS) {
+			fprintf(stderr, "rcu_table: publish v=%" PRIu64 " failed\n", v);
+			return (void *)1;
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[0]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			v, v * 1000u + 1u);
+
+		/* Wait until some reader has observed this version */
+		while (!atomic_load_explicit(&c->claimed[v], memory_order_relaxed))
+			usertest_sleep_us(USERTEST_POLL_US);
+
+		/* Reclaim with readers still running to exercise the poison path */
+		ds_rcu_table_reclaim_c(&c->table);
+	}
+
+	return NULL;
+}
+
+/*
+ * Read every key from one snapshot and check that all of them belong to
+ * the same version. Returns the version, 0 if nothing is published, or
+ * UINT64_MAX on a torn snapshot.
+ */
+static uint64_t read_snapshot(struct ctx *c)
+{
+	for (;;) {
+		struct ds_rcu_table_snap snap;
+		uint64_t version = 0;
+		bool torn = false;
+		int rc;
+
+		rc = ds_rcu_table_read_begin_c(&c->table, &snap);
+		if (rc == DS_ERROR_NOT_FOUND)
+			return 0;
+		if (rc == DS_ERROR_BUSY) {
+			atomic_fetch_add_explicit(&c->retries, 1, memory_order_relaxed);
+			continue;
+		}
+
+		for (__u64 key = 1; key <= USERTEST_TABLE_KEYS; key++) {
+			__u64 value;
+
+			if (ds_rcu_table_get_c(&snap, key, &value) != DS_SUCCESS) {
+				torn = true;
+				break;
+			}
+			if (key == 1)
+				version = value / 1000u;
+			if (value != version * 1000u + key)
+				torn = true;
+		}
+
+		if (ds_rcu_table_read_retry_c(&snap)) {
+			atomic_fetch_add_explicit(&c->retries, 1, memory_order_relaxed);
+			continue;
+		}
+
+		if (torn || version != snap.gen)
+			return UINT64_MAX;
+		return version;
+	}
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (!atomic_load_explicit(&c->stop, memory_order_relaxed)) {
+		uint64_t v = read_snapshot(c);
+
+		if (v == UINT64_MAX) {
+			atomic_fetch_add_explicit(&c->torn, 1, memory_order_relaxed);
+			continue;
+		}
+		if (v == 0 || v > USERTEST_VERSIONS)
+			continue;
+
+		if (atomic_exchange_explicit(&c->claimed[v], 1, memory_order_relaxed))
+			continue;
+
+		uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+		fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+			v, v * 1000u + 1u, n);
+	}
+
+	return NULL;
+}
+
+/* Publish as fast as possible while readers validate every snapshot. */
+static int stress_phase(struct ctx *c, pthread_t *readers)
+{
+	uint64_t torn;
+	int verify;
+
+	atomic_store(&c->stop, false);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&readers[i], NULL, consumer_thread, c) != 0) {
+			perror("pthread_create reader");
+			return 1;
+		}
+	}
+
+	for (uint64_t v = USERTEST_VERSIONS + 1; v <= USERTEST_VERSIONS + USERTEST_STRESS_VERSIONS; v++) {
+		if (build_and_publish(c, v) != DS_SUCCESS) {
+			fprintf(stderr, "rcu_table: stress publish failed\n");
+			return 1;
+		}
+	}
+	ds_rcu_table_reclaim_c(&c->table);
+
+	atomic_store(&c->stop, true);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(readers[i], NULL);
+
+	torn = atomic_load(&c->torn);
+	verify = ds_rcu_table_verify_c(&c->table);
+	fprintf(stdout, "validation: publishes=%" PRIu64 " reclaimed=%" PRIu64
+		" gen=%" PRIu64 " torn=%" PRIu64 " retries=%" PRIu64 " verify=%d\n",
+		(uint64_t)c->table.publishes, (uint64_t)c->table.reclaimed,
+		(uint64_t)c->table.gen, torn, (uint64_t)atomic_load(&c->retries), verify);
+
+	if (torn != 0 || verify != DS_SUCCESS)
+		return 1;
+	if (c->table.publishes != USERTEST_VERSIONS + USERTEST_STRESS_VERSIONS ||
+	    c->table.reclaimed != c->table.publishes - 1)
+		return 1;
+
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx c = {0};
+	pthread_t producer;
+	pthread_t consumers[USERTEST_NUM_CONSUMERS];
+
+	usertest_print_config("RCU table", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_VERSIONS);
+
+	if (ds_rcu_table_init_c(&c.table) != DS_SUCCESS) {
+		fprintf(stderr, "rcu_table: init failed\n");
+		return 1;
+	}
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&consumers[i], NULL, consumer_thread, &c) != 0) {
+			perror("pthread_create consumer");
+			return 1;
+		}
+	}
+
+	if (pthread_create(&producer, NULL, producer_thread, &c) != 0) {
+		perror("pthread_create producer");
+		return 1;
+	}
+
+	pthread_join(producer, NULL);
+	atomic_store(&c.stop, true);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(consumers[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	if (atomic_load(&c.consumed) != USERTEST_VERSIONS)
+		return 1;
+
+	return stress_phase(&c, consumers);
+}
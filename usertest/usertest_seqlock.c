@@ -0,0 +1,170 @@
+#include "usertest_common.h"
+
+#include "ds_seqlock.h"
+
+#define USERTEST_NUM_PRODUCERS 4
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_UPDATES_PER_PRODUCER 200000u
+#define USERTEST_CONTENDED_WRITERS 2
+
+struct ctx {
+	struct ds_lane_stats_pcpu lane;
+	struct ds_lane_stats_pcpu contended;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t snapshots;
+	_Atomic uint64_t torn;
+	_Atomic uint64_t backwards;
+	_Atomic bool stop;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+	uint64_t applied;
+};
+
+/* Every third operation fails so successes/failures both move */
+static int op_result(uint64_t i)
+{
+	return (i % 3 == 2) ? DS_ERROR_FULL : DS_SUCCESS;
+}
+
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+
+	for (uint64_t i = 0; i < USERTEST_UPDATES_PER_PRODUCER; i++)
+		ds_lane_stats_update_c(&c->lane, (__u32)pa->tid, op_result(i), usertest_now_ns());
+
+	atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+	fprintf(stdout, "producer[%d]: key=%d value=%u\n",
+		pa->tid, pa->tid, USERTEST_UPDATES_PER_PRODUCER);
+	return NULL;
+}
+
+/* Readers snapshot continuously; every snapshot must satisfy the invariant */
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	uint64_t last_ops = 0;
+
+	while (!atomic_load_explicit(&c->stop, memory_order_relaxed)) {
+		struct ds_lane_stats s;
+
+		if (ds_lane_stats_snapshot_c(&c->lane, &s) != DS_SUCCESS)
+			continue;
+
+		atomic_fetch_add_explicit(&c->snapshots, 1, memory_order_relaxed);
+		if (s.ops != s.successes + s.failures)
+			atomic_fetch_add_explicit(&c->torn, 1, memory_order_relaxed);
+		if (s.ops < last_ops)
+			atomic_fetch_add_explicit(&c->backwards, 1, memory_order_relaxed);
+		last_ops = s.ops;
+	}
+
+	return NULL;
+}
+
+/* Several writers on one record: every update is either applied or dropped */
+static void *contended_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+
+	for (uint64_t i = 0; i < USERTEST_UPDATES_PER_PRODUCER; i++)
+		ds_lane_stats_update_c(&pa->c->contended, 0, op_result(i), 0);
+
+	return NULL;
+}
+
+static int contended_phase(struct ctx *c)
+{
+	pthread_t writers[USERTEST_CONTENDED_WRITERS];
+	struct prod_arg args[USERTEST_CONTENDED_WRITERS];
+	struct ds_lane_stats s;
+	uint64_t dropped;
+
+	for (int i = 0; i < USERTEST_CONTENDED_WRITERS; i++) {
+		args[i] = (struct prod_arg){ .c = c, .tid = i };
+		if (pthread_create(&writers[i], NULL, contended_thread, &args[i]) != 0) {
+			perror("pthread_create contended");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_CONTENDED_WRITERS; i++)
+		pthread_join(writers[i], NULL);
+
+	if (ds_lane_stats_snapshot_c(&c->contended, &s) != DS_SUCCESS)
+		return 1;
+	dropped = arena_atomic_load(&c->contended.dropped, ARENA_RELAXED);
+
+	fprintf(stdout, "validation: contended ops=%" PRIu64 " dropped=%" PRIu64
+		" expected=%u\n", (uint64_t)s.ops, dropped,
+		USERTEST_CONTENDED_WRITERS * USERTEST_UPDATES_PER_PRODUCER);
+
+	if (s.ops + dropped != (uint64_t)USERTEST_CONTENDED_WRITERS * USERTEST_UPDATES_PER_PRODUCER)
+		return 1;
+	if (s.ops != s.successes + s.failures)
+		return 1;
+
+	return 0;
+}
+
+int main(void)
+{
+	struct ctx c = {0};
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	pthread_t consumers[USERTEST_NUM_CONSUMERS];
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	uint64_t consumed = 0;
+
+	usertest_print_config("Seqlock lane stats", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      (int)USERTEST_UPDATES_PER_PRODUCER);
+
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++) {
+		if (pthread_create(&consumers[i], NULL, consumer_thread, &c) != 0) {
+			perror("pthread_create consumer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = &c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	atomic_store(&c.stop, true);
+	for (int i = 0; i < USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(consumers[i], NULL);
+
+	/* Each producer owns one record; report what the reader sees there */
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		struct ds_lane_stats s;
+
+		if (ds_lane_stats_read_slot_c(&c.lane.slots[i], &s) != DS_SUCCESS)
+			return 1;
+		consumed++;
+		fprintf(stdout, "consumer: key=%d value=%" PRIu64 " (n=%" PRIu64 ")\n",
+			i, (uint64_t)s.ops, consumed);
+	}
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), consumed);
+	fprintf(stdout, "validation: snapshots=%" PRIu64 " torn=%" PRIu64
+		" backwards=%" PRIu64 " dropped=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.snapshots), (uint64_t)atomic_load(&c.torn),
+		(uint64_t)atomic_load(&c.backwards),
+		(uint64_t)arena_atomic_load(&c.lane.dropped, ARENA_RELAXED));
+
+	if (atomic_load(&c.torn) != 0 || atomic_load(&c.backwards) != 0)
+		return 1;
+	if (arena_atomic_load(&c.lane.dropped, ARENA_RELAXED) != 0)
+		return 1;
+
+	return contended_phase(&c);
+}
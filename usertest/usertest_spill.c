@@ -0,0 +1,151 @@
+#include "usertest_common.h"
+
+#include "ds_spill.h"
+#include "ds_vyukhov.h"
+
+#define USERTEST_NUM_PRODUCERS 1
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS 20000
+#define USERTEST_LANE_CAPACITY 256u
+#define USERTEST_SEGMENT_BYTES (64u * 1024u)
+#define USERTEST_STALL_AT 2000u
+#define USERTEST_STALL_US 150000u
+
+struct ctx {
+	struct ds_vyukhov_head lane;
+	struct ds_spill spill;
+	_Atomic uint64_t produced;
+	_Atomic int producer_done;
+	_Atomic int consumer_done;
+	uint64_t lane_full;
+	uint64_t consumed;
+	uint64_t out_of_order;
+};
+
+static struct ctx g_ctx;
+
+static int lane_pop(void *lane, struct ds_kv *out)
+{
+	return ds_vyukhov_pop_c(lane, out);
+}
+
+static __u32 lane_depth(void *lane)
+{
+	struct ds_vyukhov_head *head = lane;
+
+	return (__u32)arena_atomic_load(&head->count, ARENA_RELAXED);
+}
+
+/* Paced producer standing in for the BPF side of a KU lane */
+static void *producer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	for (uint64_t i = 0; i < USERTEST_ITEMS; i++) {
+		uint64_t value = i * 3 + 1;
+
+		while (ds_vyukhov_insert_c(&c->lane, i, value) != DS_SUCCESS) {
+			c->lane_full++;
+			usertest_sleep_us(20);
+		}
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[0]: key=%" PRIu64 " value=%" PRIu64 "\n", i, value);
+
+		if (i % 32 == 31)
+			usertest_sleep_us(200);
+	}
+
+	atomic_store(&c->producer_done, 1);
+	return NULL;
+}
+
+static void *spill_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (!atomic_load(&c->consumer_done)) {
+		if (!ds_spill_poll(&c->spill))
+			usertest_sleep_us(50);
+	}
+	return NULL;
+}
+
+/* Stalls once for USERTEST_STALL_US, then drains files first, lane second */
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+	uint64_t next = 0;
+	struct ds_kv out;
+
+	for (;;) {
+		if (c->consumed == USERTEST_STALL_AT)
+			usertest_sleep_us(USERTEST_STALL_US);
+
+		if (ds_spill_pop(&c->spill, &out) == DS_SUCCESS) {
+			if (out.key != next)
+				c->out_of_order++;
+			next = out.key + 1;
+			c->consumed++;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64
+				" (n=%" PRIu64 ")\n", (uint64_t)out.key, (uint64_t)out.value,
+				c->consumed);
+			continue;
+		}
+		if (atomic_load(&c->producer_done) && c->consumed == atomic_load(&c->produced))
+			break;
+		usertest_sleep_us(20);
+	}
+
+	atomic_store(&c->consumer_done, 1);
+	return NULL;
+}
+
+int main(void)
+{
+	struct ctx *c = &g_ctx;
+	char dir[] = "/tmp/usertest_spill.XXXXXX";
+	pthread_t producer, consumer, spiller;
+	const struct ds_spill_stats *st = &c->spill.stats;
+	int bad;
+
+	usertest_print_config("Spill-to-disk lane", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS);
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	if (ds_vyukhov_init_c(&c->lane, USERTEST_LANE_CAPACITY) != DS_SUCCESS ||
+	    ds_spill_init(&c->spill, dir, &c->lane, lane_pop, lane_depth,
+			  USERTEST_LANE_CAPACITY, USERTEST_SEGMENT_BYTES, 0) != DS_SUCCESS) {
+		rmdir(dir);
+		return 1;
+	}
+
+	if (pthread_create(&consumer, NULL, consumer_thread, c) != 0 ||
+	    pthread_create(&spiller, NULL, spill_thread, c) != 0 ||
+	    pthread_create(&producer, NULL, producer_thread, c) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	pthread_join(spiller, NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c->produced), c->consumed);
+	fprintf(stdout, "validation: spilled=%" PRIu64 " replayed=%" PRIu64 " direct=%" PRIu64
+		" segments=%" PRIu64 " lane_full=%" PRIu64 " out_of_order=%" PRIu64 "\n",
+		(uint64_t)st->spilled, (uint64_t)st->replayed, (uint64_t)st->direct,
+		(uint64_t)st->segments, c->lane_full, c->out_of_order);
+	ds_spill_print(&c->spill);
+
+	bad = c->consumed != USERTEST_ITEMS || c->out_of_order || st->errors ||
+	      !st->spilled || st->spilled != st->replayed ||
+	      st->replayed + st->direct != c->consumed;
+
+	ds_spill_destroy(&c->spill);
+	rmdir(dir);
+	return bad;
+}
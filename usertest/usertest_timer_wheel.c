@@ -0,0 +1,197 @@
+#include "usertest_common.h"
+
+#include "ds_timer_wheel.h"
+
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_NUM_CONSUMERS 1
+#define USERTEST_ITEMS_PER_PRODUCER 40
+#define USERTEST_CANCELS_PER_PRODUCER 10
+#define USERTEST_TICK_NS 100000ull          /* 100 us */
+#define USERTEST_MAX_DELAY_NS 50000000ull   /* 50 ms: spans levels 0..2 */
+#define USERTEST_CANCEL_DELAY_NS 5000000000ull
+#define USERTEST_LANE_CAPACITY 64
+#define USERTEST_POLL_US 50
+
+#define USERTEST_TOTAL_ITEMS (USERTEST_NUM_PRODUCERS * USERTEST_ITEMS_PER_PRODUCER)
+
+struct ctx {
+	struct ds_timer_wheel wheel;
+	struct ds_vyukhov_head lane;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	_Atomic uint64_t early;
+	_Atomic uint64_t max_late_ns;
+	_Atomic bool stop;
+};
+
+struct prod_arg {
+	struct ctx *c;
+	int tid;
+};
+
+static uint64_t item_key(int tid, int i)
+{
+	return (uint64_t)tid * 1000u + (uint64_t)(i + 1);
+}
+
+/*
+ * Producers schedule timers with spread-out delays (value = deadline) and
+ * also schedule far-future timers that they cancel straight away; those
+ * must never reach the lane.
+ */
+static void *producer_thread(void *arg)
+{
+	struct prod_arg *pa = arg;
+	struct ctx *c = pa->c;
+	uint64_t rng = 0x9E3779B97F4A7C15ull * (uint64_t)(pa->tid + 1);
+
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = item_key(pa->tid, i);
+		uint64_t deadline;
+
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		deadline = usertest_now_ns() + rng % USERTEST_MAX_DELAY_NS;
+
+		if (ds_timer_wheel_schedule_c(&c->wheel, deadline, key, deadline, NULL) != DS_SUCCESS) {
+			fprintf(stderr, "timer_wheel: schedule failed\n");
+			return (void *)1;
+		}
+
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			pa->tid, key, deadline);
+
+		if (i < USERTEST_CANCELS_PER_PRODUCER) {
+			struct ds_timer_wheel_handle h;
+
+			if (ds_timer_wheel_schedule_c(&c->wheel,
+						      usertest_now_ns() + USERTEST_CANCEL_DELAY_NS,
+						      ~0ull, 0, &h) != DS_SUCCESS ||
+			    ds_timer_wheel_cancel_c(&c->wheel, &h) != DS_SUCCESS ||
+			    ds_timer_wheel_cancel_c(&c->wheel, &h) != DS_ERROR_NOT_FOUND) {
+				fprintf(stderr, "timer_wheel: cancel failed\n");
+				return (void *)1;
+			}
+		}
+
+		usertest_sleep_us(200);
+	}
+
+	return NULL;
+}
+
+/* Single advancer: the userspace tick */
+static void *advancer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (!atomic_load_explicit(&c->stop, memory_order_relaxed)) {
+		ds_timer_wheel_advance_c(&c->wheel, usertest_now_ns(), &c->lane);
+		ds_timer_wheel_reclaim_c(&c->wheel);
+		usertest_sleep_us(USERTEST_POLL_US);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct ctx *c = arg;
+
+	while (atomic_load_explicit(&c->consumed, memory_order_relaxed) < USERTEST_TOTAL_ITEMS) {
+		struct ds_kv kv;
+		uint64_t now, late, prev;
+
+		if (ds_vyukhov_pop_c(&c->lane, &kv) != DS_SUCCESS) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+
+		now = usertest_now_ns();
+		if (kv.key == ~0ull || now < kv.value) {
+			atomic_fetch_add_explicit(&c->early, 1, memory_order_relaxed);
+		} else {
+			late = now - kv.value;
+			prev = atomic_load_explicit(&c->max_late_ns, memory_order_relaxed);
+			while (late > prev &&
+			       !atomic_compare_exchange_weak(&c->max_late_ns, &prev, late))
+				;
+		}
+
+		uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+		fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+			(uint64_t)kv.key, (uint64_t)kv.value, n);
+	}
+
+	return NULL;
+}
+
+int main(void)
+{
+	struct ctx c = {0};
+	pthread_t producers[USERTEST_NUM_PRODUCERS];
+	pthread_t consumer, advancer;
+	struct prod_arg pargs[USERTEST_NUM_PRODUCERS];
+	uint64_t cancelled, fired, freed;
+	int verify;
+
+	usertest_print_config("Timer wheel", USERTEST_NUM_PRODUCERS, USERTEST_NUM_CONSUMERS,
+			      USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_timer_wheel_init_c(&c.wheel, USERTEST_TICK_NS, usertest_now_ns()) != DS_SUCCESS ||
+	    ds_vyukhov_init_c(&c.lane, USERTEST_LANE_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "timer_wheel: init failed\n");
+		return 1;
+	}
+
+	if (pthread_create(&advancer, NULL, advancer_thread, &c) != 0 ||
+	    pthread_create(&consumer, NULL, consumer_thread, &c) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++) {
+		pargs[i] = (struct prod_arg){ .c = &c, .tid = i };
+		if (pthread_create(&producers[i], NULL, producer_thread, &pargs[i]) != 0) {
+			perror("pthread_create producer");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS; i++)
+		pthread_join(producers[i], NULL);
+	pthread_join(consumer, NULL);
+
+	/* Run the wheel past the cancelled deadlines so they get reclaimed */
+	atomic_store(&c.stop, true);
+	pthread_join(advancer, NULL);
+	for (int i = 0; i < 1024 && c.wheel.freed != c.wheel.scheduled; i++) {
+		ds_timer_wheel_advance_c(&c.wheel,
+					 usertest_now_ns() + 2 * USERTEST_CANCEL_DELAY_NS, &c.lane);
+		ds_timer_wheel_reclaim_c(&c.wheel);
+	}
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	cancelled = c.wheel.cancelled;
+	fired = c.wheel.fired;
+	freed = c.wheel.freed;
+	verify = ds_timer_wheel_verify_c(&c.wheel);
+	fprintf(stdout, "validation: fired=%" PRIu64 " cancelled=%" PRIu64 " freed=%" PRIu64
+		" reclaim_busy=%" PRIu64 " early=%" PRIu64 " max_late_us=%" PRIu64 " verify=%d\n",
+		fired, cancelled, freed, (uint64_t)c.wheel.reclaim_busy, (uint64_t)atomic_load(&c.early),
+		(uint64_t)atomic_load(&c.max_late_ns) / 1000u, verify);
+
+	if (atomic_load(&c.consumed) != USERTEST_TOTAL_ITEMS || atomic_load(&c.early) != 0)
+		return 1;
+	if (fired != USERTEST_TOTAL_ITEMS ||
+	    cancelled != USERTEST_NUM_PRODUCERS * USERTEST_CANCELS_PER_PRODUCER)
+		return 1;
+	if (freed != fired + cancelled || verify != DS_SUCCESS)
+		return 1;
+
+	return 0;
+}
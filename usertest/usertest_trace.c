@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include "usertest_common.h"
+
+#include <sched.h>
+
+/* ds_trace.h goes first so ds_vyukhov.h reports its retry counts */
+#include "ds_trace.h"
+#include "ds_vyukhov.h"
+
+/* Stage 2 knobs (edit these #defines; no CLI args) */
+#define USERTEST_NUM_PRODUCERS 3
+#define USERTEST_NUM_CONSUMERS 2
+#define USERTEST_ITEMS_PER_PRODUCER 2000
+#define USERTEST_POLL_US 50
+#define USERTEST_VYUKHOV_CAPACITY 64u
+#define USERTEST_DISABLED_OPS 100
+
+/* Lane ids as the exporter names them */
+#define USERTEST_LANE_EVENTS 0
+
+struct ctx {
+	struct ds_vyukhov_head q;
+	_Atomic uint64_t produced;
+	_Atomic uint64_t consumed;
+	uint64_t expected;
+};
+
+struct worker {
+	struct ctx *c;
+	int tid;
+	__u32 ring;
+	uint64_t ops; /* every recorded operation, failed ones included */
+	uint64_t ok;
+};
+
+static struct ds_metrics_store g_metrics;
+static struct ds_trace_store g_trace;
+
+static void *producer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	int rc;
+
+	w->ring = ds_trace_register_c(&g_trace);
+	for (int i = 0; i < USERTEST_ITEMS_PER_PRODUCER; i++) {
+		uint64_t key = (uint64_t)w->tid * 100000u + (uint64_t)(i + 1);
+		uint64_t value = usertest_now_ns();
+
+		for (;;) {
+			DS_TRACE_RECORD_OP_C(&g_metrics, DS_METRICS_USER_PRODUCER, &g_trace, w->ring,
+					     (__u32)sched_getcpu(), DS_OP_INSERT, USERTEST_LANE_EVENTS, {
+				rc = ds_vyukhov_insert_c(&c->q, key, value);
+			}, rc);
+			w->ops++;
+			if (rc == DS_SUCCESS)
+				break;
+			if (rc != DS_ERROR_NOMEM && rc != DS_ERROR_BUSY) {
+				fprintf(stderr, "trace: insert rc=%d\n", rc);
+				return (void *)1;
+			}
+			usertest_sleep_us(USERTEST_POLL_US);
+		}
+
+		w->ok++;
+		atomic_fetch_add_explicit(&c->produced, 1, memory_order_relaxed);
+		fprintf(stdout, "producer[%d]: key=%" PRIu64 " value=%" PRIu64 "\n",
+			w->tid, (uint64_t)key, (uint64_t)value);
+	}
+
+	return NULL;
+}
+
+static void *consumer_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct ctx *c = w->c;
+	struct ds_kv out;
+	int rc;
+
+	w->ring = ds_trace_register_c(&g_trace);
+	for (;;) {
+		if (atomic_load_explicit(&c->consumed, memory_order_relaxed) >= c->expected)
+			return NULL;
+
+		DS_TRACE_RECORD_OP_C(&g_metrics, DS_METRICS_USER_CONSUMER, &g_trace, w->ring,
+				     (__u32)sched_getcpu(), DS_OP_POP, USERTEST_LANE_EVENTS, {
+			rc = ds_vyukhov_pop_c(&c->q, &out);
+		}, rc);
+		w->ops++;
+		if (rc == DS_SUCCESS) {
+			uint64_t n = atomic_fetch_add_explicit(&c->consumed, 1, memory_order_relaxed) + 1;
+
+			w->ok++;
+			fprintf(stdout, "consumer: key=%" PRIu64 " value=%" PRIu64 " (n=%" PRIu64 ")\n",
+				(uint64_t)out.key, (uint64_t)out.value, (uint64_t)n);
+			continue;
+		}
+		if (rc == DS_ERROR_NOT_FOUND || rc == DS_ERROR_BUSY) {
+			usertest_sleep_us(USERTEST_POLL_US);
+			continue;
+		}
+		fprintf(stderr, "trace: pop rc=%d\n", rc);
+		return (void *)1;
+	}
+}
+
+/*
+ * Each ring holds exactly its writer's last min(ops, SLOTS) events, in
+ * start order, with the writer's op kind and a result that agrees with
+ * how many of them succeeded.
+ */
+static int check_ring(const struct worker *w, int op, struct ds_trace_event *buf)
+{
+	struct ds_trace_ring *ring = &g_trace.user[w->ring];
+	uint64_t want = w->ops < DS_TRACE_SLOTS ? w->ops : DS_TRACE_SLOTS;
+	__u32 n = ds_trace_read_ring_c(ring, buf);
+	uint64_t ok = 0;
+
+	if (ring->head != w->ops || n != want) {
+		fprintf(stderr, "trace: ring %u head=%llu kept=%u, want %llu/%llu\n", w->ring,
+			(unsigned long long)ring->head, n, (unsigned long long)w->ops,
+			(unsigned long long)want);
+		return -1;
+	}
+
+	for (__u32 i = 0; i < n; i++) {
+		if (buf[i].op != op || buf[i].lane != USERTEST_LANE_EVENTS ||
+		    (i && buf[i].start_ns < buf[i - 1].start_ns + buf[i - 1].dur_ns)) {
+			fprintf(stderr, "trace: ring %u event %u out of place\n", w->ring, i);
+			return -1;
+		}
+		ok += buf[i].result == DS_SUCCESS;
+	}
+
+	/* Only the newest events are kept, so at most all successes show up */
+	if (ok > w->ok || (w->ops <= DS_TRACE_SLOTS && ok != w->ok)) {
+		fprintf(stderr, "trace: ring %u shows %llu successes of %llu\n", w->ring,
+			(unsigned long long)ok, (unsigned long long)w->ok);
+		return -1;
+	}
+	return 0;
+}
+
+static int check_export(long want)
+{
+	static const char *const lanes[] = { "events" };
+	char tail[8] = {0};
+	long written;
+	FILE *f;
+
+	f = tmpfile();
+	if (!f)
+		return -1;
+
+	written = ds_trace_export_chrome_c(&g_trace, f, lanes, 1);
+	fseek(f, -3, SEEK_END);
+	if (fread(tail, 1, 3, f) != 3)
+		tail[0] = '\0';
+	fclose(f);
+
+	if (written != want || strcmp(tail, "]}\n") != 0) {
+		fprintf(stderr, "trace: exported %ld events, want %ld\n", written, want);
+		return -1;
+	}
+	fprintf(stdout, "validation: exported %ld events as Chrome trace JSON\n", written);
+	return 0;
+}
+
+int main(void)
+{
+	struct worker workers[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS] = {0};
+	pthread_t threads[USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS];
+	struct ds_trace_event *buf;
+	struct ctx c = {0};
+	uint64_t retries = 0, retried = 0;
+	long kept = 0;
+	struct ds_kv out;
+	__u32 ring;
+	int rc, failed = 0;
+
+	usertest_print_config("Flight recorder trace", USERTEST_NUM_PRODUCERS,
+			      USERTEST_NUM_CONSUMERS, USERTEST_ITEMS_PER_PRODUCER);
+
+	if (ds_vyukhov_init_c(&c.q, USERTEST_VYUKHOV_CAPACITY) != DS_SUCCESS) {
+		fprintf(stderr, "trace: init failed\n");
+		return 1;
+	}
+	c.expected = (uint64_t)USERTEST_NUM_PRODUCERS * (uint64_t)USERTEST_ITEMS_PER_PRODUCER;
+
+	/* Disabled: operations run, nothing is recorded */
+	ring = ds_trace_register_c(&g_trace);
+	for (int i = 0; i < USERTEST_DISABLED_OPS; i++)
+		DS_TRACE_RECORD_OP_C(&g_metrics, DS_METRICS_USER_CONSUMER, &g_trace, ring,
+				     0, DS_OP_POP, USERTEST_LANE_EVENTS, {
+			rc = ds_vyukhov_pop_c(&c.q, &out);
+		}, rc);
+	if (g_trace.user[ring].head != 0) {
+		fprintf(stderr, "trace: recorded while disabled\n");
+		return 1;
+	}
+	g_trace.nr_threads = 0;
+	arena_atomic_store(&g_trace.enabled, 1, ARENA_RELEASE);
+
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		bool producer = i < USERTEST_NUM_PRODUCERS;
+
+		workers[i] = (struct worker){ .c = &c, .tid = i };
+		if (pthread_create(&threads[i], NULL, producer ? producer_thread : consumer_thread,
+				   &workers[i]) != 0) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++)
+		pthread_join(threads[i], NULL);
+
+	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
+		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
+
+	buf = malloc(sizeof(*buf) * DS_TRACE_SLOTS);
+	if (!buf)
+		return 1;
+	for (int i = 0; i < USERTEST_NUM_PRODUCERS + USERTEST_NUM_CONSUMERS; i++) {
+		bool producer = i < USERTEST_NUM_PRODUCERS;
+		__u32 n;
+
+		if (check_ring(&workers[i], producer ? DS_OP_INSERT : DS_OP_POP, buf))
+			failed = 1;
+		n = ds_trace_read_ring_c(&g_trace.user[workers[i].ring], buf);
+		for (__u32 j = 0; j < n; j++) {
+			retries += buf[j].retries;
+			retried += buf[j].retries > 0;
+		}
+		kept += n;
+	}
+	free(buf);
+
+	fprintf(stdout, "validation: rings=%u kept=%ld retried=%" PRIu64 " retries=%" PRIu64 "\n",
+		g_trace.nr_threads, kept, retried, retries);
+	if (check_export(kept))
+		failed = 1;
+
+	return !failed && atomic_load(&c.consumed) == c.expected ? 0 : 1;
+}
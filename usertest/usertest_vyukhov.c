@@ -2,13 +2,31 @@
 
 #include "ds_vyukhov.h"
 
-/* Stage 2 knobs (edit these #defines; no CLI args) */
+/*
+ * Stage 2 knobs (edit these #defines; no CLI args). scripts/relax_explorer.py
+ * overrides them with -D to turn this into a no-sleep stress run.
+ */
+#ifndef USERTEST_NUM_PRODUCERS
 #define USERTEST_NUM_PRODUCERS 2
+#endif
+#ifndef USERTEST_NUM_CONSUMERS
 #define USERTEST_NUM_CONSUMERS 2
+#endif
+#ifndef USERTEST_ITEMS_PER_PRODUCER
 #define USERTEST_ITEMS_PER_PRODUCER 2
+#endif
+#ifndef USERTEST_PRODUCER_SLEEP_SEC
 #define USERTEST_PRODUCER_SLEEP_SEC 2
+#endif
+#ifndef USERTEST_POLL_US
 #define USERTEST_POLL_US 1000
+#endif
+#ifndef USERTEST_VYUKHOV_CAPACITY
 #define USERTEST_VYUKHOV_CAPACITY 64u
+#endif
+
+/* Small enough to come from a shared page fragment, not a page run */
+#define USERTEST_REUSE_CAPACITY 16u
 
 struct ctx {
 	struct ds_vyukhov_head q;
@@ -79,6 +97,60 @@ static void *consumer_thread(void *arg)
 	}
 }
 
+/*
+ * Run a ring through a full lap, free it and init a new one on the same
+ * memory, still holding the old sequences. The O(1) init only works if
+ * the slot array comes back zeroed: every slot of the new ring must take
+ * an insert, in order. Single-threaded; runs after the workers joined.
+ */
+static int reuse_phase(void)
+{
+	__u64 bytes = (__u64)USERTEST_REUSE_CAPACITY * sizeof(struct ds_vyukhov_node);
+	size_t mark = atomic_load_explicit(&usertest_arena_off, memory_order_relaxed);
+	struct ds_vyukhov_head a = {0}, b = {0};
+	struct ds_vyukhov_node __arena *old;
+	struct ds_kv out;
+
+	if (ds_vyukhov_init_c(&a, USERTEST_REUSE_CAPACITY) != DS_SUCCESS)
+		return 1;
+	for (__u64 i = 0; i < USERTEST_REUSE_CAPACITY; i++)
+		if (ds_vyukhov_insert_c(&a, i, i) != DS_SUCCESS)
+			return 1;
+	for (__u64 i = 0; i < USERTEST_REUSE_CAPACITY; i++)
+		if (ds_vyukhov_pop_c(&a, &out) != DS_SUCCESS)
+			return 1;
+
+	old = a.buffer;
+	ds_arena_free_array(a.buffer, bytes);
+	/* The test allocator never reuses; rewind it like a recycling one would */
+	atomic_store_explicit(&usertest_arena_off, mark, memory_order_relaxed);
+	if (ds_vyukhov_init_c(&b, USERTEST_REUSE_CAPACITY) != DS_SUCCESS)
+		return 1;
+	fprintf(stdout, "reuse: old=%p new=%p\n", (void *)old, (void *)b.buffer);
+	if (b.buffer != old) {
+		fprintf(stderr, "vyukhov: freed slot array was not reused\n");
+		return 1;
+	}
+
+	for (__u64 i = 0; i < USERTEST_REUSE_CAPACITY; i++) {
+		if (ds_vyukhov_insert_c(&b, 100 + i, i) != DS_SUCCESS) {
+			fprintf(stderr, "vyukhov: reused ring rejected insert %llu\n",
+				(unsigned long long)i);
+			return 1;
+		}
+	}
+	for (__u64 i = 0; i < USERTEST_REUSE_CAPACITY; i++) {
+		if (ds_vyukhov_pop_c(&b, &out) != DS_SUCCESS || out.key != 100 + i) {
+			fprintf(stderr, "vyukhov: reused ring pop %llu out of order\n",
+				(unsigned long long)i);
+			return 1;
+		}
+	}
+
+	ds_arena_free_array(b.buffer, bytes);
+	return 0;
+}
+
 int main(void)
 {
 	struct ctx c = {0};
@@ -118,5 +190,8 @@ int main(void)
 
 	fprintf(stdout, "done: produced=%" PRIu64 " consumed=%" PRIu64 "\n",
 		(uint64_t)atomic_load(&c.produced), (uint64_t)atomic_load(&c.consumed));
-	return atomic_load(&c.consumed) == c.expected ? 0 : 1;
+	if (atomic_load(&c.consumed) != c.expected)
+		return 1;
+
+	return reuse_phase();
 }